@@ -0,0 +1,46 @@
+#!/bin/bash -eu
+
+# Build the setup benchmark harness: like the fuzzers, the harness is
+# linked against the Janus objects it exercises, but with optimizations
+# on and no sanitizers, since we're measuring performance
+
+SCRIPTPATH="$( cd "$(dirname "$0")" ; pwd -P )"
+SRC="$(dirname $SCRIPTPATH)"
+OUT=${OUT-"$SCRIPTPATH/out"}
+
+BENCH_CC=${CC-gcc}
+BENCH_CFLAGS=${CFLAGS-"-O2 -g -fno-omit-frame-pointer"}
+
+# Janus objects needed by the harness
+JANUS_OBJECTS="janus-log.o janus-utils.o janus-rtcp.o janus-rtp.o janus-sdp-utils.o"
+
+DEPS_CFLAGS="$(pkg-config --cflags glib-2.0 jansson)"
+DEPS_LIB="$(pkg-config --libs glib-2.0 jansson) -pthread -lm"
+
+# Build the Janus objects, unless the caller did that already
+SKIP_JANUS_BUILD=${SKIP_JANUS_BUILD-"0"}
+pushd $SRC
+if [ "$SKIP_JANUS_BUILD" -eq "0" ]; then
+	echo "Building Janus objects"
+	./autogen.sh
+	./configure CC="$BENCH_CC" CFLAGS="$BENCH_CFLAGS" \
+		--disable-docs --disable-post-processing --disable-turn-rest-api \
+		--disable-all-transports --disable-all-plugins --disable-all-handlers \
+		--disable-data-channels
+	pushd src
+	make clean
+	make -j$(nproc) $JANUS_OBJECTS
+	popd
+fi
+popd
+
+# Build the benchmarks
+mkdir -p $OUT
+benchmarks=$(find $SCRIPTPATH -maxdepth 1 -name "*.c")
+for sourceFile in $benchmarks; do
+	name=$(basename $sourceFile .c)
+	echo "Building benchmark: $name"
+	$BENCH_CC $BENCH_CFLAGS $DEPS_CFLAGS -I$SRC/src $sourceFile \
+		$(for o in $JANUS_OBJECTS; do echo $SRC/src/$o; done) \
+		-o $OUT/$name $DEPS_LIB
+done
@@ -0,0 +1,135 @@
+/* Benchmark for the CPU-bound part of the handle setup pipeline
+ *
+ * The harness performs N in-process negotiate cycles (parse a typical
+ * browser offer, generate and render an answer, tear everything down)
+ * and reports the sustained rate plus p50/p99/worst latency per cycle.
+ * It is meant to catch setup-rate regressions in the SDP machinery
+ * before a deploy: run it on a release build, pin it to a core, and
+ * compare the numbers against the previous release (see the README
+ * for how to wrap it with perf(1) to get cycle/instruction counts).
+ *
+ * Usage: setup_bench [iterations] (default: 10000) */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <glib.h>
+#include "../src/debug.h"
+#include "../src/sdp-utils.h"
+#include "../src/utils.h"
+
+int janus_log_level = LOG_NONE;
+gboolean janus_log_timestamps = FALSE;
+gboolean janus_log_colors = FALSE;
+char *janus_log_global_prefix = NULL;
+int lock_debug = 0;
+int refcount_debug = 0;
+
+/* This is to avoid linking with openSSL */
+int RAND_bytes(uint8_t *key, int len) {
+	return 0;
+}
+
+/* A typical audio+video offer, as browsers send it */
+static const char *offer_sdp =
+	"v=0\r\n"
+	"o=- 1234567890123456 2 IN IP4 127.0.0.1\r\n"
+	"s=-\r\n"
+	"t=0 0\r\n"
+	"a=group:BUNDLE audio video\r\n"
+	"a=msid-semantic: WMS janus\r\n"
+	"m=audio 9 UDP/TLS/RTP/SAVPF 111 0 8\r\n"
+	"c=IN IP4 0.0.0.0\r\n"
+	"a=rtcp:9 IN IP4 0.0.0.0\r\n"
+	"a=ice-ufrag:bench\r\n"
+	"a=ice-pwd:benchbenchbenchbenchbench\r\n"
+	"a=fingerprint:sha-256 D2:B9:31:8F:DF:24:D8:0E:ED:D2:EF:25:9E:AF:6F:B8:34:AE:53:9C:E6:F3:8F:F2:64:15:FA:E8:7F:53:2D:38\r\n"
+	"a=setup:actpass\r\n"
+	"a=mid:audio\r\n"
+	"a=sendrecv\r\n"
+	"a=rtpmap:111 opus/48000/2\r\n"
+	"a=fmtp:111 minptime=10;useinbandfec=1\r\n"
+	"a=rtpmap:0 PCMU/8000\r\n"
+	"a=rtpmap:8 PCMA/8000\r\n"
+	"a=extmap:1 urn:ietf:params:rtp-hdrext:sdes:mid\r\n"
+	"a=extmap:2 http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time\r\n"
+	"a=ssrc:11111111 cname:janusbench\r\n"
+	"m=video 9 UDP/TLS/RTP/SAVPF 96 97\r\n"
+	"c=IN IP4 0.0.0.0\r\n"
+	"a=rtcp:9 IN IP4 0.0.0.0\r\n"
+	"a=ice-ufrag:bench\r\n"
+	"a=ice-pwd:benchbenchbenchbenchbench\r\n"
+	"a=fingerprint:sha-256 D2:B9:31:8F:DF:24:D8:0E:ED:D2:EF:25:9E:AF:6F:B8:34:AE:53:9C:E6:F3:8F:F2:64:15:FA:E8:7F:53:2D:38\r\n"
+	"a=setup:actpass\r\n"
+	"a=mid:video\r\n"
+	"a=sendrecv\r\n"
+	"a=rtpmap:96 VP8/90000\r\n"
+	"a=rtcp-fb:96 ccm fir\r\n"
+	"a=rtcp-fb:96 nack\r\n"
+	"a=rtcp-fb:96 nack pli\r\n"
+	"a=rtcp-fb:96 goog-remb\r\n"
+	"a=rtpmap:97 rtx/90000\r\n"
+	"a=fmtp:97 apt=96\r\n"
+	"a=extmap:1 urn:ietf:params:rtp-hdrext:sdes:mid\r\n"
+	"a=extmap:3 urn:3gpp:video-orientation\r\n"
+	"a=ssrc:22222222 cname:janusbench\r\n";
+
+static int compare_latencies(const void *a, const void *b) {
+	gint64 la = *(const gint64 *)a, lb = *(const gint64 *)b;
+	return la == lb ? 0 : (la < lb ? -1 : 1);
+}
+
+int main(int argc, char *argv[]) {
+	int iterations = 10000;
+	if(argc > 1)
+		iterations = atoi(argv[1]);
+	if(iterations < 1) {
+		fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+		return 1;
+	}
+	gint64 *latencies = g_malloc(iterations*sizeof(gint64));
+	char error_str[512];
+	int i = 0;
+	gint64 started = janus_get_monotonic_time();
+	for(i = 0; i < iterations; i++) {
+		gint64 before = janus_get_monotonic_time();
+		/* Parse the offer, as the core does when a browser sends one */
+		janus_sdp *offer = janus_sdp_parse(offer_sdp, error_str, sizeof(error_str));
+		if(offer == NULL) {
+			fprintf(stderr, "Error parsing offer: %s\n", error_str);
+			g_free(latencies);
+			return 1;
+		}
+		/* Generate an answer, accepting both m-lines */
+		janus_sdp *answer = janus_sdp_generate_answer(offer);
+		GList *temp = offer->m_lines;
+		while(temp) {
+			janus_sdp_mline *m = (janus_sdp_mline *)temp->data;
+			janus_sdp_generate_answer_mline(offer, answer, m,
+				JANUS_SDP_OA_MLINE, m->type,
+				JANUS_SDP_OA_DONE);
+			temp = temp->next;
+		}
+		/* Render the answer back to a blob, as we'd send it to the browser */
+		char *answer_sdp = janus_sdp_write(answer);
+		/* Cycle done, tear everything down */
+		g_free(answer_sdp);
+		janus_sdp_destroy(answer);
+		janus_sdp_destroy(offer);
+		latencies[i] = janus_get_monotonic_time() - before;
+	}
+	gint64 elapsed = janus_get_monotonic_time() - started;
+	/* Crunch the numbers */
+	qsort(latencies, iterations, sizeof(gint64), compare_latencies);
+	double rate = elapsed > 0 ? (double)iterations*G_USEC_PER_SEC/(double)elapsed : 0.0;
+	printf("Negotiate cycles:  %d\n", iterations);
+	printf("Total time:        %.3fs\n", (double)elapsed/G_USEC_PER_SEC);
+	printf("Rate:              %.0f cycles/sec\n", rate);
+	printf("Latency (p50):     %"SCNi64"us\n", latencies[iterations/2]);
+	printf("Latency (p99):     %"SCNi64"us\n", latencies[(int)(iterations*0.99)]);
+	printf("Latency (worst):   %"SCNi64"us\n", latencies[iterations-1]);
+	g_free(latencies);
+	return 0;
+}
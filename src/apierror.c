@@ -54,6 +54,10 @@ const char *janus_get_api_error(int error) {
 			return "Wrong WebRTC state";
 		case JANUS_ERROR_NOT_ACCEPTING_SESSIONS:
 			return "Currently not accepting new sessions";
+		case JANUS_ERROR_REQUEST_PENDING:
+			return "Request with the same dedupe key still being processed";
+		case JANUS_ERROR_TOO_MANY_REQUESTS:
+			return "Too many requests";
 		default:
 			return "Unknown error";
 	}
@@ -66,6 +66,10 @@
 #define JANUS_ERROR_WEBRTC_STATE				471
 /*! \brief The server is currently configured not to accept new sessions */
 #define JANUS_ERROR_NOT_ACCEPTING_SESSIONS		472
+/*! \brief A request with the same dedupe key is still being processed */
+#define JANUS_ERROR_REQUEST_PENDING				473
+/*! \brief The request was rejected because a rate limit has been exceeded */
+#define JANUS_ERROR_TOO_MANY_REQUESTS			474
 
 
 /*! \brief Helper method to get a string representation of an API error code
@@ -33,16 +33,83 @@
 #include "mutex.h"
 #include "utils.h"
 
-/* Hash table to contain the tokens to match */
+/* Hash table to contain the tokens to match: token checks happen on
+ * every single API message, so we use a read/write lock to keep the
+ * lookups from contending with each other (updates are much rarer) */
 static GHashTable *tokens = NULL, *allowed_plugins = NULL;
 static gboolean auth_enabled = FALSE;
-static janus_mutex mutex;
+static janus_rwlock rwlock;
 static char *auth_secret = NULL;
 
 static void janus_auth_free_token(char *token) {
 	g_free(token);
 }
 
+/* In signed mode, we keep a small LRU cache of recently verified tokens,
+ * so we don't have to recompute the HMAC on every request (including
+ * keepalives and trickles): entries are dropped when the token expires,
+ * or when the cache is full and the token is the least recently used */
+#define JANUS_AUTH_SIGNED_CACHE_SIZE	100
+typedef struct janus_auth_signed_token {
+	char *token;		/* The token string (used as the hash table key too) */
+	char *realm;		/* The realm the token was verified against */
+	gint64 expiry;		/* When the token expires, in seconds */
+	GList *lru;			/* Position in the LRU queue */
+} janus_auth_signed_token;
+static GHashTable *signed_tokens = NULL;
+static GQueue signed_lru = G_QUEUE_INIT;
+static janus_mutex signed_mutex;
+
+static void janus_auth_free_signed_token(janus_auth_signed_token *cached) {
+	if(cached == NULL)
+		return;
+	g_free(cached->token);
+	g_free(cached->realm);
+	g_free(cached);
+}
+
+/* Check if we recently verified this token already: the caller is
+ * supposed to hold the signed_mutex lock when invoking this helper */
+static gboolean janus_auth_signed_cache_check(const char *token, const char *realm) {
+	if(signed_tokens == NULL || token == NULL || realm == NULL)
+		return FALSE;
+	janus_auth_signed_token *cached = g_hash_table_lookup(signed_tokens, token);
+	if(cached == NULL || strcmp(cached->realm, realm))
+		return FALSE;
+	if(janus_get_real_time()/G_USEC_PER_SEC > cached->expiry) {
+		/* The token expired, get rid of the cached entry */
+		g_queue_delete_link(&signed_lru, cached->lru);
+		g_hash_table_remove(signed_tokens, cached->token);
+		return FALSE;
+	}
+	/* Cache hit: mark the token as the most recently used one */
+	g_queue_unlink(&signed_lru, cached->lru);
+	g_queue_push_tail_link(&signed_lru, cached->lru);
+	return TRUE;
+}
+
+/* Cache a token we just verified: the caller is supposed to hold the
+ * signed_mutex lock when invoking this helper */
+static void janus_auth_signed_cache_add(const char *token, const char *realm, gint64 expiry) {
+	if(signed_tokens == NULL || token == NULL || realm == NULL)
+		return;
+	if(g_hash_table_lookup(signed_tokens, token) != NULL)
+		return;
+	if(g_hash_table_size(signed_tokens) >= JANUS_AUTH_SIGNED_CACHE_SIZE) {
+		/* The cache is full, evict the least recently used token */
+		janus_auth_signed_token *old = g_queue_pop_head(&signed_lru);
+		if(old != NULL)
+			g_hash_table_remove(signed_tokens, old->token);
+	}
+	janus_auth_signed_token *cached = g_malloc(sizeof(janus_auth_signed_token));
+	cached->token = g_strdup(token);
+	cached->realm = g_strdup(realm);
+	cached->expiry = expiry;
+	g_queue_push_tail(&signed_lru, cached);
+	cached->lru = g_queue_peek_tail_link(&signed_lru);
+	g_hash_table_insert(signed_tokens, cached->token, cached);
+}
+
 /* Setup */
 void janus_auth_init(gboolean enabled, const char *secret) {
 	if(enabled) {
@@ -54,12 +121,15 @@ void janus_auth_init(gboolean enabled, const char *secret) {
 		} else {
 			JANUS_LOG(LOG_INFO, "Signed-Token based authentication enabled\n");
 			auth_secret = g_strdup(secret);
+			signed_tokens = g_hash_table_new_full(g_str_hash, g_str_equal,
+				NULL, (GDestroyNotify)janus_auth_free_signed_token);
 			auth_enabled = TRUE;
 		}
 	} else {
 		JANUS_LOG(LOG_INFO, "Token based authentication disabled\n");
 	}
-	janus_mutex_init(&mutex);
+	janus_rwlock_init(&rwlock);
+	janus_mutex_init(&signed_mutex);
 }
 
 gboolean janus_auth_is_enabled(void) {
@@ -75,7 +145,7 @@ gboolean janus_auth_is_signed_mode(void) {
 }
 
 void janus_auth_deinit(void) {
-	janus_mutex_lock(&mutex);
+	janus_rwlock_wrlock(&rwlock);
 	if(tokens != NULL)
 		g_hash_table_destroy(tokens);
 	tokens = NULL;
@@ -84,12 +154,24 @@ void janus_auth_deinit(void) {
 	allowed_plugins = NULL;
 	g_free(auth_secret);
 	auth_secret = NULL;
-	janus_mutex_unlock(&mutex);
+	janus_rwlock_wrunlock(&rwlock);
+	janus_mutex_lock(&signed_mutex);
+	g_queue_clear(&signed_lru);
+	if(signed_tokens != NULL)
+		g_hash_table_destroy(signed_tokens);
+	signed_tokens = NULL;
+	janus_mutex_unlock(&signed_mutex);
 }
 
 gboolean janus_auth_check_signature(const char *token, const char *realm) {
 	if (!auth_enabled || auth_secret == NULL)
 		return FALSE;
+	/* Did we verify this specific token recently already? */
+	janus_mutex_lock(&signed_mutex);
+	gboolean cached = janus_auth_signed_cache_check(token, realm);
+	janus_mutex_unlock(&signed_mutex);
+	if(cached)
+		return TRUE;
 	gchar **parts = g_strsplit(token, ":", 2);
 	gchar **data = NULL;
 	/* Token should have exactly one data and one hash part */
@@ -113,6 +195,12 @@ gboolean janus_auth_check_signature(const char *token, const char *realm) {
 	HMAC(EVP_sha1(), auth_secret, strlen(auth_secret), (const unsigned char*)parts[0], strlen(parts[0]), signature, &len);
 	gchar *base64 = g_base64_encode(signature, len);
 	gboolean result = janus_strcmp_const_time(parts[1], base64);
+	if(result) {
+		/* Valid token: cache it, so we can skip the HMAC next time */
+		janus_mutex_lock(&signed_mutex);
+		janus_auth_signed_cache_add(token, realm, expiry_time);
+		janus_mutex_unlock(&signed_mutex);
+	}
 	g_strfreev(data);
 	g_strfreev(parts);
 	g_free(base64);
@@ -183,15 +271,15 @@ gboolean janus_auth_add_token(const char *token) {
 	}
 	if(token == NULL)
 		return FALSE;
-	janus_mutex_lock(&mutex);
+	janus_rwlock_wrlock(&rwlock);
 	if(g_hash_table_lookup(tokens, token)) {
 		JANUS_LOG(LOG_VERB, "Token already validated\n");
-		janus_mutex_unlock(&mutex);
+		janus_rwlock_wrunlock(&rwlock);
 		return TRUE;
 	}
 	char *new_token = g_strdup(token);
 	g_hash_table_insert(tokens, new_token, new_token);
-	janus_mutex_unlock(&mutex);
+	janus_rwlock_wrunlock(&rwlock);
 	return TRUE;
 }
 
@@ -201,12 +289,12 @@ gboolean janus_auth_check_token(const char *token) {
 		return TRUE;
 	if (tokens == NULL)
 		return janus_auth_check_signature(token, "janus");
-	janus_mutex_lock(&mutex);
+	janus_rwlock_rdlock(&rwlock);
 	if(token && g_hash_table_lookup(tokens, token)) {
-		janus_mutex_unlock(&mutex);
+		janus_rwlock_rdunlock(&rwlock);
 		return TRUE;
 	}
-	janus_mutex_unlock(&mutex);
+	janus_rwlock_rdunlock(&rwlock);
 	return FALSE;
 }
 
@@ -214,7 +302,7 @@ GList *janus_auth_list_tokens(void) {
 	/* Always NULL if the mechanism is disabled, of course */
 	if(!auth_enabled || tokens == NULL)
 		return NULL;
-	janus_mutex_lock(&mutex);
+	janus_rwlock_rdlock(&rwlock);
 	GList *list = NULL;
 	if(g_hash_table_size(tokens) > 0) {
 		GHashTableIter iter;
@@ -225,7 +313,7 @@ GList *janus_auth_list_tokens(void) {
 			list = g_list_append(list, g_strdup(token));
 		}
 	}
-	janus_mutex_unlock(&mutex);
+	janus_rwlock_rdunlock(&rwlock);
 	return list;
 }
 
@@ -234,7 +322,7 @@ gboolean janus_auth_remove_token(const char *token) {
 		JANUS_LOG(LOG_ERR, "Can't remove token, stored-authentication mechanism is disabled\n");
 		return FALSE;
 	}
-	janus_mutex_lock(&mutex);
+	janus_rwlock_wrlock(&rwlock);
 	gboolean ok = token && g_hash_table_remove(tokens, token);
 	/* Also clear the allowed plugins mapping */
 	GList *list = g_hash_table_lookup(allowed_plugins, token);
@@ -242,7 +330,7 @@ gboolean janus_auth_remove_token(const char *token) {
 	if(list != NULL)
 		g_list_free(list);
 	/* Done */
-	janus_mutex_unlock(&mutex);
+	janus_rwlock_wrunlock(&rwlock);
 	return ok;
 }
 
@@ -254,9 +342,9 @@ gboolean janus_auth_allow_plugin(const char *token, janus_plugin *plugin) {
 	}
 	if(token == NULL || plugin == NULL)
 		return FALSE;
-	janus_mutex_lock(&mutex);
+	janus_rwlock_wrlock(&rwlock);
 	if(!g_hash_table_lookup(tokens, token)) {
-		janus_mutex_unlock(&mutex);
+		janus_rwlock_wrunlock(&rwlock);
 		return FALSE;
 	}
 	GList *list = g_hash_table_lookup(allowed_plugins, token);
@@ -265,19 +353,19 @@ gboolean janus_auth_allow_plugin(const char *token, janus_plugin *plugin) {
 		list = g_list_append(list, plugin);
 		char *new_token = g_strdup(token);
 		g_hash_table_insert(allowed_plugins, new_token, list);
-		janus_mutex_unlock(&mutex);
+		janus_rwlock_wrunlock(&rwlock);
 		return TRUE;
 	}
 	/* We already have a list, update it if needed */
 	if(g_list_find(list, plugin) != NULL) {
 		JANUS_LOG(LOG_VERB, "Plugin access already allowed for token\n");
-		janus_mutex_unlock(&mutex);
+		janus_rwlock_wrunlock(&rwlock);
 		return TRUE;
 	}
 	list = g_list_append(list, plugin);
 	char *new_token = g_strdup(token);
 	g_hash_table_insert(allowed_plugins, new_token, list);
-	janus_mutex_unlock(&mutex);
+	janus_rwlock_wrunlock(&rwlock);
 	return TRUE;
 }
 
@@ -287,17 +375,17 @@ gboolean janus_auth_check_plugin(const char *token, janus_plugin *plugin) {
 		return TRUE;
 	if (allowed_plugins == NULL)
 		return janus_auth_check_signature_contains(token, "janus", plugin->get_package());
-	janus_mutex_lock(&mutex);
+	janus_rwlock_rdlock(&rwlock);
 	if(!g_hash_table_lookup(tokens, token)) {
-		janus_mutex_unlock(&mutex);
+		janus_rwlock_rdunlock(&rwlock);
 		return FALSE;
 	}
 	GList *list = g_hash_table_lookup(allowed_plugins, token);
 	if(g_list_find(list, plugin) == NULL) {
-		janus_mutex_unlock(&mutex);
+		janus_rwlock_rdunlock(&rwlock);
 		return FALSE;
 	}
-	janus_mutex_unlock(&mutex);
+	janus_rwlock_rdunlock(&rwlock);
 	return TRUE;
 }
 
@@ -305,16 +393,16 @@ GList *janus_auth_list_plugins(const char *token) {
 	/* Always NULL if the mechanism is disabled, of course */
 	if(!auth_enabled || allowed_plugins == NULL)
 		return NULL;
-	janus_mutex_lock(&mutex);
+	janus_rwlock_rdlock(&rwlock);
 	if(!g_hash_table_lookup(tokens, token)) {
-		janus_mutex_unlock(&mutex);
+		janus_rwlock_rdunlock(&rwlock);
 		return FALSE;
 	}
 	GList *list = NULL;
 	GList *plugins_list = g_hash_table_lookup(allowed_plugins, token);
 	if(plugins_list != NULL)
 		list = g_list_copy(plugins_list);
-	janus_mutex_unlock(&mutex);
+	janus_rwlock_rdunlock(&rwlock);
 	return list;
 }
 
@@ -323,9 +411,9 @@ gboolean janus_auth_disallow_plugin(const char *token, janus_plugin *plugin) {
 		JANUS_LOG(LOG_ERR, "Can't disallow access to plugin, authentication mechanism is disabled\n");
 		return FALSE;
 	}
-	janus_mutex_lock(&mutex);
+	janus_rwlock_wrlock(&rwlock);
 	if(!g_hash_table_lookup(tokens, token)) {
-		janus_mutex_unlock(&mutex);
+		janus_rwlock_wrunlock(&rwlock);
 		return FALSE;
 	}
 	GList *list = g_hash_table_lookup(allowed_plugins, token);
@@ -335,6 +423,6 @@ gboolean janus_auth_disallow_plugin(const char *token, janus_plugin *plugin) {
 		char *new_token = g_strdup(token);
 		g_hash_table_insert(allowed_plugins, new_token, list);
 	}
-	janus_mutex_unlock(&mutex);
+	janus_rwlock_wrunlock(&rwlock);
 	return TRUE;
 }
@@ -2,7 +2,10 @@
  * \author   Lorenzo Miniero <lorenzo@meetecho.com>
  * \copyright GNU General Public License v3
  * \brief    OpenSSL BIO agent writer
- * \details  OpenSSL BIO that writes packets to a libnice agent.
+ * \details  OpenSSL BIO that writes packets to a libnice agent. Notice that
+ * outgoing records are handed to nice_agent_send as they are, with no
+ * intermediate copies or buffering: this matters for data channel heavy
+ * deployments, where a lot of traffic goes through this path.
  *
  * \ingroup protocols
  * \ref protocols
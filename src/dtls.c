@@ -18,6 +18,8 @@
 #include "rtcp.h"
 #include "events.h"
 
+#include <sys/stat.h>
+
 #include <openssl/err.h>
 #include <openssl/bn.h>
 #include <openssl/evp.h>
@@ -122,10 +124,47 @@ gboolean janus_dtls_are_selfsigned_certs_ok(void) {
  * that value cannot be modified (it will in OpenSSL v1.1.1) */
 static guint16 dtls_timeout_base = 1000;
 
+/* SRTP replay-protection window to use when creating SRTP sessions: the
+ * default libsrtp window (128 packets) is fine in most cases, but deployments
+ * dealing with heavy reordering (e.g., bonded links) may want a larger one,
+ * to avoid valid packets being dropped as replays */
+#define DEFAULT_SRTP_REPLAY_WINDOW	128
+static guint srtp_replay_window = DEFAULT_SRTP_REPLAY_WINDOW;
+void janus_dtls_set_srtp_replay_window(guint window_size) {
+	if(window_size < 64 || window_size > 32768) {
+		JANUS_LOG(LOG_WARN, "Invalid SRTP replay window size %u, falling back to default (%d)\n",
+			window_size, DEFAULT_SRTP_REPLAY_WINDOW);
+		window_size = DEFAULT_SRTP_REPLAY_WINDOW;
+	}
+	srtp_replay_window = window_size;
+}
+guint janus_dtls_get_srtp_replay_window(void) {
+	return srtp_replay_window;
+}
+
+/* Number of SRTP sessions (crypto contexts) currently allocated by the core:
+ * each established PeerConnection accounts for two, one per direction */
+static volatile gint srtp_sessions = 0;
+gint janus_dtls_get_srtp_session_count(void) {
+	return g_atomic_int_get(&srtp_sessions);
+}
+
 static SSL_CTX *ssl_ctx = NULL;
 static X509 *ssl_cert = NULL;
 static EVP_PKEY *ssl_key = NULL;
 
+/* Incoming DTLS messages are processed by a worker pool, rather than by the
+ * handle loops: handshakes involve expensive asymmetric crypto, and a storm
+ * of reconnecting clients would otherwise delay media for the established
+ * PeerConnections served by the same loops. Tasks are serialized per stack,
+ * so messages are still processed in the order they were received */
+static GThreadPool *handshake_pool = NULL;
+static void janus_dtls_srtp_handshake_task(gpointer data, gpointer user_data);
+typedef struct janus_dtls_srtp_msg {
+	char *buf;		/* NULL if this is just kickstarting the handshake */
+	uint16_t len;
+} janus_dtls_srtp_msg;
+
 static gchar local_fingerprint[160];
 gchar *janus_dtls_get_local_fingerprint(void) {
 	return (gchar *)local_fingerprint;
@@ -389,6 +428,96 @@ error:
 	return -1;
 }
 
+/* Helpers to cache autogenerated certificates to (and reuse them from) a
+ * local directory, so that the local fingerprint survives restarts: unlike
+ * janus_dtls_load_keys above, a failure here is not fatal, as we can always
+ * fall back to generating a new certificate */
+static int janus_dtls_load_cached_keys(const char *cert_path, const char *key_path,
+		gboolean rsa_private_key, X509 **certificate, EVP_PKEY **private_key) {
+	if(!g_file_test(cert_path, G_FILE_TEST_IS_REGULAR) || !g_file_test(key_path, G_FILE_TEST_IS_REGULAR))
+		return -1;
+	FILE *f = fopen(cert_path, "r");
+	if(!f) {
+		JANUS_LOG(LOG_WARN, "Error opening cached certificate file (%s)\n", g_strerror(errno));
+		goto error;
+	}
+	*certificate = PEM_read_X509(f, NULL, NULL, NULL);
+	fclose(f);
+	f = NULL;
+	if(!*certificate) {
+		JANUS_LOG(LOG_WARN, "Error parsing cached certificate file\n");
+		goto error;
+	}
+	f = fopen(key_path, "r");
+	if(!f) {
+		JANUS_LOG(LOG_WARN, "Error opening cached key file (%s)\n", g_strerror(errno));
+		goto error;
+	}
+	*private_key = PEM_read_PrivateKey(f, NULL, NULL, NULL);
+	fclose(f);
+	f = NULL;
+	if(!*private_key) {
+		JANUS_LOG(LOG_WARN, "Error parsing cached key file\n");
+		goto error;
+	}
+	/* Make sure what we loaded is still usable */
+	if(X509_cmp_current_time(X509_get_notAfter(*certificate)) <= 0) {
+		JANUS_LOG(LOG_WARN, "Cached DTLS certificate has expired, generating a new one\n");
+		goto error;
+	}
+	if(EVP_PKEY_base_id(*private_key) != (rsa_private_key ? EVP_PKEY_RSA : EVP_PKEY_EC)) {
+		JANUS_LOG(LOG_WARN, "Cached DTLS key doesn't match the configured key type, generating a new one\n");
+		goto error;
+	}
+	return 0;
+
+error:
+	if(f)
+		fclose(f);
+	if(*certificate) {
+		X509_free(*certificate);
+		*certificate = NULL;
+	}
+	if(*private_key) {
+		EVP_PKEY_free(*private_key);
+		*private_key = NULL;
+	}
+	return -1;
+}
+
+static int janus_dtls_save_cached_keys(const char *cert_path, const char *key_path,
+		X509 *certificate, EVP_PKEY *private_key) {
+	/* Write the key first, making sure only we can read it back */
+	FILE *f = fopen(key_path, "w");
+	if(!f) {
+		JANUS_LOG(LOG_WARN, "Error creating cached key file (%s)\n", g_strerror(errno));
+		return -1;
+	}
+	(void)fchmod(fileno(f), S_IRUSR | S_IWUSR);
+	if(!PEM_write_PrivateKey(f, private_key, NULL, NULL, 0, NULL, NULL)) {
+		JANUS_LOG(LOG_WARN, "Error writing cached key file\n");
+		fclose(f);
+		unlink(key_path);
+		return -1;
+	}
+	fclose(f);
+	f = fopen(cert_path, "w");
+	if(!f) {
+		JANUS_LOG(LOG_WARN, "Error creating cached certificate file (%s)\n", g_strerror(errno));
+		unlink(key_path);
+		return -1;
+	}
+	if(!PEM_write_X509(f, certificate)) {
+		JANUS_LOG(LOG_WARN, "Error writing cached certificate file\n");
+		fclose(f);
+		unlink(cert_path);
+		unlink(key_path);
+		return -1;
+	}
+	fclose(f);
+	return 0;
+}
+
 /* Versioning info ( */
 const char *janus_get_ssl_version(void) {
 	return OPENSSL_VERSION_TEXT;
@@ -396,7 +525,8 @@ const char *janus_get_ssl_version(void) {
 
 /* DTLS-SRTP initialization */
 gint janus_dtls_srtp_init(const char *server_pem, const char *server_key, const char *password,
-		const char *ciphers, guint16 timeout, gboolean rsa_private_key, gboolean accept_selfsigned) {
+		const char *ciphers, guint16 timeout, gboolean rsa_private_key, gboolean accept_selfsigned,
+		const char *cert_cache_dir) {
 	const char *crypto_lib = NULL;
 #if JANUS_USE_OPENSSL_PRE_1_1_API && !defined(HAVE_BORINGSSL)
 #if defined(LIBRESSL_VERSION_NUMBER)
@@ -446,10 +576,30 @@ gint janus_dtls_srtp_init(const char *server_pem, const char *server_key, const
 #endif
 
 	if(!server_pem && !server_key) {
-		JANUS_LOG(LOG_INFO, "No cert/key specified, autogenerating some...\n");
-		if(janus_dtls_generate_keys(&ssl_cert, &ssl_key, rsa_private_key) != 0) {
-			JANUS_LOG(LOG_FATAL, "Error generating DTLS key/certificate\n");
-			return -2;
+		/* In case a cache directory was configured, check if we autogenerated
+		 * a certificate in a previous run, and reuse it if so: this keeps the
+		 * local fingerprint stable across restarts */
+		char cert_path[512], key_path[512];
+		if(cert_cache_dir != NULL) {
+			g_snprintf(cert_path, sizeof(cert_path), "%s/janus-dtls-cert.pem", cert_cache_dir);
+			g_snprintf(key_path, sizeof(key_path), "%s/janus-dtls-cert.key", cert_cache_dir);
+			if(janus_dtls_load_cached_keys(cert_path, key_path, rsa_private_key, &ssl_cert, &ssl_key) == 0)
+				JANUS_LOG(LOG_INFO, "Reusing cached DTLS certificate from %s\n", cert_cache_dir);
+		}
+		if(ssl_cert == NULL || ssl_key == NULL) {
+			JANUS_LOG(LOG_INFO, "No cert/key specified, autogenerating some...\n");
+			if(janus_dtls_generate_keys(&ssl_cert, &ssl_key, rsa_private_key) != 0) {
+				JANUS_LOG(LOG_FATAL, "Error generating DTLS key/certificate\n");
+				return -2;
+			}
+			if(cert_cache_dir != NULL) {
+				if(g_mkdir_with_parents(cert_cache_dir, 0700) < 0) {
+					JANUS_LOG(LOG_WARN, "Error creating certificate cache directory (%s), not caching the certificate\n",
+						g_strerror(errno));
+				} else if(janus_dtls_save_cached_keys(cert_path, key_path, ssl_cert, ssl_key) == 0) {
+					JANUS_LOG(LOG_INFO, "Cached the autogenerated DTLS certificate to %s\n", cert_cache_dir);
+				}
+			}
 		}
 	} else if(!server_pem || !server_key) {
 		JANUS_LOG(LOG_FATAL, "DTLS certificate and key must be specified\n");
@@ -492,6 +642,11 @@ gint janus_dtls_srtp_init(const char *server_pem, const char *server_key, const
 		JANUS_LOG(LOG_FATAL, "Error setting cipher list (%s)\n", ERR_reason_error_string(ERR_get_error()));
 		return -8;
 	}
+	/* Enable the session cache: clients that reconnect after a network blip
+	 * and offer their previous session (ID or ticket) can then complete an
+	 * abbreviated handshake, skipping most of the asymmetric crypto */
+	SSL_CTX_set_session_cache_mode(ssl_ctx, SSL_SESS_CACHE_SERVER);
+	SSL_CTX_set_session_id_context(ssl_ctx, (const unsigned char *)"janus", 5);
 
 	if(janus_dtls_bio_agent_init() < 0) {
 		JANUS_LOG(LOG_FATAL, "Error initializing BIO agent\n");
@@ -511,6 +666,17 @@ gint janus_dtls_srtp_init(const char *server_pem, const char *server_key, const
 		return -10;
 	}
 
+	/* Create the worker pool incoming handshake messages are processed in */
+	GError *error = NULL;
+	handshake_pool = g_thread_pool_new(janus_dtls_srtp_handshake_task, NULL,
+		MAX(1, (gint)g_get_num_processors()/2), FALSE, &error);
+	if(error != NULL) {
+		JANUS_LOG(LOG_FATAL, "Got error %d (%s) trying to create the DTLS handshake pool...\n",
+			error->code, error->message ? error->message : "??");
+		g_error_free(error);
+		return -11;
+	}
+
 	/* Finally, let's set our policy with respect to DTLS self signed certificates */
 	dtls_selfsigned_certs_ok = accept_selfsigned;
 	if(!dtls_selfsigned_certs_ok) {
@@ -524,6 +690,16 @@ static void janus_dtls_srtp_free(const janus_refcount *dtls_ref) {
 	janus_dtls_srtp *dtls = janus_refcount_containerof(dtls_ref, janus_dtls_srtp, ref);
 	/* This stack can be destroyed, free all the resources */
 	dtls->pc = NULL;
+	if(dtls->handshake_msgs != NULL) {
+		janus_dtls_srtp_msg *msg = NULL;
+		while((msg = g_async_queue_try_pop(dtls->handshake_msgs)) != NULL) {
+			g_free(msg->buf);
+			g_free(msg);
+		}
+		g_async_queue_unref(dtls->handshake_msgs);
+		dtls->handshake_msgs = NULL;
+	}
+	janus_mutex_destroy(&dtls->ssl_mutex);
 	if(dtls->ssl != NULL) {
 		SSL_free(dtls->ssl);
 		dtls->ssl = NULL;
@@ -535,10 +711,12 @@ static void janus_dtls_srtp_free(const janus_refcount *dtls_ref) {
 		if(dtls->srtp_in) {
 			srtp_dealloc(dtls->srtp_in);
 			dtls->srtp_in = NULL;
+			g_atomic_int_dec_and_test(&srtp_sessions);
 		}
 		if(dtls->srtp_out) {
 			srtp_dealloc(dtls->srtp_out);
 			dtls->srtp_out = NULL;
+			g_atomic_int_dec_and_test(&srtp_sessions);
 		}
 		/* FIXME What about dtls->remote_policy and dtls->local_policy? */
 	}
@@ -547,6 +725,10 @@ static void janus_dtls_srtp_free(const janus_refcount *dtls_ref) {
 }
 
 void janus_dtls_srtp_cleanup(void) {
+	if(handshake_pool != NULL) {
+		g_thread_pool_free(handshake_pool, FALSE, TRUE);
+		handshake_pool = NULL;
+	}
 	if(ssl_cert != NULL) {
 		X509_free(ssl_cert);
 		ssl_cert = NULL;
@@ -579,6 +761,9 @@ janus_dtls_srtp *janus_dtls_srtp_create(void *ice_pc, janus_dtls_role role) {
 	janus_dtls_srtp *dtls = g_malloc0(sizeof(janus_dtls_srtp));
 	g_atomic_int_set(&dtls->destroyed, 0);
 	janus_refcount_init(&dtls->ref, janus_dtls_srtp_free);
+	janus_mutex_init(&dtls->ssl_mutex);
+	dtls->handshake_msgs = g_async_queue_new();
+	g_atomic_int_set(&dtls->processing, 0);
 	/* Create SSL context, at last */
 	dtls->srtp_valid = 0;
 	dtls->ssl = SSL_new(ssl_ctx);
@@ -644,9 +829,10 @@ janus_dtls_srtp *janus_dtls_srtp_create(void *ice_pc, janus_dtls_role role) {
 	return dtls;
 }
 
-void janus_dtls_srtp_handshake(janus_dtls_srtp *dtls) {
+static void janus_dtls_srtp_handshake_internal(janus_dtls_srtp *dtls) {
 	if(dtls == NULL || dtls->ssl == NULL)
 		return;
+	janus_mutex_lock(&dtls->ssl_mutex);
 	if(dtls->dtls_state == JANUS_DTLS_STATE_CREATED) {
 		/* Starting the handshake now: enforce the role */
 		dtls->dtls_started = janus_get_monotonic_time();
@@ -658,11 +844,90 @@ void janus_dtls_srtp_handshake(janus_dtls_srtp *dtls) {
 		dtls->dtls_state = JANUS_DTLS_STATE_TRYING;
 	}
 	SSL_do_handshake(dtls->ssl);
+	janus_mutex_unlock(&dtls->ssl_mutex);
 
 	/* Notify event handlers */
 	janus_dtls_notify_state_change(dtls);
 }
 
+static void janus_dtls_srtp_process_msg(janus_dtls_srtp *dtls, char *buf, uint16_t len);
+
+/* Helper to queue a message (or a handshake kickstart, if buf is NULL) for
+ * the worker pool, making sure a single task works on a stack at a time */
+static void janus_dtls_srtp_enqueue(janus_dtls_srtp *dtls, char *buf, uint16_t len) {
+	janus_dtls_srtp_msg *msg = g_malloc(sizeof(janus_dtls_srtp_msg));
+	if(buf != NULL) {
+		msg->buf = g_malloc(len);
+		memcpy(msg->buf, buf, len);
+	} else {
+		msg->buf = NULL;
+	}
+	msg->len = len;
+	g_async_queue_push(dtls->handshake_msgs, msg);
+	if(g_atomic_int_compare_and_exchange(&dtls->processing, 0, 1)) {
+		/* No task is working on this stack yet, schedule one */
+		janus_refcount_increase(&dtls->ref);
+		GError *error = NULL;
+		g_thread_pool_push(handshake_pool, dtls, &error);
+		if(error != NULL) {
+			JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to schedule a DTLS task, processing synchronously...\n",
+				error->code, error->message ? error->message : "??");
+			g_error_free(error);
+			g_atomic_int_set(&dtls->processing, 0);
+			janus_refcount_decrease(&dtls->ref);
+			/* Process what we have queued inline, as a fallback */
+			while((msg = g_async_queue_try_pop(dtls->handshake_msgs)) != NULL) {
+				if(msg->buf == NULL)
+					janus_dtls_srtp_handshake_internal(dtls);
+				else
+					janus_dtls_srtp_process_msg(dtls, msg->buf, msg->len);
+				g_free(msg->buf);
+				g_free(msg);
+			}
+		}
+	}
+}
+
+static void janus_dtls_srtp_handshake_task(gpointer data, gpointer user_data) {
+	janus_dtls_srtp *dtls = (janus_dtls_srtp *)data;
+	janus_dtls_srtp_msg *msg = NULL;
+	while((msg = g_async_queue_try_pop(dtls->handshake_msgs)) != NULL) {
+		if(!g_atomic_int_get(&dtls->destroyed)) {
+			if(msg->buf == NULL) {
+				/* Not a message, we just need to (re)start the handshake */
+				janus_dtls_srtp_handshake_internal(dtls);
+			} else {
+				janus_dtls_srtp_process_msg(dtls, msg->buf, msg->len);
+			}
+		}
+		g_free(msg->buf);
+		g_free(msg);
+	}
+	/* Done: let other tasks work on this stack, but make sure we don't
+	 * leave anything that was queued in the meanwhile stranded */
+	g_atomic_int_set(&dtls->processing, 0);
+	if(g_async_queue_length(dtls->handshake_msgs) > 0 &&
+			g_atomic_int_compare_and_exchange(&dtls->processing, 0, 1)) {
+		janus_refcount_increase(&dtls->ref);
+		GError *error = NULL;
+		g_thread_pool_push(handshake_pool, dtls, &error);
+		if(error != NULL) {
+			JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to reschedule the DTLS task...\n",
+				error->code, error->message ? error->message : "??");
+			g_error_free(error);
+			g_atomic_int_set(&dtls->processing, 0);
+			janus_refcount_decrease(&dtls->ref);
+		}
+	}
+	janus_refcount_decrease(&dtls->ref);
+}
+
+void janus_dtls_srtp_handshake(janus_dtls_srtp *dtls) {
+	if(dtls == NULL || dtls->ssl == NULL)
+		return;
+	janus_dtls_srtp_enqueue(dtls, NULL, 0);
+}
+
 int janus_dtls_srtp_create_sctp(janus_dtls_srtp *dtls) {
 #ifdef HAVE_SCTP
 	if(dtls == NULL)
@@ -692,6 +957,13 @@ void janus_dtls_srtp_incoming_msg(janus_dtls_srtp *dtls, char *buf, uint16_t len
 		JANUS_LOG(LOG_ERR, "No DTLS-SRTP stack, no incoming message...\n");
 		return;
 	}
+	if(buf == NULL || len == 0)
+		return;
+	/* Copy the message and defer the processing to the worker pool */
+	janus_dtls_srtp_enqueue(dtls, buf, len);
+}
+
+static void janus_dtls_srtp_process_msg(janus_dtls_srtp *dtls, char *buf, uint16_t len) {
 	janus_ice_peerconnection *pc = (janus_ice_peerconnection *)dtls->pc;
 	if(pc == NULL) {
 		JANUS_LOG(LOG_ERR, "No WebRTC PeerConnection, no DTLS...\n");
@@ -714,6 +986,7 @@ void janus_dtls_srtp_incoming_msg(janus_dtls_srtp *dtls, char *buf, uint16_t len
 		/* Handshake not started yet: maybe we're still waiting for the answer and the DTLS role? */
 		return;
 	}
+	janus_mutex_lock(&dtls->ssl_mutex);
 	int written = BIO_write(dtls->read_bio, buf, len);
 	if(written != len) {
 		JANUS_LOG(LOG_WARN, "[%"SCNu64"]     Only written %d/%d of those bytes on the read BIO...\n", handle->handle_id, written, len);
@@ -731,17 +1004,20 @@ void janus_dtls_srtp_incoming_msg(janus_dtls_srtp *dtls, char *buf, uint16_t len
 			char error[200];
 			ERR_error_string_n(ERR_get_error(), error, 200);
 			JANUS_LOG(LOG_ERR, "[%"SCNu64"] Handshake error: %s\n", handle->handle_id, error);
+			janus_mutex_unlock(&dtls->ssl_mutex);
 			return;
 		}
 	}
 	if(janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_STOP) || janus_is_stopping()) {
 		/* DTLS alert triggered, we should end it here */
 		JANUS_LOG(LOG_VERB, "[%"SCNu64"] Forced to stop it here...\n", handle->handle_id);
+		janus_mutex_unlock(&dtls->ssl_mutex);
 		return;
 	}
 	if(!SSL_is_init_finished(dtls->ssl)) {
 		/* Nothing else to do for now */
 		JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Initialization not finished yet...\n", handle->handle_id);
+		janus_mutex_unlock(&dtls->ssl_mutex);
 		return;
 	}
 	if(dtls->ready) {
@@ -893,7 +1169,7 @@ void janus_dtls_srtp_incoming_msg(janus_dtls_srtp *dtls, char *buf, uint16_t len
 				memcpy(dtls->remote_policy.key, remote_key, key_length);
 				memcpy(dtls->remote_policy.key + key_length, remote_salt, salt_length);
 #if HAS_DTLS_WINDOW_SIZE
-				dtls->remote_policy.window_size = 128;
+				dtls->remote_policy.window_size = srtp_replay_window;
 				dtls->remote_policy.allow_repeat_tx = 0;
 #endif
 				dtls->remote_policy.next = NULL;
@@ -928,7 +1204,7 @@ void janus_dtls_srtp_incoming_msg(janus_dtls_srtp *dtls, char *buf, uint16_t len
 				memcpy(dtls->local_policy.key, local_key, key_length);
 				memcpy(dtls->local_policy.key + key_length, local_salt, salt_length);
 #if HAS_DTLS_WINDOW_SIZE
-				dtls->local_policy.window_size = 128;
+				dtls->local_policy.window_size = srtp_replay_window;
 				dtls->local_policy.allow_repeat_tx = 0;
 #endif
 				dtls->local_policy.next = NULL;
@@ -940,6 +1216,7 @@ void janus_dtls_srtp_incoming_msg(janus_dtls_srtp *dtls, char *buf, uint16_t len
 					JANUS_LOG(LOG_ERR, "[%"SCNu64"]  -- %d (%s)\n", handle->handle_id, res, janus_srtp_error_str(res));
 					goto done;
 				}
+				g_atomic_int_inc(&srtp_sessions);
 				JANUS_LOG(LOG_VERB, "[%"SCNu64"] Created inbound SRTP session for component %d in stream %d\n", handle->handle_id, pc->component_id, pc->stream_id);
 				res = srtp_create(&(dtls->srtp_out), &(dtls->local_policy));
 				if(res != srtp_err_status_ok) {
@@ -948,6 +1225,7 @@ void janus_dtls_srtp_incoming_msg(janus_dtls_srtp *dtls, char *buf, uint16_t len
 					JANUS_LOG(LOG_ERR, "[%"SCNu64"]  -- %d (%s)\n", handle->handle_id, res, janus_srtp_error_str(res));
 					goto done;
 				}
+				g_atomic_int_inc(&srtp_sessions);
 				dtls->srtp_profile = srtp_profile->id;
 				dtls->srtp_valid = 1;
 				JANUS_LOG(LOG_VERB, "[%"SCNu64"] Created outbound SRTP session for component %d in stream %d\n", handle->handle_id, pc->component_id, pc->stream_id);
@@ -970,6 +1248,7 @@ done:
 			}
 		}
 	}
+	janus_mutex_unlock(&dtls->ssl_mutex);
 }
 
 void janus_dtls_srtp_send_alert(janus_dtls_srtp *dtls) {
@@ -978,7 +1257,9 @@ void janus_dtls_srtp_send_alert(janus_dtls_srtp *dtls) {
 	/* Send alert */
 	janus_refcount_increase(&dtls->ref);
 	if(dtls != NULL && dtls->ssl != NULL) {
+		janus_mutex_lock(&dtls->ssl_mutex);
 		SSL_shutdown(dtls->ssl);
+		janus_mutex_unlock(&dtls->ssl_mutex);
 	}
 	janus_refcount_decrease(&dtls->ref);
 }
@@ -1069,11 +1350,13 @@ void janus_dtls_wrap_sctp_data(janus_dtls_srtp *dtls, char *label, char *protoco
 int janus_dtls_send_sctp_data(janus_dtls_srtp *dtls, char *buf, int len) {
 	if(dtls == NULL || !dtls->ready || buf == NULL || len < 1)
 		return -1;
+	janus_mutex_lock(&dtls->ssl_mutex);
 	int res = SSL_write(dtls->ssl, buf, len);
 	if(res <= 0) {
 		unsigned long err = SSL_get_error(dtls->ssl, res);
 		JANUS_LOG(LOG_ERR, "Error sending data: %s\n", ERR_reason_error_string(err));
 	}
+	janus_mutex_unlock(&dtls->ssl_mutex);
 	return res;
 }
 
@@ -1110,6 +1393,10 @@ gboolean janus_dtls_retry(gpointer stack) {
 		JANUS_LOG(LOG_VERB, "[%"SCNu64"] DTLS already set up, disabling retransmission timer!\n", handle->handle_id);
 		goto stoptimer;
 	}
+	if(dtls->dtls_started == 0) {
+		/* The worker pool hasn't actually started the handshake yet */
+		return TRUE;
+	}
 	if(janus_get_monotonic_time() - dtls->dtls_started >= 20*G_USEC_PER_SEC) {
 		/* FIXME Should we really give up after 20 seconds waiting for DTLS? */
 		JANUS_LOG(LOG_ERR, "[%"SCNu64"] DTLS taking too much time for component %d in stream %d...\n",
@@ -1118,8 +1405,10 @@ gboolean janus_dtls_retry(gpointer stack) {
 		goto stoptimer;
 	}
 	struct timeval timeout = {0};
+	janus_mutex_lock(&dtls->ssl_mutex);
 	if(DTLSv1_get_timeout(dtls->ssl, &timeout) == 0) {
 		/* failed to get timeout. try again on next iter */
+		janus_mutex_unlock(&dtls->ssl_mutex);
 		return TRUE;
 	}
 	guint64 timeout_value = timeout.tv_sec*1000 + timeout.tv_usec/1000;
@@ -1134,11 +1423,13 @@ gboolean janus_dtls_retry(gpointer stack) {
 		if(res == -1 && SSL_get_error(dtls->ssl, res) != SSL_ERROR_WANT_WRITE) {
 			/* DTLSv1_handle_timeout returned an unrecoverable error, fail right away
 			 * Ref.: https://webrtc-review.googlesource.com/c/src/+/260100 */
+			janus_mutex_unlock(&dtls->ssl_mutex);
 			JANUS_LOG(LOG_ERR, "[%"SCNu64"] DTLSv1_handle_timeout failed...\n", handle->handle_id);
 			janus_ice_webrtc_hangup(handle, "DTLS error");
 			goto stoptimer;
 		}
 	}
+	janus_mutex_unlock(&dtls->ssl_mutex);
 	return TRUE;
 
 stoptimer:
@@ -21,6 +21,7 @@
 #include "rtp.h"
 #include "rtpsrtp.h"
 #include "sctp.h"
+#include "mutex.h"
 #include "refcount.h"
 #include "dtls-bio.h"
 
@@ -36,15 +37,30 @@ const char *janus_get_ssl_version(void);
  * @param[in] timeout DTLS timeout base, in ms, to use for retransmissions (ignored if not using BoringSSL)
  * @param[in] rsa_private_key Whether RSA certificates should be generated, instead of NIST P-256
  * @param[in] accept_selfsigned Whether to accept self-signed certificates (default) or enforce validation
+ * @param[in] cert_cache_dir Directory to cache autogenerated certificates in, so that they
+ * (and so the local fingerprint) can be reused across restarts (ignored if NULL, or if a
+ * certificate was configured explicitly)
  * @returns 0 in case of success, a negative integer on errors */
 gint janus_dtls_srtp_init(const char *server_pem, const char *server_key, const char *password,
-	const char *ciphers, guint16 timeout, gboolean rsa_private_key, gboolean accept_selfsigned);
+	const char *ciphers, guint16 timeout, gboolean rsa_private_key, gboolean accept_selfsigned,
+	const char *cert_cache_dir);
 /*! \brief Method to cleanup DTLS stuff before exiting */
 void janus_dtls_srtp_cleanup(void);
 /*! \brief Method to return a string representation (SHA-256) of the certificate fingerprint */
 gchar *janus_dtls_get_local_fingerprint(void);
 /*! \brief Method to check whether DTLS self-signed certificates are ok (default) or not */
 gboolean janus_dtls_are_selfsigned_certs_ok(void);
+/*! \brief Method to modify the SRTP replay-protection window to use when creating
+ * SRTP sessions (default=128 packets; only effective if libsrtp supports it)
+ * @param[in] window_size The window size to use, in packets (64-32768) */
+void janus_dtls_set_srtp_replay_window(guint window_size);
+/*! \brief Method to get the SRTP replay-protection window currently in use
+ * @returns The window size, in packets */
+guint janus_dtls_get_srtp_replay_window(void);
+/*! \brief Method to get the number of SRTP sessions (crypto contexts) the core
+ * has currently allocated, e.g., to keep an eye on their memory footprint
+ * @returns The number of active SRTP sessions */
+gint janus_dtls_get_srtp_session_count(void);
 
 
 /*! \brief DTLS roles */
@@ -96,6 +112,13 @@ typedef struct janus_dtls_srtp {
 	int ready;
 	/*! \brief The number of retransmissions that have occurred for this DTLS instance so far */
 	int retransmissions;
+	/*! \brief Queue of incoming messages waiting to be processed by the handshake worker pool */
+	GAsyncQueue *handshake_msgs;
+	/*! \brief Whether a worker pool task is currently processing this stack */
+	volatile gint processing;
+	/*! \brief Mutex to serialize access to the SSL stack, since handshake messages
+	 * are processed by a worker pool rather than by the handle loop */
+	janus_mutex ssl_mutex;
 #ifdef HAVE_SCTP
 	/*! \brief SCTP association, if DataChannels are involved */
 	janus_sctp_association *sctp;
@@ -113,6 +136,8 @@ typedef struct janus_dtls_srtp {
  * @returns A new janus_dtls_srtp instance if successful, NULL otherwise */
 janus_dtls_srtp *janus_dtls_srtp_create(void *pc, janus_dtls_role role);
 /*! \brief Start a DTLS handshake
+ * \note The handshake is actually started by a dedicated worker pool, so
+ * that the expensive asymmetric crypto never runs on the handle loops
  * @param[in] dtls The janus_dtls_srtp instance to start the handshake on */
 void janus_dtls_srtp_handshake(janus_dtls_srtp *dtls);
 /*! \brief Create an SCTP association, for data channels
@@ -123,6 +148,8 @@ void janus_dtls_srtp_handshake(janus_dtls_srtp *dtls);
  * @returns 0 in case of success, a negative integer otherwise */
 int janus_dtls_srtp_create_sctp(janus_dtls_srtp *dtls);
 /*! \brief Handle an incoming DTLS message
+ * \note The message is copied and queued for the worker pool: processing
+ * happens asynchronously, in the order messages were received
  * @param[in] dtls The janus_dtls_srtp instance to start the handshake on
  * @param[in] buf The DTLS message data
  * @param[in] len The DTLS message data length */
@@ -34,33 +34,66 @@ static struct janus_event_types {
 };
 
 static gboolean eventsenabled = FALSE;
+static int batching_window = 0;
 static char *server = NULL;
+static json_t *server_json = NULL;	/* Shared immortal string, added to every event as the emitter */
 static GHashTable *eventhandlers = NULL;
 
-static GAsyncQueue *events = NULL;
 static json_t exit_event;
 
-static GThread *events_thread;
-void *janus_events_thread(void *data);
+/* Maximum number of events we queue for a single handler: should a
+ * handler be too slow to keep up with the rate of new events, we start
+ * dropping the oldest queued events, rather than backpressuring the
+ * other handlers or letting the queue grow indefinitely */
+#define JANUS_EVENTS_QUEUE_MAXLEN	2048
 
-int janus_events_init(gboolean enabled, char *server_name, GHashTable *handlers) {
+/*! \brief Per-handler event dispatcher: each event handler gets its own
+ * bounded queue and delivery thread, so that a slow handler can only
+ * delay (or drop) its own events, and not those of other handlers */
+typedef struct janus_events_dispatcher {
+	janus_eventhandler *handler;	/* Event handler plugin this dispatcher feeds */
+	GAsyncQueue *queue;				/* Bounded queue of events for this handler */
+	GThread *thread;				/* Thread delivering the queued events to the handler */
+	guint64 dropped;				/* Number of events we had to drop because the handler couldn't keep up */
+} janus_events_dispatcher;
+static GList *dispatchers = NULL;
+static void *janus_events_dispatcher_thread(void *data);
+
+int janus_events_init(gboolean enabled, int batching, char *server_name, GHashTable *handlers) {
 	eventsenabled = enabled;
 	if(eventsenabled) {
-		events = g_async_queue_new();
-		if(server_name != NULL)
+		batching_window = batching > 0 ? batching : 0;
+		if(server_name != NULL) {
 			server = g_strdup(server_name);
+			server_json = janus_json_immortal_string(server);
+		}
 		eventhandlers = handlers;
-		/* We setup a thread for passing events to the handlers */
-		GError *error = NULL;
-		events_thread = g_thread_try_new("janus events thread", janus_events_thread, NULL, &error);
-		if(error != NULL) {
-			eventsenabled = FALSE;
-			g_free(server);
-			g_async_queue_unref(events);
-			JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the Events handler thread...\n",
-				error->code, error->message ? error->message : "??");
-			g_error_free(error);
-			return -1;
+		/* We setup a dedicated dispatcher (queue + thread) for each handler */
+		GHashTableIter iter;
+		gpointer value;
+		g_hash_table_iter_init(&iter, eventhandlers);
+		while(g_hash_table_iter_next(&iter, NULL, &value)) {
+			janus_eventhandler *e = value;
+			if(e == NULL)
+				continue;
+			janus_events_dispatcher *ed = g_malloc0(sizeof(janus_events_dispatcher));
+			ed->handler = e;
+			ed->queue = g_async_queue_new();
+			const char *package = e->get_package(), *shortname = strrchr(package, '.');
+			char tname[16];
+			g_snprintf(tname, sizeof(tname), "evh %s", shortname ? shortname+1 : package);
+			GError *error = NULL;
+			ed->thread = g_thread_try_new(tname, janus_events_dispatcher_thread, ed, &error);
+			if(error != NULL) {
+				JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the events dispatcher thread for '%s'...\n",
+					error->code, error->message ? error->message : "??", e->get_package());
+				g_error_free(error);
+				g_async_queue_unref(ed->queue);
+				g_free(ed);
+				janus_events_deinit();
+				return -1;
+			}
+			dispatchers = g_list_prepend(dispatchers, ed);
 		}
 	}
 	return 0;
@@ -68,15 +101,23 @@ int janus_events_init(gboolean enabled, char *server_name, GHashTable *handlers)
 
 void janus_events_deinit(void) {
 	eventsenabled = FALSE;
-	if(events != NULL) {
-		g_async_queue_push(events, &exit_event);
+	/* Wake all the dispatcher threads up, and wait for them to leave */
+	GList *temp = dispatchers;
+	while(temp) {
+		janus_events_dispatcher *ed = (janus_events_dispatcher *)temp->data;
+		g_async_queue_push(ed->queue, &exit_event);
+		temp = temp->next;
 	}
-	if(events_thread != NULL) {
-		g_thread_join(events_thread);
-		events_thread = NULL;
+	temp = dispatchers;
+	while(temp) {
+		janus_events_dispatcher *ed = (janus_events_dispatcher *)temp->data;
+		g_thread_join(ed->thread);
+		g_async_queue_unref(ed->queue);
+		g_free(ed);
+		temp = temp->next;
 	}
-	if(events != NULL)
-		g_async_queue_unref(events);
+	g_list_free(dispatchers);
+	dispatchers = NULL;
 	g_free(server);
 }
 
@@ -84,13 +125,47 @@ gboolean janus_events_is_enabled(void) {
 	return eventsenabled;
 }
 
+/* Helper to enqueue an event on a dispatcher queue, enforcing the bound:
+ * if the handler is falling behind, we drop the oldest queued event */
+static void janus_events_dispatcher_push(janus_events_dispatcher *ed, json_t *event) {
+	g_async_queue_lock(ed->queue);
+	if(g_async_queue_length_unlocked(ed->queue) >= JANUS_EVENTS_QUEUE_MAXLEN) {
+		json_t *old = g_async_queue_try_pop_unlocked(ed->queue);
+		if(old == &exit_event) {
+			/* We're shutting down, put the marker back */
+			g_async_queue_push_unlocked(ed->queue, old);
+		} else if(old != NULL) {
+			json_decref(old);
+			ed->dropped++;
+			if(ed->dropped == 1 || ed->dropped % 1000 == 0) {
+				JANUS_LOG(LOG_WARN, "Event handler '%s' is not keeping up, dropped %"SCNu64" events so far\n",
+					ed->handler->get_package(), ed->dropped);
+			}
+		}
+	}
+	g_async_queue_push_unlocked(ed->queue, event);
+	g_async_queue_unlock(ed->queue);
+}
+
 void janus_events_notify_handlers(int type, int subtype, guint64 session_id, ...) {
 	/* This method has a variable list of arguments, depending on the event type */
 	va_list args;
 	va_start(args, session_id);
 
-	if(!eventsenabled || eventhandlers == NULL || g_hash_table_size(eventhandlers) == 0) {
-		/* Event handlers disabled, or no event handler plugins available: free resources, if needed */
+	/* Check how many handlers are actually interested in this event type:
+	 * if none is, we don't even need to allocate the event object */
+	int interested = 0;
+	if(eventsenabled) {
+		GList *temp = dispatchers;
+		while(temp) {
+			janus_events_dispatcher *ed = (janus_events_dispatcher *)temp->data;
+			if(janus_flags_is_set(&ed->handler->events_mask, type))
+				interested++;
+			temp = temp->next;
+		}
+	}
+	if(interested == 0) {
+		/* Event handlers disabled, or no event handler plugin interested in this event: free resources, if needed */
 		if(type == JANUS_EVENT_TYPE_MEDIA || type == JANUS_EVENT_TYPE_WEBRTC) {
 			/* These events allocate a json_t object for their data, skip some arguments and unref it */
 			va_arg(args, guint64);
@@ -132,8 +207,8 @@ void janus_events_notify_handlers(int type, int subtype, guint64 session_id, ...
 
 	/* Prepare the event to notify as a Jansson json_t object */
 	json_t *event = json_object();
-	if(server != NULL)
-		json_object_set_new(event, "emitter", json_string(server));
+	if(server_json != NULL)
+		json_object_set(event, "emitter", server_json);
 	json_object_set_new(event, "type", json_integer(type));
 	if(subtype > 0)
 		json_object_set_new(event, "subtype", json_integer(subtype));
@@ -270,56 +345,90 @@ void janus_events_notify_handlers(int type, int subtype, guint64 session_id, ...
 		json_decref(event);
 		return;
 	}
-	/* Enqueue the event */
-	g_async_queue_push(events, event);
+	/* Enqueue the event on the dispatchers of all interested handlers:
+	 * handlers may modify the events they receive, so when more than one
+	 * is interested each gets its own copy, and the last one gets the
+	 * original instance */
+	GList *temp = dispatchers;
+	while(temp) {
+		janus_events_dispatcher *ed = (janus_events_dispatcher *)temp->data;
+		if(!janus_flags_is_set(&ed->handler->events_mask, type)) {
+			temp = temp->next;
+			continue;
+		}
+		if(interested > 1) {
+			janus_events_dispatcher_push(ed, json_deep_copy(event));
+			interested--;
+		} else {
+			janus_events_dispatcher_push(ed, event);
+			event = NULL;
+			break;
+		}
+		temp = temp->next;
+	}
+	if(event != NULL) {
+		/* The masks changed while we were preparing the event */
+		json_decref(event);
+	}
 }
 
-void *janus_events_thread(void *data) {
-	JANUS_LOG(LOG_VERB, "Joining Events handler thread\n");
+static void *janus_events_dispatcher_thread(void *data) {
+	janus_events_dispatcher *ed = (janus_events_dispatcher *)data;
+	JANUS_LOG(LOG_VERB, "Joining events dispatcher thread for '%s'\n", ed->handler->get_package());
 	json_t *event = NULL;
+	/* If this handler supports batched delivery and batching is enabled,
+	 * we accumulate events for the duration of the batching window and
+	 * deliver them all in one call, rather than one by one */
+	gboolean batching = (ed->handler->incoming_events != NULL && batching_window > 0);
 
 	while(eventsenabled) {
 		/* Any event in queue? */
-		event = g_async_queue_pop(events);
+		event = g_async_queue_pop(ed->queue);
 		if(event == &exit_event)
 			break;
 
-		/* Notify all interested handlers, increasing the event reference to make sure it's not lost because of errors */
-		int type = json_integer_value(json_object_get(event, "type"));
-		guint count = g_hash_table_size(eventhandlers);
-		GHashTableIter iter;
-		gpointer value;
-		g_hash_table_iter_init(&iter, eventhandlers);
-		json_incref(event);
-		while(g_hash_table_iter_next(&iter, NULL, &value)) {
-			janus_eventhandler *e = value;
-			if(e == NULL)
-				continue;
-			if(!janus_flags_is_set(&e->events_mask, type))
-				continue;
-			if(count == 1) {
-				/* Single event handler: pass this instance directly */
-				e->incoming_event(event);
-			} else {
-				/* Multiple event handlers, that may modify the event: pass a copy */
-				json_t *copy = json_deep_copy(event);
-				e->incoming_event(copy);
-				json_decref(copy);
+		if(!batching) {
+			/* Pass the event to the handler, which will have its own reference if it needs one */
+			ed->handler->incoming_event(event);
+			json_decref(event);
+			continue;
+		}
+		/* Keep accumulating events until the batching window expires */
+		json_t *batch = json_array();
+		json_array_append_new(batch, event);
+		gboolean stop = FALSE;
+		gint64 deadline = janus_get_monotonic_time() + ((gint64)batching_window)*1000, timeout = 0;
+		while((timeout = deadline - janus_get_monotonic_time()) > 0) {
+			event = g_async_queue_timeout_pop(ed->queue, timeout);
+			if(event == NULL)
+				break;
+			if(event == &exit_event) {
+				stop = TRUE;
+				break;
 			}
+			json_array_append_new(batch, event);
 		}
-		json_decref(event);
-
-		/* Unref the final event reference, interested handlers will have their own reference */
-		json_decref(event);
+		/* Serialize the batch once, and pass both views to the handler */
+		char *body = json_dumps(batch, JSON_COMPACT | JSON_PRESERVE_ORDER);
+		if(body != NULL) {
+			ed->handler->incoming_events(batch, body);
+			free(body);
+		} else {
+			JANUS_LOG(LOG_WARN, "Failed to stringify batch of events for '%s', %zu events lost...\n",
+				ed->handler->get_package(), json_array_size(batch));
+		}
+		json_decref(batch);
+		if(stop)
+			break;
 	}
 
 	/* Cleanup pending events */
-	while((event = g_async_queue_try_pop(events)) != NULL) {
+	while((event = g_async_queue_try_pop(ed->queue)) != NULL) {
 		if(event != &exit_event)
 			json_decref(event);
 	}
 
-	JANUS_LOG(LOG_VERB, "Leaving Events handler thread\n");
+	JANUS_LOG(LOG_VERB, "Leaving events dispatcher thread for '%s'\n", ed->handler->get_package());
 	return NULL;
 }
 
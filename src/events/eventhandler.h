@@ -61,6 +61,13 @@ janus_eventhandler *create(void) {
  * reject an event handler plugin that doesn't implement any of the
  * mandatory callbacks.
  *
+ * An event handler plugin may also optionally implement \c incoming_events():
+ * when it does, and event batching is enabled in the core configuration,
+ * events are accumulated for the duration of the batching window and
+ * delivered in a single call as a JSON array, together with a shared
+ * serialization of that array, which allows the handler to relay many
+ * events with a single POST/publish and without serializing them itself.
+ *
  * Additionally, a \c janus_eventhandler instance must also include a
  * mask of the events it is interested in, a \c events_mask janus_flag
  * object that must refer to the available types defined in this header.
@@ -101,7 +108,7 @@ janus_eventhandler *create(void) {
 
 
 /*! \brief Version of the API, to match the one event handler plugins were compiled against */
-#define JANUS_EVENTHANDLER_API_VERSION	3
+#define JANUS_EVENTHANDLER_API_VERSION	4
 
 /*! \brief Initialization of all event handler plugin properties to NULL
  *
@@ -171,6 +178,12 @@ static janus_eventhandler janus_fake_eventhandler_plugin =
 #define JANUS_EVENT_SUBTYPE_CORE_STARTUP	1
 /*! \brief Core event subtypes: shutdown */
 #define JANUS_EVENT_SUBTYPE_CORE_SHUTDOWN	2
+/*! \brief Core event subtypes: recording closed */
+#define JANUS_EVENT_SUBTYPE_CORE_RECORDING	3
+/*! \brief Core event subtypes: rate limit violation */
+#define JANUS_EVENT_SUBTYPE_CORE_RATELIMIT	4
+/*! \brief Core event subtypes: periodic state snapshot */
+#define JANUS_EVENT_SUBTYPE_CORE_SNAPSHOT	5
 /*! \brief WebRTC event subtypes: ICE state */
 #define JANUS_EVENT_SUBTYPE_WEBRTC_ICE		1
 /*! \brief WebRTC event subtypes: local candidate */
@@ -202,6 +215,7 @@ static janus_eventhandler janus_fake_eventhandler_plugin =
 		.get_author = NULL,						\
 		.get_package = NULL,					\
 		.incoming_event = NULL,					\
+		.incoming_events = NULL,				\
 		.events_mask = JANUS_EVENT_TYPE_NONE,	\
 		## __VA_ARGS__ }
 
@@ -256,6 +270,21 @@ struct janus_eventhandler {
 	 * object once you're done with it: a failure to do so will result in memory leaks.
 	 * @param[in] event Jansson object containing the event details */
 	void (* const incoming_event)(json_t *event);
+	/*! \brief Method to notify the event handler plugin that a batch of events is available
+	 * \details Batched variant of \c incoming_event : this method is optional, but
+	 * when a handler implements it, and event batching is enabled in the core
+	 * configuration, events are accumulated for the duration of the batching
+	 * window and delivered all at once as a Jansson array, along with a shared
+	 * compact serialization of that array, which the handler can use as it is
+	 * (e.g., to relay the whole batch with a single HTTP POST or publish)
+	 * instead of serializing every event itself.
+	 * \note Just as with \c incoming_event , do NOT handle the events directly
+	 * in this method. Besides, both the array and the serialized string are
+	 * owned by the core: reference the array, or copy the string, in case you
+	 * need either of them past this call.
+	 * @param[in] events Jansson array containing one or more events
+	 * @param[in] body The events array, already serialized as compact JSON */
+	void (* const incoming_events)(json_t *events, const char *body);
 
 	/*! \brief Method to send a request to this specific event handler plugin
 	 * \details The method takes a Jansson json_t, that contains all the info related
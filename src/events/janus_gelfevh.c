@@ -86,6 +86,7 @@ janus_eventhandler *create(void) {
 /* Compression, if any */
 static gboolean compress = FALSE;
 static int compression = 6; /* Z_DEFAULT_COMPRESSION */
+static janus_gzip_context *zctx = NULL;	/* Reusable deflate state (handler thread only) */
 
 /* Useful stuff */
 static volatile gint initialized = 0, stopping = 0;
@@ -98,6 +99,7 @@ static size_t json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
 
 /* Queue of events to handle */
 static GAsyncQueue *events = NULL;
+static volatile gint events_cap = 0, dropped = 0;
 static json_t exit_event;
 static void janus_gelfevh_event_free(json_t *event) {
 	if(!event || event == &exit_event)
@@ -127,7 +129,8 @@ static struct janus_json_parameter tweak_parameters[] = {
 	{"backend", JSON_STRING, 0},
 	{"port", JSON_STRING, 0},
 	{"max_gelf_msg_len", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
-	{"janus_gelfevh_socket_type", JSON_STRING, 0}
+	{"janus_gelfevh_socket_type", JSON_STRING, 0},
+	{"events_cap", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE}
 };
 /* Error codes (for the tweaking via Admin API */
 #define JANUS_GELFEVH_ERROR_INVALID_REQUEST		411
@@ -187,6 +190,13 @@ static int janus_gelfevh_connect(void) {
 		g_free(host);
 		return -1;
 	}
+	if(transport == JANUS_GELFEVH_SOCKET_TYPE_TCP) {
+		/* Enable TCP keepalives, so that a dead backend connection is
+		 * detected even when there are no events to deliver */
+		int opt = 1;
+		if(setsockopt(sockfd, SOL_SOCKET, SO_KEEPALIVE, &opt, sizeof(opt)) < 0)
+			JANUS_LOG(LOG_WARN, "Error enabling TCP keepalive: %d (%s)\n", errno, g_strerror(errno));
+	}
 	JANUS_LOG(LOG_INFO, "Connected to GELF backend: [%s:%s]\n", host, port);
 	g_free(host);
 	return 0;
@@ -208,6 +218,9 @@ static int janus_gelfevh_send(char *message) {
 			if(out_bytes <= 0) {
 				JANUS_LOG(LOG_WARN, "Sending TCP message failed, dropping event: %d (%s)\n", errno, g_strerror(errno));
 				close(sockfd);
+				/* Try to re-establish the connection right away, for the next event */
+				if(janus_gelfevh_connect() < 0)
+					JANUS_LOG(LOG_WARN, "Couldn't reconnect to GELF backend, will retry with the next event\n");
 				return -1;
 			}
 			buffer += out_bytes;
@@ -218,10 +231,21 @@ static int janus_gelfevh_send(char *message) {
 		int len = strlen(message);
 		char *buf = message;
 		if(compress) {
+			/* Lazily create a reusable deflate context: we're the only thread
+			 * compressing, and reusing the state is much cheaper than setting
+			 * up and tearing down a new one for each event */
+			if(zctx == NULL)
+				zctx = janus_gzip_context_create(compression);
 			size_t compressed_len = 0;
-			compressed_len = janus_gzip_compress(compression,
-				message, strlen(message),
-				compressed_text, sizeof(compressed_text));
+			if(zctx != NULL) {
+				compressed_len = janus_gzip_context_compress(zctx, compression,
+					message, strlen(message),
+					compressed_text, sizeof(compressed_text));
+			} else {
+				compressed_len = janus_gzip_compress(compression,
+					message, strlen(message),
+					compressed_text, sizeof(compressed_text));
+			}
 			if(compressed_len == 0) {
 				JANUS_LOG(LOG_WARN, "Failed to compress event (%zu bytes), sending message uncompressed\n", strlen(message));
 				/* Sending message uncompressed */
@@ -365,6 +389,12 @@ int janus_gelfevh_init(const char *config_path) {
 				}
 			}
 		}
+		/* Do we need to cap the number of queued events? */
+		item = janus_config_get(config, config_general, janus_config_type_item, "events_cap");
+		if(item && item->value)
+			events_cap = atoi(item->value);
+		if(events_cap < 0)
+			events_cap = 0;
 		/* Done */
 		enabled = TRUE;
 	}
@@ -416,6 +446,9 @@ void janus_gelfevh_destroy(void) {
 	g_async_queue_unref(events);
 	events = NULL;
 
+	janus_gzip_context_destroy(zctx);
+	zctx = NULL;
+
 	g_free(backend);
 
 	g_atomic_int_set(&initialized, 0);
@@ -469,6 +502,21 @@ void janus_gelfevh_incoming_event(json_t *event) {
 	 * when the event actually happened on this machine, so that, if relevant, we can compute
 	 * any delay in the actual event processing ourselves. */
 	json_incref(event);
+	guint cap = g_atomic_int_get(&events_cap);
+	if(cap > 0 && g_async_queue_length(events) >= (gint)cap) {
+		/* The queue is full: drop the oldest event to make room for this one */
+		json_t *drop = g_async_queue_try_pop(events);
+		if(drop == &exit_event) {
+			/* Oops, we're closing: put it back where it was */
+			g_async_queue_push(events, drop);
+		} else if(drop != NULL) {
+			json_decref(drop);
+			if((g_atomic_int_add(&dropped, 1) % 1000) == 0) {
+				JANUS_LOG(LOG_WARN, "Queue of GELF events full, dropping older events (%d dropped so far)\n",
+					g_atomic_int_get(&dropped));
+			}
+		}
+	}
 	g_async_queue_push(events, event);
 
 }
@@ -540,6 +588,8 @@ json_t *janus_gelfevh_handle_request(json_t *request) {
 		}
 		if(req_compression > -1 && req_compression < 10)
 			compression = req_compression;
+		if(json_object_get(request, "events_cap"))
+			g_atomic_int_set(&events_cap, json_integer_value(json_object_get(request, "events_cap")));
 		if(req_backend && req_port) {
 			g_free(backend);
 			g_free(port);
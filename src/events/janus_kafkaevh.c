@@ -0,0 +1,465 @@
+/*! \file   janus_kafkaevh.c
+ * \author Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief  Janus KafkaEventHandler plugin
+ * \details  This is a Kafka event handler plugin for Janus, which is
+ * built on librdkafka. Each event is produced individually to the
+ * configured topic, keyed by the session identifier it refers to (when
+ * there is one), so that all the events of the same session end up on
+ * the same partition and their relative order is preserved; batching
+ * on the wire is left to librdkafka itself, which aggregates produced
+ * messages according to the configured linger time.
+ *
+ * \ingroup eventhandlers
+ * \ref eventhandlers
+ */
+
+#include "eventhandler.h"
+
+#include <librdkafka/rdkafka.h>
+
+#include "../debug.h"
+#include "../config.h"
+#include "../mutex.h"
+#include "../utils.h"
+#include "../events.h"
+
+
+/* Plugin information */
+#define JANUS_KAFKAEVH_VERSION			1
+#define JANUS_KAFKAEVH_VERSION_STRING	"0.0.1"
+#define JANUS_KAFKAEVH_DESCRIPTION		"This is a Kafka event handler plugin for Janus, built on librdkafka."
+#define JANUS_KAFKAEVH_NAME				"JANUS KafkaEventHandler plugin"
+#define JANUS_KAFKAEVH_AUTHOR			"Meetecho s.r.l."
+#define JANUS_KAFKAEVH_PACKAGE			"janus.eventhandler.kafkaevh"
+
+/* Plugin methods */
+janus_eventhandler *create(void);
+int janus_kafkaevh_init(const char *config_path);
+void janus_kafkaevh_destroy(void);
+int janus_kafkaevh_get_api_compatibility(void);
+int janus_kafkaevh_get_version(void);
+const char *janus_kafkaevh_get_version_string(void);
+const char *janus_kafkaevh_get_description(void);
+const char *janus_kafkaevh_get_name(void);
+const char *janus_kafkaevh_get_author(void);
+const char *janus_kafkaevh_get_package(void);
+void janus_kafkaevh_incoming_event(json_t *event);
+json_t *janus_kafkaevh_handle_request(json_t *request);
+
+/* Event handler setup */
+static janus_eventhandler janus_kafkaevh =
+	JANUS_EVENTHANDLER_INIT (
+		.init = janus_kafkaevh_init,
+		.destroy = janus_kafkaevh_destroy,
+
+		.get_api_compatibility = janus_kafkaevh_get_api_compatibility,
+		.get_version = janus_kafkaevh_get_version,
+		.get_version_string = janus_kafkaevh_get_version_string,
+		.get_description = janus_kafkaevh_get_description,
+		.get_name = janus_kafkaevh_get_name,
+		.get_author = janus_kafkaevh_get_author,
+		.get_package = janus_kafkaevh_get_package,
+
+		.incoming_event = janus_kafkaevh_incoming_event,
+		.handle_request = janus_kafkaevh_handle_request,
+
+		.events_mask = JANUS_EVENT_TYPE_NONE
+	);
+
+/* Plugin creator */
+janus_eventhandler *create(void) {
+	JANUS_LOG(LOG_VERB, "%s created!\n", JANUS_KAFKAEVH_NAME);
+	return &janus_kafkaevh;
+}
+
+
+/* Useful stuff */
+static volatile gint initialized = 0, stopping = 0;
+static GThread *handler_thread;
+static void *janus_kafkaevh_handler(void *data);
+
+/* Queue of events to handle */
+static GAsyncQueue *events = NULL;
+static json_t exit_event;
+static void janus_kafkaevh_event_free(json_t *event) {
+	if(!event || event == &exit_event)
+		return;
+	json_decref(event);
+}
+
+/* JSON serialization options */
+static size_t json_format = JSON_COMPACT | JSON_PRESERVE_ORDER;
+
+/* Kafka producer */
+static rd_kafka_t *rk = NULL;
+static char *brokers = NULL;
+static char *topic = NULL;
+static char *compression = NULL;
+static int linger_ms = 5;
+
+/* Parameter validation (for tweaking via Admin API) */
+static struct janus_json_parameter request_parameters[] = {
+	{"request", JSON_STRING, JANUS_JSON_PARAM_REQUIRED}
+};
+static struct janus_json_parameter tweak_parameters[] = {
+	{"events", JSON_STRING, 0}
+};
+/* Error codes (for the tweaking via Admin API */
+#define JANUS_KAFKAEVH_ERROR_INVALID_REQUEST		411
+#define JANUS_KAFKAEVH_ERROR_MISSING_ELEMENT		412
+#define JANUS_KAFKAEVH_ERROR_INVALID_ELEMENT		413
+#define JANUS_KAFKAEVH_ERROR_UNKNOWN_ERROR			499
+
+
+/* Delivery report callback: we only use this to log failed deliveries */
+static void janus_kafkaevh_delivery_report(rd_kafka_t *producer, const rd_kafka_message_t *message, void *opaque) {
+	if(message->err != RD_KAFKA_RESP_ERR_NO_ERROR) {
+		JANUS_LOG(LOG_ERR, "KafkaEventHandler: Failed to deliver event: %s\n", rd_kafka_err2str(message->err));
+	}
+}
+
+/* Plugin implementation */
+int janus_kafkaevh_init(const char *config_path) {
+	gboolean success = TRUE;
+	if(g_atomic_int_get(&stopping)) {
+		/* Still stopping from before */
+		return -1;
+	}
+	if(config_path == NULL) {
+		/* Invalid arguments */
+		return -1;
+	}
+	/* Read configuration */
+	char filename[255];
+	g_snprintf(filename, 255, "%s/%s.jcfg", config_path, JANUS_KAFKAEVH_PACKAGE);
+	JANUS_LOG(LOG_VERB, "Configuration file: %s\n", filename);
+	janus_config *config = janus_config_parse(filename);
+	if(config == NULL) {
+		JANUS_LOG(LOG_WARN, "Couldn't find .jcfg configuration file (%s), trying .cfg\n", JANUS_KAFKAEVH_PACKAGE);
+		g_snprintf(filename, 255, "%s/%s.cfg", config_path, JANUS_KAFKAEVH_PACKAGE);
+		JANUS_LOG(LOG_VERB, "Configuration file: %s\n", filename);
+		config = janus_config_parse(filename);
+	}
+	if(config != NULL)
+		janus_config_print(config);
+	janus_config_category *config_general = janus_config_get_create(config, NULL, janus_config_type_category, "general");
+
+	/* Setup the event handler, if required */
+	janus_config_item *item = janus_config_get(config, config_general, janus_config_type_item, "enabled");
+	if(!item || !item->value || !janus_is_true(item->value)) {
+		JANUS_LOG(LOG_WARN, "Kafka event handler disabled\n");
+		goto error;
+	}
+
+	item = janus_config_get(config, config_general, janus_config_type_item, "json");
+	if(item && item->value) {
+		/* Check how we need to format/serialize the JSON output */
+		if(!strcasecmp(item->value, "indented")) {
+			/* Indented, we use three spaces for that */
+			json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
+		} else if(!strcasecmp(item->value, "plain")) {
+			/* Not indented and no new lines, but still readable */
+			json_format = JSON_INDENT(0) | JSON_PRESERVE_ORDER;
+		} else if(!strcasecmp(item->value, "compact")) {
+			/* Default: compact, so no spaces between separators */
+			json_format = JSON_COMPACT | JSON_PRESERVE_ORDER;
+		} else {
+			JANUS_LOG(LOG_WARN, "KafkaEventHandler: Unsupported JSON format option '%s', using default (compact)\n", item->value);
+			json_format = JSON_COMPACT | JSON_PRESERVE_ORDER;
+		}
+	}
+
+	/* Which events should we subscribe to? */
+	item = janus_config_get(config, config_general, janus_config_type_item, "events");
+	if(item && item->value)
+		janus_events_edit_events_mask(item->value, &janus_kafkaevh.events_mask);
+
+	/* Handle configuration, starting from the server details */
+	item = janus_config_get(config, config_general, janus_config_type_item, "brokers");
+	if(!item || !item->value) {
+		JANUS_LOG(LOG_FATAL, "KafkaEventHandler: Missing list of Kafka brokers...\n");
+		goto error;
+	}
+	brokers = g_strdup(item->value);
+
+	item = janus_config_get(config, config_general, janus_config_type_item, "topic");
+	if(!item || !item->value) {
+		JANUS_LOG(LOG_FATAL, "KafkaEventHandler: Missing name of Kafka topic...\n");
+		goto error;
+	}
+	topic = g_strdup(item->value);
+
+	item = janus_config_get(config, config_general, janus_config_type_item, "compression");
+	if(item && item->value)
+		compression = g_strdup(item->value);
+
+	item = janus_config_get(config, config_general, janus_config_type_item, "linger_ms");
+	if(item && item->value) {
+		linger_ms = atoi(item->value);
+		if(linger_ms < 0) {
+			JANUS_LOG(LOG_ERR, "KafkaEventHandler: Invalid linger time (%s), falling back to default (5)\n", item->value);
+			linger_ms = 5;
+		}
+	}
+
+	/* Create the producer */
+	char errstr[512], value[20];
+	rd_kafka_conf_t *conf = rd_kafka_conf_new();
+	if(rd_kafka_conf_set(conf, "bootstrap.servers", brokers, errstr, sizeof(errstr)) != RD_KAFKA_CONF_OK) {
+		JANUS_LOG(LOG_FATAL, "KafkaEventHandler: Error configuring brokers... %s\n", errstr);
+		rd_kafka_conf_destroy(conf);
+		goto error;
+	}
+	g_snprintf(value, sizeof(value), "%d", linger_ms);
+	if(rd_kafka_conf_set(conf, "linger.ms", value, errstr, sizeof(errstr)) != RD_KAFKA_CONF_OK) {
+		JANUS_LOG(LOG_FATAL, "KafkaEventHandler: Error configuring linger time... %s\n", errstr);
+		rd_kafka_conf_destroy(conf);
+		goto error;
+	}
+	if(compression != NULL && rd_kafka_conf_set(conf, "compression.codec", compression, errstr, sizeof(errstr)) != RD_KAFKA_CONF_OK) {
+		JANUS_LOG(LOG_FATAL, "KafkaEventHandler: Error configuring compression... %s\n", errstr);
+		rd_kafka_conf_destroy(conf);
+		goto error;
+	}
+	rd_kafka_conf_set_dr_msg_cb(conf, janus_kafkaevh_delivery_report);
+	rk = rd_kafka_new(RD_KAFKA_PRODUCER, conf, errstr, sizeof(errstr));
+	if(rk == NULL) {
+		/* rd_kafka_new() owns the configuration only on success */
+		JANUS_LOG(LOG_FATAL, "KafkaEventHandler: Error creating producer... %s\n", errstr);
+		rd_kafka_conf_destroy(conf);
+		goto error;
+	}
+	JANUS_LOG(LOG_INFO, "KafkaEventHandler: enabled, %s (%s)\n", brokers, topic);
+
+	/* Initialize the events queue */
+	events = g_async_queue_new_full((GDestroyNotify) janus_kafkaevh_event_free);
+	g_atomic_int_set(&initialized, 1);
+
+	GError *error = NULL;
+	handler_thread = g_thread_try_new("janus kafkaevh handler", janus_kafkaevh_handler, NULL, &error);
+	if(error != NULL) {
+		g_atomic_int_set(&initialized, 0);
+		JANUS_LOG(LOG_FATAL, "KafkaEventHandler: Got error %d (%s) trying to launch the KafkaEventHandler handler thread...\n",
+			error->code, error->message ? error->message : "??");
+		g_error_free(error);
+		goto error;
+	}
+
+	/* Done */
+	JANUS_LOG(LOG_INFO, "Setup of Kafka event handler completed\n");
+	goto done;
+
+error:
+	/* If we got here, something went wrong */
+	success = FALSE;
+	if(rk != NULL) {
+		rd_kafka_destroy(rk);
+		rk = NULL;
+	}
+	g_free(brokers);
+	g_free(topic);
+	g_free(compression);
+	/* Fall through */
+done:
+	if(config)
+		janus_config_destroy(config);
+
+	if(!success) {
+		return -1;
+	}
+	JANUS_LOG(LOG_INFO, "%s initialized!\n", JANUS_KAFKAEVH_NAME);
+	return 0;
+}
+
+void janus_kafkaevh_destroy(void) {
+	if(!g_atomic_int_get(&initialized))
+		return;
+	g_atomic_int_set(&stopping, 1);
+
+	g_async_queue_push(events, &exit_event);
+	if(handler_thread != NULL) {
+		g_thread_join(handler_thread);
+		handler_thread = NULL;
+	}
+
+	g_async_queue_unref(events);
+	events = NULL;
+
+	if(rk != NULL) {
+		/* Give in-flight events a chance to be delivered before leaving */
+		rd_kafka_flush(rk, 5000);
+		rd_kafka_destroy(rk);
+		rk = NULL;
+	}
+	g_free(brokers);
+	g_free(topic);
+	g_free(compression);
+
+	g_atomic_int_set(&initialized, 0);
+	g_atomic_int_set(&stopping, 0);
+	JANUS_LOG(LOG_INFO, "%s destroyed!\n", JANUS_KAFKAEVH_NAME);
+}
+
+int janus_kafkaevh_get_api_compatibility(void) {
+	/* Important! This is what your plugin MUST always return: don't lie here or bad things will happen */
+	return JANUS_EVENTHANDLER_API_VERSION;
+}
+
+int janus_kafkaevh_get_version(void) {
+	return JANUS_KAFKAEVH_VERSION;
+}
+
+const char *janus_kafkaevh_get_version_string(void) {
+	return JANUS_KAFKAEVH_VERSION_STRING;
+}
+
+const char *janus_kafkaevh_get_description(void) {
+	return JANUS_KAFKAEVH_DESCRIPTION;
+}
+
+const char *janus_kafkaevh_get_name(void) {
+	return JANUS_KAFKAEVH_NAME;
+}
+
+const char *janus_kafkaevh_get_author(void) {
+	return JANUS_KAFKAEVH_AUTHOR;
+}
+
+const char *janus_kafkaevh_get_package(void) {
+	return JANUS_KAFKAEVH_PACKAGE;
+}
+
+void janus_kafkaevh_incoming_event(json_t *event) {
+	if(g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized)) {
+		/* Janus is closing or the plugin is */
+		return;
+	}
+
+	/* Do NOT handle the event here in this callback! Since Janus notifies you right
+	 * away when something happens, these events are triggered from working threads and
+	 * not some sort of message bus. As such, performing I/O or network operations in
+	 * here could dangerously slow Janus down. Let's just reference and enqueue the event,
+	 * and handle it in our own thread. */
+	json_incref(event);
+	g_async_queue_push(events, event);
+}
+
+json_t *janus_kafkaevh_handle_request(json_t *request) {
+	if(g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized)) {
+		return NULL;
+	}
+	/* We can use this requests to apply tweaks to the logic */
+	int error_code = 0;
+	char error_cause[512];
+	JANUS_VALIDATE_JSON_OBJECT(request, request_parameters,
+		error_code, error_cause, TRUE,
+		JANUS_KAFKAEVH_ERROR_MISSING_ELEMENT, JANUS_KAFKAEVH_ERROR_INVALID_ELEMENT);
+	if(error_code != 0)
+		goto plugin_response;
+	/* Get the request */
+	const char *request_text = json_string_value(json_object_get(request, "request"));
+	if(!strcasecmp(request_text, "tweak")) {
+		/* We only support a request to tweak the current settings */
+		JANUS_VALIDATE_JSON_OBJECT(request, tweak_parameters,
+			error_code, error_cause, TRUE,
+			JANUS_KAFKAEVH_ERROR_MISSING_ELEMENT, JANUS_KAFKAEVH_ERROR_INVALID_ELEMENT);
+		if(error_code != 0)
+			goto plugin_response;
+		/* Events */
+		if(json_object_get(request, "events"))
+			janus_events_edit_events_mask(json_string_value(json_object_get(request, "events")), &janus_kafkaevh.events_mask);
+	} else {
+		JANUS_LOG(LOG_VERB, "KafkaEventHandler: Unknown request '%s'\n", request_text);
+		error_code = JANUS_KAFKAEVH_ERROR_INVALID_REQUEST;
+		g_snprintf(error_cause, 512, "Unknown request '%s'", request_text);
+	}
+
+plugin_response:
+		{
+			json_t *response = json_object();
+			if(error_code == 0) {
+				/* Return a success */
+				json_object_set_new(response, "result", json_integer(200));
+			} else {
+				/* Prepare JSON error event */
+				json_object_set_new(response, "error_code", json_integer(error_code));
+				json_object_set_new(response, "error", json_string(error_cause));
+			}
+			return response;
+		}
+}
+
+/* Thread to handle incoming events */
+static void *janus_kafkaevh_handler(void *data) {
+	JANUS_LOG(LOG_VERB, "KafkaEventHandler: joining handler thread\n");
+	json_t *event = NULL;
+	char *event_text = NULL;
+
+	while(g_atomic_int_get(&initialized) && !g_atomic_int_get(&stopping)) {
+
+		/* We use a timed pop so that delivery reports are serviced
+		 * regularly even when no new events are coming in */
+		event = g_async_queue_timeout_pop(events, 100000);
+		if(event == NULL) {
+			rd_kafka_poll(rk, 0);
+			continue;
+		}
+		if(event == &exit_event)
+			break;
+
+		/* Handle event: just for fun, let's see how long it took for us to take care of this */
+		json_t *created = json_object_get(event, "timestamp");
+		if(created && json_is_integer(created)) {
+			gint64 then = json_integer_value(created);
+			gint64 now = janus_get_monotonic_time();
+			JANUS_LOG(LOG_DBG, "KafkaEventHandler: Handled event after %"SCNu64" us\n", now-then);
+		}
+
+		/* Convert to string... */
+		event_text = json_dumps(event, json_format);
+		if(event_text == NULL) {
+			JANUS_LOG(LOG_WARN, "KafkaEventHandler: Failed to stringify event, event lost...\n");
+			/* Nothing we can do... get rid of the event */
+			json_decref(event);
+			continue;
+		}
+		/* Key the message by session, if there is one, so that all the
+		 * events of the same session go to the same partition and their
+		 * relative order is preserved */
+		char key[30];
+		size_t keylen = 0;
+		json_t *session_id = json_object_get(event, "session_id");
+		if(session_id && json_is_integer(session_id))
+			keylen = g_snprintf(key, sizeof(key), "%"SCNu64, (guint64)json_integer_value(session_id));
+		/* Produce the event: on success librdkafka owns (and frees) the
+		 * payload, and actual sends are batched according to linger.ms */
+		int tries = 0;
+		rd_kafka_resp_err_t err = RD_KAFKA_RESP_ERR_NO_ERROR;
+		while(tries < 3) {
+			err = rd_kafka_producev(rk,
+				RD_KAFKA_V_TOPIC(topic),
+				RD_KAFKA_V_MSGFLAGS(RD_KAFKA_MSG_F_FREE),
+				RD_KAFKA_V_VALUE(event_text, strlen(event_text)),
+				RD_KAFKA_V_KEY(keylen > 0 ? key : NULL, keylen),
+				RD_KAFKA_V_END);
+			if(err != RD_KAFKA_RESP_ERR__QUEUE_FULL)
+				break;
+			/* Local queue is full, service the producer a bit and retry */
+			tries++;
+			rd_kafka_poll(rk, 100);
+		}
+		if(err != RD_KAFKA_RESP_ERR_NO_ERROR) {
+			JANUS_LOG(LOG_ERR, "KafkaEventHandler: Error producing event... %s\n", rd_kafka_err2str(err));
+			free(event_text);
+		}
+		event_text = NULL;
+		/* Serve queued delivery reports, if any */
+		rd_kafka_poll(rk, 0);
+
+		/* Done, let's unref the event */
+		json_decref(event);
+	}
+	JANUS_LOG(LOG_VERB, "KafkaEventHandler: leaving handler thread\n");
+	return NULL;
+}
@@ -123,6 +123,9 @@ static char *route_key = NULL, *exchange = NULL, *exchange_type = NULL ;
 static uint16_t heartbeat = 0;
 static uint16_t rmqport = AMQP_PROTOCOL_PORT;
 static gboolean declare_outgoing_queue = TRUE;
+static uint16_t publish_channels = 1;
+static uint16_t next_channel = 0;
+static uint16_t grouping_window = 0;
 
 /* Parameter validation (for tweaking via Admin API) */
 static struct janus_json_parameter request_parameters[] = {
@@ -200,6 +203,25 @@ int janus_rabbitmqevh_init(const char *config_path) {
 	if(item && item->value)
 		group_events = janus_is_true(item->value);
 
+	/* How long should we wait for more events before flushing a group? */
+	item = janus_config_get(config, config_general, janus_config_type_item, "grouping_window");
+	if(item && item->value && janus_string_to_uint16(item->value, &grouping_window) < 0) {
+		JANUS_LOG(LOG_ERR, "RabbitMQEventHandler: Invalid grouping window (%s), falling back to default (0, no waiting)\n", item->value);
+		grouping_window = 0;
+	}
+
+	/* How many channels should we spread publishes on? */
+	item = janus_config_get(config, config_general, janus_config_type_item, "publish_channels");
+	if(item && item->value) {
+		if(janus_string_to_uint16(item->value, &publish_channels) < 0 || publish_channels == 0) {
+			JANUS_LOG(LOG_ERR, "RabbitMQEventHandler: Invalid number of publish channels (%s), falling back to default (1)\n", item->value);
+			publish_channels = 1;
+		} else if(publish_channels > 16) {
+			JANUS_LOG(LOG_WARN, "RabbitMQEventHandler: Capping number of publish channels to 16 (configured: %"SCNu16")\n", publish_channels);
+			publish_channels = 16;
+		}
+	}
+
 	/* Handle configuration, starting from the server details */
 	item = janus_config_get(config, config_general, janus_config_type_item, "host");
 	if(item && item->value)
@@ -403,6 +425,20 @@ int janus_rabbitmqevh_connect(void) {
 		JANUS_LOG(LOG_FATAL, "RabbitMQEventHandler: Can't connect to RabbitMQ server: error opening channel... %s, %s\n", amqp_error_string2(result.library_error), amqp_method_name(result.reply.id));
 		return -1;
 	}
+	/* If we're supposed to spread publishes on more than one channel,
+	 * open the additional ones too: channels are the unit of parallelism
+	 * on the broker, so this helps when publishing at a high rate */
+	next_channel = 0;
+	uint16_t extra_channel = 0;
+	for(extra_channel = 2; extra_channel <= publish_channels; extra_channel++) {
+		JANUS_LOG(LOG_VERB, "RabbitMQEventHandler: Opening publish channel #%"SCNu16"...\n", extra_channel);
+		amqp_channel_open(rmq_conn, extra_channel);
+		result = amqp_get_rpc_reply(rmq_conn);
+		if(result.reply_type != AMQP_RESPONSE_NORMAL) {
+			JANUS_LOG(LOG_FATAL, "RabbitMQEventHandler: Can't connect to RabbitMQ server: error opening channel... %s, %s\n", amqp_error_string2(result.library_error), amqp_method_name(result.reply.id));
+			return -1;
+		}
+	}
 	rmq_exchange = amqp_empty_bytes;
 	if(exchange != NULL) {
 		JANUS_LOG(LOG_VERB, "RabbitMQEventHandler: Declaring exchange...\n");
@@ -574,6 +610,8 @@ static void *jns_rmqevh_hdlr(void *data) {
 			break;
 		count = 0;
 		output = NULL;
+		/* If we're grouping with a window, never wait beyond its deadline */
+		gint64 deadline = grouping_window > 0 ? (janus_get_monotonic_time() + ((gint64)grouping_window)*1000) : 0;
 
 		while(TRUE) {
 			/* Handle event: just for fun, let's see how long it took for us to take care of this */
@@ -596,7 +634,15 @@ static void *jns_rmqevh_hdlr(void *data) {
 			count++;
 			if(count == max)
 				break;
-			event = g_async_queue_try_pop(events);
+			if(grouping_window == 0) {
+				event = g_async_queue_try_pop(events);
+			} else {
+				/* Wait a bit for more events before flushing the group, so
+				 * that under sustained load we actually fill it up and pay
+				 * for fewer publishes overall */
+				gint64 now = janus_get_monotonic_time();
+				event = (now < deadline) ? g_async_queue_timeout_pop(events, deadline - now) : g_async_queue_try_pop(events);
+			}
 			if(event == NULL || event == &exit_event)
 				break;
 		}
@@ -617,7 +663,9 @@ static void *jns_rmqevh_hdlr(void *data) {
 			props.content_type = amqp_cstring_bytes("application/json");
 			amqp_bytes_t message = amqp_cstring_bytes(event_text);
 			janus_mutex_lock(&mutex);
-			int status = amqp_basic_publish(rmq_conn, rmq_channel, rmq_exchange, amqp_cstring_bytes(route_key), 0, 0, &props, message);
+			/* Round-robin the publishes over the available channels */
+			amqp_channel_t channel = (next_channel++ % publish_channels) + 1;
+			int status = amqp_basic_publish(rmq_conn, channel, rmq_exchange, amqp_cstring_bytes(route_key), 0, 0, &props, message);
 			if(status != AMQP_STATUS_OK) {
 				JANUS_LOG(LOG_ERR, "RabbitMQEventHandler: Error publishing... %d, %s\n", status, amqp_error_string2(status));
 			}
@@ -43,6 +43,7 @@ const char *janus_sampleevh_get_name(void);
 const char *janus_sampleevh_get_author(void);
 const char *janus_sampleevh_get_package(void);
 void janus_sampleevh_incoming_event(json_t *event);
+void janus_sampleevh_incoming_events(json_t *events, const char *body);
 json_t *janus_sampleevh_handle_request(json_t *request);
 
 /* Event handler setup */
@@ -60,6 +61,7 @@ static janus_eventhandler janus_sampleevh =
 		.get_package = janus_sampleevh_get_package,
 
 		.incoming_event = janus_sampleevh_incoming_event,
+		.incoming_events = janus_sampleevh_incoming_events,
 		.handle_request = janus_sampleevh_handle_request,
 
 		.events_mask = JANUS_EVENT_TYPE_NONE
@@ -338,6 +340,22 @@ void janus_sampleevh_incoming_event(json_t *event) {
 
 }
 
+void janus_sampleevh_incoming_events(json_t *events_batch, const char *body) {
+	if(g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized)) {
+		/* Janus is closing or the plugin is */
+		return;
+	}
+
+	/* The core batched the events for us already: just as with single
+	 * events, we reference and enqueue the whole array as it is, and our
+	 * thread will relay it to the backend with a single HTTP POST. We
+	 * ignore the pre-serialized body, since we may need to re-serialize
+	 * the batch with our own settings (e.g., indented JSON) anyway. */
+	json_incref(events_batch);
+	g_async_queue_push(events, events_batch);
+
+}
+
 json_t *janus_sampleevh_handle_request(json_t *request) {
 	if(g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized)) {
 		return NULL;
@@ -461,6 +479,13 @@ static void *janus_sampleevh_handler(void *data) {
 			output = NULL;
 
 			while(TRUE) {
+				if(json_is_array(event)) {
+					/* This is a batch of events the core grouped for us
+					 * already, no need to do any grouping of our own:
+					 * just relay the array as it is */
+					output = event;
+					break;
+				}
 				/* Handle event: just for fun, let's see how long it took for us to take care of this */
 				json_t *created = json_object_get(event, "timestamp");
 				if(created && json_is_integer(created)) {
@@ -89,7 +89,7 @@ static void janus_wsevh_connect_attempt(lws_sorted_usec_list_t *sul);
 static GQueue *events = NULL;
 static janus_mutex events_mutex = JANUS_MUTEX_INITIALIZER;
 static gboolean group_events = TRUE;
-static volatile gint events_cap_on_reconnect = 0, dropped = 0;
+static volatile gint events_cap = 0, events_cap_on_reconnect = 0, dropped = 0, dropped_total = 0;
 static void janus_wsevh_event_free(json_t *event) {
 	json_decref(event);
 }
@@ -105,6 +105,7 @@ static struct janus_json_parameter request_parameters[] = {
 static struct janus_json_parameter tweak_parameters[] = {
 	{"events", JSON_STRING, 0},
 	{"grouping", JANUS_JSON_BOOL, 0},
+	{"events_cap", JANUS_JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"events_cap_on_reconnect", JANUS_JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE}
 };
 /* Error codes (for the tweaking via Admin API */
@@ -353,6 +354,13 @@ int janus_wsevh_init(const char *config_path) {
 	if(item && item->value)
 		group_events = janus_is_true(item->value);
 
+	/* Do we need to cap the number of queued events, no matter the connection state */
+	item = janus_config_get(config, config_general, janus_config_type_item, "events_cap");
+	if(item && item->value)
+		events_cap = atoi(item->value);
+	if(events_cap < 0)
+		events_cap = 0;
+
 	/* Do we need to cap the number of queued events when reconnecting */
 	item = janus_config_get(config, config_general, janus_config_type_item, "events_cap_on_reconnect");
 	if(item && item->value)
@@ -511,17 +519,22 @@ void janus_wsevh_incoming_event(json_t *event) {
 	json_incref(event);
 	janus_mutex_lock(&events_mutex);
 	g_queue_push_tail(events, event);
+	/* Check if there's a cap to how many events to keep in the buffer: a
+	 * global one, and possibly a stricter one for when we're reconnecting */
+	guint cap = g_atomic_int_get(&events_cap);
 	if(g_atomic_int_get(&reconnect)) {
-		/* We're reconnecting: check if there's a cap to how many events to keep in the buffer */
-		guint cap = g_atomic_int_get(&events_cap_on_reconnect);
-		if(cap > 0 && g_queue_get_length(events) > cap) {
-			/* Get rid of older events, we won't need them anymore */
-			json_t *drop = NULL;
-			while(g_queue_get_length(events) > cap) {
-				drop = g_queue_pop_head(events);
-				json_decref(drop);
-				g_atomic_int_inc(&dropped);
-			}
+		guint rcap = g_atomic_int_get(&events_cap_on_reconnect);
+		if(rcap > 0 && (cap == 0 || rcap < cap))
+			cap = rcap;
+	}
+	if(cap > 0 && g_queue_get_length(events) > cap) {
+		/* Get rid of older events, we won't need them anymore */
+		json_t *drop = NULL;
+		while(g_queue_get_length(events) > cap) {
+			drop = g_queue_pop_head(events);
+			json_decref(drop);
+			g_atomic_int_inc(&dropped);
+			g_atomic_int_inc(&dropped_total);
 		}
 	}
 	janus_mutex_unlock(&events_mutex);
@@ -565,9 +578,23 @@ json_t *janus_wsevh_handle_request(json_t *request) {
 		/* Grouping */
 		if(json_object_get(request, "grouping"))
 			group_events = json_is_true(json_object_get(request, "grouping"));
+		/* Whether we should put a cap on queued events, no matter the connection state */
+		if(json_object_get(request, "events_cap"))
+			g_atomic_int_set(&events_cap, json_integer_value(json_object_get(request, "events_cap")));
 		/* Whether we should put a cap on queued events when reconnecting */
 		if(json_object_get(request, "events_cap_on_reconnect"))
 			g_atomic_int_set(&events_cap_on_reconnect, json_integer_value(json_object_get(request, "events_cap_on_reconnect")));
+	} else if(!strcasecmp(request_text, "status")) {
+		/* Return some details on the state of the connection and of the events queue */
+		json_t *response = json_object();
+		json_object_set_new(response, "result", json_integer(200));
+		json_object_set_new(response, "connected", g_atomic_int_get(&reconnect) ? json_false() : json_true());
+		janus_mutex_lock(&events_mutex);
+		json_object_set_new(response, "queued", json_integer(g_queue_get_length(events)));
+		janus_mutex_unlock(&events_mutex);
+		json_object_set_new(response, "dropped", json_integer(g_atomic_int_get(&dropped)));
+		json_object_set_new(response, "dropped_total", json_integer(g_atomic_int_get(&dropped_total)));
+		return response;
 	} else {
 		JANUS_LOG(LOG_VERB, "Unknown request '%s'\n", request_text);
 		error_code = JANUS_WSEVH_ERROR_INVALID_REQUEST;
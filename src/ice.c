@@ -18,6 +18,12 @@
  * \ref protocols
  */
 
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#endif
 #include <ifaddrs.h>
 #include <poll.h>
 #include <net/if.h>
@@ -38,6 +44,8 @@
 #include "apierror.h"
 #include "ip-utils.h"
 #include "events.h"
+#include "tracepoints.h"
+#include "metrics.h"
 
 /* STUN server/port, if any */
 static char *janus_stun_server = NULL;
@@ -138,6 +146,27 @@ void janus_ice_set_nomination_mode(const char *nomination) {
 const char *janus_ice_get_nomination_mode(void) {
 	return (janus_ice_nomination == NICE_NOMINATION_MODE_REGULAR ? "regular" : "aggressive");
 }
+/* Recent versions of libnice also allow tuning the timing of STUN
+ * connectivity checks: a lower initial retransmission timeout makes checks
+ * towards multi-homed or lossy clients converge on a working pair much
+ * faster (libnice keeps checking the remaining pairs in the background
+ * anyway, and with aggressive nomination will seamlessly switch if a better
+ * pair completes later), at the cost of some more STUN traffic. A value of
+ * 0 means sticking to the libnice defaults */
+static guint janus_ice_check_initial_timeout = 0;
+static guint janus_ice_check_max_retransmissions = 0;
+void janus_ice_set_check_timings(guint initial_timeout, guint max_retransmissions) {
+	janus_ice_check_initial_timeout = initial_timeout;
+	janus_ice_check_max_retransmissions = max_retransmissions;
+	if(janus_ice_check_initial_timeout > 0) {
+		JANUS_LOG(LOG_INFO, "Setting the initial timeout of ICE connectivity checks to %ums\n",
+			janus_ice_check_initial_timeout);
+	}
+	if(janus_ice_check_max_retransmissions > 0) {
+		JANUS_LOG(LOG_INFO, "Setting the maximum number of ICE connectivity check retransmissions to %u\n",
+			janus_ice_check_max_retransmissions);
+	}
+}
 #endif
 
 /* ICE consent freshness */
@@ -199,12 +228,22 @@ gboolean janus_is_opaqueid_in_api_enabled(void) {
 }
 
 /* Only needed in case we're using static event loops spawned at startup (disabled by default) */
+#define JANUS_ICE_TIMER_WHEEL_SLOTS		8
+#define JANUS_ICE_TIMER_WHEEL_TICK_MS	(1000/JANUS_ICE_TIMER_WHEEL_SLOTS)
 typedef struct janus_ice_static_event_loop {
 	int id;
 	GMainContext *mainctx;
 	GMainLoop *mainloop;
 	GThread *thread;
 	uint16_t handles;
+	int core;
+	int numa_node;
+	guint64 pkts_out;
+	guint64 last_pkts_out;
+	volatile gint busy;
+	GSource *wheel_source;
+	GSList *wheel_slots[JANUS_ICE_TIMER_WHEEL_SLOTS];
+	guint wheel_tick;
 	volatile gint destroyed;
 	janus_refcount ref;
 } janus_ice_static_event_loop;
@@ -215,10 +254,14 @@ static void janus_ice_static_event_loop_destroy(janus_ice_static_event_loop *loo
 }
 static void janus_ice_static_event_loop_free(const janus_refcount *loop_ref) {
 	janus_ice_static_event_loop *loop = janus_refcount_containerof(loop_ref, janus_ice_static_event_loop, ref);
+	int i = 0;
+	for(i=0; i<JANUS_ICE_TIMER_WHEEL_SLOTS; i++)
+		g_slist_free(loop->wheel_slots[i]);
 	g_free(loop);
 }
 static int static_event_loops = 0;
 static gboolean allow_loop_indication = FALSE;
+static gboolean pin_event_loops = FALSE;
 static GSList *event_loops = NULL;
 static janus_mutex event_loops_mutex = JANUS_MUTEX_INITIALIZER;
 static void *janus_ice_static_event_loop_thread(void *data) {
@@ -230,6 +273,22 @@ static void *janus_ice_static_event_loop_thread(void *data) {
 		janus_refcount_decrease(&loop->ref);
 		return NULL;
 	}
+	if(loop->core > -1) {
+		/* We were asked to pin this loop to a specific CPU core */
+#ifdef __linux__
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		CPU_SET(loop->core, &cpuset);
+		if(pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
+			JANUS_LOG(LOG_WARN, "[loop#%d] Error pinning event loop to core %d (%d)\n",
+				loop->id, loop->core, errno);
+		} else {
+			JANUS_LOG(LOG_VERB, "[loop#%d] Event loop pinned to core %d\n", loop->id, loop->core);
+		}
+#else
+		JANUS_LOG(LOG_WARN, "[loop#%d] CPU pinning of event loops is only supported on Linux\n", loop->id);
+#endif
+	}
 	JANUS_LOG(LOG_DBG, "[loop#%d] Looping...\n", loop->id);
 	g_main_loop_run(loop->mainloop);
 	/* When the loop quits, we can unref it */
@@ -239,27 +298,133 @@ static void *janus_ice_static_event_loop_thread(void *data) {
 	janus_refcount_decrease(&loop->ref);
 	return NULL;
 }
+/* When static event loops are in use, we coalesce the periodic per-handle
+ * work (outgoing RTCP SR/RR and stats updates) in a single timer wheel per
+ * loop, rather than arming a couple of dedicated GLib timers per handle:
+ * handles are spread across the wheel slots, so that each handle is still
+ * served once per second but the wakeups are staggered, not synchronized */
+static gboolean janus_ice_outgoing_rtcp_handle(gpointer user_data);
+static gboolean janus_ice_outgoing_stats_handle(gpointer user_data);
+static gboolean janus_ice_outgoing_transport_wide_cc_feedback(gpointer user_data);
+static uint twcc_period;	/* Initialized below, next to its setter */
+static gboolean janus_ice_static_event_loop_wheel_tick(gpointer user_data) {
+	janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)user_data;
+	/* The wheel is only ever touched from the loop thread itself, so no lock */
+	GSList *slot = loop->wheel_slots[loop->wheel_tick % JANUS_ICE_TIMER_WHEEL_SLOTS];
+	loop->wheel_tick++;
+	while(slot) {
+		janus_ice_handle *handle = (janus_ice_handle *)slot->data;
+		slot = slot->next;
+		(void)janus_ice_outgoing_rtcp_handle(handle);
+		(void)janus_ice_outgoing_stats_handle(handle);
+	}
+	if(twcc_period != 1000) {
+		/* TWCC feedback runs at a faster pace than the wheel rotation, so on
+		 * every tick we check all the handles on the wheel and serve the ones
+		 * that are due: the check is just a timestamp comparison, and this way
+		 * we don't need a dedicated TWCC timer per handle either */
+		gint64 now = janus_get_monotonic_time();
+		int i = 0;
+		for(i = 0; i < JANUS_ICE_TIMER_WHEEL_SLOTS; i++) {
+			GSList *item = loop->wheel_slots[i];
+			while(item) {
+				janus_ice_handle *handle = (janus_ice_handle *)item->data;
+				item = item->next;
+				if(now >= handle->twcc_due) {
+					handle->twcc_due = now + (gint64)twcc_period*1000;
+					(void)janus_ice_outgoing_transport_wide_cc_feedback(handle);
+				}
+			}
+		}
+	}
+	return G_SOURCE_CONTINUE;
+}
+static void janus_ice_timer_wheel_add(janus_ice_handle *handle) {
+	janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)handle->static_event_loop;
+	if(loop == NULL || handle->timer_wheel_slot > -1)
+		return;
+	/* Use the handle ID to pick a slot, which jitters the periodic work */
+	handle->timer_wheel_slot = handle->handle_id % JANUS_ICE_TIMER_WHEEL_SLOTS;
+	janus_refcount_increase(&handle->ref);
+	loop->wheel_slots[handle->timer_wheel_slot] =
+		g_slist_prepend(loop->wheel_slots[handle->timer_wheel_slot], handle);
+}
+static void janus_ice_timer_wheel_remove(janus_ice_handle *handle) {
+	janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)handle->static_event_loop;
+	if(loop == NULL || handle->timer_wheel_slot < 0)
+		return;
+	loop->wheel_slots[handle->timer_wheel_slot] =
+		g_slist_remove(loop->wheel_slots[handle->timer_wheel_slot], handle);
+	handle->timer_wheel_slot = -1;
+	janus_refcount_decrease(&handle->ref);
+}
+#ifdef __linux__
+/* Helper to find out which NUMA node a CPU core belongs to: when event
+ * loops are pinned, knowing the node lets us keep related handles (e.g.,
+ * subscribers of the same publisher) on the node their media arrives on,
+ * instead of paying for cross-socket traffic on every fanout. We read
+ * the topology from sysfs, so that we don't need to depend on libnuma
+ * just for this; returns -1 if the node can't be resolved */
+static int janus_ice_numa_node_of_core(int core) {
+	char path[100];
+	g_snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", core);
+	GDir *dir = g_dir_open(path, 0, NULL);
+	if(dir == NULL)
+		return -1;
+	int node = -1;
+	const char *entry = NULL;
+	while((entry = g_dir_read_name(dir)) != NULL) {
+		if(sscanf(entry, "node%d", &node) == 1)
+			break;
+		node = -1;
+	}
+	g_dir_close(dir);
+	return node;
+}
+#endif
 int janus_ice_get_static_event_loops(void) {
 	return static_event_loops;
 }
 gboolean janus_ice_is_loop_indication_allowed(void) {
 	return allow_loop_indication;
 }
-void janus_ice_set_static_event_loops(int loops, gboolean allow_api) {
+void janus_ice_set_static_event_loops(int loops, gboolean allow_api, gboolean pin_loops) {
 	if(loops == 0)
 		return;
 	else if(loops < 1) {
 		JANUS_LOG(LOG_WARN, "Invalid number of static event loops (%d), disabling\n", loops);
 		return;
 	}
+	pin_event_loops = pin_loops;
+	guint cores = g_get_num_processors();
+	if(pin_event_loops && loops > (int)cores) {
+		JANUS_LOG(LOG_WARN, "More static event loops (%d) than available cores (%u), some cores will host more than one loop\n",
+			loops, cores);
+	}
 	/* Create a pool of new event loops */
 	int i = 0;
 	for(i=0; i<loops; i++) {
 		janus_ice_static_event_loop *loop = g_malloc0(sizeof(janus_ice_static_event_loop));
 		loop->id = static_event_loops;
+		loop->core = pin_event_loops ? (loop->id % cores) : -1;
+		loop->numa_node = -1;
+#ifdef __linux__
+		if(loop->core > -1) {
+			loop->numa_node = janus_ice_numa_node_of_core(loop->core);
+			if(loop->numa_node > -1) {
+				JANUS_LOG(LOG_VERB, "[loop#%d] Core %d is on NUMA node %d\n",
+					loop->id, loop->core, loop->numa_node);
+			}
+		}
+#endif
 		loop->mainctx = g_main_context_new();
 		loop->mainloop = g_main_loop_new(loop->mainctx, FALSE);
 		janus_refcount_init(&loop->ref, janus_ice_static_event_loop_free);
+		/* Attach the timer wheel this loop will use for the periodic handle work */
+		loop->wheel_source = g_timeout_source_new(JANUS_ICE_TIMER_WHEEL_TICK_MS);
+		g_source_set_priority(loop->wheel_source, G_PRIORITY_DEFAULT);
+		g_source_set_callback(loop->wheel_source, janus_ice_static_event_loop_wheel_tick, loop, NULL);
+		g_source_attach(loop->wheel_source, loop->mainctx);
 		/* Now spawn a thread for this loop */
 		GError *error = NULL;
 		char tname[16];
@@ -296,7 +461,55 @@ json_t *janus_ice_static_event_loops_info(void) {
 		json_t *info = json_object();
 		json_object_set_new(info, "id", json_integer(loop->id));
 		json_object_set_new(info, "handles", json_integer(loop->handles));
+		if(loop->core > -1)
+			json_object_set_new(info, "core", json_integer(loop->core));
+		if(loop->numa_node > -1)
+			json_object_set_new(info, "numa_node", json_integer(loop->numa_node));
+		json_object_set_new(info, "outgoing-packets", json_integer(loop->pkts_out));
+		if(g_atomic_int_get(&loop->busy))
+			json_object_set_new(info, "busy", json_true());
+		json_array_append_new(list, info);
+		l = l->next;
+	}
+	janus_mutex_unlock(&event_loops_mutex);
+	return list;
+}
+json_t *janus_ice_static_event_loops_rebalance(void) {
+	json_t *list = json_array();
+	if(static_event_loops < 1)
+		return list;
+	/* Compute how much outgoing traffic each loop dispatched since the last
+	 * rebalance, and flag the loops that are well above the average as busy:
+	 * busy loops are skipped when automatically assigning new handles, until
+	 * a subsequent rebalance clears the flag */
+	janus_mutex_lock(&event_loops_mutex);
+	guint64 total = 0;
+	GSList *l = event_loops;
+	while(l) {
+		janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)l->data;
+		total += (loop->pkts_out - loop->last_pkts_out);
+		l = l->next;
+	}
+	guint64 average = total / static_event_loops;
+	l = event_loops;
+	while(l) {
+		janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)l->data;
+		guint64 delta = loop->pkts_out - loop->last_pkts_out;
+		loop->last_pkts_out = loop->pkts_out;
+		gboolean busy = (average > 0 && delta > average + average/2);
+		g_atomic_int_set(&loop->busy, busy ? 1 : 0);
+		json_t *info = json_object();
+		json_object_set_new(info, "id", json_integer(loop->id));
+		json_object_set_new(info, "handles", json_integer(loop->handles));
+		if(loop->numa_node > -1)
+			json_object_set_new(info, "numa_node", json_integer(loop->numa_node));
+		json_object_set_new(info, "outgoing-packets", json_integer(delta));
+		json_object_set_new(info, "busy", busy ? json_true() : json_false());
 		json_array_append_new(list, info);
+		if(busy) {
+			JANUS_LOG(LOG_INFO, "[loop#%d] Loop flagged as busy (%"SCNu64" packets since last rebalance, average %"SCNu64"), new handles will avoid it\n",
+				loop->id, delta, average);
+		}
 		l = l->next;
 	}
 	janus_mutex_unlock(&event_loops_mutex);
@@ -310,6 +523,11 @@ void janus_ice_stop_static_event_loops(void) {
 	GSList *l = event_loops;
 	while(l) {
 		janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)l->data;
+		if(loop->wheel_source != NULL) {
+			g_source_destroy(loop->wheel_source);
+			g_source_unref(loop->wheel_source);
+			loop->wheel_source = NULL;
+		}
 		if(loop->mainloop != NULL && g_main_loop_is_running(loop->mainloop))
 			g_main_loop_quit(loop->mainloop);
 		g_thread_join(loop->thread);
@@ -421,6 +639,17 @@ int janus_ice_get_event_stats_period(void) {
 	return janus_ice_event_stats_period;
 }
 
+/* Cap on the number of media packets each handle can send us per second (disabled by default) */
+static int janus_ice_media_rate_limit = 0;
+void janus_ice_set_media_rate_limit(int rate) {
+	janus_ice_media_rate_limit = rate;
+	if(janus_ice_media_rate_limit < 0)
+		janus_ice_media_rate_limit = 0;
+	if(janus_ice_media_rate_limit > 0) {
+		JANUS_LOG(LOG_INFO, "Incoming media capped to %d packets per second per handle\n", janus_ice_media_rate_limit);
+	}
+}
+
 /* How to handle media statistic events (one per media or one per peerConnection) */
 static gboolean janus_ice_event_combine_media_stats = false;
 void janus_ice_event_set_combine_media_stats(gboolean combine_media_stats_to_one_event) {
@@ -445,7 +674,6 @@ static uint16_t rtp_range_max = 0;
 #define JANUS_ICE_PACKET_VIDEO	1
 #define JANUS_ICE_PACKET_TEXT	2
 #define JANUS_ICE_PACKET_BINARY	3
-#define JANUS_ICE_PACKET_SCTP	4
 /* Helper to convert packet types to core types */
 static janus_media_type janus_media_type_from_packet(int type) {
 	switch(type) {
@@ -455,7 +683,6 @@ static janus_media_type janus_media_type_from_packet(int type) {
 			return JANUS_MEDIA_VIDEO;
 		case JANUS_ICE_PACKET_TEXT:
 		case JANUS_ICE_PACKET_BINARY:
-		case JANUS_ICE_PACKET_SCTP:
 			return JANUS_MEDIA_DATA;
 		default:
 			break;
@@ -466,6 +693,13 @@ static janus_media_type janus_media_type_from_packet(int type) {
 typedef struct janus_ice_queued_packet {
 	gint mindex;
 	char *data;
+	/* Refcounted buffer shared by the plugin, if any: when set, the copy
+	 * into the private data buffer is deferred to the send loop, and
+	 * shared_data points to where the packet starts within the buffer
+	 * (for RTP, it's repointed at the payload once that's been staged) */
+	janus_plugin_buffer *shared;
+	char *shared_data;
+	gint shared_plen;
 	char *label;
 	char *protocol;
 	janus_plugin_rtp_extensions extensions;
@@ -474,6 +708,8 @@ typedef struct janus_ice_queued_packet {
 	gboolean control;
 	gboolean retransmission;
 	gboolean encrypted;
+	gboolean batched;
+	gboolean pooled;
 	gint64 added;
 } janus_ice_queued_packet;
 /* A few static, fake, messages we use as a trigger: e.g., to start a
@@ -525,39 +761,291 @@ const char *janus_media_type_str(janus_media_type type) {
 
 /* Deallocation helpers for handles and related structs */
 static void janus_ice_handle_free(const janus_refcount *handle_ref);
+static void janus_ice_handle_reap(janus_ice_handle *handle);
 static void janus_ice_webrtc_free(janus_ice_handle *handle);
 static void janus_ice_plugin_session_free(const janus_refcount *app_handle_ref);
 static void janus_ice_peerconnection_free(const janus_refcount *pc_ref);
 static void janus_ice_peerconnection_medium_free(const janus_refcount *medium_ref);
 
+/* Maximum number of packets we can flush with a single batched send */
+#define JANUS_ICE_SEND_BATCH_MAX	64
+/* Size of the send batch, if batching of media packets is enabled (0 means
+ * packets are sent one by one, which is the default): when batching is on,
+ * encrypted RTP packets are accumulated during a dispatch of the outgoing
+ * traffic source, and flushed with a single (vectored) libnice send, which
+ * can use sendmmsg() internally and so save a lot of syscalls per packet.
+ * Note: UDP segmentation offload (UDP_SEGMENT) would cut the per-packet
+ * kernel cost further, but it doesn't fit how WebRTC media is sent here:
+ * each PeerConnection has its own candidate socket owned by libnice (which
+ * may actually be TURN or TCP underneath), we never get at the raw fd, and
+ * GSO requires uniform-size segments to a single destination, while SRTP
+ * packets vary in size and each handle has exactly one peer; batched
+ * vectored sends are the closest applicable optimization */
+static int send_batch_size = 0;
+void janus_ice_set_send_batch_size(int size) {
+	if(size < 0 || size > JANUS_ICE_SEND_BATCH_MAX) {
+		JANUS_LOG(LOG_WARN, "Invalid send batch size %d (should be 0-%d), disabling batching\n",
+			size, JANUS_ICE_SEND_BATCH_MAX);
+		size = 0;
+	}
+	send_batch_size = size;
+	if(send_batch_size > 0)
+		JANUS_LOG(LOG_INFO, "Batching outgoing media packets (up to %d per send)\n", send_batch_size);
+}
+int janus_ice_get_send_batch_size(void) {
+	return send_batch_size;
+}
+
+/* Size of the pacing burst, if pacing of outgoing video is enabled (0 means
+ * packets are sent as soon as plugins relay them, which is the default):
+ * when pacing is on, each handle gets a token bucket of this many bytes,
+ * and video packets exceeding the budget are spread over time, rather than
+ * hitting the wire all at once (e.g., when a keyframe is relayed). The
+ * bucket refill rate follows what the handle has been sending recently,
+ * with some headroom on top to probe for more bandwidth, and backs off
+ * when the TWCC feedback from the peer reports losses */
+static int pacing_burst = 0;
+#define JANUS_ICE_PACING_INTERVAL	5		/* How often we resume paced packets, in ms */
+#define JANUS_ICE_PACING_MIN_RATE	125000	/* Floor for the refill rate: 125000 bytes/s, i.e., 1mbps */
+void janus_ice_set_pacing_burst(int burst) {
+	if(burst < 0) {
+		JANUS_LOG(LOG_WARN, "Invalid pacing burst size %d, disabling pacing\n", burst);
+		burst = 0;
+	}
+	pacing_burst = burst;
+	if(pacing_burst > 0)
+		JANUS_LOG(LOG_INFO, "Pacing outgoing video (bursts of %d bytes at most)\n", pacing_burst);
+}
+int janus_ice_get_pacing_burst(void) {
+	return pacing_burst;
+}
+
 /* Custom GSource for outgoing traffic */
 typedef struct janus_ice_outgoing_traffic {
 	GSource parent;
 	janus_ice_handle *handle;
+	guint batched;
+	GOutputVector vectors[JANUS_ICE_SEND_BATCH_MAX];
+	NiceOutputMessage messages[JANUS_ICE_SEND_BATCH_MAX];
+	janus_ice_queued_packet *bpkts[JANUS_ICE_SEND_BATCH_MAX];
 	GDestroyNotify destroy;
+	/* Pacing state, only used when a pacing burst is configured */
+	gint64 pace_tokens;			/* Bytes we can still send right away */
+	gint64 pace_refilled;		/* Monotonic time of the last bucket refill */
+	guint64 pace_rate;			/* Current refill rate, in bytes per second */
+	gint64 pace_updated;		/* Monotonic time of the last rate update */
+	guint32 pace_twcc_received;	/* TWCC counters at the last rate update */
+	guint32 pace_twcc_lost;
+	GQueue *paced;				/* Packets waiting for the bucket to refill */
+	GSource *pace_source;		/* Timer resuming the paced packets */
 } janus_ice_outgoing_traffic;
-static gboolean janus_ice_outgoing_rtcp_handle(gpointer user_data);
-static gboolean janus_ice_outgoing_stats_handle(gpointer user_data);
-static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janus_ice_queued_packet *pkt);
+static gboolean janus_ice_outgoing_traffic_handle(janus_ice_outgoing_traffic *t, janus_ice_queued_packet *pkt);
+static void janus_ice_free_queued_packet(janus_ice_queued_packet *pkt);
+/* Defined later with the other helpers of the outgoing RTP packet ring */
+typedef struct janus_ice_packet_ring janus_ice_packet_ring;
+static janus_ice_queued_packet *janus_ice_packet_ring_pop(janus_ice_packet_ring *ring);
+static guint janus_ice_packet_ring_length(janus_ice_packet_ring *ring);
+static void janus_ice_outgoing_traffic_flush(janus_ice_outgoing_traffic *t) {
+	if(t == NULL || t->batched == 0)
+		return;
+	janus_ice_handle *handle = t->handle;
+	janus_ice_peerconnection *pc = handle->pc;
+	if(pc != NULL && handle->agent != NULL) {
+		gint sent = nice_agent_send_messages_nonblocking(handle->agent,
+			pc->stream_id, pc->component_id, t->messages, t->batched, NULL, NULL);
+		JANUS_PROBE(socket_send, handle->handle_id, sent);
+		if(sent < (gint)t->batched) {
+			JANUS_LOG(LOG_ERR, "[%"SCNu64"] ... only sent %d of %u batched packets?\n",
+				handle->handle_id, sent > 0 ? sent : 0, t->batched);
+		}
+	}
+	guint i = 0;
+	for(i=0; i<t->batched; i++) {
+		t->bpkts[i]->batched = FALSE;
+		janus_ice_free_queued_packet(t->bpkts[i]);
+		t->bpkts[i] = NULL;
+	}
+	t->batched = 0;
+}
+static void janus_ice_outgoing_traffic_batch(janus_ice_outgoing_traffic *t, janus_ice_queued_packet *pkt, int length) {
+	/* Take ownership of the packet: it will be freed when the batch is flushed */
+	pkt->batched = TRUE;
+	t->vectors[t->batched].buffer = pkt->data;
+	t->vectors[t->batched].size = length;
+	t->messages[t->batched].buffers = &t->vectors[t->batched];
+	t->messages[t->batched].n_buffers = 1;
+	t->bpkts[t->batched] = pkt;
+	t->batched++;
+	if(t->batched == (guint)send_batch_size)
+		janus_ice_outgoing_traffic_flush(t);
+}
+static gboolean janus_ice_outgoing_traffic_pace(gpointer user_data);
+/* Refill the pacing token bucket, and periodically update the refill rate */
+static void janus_ice_outgoing_traffic_pace_refill(janus_ice_outgoing_traffic *t) {
+	gint64 now = janus_get_monotonic_time();
+	if(t->pace_refilled > 0) {
+		t->pace_tokens += (gint64)((t->pace_rate*(guint64)(now - t->pace_refilled))/G_USEC_PER_SEC);
+		if(t->pace_tokens > (gint64)pacing_burst)
+			t->pace_tokens = pacing_burst;
+	} else {
+		/* First time we're called for this handle, start with a full bucket */
+		t->pace_tokens = pacing_burst;
+		t->pace_rate = JANUS_ICE_PACING_MIN_RATE;
+		t->pace_updated = now;
+	}
+	t->pace_refilled = now;
+	if(now - t->pace_updated < 250000)
+		return;
+	t->pace_updated = now;
+	/* Update the refill rate: start from what this handle sent in the last
+	 * second, with some headroom on top to act as a bandwidth probe, and
+	 * back off, instead, if the TWCC feedback we got reported losses */
+	janus_ice_peerconnection *pc = t->handle->pc;
+	if(pc == NULL)
+		return;
+	guint64 sent = 0;
+	guint32 twcc_received = 0, twcc_lost = 0;
+	GHashTableIter iter;
+	gpointer value;
+	g_hash_table_iter_init(&iter, pc->media);
+	while(g_hash_table_iter_next(&iter, NULL, &value)) {
+		janus_ice_peerconnection_medium *medium = value;
+		if(medium == NULL)
+			continue;
+		sent += medium->out_stats.info[0].bytes_lastsec;
+		if(medium->rtcp_ctx[0] != NULL) {
+			twcc_received += medium->rtcp_ctx[0]->twcc_received;
+			twcc_lost += medium->rtcp_ctx[0]->twcc_lost;
+		}
+	}
+	guint64 rate = sent + sent/4;
+	if(rate < JANUS_ICE_PACING_MIN_RATE)
+		rate = JANUS_ICE_PACING_MIN_RATE;
+	/* Check how many of the packets covered by recent feedback were lost */
+	guint32 received = twcc_received - t->pace_twcc_received,
+		lost = twcc_lost - t->pace_twcc_lost;
+	t->pace_twcc_received = twcc_received;
+	t->pace_twcc_lost = twcc_lost;
+	if(lost > 0 && (lost*100)/(lost+received) > 5) {
+		/* More than 5% of losses since the last update, slow down */
+		rate = (rate*85)/100;
+	}
+	t->pace_rate = rate;
+}
+/* Check if an outgoing packet should be deferred by the pacer: returns TRUE
+ * if the packet was queued (and so must not be handled now), FALSE otherwise */
+static gboolean janus_ice_outgoing_traffic_pace_defer(janus_ice_outgoing_traffic *t, janus_ice_queued_packet *pkt) {
+	if(pacing_burst == 0)
+		return FALSE;
+	if(pkt == NULL || pkt == &janus_ice_start_gathering ||
+			pkt == &janus_ice_add_candidates ||
+			pkt == &janus_ice_dtls_handshake ||
+			pkt == &janus_ice_media_stopped ||
+			pkt == &janus_ice_hangup_peerconnection ||
+			pkt == &janus_ice_detach_handle ||
+			pkt == &janus_ice_data_ready) {
+		/* Fake packets are triggers, never pace them */
+		return FALSE;
+	}
+	if(pkt->type != JANUS_ICE_PACKET_VIDEO || pkt->control || pkt->retransmission) {
+		/* We only pace fresh video RTP packets: audio and data are low rate,
+		 * RTCP is tiny, and delaying retransmissions would defeat NACKs */
+		return FALSE;
+	}
+	if(t->pace_tokens > 0 && (t->paced == NULL || g_queue_is_empty(t->paced))) {
+		/* There's budget, send it right away */
+		t->pace_tokens -= pkt->length;
+		return FALSE;
+	}
+	/* Out of budget (or packets are queued already), wait for a refill */
+	if(t->paced == NULL)
+		t->paced = g_queue_new();
+	g_queue_push_tail(t->paced, pkt);
+	if(t->pace_source == NULL) {
+		t->pace_source = g_timeout_source_new(JANUS_ICE_PACING_INTERVAL);
+		g_source_set_callback(t->pace_source, janus_ice_outgoing_traffic_pace, t, NULL);
+		g_source_attach(t->pace_source, t->handle->mainctx);
+	}
+	return TRUE;
+}
+/* Timer callback draining the paced packets as the bucket refills */
+static gboolean janus_ice_outgoing_traffic_pace(gpointer user_data) {
+	janus_ice_outgoing_traffic *t = (janus_ice_outgoing_traffic *)user_data;
+	janus_ice_outgoing_traffic_pace_refill(t);
+	janus_ice_queued_packet *pkt = NULL;
+	/* Note: if pacing was just disabled via a configuration reload, we
+	 * simply flush everything that was still waiting for the bucket */
+	while((pacing_burst == 0 || t->pace_tokens > 0) && (pkt = g_queue_pop_head(t->paced)) != NULL) {
+		t->pace_tokens -= pkt->length;
+		/* Only media packets are ever paced, so we can ignore the return value */
+		(void)janus_ice_outgoing_traffic_handle(t, pkt);
+	}
+	janus_ice_outgoing_traffic_flush(t);
+	if(g_queue_is_empty(t->paced)) {
+		/* Nothing left to pace, we can get rid of the timer */
+		g_source_unref(t->pace_source);
+		t->pace_source = NULL;
+		return G_SOURCE_REMOVE;
+	}
+	return G_SOURCE_CONTINUE;
+}
 static gboolean janus_ice_outgoing_traffic_prepare(GSource *source, gint *timeout) {
 	janus_ice_outgoing_traffic *t = (janus_ice_outgoing_traffic *)source;
-	return (g_async_queue_length(t->handle->queued_packets) > 0);
+	return (g_async_queue_length(t->handle->queued_packets) > 0 ||
+		janus_ice_packet_ring_length(t->handle->packet_ring) > 0);
 }
 static gboolean janus_ice_outgoing_traffic_dispatch(GSource *source, GSourceFunc callback, gpointer user_data) {
 	janus_ice_outgoing_traffic *t = (janus_ice_outgoing_traffic *)source;
 	int ret = G_SOURCE_CONTINUE;
 	janus_ice_queued_packet *pkt = NULL;
+	guint64 sent = 0;
+	if(pacing_burst > 0)
+		janus_ice_outgoing_traffic_pace_refill(t);
 	while((pkt = g_async_queue_try_pop(t->handle->queued_packets)) != NULL) {
-		if(janus_ice_outgoing_traffic_handle(t->handle, pkt) == G_SOURCE_REMOVE)
+		sent++;
+		JANUS_PROBE(queue_dequeue, t->handle->handle_id, pkt->type, pkt->length);
+		if(janus_ice_outgoing_traffic_pace_defer(t, pkt))
+			continue;
+		if(janus_ice_outgoing_traffic_handle(t, pkt) == G_SOURCE_REMOVE)
 			ret = G_SOURCE_REMOVE;
 	}
+	/* Drain the lock-free RTP ring as well, if in use */
+	if(t->handle->packet_ring != NULL) {
+		while((pkt = janus_ice_packet_ring_pop(t->handle->packet_ring)) != NULL) {
+			sent++;
+			JANUS_PROBE(queue_dequeue, t->handle->handle_id, pkt->type, pkt->length);
+			if(janus_ice_outgoing_traffic_pace_defer(t, pkt))
+				continue;
+			if(janus_ice_outgoing_traffic_handle(t, pkt) == G_SOURCE_REMOVE)
+				ret = G_SOURCE_REMOVE;
+		}
+	}
+	/* Flush any media packet the drain above may have batched */
+	janus_ice_outgoing_traffic_flush(t);
+	/* If this handle is on a static loop, track how much it's dispatching
+	 * there, so that rebalance requests can spot the overloaded loops */
+	janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)t->handle->static_event_loop;
+	if(sent > 0 && loop != NULL)
+		loop->pkts_out += sent;
 	return ret;
 }
 static void janus_ice_outgoing_traffic_finalize(GSource *source) {
 	janus_ice_outgoing_traffic *t = (janus_ice_outgoing_traffic *)source;
 	JANUS_LOG(LOG_VERB, "[%"SCNu64"] Finalizing loop source\n", t->handle->handle_id);
+	janus_ice_outgoing_traffic_flush(t);
+	if(t->pace_source != NULL) {
+		g_source_destroy(t->pace_source);
+		g_source_unref(t->pace_source);
+		t->pace_source = NULL;
+	}
+	if(t->paced != NULL) {
+		g_queue_free_full(t->paced, (GDestroyNotify)janus_ice_free_queued_packet);
+		t->paced = NULL;
+	}
 	if(static_event_loops > 0) {
-		/* This handle was sharing an event loop with others */
+		/* This handle was sharing an event loop with others: make sure it's
+		 * not on the loop timer wheel anymore, then free the WebRTC stuff */
+		janus_ice_timer_wheel_remove(t->handle);
 		janus_ice_webrtc_free(t->handle);
 		janus_refcount_decrease(&t->handle->ref);
 	} else if(t->handle->mainloop != NULL && g_main_loop_is_running(t->handle->mainloop)) {
@@ -618,6 +1106,12 @@ uint janus_get_slowlink_threshold(void) {
 	return slowlink_threshold;
 }
 
+/* Constant "janus" values for the events we generate per occurrence: shared
+ * immortal strings (see janus_json_immortal_string), so that we don't have
+ * to allocate and copy a new string for every single event */
+static json_t *janus_json_media = NULL, *janus_json_hangup = NULL,
+	*janus_json_webrtcup = NULL, *janus_json_slowlink = NULL;
+
 /* Period, in milliseconds, to refer to for sending TWCC feedback */
 #define DEFAULT_TWCC_PERIOD		200
 static uint twcc_period = DEFAULT_TWCC_PERIOD;
@@ -652,10 +1146,339 @@ static inline void janus_ice_free_rtp_packet(janus_rtp_packet *pkt) {
 		return;
 	}
 
+	if(pkt->shared != NULL)
+		janus_plugin_buffer_unref(pkt->shared);
 	g_free(pkt->data);
 	g_free(pkt);
 }
 
+/* Optional bounded lock-free ring for fresh outgoing RTP packets: there's
+ * exactly one consumer (the handle's loop), but there can be more than one
+ * producer, as several plugin threads may be relaying media on the same
+ * handle at the same time (e.g., a multistream subscriber being fed by the
+ * loops of all the publishers it's subscribed to), so the write index is
+ * claimed with a CAS and each slot is published atomically; this still
+ * lets all sides proceed without ever contending on the queue mutex, while
+ * control messages, events and retransmissions keep using the GAsyncQueue,
+ * which also means they're implicitly prioritized */
+struct janus_ice_packet_ring {
+	/*! \brief Preallocated slots for the queued packets */
+	janus_ice_queued_packet **packets;
+	/*! \brief Number of slots (power of two, so that we can mask) */
+	guint size;
+	/*! \brief Write index, claimed via CAS by the producers (free running) */
+	volatile gint head;
+	/*! \brief Read index, only updated by the consumer (free running) */
+	volatile gint tail;
+	/*! \brief Depth high-watermark, only updated by the producers */
+	volatile gint hwm;
+};
+static int packet_ring_size = 0;	/* Disabled by default */
+void janus_ice_set_packet_ring_size(int size) {
+	if(size < 0) {
+		JANUS_LOG(LOG_WARN, "Invalid packet ring size %d, disabling the ring\n", size);
+		size = 0;
+	}
+	if(size > 0) {
+		/* Round up to the next power of two */
+		int rounded = 1;
+		while(rounded < size)
+			rounded = rounded << 1;
+		size = rounded;
+		JANUS_LOG(LOG_INFO, "Using a lock-free ring for outgoing RTP packets (%d slots per handle)\n", size);
+	}
+	packet_ring_size = size;
+}
+int janus_ice_get_packet_ring_size(void) {
+	return packet_ring_size;
+}
+static janus_ice_packet_ring *janus_ice_packet_ring_create(void) {
+	if(packet_ring_size < 1)
+		return NULL;
+	janus_ice_packet_ring *ring = g_malloc0(sizeof(janus_ice_packet_ring));
+	ring->size = packet_ring_size;
+	ring->packets = g_malloc0(sizeof(janus_ice_queued_packet *) * ring->size);
+	return ring;
+}
+static gboolean janus_ice_packet_ring_push(janus_ice_packet_ring *ring, janus_ice_queued_packet *pkt) {
+	/* Claim a slot first: producers may be racing each other, so the write
+	 * index is only advanced via CAS, and each producer ends up owning a
+	 * different slot (a plain read-modify-write here could have two of them
+	 * overwrite the same slot, or move the index backwards) */
+	guint head, tail;
+	do {
+		head = (guint)g_atomic_int_get(&ring->head);
+		tail = (guint)g_atomic_int_get(&ring->tail);
+		if(head - tail >= ring->size)
+			return FALSE;	/* Ring is full */
+	} while(!g_atomic_int_compare_and_exchange(&ring->head, (gint)head, (gint)(head+1)));
+	/* The slot is ours: publish the packet with an atomic store, since the
+	 * consumer won't go past a claimed slot until it's actually been filled
+	 * (the slot is known to be NULL here, the consumer clears it on pop) */
+	g_atomic_pointer_set(&ring->packets[head & (ring->size-1)], pkt);
+	/* Track the deepest the ring has been, to help size it: the consumer
+	 * may have drained packets since we read the tail, but being a packet
+	 * or two pessimistic doesn't matter for a high-watermark */
+	if((gint)(head - tail + 1) > g_atomic_int_get(&ring->hwm))
+		g_atomic_int_set(&ring->hwm, (gint)(head - tail + 1));
+	return TRUE;
+}
+static janus_ice_queued_packet *janus_ice_packet_ring_pop(janus_ice_packet_ring *ring) {
+	guint tail = (guint)g_atomic_int_get(&ring->tail),
+		head = (guint)g_atomic_int_get(&ring->head);
+	if(tail == head)
+		return NULL;	/* Ring is empty */
+	janus_ice_queued_packet *pkt = g_atomic_pointer_get(&ring->packets[tail & (ring->size-1)]);
+	if(pkt == NULL) {
+		/* A producer has claimed this slot but hasn't filled it yet: treat
+		 * the ring as momentarily empty, the loop will check again right
+		 * away anyway (the source's prepare callback looks at the depth) */
+		return NULL;
+	}
+	ring->packets[tail & (ring->size-1)] = NULL;
+	g_atomic_int_set(&ring->tail, (gint)(tail+1));
+	return pkt;
+}
+static guint janus_ice_packet_ring_length(janus_ice_packet_ring *ring) {
+	if(ring == NULL)
+		return 0;
+	return (guint)g_atomic_int_get(&ring->head) - (guint)g_atomic_int_get(&ring->tail);
+}
+guint janus_ice_get_packet_ring_depth(janus_ice_handle *handle) {
+	if(handle == NULL || handle->packet_ring == NULL)
+		return 0;
+	return janus_ice_packet_ring_length(handle->packet_ring);
+}
+guint janus_ice_get_packet_ring_hwm(janus_ice_handle *handle) {
+	if(handle == NULL || handle->packet_ring == NULL)
+		return 0;
+	return (guint)g_atomic_int_get(&handle->packet_ring->hwm);
+}
+static void janus_ice_free_queued_packet(janus_ice_queued_packet *pkt);
+static void janus_ice_packet_ring_destroy(janus_ice_packet_ring *ring) {
+	if(ring == NULL)
+		return;
+	janus_ice_queued_packet *pkt = NULL;
+	while((pkt = janus_ice_packet_ring_pop(ring)) != NULL)
+		janus_ice_free_queued_packet(pkt);
+	g_free(ring->packets);
+	g_free(ring);
+}
+
+/* Optional pool of recycled queued packets: when enabled, the packets (and
+ * their MTU-sized buffers) used on the media relay path are reused instead
+ * of being allocated and freed for each packet, which takes the allocator
+ * out of the steady-state path on servers with a high fan-out */
+#define JANUS_ICE_PACKET_POOL_BUFSIZE	(1500 + SRTP_MAX_TAG_LEN + 4)
+static int packet_pool_size = 0;	/* Disabled by default */
+static GQueue packet_pool = G_QUEUE_INIT;
+static janus_mutex packet_pool_mutex = JANUS_MUTEX_INITIALIZER;
+void janus_ice_set_packet_pool_size(int size) {
+	if(size < 0) {
+		JANUS_LOG(LOG_WARN, "Invalid packet pool size %d, disabling pooling\n", size);
+		size = 0;
+	}
+	packet_pool_size = size;
+	if(packet_pool_size > 0) {
+		JANUS_LOG(LOG_INFO, "Pooling queued media packets (up to %d recycled instances)\n", packet_pool_size);
+		/* Preallocate the whole pool, so that we don't pay for the
+		 * allocations when the traffic starts ramping up either */
+		janus_mutex_lock(&packet_pool_mutex);
+		while((int)g_queue_get_length(&packet_pool) < packet_pool_size) {
+			janus_ice_queued_packet *pkt = g_malloc(sizeof(janus_ice_queued_packet));
+			pkt->data = g_malloc(JANUS_ICE_PACKET_POOL_BUFSIZE);
+			g_queue_push_head(&packet_pool, pkt);
+		}
+		janus_mutex_unlock(&packet_pool_mutex);
+	}
+}
+int janus_ice_get_packet_pool_size(void) {
+	return packet_pool_size;
+}
+static void janus_ice_packet_pool_destroy(void) {
+	janus_mutex_lock(&packet_pool_mutex);
+	janus_ice_queued_packet *pkt = NULL;
+	while((pkt = g_queue_pop_head(&packet_pool)) != NULL) {
+		g_free(pkt->data);
+		g_free(pkt);
+	}
+	janus_mutex_unlock(&packet_pool_mutex);
+}
+/* Helper to allocate a queued packet and its data buffer, trying the pool
+ * first in case pooling is enabled and the requested size fits a slot */
+static janus_ice_queued_packet *janus_ice_alloc_queued_packet(gint length) {
+	janus_ice_queued_packet *pkt = NULL;
+	if(packet_pool_size > 0 && length <= JANUS_ICE_PACKET_POOL_BUFSIZE) {
+		janus_mutex_lock(&packet_pool_mutex);
+		pkt = g_queue_pop_head(&packet_pool);
+		janus_mutex_unlock(&packet_pool_mutex);
+		if(pkt == NULL) {
+			/* The pool is momentarily empty, create a new recyclable packet */
+			pkt = g_malloc(sizeof(janus_ice_queued_packet));
+			pkt->data = g_malloc(JANUS_ICE_PACKET_POOL_BUFSIZE);
+		}
+		pkt->pooled = TRUE;
+		pkt->shared = NULL;
+		pkt->shared_data = NULL;
+		pkt->shared_plen = 0;
+		return pkt;
+	}
+	pkt = g_malloc(sizeof(janus_ice_queued_packet));
+	pkt->data = g_malloc(length);
+	pkt->pooled = FALSE;
+	pkt->shared = NULL;
+	pkt->shared_data = NULL;
+	pkt->shared_plen = 0;
+	return pkt;
+}
+/* Optional pool of SRTP helper threads: when enabled, the srtp_protect
+ * calls (and the related sends) are taken off the handle loops, and done
+ * on a small pool of dedicated threads instead; each handle is statically
+ * mapped to one helper, so that all the crypto for a libsrtp context stays
+ * serialized on a single thread, as the library requires */
+typedef struct janus_ice_crypto_job {
+	janus_ice_handle *handle;
+	janus_ice_peerconnection *pc;
+	janus_ice_queued_packet *pkt;
+} janus_ice_crypto_job;
+static int crypto_helpers = 0;	/* Disabled by default */
+static GAsyncQueue **crypto_queues = NULL;
+static GThread **crypto_threads = NULL;
+static janus_ice_crypto_job janus_ice_crypto_exit;
+static void *janus_ice_crypto_helper_thread(void *data) {
+	GAsyncQueue *queue = data;
+	JANUS_LOG(LOG_VERB, "SRTP helper thread started\n");
+	janus_ice_crypto_job *job = NULL;
+	while((job = g_async_queue_pop(queue)) != NULL) {
+		if(job == &janus_ice_crypto_exit)
+			break;
+		janus_ice_handle *handle = job->handle;
+		janus_ice_peerconnection *pc = job->pc;
+		janus_ice_queued_packet *pkt = job->pkt;
+		if(!g_atomic_int_get(&pc->destroyed) && (!janus_is_webrtc_encryption_enabled() ||
+				(pc->dtls && pc->dtls->srtp_valid && pc->dtls->srtp_out))) {
+			int protected = pkt->length;
+			int res = srtp_err_status_ok;
+			if(janus_is_webrtc_encryption_enabled()) {
+				res = pkt->control ? srtp_protect_rtcp(pc->dtls->srtp_out, pkt->data, &protected) :
+					srtp_protect(pc->dtls->srtp_out, pkt->data, &protected);
+			}
+			JANUS_PROBE(srtp_protect, handle->handle_id, pkt->control, pkt->length, protected, res);
+			if(res != srtp_err_status_ok) {
+				/* As in the inline case, take note and print a summary later */
+				handle->srtp_errors_count++;
+				handle->last_srtp_error = res;
+				JANUS_LOG(LOG_DBG, "[%"SCNu64"] ... SRTP protect error... %s (len=%d-->%d)...\n",
+					handle->handle_id, janus_srtp_error_str(res), pkt->length, protected);
+			} else {
+				int sent = nice_agent_send(handle->agent, pc->stream_id, pc->component_id, protected, pkt->data);
+				JANUS_PROBE(socket_send, handle->handle_id, sent);
+				if(sent < protected) {
+					JANUS_LOG(LOG_ERR, "[%"SCNu64"] ... only sent %d bytes? (was %d)\n", handle->handle_id, sent, protected);
+				}
+			}
+		}
+		janus_refcount_decrease(&pc->ref);
+		janus_refcount_decrease(&handle->ref);
+		janus_ice_free_queued_packet(pkt);
+		g_free(job);
+	}
+	JANUS_LOG(LOG_VERB, "SRTP helper thread ended\n");
+	return NULL;
+}
+void janus_ice_set_srtp_helpers(int helpers) {
+	if(helpers < 0) {
+		JANUS_LOG(LOG_WARN, "Invalid number of SRTP helpers %d, keeping encryption inline\n", helpers);
+		return;
+	}
+	if(helpers == 0 || crypto_helpers > 0)
+		return;
+	crypto_queues = g_malloc0(sizeof(GAsyncQueue *)*helpers);
+	crypto_threads = g_malloc0(sizeof(GThread *)*helpers);
+	int i = 0;
+	for(i=0; i<helpers; i++) {
+		crypto_queues[i] = g_async_queue_new();
+		GError *error = NULL;
+		char tname[16];
+		g_snprintf(tname, sizeof(tname), "srtp %d", i);
+		crypto_threads[i] = g_thread_try_new(tname, &janus_ice_crypto_helper_thread, crypto_queues[i], &error);
+		if(error != NULL) {
+			JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch an SRTP helper thread...\n",
+				error->code, error->message ? error->message : "??");
+			g_error_free(error);
+			g_async_queue_unref(crypto_queues[i]);
+			crypto_queues[i] = NULL;
+			break;
+		}
+		crypto_helpers++;
+	}
+	if(crypto_helpers > 0)
+		JANUS_LOG(LOG_INFO, "Spawned %d SRTP helper threads (encryption will happen off the handle loops)\n", crypto_helpers);
+}
+int janus_ice_get_srtp_helpers(void) {
+	return crypto_helpers;
+}
+static void janus_ice_srtp_helpers_stop(void) {
+	if(crypto_helpers < 1)
+		return;
+	int i = 0;
+	for(i=0; i<crypto_helpers; i++)
+		g_async_queue_push(crypto_queues[i], &janus_ice_crypto_exit);
+	for(i=0; i<crypto_helpers; i++) {
+		g_thread_join(crypto_threads[i]);
+		g_async_queue_unref(crypto_queues[i]);
+	}
+	g_free(crypto_queues);
+	g_free(crypto_threads);
+	crypto_queues = NULL;
+	crypto_threads = NULL;
+	crypto_helpers = 0;
+}
+/* Helper to hand a packet over to the SRTP helper this handle maps to:
+ * returns FALSE if that's not possible, and encryption should stay inline */
+static gboolean janus_ice_crypto_offload(janus_ice_handle *handle, janus_ice_queued_packet *pkt) {
+	if(crypto_helpers < 1 || handle->pc == NULL)
+		return FALSE;
+	janus_ice_crypto_job *job = g_malloc(sizeof(janus_ice_crypto_job));
+	janus_refcount_increase(&handle->ref);
+	janus_refcount_increase(&handle->pc->ref);
+	job->handle = handle;
+	job->pc = handle->pc;
+	job->pkt = pkt;
+	g_async_queue_push(crypto_queues[handle->handle_id % crypto_helpers], job);
+	return TRUE;
+}
+/* Background reaper dead handles are handed over to: actually tearing a
+ * handle down can be expensive (queued packets, retransmit buffers, long
+ * refcount chains), and the last unref often comes from a plugin thread
+ * holding its own locks (e.g., a room being destroyed), so rather than
+ * freeing everything inline we take ownership of the dead handle right
+ * away, and do the actual work on this dedicated thread instead */
+static GAsyncQueue *reaper_queue = NULL;
+static GThread *reaper_thread = NULL;
+static janus_ice_handle janus_ice_reaper_exit;
+static void *janus_ice_handle_reaper_thread(void *data) {
+	GAsyncQueue *queue = data;
+	JANUS_LOG(LOG_VERB, "Handle reaper thread started\n");
+	janus_ice_handle *handle = NULL;
+	while((handle = g_async_queue_pop(queue)) != NULL) {
+		if(handle == &janus_ice_reaper_exit)
+			break;
+		janus_ice_handle_reap(handle);
+	}
+	JANUS_LOG(LOG_VERB, "Handle reaper thread ended\n");
+	return NULL;
+}
+static void janus_ice_handle_reaper_stop(void) {
+	if(reaper_thread == NULL)
+		return;
+	g_async_queue_push(reaper_queue, &janus_ice_reaper_exit);
+	g_thread_join(reaper_thread);
+	reaper_thread = NULL;
+	g_async_queue_unref(reaper_queue);
+	reaper_queue = NULL;
+}
+
 static void janus_ice_free_queued_packet(janus_ice_queued_packet *pkt) {
 	if(pkt == NULL || pkt == &janus_ice_start_gathering ||
 			pkt == &janus_ice_add_candidates ||
@@ -666,6 +1489,31 @@ static void janus_ice_free_queued_packet(janus_ice_queued_packet *pkt) {
 			pkt == &janus_ice_data_ready) {
 		return;
 	}
+	if(pkt->batched) {
+		/* This packet is now owned by the send batch of the outgoing traffic
+		 * source, which will free it for real when the batch is flushed */
+		return;
+	}
+	if(pkt->shared != NULL) {
+		/* We never got to copy the shared buffer, just release our reference */
+		janus_plugin_buffer_unref(pkt->shared);
+		pkt->shared = NULL;
+		pkt->shared_data = NULL;
+	}
+	if(pkt->pooled) {
+		/* This packet came from the pool: give it back, unless the pool
+		 * is already full (e.g., because the size was lowered meanwhile) */
+		g_clear_pointer(&pkt->label, g_free);
+		g_clear_pointer(&pkt->protocol, g_free);
+		janus_mutex_lock(&packet_pool_mutex);
+		if((int)g_queue_get_length(&packet_pool) < packet_pool_size) {
+			g_queue_push_head(&packet_pool, pkt);
+			pkt = NULL;
+		}
+		janus_mutex_unlock(&packet_pool_mutex);
+		if(pkt == NULL)
+			return;
+	}
 	g_free(pkt->data);
 	g_free(pkt->label);
 	g_free(pkt->protocol);
@@ -675,8 +1523,22 @@ static void janus_ice_free_queued_packet(janus_ice_queued_packet *pkt) {
 /* Minimum and maximum value, in milliseconds, for the NACK queue/retransmissions (default=200ms/1000ms) */
 #define DEFAULT_MIN_NACK_QUEUE	200
 #define DEFAULT_MAX_NACK_QUEUE	1000
+/* Number of slots in the per-medium ring of retransmittable packets: packets
+ * are indexed by sequence number, so lookups on incoming NACKs are O(1); the
+ * size is a power of two (so that we can mask) large enough to cover the
+ * maximum NACK queue history at high video rates, and a new packet landing
+ * on a taken slot simply replaces the (much older) previous occupant */
+#define JANUS_RETRANSMIT_RING_SIZE	2048
+#define JANUS_RETRANSMIT_RING_MASK	(JANUS_RETRANSMIT_RING_SIZE-1)
 /* Maximum ignore count after retransmission (200ms) */
 #define MAX_NACK_IGNORE			200000
+/* Number of slots in the per-PeerConnection circular arrival log we use for
+ * transport wide cc: arrivals are indexed by extended transport sequence
+ * number, so both logging a packet and walking the log to build the feedback
+ * message are allocation and sort free; the size is a power of two (so that
+ * we can mask) large enough to cover several feedback intervals at high rates */
+#define JANUS_ICE_TWCC_LOG_SIZE	2048
+#define JANUS_ICE_TWCC_LOG_MASK	(JANUS_ICE_TWCC_LOG_SIZE-1)
 
 static gboolean nack_optimizations = FALSE;
 void janus_set_nack_optimizations_enabled(gboolean optimize) {
@@ -708,18 +1570,15 @@ static void janus_cleanup_nack_buffer(gint64 now, janus_ice_peerconnection *pc,
 			continue;
 		if((medium->type == JANUS_MEDIA_AUDIO && !audio) || (medium->type == JANUS_MEDIA_VIDEO && !video))
 			continue;
-		if(medium->retransmit_buffer) {
-			janus_rtp_packet *p = (janus_rtp_packet *)g_queue_peek_head(medium->retransmit_buffer);
-			while(p && (!now || (now - p->created >= (gint64)medium->nack_queue_ms*1000))) {
-				/* Packet is too old, get rid of it */
-				g_queue_pop_head(medium->retransmit_buffer);
-				/* Remove from hashtable too */
-				janus_rtp_header *header = (janus_rtp_header *)p->data;
-				guint16 seq = ntohs(header->seq_number);
-				g_hash_table_remove(medium->retransmit_seqs, GUINT_TO_POINTER(seq));
-				/* Free the packet */
-				janus_ice_free_rtp_packet(p);
-				p = (janus_rtp_packet *)g_queue_peek_head(medium->retransmit_buffer);
+		if(medium->retransmit_ring) {
+			guint i = 0;
+			for(i=0; i<JANUS_RETRANSMIT_RING_SIZE; i++) {
+				janus_rtp_packet *p = medium->retransmit_ring[i];
+				if(p && (!now || (now - p->created >= (gint64)medium->nack_queue_ms*1000))) {
+					/* Packet is too old, get rid of it */
+					medium->retransmit_ring[i] = NULL;
+					janus_ice_free_rtp_packet(p);
+				}
 			}
 		}
 	}
@@ -728,44 +1587,14 @@ static void janus_cleanup_nack_buffer(gint64 now, janus_ice_peerconnection *pc,
 
 #define SEQ_MISSING_WAIT 12000 /*  12ms */
 #define SEQ_NACKED_WAIT 155000 /* 155ms */
-/* janus_seq_info list functions */
-static void janus_seq_append(janus_seq_info **head, janus_seq_info *new_seq) {
-	if(*head == NULL) {
-		new_seq->prev = new_seq;
-		new_seq->next = new_seq;
-		*head = new_seq;
-	} else {
-		janus_seq_info *last_seq = (*head)->prev;
-		new_seq->prev = last_seq;
-		new_seq->next = *head;
-		(*head)->prev = new_seq;
-		last_seq->next = new_seq;
-	}
-}
-static janus_seq_info *janus_seq_pop_head(janus_seq_info **head) {
-	janus_seq_info *pop_seq = *head;
-	if(pop_seq) {
-		janus_seq_info *new_head = pop_seq->next;
-		if(pop_seq == new_head || new_head == NULL) {
-			*head = NULL;
-		} else {
-			*head = new_head;
-			new_head->prev = pop_seq->prev;
-			new_head->prev->next = new_head;
-		}
-	}
-	return pop_seq;
-}
-void janus_seq_list_free(janus_seq_info **head) {
-	if(!*head)
+/* janus_seq_window functions */
+void janus_seq_window_reset(janus_seq_window *window) {
+	if(window == NULL)
 		return;
-	janus_seq_info *cur = *head;
-	do {
-		janus_seq_info *next = cur->next;
-		g_free(cur);
-		cur = next;
-	} while(cur != *head);
-	*head = NULL;
+	window->base_seq = 0;
+	window->last_seq = 0;
+	window->count = 0;
+	memset(window->received, 0, sizeof(window->received));
 }
 static int janus_seq_in_range(guint16 seqn, guint16 start, guint16 len) {
 	/* Supports wrapping sequence (easier with int range) */
@@ -811,6 +1640,9 @@ static void janus_ice_clear_queued_candidates(janus_ice_handle *handle) {
 	while(g_async_queue_length(handle->queued_candidates) > 0) {
 		(void)g_async_queue_try_pop(handle->queued_candidates);
 	}
+	/* Any pending request to process candidates is moot now, and the related
+	 * token may be getting flushed too: let new candidates wake the loop again */
+	g_atomic_int_set(&handle->candidates_pending, 0);
 }
 
 static void janus_ice_clear_queued_packets(janus_ice_handle *handle) {
@@ -856,7 +1688,7 @@ static void janus_ice_notify_trickle(janus_ice_handle *handle, char *buffer) {
 	janus_session_notify_event(session, event);
 }
 
-static void janus_ice_notify_media(janus_ice_handle *handle, char *mid, gboolean video, gboolean simulcast, int substream, gboolean up) {
+static void janus_ice_notify_media(janus_ice_handle *handle, const char *mid, gboolean video, gboolean simulcast, int substream, gboolean up) {
 	if(handle == NULL)
 		return;
 	/* Prepare JSON event to notify user/application */
@@ -866,7 +1698,7 @@ static void janus_ice_notify_media(janus_ice_handle *handle, char *mid, gboolean
 	if(session == NULL)
 		return;
 	json_t *event = json_object();
-	json_object_set_new(event, "janus", json_string("media"));
+	json_object_set(event, "janus", janus_json_media);
 	json_object_set_new(event, "session_id", json_integer(session->session_id));
 	json_object_set_new(event, "sender", json_integer(handle->handle_id));
 	if(opaqueid_in_api && handle->opaque_id != NULL)
@@ -924,7 +1756,7 @@ void janus_ice_notify_hangup(janus_ice_handle *handle, const char *reason) {
 	if(session == NULL)
 		return;
 	json_t *event = json_object();
-	json_object_set_new(event, "janus", json_string("hangup"));
+	json_object_set(event, "janus", janus_json_hangup);
 	json_object_set_new(event, "session_id", json_integer(session->session_id));
 	json_object_set_new(event, "sender", json_integer(handle->handle_id));
 	if(opaqueid_in_api && handle->opaque_id != NULL)
@@ -937,7 +1769,7 @@ void janus_ice_notify_hangup(janus_ice_handle *handle, const char *reason) {
 	/* Notify event handlers as well */
 	if(janus_events_is_enabled()) {
 		json_t *info = json_object();
-		json_object_set_new(info, "connection", json_string("hangup"));
+		json_object_set(info, "connection", janus_json_hangup);
 		if(reason != NULL)
 			json_object_set_new(info, "reason", json_string(reason));
 		janus_events_notify_handlers(JANUS_EVENT_TYPE_WEBRTC, JANUS_EVENT_SUBTYPE_WEBRTC_STATE,
@@ -1035,6 +1867,10 @@ void janus_ice_trickle_destroy(janus_ice_trickle *trickle) {
 /* libnice initialization */
 void janus_ice_init(gboolean ice_lite, gboolean ice_tcp, gboolean full_trickle, gboolean ignore_mdns,
 		gboolean ipv6, gboolean ipv6_linklocal, uint16_t rtp_min_port, uint16_t rtp_max_port) {
+	janus_json_media = janus_json_immortal_string("media");
+	janus_json_hangup = janus_json_immortal_string("hangup");
+	janus_json_webrtcup = janus_json_immortal_string("webrtcup");
+	janus_json_slowlink = janus_json_immortal_string("slowlink");
 	janus_ice_lite_enabled = ice_lite;
 	janus_ice_tcp_enabled = ice_tcp;
 	janus_full_trickle_enabled = full_trickle;
@@ -1082,6 +1918,18 @@ void janus_ice_init(gboolean ice_lite, gboolean ice_tcp, gboolean full_trickle,
 	plugin_sessions = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_plugin_session_dereference);
 	janus_mutex_init(&plugin_sessions_mutex);
 
+	/* Start the reaper thread dead handles will be handed over to */
+	reaper_queue = g_async_queue_new();
+	GError *error = NULL;
+	reaper_thread = g_thread_try_new("ice reaper", &janus_ice_handle_reaper_thread, reaper_queue, &error);
+	if(error != NULL) {
+		JANUS_LOG(LOG_WARN, "Got error %d (%s) trying to launch the handle reaper thread, dead handles will be freed inline\n",
+			error->code, error->message ? error->message : "??");
+		g_error_free(error);
+		g_async_queue_unref(reaper_queue);
+		reaper_queue = NULL;
+	}
+
 #ifdef HAVE_TURNRESTAPI
 	/* Initialize the TURN REST API client stack, whether we're going to use it or not */
 	janus_turnrest_init();
@@ -1090,6 +1938,9 @@ void janus_ice_init(gboolean ice_lite, gboolean ice_tcp, gboolean full_trickle,
 }
 
 void janus_ice_deinit(void) {
+	janus_ice_handle_reaper_stop();
+	janus_ice_srtp_helpers_stop();
+	janus_ice_packet_pool_destroy();
 #ifdef HAVE_TURNRESTAPI
 	janus_turnrest_deinit();
 #endif
@@ -1410,6 +2261,8 @@ janus_ice_handle *janus_ice_handle_create(void *core_session, const char *opaque
 	handle->app_handle = NULL;
 	handle->queued_candidates = g_async_queue_new();
 	handle->queued_packets = g_async_queue_new();
+	handle->timer_wheel_slot = -1;
+	janus_rate_limiter_init(&handle->media_limiter, janus_ice_media_rate_limit);
 	janus_mutex_init(&handle->mutex);
 	janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ALERT);
 	janus_session_handles_insert(session, handle);
@@ -1467,21 +2320,51 @@ gint janus_ice_handle_attach_plugin(void *core_session, janus_ice_handle *handle
 			if(loop == NULL) {
 				JANUS_LOG(LOG_WARN, "[%"SCNu64"] Invalid loop index %d, picking event loop automatically\n", handle->handle_id, loop_index);
 			} else {
+				if(loop->numa_node > -1 && g_atomic_int_get(&loop->busy)) {
+					/* The indicated loop was flagged as busy by a rebalance:
+					 * since loops are pinned and we know which NUMA node this
+					 * one lives on, look for a quieter loop on the same node,
+					 * so that the caller keeps the memory locality they asked
+					 * for (e.g., subscribers colocated with their publisher)
+					 * without piling more handles on the hot loop */
+					janus_ice_static_event_loop *sibling = NULL;
+					GSList *l = event_loops;
+					while(l) {
+						janus_ice_static_event_loop *el = (janus_ice_static_event_loop *)l->data;
+						if(el != loop && el->numa_node == loop->numa_node && !g_atomic_int_get(&el->busy) &&
+								(sibling == NULL || el->handles < sibling->handles))
+							sibling = el;
+						l = l->next;
+					}
+					if(sibling != NULL) {
+						JANUS_LOG(LOG_VERB, "[%"SCNu64"] Loop #%d is busy, using loop #%d on the same NUMA node (%d) instead\n",
+							handle->handle_id, loop->id, sibling->id, loop->numa_node);
+						loop = sibling;
+					}
+				}
 				janus_refcount_increase(&loop->ref);
 				automatic_selection = FALSE;
 				handle->mainctx = loop->mainctx;
 				handle->mainloop = loop->mainloop;
+				handle->static_event_loop = loop;
 				loop->handles++;
 				JANUS_LOG(LOG_VERB, "[%"SCNu64"] Manually added handle to loop #%d\n", handle->handle_id, loop->id);
 			}
 		}
 		if(automatic_selection) {
-			/* Pick an available loop automatically (least loaded) */
+			/* Pick an available loop automatically (least loaded, skipping
+			 * the loops a rebalance may have flagged as busy, if possible) */
 			int handles = -1;
-			janus_ice_static_event_loop *loop = NULL;
+			janus_ice_static_event_loop *loop = NULL, *fallback = NULL;
 			GSList *l = event_loops;
 			while(l) {
 				janus_ice_static_event_loop *el = (janus_ice_static_event_loop *)l->data;
+				if(g_atomic_int_get(&el->busy)) {
+					if(fallback == NULL || el->handles < fallback->handles)
+						fallback = el;
+					l = l->next;
+					continue;
+				}
 				if(el->handles == 0) {
 					/* Best option, stop here */
 					loop = el;
@@ -1493,6 +2376,8 @@ gint janus_ice_handle_attach_plugin(void *core_session, janus_ice_handle *handle
 				}
 				l = l->next;
 			}
+			if(loop == NULL)
+				loop = fallback;
 			janus_refcount_increase(&loop->ref);
 			loop->handles++;
 			handle->mainctx = loop->mainctx;
@@ -1530,7 +2415,7 @@ gint janus_ice_handle_attach_plugin(void *core_session, janus_ice_handle *handle
 }
 
 gint janus_ice_handle_destroy(void *core_session, janus_ice_handle *handle) {
-	/* session->mutex has to be locked when calling this function */
+	/* session->handles_lock has to be held for writing when calling this function */
 	janus_session *session = (janus_session *)core_session;
 	if(session == NULL)
 		return JANUS_ERROR_SESSION_NOT_FOUND;
@@ -1595,6 +2480,17 @@ gint janus_ice_handle_destroy(void *core_session, janus_ice_handle *handle) {
 
 static void janus_ice_handle_free(const janus_refcount *handle_ref) {
 	janus_ice_handle *handle = janus_refcount_containerof(handle_ref, janus_ice_handle, ref);
+	/* Nobody references this handle anymore: rather than freeing everything
+	 * inline (which may stall whoever dropped the last reference, e.g., a
+	 * plugin destroying a room), hand ownership over to the reaper thread */
+	if(reaper_queue != NULL) {
+		g_async_queue_push(reaper_queue, handle);
+		return;
+	}
+	janus_ice_handle_reap(handle);
+}
+
+static void janus_ice_handle_reap(janus_ice_handle *handle) {
 	/* This stack can be destroyed, free all the resources */
 	janus_mutex_lock(&handle->mutex);
 	if(handle->queued_candidates != NULL) {
@@ -1605,6 +2501,10 @@ static void janus_ice_handle_free(const janus_refcount *handle_ref) {
 		janus_ice_clear_queued_packets(handle);
 		g_async_queue_unref(handle->queued_packets);
 	}
+	if(handle->packet_ring != NULL) {
+		janus_ice_packet_ring_destroy(handle->packet_ring);
+		handle->packet_ring = NULL;
+	}
 	if(static_event_loops == 0 && handle->mainloop != NULL) {
 		g_main_loop_unref(handle->mainloop);
 		handle->mainloop = NULL;
@@ -1684,6 +2584,8 @@ void janus_ice_webrtc_hangup(janus_ice_handle *handle, const char *reason) {
 static void janus_ice_webrtc_free(janus_ice_handle *handle) {
 	if(handle == NULL)
 		return;
+	/* In case incoming RTP was bridged to another handle, tear the bridge down */
+	janus_ice_set_media_bridge(handle, NULL);
 	janus_mutex_lock(&handle->mutex);
 	if(!handle->agent_created) {
 		janus_flags_clear(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_NEW_DATACHAN_SDP);
@@ -1764,6 +2666,8 @@ void janus_ice_peerconnection_destroy(janus_ice_peerconnection *pc) {
 	if(pc == NULL)
 		return;
 	/* Remove all media instances */
+	pc->ssrc_in_cached = 0;
+	pc->medium_in_cached = NULL;
 	g_hash_table_remove_all(pc->media);
 	g_hash_table_remove_all(pc->media_byssrc);
 	g_hash_table_remove_all(pc->media_bymid);
@@ -1808,8 +2712,8 @@ static void janus_ice_peerconnection_free(const janus_refcount *pc_ref) {
 	pc->ruser = NULL;
 	g_free(pc->rpass);
 	pc->rpass = NULL;
-	g_slist_free_full(pc->transport_wide_received_seq_nums, (GDestroyNotify)g_free);
-	pc->transport_wide_received_seq_nums = NULL;
+	g_free(pc->transport_wide_cc_log);
+	pc->transport_wide_cc_log = NULL;
 	if(pc->candidates != NULL) {
 		GSList *i = NULL, *candidates = pc->candidates;
 		for(i = candidates; i; i = i->next) {
@@ -1923,7 +2827,6 @@ static void janus_ice_peerconnection_medium_dereference(janus_ice_peerconnection
 
 static void janus_ice_peerconnection_medium_free(const janus_refcount *medium_ref) {
 	janus_ice_peerconnection_medium *medium = janus_refcount_containerof(medium_ref, janus_ice_peerconnection_medium, ref);
-	g_free(medium->mid);
 	g_free(medium->msid);
 	g_free(medium->mstid);
 	g_free(medium->remote_msid);
@@ -1970,25 +2873,19 @@ static void janus_ice_peerconnection_medium_free(const janus_refcount *medium_re
 		g_hash_table_destroy(medium->pending_nacked_cleanup);
 	}
 	medium->pending_nacked_cleanup = NULL;
-	if(medium->retransmit_buffer != NULL) {
-		janus_rtp_packet *p = NULL;
-		while((p = (janus_rtp_packet *)g_queue_pop_head(medium->retransmit_buffer)) != NULL) {
-			/* Remove from hashtable too */
-			janus_rtp_header *header = (janus_rtp_header *)p->data;
-			guint16 seq = ntohs(header->seq_number);
-			g_hash_table_remove(medium->retransmit_seqs, GUINT_TO_POINTER(seq));
-			/* Free the packet */
-			janus_ice_free_rtp_packet(p);
-		}
-		g_queue_free(medium->retransmit_buffer);
-		g_hash_table_destroy(medium->retransmit_seqs);
-	}
-	if(medium->last_seqs[0])
-		janus_seq_list_free(&medium->last_seqs[0]);
-	if(medium->last_seqs[1])
-		janus_seq_list_free(&medium->last_seqs[1]);
-	if(medium->last_seqs[2])
-		janus_seq_list_free(&medium->last_seqs[2]);
+	if(medium->retransmit_ring != NULL) {
+		guint i = 0;
+		for(i=0; i<JANUS_RETRANSMIT_RING_SIZE; i++)
+			janus_ice_free_rtp_packet(medium->retransmit_ring[i]);
+		g_free(medium->retransmit_ring);
+		medium->retransmit_ring = NULL;
+	}
+	g_free(medium->last_seqs[0]);
+	medium->last_seqs[0] = NULL;
+	g_free(medium->last_seqs[1]);
+	medium->last_seqs[1] = NULL;
+	g_free(medium->last_seqs[2]);
+	medium->last_seqs[2] = NULL;
 	g_free(medium);
 	//~ janus_mutex_unlock(&handle->mutex);
 }
@@ -2011,7 +2908,7 @@ janus_slow_link_update(janus_ice_peerconnection_medium *medium, janus_ice_handle
 		janus_session *session = (janus_session *)handle->session;
 		if(session != NULL) {
 			json_t *event = json_object();
-			json_object_set_new(event, "janus", json_string("slowlink"));
+			json_object_set(event, "janus", janus_json_slowlink);
 			json_object_set_new(event, "session_id", json_integer(session->session_id));
 			json_object_set_new(event, "sender", json_integer(handle->handle_id));
 			if(opaqueid_in_api && handle->opaque_id != NULL)
@@ -2258,6 +3155,17 @@ static void janus_ice_cb_new_selected_pair (NiceAgent *agent, guint stream_id, g
 		newpair = TRUE;
 		gchar *prev_selected_pair = pc->selected_pair;
 		pc->selected_pair = g_strdup(sp);
+		if(prev_selected_pair != NULL && pc->connected > 0) {
+			/* The media path migrated after the connection was already up:
+			 * with aggressive nomination libnice seamlessly switches to a
+			 * better pair that completes later (e.g., a direct path becoming
+			 * viable again after a client roamed back from a relay), so keep
+			 * track of these changes and surface them via the Admin API */
+			pc->selected_pair_changes++;
+			pc->selected_pair_changed = janus_get_monotonic_time();
+			JANUS_LOG(LOG_INFO, "[%"SCNu64"] Selected pair changed: %s (was %s)\n",
+				handle->handle_id, sp, prev_selected_pair);
+		}
 		g_clear_pointer(&prev_selected_pair, g_free);
 	}
 	/* Notify event handlers */
@@ -2312,14 +3220,19 @@ static void janus_ice_cb_new_local_candidate (NiceAgent *agent, guint stream_id,
 #else
 static void janus_ice_cb_new_local_candidate (NiceAgent *agent, NiceCandidate *candidate, gpointer ice) {
 #endif
-	if(!janus_full_trickle_enabled) {
-		/* Ignore if we're not full-trickling: for half-trickle
-		 * janus_ice_candidates_to_sdp() is used instead */
-		return;
-	}
 	janus_ice_handle *handle = (janus_ice_handle *)ice;
 	if(!handle)
 		return;
+	if(!janus_full_trickle_enabled) {
+		/* If we're not full-trickling, candidates are put in the SDP by
+		 * janus_ice_candidates_to_sdp() instead: the exception is candidates
+		 * gathered after the SDP has already been sent (e.g., because STUN
+		 * or TURN were slow and we stopped waiting), which we trickle to
+		 * trickle-capable peers rather than just losing them */
+		if(!janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_SDP_SENT) ||
+				!janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_TRICKLE))
+			return;
+	}
 #ifndef HAVE_LIBNICE_TCP
 	JANUS_LOG(LOG_VERB, "[%"SCNu64"] Discovered new local candidate for component %d in stream %d: foundation=%s\n", handle ? handle->handle_id : 0, component_id, stream_id, foundation);
 #else
@@ -2595,7 +3508,24 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 		}
 		return;
 	}
-	/* Not DTLS... RTP or RTCP? (http://tools.ietf.org/html/rfc5761#section-4) */
+	/* Not DTLS... before we go on, check the media rate limiter, if a cap
+	 * is configured: packets beyond the cap are dropped right here, before
+	 * we spend any SRTP or demultiplexing work on them */
+	if(!janus_rate_limiter_consume(&handle->media_limiter)) {
+		if(janus_rate_limiter_tripped(&handle->media_limiter)) {
+			JANUS_LOG(LOG_WARN, "[%"SCNu64"] Incoming media exceeds the configured rate limit (%d packets per second), dropping packets\n",
+				handle->handle_id, handle->media_limiter.rate);
+			if(janus_events_is_enabled()) {
+				json_t *info = json_object();
+				json_object_set_new(info, "ratelimit", json_string("media"));
+				json_object_set_new(info, "rate", json_integer(handle->media_limiter.rate));
+				janus_events_notify_handlers(JANUS_EVENT_TYPE_CORE, JANUS_EVENT_SUBTYPE_CORE_RATELIMIT,
+					session ? session->session_id : 0, info);
+			}
+		}
+		return;
+	}
+	/* RTP or RTCP? (http://tools.ietf.org/html/rfc5761#section-4) */
 	if(janus_is_rtp(buf, len)) {
 		/* This is RTP */
 		if(janus_is_webrtc_encryption_enabled() && (!pc->dtls || !pc->dtls->srtp_valid || !pc->dtls->srtp_in)) {
@@ -2603,9 +3533,23 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 		} else {
 			janus_rtp_header *header = (janus_rtp_header *)buf;
 			guint32 packet_ssrc = ntohl(header->ssrc);
-			/* Which medium does this refer to? Is this audio or video? */
+			/* Which medium does this refer to? Is this audio or video? Since
+			 * consecutive packets almost always belong to the same stream, we
+			 * check the last SSRC we demultiplexed first, to avoid a hash
+			 * table lookup per packet: this callback and the code tearing the
+			 * media instances down both run on the ICE loop thread, so the
+			 * cached pointer can't be pulled from under our feet */
 			int video = 0, vindex = 0, rtx = 0;
-			janus_ice_peerconnection_medium *medium = g_hash_table_lookup(pc->media_byssrc, GINT_TO_POINTER(packet_ssrc));
+			janus_ice_peerconnection_medium *medium = NULL;
+			if(pc->medium_in_cached != NULL && pc->ssrc_in_cached == packet_ssrc) {
+				medium = pc->medium_in_cached;
+			} else {
+				medium = g_hash_table_lookup(pc->media_byssrc, GINT_TO_POINTER(packet_ssrc));
+				if(medium != NULL) {
+					pc->ssrc_in_cached = packet_ssrc;
+					pc->medium_in_cached = medium;
+				}
+			}
 			if(medium == NULL) {
 				/* SSRC not found, try the mid/rid RTP extensions if in use */
 				if(pc->mid_ext_id > 0) {
@@ -2664,6 +3608,8 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 							if(found) {
 								g_hash_table_insert(pc->media_byssrc, GINT_TO_POINTER(packet_ssrc), medium);
 								janus_refcount_increase(&medium->ref);
+								pc->ssrc_in_cached = packet_ssrc;
+								pc->medium_in_cached = medium;
 							} else {
 								medium = NULL;
 							}
@@ -2723,6 +3669,7 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 					JANUS_LOG(LOG_ERR, "[%"SCNu64"]     SRTP unprotect error: %s (len=%d-->%d, ts=%"SCNu32", seq=%"SCNu16")\n", handle->handle_id, janus_srtp_error_str(res), len, buflen, timestamp, seq);
 				}
 			} else {
+				JANUS_PROBE(incoming_rtp, handle->handle_id, video, vindex, buflen);
 				if((!video && medium->ssrc_peer[0] == 0) || (vindex == 0 && medium->ssrc_peer[0] == 0)) {
 					medium->ssrc_peer[0] = ntohl(header->ssrc);
 					JANUS_LOG(LOG_VERB, "[%"SCNu64"]     Peer #%d (%s) SSRC: %u\n",
@@ -2769,8 +3716,6 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 						/* Get current timestamp */
 						struct timeval now;
 						gettimeofday(&now,0);
-						/* Create <seq num, time> pair */
-						janus_rtcp_transport_wide_cc_stats *stats = g_malloc0(sizeof(janus_rtcp_transport_wide_cc_stats));
 						/* Check if we have a sequence wrap */
 						if(transport_seq_num<0x0FFF && (pc->transport_wide_cc_last_seq_num&0xFFFF)>0xF000) {
 							/* Increase cycles */
@@ -2780,12 +3725,19 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 						guint32 transport_ext_seq_num = pc->transport_wide_cc_cycles<<16 | transport_seq_num;
 						/* Store last received transport seq num */
 						pc->transport_wide_cc_last_seq_num = transport_seq_num;
-						/* Set stats values */
+						/* Log the <seq num, time> pair in the circular arrival log */
+						janus_mutex_lock(&pc->mutex);
+						if(pc->transport_wide_cc_log == NULL) {
+							/* First logged packet, allocate the log in one go */
+							pc->transport_wide_cc_log = g_malloc0(JANUS_ICE_TWCC_LOG_SIZE*sizeof(janus_rtcp_transport_wide_cc_stats));
+							pc->transport_wide_cc_first_seq_num = transport_ext_seq_num;
+						}
+						janus_rtcp_transport_wide_cc_stats *stats =
+							&pc->transport_wide_cc_log[transport_ext_seq_num & JANUS_ICE_TWCC_LOG_MASK];
 						stats->transport_seq_num = transport_ext_seq_num;
 						stats->timestamp = (((guint64)now.tv_sec)*1E6+now.tv_usec);
-						/* Lock and append to received list */
-						janus_mutex_lock(&pc->mutex);
-						pc->transport_wide_received_seq_nums = g_slist_prepend(pc->transport_wide_received_seq_nums, stats);
+						if(transport_ext_seq_num > pc->transport_wide_cc_last_ext_seq_num)
+							pc->transport_wide_cc_last_ext_seq_num = transport_ext_seq_num;
 						janus_mutex_unlock(&pc->mutex);
 					}
 				}
@@ -2854,11 +3806,15 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 				/* Prepare the data to pass to the responsible plugin */
 				janus_plugin_rtp rtp = { .mindex = medium->mindex, .video = video, .buffer = buf, .length = buflen };
 				janus_plugin_rtp_extensions_reset(&rtp.extensions);
-				/* Parse RTP extensions before involving the plugin */
+				/* Parse RTP extensions before involving the plugin: we index the
+				 * extension block once, so that each negotiated extension can be
+				 * read from the index without rescanning the packet every time */
+				janus_rtp_header_extension_index extmap;
+				janus_rtp_header_extensions_index(buf, buflen, &extmap);
 				if(!video && pc->audiolevel_ext_id != -1) {
 					gboolean vad = FALSE;
 					int level = -1;
-					if(janus_rtp_header_extension_parse_audio_level(buf, buflen,
+					if(janus_rtp_header_extension_parse_audio_level_indexed(&extmap, buf,
 							pc->audiolevel_ext_id, &vad, &level) == 0) {
 						rtp.extensions.audio_level = level;
 						rtp.extensions.audio_level_vad = vad;
@@ -2866,7 +3822,7 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 				}
 				if(video && pc->videoorientation_ext_id != -1) {
 					gboolean c = FALSE, f = FALSE, r1 = FALSE, r0 = FALSE;
-					if(janus_rtp_header_extension_parse_video_orientation(buf, buflen,
+					if(janus_rtp_header_extension_parse_video_orientation_indexed(&extmap, buf,
 							pc->videoorientation_ext_id, &c, &f, &r1, &r0) == 0) {
 						rtp.extensions.video_rotation = 0;
 						if(r1 && r0)
@@ -2881,7 +3837,7 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 				}
 				if(video && pc->playoutdelay_ext_id != -1) {
 					uint16_t min = 0, max = 0;
-					if(janus_rtp_header_extension_parse_playout_delay(buf, buflen,
+					if(janus_rtp_header_extension_parse_playout_delay_indexed(&extmap, buf,
 							pc->playoutdelay_ext_id, &min, &max) == 0) {
 						rtp.extensions.min_delay = min;
 						rtp.extensions.max_delay = max;
@@ -2890,7 +3846,7 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 				if(video && pc->dependencydesc_ext_id != -1) {
 					uint8_t dd[256];
 					int len = sizeof(dd);
-					if(janus_rtp_header_extension_parse_dependency_desc(buf, buflen,
+					if(janus_rtp_header_extension_parse_dependency_desc_indexed(&extmap, buf, buflen,
 							pc->dependencydesc_ext_id, dd, &len) == 0 && len > 0) {
 						/* We copy the DD bytes as they are: it's up to plugins to parse it, if needed */
 						rtp.extensions.dd_len = len;
@@ -2899,17 +3855,32 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 				}
 				if(pc->abs_capture_time_ext_id != -1) {
 					uint64_t abs_ts = 0;
-					if(janus_rtp_header_extension_parse_abs_capture_time(buf, buflen,
+					if(janus_rtp_header_extension_parse_abs_capture_time_indexed(&extmap, buf,
 							pc->abs_capture_time_ext_id, &abs_ts) == 0) {
 						rtp.extensions.abs_capture_ts = abs_ts;
 					}
 				}
-				/* Pass the packet to the plugin */
-				janus_plugin *plugin = (janus_plugin *)handle->app;
-				if(plugin && plugin->incoming_rtp && handle->app_handle &&
-						!g_atomic_int_get(&handle->app_handle->stopped) &&
-						!g_atomic_int_get(&handle->destroyed))
-					plugin->incoming_rtp(handle->app_handle, &rtp);
+				/* Check if we should bridge this packet to another handle directly */
+				janus_ice_handle *bridged = (janus_ice_handle *)g_atomic_pointer_get(&handle->bridged_handle);
+				if(bridged != NULL) {
+					/* There's a core-level bridge, relay the packet to the other
+					 * handle ourselves and don't bother the plugin at all */
+					janus_refcount_increase(&bridged->ref);
+					if(!g_atomic_int_get(&bridged->destroyed) &&
+							!janus_flags_is_set(&bridged->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_STOP) &&
+							!janus_flags_is_set(&bridged->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ALERT))
+						janus_ice_relay_rtp(bridged, &rtp);
+					janus_refcount_decrease(&bridged->ref);
+				} else {
+					/* Pass the packet to the plugin */
+					janus_plugin *plugin = (janus_plugin *)handle->app;
+					if(plugin && plugin->incoming_rtp && handle->app_handle &&
+							!g_atomic_int_get(&handle->app_handle->stopped) &&
+							!g_atomic_int_get(&handle->destroyed)) {
+						JANUS_PROBE(plugin_handoff, handle->handle_id, video, buflen);
+						plugin->incoming_rtp(handle->app_handle, &rtp);
+					}
+				}
 				/* Restore the header for the stats (plugins may have messed with it) */
 				*header = backup;
 				/* Update stats (overall data received, and data received in the last second) */
@@ -2923,6 +3894,7 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 					/* Overall video data for this SSRC */
 					medium->in_stats.info[vindex].packets++;
 					medium->in_stats.info[vindex].bytes += buflen;
+					janus_metrics_account_rtp(FALSE, medium->type == JANUS_MEDIA_VIDEO, buflen);
 					/* Last second video data for this SSRC */
 					if(medium->in_stats.info[vindex].updated == 0)
 						medium->in_stats.info[vindex].updated = now;
@@ -2951,23 +3923,29 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 					return;
 				}
 				guint16 new_seqn = ntohs(header->seq_number);
-				/* If this is video, check if this is a keyframe: if so, we empty our NACK queue */
+				/* If this is video, check if this is a keyframe: if so, we empty our NACK queue.
+				 * All packets of a frame share the RTP timestamp, so it's enough to only
+				 * parse the payload of the first packet we see of each new frame */
 				if(video && medium->video_is_keyframe) {
-					if(medium->video_is_keyframe(payload, plen)) {
-						if(rtcp_ctx && (int16_t)(new_seqn - rtcp_ctx->max_seq_nr) > 0) {
-							JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Keyframe received with a highest sequence number, resetting NACK queue\n", handle->handle_id);
-							janus_seq_list_free(&medium->last_seqs[vindex]);
+					guint32 frame_ts = ntohl(header->timestamp);
+					if(!medium->kf_checked_in[vindex] || medium->kf_check_in_ts[vindex] != frame_ts) {
+						medium->kf_checked_in[vindex] = TRUE;
+						medium->kf_check_in_ts[vindex] = frame_ts;
+						if(medium->video_is_keyframe(payload, plen)) {
+							if(rtcp_ctx && (int16_t)(new_seqn - rtcp_ctx->max_seq_nr) > 0) {
+								JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Keyframe received with a highest sequence number, resetting NACK queue\n", handle->handle_id);
+								janus_seq_window_reset(medium->last_seqs[vindex]);
+							}
 						}
 					}
 				}
 				guint16 cur_seqn;
-				int last_seqs_len = 0;
 				janus_mutex_lock(&medium->mutex);
-				janus_seq_info **last_seqs = &medium->last_seqs[vindex];
-				janus_seq_info *cur_seq = *last_seqs;
-				if(cur_seq) {
-					cur_seq = cur_seq->prev;
-					cur_seqn = cur_seq->seq;
+				if(medium->last_seqs[vindex] == NULL)
+					medium->last_seqs[vindex] = g_malloc0(sizeof(janus_seq_window));
+				janus_seq_window *window = medium->last_seqs[vindex];
+				if(window->count > 0) {
+					cur_seqn = window->last_seq;
 				} else {
 					/* First seq, set up to add one seq */
 					cur_seqn = new_seqn - (guint16)1; /* Can wrap */
@@ -2977,8 +3955,7 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 					/* Jump too big, start fresh */
 					JANUS_LOG(LOG_WARN, "[%"SCNu64"] Big sequence number jump %hu -> %hu (%s stream #%d)\n",
 						handle->handle_id, cur_seqn, new_seqn, video ? "video" : "audio", vindex);
-					janus_seq_list_free(last_seqs);
-					cur_seq = NULL;
+					janus_seq_window_reset(window);
 					cur_seqn = new_seqn - (guint16)1;
 				}
 
@@ -2986,68 +3963,84 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 				gint64 now = janus_get_monotonic_time();
 
 				if(janus_seq_in_range(new_seqn, cur_seqn, LAST_SEQS_MAX_LEN)) {
-					/* Add new seq objs forward */
+					/* Track all the seqs up to the new one: the new one is
+					 * received, any gap in between starts out as missing */
 					while(cur_seqn != new_seqn) {
 						cur_seqn += (guint16)1; /* can wrap */
-						janus_seq_info *seq_obj = g_malloc0(sizeof(janus_seq_info));
-						seq_obj->seq = cur_seqn;
-						seq_obj->ts = now;
-						seq_obj->state = (cur_seqn == new_seqn) ? SEQ_RECVED : SEQ_MISSING;
-						janus_seq_append(last_seqs, seq_obj);
-						last_seqs_len++;
+						guint slot = cur_seqn & JANUS_SEQ_WINDOW_MASK;
+						window->states[slot] = (cur_seqn == new_seqn) ? SEQ_RECVED : SEQ_MISSING;
+						window->ts[slot] = now;
+						if(cur_seqn == new_seqn)
+							window->received[slot/64] |= ((guint64)1 << (slot%64));
+						else
+							window->received[slot/64] &= ~((guint64)1 << (slot%64));
+						window->last_seq = cur_seqn;
+						if(window->count == 0)
+							window->base_seq = cur_seqn;
+						if(window->count < LAST_SEQS_MAX_LEN)
+							window->count++;
+						else
+							window->base_seq++;	/* The oldest tracked seq falls off */
+					}
+				} else if(window->count > 0 && janus_seq_in_range(new_seqn, window->base_seq, window->count)) {
+					/* An older packet we were still tracking, mark it as received */
+					guint slot = new_seqn & JANUS_SEQ_WINDOW_MASK;
+					if(window->states[slot] != SEQ_RECVED) {
+						JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Received missed sequence number %"SCNu16" (%s stream #%d)\n",
+							handle->handle_id, new_seqn, video ? "video" : "audio", vindex);
 					}
+					window->states[slot] = SEQ_RECVED;
+					window->received[slot/64] |= ((guint64)1 << (slot%64));
 				}
-				if(cur_seq) {
-					/* Scan old seq objs backwards */
-					while(cur_seq != NULL) {
-						last_seqs_len++;
-						if(cur_seq->seq == new_seqn) {
-							JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Received missed sequence number %"SCNu16" (%s stream #%d)\n",
-								handle->handle_id, cur_seq->seq, video ? "video" : "audio", vindex);
-							cur_seq->state = SEQ_RECVED;
-						} else if(cur_seq->state == SEQ_MISSING && now - cur_seq->ts > SEQ_MISSING_WAIT) {
-							JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Missed sequence number %"SCNu16" (%s stream #%d), sending 1st NACK\n",
-								handle->handle_id, cur_seq->seq, video ? "video" : "audio", vindex);
-							nacks = g_slist_prepend(nacks, GUINT_TO_POINTER(cur_seq->seq));
-							cur_seq->state = SEQ_NACKED;
-							if(video && janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_RFC4588_RTX)) {
-								/* Keep track of this sequence number, we need to avoid duplicates */
-								JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Tracking NACKed packet %"SCNu16" (SSRC %"SCNu32", vindex %d)...\n",
-									handle->handle_id, cur_seq->seq, packet_ssrc, vindex);
-								if(medium->rtx_nacked[vindex] == NULL)
-									medium->rtx_nacked[vindex] = g_hash_table_new(NULL, NULL);
-								g_hash_table_insert(medium->rtx_nacked[vindex], GUINT_TO_POINTER(cur_seq->seq), GINT_TO_POINTER(1));
-								/* We don't track it forever, though: add a timed source to remove it in a few seconds */
-								janus_ice_nacked_packet *np = g_malloc(sizeof(janus_ice_nacked_packet));
-								np->medium = medium;
-								np->seq_number = cur_seq->seq;
-								np->vindex = vindex;
-								if(medium->pending_nacked_cleanup == NULL)
-									medium->pending_nacked_cleanup = g_hash_table_new(NULL, NULL);
-								GSource *timeout_source = g_timeout_source_new_seconds(5);
-								g_source_set_callback(timeout_source, janus_ice_nacked_packet_cleanup, np, (GDestroyNotify)g_free);
-								np->source_id = g_source_attach(timeout_source, handle->mainctx);
-								g_source_unref(timeout_source);
-								g_hash_table_insert(medium->pending_nacked_cleanup, GUINT_TO_POINTER(np->source_id), timeout_source);
-							}
-						} else if(cur_seq->state == SEQ_NACKED  && now - cur_seq->ts > SEQ_NACKED_WAIT) {
-							JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Missed sequence number %"SCNu16" (%s stream #%d), sending 2nd NACK\n",
-								handle->handle_id, cur_seq->seq, video ? "video" : "audio", vindex);
-							nacks = g_slist_prepend(nacks, GUINT_TO_POINTER(cur_seq->seq));
-							cur_seq->state = SEQ_GIVEUP;
-						}
-						if(cur_seq == *last_seqs) {
-							/* Just processed head */
-							break;
+				/* Now scan the window for gaps we should NACK: whenever a whole
+				 * word of the received bitmap is set, 64 seqs were all received
+				 * and we can skip them in one go */
+				guint16 seq = window->base_seq;
+				guint remaining = window->count;
+				while(remaining > 0) {
+					guint slot = seq & JANUS_SEQ_WINDOW_MASK;
+					if((slot%64) == 0 && remaining >= 64 && window->received[slot/64] == G_MAXUINT64) {
+						seq += 64;
+						remaining -= 64;
+						continue;
+					}
+					if(window->states[slot] == SEQ_MISSING && now - window->ts[slot] > SEQ_MISSING_WAIT) {
+						JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Missed sequence number %"SCNu16" (%s stream #%d), sending 1st NACK\n",
+							handle->handle_id, seq, video ? "video" : "audio", vindex);
+						nacks = g_slist_prepend(nacks, GUINT_TO_POINTER(seq));
+						window->states[slot] = SEQ_NACKED;
+						if(video && janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_RFC4588_RTX)) {
+							/* Keep track of this sequence number, we need to avoid duplicates */
+							JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Tracking NACKed packet %"SCNu16" (SSRC %"SCNu32", vindex %d)...\n",
+								handle->handle_id, seq, packet_ssrc, vindex);
+							if(medium->rtx_nacked[vindex] == NULL)
+								medium->rtx_nacked[vindex] = g_hash_table_new(NULL, NULL);
+							g_hash_table_insert(medium->rtx_nacked[vindex], GUINT_TO_POINTER(seq), GINT_TO_POINTER(1));
+							/* We don't track it forever, though: add a timed source to remove it in a few seconds */
+							janus_ice_nacked_packet *np = g_malloc(sizeof(janus_ice_nacked_packet));
+							np->medium = medium;
+							np->seq_number = seq;
+							np->vindex = vindex;
+							if(medium->pending_nacked_cleanup == NULL)
+								medium->pending_nacked_cleanup = g_hash_table_new(NULL, NULL);
+							GSource *timeout_source = g_timeout_source_new_seconds(5);
+							g_source_set_callback(timeout_source, janus_ice_nacked_packet_cleanup, np, (GDestroyNotify)g_free);
+							np->source_id = g_source_attach(timeout_source, handle->mainctx);
+							g_source_unref(timeout_source);
+							g_hash_table_insert(medium->pending_nacked_cleanup, GUINT_TO_POINTER(np->source_id), timeout_source);
 						}
-						cur_seq = cur_seq->prev;
+					} else if(window->states[slot] == SEQ_NACKED && now - window->ts[slot] > SEQ_NACKED_WAIT) {
+						JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Missed sequence number %"SCNu16" (%s stream #%d), sending 2nd NACK\n",
+							handle->handle_id, seq, video ? "video" : "audio", vindex);
+						nacks = g_slist_prepend(nacks, GUINT_TO_POINTER(seq));
+						window->states[slot] = SEQ_GIVEUP;
 					}
+					seq++;
+					remaining--;
 				}
-				while(last_seqs_len > LAST_SEQS_MAX_LEN) {
-					janus_seq_info *node = janus_seq_pop_head(last_seqs);
-					g_free(node);
-					last_seqs_len--;
-				}
+				/* The scan above walked the window oldest to newest, so reverse
+				 * the list to keep the NACKed seqs in ascending order */
+				nacks = g_slist_reverse(nacks);
 
 				guint nacks_count = g_slist_length(nacks);
 				if(nacks_count) {
@@ -3066,6 +4059,7 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 					/* Update stats */
 					medium->nack_sent_recent_cnt += nacks_count;
 					medium->out_stats.info[vindex].nacks += nacks_count;
+					janus_metrics_account_nacks(TRUE, nacks_count);
 				}
 				if(medium->nack_sent_recent_cnt &&
 						(now - medium->nack_sent_log_ts) > 5*G_USEC_PER_SEC) {
@@ -3158,35 +4152,49 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 					medium->nack_queue_ms = mavg;
 				}
 				JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Got %s RTCP (%d bytes)\n", handle->handle_id, video ? "video" : "audio", buflen);
+				/* Summarize the feedback in this compound packet with a single
+				 * walk, rather than iterating it once per helper method */
+				janus_rtcp_summary summary;
+				if(janus_rtcp_summarize(buf, buflen, &summary) < 0) {
+					/* Drop the packet if the summary function returns with an error */
+					return;
+				}
 				/* See if there's any REMB bitrate to track */
-				uint32_t bitrate = janus_rtcp_get_remb(buf, buflen);
-				if(bitrate > 0)
-					pc->remb_bitrate = bitrate;
+				if(summary.remb_bitrate > 0)
+					pc->remb_bitrate = summary.remb_bitrate;
 
 				/* Now let's see if there are any NACKs to handle */
 				gint64 now = janus_get_monotonic_time();
-				GSList *nacks = janus_rtcp_get_nacks(buf, buflen);
-				guint nacks_count = g_slist_length(nacks);
+				guint nacks_count = summary.nacks_count;
+				if(summary.nacks_truncated) {
+					JANUS_LOG(LOG_WARN, "[%"SCNu64"] Got more NACKs than we can handle at once (%d), some will be ignored\n",
+						handle->handle_id, nacks_count);
+				}
 				if(nacks_count && medium->do_nacks) {
 					/* Handle NACK */
 					JANUS_LOG(LOG_HUGE, "[%"SCNu64"]     Just got some NACKS (%d) we should handle...\n", handle->handle_id, nacks_count);
-					GHashTable *retransmit_seqs = medium->retransmit_seqs;
-					GSList *list = (retransmit_seqs != NULL ? nacks : NULL);
+					janus_rtp_packet **retransmit_ring = medium->retransmit_ring;
+					guint i = 0;
 					int retransmits_cnt = 0;
 					janus_mutex_lock(&medium->mutex);
-					while(list) {
-						unsigned int seqnr = GPOINTER_TO_UINT(list->data);
+					for(i = 0; retransmit_ring != NULL && i < nacks_count; i++) {
+						unsigned int seqnr = summary.nacks[i];
 						JANUS_LOG(LOG_DBG, "[%"SCNu64"]   >> %u\n", handle->handle_id, seqnr);
 						int in_rb = 0;
-						/* Check if we have the packet */
-						janus_rtp_packet *p = g_hash_table_lookup(retransmit_seqs, GUINT_TO_POINTER(seqnr));
+						/* Check if we have the packet: the slot is a function of the
+						 * sequence number, so we just make sure the occupant matches */
+						janus_rtp_packet *p = retransmit_ring[seqnr & JANUS_RETRANSMIT_RING_MASK];
+						if(p != NULL) {
+							janus_rtp_header *header = (janus_rtp_header *)p->data;
+							if(ntohs(header->seq_number) != (guint16)seqnr)
+								p = NULL;
+						}
 						if(p == NULL) {
 							JANUS_LOG(LOG_HUGE, "[%"SCNu64"]   >> >> Can't retransmit packet %u, we don't have it...\n", handle->handle_id, seqnr);
 						} else {
 							/* Should we retransmit this packet? */
 							if((p->last_retransmit > 0) && (now-p->last_retransmit < MAX_NACK_IGNORE)) {
 								JANUS_LOG(LOG_HUGE, "[%"SCNu64"]   >> >> Packet %u was retransmitted just %"SCNi64"ms ago, skipping\n", handle->handle_id, seqnr, now-p->last_retransmit);
-								list = list->next;
 								continue;
 							}
 							in_rb = 1;
@@ -3194,22 +4202,32 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 							p->last_retransmit = now;
 							retransmits_cnt++;
 							/* Enqueue it */
-							janus_ice_queued_packet *pkt = g_malloc(sizeof(janus_ice_queued_packet));
+							janus_ice_queued_packet *pkt = janus_ice_alloc_queued_packet(p->length+SRTP_MAX_TAG_LEN);
 							pkt->mindex = medium->mindex;
-							pkt->data = g_malloc(p->length+SRTP_MAX_TAG_LEN);
-							memcpy(pkt->data, p->data, p->length);
+							if(p->shared != NULL) {
+								/* We only stored the headers privately, and the payload
+								 * is in the buffer shared with the other recipients */
+								int hlen = p->length - p->shared_plen;
+								memcpy(pkt->data, p->data, hlen);
+								memcpy(pkt->data + hlen, p->shared_payload, p->shared_plen);
+							} else {
+								memcpy(pkt->data, p->data, p->length);
+							}
 							pkt->length = p->length;
 							pkt->type = video ? JANUS_ICE_PACKET_VIDEO : JANUS_ICE_PACKET_AUDIO;
 							pkt->extensions = p->extensions;
 							pkt->control = FALSE;
 							pkt->retransmission = TRUE;
+							pkt->batched = FALSE;
 							pkt->label = NULL;
 							pkt->protocol = NULL;
 							pkt->added = janus_get_monotonic_time();
 							/* What to send and how depends on whether we're doing RFC4588 or not */
 							if(!video || !janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_RFC4588_RTX)) {
-								/* We're not: just clarify the packet was already encrypted before */
-								pkt->encrypted = TRUE;
+								/* We're not: just clarify the packet was already encrypted
+								 * before (unless SRTP helpers are in use, in which case we
+								 * saved the plaintext, and it will be encrypted again) */
+								pkt->encrypted = (crypto_helpers > 0 ? FALSE : TRUE);
 							} else {
 								/* We are: overwrite the RTP header (which means we'll need a new SRTP encrypt) */
 								pkt->encrypted = FALSE;
@@ -3233,16 +4251,14 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 						if(rtcp_ctx != NULL && in_rb) {
 							g_atomic_int_inc(&rtcp_ctx->nack_count);
 						}
-						list = list->next;
 					}
 					medium->retransmit_recent_cnt += retransmits_cnt;
 					/* FIXME Remove the NACK compound packet, we've handled it */
 					buflen = janus_rtcp_remove_nacks(buf, buflen);
 					/* Update stats */
 					medium->in_stats.info[vindex].nacks += nacks_count;
+					janus_metrics_account_nacks(FALSE, nacks_count);
 					janus_mutex_unlock(&medium->mutex);
-					g_slist_free(nacks);
-					nacks = NULL;
 				}
 				if(medium->retransmit_recent_cnt &&
 						now - medium->retransmit_log_ts > 5*G_USEC_PER_SEC) {
@@ -3520,6 +4536,12 @@ void janus_ice_add_remote_candidate(janus_ice_handle *handle, NiceCandidate *c)
 	JANUS_LOG(LOG_VERB, "[%"SCNu64"] Queueing candidate %p\n", handle->handle_id, c);
 	if(handle->queued_candidates != NULL)
 		g_async_queue_push(handle->queued_candidates, c);
+	/* If the loop was already asked to process candidates and hasn't gotten to
+	 * it yet, it will pick this one up as well: browsers trickle candidates in
+	 * rapid bursts, and coalescing them here means a burst costs the loop a
+	 * single wakeup, and libnice a single remote candidates update */
+	if(!g_atomic_int_compare_and_exchange(&handle->candidates_pending, 0, 1))
+		return;
 	if(handle->queued_packets != NULL) {
 #if GLIB_CHECK_VERSION(2, 46, 0)
 		g_async_queue_push_front(handle->queued_packets, &janus_ice_add_candidates);
@@ -3561,7 +4583,8 @@ void janus_ice_setup_remote_candidates(janus_ice_handle *handle, guint stream_id
 			g_async_queue_push(handle->queued_candidates, c);
 		gsc = gsc->next;
 	}
-	if(handle->queued_packets != NULL) {
+	if(handle->queued_packets != NULL &&
+			g_atomic_int_compare_and_exchange(&handle->candidates_pending, 0, 1)) {
 #if GLIB_CHECK_VERSION(2, 46, 0)
 		g_async_queue_push_front(handle->queued_packets, &janus_ice_add_candidates);
 #else
@@ -3623,9 +4646,23 @@ int janus_ice_setup_local(janus_ice_handle *handle, gboolean offer, gboolean tri
 		"ice-tcp", janus_ice_tcp_enabled ? TRUE : FALSE,
 #endif
 		NULL);
+#ifdef HAVE_ICE_NOMINATION
+	/* Speed up connectivity checks, if we were asked to */
+	if(janus_ice_check_initial_timeout > 0)
+		g_object_set(G_OBJECT(handle->agent), "stun-initial-timeout", janus_ice_check_initial_timeout, NULL);
+	if(janus_ice_check_max_retransmissions > 0)
+		g_object_set(G_OBJECT(handle->agent), "stun-max-retransmissions", janus_ice_check_max_retransmissions, NULL);
+#endif
 	handle->agent_created = janus_get_monotonic_time();
 	handle->srtp_errors_count = 0;
 	handle->last_srtp_error = 0;
+	/* If a lock-free ring was configured for outgoing packets, this handle
+	 * will need one now: we don't allocate it at creation time, as handles
+	 * without a PeerConnection never queue media, and keeping them slim
+	 * helps when there's a lot of idle handles around (on ICE restarts we
+	 * simply keep using the ring we already have) */
+	if(handle->packet_ring == NULL)
+		handle->packet_ring = janus_ice_packet_ring_create();
 	/* Any STUN server to use? */
 	if(janus_stun_server != NULL && janus_stun_port > 0) {
 		g_object_set(G_OBJECT(handle->agent),
@@ -3673,14 +4710,14 @@ int janus_ice_setup_local(janus_ice_handle *handle, gboolean offer, gboolean tri
 	g_signal_connect (G_OBJECT (handle->agent), "new-selected-pair-full",
 #endif
 		G_CALLBACK (janus_ice_cb_new_selected_pair), handle);
-	if(janus_full_trickle_enabled) {
+	/* We need this both for full-trickle, and to trickle candidates that
+	 * are gathered after the SDP has been sent in half-trickle mode */
 #ifndef HAVE_LIBNICE_TCP
-		g_signal_connect (G_OBJECT (handle->agent), "new-candidate",
+	g_signal_connect (G_OBJECT (handle->agent), "new-candidate",
 #else
-		g_signal_connect (G_OBJECT (handle->agent), "new-candidate-full",
+	g_signal_connect (G_OBJECT (handle->agent), "new-candidate-full",
 #endif
-			G_CALLBACK (janus_ice_cb_new_local_candidate), handle);
-	}
+		G_CALLBACK (janus_ice_cb_new_local_candidate), handle);
 #ifndef HAVE_LIBNICE_TCP
 	g_signal_connect (G_OBJECT (handle->agent), "new-remote-candidate",
 #else
@@ -3689,10 +4726,10 @@ int janus_ice_setup_local(janus_ice_handle *handle, gboolean offer, gboolean tri
 		G_CALLBACK (janus_ice_cb_new_remote_candidate), handle);
 
 	/* Add all local addresses, except those in the ignore list */
-	struct ifaddrs *ifaddr, *ifa;
+	const struct ifaddrs *ifaddr, *ifa;
 	int family, s, n;
 	char host[NI_MAXHOST];
-	if(getifaddrs(&ifaddr) == -1) {
+	if((ifaddr = janus_network_acquire_ifaddrs()) == NULL) {
 		JANUS_LOG(LOG_ERR, "[%"SCNu64"] Error getting list of interfaces... %d (%s)\n",
 			handle->handle_id, errno, g_strerror(errno));
 	} else {
@@ -3741,7 +4778,7 @@ int janus_ice_setup_local(janus_ice_handle *handle, gboolean offer, gboolean tri
 			}
 			nice_agent_add_local_address (handle->agent, &addr_local);
 		}
-		freeifaddrs(ifaddr);
+		janus_network_release_ifaddrs(ifaddr);
 	}
 
 	handle->cdone = 0;
@@ -3793,8 +4830,9 @@ int janus_ice_setup_local(janus_ice_handle *handle, gboolean offer, gboolean tri
 	/* Create the media instances we need */
 	pc->media = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_ice_peerconnection_medium_destroy);
 	pc->media_byssrc = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_ice_peerconnection_medium_dereference);
+	/* Keys are interned mids, so there's no key destructor to invoke */
 	pc->media_bymid = g_hash_table_new_full(g_str_hash, g_str_equal,
-		(GDestroyNotify)g_free, (GDestroyNotify)janus_ice_peerconnection_medium_dereference);
+		NULL, (GDestroyNotify)janus_ice_peerconnection_medium_dereference);
 	pc->media_bytype = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_ice_peerconnection_medium_dereference);
 #ifdef HAVE_PORTRANGE
 	/* FIXME: libnice supports this since 0.1.0, but the 0.1.3 on Fedora fails with an undefined reference! */
@@ -3898,9 +4936,16 @@ static void janus_ice_rtp_extension_update(janus_ice_handle *handle, janus_ice_p
 	if(handle == NULL || handle->pc == NULL || medium == NULL || packet == NULL || packet->data == NULL)
 		return;
 	uint16_t totlen = RTP_HEADER_SIZE;
-	/* Check how large the payload is */
+	/* Check how large the payload is: if it still lives in a buffer shared
+	 * with the other recipients of the same source packet, it hasn't been
+	 * copied to our private buffer yet, and we'll gather it at its final
+	 * offset directly, once we know how large the new extensions are */
 	int plen = 0;
-	char *payload = janus_rtp_payload(packet->data, packet->length, &plen);
+	char *payload = NULL;
+	if(packet->shared != NULL)
+		payload = janus_rtp_payload(packet->shared_data, packet->length, &plen);
+	else
+		payload = janus_rtp_payload(packet->data, packet->length, &plen);
 	if(payload != NULL)
 		totlen += plen;
 	/* We need to strip extensions, here, and add those that need to be there manually */
@@ -4047,7 +5092,7 @@ static void janus_ice_rtp_extension_update(janus_ice_handle *handle, janus_ice_p
 		}
 		/* Check if we need to add the mid extension */
 		if(handle->pc->mid_ext_id > 0) {
-			char *mid = medium->mid;
+			const char *mid = medium->mid;
 			if(mid != NULL) {
 				if(!use_2byte) {
 					size_t midlen = strlen(mid) & 0x0F;
@@ -4128,24 +5173,43 @@ static void janus_ice_rtp_extension_update(janus_ice_handle *handle, janus_ice_p
 		totlen += extlen;
 	}
 	/* Check if we need to resize this packet buffer first */
-	uint16_t payload_start = payload ? (payload - packet->data) : 0;
+	uint16_t payload_start = (packet->shared == NULL && payload != NULL) ? (payload - packet->data) : 0;
 	if(packet->length < totlen)
 		packet->data = g_realloc(packet->data, totlen + SRTP_MAX_TAG_LEN);
-	/* Now check if we need to move the payload */
-	payload = payload_start ? (packet->data + payload_start) : NULL;
-	if(payload != NULL && plen > 0 && packet->length != totlen)
-		memmove(packet->data + RTP_HEADER_SIZE + extlen, payload, plen);
-	/* Finally, copy RTP extensions, if any */
-	if(extlen > 0) {
-		/* Copy the extensions after the RTP header */
-		memcpy(packet->data + RTP_HEADER_SIZE, extensions, extlen);
+	if(packet->shared != NULL) {
+		/* Scatter-gather composition: copy the new extensions first, and
+		 * then the payload from the shared buffer, each directly at its
+		 * final offset, so that there's a single payload copy per recipient
+		 * and no moving things around when the extensions change size */
+		if(extlen > 0)
+			memcpy(packet->data + RTP_HEADER_SIZE, extensions, extlen);
+		if(payload != NULL && plen > 0) {
+			memcpy(packet->data + RTP_HEADER_SIZE + extlen, payload, plen);
+			/* Keep the reference, but point it at the payload: if this
+			 * packet ends up in the retransmit buffer, we'll reference the
+			 * shared payload from there too, rather than store a private
+			 * copy of the same payload for every subscriber of the source */
+			packet->shared_data = payload;
+			packet->shared_plen = plen;
+		} else {
+			janus_plugin_buffer_unref(packet->shared);
+			packet->shared = NULL;
+			packet->shared_data = NULL;
+		}
+	} else {
+		/* Now check if we need to move the payload */
+		payload = payload_start ? (packet->data + payload_start) : NULL;
+		if(payload != NULL && plen > 0 && packet->length != totlen)
+			memmove(packet->data + RTP_HEADER_SIZE + extlen, payload, plen);
+		/* Finally, copy RTP extensions, if any */
+		if(extlen > 0) {
+			/* Copy the extensions after the RTP header */
+			memcpy(packet->data + RTP_HEADER_SIZE, extensions, extlen);
+		}
 	}
 	packet->length = totlen;
 }
 
-static gint rtcp_transport_wide_cc_stats_comparator(gconstpointer item1, gconstpointer item2) {
-	return ((rtcp_transport_wide_cc_stats*)item1)->transport_seq_num - ((rtcp_transport_wide_cc_stats*)item2)->transport_seq_num;
-}
 static gboolean janus_ice_outgoing_transport_wide_cc_feedback(gpointer user_data) {
 	janus_ice_handle *handle = (janus_ice_handle *)user_data;
 	janus_ice_peerconnection *pc = handle->pc;
@@ -4185,87 +5249,51 @@ static gboolean janus_ice_outgoing_transport_wide_cc_feedback(gpointer user_data
 		return G_SOURCE_CONTINUE;
 	}
 
-	if(pc && pc->do_transport_wide_cc) {
+	if(pc && pc->do_transport_wide_cc && pc->transport_wide_cc_log != NULL) {
 		/* Create a transport wide feedback message */
 		size_t size = 1300;
 		char rtcpbuf[1300];
-		/* Order packet list */
-		pc->transport_wide_received_seq_nums = g_slist_sort(pc->transport_wide_received_seq_nums,
-			rtcp_transport_wide_cc_stats_comparator);
-		/* Create full stats queue */
-		GQueue *packets = g_queue_new();
-		/* For all packets */
-		GSList *it = NULL;
-		for(it = pc->transport_wide_received_seq_nums; it; it = it->next) {
-			/* Get stat */
-			janus_rtcp_transport_wide_cc_stats *stats = (janus_rtcp_transport_wide_cc_stats *)it->data;
-			/* Get transport seq */
-			guint32 transport_seq_num = stats->transport_seq_num;
-			/* Check if it is an out of order  */
-			if(transport_seq_num < pc->transport_wide_cc_last_feedback_seq_num) {
-				/* Skip, it was already reported as lost */
-				g_free(stats);
-				continue;
-			}
-			/* If not first */
-			if(pc->transport_wide_cc_last_feedback_seq_num) {
-				/* For each lost */
-				guint32 i = 0;
-				for(i = pc->transport_wide_cc_last_feedback_seq_num+1; i<transport_seq_num; ++i) {
-					/* Create new stat */
-					janus_rtcp_transport_wide_cc_stats *missing = g_malloc(sizeof(janus_rtcp_transport_wide_cc_stats));
-					/* Add missing packet */
-					missing->transport_seq_num = i;
-					missing->timestamp = 0;
-					/* Add it */
-					g_queue_push_tail(packets, missing);
-				}
-			}
-			/* Store last */
-			pc->transport_wide_cc_last_feedback_seq_num = transport_seq_num;
-			/* Add this one */
-			g_queue_push_tail(packets, stats);
-		}
-		/* Free and reset stats list */
-		g_slist_free(pc->transport_wide_received_seq_nums);
-		pc->transport_wide_received_seq_nums = NULL;
-		/* Create and enqueue RTCP packets */
-		guint packets_len = 0;
-		while((packets_len = g_queue_get_length(packets)) > 0) {
-			GQueue *packets_to_process;
-			/* If we have more than 400 packets to acknowledge, let's send more than one message */
-			if(packets_len > 400) {
-				/* Split the queue into two */
-				GList *new_head = g_queue_peek_nth_link(packets, 400);
-				GList *new_tail = new_head->prev;
-				new_head->prev = NULL;
-				new_tail->next = NULL;
-				packets_to_process = g_queue_new();
-				packets_to_process->head = packets->head;
-				packets_to_process->tail = new_tail;
-				packets_to_process->length = 400;
-				packets->head = new_head;
-				/* packets->tail is unchanged */
-				packets->length = packets_len - 400;
-			} else {
-				packets_to_process = packets;
+		janus_rtcp_transport_wide_cc_stats stats[JANUS_RTCP_TWCC_FEEDBACK_MAX_PACKETS];
+		/* The arrival log is inherently ordered by transport sequence number,
+		 * so we just walk it from the last sequence number we reported to the
+		 * highest one we logged: no sorting and no allocation involved (if we
+		 * have more packets to acknowledge than a single feedback message can
+		 * carry, we send more than one message) */
+		gboolean done = FALSE;
+		while(!done) {
+			janus_mutex_lock(&pc->mutex);
+			guint32 seq = pc->transport_wide_cc_last_feedback_seq_num ?
+				pc->transport_wide_cc_last_feedback_seq_num+1 : pc->transport_wide_cc_first_seq_num;
+			guint32 last = pc->transport_wide_cc_last_ext_seq_num;
+			guint num_stats = 0;
+			while(seq <= last && num_stats < JANUS_RTCP_TWCC_FEEDBACK_MAX_PACKETS) {
+				janus_rtcp_transport_wide_cc_stats *logged =
+					&pc->transport_wide_cc_log[seq & JANUS_ICE_TWCC_LOG_MASK];
+				stats[num_stats].transport_seq_num = seq;
+				/* If the slot holds a different sequence number, the packet
+				 * never arrived (or is so old it was overwritten): report it
+				 * as lost, which is what a zero timestamp means */
+				stats[num_stats].timestamp = (logged->transport_seq_num == seq) ? logged->timestamp : 0;
+				num_stats++;
+				seq++;
 			}
+			if(num_stats > 0)
+				pc->transport_wide_cc_last_feedback_seq_num = stats[num_stats-1].transport_seq_num;
+			done = (seq > last);
+			janus_mutex_unlock(&pc->mutex);
+			if(num_stats == 0)
+				break;
 			/* Get feedback packet count and increase it for next one */
 			guint8 feedback_packet_count = pc->transport_wide_cc_feedback_count++;
 			/* Create RTCP packet */
-			int len = janus_rtcp_transport_wide_cc_feedback(rtcpbuf, size,
-				medium->ssrc, ssrc_peer, feedback_packet_count, packets_to_process);
+			int len = janus_rtcp_transport_wide_cc_feedback_array(rtcpbuf, size,
+				medium->ssrc, ssrc_peer, feedback_packet_count, stats, num_stats);
 			/* Enqueue it, we'll send it later */
 			if(len > 0) {
 				janus_plugin_rtcp rtcp = { .mindex = medium->mindex, .video = TRUE, .buffer = rtcpbuf, .length = len };
 				janus_ice_relay_rtcp_internal(handle, medium, &rtcp, FALSE);
 			}
-			if(packets_to_process != packets) {
-				g_queue_free(packets_to_process);
-			}
 		}
-		/* Free mem */
-		g_queue_free(packets);
 	}
 	return G_SOURCE_CONTINUE;
 }
@@ -4502,7 +5530,53 @@ static gboolean janus_ice_outgoing_stats_handle(gpointer user_data) {
 	return G_SOURCE_CONTINUE;
 }
 
-static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janus_ice_queued_packet *pkt) {
+/* Helper to update the outgoing stats and RTCP context for an RTP packet
+ * we just sent (or just handed over to an SRTP helper thread) */
+static void janus_ice_rtp_sent_stats_update(janus_ice_peerconnection_medium *medium, janus_ice_queued_packet *pkt) {
+	/* Update the RTCP context as well */
+	janus_rtp_header *header = (janus_rtp_header *)pkt->data;
+	guint32 timestamp = ntohl(header->timestamp);
+	medium->out_stats.info[0].packets++;
+	medium->out_stats.info[0].bytes += pkt->length;
+	janus_metrics_account_rtp(TRUE, medium->type == JANUS_MEDIA_VIDEO, pkt->length);
+	/* Last second outgoing media */
+	gint64 now = janus_get_monotonic_time();
+	if(medium->out_stats.info[0].updated == 0)
+		medium->out_stats.info[0].updated = now;
+	if(now > medium->out_stats.info[0].updated &&
+			now - medium->out_stats.info[0].updated >= G_USEC_PER_SEC) {
+		medium->out_stats.info[0].bytes_lastsec = medium->out_stats.info[0].bytes_lastsec_temp;
+		medium->out_stats.info[0].bytes_lastsec_temp = 0;
+		medium->out_stats.info[0].updated = now;
+	}
+	medium->out_stats.info[0].bytes_lastsec_temp += pkt->length;
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	if(medium->last_ntp_ts == 0 || (gint32)(timestamp - medium->last_rtp_ts) > 0) {
+		medium->last_ntp_ts = (gint64)tv.tv_sec*G_USEC_PER_SEC + tv.tv_usec;
+		medium->last_rtp_ts = timestamp;
+	}
+	if(medium->first_ntp_ts[0] == 0) {
+		medium->first_ntp_ts[0] = (gint64)tv.tv_sec*G_USEC_PER_SEC + tv.tv_usec;
+		medium->first_rtp_ts[0] = timestamp;
+	}
+	/* Update sent packets counter */
+	rtcp_context *rtcp_ctx = medium->rtcp_ctx[0];
+	if(rtcp_ctx) {
+		g_atomic_int_inc(&rtcp_ctx->sent_packets_since_last_rr);
+		if(pkt->type == JANUS_ICE_PACKET_AUDIO) {
+			/* Let's check if this is not Opus: in case we may need to change the timestamp base */
+			int pt = header->type;
+			uint32_t clock_rate = medium->clock_rates ?
+				GPOINTER_TO_UINT(g_hash_table_lookup(medium->clock_rates, GINT_TO_POINTER(pt))) : 48000;
+			if(rtcp_ctx->tb != clock_rate)
+				rtcp_ctx->tb = clock_rate;
+		}
+	}
+}
+
+static gboolean janus_ice_outgoing_traffic_handle(janus_ice_outgoing_traffic *t, janus_ice_queued_packet *pkt) {
+	janus_ice_handle *handle = t->handle;
 	janus_session *session = (janus_session *)handle->session;
 	janus_ice_peerconnection *pc = handle->pc;
 	janus_ice_peerconnection_medium *medium = NULL;
@@ -4516,7 +5590,10 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 		}
 		return G_SOURCE_CONTINUE;
 	} else if(pkt == &janus_ice_add_candidates) {
-		/* There are remote candidates pending, add them now */
+		/* There are remote candidates pending, add them all now: we clear the
+		 * flag before draining, so that candidates queued from now on trigger
+		 * a new request rather than assuming this drain will catch them */
+		g_atomic_int_set(&handle->candidates_pending, 0);
 		GSList *candidates = NULL;
 		NiceCandidate *c = NULL;
 		while((c = g_async_queue_try_pop(handle->queued_candidates)) != NULL) {
@@ -4577,7 +5654,9 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 		}
 		return G_SOURCE_CONTINUE;
 	} else if(pkt == &janus_ice_hangup_peerconnection) {
-		/* The media session is over, send an alert on all streams and components */
+		/* The media session is over: flush any pending batched media first */
+		janus_ice_outgoing_traffic_flush(t);
+		/* Send an alert on all streams and components */
 		if(handle->pc && janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_READY)) {
 			janus_dtls_srtp_send_alert(handle->pc->dtls);
 		}
@@ -4604,6 +5683,8 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 			g_source_unref(handle->stats_source);
 			handle->stats_source = NULL;
 		}
+		/* If this handle was on a loop timer wheel, take it out */
+		janus_ice_timer_wheel_remove(handle);
 		/* If event handlers are active, send stats one last time */
 		if(janus_events_is_enabled()) {
 			handle->last_event_stats = janus_ice_event_stats_period;
@@ -4689,8 +5770,20 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 		janus_ice_free_queued_packet(pkt);
 		return G_SOURCE_CONTINUE;
 	}
+	if(pkt->shared != NULL && (pkt->type == JANUS_ICE_PACKET_TEXT || pkt->type == JANUS_ICE_PACKET_BINARY)) {
+		/* The plugin shared a refcounted buffer and we deferred the copy:
+		 * this message is actually going out, so materialize our private
+		 * copy now (data messages have no header, so we copy them whole;
+		 * for RTP packets we wait until we rebuild the extensions instead,
+		 * so that the payload is staged at its final offset directly) */
+		memcpy(pkt->data, pkt->shared_data, pkt->length);
+		janus_plugin_buffer_unref(pkt->shared);
+		pkt->shared = NULL;
+		pkt->shared_data = NULL;
+	}
 	if(pkt->control) {
-		/* RTCP */
+		/* RTCP: flush any batched media first, to preserve the packet ordering */
+		janus_ice_outgoing_traffic_flush(t);
 		int video = (pkt->type == JANUS_ICE_PACKET_VIDEO);
 		pc->noerrorlog = FALSE;
 		if(janus_is_webrtc_encryption_enabled() && (!pc->dtls || !pc->dtls->srtp_valid || !pc->dtls->srtp_out)) {
@@ -4706,6 +5799,7 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 		if(pkt->encrypted) {
 			/* Already SRTCP */
 			int sent = nice_agent_send(handle->agent, pc->stream_id, pc->component_id, pkt->length, (const gchar *)pkt->data);
+			JANUS_PROBE(socket_send, handle->handle_id, sent);
 			if(sent < pkt->length) {
 				JANUS_LOG(LOG_ERR, "[%"SCNu64"] ... only sent %d bytes? (was %d)\n", handle->handle_id, sent, pkt->length);
 			}
@@ -4732,20 +5826,26 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 						remb->ssrc[2] = htonl(medium->ssrc_peer[2]);
 					}
 				}
-				/* Free old packet and update */
+				/* Free old packet and update: the new buffer doesn't come
+				 * from the pool, so make sure we won't try to recycle it */
 				char *prev_data = pkt->data;
 				pkt->data = rtcpbuf;
 				pkt->length = rrlen+pkt->length;
+				pkt->pooled = FALSE;
 				g_clear_pointer(&prev_data, g_free);
 			}
 			/* Do we need to dump this packet for debugging? */
 			if(g_atomic_int_get(&handle->dump_packets))
 				janus_text2pcap_dump(handle->text2pcap, JANUS_TEXT2PCAP_RTCP, FALSE, pkt->data, pkt->length,
 					"[session=%"SCNu64"][handle=%"SCNu64"]", session->session_id, handle->handle_id);
+			/* If SRTP helpers are in use, the encryption and send happen there */
+			if(crypto_helpers > 0 && janus_ice_crypto_offload(handle, pkt))
+				return G_SOURCE_CONTINUE;
 			/* Encrypt SRTCP */
 			int protected = pkt->length;
 			int res = janus_is_webrtc_encryption_enabled() ?
 				srtp_protect_rtcp(pc->dtls->srtp_out, pkt->data, &protected) : srtp_err_status_ok;
+			JANUS_PROBE(srtp_protect, handle->handle_id, pkt->control, pkt->length, protected, res);
 			if(res != srtp_err_status_ok) {
 				/* We don't spam the logs for every SRTP error: just take note of this, and print a summary later */
 				handle->srtp_errors_count++;
@@ -4755,6 +5855,7 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 			} else {
 				/* Shoot! */
 				int sent = nice_agent_send(handle->agent, pc->stream_id, pc->component_id, protected, pkt->data);
+				JANUS_PROBE(socket_send, handle->handle_id, sent);
 				if(sent < protected) {
 					JANUS_LOG(LOG_ERR, "[%"SCNu64"] ... only sent %d bytes? (was %d)\n", handle->handle_id, sent, protected);
 				}
@@ -4784,9 +5885,15 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 				/* Already RTP (probably a retransmission?) */
 				janus_rtp_header *header = (janus_rtp_header *)pkt->data;
 				JANUS_LOG(LOG_HUGE, "[%"SCNu64"] ... Retransmitting seq.nr %"SCNu16"\n\n", handle->handle_id, ntohs(header->seq_number));
-				int sent = nice_agent_send(handle->agent, pc->stream_id, pc->component_id, pkt->length, (const gchar *)pkt->data);
-				if(sent < pkt->length) {
-					JANUS_LOG(LOG_ERR, "[%"SCNu64"] ... only sent %d bytes? (was %d)\n", handle->handle_id, sent, pkt->length);
+				if(send_batch_size > 0) {
+					/* Batched mode: the packet will be flushed with a vectored send */
+					janus_ice_outgoing_traffic_batch(t, pkt, pkt->length);
+				} else {
+					int sent = nice_agent_send(handle->agent, pc->stream_id, pc->component_id, pkt->length, (const gchar *)pkt->data);
+					JANUS_PROBE(socket_send, handle->handle_id, sent);
+					if(sent < pkt->length) {
+						JANUS_LOG(LOG_ERR, "[%"SCNu64"] ... only sent %d bytes? (was %d)\n", handle->handle_id, sent, pkt->length);
+					}
 				}
 			} else {
 				/* Prune/update/set RTP extensions */
@@ -4831,49 +5938,123 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 					janus_text2pcap_dump(handle->text2pcap, JANUS_TEXT2PCAP_RTP, FALSE, pkt->data, pkt->length,
 						"[session=%"SCNu64"][handle=%"SCNu64"]", session->session_id, handle->handle_id);
 				/* If this is video and NACK optimizations are enabled, check if this is
-				 * a keyframe: if so, we empty our retransmit buffer for incoming NACKs */
+				 * a keyframe: if so, we empty our retransmit buffer for incoming NACKs.
+				 * As on the receiving path, we only parse the payload once per frame */
 				if(video && nack_optimizations && medium->video_is_keyframe) {
-					int plen = 0;
-					char *payload = janus_rtp_payload(pkt->data, pkt->length, &plen);
-					if(medium->video_is_keyframe(payload, plen)) {
-						JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Keyframe sent, cleaning retransmit buffer\n", handle->handle_id);
-						janus_cleanup_nack_buffer(0, pc, FALSE, TRUE);
+					janus_rtp_header *header = (janus_rtp_header *)pkt->data;
+					guint32 frame_ts = ntohl(header->timestamp);
+					if(!medium->kf_checked_out || medium->kf_check_out_ts != frame_ts) {
+						medium->kf_checked_out = TRUE;
+						medium->kf_check_out_ts = frame_ts;
+						int plen = 0;
+						char *payload = janus_rtp_payload(pkt->data, pkt->length, &plen);
+						if(medium->video_is_keyframe(payload, plen)) {
+							JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Keyframe sent, cleaning retransmit buffer\n", handle->handle_id);
+							janus_cleanup_nack_buffer(0, pc, FALSE, TRUE);
+						}
 					}
 				}
 				/* Before encrypting, check if we need to copy the unencrypted payload (e.g., for rtx/90000) */
 				janus_rtp_packet *p = NULL;
 				if(medium->nack_queue_ms > 0 && !pkt->retransmission && pkt->type == JANUS_ICE_PACKET_VIDEO && medium->do_nacks &&
 						janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_RFC4588_RTX)) {
-					/* Save the packet for retransmissions that may be needed later: start by
-					 * making room for two more bytes to store the original sequence number */
-					p = g_malloc(sizeof(janus_rtp_packet));
-					janus_rtp_header *header = (janus_rtp_header *)pkt->data;
-					guint16 original_seq = header->seq_number;
-					p->data = g_malloc(pkt->length+2);
-					p->length = pkt->length+2;
-					/* Check where the payload starts */
+					/* Save the packet for retransmissions that may be needed later:
+					 * check where the payload starts, first */
 					int plen = 0;
 					char *payload = janus_rtp_payload(pkt->data, pkt->length, &plen);
 					if(plen == 0) {
 						JANUS_LOG(LOG_WARN, "[%"SCNu64"] Discarding outgoing empty RTP packet\n", handle->handle_id);
-						janus_ice_free_rtp_packet(p);
 						janus_ice_free_queued_packet(pkt);
 						return G_SOURCE_CONTINUE;
 					}
+					p = g_malloc(sizeof(janus_rtp_packet));
+					janus_rtp_header *header = (janus_rtp_header *)pkt->data;
+					guint16 original_seq = header->seq_number;
+					p->length = pkt->length+2;
+					p->shared = NULL;
+					p->shared_payload = NULL;
+					p->shared_plen = 0;
 					size_t hsize = payload - pkt->data;
-					/* Copy the header first */
-					memcpy(p->data, pkt->data, hsize);
-					/* Copy the original sequence number */
-					memcpy(p->data+hsize, &original_seq, 2);
+					if(pkt->shared != NULL && pkt->shared_plen == plen) {
+						/* The payload lives in a buffer shared with the other
+						 * recipients of the same source packet: reference it from
+						 * here too, and only store the rewritten header (plus the
+						 * two bytes for the original sequence number) privately */
+						p->data = g_malloc(hsize+2);
+						memcpy(p->data, pkt->data, hsize);
+						memcpy(p->data+hsize, &original_seq, 2);
+						janus_plugin_buffer_ref(pkt->shared);
+						p->shared = pkt->shared;
+						p->shared_payload = pkt->shared_data;
+						p->shared_plen = pkt->shared_plen;
+					} else {
+						/* Private payload: make room for two more bytes to store
+						 * the original sequence number, and copy the whole packet */
+						p->data = g_malloc(pkt->length+2);
+						/* Copy the header first */
+						memcpy(p->data, pkt->data, hsize);
+						/* Copy the original sequence number */
+						memcpy(p->data+hsize, &original_seq, 2);
+						/* Copy the payload */
+						memcpy(p->data+hsize+2, payload, pkt->length - hsize);
+					}
 					/* Copy the extensions struct */
 					p->extensions = pkt->extensions;
-					/* Copy the payload */
-					memcpy(p->data+hsize+2, payload, pkt->length - hsize);
+				}
+				/* If SRTP helpers are in use, hand the packet over for the
+				 * encryption and send: stats and the retransmit buffer are
+				 * updated here first, since the helper will own the packet;
+				 * note that in this mode we save the plaintext for possible
+				 * retransmissions, which will simply be encrypted again (the
+				 * keystream is a function of the sequence number, so the
+				 * ciphertext will be the same) if they're ever NACKed */
+				if(crypto_helpers > 0) {
+					janus_ice_rtp_sent_stats_update(medium, pkt);
+					if(medium->nack_queue_ms > 0 && !pkt->retransmission && medium->do_nacks) {
+						if(p == NULL) {
+							p = g_malloc(sizeof(janus_rtp_packet));
+							p->length = pkt->length;
+							if(pkt->shared != NULL && pkt->shared_plen < pkt->length) {
+								/* The payload lives in a shared buffer: reference it
+								 * and only store the rewritten header privately */
+								int hlen = pkt->length - pkt->shared_plen;
+								p->data = g_malloc(hlen);
+								memcpy(p->data, pkt->data, hlen);
+								janus_plugin_buffer_ref(pkt->shared);
+								p->shared = pkt->shared;
+								p->shared_payload = pkt->shared_data;
+								p->shared_plen = pkt->shared_plen;
+							} else {
+								p->data = g_malloc(pkt->length);
+								memcpy(p->data, pkt->data, pkt->length);
+								p->shared = NULL;
+								p->shared_payload = NULL;
+								p->shared_plen = 0;
+							}
+							janus_plugin_rtp_extensions_reset(&p->extensions);
+						}
+						p->created = janus_get_monotonic_time();
+						p->last_retransmit = 0;
+						janus_rtp_header *header = (janus_rtp_header *)pkt->data;
+						guint16 seq = ntohs(header->seq_number);
+						if(medium->retransmit_ring == NULL) {
+							/* Allocate all the (empty) slots of the ring now */
+							medium->retransmit_ring = g_malloc0(sizeof(janus_rtp_packet *)*JANUS_RETRANSMIT_RING_SIZE);
+						}
+						guint slot = seq & JANUS_RETRANSMIT_RING_MASK;
+						janus_ice_free_rtp_packet(medium->retransmit_ring[slot]);
+						medium->retransmit_ring[slot] = p;
+					} else {
+						janus_ice_free_rtp_packet(p);
+					}
+					if(janus_ice_crypto_offload(handle, pkt))
+						return G_SOURCE_CONTINUE;
 				}
 				/* Encrypt SRTP */
 				int protected = pkt->length;
 				int res = janus_is_webrtc_encryption_enabled() ?
 					srtp_protect(pc->dtls->srtp_out, pkt->data, &protected) : srtp_err_status_ok;
+				JANUS_PROBE(srtp_protect, handle->handle_id, pkt->control, pkt->length, protected, res);
 				if(res != srtp_err_status_ok) {
 					/* We don't spam the logs for every SRTP error: just take note of this, and print a summary later */
 					handle->srtp_errors_count++;
@@ -4887,52 +6068,21 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 					janus_ice_free_rtp_packet(p);
 				} else {
 					/* Shoot! */
-					int sent = nice_agent_send(handle->agent, pc->stream_id, pc->component_id, protected, pkt->data);
-					if(sent < protected) {
-						JANUS_LOG(LOG_ERR, "[%"SCNu64"] ... only sent %d bytes? (was %d)\n", handle->handle_id, sent, protected);
-					}
-					/* Update stats */
-					if(sent > 0) {
-						/* Update the RTCP context as well */
-						janus_rtp_header *header = (janus_rtp_header *)pkt->data;
-						guint32 timestamp = ntohl(header->timestamp);
-						medium->out_stats.info[0].packets++;
-						medium->out_stats.info[0].bytes += pkt->length;
-						/* Last second outgoing media */
-						gint64 now = janus_get_monotonic_time();
-						if(medium->out_stats.info[0].updated == 0)
-							medium->out_stats.info[0].updated = now;
-						if(now > medium->out_stats.info[0].updated &&
-								now - medium->out_stats.info[0].updated >= G_USEC_PER_SEC) {
-							medium->out_stats.info[0].bytes_lastsec = medium->out_stats.info[0].bytes_lastsec_temp;
-							medium->out_stats.info[0].bytes_lastsec_temp = 0;
-							medium->out_stats.info[0].updated = now;
-						}
-						medium->out_stats.info[0].bytes_lastsec_temp += pkt->length;
-						struct timeval tv;
-						gettimeofday(&tv, NULL);
-						if(medium->last_ntp_ts == 0 || (gint32)(timestamp - medium->last_rtp_ts) > 0) {
-							medium->last_ntp_ts = (gint64)tv.tv_sec*G_USEC_PER_SEC + tv.tv_usec;
-							medium->last_rtp_ts = timestamp;
-						}
-						if(medium->first_ntp_ts[0] == 0) {
-							medium->first_ntp_ts[0] = (gint64)tv.tv_sec*G_USEC_PER_SEC + tv.tv_usec;
-							medium->first_rtp_ts[0] = timestamp;
-						}
-						/* Update sent packets counter */
-						rtcp_context *rtcp_ctx = medium->rtcp_ctx[0];
-						if(rtcp_ctx) {
-							g_atomic_int_inc(&rtcp_ctx->sent_packets_since_last_rr);
-							if(pkt->type == JANUS_ICE_PACKET_AUDIO) {
-								/* Let's check if this is not Opus: in case we may need to change the timestamp base */
-								int pt = header->type;
-								uint32_t clock_rate = medium->clock_rates ?
-									GPOINTER_TO_UINT(g_hash_table_lookup(medium->clock_rates, GINT_TO_POINTER(pt))) : 48000;
-								if(rtcp_ctx->tb != clock_rate)
-									rtcp_ctx->tb = clock_rate;
-							}
+					int sent = protected;
+					if(send_batch_size > 0) {
+						/* Batched mode: the packet is queued, and will be flushed
+						 * with a single vectored send at the end of the dispatch */
+						janus_ice_outgoing_traffic_batch(t, pkt, protected);
+					} else {
+						sent = nice_agent_send(handle->agent, pc->stream_id, pc->component_id, protected, pkt->data);
+						JANUS_PROBE(socket_send, handle->handle_id, sent);
+						if(sent < protected) {
+							JANUS_LOG(LOG_ERR, "[%"SCNu64"] ... only sent %d bytes? (was %d)\n", handle->handle_id, sent, protected);
 						}
 					}
+					/* Update stats */
+					if(sent > 0)
+						janus_ice_rtp_sent_stats_update(medium, pkt);
 					if(medium->nack_queue_ms > 0 && !pkt->retransmission) {
 						/* Save the packet for retransmissions that may be needed later */
 						if(!medium->do_nacks) {
@@ -4946,19 +6096,25 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 							p->data = g_malloc(protected);
 							memcpy(p->data, pkt->data, protected);
 							p->length = protected;
+							/* This is ciphertext, so there's no shared payload to point to */
+							p->shared = NULL;
+							p->shared_payload = NULL;
+							p->shared_plen = 0;
 							janus_plugin_rtp_extensions_reset(&p->extensions);
 						}
 						p->created = janus_get_monotonic_time();
 						p->last_retransmit = 0;
 						janus_rtp_header *header = (janus_rtp_header *)pkt->data;
 						guint16 seq = ntohs(header->seq_number);
-						if(medium->retransmit_buffer == NULL) {
-							medium->retransmit_buffer = g_queue_new();
-							medium->retransmit_seqs = g_hash_table_new(NULL, NULL);
+						if(medium->retransmit_ring == NULL) {
+							/* Allocate all the (empty) slots of the ring now */
+							medium->retransmit_ring = g_malloc0(sizeof(janus_rtp_packet *)*JANUS_RETRANSMIT_RING_SIZE);
 						}
-						g_queue_push_tail(medium->retransmit_buffer, p);
-						/* Insert in the table too, for quick lookup */
-						g_hash_table_insert(medium->retransmit_seqs, GUINT_TO_POINTER(seq), p);
+						/* Store in the slot this sequence number maps to, getting
+						 * rid of the previous (much older) occupant, if any */
+						guint slot = seq & JANUS_RETRANSMIT_RING_MASK;
+						janus_ice_free_rtp_packet(medium->retransmit_ring[slot]);
+						medium->retransmit_ring[slot] = p;
 					} else {
 						janus_ice_free_rtp_packet(p);
 					}
@@ -4983,25 +6139,6 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 			/* TODO Support binary data */
 			janus_dtls_wrap_sctp_data(pc->dtls, pkt->label, pkt->protocol,
 				pkt->type == JANUS_ICE_PACKET_TEXT, pkt->data, pkt->length);
-#endif
-		} else if(pkt->type == JANUS_ICE_PACKET_SCTP) {
-			/* SCTP data to push */
-			if(!janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_DATA_CHANNELS)) {
-				janus_ice_free_queued_packet(pkt);
-				return G_SOURCE_CONTINUE;
-			}
-#ifdef HAVE_SCTP
-			/* Encapsulate this data in DTLS and send it */
-			if(!pc->dtls) {
-				if(!janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ALERT) && !medium->noerrorlog) {
-					JANUS_LOG(LOG_WARN, "[%"SCNu64"] SCTP stream component has no valid DTLS session (yet?)\n", handle->handle_id);
-					medium->noerrorlog = TRUE;	/* Don't flood with the same error all over again */
-				}
-				janus_ice_free_queued_packet(pkt);
-				return G_SOURCE_CONTINUE;
-			}
-			medium->noerrorlog = FALSE;
-			janus_dtls_send_sctp_data(pc->dtls, pkt->data, pkt->length);
 #endif
 		} else {
 			JANUS_LOG(LOG_WARN, "[%"SCNu64"] Unsupported packet type %d\n", handle->handle_id, pkt->type);
@@ -5012,9 +6149,26 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 }
 
 static void janus_ice_queue_packet(janus_ice_handle *handle, janus_ice_queued_packet *pkt) {
+	/* Fresh RTP goes through the lock-free ring, if in use: there's a single
+	 * producer for it (the plugin thread relaying media on this handle), so
+	 * we never contend with the loop on the queue mutex; if the ring is full
+	 * we drop the packet (and count the drop), rather than delay the sender */
+	if(handle->packet_ring != NULL && !pkt->control &&
+			(pkt->type == JANUS_ICE_PACKET_AUDIO || pkt->type == JANUS_ICE_PACKET_VIDEO)) {
+		if(!janus_ice_packet_ring_push(handle->packet_ring, pkt)) {
+			g_atomic_int_inc(&handle->ring_drops);
+			janus_metrics_account_ring_drop();
+			janus_ice_free_queued_packet(pkt);
+			return;
+		}
+		JANUS_PROBE(queue_enqueue, handle->handle_id, pkt->type, pkt->length);
+		g_main_context_wakeup(handle->mainctx);
+		return;
+	}
 	/* TODO: There is a potential race condition where the "queued_packets"
 	 * could get released between the condition and pushing the packet. */
 	if(handle->queued_packets != NULL) {
+		JANUS_PROBE(queue_enqueue, handle->handle_id, pkt->type, pkt->length);
 		g_async_queue_push(handle->queued_packets, pkt);
 		g_main_context_wakeup(handle->mainctx);
 	} else {
@@ -5022,21 +6176,55 @@ static void janus_ice_queue_packet(janus_ice_handle *handle, janus_ice_queued_pa
 	}
 }
 
+void janus_ice_set_media_bridge(janus_ice_handle *handle, janus_ice_handle *bridged) {
+	if(handle == NULL)
+		return;
+	if(bridged != NULL)
+		janus_refcount_increase(&bridged->ref);
+	janus_ice_handle *prev = NULL;
+	do {
+		prev = (janus_ice_handle *)g_atomic_pointer_get(&handle->bridged_handle);
+	} while(!g_atomic_pointer_compare_and_exchange(&handle->bridged_handle, prev, bridged));
+	if(bridged != NULL) {
+		JANUS_LOG(LOG_VERB, "[%"SCNu64"] Bridging incoming RTP packets to handle %"SCNu64"\n",
+			handle->handle_id, bridged->handle_id);
+	} else if(prev != NULL) {
+		JANUS_LOG(LOG_VERB, "[%"SCNu64"] Not bridging incoming RTP packets to handle %"SCNu64" anymore\n",
+			handle->handle_id, prev->handle_id);
+	}
+	if(prev != NULL)
+		janus_refcount_decrease(&prev->ref);
+}
+
 void janus_ice_relay_rtp(janus_ice_handle *handle, janus_plugin_rtp *packet) {
 	if(!handle || !handle->pc || handle->queued_packets == NULL || packet == NULL || packet->buffer == NULL ||
 			!janus_is_rtp(packet->buffer, packet->length))
 		return;
+	JANUS_PROBE(relay_rtp, handle->handle_id, packet->video, packet->length);
 	/* Queue this packet as it is (we'll prune/update/set extensions later) */
-	janus_ice_queued_packet *pkt = g_malloc(sizeof(janus_ice_queued_packet));
+	janus_ice_queued_packet *pkt = janus_ice_alloc_queued_packet(packet->length + SRTP_MAX_TAG_LEN);
 	pkt->mindex = packet->mindex;
-	pkt->data = g_malloc(packet->length + SRTP_MAX_TAG_LEN);
-	memcpy(pkt->data, packet->buffer, packet->length);
+	if(packet->shared != NULL && packet->length > RTP_HEADER_SIZE) {
+		/* The plugin shared a refcounted buffer: copy the RTP header now,
+		 * since plugins typically rewrite it per recipient and restore it
+		 * right after this call, but reference the buffer and defer the
+		 * payload copy to the send loop, so that fanning the same payload
+		 * out to many handles doesn't cost a full memcpy per recipient
+		 * on the thread that's relaying */
+		memcpy(pkt->data, packet->buffer, RTP_HEADER_SIZE);
+		janus_plugin_buffer_ref(packet->shared);
+		pkt->shared = packet->shared;
+		pkt->shared_data = packet->buffer;
+	} else {
+		memcpy(pkt->data, packet->buffer, packet->length);
+	}
 	pkt->length = packet->length;
 	pkt->type = packet->video ? JANUS_ICE_PACKET_VIDEO : JANUS_ICE_PACKET_AUDIO;
 	pkt->extensions = packet->extensions;
 	pkt->control = FALSE;
 	pkt->encrypted = FALSE;
 	pkt->retransmission = FALSE;
+	pkt->batched = FALSE;
 	pkt->label = NULL;
 	pkt->protocol = NULL;
 	pkt->added = janus_get_monotonic_time();
@@ -5069,9 +6257,8 @@ void janus_ice_relay_rtcp_internal(janus_ice_handle *handle, janus_ice_peerconne
 			medium->ssrc, medium->ssrc_peer[0]);
 	}
 	/* Queue this packet */
-	janus_ice_queued_packet *pkt = g_malloc(sizeof(janus_ice_queued_packet));
+	janus_ice_queued_packet *pkt = janus_ice_alloc_queued_packet(rtcp_len+SRTP_MAX_TAG_LEN+4);
 	pkt->mindex = medium->mindex;
-	pkt->data = g_malloc(rtcp_len+SRTP_MAX_TAG_LEN+4);
 	memcpy(pkt->data, rtcp_buf, rtcp_len);
 	pkt->length = rtcp_len;
 	pkt->type = packet->video ? JANUS_ICE_PACKET_VIDEO : JANUS_ICE_PACKET_AUDIO;
@@ -5079,6 +6266,7 @@ void janus_ice_relay_rtcp_internal(janus_ice_handle *handle, janus_ice_peerconne
 	pkt->control = TRUE;
 	pkt->encrypted = FALSE;
 	pkt->retransmission = FALSE;
+	pkt->batched = FALSE;
 	pkt->label = NULL;
 	pkt->protocol = NULL;
 	pkt->added = janus_get_monotonic_time();
@@ -5168,16 +6356,26 @@ void janus_ice_send_remb(janus_ice_handle *handle, uint32_t bitrate) {
 void janus_ice_relay_data(janus_ice_handle *handle, janus_plugin_data *packet) {
 	if(!handle || !handle->pc || handle->queued_packets == NULL || packet == NULL || packet->buffer == NULL || packet->length < 1)
 		return;
-	janus_ice_queued_packet *pkt = g_malloc(sizeof(janus_ice_queued_packet));
-	pkt->data = g_malloc(packet->length);
+	janus_ice_queued_packet *pkt = janus_ice_alloc_queued_packet(packet->length);
 	pkt->mindex = -1;
-	memcpy(pkt->data, packet->buffer, packet->length);
+	if(packet->shared != NULL) {
+		/* The plugin shared a refcounted buffer (e.g., a room broadcast):
+		 * reference it and defer our private copy to the send loop, so that
+		 * fanning the same message out to many handles doesn't cost a full
+		 * memcpy per recipient on the thread that's relaying */
+		janus_plugin_buffer_ref(packet->shared);
+		pkt->shared = packet->shared;
+		pkt->shared_data = packet->buffer;
+	} else {
+		memcpy(pkt->data, packet->buffer, packet->length);
+	}
 	pkt->length = packet->length;
 	pkt->type = packet->binary ? JANUS_ICE_PACKET_BINARY : JANUS_ICE_PACKET_TEXT;
 	memset(&pkt->extensions, 0, sizeof(pkt->extensions));
 	pkt->control = FALSE;
 	pkt->encrypted = FALSE;
 	pkt->retransmission = FALSE;
+	pkt->batched = FALSE;
 	pkt->label = packet->label ? g_strdup(packet->label) : NULL;
 	pkt->protocol = packet->protocol ? g_strdup(packet->protocol) : NULL;
 	pkt->added = janus_get_monotonic_time();
@@ -5187,28 +6385,29 @@ void janus_ice_relay_data(janus_ice_handle *handle, janus_plugin_data *packet) {
 
 void janus_ice_relay_sctp(janus_ice_handle *handle, char *buffer, int length) {
 #ifdef HAVE_SCTP
-	if(!handle || !handle->pc || handle->queued_packets == NULL || buffer == NULL || length < 1)
+	if(!handle || !handle->pc || buffer == NULL || length < 1)
+		return;
+	janus_ice_peerconnection *pc = handle->pc;
+	if(!janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_DATA_CHANNELS))
 		return;
 	/* Find the right medium instance */
-	janus_ice_peerconnection_medium *medium = g_hash_table_lookup(handle->pc->media_bytype,
+	janus_ice_peerconnection_medium *medium = g_hash_table_lookup(pc->media_bytype,
 		GINT_TO_POINTER(JANUS_MEDIA_DATA));
-	if(!medium)	/* Queue this packet */
+	if(!medium)
 		return;
-	/* Queue this packet */
-	janus_ice_queued_packet *pkt = g_malloc(sizeof(janus_ice_queued_packet));
-	pkt->data = g_malloc(length);
-	pkt->mindex = medium->mindex;
-	memcpy(pkt->data, buffer, length);
-	pkt->length = length;
-	pkt->type = JANUS_ICE_PACKET_SCTP;
-	memset(&pkt->extensions, 0, sizeof(pkt->extensions));
-	pkt->control = FALSE;
-	pkt->encrypted = FALSE;
-	pkt->retransmission = FALSE;
-	pkt->label = NULL;
-	pkt->protocol = NULL;
-	pkt->added = janus_get_monotonic_time();
-	janus_ice_queue_packet(handle, pkt);
+	if(!pc->dtls) {
+		if(!janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ALERT) && !medium->noerrorlog) {
+			JANUS_LOG(LOG_WARN, "[%"SCNu64"] SCTP stream component has no valid DTLS session (yet?)\n", handle->handle_id);
+			medium->noerrorlog = TRUE;	/* Don't flood with the same error all over again */
+		}
+		return;
+	}
+	medium->noerrorlog = FALSE;
+	/* Encapsulate this data in DTLS and send it right away: the SSL stack
+	 * is protected by its own mutex, and the BIO hands the encrypted record
+	 * straight to libnice, so there's no need to copy the packet and bounce
+	 * it through the send loop anymore */
+	janus_dtls_send_sctp_data(pc->dtls, buffer, length);
 #endif
 }
 
@@ -5251,24 +6450,31 @@ void janus_ice_dtls_handshake_done(janus_ice_handle *handle) {
 		return;
 	}
 	janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_READY);
-	/* Create a source for RTCP and one for stats */
-	handle->rtcp_source = g_timeout_source_new_seconds(1);
-	g_source_set_priority(handle->rtcp_source, G_PRIORITY_DEFAULT);
-	g_source_set_callback(handle->rtcp_source, janus_ice_outgoing_rtcp_handle, handle, NULL);
-	g_source_attach(handle->rtcp_source, handle->mainctx);
-	if(twcc_period != 1000) {
-		/* The Transport Wide CC feedback period is different, create another source */
-		handle->twcc_source = g_timeout_source_new(twcc_period);
-		g_source_set_priority(handle->twcc_source, G_PRIORITY_DEFAULT);
-		g_source_set_callback(handle->twcc_source, janus_ice_outgoing_transport_wide_cc_feedback, handle, NULL);
-		g_source_attach(handle->twcc_source, handle->mainctx);
-	}
+	/* Create a source for RTCP and one for stats (or, if this handle shares a
+	 * static event loop, coalesce both in the loop timer wheel instead) */
 	handle->last_event_stats = 0;
 	handle->last_srtp_summary = -1;
-	handle->stats_source = g_timeout_source_new_seconds(1);
-	g_source_set_callback(handle->stats_source, janus_ice_outgoing_stats_handle, handle, NULL);
-	g_source_set_priority(handle->stats_source, G_PRIORITY_DEFAULT);
-	g_source_attach(handle->stats_source, handle->mainctx);
+	if(handle->static_event_loop != NULL) {
+		/* The wheel takes care of TWCC feedback too, no dedicated timer needed */
+		handle->twcc_due = 0;
+		janus_ice_timer_wheel_add(handle);
+	} else {
+		handle->rtcp_source = g_timeout_source_new_seconds(1);
+		g_source_set_priority(handle->rtcp_source, G_PRIORITY_DEFAULT);
+		g_source_set_callback(handle->rtcp_source, janus_ice_outgoing_rtcp_handle, handle, NULL);
+		g_source_attach(handle->rtcp_source, handle->mainctx);
+		handle->stats_source = g_timeout_source_new_seconds(1);
+		g_source_set_callback(handle->stats_source, janus_ice_outgoing_stats_handle, handle, NULL);
+		g_source_set_priority(handle->stats_source, G_PRIORITY_DEFAULT);
+		g_source_attach(handle->stats_source, handle->mainctx);
+		if(twcc_period != 1000) {
+			/* The Transport Wide CC feedback period is different, create another source */
+			handle->twcc_source = g_timeout_source_new(twcc_period);
+			g_source_set_priority(handle->twcc_source, G_PRIORITY_DEFAULT);
+			g_source_set_callback(handle->twcc_source, janus_ice_outgoing_transport_wide_cc_feedback, handle, NULL);
+			g_source_attach(handle->twcc_source, handle->mainctx);
+		}
+	}
 	janus_mutex_unlock(&handle->mutex);
 	JANUS_LOG(LOG_INFO, "[%"SCNu64"] The DTLS handshake has been completed\n", handle->handle_id);
 	/* Notify the plugin that the WebRTC PeerConnection is ready to be used */
@@ -5283,7 +6489,7 @@ void janus_ice_dtls_handshake_done(janus_ice_handle *handle) {
 	if(session == NULL)
 		return;
 	json_t *event = json_object();
-	json_object_set_new(event, "janus", json_string("webrtcup"));
+	json_object_set(event, "janus", janus_json_webrtcup);
 	json_object_set_new(event, "session_id", json_integer(session->session_id));
 	json_object_set_new(event, "sender", json_integer(handle->handle_id));
 	if(opaqueid_in_api && handle->opaque_id != NULL)
@@ -5294,7 +6500,7 @@ void janus_ice_dtls_handshake_done(janus_ice_handle *handle) {
 	/* Notify event handlers as well */
 	if(janus_events_is_enabled()) {
 		json_t *info = json_object();
-		json_object_set_new(info, "connection", json_string("webrtcup"));
+		json_object_set(info, "connection", janus_json_webrtcup);
 		janus_events_notify_handlers(JANUS_EVENT_TYPE_WEBRTC, JANUS_EVENT_SUBTYPE_WEBRTC_STATE,
 			session->session_id, handle->handle_id, handle->opaque_id, info);
 	}
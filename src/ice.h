@@ -29,6 +29,7 @@
 #include "sctp.h"
 #include "rtcp.h"
 #include "text2pcap.h"
+#include "ratelimit.h"
 #include "utils.h"
 #include "ip-utils.h"
 #include "refcount.h"
@@ -150,6 +151,12 @@ void janus_ice_set_nomination_mode(const char *nomination);
 /*! \brief Method to return a string description of the configured ICE nomination mode
  * @returns "regular" or "aggressive" */
 const char *janus_ice_get_nomination_mode(void);
+/*! \brief Method to tune the timing of ICE connectivity checks: a lower
+ * initial retransmission timeout speeds up nomination on multi-homed or
+ * lossy clients, at the cost of some more STUN traffic
+ * @param[in] initial_timeout Initial STUN retransmission timeout, in milliseconds (0 to use the libnice default)
+ * @param[in] max_retransmissions Maximum number of STUN retransmissions per check (0 to use the libnice default) */
+void janus_ice_set_check_timings(guint initial_timeout, guint max_retransmissions);
 #endif
 /*! \brief Method to enable/disable consent freshness in PeerConnections.
  * \note This is only available on libnice >= 0.1.19, and automatically enables
@@ -190,6 +197,62 @@ void janus_set_nack_optimizations_enabled(gboolean optimize);
 /*! \brief Method to check whether NACK optimizations on outgoing keyframes are enabled or not
  * @returns optimize if optimizations are enabled, false otherwise */
 gboolean janus_is_nack_optimizations_enabled(void);
+/*! \brief Method to modify the size of the send batch (i.e., how many outgoing media
+ * packets at most can be accumulated during a dispatch, and flushed with a single
+ * vectored send): batching is disabled by default (size=0, send packets one by one)
+ * @param[in] size The new send batch size (0 to disable batching) */
+void janus_ice_set_send_batch_size(int size);
+/*! \brief Method to get the current size of the send batch (see above)
+ * @returns The current send batch size, or 0 if batching is disabled */
+int janus_ice_get_send_batch_size(void);
+/*! \brief Method to modify the size of the pacing burst (i.e., how many bytes
+ * of video at most can leave a handle at once, before the remaining packets
+ * are spread over time by a token bucket): pacing smooths out keyframe bursts,
+ * which would otherwise tail-drop at shallow network buffers, and slows down
+ * when the TWCC feedback from the peer reports losses; it's disabled by
+ * default (burst=0, send packets as soon as plugins relay them)
+ * @param[in] burst The new pacing burst size, in bytes (0 to disable pacing) */
+void janus_ice_set_pacing_burst(int burst);
+/*! \brief Method to get the current size of the pacing burst (see above)
+ * @returns The current pacing burst size, or 0 if pacing is disabled */
+int janus_ice_get_pacing_burst(void);
+/*! \brief Method to modify the size of the queued packet pool (i.e., how many
+ * packet instances and MTU-sized buffers at most can be kept around and recycled
+ * on the media relay path, instead of being allocated and freed each time):
+ * pooling is disabled by default (size=0, allocate each packet)
+ * @param[in] size The new packet pool size (0 to disable pooling) */
+void janus_ice_set_packet_pool_size(int size);
+/*! \brief Method to get the current size of the queued packet pool (see above)
+ * @returns The current packet pool size, or 0 if pooling is disabled */
+int janus_ice_get_packet_pool_size(void);
+/*! \brief Method to modify the size of the per-handle outgoing RTP ring (i.e., the
+ * bounded lock-free ring fresh RTP packets are queued on, instead of the generic
+ * GAsyncQueue): the ring is disabled by default (size=0, use the queue for everything)
+ * @note The size is rounded up to the next power of two; when the ring is full,
+ * new packets are dropped (and counted), rather than delaying the sender
+ * @param[in] size The new ring size (0 to disable the ring) */
+void janus_ice_set_packet_ring_size(int size);
+/*! \brief Method to get the current size of the per-handle outgoing RTP ring (see above)
+ * @returns The current ring size, or 0 if the ring is disabled */
+int janus_ice_get_packet_ring_size(void);
+/*! \brief Method to get the current depth of a handle's outgoing RTP ring
+ * @param[in] handle The Janus ICE handle the ring belongs to
+ * @returns How many packets are queued on the ring right now, or 0 if the ring is disabled */
+guint janus_ice_get_packet_ring_depth(janus_ice_handle *handle);
+/*! \brief Method to get the depth high-watermark of a handle's outgoing RTP ring
+ * (i.e., the deepest the ring has been so far, which helps sizing it)
+ * @param[in] handle The Janus ICE handle the ring belongs to
+ * @returns The deepest the ring has been, or 0 if the ring is disabled */
+guint janus_ice_get_packet_ring_hwm(janus_ice_handle *handle);
+/*! \brief Method to spawn a pool of SRTP helper threads at startup: when enabled,
+ * srtp_protect and the related sends are done there, rather than inline on the
+ * handle loops; each handle is statically mapped to one helper, so that all the
+ * crypto for a libsrtp context stays serialized on a single thread
+ * @param[in] helpers The number of SRTP helper threads to spawn (0, the default, keeps encryption inline) */
+void janus_ice_set_srtp_helpers(int helpers);
+/*! \brief Method to get the number of SRTP helper threads (see above)
+ * @returns The number of SRTP helpers, or 0 if encryption is inline */
+int janus_ice_get_srtp_helpers(void);
 /*! \brief Method to modify the no-media event timer (i.e., the number of seconds where no media arrives before Janus notifies this)
  * @param[in] timer The new timer value, in seconds */
 void janus_set_no_media_timer(uint timer);
@@ -220,6 +283,11 @@ void janus_ice_set_event_stats_period(int period);
 /*! \brief Method to get the current event handler statistics period (see above)
  * @returns The current event handler stats period */
 int janus_ice_get_event_stats_period(void);
+/*! \brief Method to configure a cap on the number of media packets each handle
+ * is allowed to send us per second: packets beyond the cap are dropped as soon
+ * as they're demultiplexed, before any SRTP work is done on them
+ * @param[in] rate The number of allowed packets per second per handle (0 to disable) */
+void janus_ice_set_media_rate_limit(int rate);
 /*! \brief Method to get the number of active PeerConnection (for stats)
  * @returns The current number of active PeerConnections */
 int janus_ice_get_peerconnection_num(void);
@@ -281,6 +349,7 @@ typedef struct janus_ice_trickle janus_ice_trickle;
 #define JANUS_ICE_HANDLE_WEBRTC_RFC4588_RTX			(1 << 19)
 #define JANUS_ICE_HANDLE_WEBRTC_NEW_DATACHAN_SDP	(1 << 20)
 #define JANUS_ICE_HANDLE_WEBRTC_E2EE				(1 << 21)
+#define JANUS_ICE_HANDLE_WEBRTC_SDP_SENT			(1 << 22)
 
 
 /*! \brief Janus media types */
@@ -333,15 +402,30 @@ void janus_ice_notify_hangup(janus_ice_handle *handle, const char *reason);
 gboolean janus_plugin_session_is_alive(janus_plugin_session *plugin_session);
 
 
-/*! \brief A helper struct for determining when to send NACKs */
-typedef struct janus_seq_info {
-	gint64 ts;
-	guint16 seq;
-	guint16 state;
-	struct janus_seq_info *next;
-	struct janus_seq_info *prev;
-} janus_seq_info;
-void janus_seq_list_free(janus_seq_info **head);
+/*! \brief Number of slots in the janus_seq_window structure: a power of two
+ * (so that sequence numbers can be masked into slots) larger than the number
+ * of sequence numbers we actually track (LAST_SEQS_MAX_LEN) */
+#define JANUS_SEQ_WINDOW_SIZE	256
+#define JANUS_SEQ_WINDOW_MASK	(JANUS_SEQ_WINDOW_SIZE-1)
+/*! \brief A helper struct for determining when to send NACKs: a fixed window
+ * over the 16-bit RTP sequence space, where marking and testing a sequence
+ * number is O(1) and the received bitmap lets the gap scan skip fully
+ * received ranges a word at a time */
+typedef struct janus_seq_window {
+	/*! \brief Oldest sequence number still tracked */
+	guint16 base_seq;
+	/*! \brief Most recent sequence number tracked */
+	guint16 last_seq;
+	/*! \brief Number of sequence numbers currently tracked */
+	guint16 count;
+	/*! \brief Bitmap of received sequence numbers, indexed by masked sequence number */
+	guint64 received[JANUS_SEQ_WINDOW_SIZE/64];
+	/*! \brief NACK state of each tracked sequence number */
+	guint8 states[JANUS_SEQ_WINDOW_SIZE];
+	/*! \brief Monotonic time each tracked sequence number was first expected */
+	gint64 ts[JANUS_SEQ_WINDOW_SIZE];
+} janus_seq_window;
+void janus_seq_window_reset(janus_seq_window *window);
 enum {
 	SEQ_MISSING,
 	SEQ_NACKED,
@@ -366,6 +450,11 @@ struct janus_ice_handle {
 	void *app;
 	/*! \brief Opaque core/plugin session pointer */
 	janus_plugin_session *app_handle;
+	/*! \brief Handle incoming RTP packets should be bridged to directly, skipping
+	 * the plugin, in case the plugin asked for that (see janus_ice_set_media_bridge) */
+	void *bridged_handle;
+	/*! \brief Rate limiter for incoming media packets, if a cap is configured */
+	janus_rate_limiter media_limiter;
 	/*! \brief Mask of WebRTC-related flags for this handle */
 	janus_flags webrtc_flags;
 	/*! \brief Number of gathered candidates */
@@ -376,6 +465,12 @@ struct janus_ice_handle {
 	GMainLoop *mainloop;
 	/*! \brief In case static event loops are used, opaque pointer to the loop */
 	void *static_event_loop;
+	/*! \brief In case static event loops are used, slot this handle occupies
+	 * in the loop timer wheel (-1 if not on the wheel) */
+	gint timer_wheel_slot;
+	/*! \brief In case static event loops are used, monotonic time the next
+	 * TWCC feedback for this handle is due (0 means right away) */
+	gint64 twcc_due;
 	/*! \brief GLib thread for the handle and libnice */
 	GThread *thread;
 	/*! \brief GLib sources for outgoing traffic, recurring RTCP, and stats (and optionally TWCC) */
@@ -406,8 +501,15 @@ struct janus_ice_handle {
 	GList *pending_trickles;
 	/*! \brief Queue of remote candidates that still need to be processed */
 	GAsyncQueue *queued_candidates;
+	/*! \brief Whether the loop has already been asked to process the queued remote
+	 * candidates (lets trickle bursts coalesce into a single wakeup and libnice update) */
+	volatile gint candidates_pending;
 	/*! \brief Queue of events in the loop and outgoing packets to send */
 	GAsyncQueue *queued_packets;
+	/*! \brief Optional lock-free ring for fresh outgoing RTP packets (see \c packet_ring_size) */
+	struct janus_ice_packet_ring *packet_ring;
+	/*! \brief Number of packets dropped because the above ring was full */
+	volatile gint ring_drops;
 	/*! \brief Count of the recent SRTP replay errors, in order to avoid spamming the logs */
 	guint srtp_errors_count;
 	/*! \brief Count of the recent SRTP replay errors, in order to avoid spamming the logs */
@@ -454,6 +556,11 @@ struct janus_ice_peerconnection {
 	GSList *remote_candidates;
 	/*! \brief String representation of the selected pair as notified by libnice (foundations) */
 	gchar *selected_pair;
+	/*! \brief Number of times the selected pair changed after the component first connected
+	 * (e.g., aggressive nomination promoted a better pair, or the peer switched network) */
+	guint selected_pair_changes;
+	/*! \brief Monotonic time of when the selected pair last changed, if it ever did */
+	gint64 selected_pair_changed;
 	/*! \brief Whether the setup of remote candidates for this component has started or not */
 	gboolean process_started;
 	/*! \brief Timer to check when we should consider ICE as failed */
@@ -494,8 +601,12 @@ struct janus_ice_peerconnection {
 	guint16 transport_wide_cc_cycles;
 	/*! \brief Transport wide cc rtp ext ID */
 	guint transport_wide_cc_feedback_count;
-	/*! \brief GLib list of transport wide cc stats in reverse received order */
-	GSList *transport_wide_received_seq_nums;
+	/*! \brief Extended highest transport wide seq num logged so far */
+	guint32 transport_wide_cc_last_ext_seq_num;
+	/*! \brief First extended transport wide seq num ever logged */
+	guint32 transport_wide_cc_first_seq_num;
+	/*! \brief Preallocated circular arrival log for transport wide cc, indexed by transport seq num */
+	janus_rtcp_transport_wide_cc_stats *transport_wide_cc_log;
 	/*! \brief Latest REMB feedback we received */
 	uint32_t remb_bitrate;
 	/*! \brief DTLS role of the server for this stream */
@@ -514,6 +625,13 @@ struct janus_ice_peerconnection {
 	GHashTable *media;
 	/*! \brief GLib hash table of media (SSRCs are the keys) */
 	GHashTable *media_byssrc;
+	/*! \brief SSRC of the last incoming RTP packet we demultiplexed
+	 * @note Consecutive packets almost always belong to the same stream, so
+	 * we keep a single-entry cache to avoid a hash table lookup per packet
+	 * in the receive hot path; only ever accessed from the ICE loop thread */
+	guint32 ssrc_in_cached;
+	/*! \brief Medium the last incoming RTP packet belonged to (see \c ssrc_in_cached) */
+	janus_ice_peerconnection_medium *medium_in_cached;
 	/*! \brief GLib hash table of media (mids are the keys) */
 	GHashTable *media_bymid;
 	/*! \brief GLib hash table of media (media types are the keys)
@@ -548,8 +666,8 @@ struct janus_ice_peerconnection_medium {
 	janus_media_type type;
 	/*! \brief Index of this medium in the media list */
 	int mindex;
-	/*! \brief Media ID */
-	char *mid;
+	/*! \brief Media ID (interned, see g_intern_string) */
+	const char *mid;
 	/*! \brief Media Stream ID info */
 	char *msid, *mstid, *remote_msid, *remote_mstid;
 	/*! \brief SSRC of the server for this medium */
@@ -584,6 +702,16 @@ struct janus_ice_peerconnection_medium {
 	char *codec;
 	/*! \brief Pointer to function to check if a packet is a keyframe (depends on negotiated codec; video only) */
 	gboolean (* video_is_keyframe)(const char* buffer, int len);
+	/*! \brief RTP timestamp of the last incoming frame we ran the keyframe check
+	 * on, per simulcast substream: since all packets of a frame share the RTP
+	 * timestamp, the payload only needs to be parsed once per frame */
+	guint32 kf_check_in_ts[3];
+	/*! \brief Whether we ran the keyframe check on incoming frames at all yet, per simulcast substream */
+	gboolean kf_checked_in[3];
+	/*! \brief RTP timestamp of the last outgoing frame we ran the keyframe check on */
+	guint32 kf_check_out_ts;
+	/*! \brief Whether we ran the keyframe check on outgoing frames at all yet */
+	gboolean kf_checked_out;
 	/*! \brief Media direction */
 	gboolean send, recv;
 	/*! \brief RTCP context(s) for the medium (may be simulcasting) */
@@ -604,10 +732,9 @@ struct janus_ice_peerconnection_medium {
 	guint32 last_rtp_ts;
 	/*! \brief Whether we should do NACKs (in or out) for this medium */
 	gboolean do_nacks;
-	/*! \brief List of previously sent janus_rtp_packet RTP packets, in case we receive NACKs */
-	GQueue *retransmit_buffer;
-	/*! \brief HashTable of retransmittable sequence numbers, in case we receive NACKs */
-	GHashTable *retransmit_seqs;
+	/*! \brief Ring of previously sent janus_rtp_packet RTP packets, indexed by
+	 * sequence number so that lookups on incoming NACKs are O(1) */
+	struct janus_rtp_packet **retransmit_ring;
 	/*! \brief Current sequence number for the RFC4588 rtx SSRC session */
 	guint16 rtx_seq_number;
 	/*! \brief Last time a log message about sending retransmits was printed */
@@ -618,8 +745,8 @@ struct janus_ice_peerconnection_medium {
 	gint64 nack_sent_log_ts;
 	/*! \brief Number of NACKs sent since last log message */
 	guint nack_sent_recent_cnt;
-	/*! \brief List of recently received sequence numbers (as a support to NACK generation, for each simulcast SSRC) */
-	janus_seq_info *last_seqs[3];
+	/*! \brief Window of recently received sequence numbers (as a support to NACK generation, for each simulcast SSRC) */
+	janus_seq_window *last_seqs[3];
 	/*! \brief Stats for incoming data (audio/video/data) */
 	janus_ice_stats in_stats;
 	/*! \brief Stats for outgoing data (audio/video/data) */
@@ -712,6 +839,15 @@ void janus_ice_peerconnection_destroy(janus_ice_peerconnection *pc);
  * @param[in] handle The Janus ICE handle associated with the peer
  * @param[in] packet The RTP packet to send */
 void janus_ice_relay_rtp(janus_ice_handle *handle, janus_plugin_rtp *packet);
+/*! \brief Method plugins can use to have the core bridge incoming RTP packets
+ * on a handle straight to another handle, skipping the plugin callback: this
+ * only makes sense when the plugin would relay the packets unmodified anyway
+ * \note This only covers one direction: for a bidirectional bridge the method
+ * must be invoked twice, swapping the arguments. RTCP and data keep going
+ * through the plugin callbacks in any case
+ * @param[in] handle The Janus ICE handle whose incoming RTP should be bridged
+ * @param[in] bridged The Janus ICE handle to relay the packets to (NULL to tear the bridge down) */
+void janus_ice_set_media_bridge(janus_ice_handle *handle, janus_ice_handle *bridged);
 /*! \brief Core RTCP callback, called when a plugin has an RTCP message to send to a peer
  * @param[in] handle The Janus ICE handle associated with the peer
  * @param[in] packet The RTCP message to send */
@@ -740,6 +876,8 @@ void janus_ice_send_remb(janus_ice_handle *handle, uint32_t bitrate);
  * @param[in] length The buffer length */
 void janus_ice_incoming_data(janus_ice_handle *handle, char *label, char *protocol, gboolean textdata, char *buffer, int length);
 /*! \brief Core SCTP/DataChannel callback, called by the SCTP stack when when there's data to send.
+ * \note The data is encapsulated in DTLS and handed to libnice right away, on the
+ * calling thread: no intermediate copy or bouncing through the send loop is involved
  * @param[in] handle The Janus ICE handle associated with the peer
  * @param[in] buffer The message data (buffer)
  * @param[in] length The buffer length */
@@ -795,8 +933,9 @@ void janus_ice_resend_trickles(janus_ice_handle *handle);
  * @note Check the \c event_loops property in the \c janus.jcfg configuration
  * for an explanation of this feature, and the possible impact on Janus and users
  * @param[in] loops The number of static event loops to start (0 to disable the feature)
- * @param[in] allow_api Whether allocation on a specific loop driven via API should be allowed or not (false by default) */
-void janus_ice_set_static_event_loops(int loops, gboolean allow_api);
+ * @param[in] allow_api Whether allocation on a specific loop driven via API should be allowed or not (false by default)
+ * @param[in] pin_loops Whether each loop thread should be pinned to a specific CPU core (false by default) */
+void janus_ice_set_static_event_loops(int loops, gboolean allow_api, gboolean pin_loops);
 /*! \brief Method to return the number of static event loops, if enabled
  * @returns The number of static event loops, if configured, or 0 if the feature is disabled */
 int janus_ice_get_static_event_loops(void);
@@ -807,6 +946,11 @@ gboolean janus_ice_is_loop_indication_allowed(void);
  * @note This is only used by the Admin API
  * @returns a json_t array with the required info */
 json_t *janus_ice_static_event_loops_info(void);
+/*! \brief Helper method to rebalance the static loops, flagging the overloaded
+ * ones so that they're avoided when automatically assigning new handles
+ * @note This is only used by the Admin API
+ * @returns a json_t array with the per-loop activity since the previous rebalance */
+json_t *janus_ice_static_event_loops_rebalance(void);
 /*! \brief Method to stop all the static event loops, if enabled
  * @note This will wait for the related threads to exit, and so may delay the shutdown process */
 void janus_ice_stop_static_event_loops(void);
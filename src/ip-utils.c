@@ -19,10 +19,15 @@
 #include <net/if.h>
 #include <string.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#endif
 
 #include <glib.h>
 
 #include "ip-utils.h"
+#include "mutex.h"
 
 static int janus_ip_compare_byte_arrays(const uint8_t *b1, const uint8_t *b2, const size_t size) {
 	size_t i;
@@ -259,6 +264,109 @@ int janus_network_lookup_interface(const struct ifaddrs *ifas, const char *iface
 	return 0;
 }
 
+/* We keep a cached snapshot of the local interfaces around, so that hot
+ * paths that need to resolve an interface name or address (e.g., creating
+ * a new mountpoint, or gathering candidates) don't have to enumerate all
+ * the system interfaces with getifaddrs() every time. On Linux we listen
+ * on a netlink socket to know when addresses or links change, and only
+ * refresh the snapshot then; elsewhere we refresh at every acquire, which
+ * keeps the old behaviour. Since a snapshot may still be in use when we
+ * refresh it, we only free it when the last user releases it */
+typedef struct janus_network_ifas_snapshot {
+	struct ifaddrs *ifas;
+	guint users;
+} janus_network_ifas_snapshot;
+static janus_network_ifas_snapshot *ifas_cache = NULL;
+static GSList *ifas_cache_old = NULL;
+static gboolean ifas_cache_dirty = TRUE;
+static int ifas_cache_nlfd = -1;
+static janus_mutex ifas_cache_mutex = JANUS_MUTEX_INITIALIZER;
+
+const struct ifaddrs *janus_network_acquire_ifaddrs(void) {
+	janus_mutex_lock(&ifas_cache_mutex);
+#ifdef __linux__
+	if(ifas_cache_nlfd == -1) {
+		/* First time we're invoked, try subscribing to address/link updates */
+		ifas_cache_nlfd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK, NETLINK_ROUTE);
+		if(ifas_cache_nlfd > -1) {
+			struct sockaddr_nl nladdr = { 0 };
+			nladdr.nl_family = AF_NETLINK;
+			nladdr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+			if(bind(ifas_cache_nlfd, (struct sockaddr *)&nladdr, sizeof(nladdr)) < 0) {
+				close(ifas_cache_nlfd);
+				ifas_cache_nlfd = -2;
+			}
+		} else {
+			ifas_cache_nlfd = -2;
+		}
+	}
+	if(ifas_cache_nlfd > -1) {
+		/* Drain any pending notification: we don't care about the details,
+		 * any event means the snapshot may be stale */
+		char nlbuf[4096];
+		while(recv(ifas_cache_nlfd, nlbuf, sizeof(nlbuf), MSG_DONTWAIT) > 0)
+			ifas_cache_dirty = TRUE;
+	} else {
+		/* No netlink, never trust the snapshot */
+		ifas_cache_dirty = TRUE;
+	}
+#else
+	ifas_cache_dirty = TRUE;
+#endif
+	if(ifas_cache_dirty || ifas_cache == NULL) {
+		struct ifaddrs *ifas = NULL;
+		if(getifaddrs(&ifas) != -1) {
+			if(ifas_cache != NULL) {
+				if(ifas_cache->users == 0) {
+					freeifaddrs(ifas_cache->ifas);
+					g_free(ifas_cache);
+				} else {
+					/* Somebody's still reading the old snapshot, keep it
+					 * around until they're done */
+					ifas_cache_old = g_slist_prepend(ifas_cache_old, ifas_cache);
+				}
+			}
+			ifas_cache = g_malloc(sizeof(janus_network_ifas_snapshot));
+			ifas_cache->ifas = ifas;
+			ifas_cache->users = 0;
+			ifas_cache_dirty = FALSE;
+		}
+	}
+	const struct ifaddrs *result = NULL;
+	if(ifas_cache != NULL) {
+		ifas_cache->users++;
+		result = ifas_cache->ifas;
+	}
+	janus_mutex_unlock(&ifas_cache_mutex);
+	return result;
+}
+
+void janus_network_release_ifaddrs(const struct ifaddrs *ifas) {
+	if(ifas == NULL)
+		return;
+	janus_mutex_lock(&ifas_cache_mutex);
+	if(ifas_cache != NULL && ifas_cache->ifas == ifas) {
+		ifas_cache->users--;
+	} else {
+		/* This must be a snapshot we refreshed while it was in use */
+		GSList *l = ifas_cache_old;
+		while(l) {
+			janus_network_ifas_snapshot *old = (janus_network_ifas_snapshot *)l->data;
+			if(old->ifas == ifas) {
+				old->users--;
+				if(old->users == 0) {
+					ifas_cache_old = g_slist_remove(ifas_cache_old, old);
+					freeifaddrs(old->ifas);
+					g_free(old);
+				}
+				break;
+			}
+			l = l->next;
+		}
+	}
+	janus_mutex_unlock(&ifas_cache_mutex);
+}
+
 int janus_network_detect_local_ip(janus_network_query_options addr_type, janus_network_address *result) {
 	if(result == NULL)
 		return -EINVAL;
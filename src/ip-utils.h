@@ -228,6 +228,22 @@ int janus_network_string_to_address(janus_network_query_options addr_type, const
  */
 int janus_network_lookup_interface(const struct ifaddrs *ifas, const char *iface, janus_network_address *result);
 
+/*!
+ * \brief Get a cached snapshot of the local interfaces, to use in place of \c getifaddrs()
+ * \note On Linux the snapshot is only refreshed when netlink reports a link or address
+ * change, on other platforms at every call. The list MUST be released with
+ * janus_network_release_ifaddrs() when done, and not with \c freeifaddrs()
+ * \return The list of interfaces, or NULL on errors
+ */
+const struct ifaddrs *janus_network_acquire_ifaddrs(void);
+
+/*!
+ * \brief Release a snapshot of the local interfaces previously obtained
+ * via janus_network_acquire_ifaddrs()
+ * \param ifas The list of interfaces to release
+ */
+void janus_network_release_ifaddrs(const struct ifaddrs *ifas);
+
 /*!
  * \brief Helper method to find a valid local IP address, that is an address that can be used to communicate
  * \param addr_type The type of address you're interested in (janus_network_query_options_ipv4,
@@ -0,0 +1,306 @@
+/*! \file    janus-bench.c
+ * \author   Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief    Simple utility to benchmark the Janus relay path
+ * \details  While the fuzzers in the \c fuzzers folder help catching
+ * correctness regressions in the packet processing code, they tell us
+ * nothing about performance: this tool drives synthetic packets through
+ * the hottest helpers of the relay path in isolation (RTP extension
+ * parsing, RTCP compound parsing, simulcast layer selection, SRTP
+ * protection and the queued-packet allocations), and reports the cost
+ * in nanoseconds per packet for each of them.
+ *
+ * Using the utility is quite simple. Just launch it without arguments
+ * to run all the benchmarks and print the results; you can store the
+ * results of a run as a baseline, and compare later runs against it,
+ * e.g., before and after upgrading a dependency or patching the code:
+ *
+\verbatim
+./janus-bench -w baseline.txt
+./janus-bench -b baseline.txt
+\endverbatim
+ *
+ * When comparing, the tool exits with a non-zero code if any benchmark
+ * got slower than the baseline by more than the tolerance (10% by
+ * default, use \c -t to change it), which makes it easy to wire in CI.
+ *
+ * \ingroup tools
+ * \ref tools
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "rtp.h"
+#include "rtcp.h"
+#include "rtpsrtp.h"
+#include "utils.h"
+#include "version.h"
+
+int janus_log_level = 4;
+gboolean janus_log_timestamps = FALSE;
+gboolean janus_log_colors = TRUE;
+char *janus_log_global_prefix = NULL;
+int lock_debug = 0;
+
+/* How many packets each benchmark processes (default=1000000) */
+static int iterations = 1000000;
+
+/* Results of the benchmarks we ran */
+#define JANUS_BENCH_MAX_RESULTS	10
+static struct {
+	const char *name;
+	double ns;
+} results[JANUS_BENCH_MAX_RESULTS];
+static int results_num = 0;
+static void janus_bench_report(const char *name, gint64 elapsed) {
+	double ns = (double)elapsed * 1000.0 / (double)iterations;
+	JANUS_LOG(LOG_INFO, "  %-16s %8.1f ns/packet\n", name, ns);
+	if(results_num < JANUS_BENCH_MAX_RESULTS) {
+		results[results_num].name = name;
+		results[results_num].ns = ns;
+		results_num++;
+	}
+}
+
+/* Helper to craft the RTP packet all benchmarks work on: a typical audio
+ * packet with a one-byte header extension carrying the audio level */
+#define JANUS_BENCH_AUDIOLEVEL_ID	1
+static int janus_bench_craft_rtp(char *buf, int payload) {
+	memset(buf, 0, 12);
+	janus_rtp_header *rtp = (janus_rtp_header *)buf;
+	rtp->version = 2;
+	rtp->extension = 1;
+	rtp->type = 111;
+	rtp->seq_number = htons(1);
+	rtp->timestamp = htonl(960);
+	rtp->ssrc = htonl(0x12345678);
+	/* One-byte header extensions, a single audio-level element */
+	uint8_t *ext = (uint8_t *)(buf + 12);
+	ext[0] = 0xBE; ext[1] = 0xDE;
+	ext[2] = 0x00; ext[3] = 0x01;
+	ext[4] = (JANUS_BENCH_AUDIOLEVEL_ID << 4);
+	ext[5] = 0x85;	/* VAD set, level 5 */
+	ext[6] = 0x00; ext[7] = 0x00;
+	/* Dummy payload */
+	memset(buf + 20, 0xA0, payload);
+	return 20 + payload;
+}
+
+/* RTP extension parsing */
+static void janus_bench_rtp_extensions(void) {
+	char buf[1500];
+	int len = janus_bench_craft_rtp(buf, 160);
+	gboolean vad = FALSE;
+	int level = 0, i = 0;
+	gint64 start = janus_get_monotonic_time();
+	for(i=0; i<iterations; i++)
+		(void)janus_rtp_header_extension_parse_audio_level(buf, len, JANUS_BENCH_AUDIOLEVEL_ID, &vad, &level);
+	janus_bench_report("rtp-extensions", janus_get_monotonic_time() - start);
+}
+
+/* RTCP compound packet parsing */
+static void janus_bench_rtcp_parse(void) {
+	/* Craft a typical compound packet: an SR followed by an SDES */
+	uint8_t buf[64];
+	memset(buf, 0, sizeof(buf));
+	/* SR, no report blocks (28 bytes) */
+	buf[0] = 0x80; buf[1] = 200;
+	buf[2] = 0x00; buf[3] = 0x06;
+	buf[7] = 0x01;	/* Sender SSRC */
+	/* SDES with a CNAME (16 bytes) */
+	uint8_t *sdes = buf + 28;
+	sdes[0] = 0x81; sdes[1] = 202;
+	sdes[2] = 0x00; sdes[3] = 0x03;
+	sdes[7] = 0x01;	/* SSRC */
+	sdes[8] = 0x01; sdes[9] = 0x05;	/* CNAME, 5 bytes */
+	memcpy(sdes + 10, "janus", 5);
+	int len = 28 + 16, i = 0;
+	janus_rtcp_context ctx;
+	memset(&ctx, 0, sizeof(ctx));
+	gint64 start = janus_get_monotonic_time();
+	for(i=0; i<iterations; i++)
+		(void)janus_rtcp_parse(&ctx, (char *)buf, len);
+	janus_bench_report("rtcp-parse", janus_get_monotonic_time() - start);
+}
+
+/* Simulcast layer selection */
+static void janus_bench_simulcast(void) {
+	char buf[1500];
+	int len = janus_bench_craft_rtp(buf, 1200), i = 0;
+	janus_rtp_header *rtp = (janus_rtp_header *)buf;
+	rtp->extension = 0;
+	/* Minimal VP8 payload descriptor (S=1, PID=0) */
+	buf[12] = 0x10;
+	uint32_t ssrcs[3] = { 0xAA, 0xBB, 0xCC };
+	janus_rtp_simulcasting_context context;
+	janus_rtp_simulcasting_context_reset(&context);
+	context.substream_target = 2;
+	context.templayer_target = 2;
+	janus_rtp_switching_context sc;
+	janus_rtp_switching_context_reset(&sc);
+	gint64 start = janus_get_monotonic_time();
+	for(i=0; i<iterations; i++) {
+		/* Interleave the three substreams, as the mixer would see them */
+		rtp->ssrc = htonl(ssrcs[i % 3]);
+		rtp->seq_number = htons(i/3);
+		rtp->timestamp = htonl((i/3) * 3000);
+		(void)janus_rtp_simulcasting_context_process_rtp(&context,
+			buf, len, NULL, 0, ssrcs, NULL, JANUS_VIDEOCODEC_VP8, &sc, NULL);
+	}
+	janus_bench_report("simulcast", janus_get_monotonic_time() - start);
+}
+
+/* SRTP protection */
+static void janus_bench_srtp_protect(void) {
+	/* Create an SRTP session with a static test key */
+	srtp_policy_t policy;
+	memset(&policy, 0, sizeof(policy));
+	srtp_crypto_policy_set_rtp_default(&(policy.rtp));
+	srtp_crypto_policy_set_rtcp_default(&(policy.rtcp));
+	policy.ssrc.type = ssrc_any_outbound;
+	unsigned char key[SRTP_MASTER_LENGTH];
+	memset(key, 0x42, sizeof(key));
+	policy.key = key;
+	policy.next = NULL;
+	srtp_t session = NULL;
+	srtp_err_status_t res = srtp_create(&session, &policy);
+	if(res != srtp_err_status_ok) {
+		JANUS_LOG(LOG_ERR, "  %-16s skipped (srtp_create error %d, %s)\n",
+			"srtp-protect", res, janus_srtp_error_str(res));
+		return;
+	}
+	char template[1500], buf[1500+SRTP_MAX_TRAILER_LEN];
+	int len = janus_bench_craft_rtp(template, 1200), i = 0, errors = 0;
+	janus_rtp_header *rtp = (janus_rtp_header *)buf;
+	gint64 start = janus_get_monotonic_time();
+	for(i=0; i<iterations; i++) {
+		memcpy(buf, template, len);
+		/* Sequence numbers must be monotonic, or replay protection kicks in */
+		rtp->seq_number = htons(i);
+		rtp->timestamp = htonl(i * 960);
+		int protected_len = len;
+		if(srtp_protect(session, buf, &protected_len) != srtp_err_status_ok)
+			errors++;
+	}
+	janus_bench_report("srtp-protect", janus_get_monotonic_time() - start);
+	if(errors > 0)
+		JANUS_LOG(LOG_WARN, "  %-16s got %d SRTP protect errors\n", "srtp-protect", errors);
+	srtp_dealloc(session);
+}
+
+/* Queued-packet path: the allocations and queue traffic each relayed
+ * packet pays in the core (we can't link the actual helpers in ice.c
+ * in isolation, so we replicate what they do mechanically) */
+static void janus_bench_queued_packets(void) {
+	typedef struct janus_bench_packet {
+		char *data;
+		int length;
+	} janus_bench_packet;
+	char template[1500];
+	int len = janus_bench_craft_rtp(template, 1200), i = 0;
+	GAsyncQueue *queue = g_async_queue_new();
+	gint64 start = janus_get_monotonic_time();
+	for(i=0; i<iterations; i++) {
+		janus_bench_packet *pkt = g_malloc(sizeof(janus_bench_packet));
+		pkt->data = g_malloc(len);
+		memcpy(pkt->data, template, len);
+		pkt->length = len;
+		g_async_queue_push(queue, pkt);
+		pkt = g_async_queue_pop(queue);
+		g_free(pkt->data);
+		g_free(pkt);
+	}
+	janus_bench_report("queued-packets", janus_get_monotonic_time() - start);
+	g_async_queue_unref(queue);
+}
+
+/* Main Code */
+int main(int argc, char *argv[])
+{
+	janus_log_init(FALSE, TRUE, NULL);
+	atexit(janus_log_destroy);
+
+	JANUS_LOG(LOG_INFO, "Janus version: %d (%s)\n", janus_version, janus_version_string);
+	JANUS_LOG(LOG_INFO, "Janus commit: %s\n", janus_build_git_sha);
+	JANUS_LOG(LOG_INFO, "Compiled on:  %s\n\n", janus_build_git_time);
+
+	/* Evaluate arguments */
+	const char *write_file = NULL, *baseline_file = NULL;
+	double tolerance = 10.0;
+	int i = 0;
+	for(i=1; i<argc; i++) {
+		if(!strcmp(argv[i], "-i") && i+1 < argc) {
+			iterations = atoi(argv[++i]);
+		} else if(!strcmp(argv[i], "-w") && i+1 < argc) {
+			write_file = argv[++i];
+		} else if(!strcmp(argv[i], "-b") && i+1 < argc) {
+			baseline_file = argv[++i];
+		} else if(!strcmp(argv[i], "-t") && i+1 < argc) {
+			tolerance = atof(argv[++i]);
+		} else {
+			JANUS_LOG(LOG_INFO, "Usage: %s [-i iterations] [-w baseline] [-b baseline] [-t tolerance%%]\n", argv[0]);
+			exit(1);
+		}
+	}
+	if(iterations < 1) {
+		JANUS_LOG(LOG_ERR, "Invalid number of iterations\n");
+		exit(1);
+	}
+	if(srtp_init() != srtp_err_status_ok) {
+		JANUS_LOG(LOG_ERR, "Error setting up libsrtp\n");
+		exit(1);
+	}
+
+	/* Run the benchmarks */
+	JANUS_LOG(LOG_INFO, "Benchmarking the relay path (%d packets each):\n", iterations);
+	janus_bench_rtp_extensions();
+	janus_bench_rtcp_parse();
+	janus_bench_simulcast();
+	janus_bench_srtp_protect();
+	janus_bench_queued_packets();
+	srtp_shutdown();
+
+	/* Store this run as the new baseline? */
+	if(write_file != NULL) {
+		FILE *file = fopen(write_file, "wt");
+		if(file == NULL) {
+			JANUS_LOG(LOG_ERR, "Error opening %s for writing\n", write_file);
+			exit(1);
+		}
+		for(i=0; i<results_num; i++)
+			fprintf(file, "%s %f\n", results[i].name, results[i].ns);
+		fclose(file);
+		JANUS_LOG(LOG_INFO, "\nBaseline saved to %s\n", write_file);
+	}
+	/* Compare against a stored baseline? */
+	int regressions = 0;
+	if(baseline_file != NULL) {
+		FILE *file = fopen(baseline_file, "rt");
+		if(file == NULL) {
+			JANUS_LOG(LOG_ERR, "Error opening baseline %s\n", baseline_file);
+			exit(1);
+		}
+		JANUS_LOG(LOG_INFO, "\nComparing against %s (tolerance %.0f%%):\n", baseline_file, tolerance);
+		char name[40];
+		double base = 0.0;
+		while(fscanf(file, "%39s %lf", name, &base) == 2) {
+			for(i=0; i<results_num; i++) {
+				if(strcmp(results[i].name, name) || base <= 0.0)
+					continue;
+				double delta = (results[i].ns - base) * 100.0 / base;
+				gboolean slower = (delta > tolerance);
+				if(slower)
+					regressions++;
+				JANUS_LOG(LOG_INFO, "  %-16s %8.1f --> %8.1f ns/packet (%+.1f%%)%s\n",
+					name, base, results[i].ns, delta, slower ? " <-- regression" : "");
+			}
+		}
+		fclose(file);
+		if(regressions > 0)
+			JANUS_LOG(LOG_WARN, "\n%d benchmark(s) regressed beyond the tolerance\n", regressions);
+	}
+
+	return regressions > 0 ? 1 : 0;
+}
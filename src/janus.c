@@ -25,6 +25,9 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <poll.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 #include <openssl/rand.h>
 #ifdef HAVE_TURNRESTAPI
@@ -43,6 +46,10 @@
 #include "auth.h"
 #include "record.h"
 #include "events.h"
+#include "metrics.h"
+#ifdef JANUS_LOCK_PROFILER
+#include "lockprofiler.h"
+#endif
 
 
 #define JANUS_NAME				"Janus WebRTC Server"
@@ -92,13 +99,27 @@ janus_mutex counters_mutex;
 /* API secrets */
 static char *api_secret = NULL, *admin_api_secret = NULL;
 
+/* Optional rate limiting for the Janus API: a global cap and a per-session cap
+ * on the number of requests per second, to protect the server from request
+ * floods without having to front it with a rate limiting proxy */
+static janus_rate_limiter api_rate_limiter = { 0 };
+static int session_api_rate_limit = 0;
+
 /* JSON parameters */
 static int janus_process_error_string(janus_request *request, uint64_t session_id, const char *transaction, gint error, gchar *error_string);
 
 static struct janus_json_parameter incoming_request_parameters[] = {
 	{"transaction", JSON_STRING, JANUS_JSON_PARAM_REQUIRED},
 	{"janus", JSON_STRING, JANUS_JSON_PARAM_REQUIRED},
-	{"id", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE}
+	{"id", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	{"dedupe_key", JSON_STRING, 0}
+};
+/* Positional view of the table above, as captured at validation time */
+enum {
+	JANUS_INCOMING_PARAM_TRANSACTION = 0,
+	JANUS_INCOMING_PARAM_JANUS,
+	JANUS_INCOMING_PARAM_ID,
+	JANUS_INCOMING_PARAM_DEDUPE_KEY
 };
 static struct janus_json_parameter attach_parameters[] = {
 	{"plugin", JSON_STRING, JANUS_JSON_PARAM_REQUIRED},
@@ -108,6 +129,10 @@ static struct janus_json_parameter attach_parameters[] = {
 static struct janus_json_parameter body_parameters[] = {
 	{"body", JSON_OBJECT, JANUS_JSON_PARAM_REQUIRED}
 };
+static struct janus_json_parameter event_filter_parameters[] = {
+	{"events", JSON_ARRAY, 0},
+	{"plugin_keys", JSON_ARRAY, 0}
+};
 static struct janus_json_parameter jsep_parameters[] = {
 	{"type", JSON_STRING, JANUS_JSON_PARAM_REQUIRED},
 	{"sdp", JSON_STRING, JANUS_JSON_PARAM_REQUIRED},
@@ -133,6 +158,19 @@ static struct janus_json_parameter debug_parameters[] = {
 static struct janus_json_parameter timeout_parameters[] = {
 	{"timeout", JSON_INTEGER, JANUS_JSON_PARAM_REQUIRED | JANUS_JSON_PARAM_POSITIVE}
 };
+static struct janus_json_parameter list_parameters[] = {
+	{"limit", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	{"cursor", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE}
+};
+static struct janus_json_parameter queryhandles_parameters[] = {
+	{"plugin", JSON_STRING, 0},
+	{"opaque_id", JSON_STRING, 0},
+	{"ready", JANUS_JSON_BOOL, 0},
+	{"has_audio", JANUS_JSON_BOOL, 0},
+	{"has_video", JANUS_JSON_BOOL, 0},
+	{"plugin_info", JANUS_JSON_BOOL, 0},
+	{"limit", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE}
+};
 static struct janus_json_parameter session_timeout_parameters[] = {
 	{"timeout", JSON_INTEGER, JANUS_JSON_PARAM_REQUIRED}
 };
@@ -264,9 +302,20 @@ static GMainLoop *mainloop = NULL;
 /* Public instance name */
 static gchar *server_name = NULL;
 
+/* Most of the messages we create use one of a few constant "janus" values:
+ * we share immortal string constants for those (see janus_json_immortal_string),
+ * rather than allocating and copying a new string for every single message */
+static json_t *janus_json_ack = NULL, *janus_json_success = NULL, *janus_json_event = NULL;
 static json_t *janus_create_message(const char *status, uint64_t session_id, const char *transaction) {
 	json_t *msg = json_object();
-	json_object_set_new(msg, "janus", json_string(status));
+	if(janus_json_ack != NULL && !strcmp(status, "ack"))
+		json_object_set(msg, "janus", janus_json_ack);
+	else if(janus_json_success != NULL && !strcmp(status, "success"))
+		json_object_set(msg, "janus", janus_json_success);
+	else if(janus_json_event != NULL && !strcmp(status, "event"))
+		json_object_set(msg, "janus", janus_json_event);
+	else
+		json_object_set_new(msg, "janus", json_string(status));
 	if(session_id > 0)
 		json_object_set_new(msg, "session_id", json_integer(session_id));
 	if(transaction != NULL)
@@ -291,6 +340,16 @@ static uint global_session_timeout = DEFAULT_SESSION_TIMEOUT;
 
 #define DEFAULT_RECLAIM_SESSION_TIMEOUT		0
 static uint reclaim_session_timeout = DEFAULT_RECLAIM_SESSION_TIMEOUT;
+#define DEFAULT_SHUTDOWN_TIMEOUT		10
+static uint shutdown_timeout = DEFAULT_SHUTDOWN_TIMEOUT;
+/* How often (seconds) state snapshots should be sent to event handlers (0=disabled) */
+static uint state_snapshots_period = 0;
+
+/* Long-running servers with a lot of session churn fragment the allocator
+ * arenas, and the process RSS keeps growing even though the number of live
+ * sessions is flat: if configured to (glibc only), we periodically ask the
+ * allocator to release its freed pages back to the operating system. */
+static uint malloc_trim_interval = 0;	/* Disabled by default */
 
 /* We can programmatically change whether we want to accept new sessions
  * or not: the default is of course TRUE, but we may want to temporarily
@@ -374,9 +433,13 @@ static json_t *janus_info(const char *transaction) {
 	json_object_set_new(info, "min-nack-queue", json_integer(janus_get_min_nack_queue()));
 	json_object_set_new(info, "nack-optimizations", janus_is_nack_optimizations_enabled() ? json_true() : json_false());
 	json_object_set_new(info, "twcc-period", json_integer(janus_get_twcc_period()));
+	if(janus_ice_get_pacing_burst() > 0)
+		json_object_set_new(info, "pacing-burst", json_integer(janus_ice_get_pacing_burst()));
 	if(janus_get_dscp() > 0)
 		json_object_set_new(info, "dscp", json_integer(janus_get_dscp()));
 	json_object_set_new(info, "dtls-mtu", json_integer(janus_dtls_bio_agent_get_mtu()));
+	json_object_set_new(info, "srtp-replay-window", json_integer(janus_dtls_get_srtp_replay_window()));
+	json_object_set_new(info, "srtp-sessions", json_integer(janus_dtls_get_srtp_session_count()));
 	if(janus_ice_get_stun_server() != NULL) {
 		char server[255];
 		g_snprintf(server, 255, "%s:%"SCNu16, janus_ice_get_stun_server(), janus_ice_get_stun_port());
@@ -538,6 +601,13 @@ static void janus_handle_signal(int signum) {
 		g_main_loop_quit(mainloop);
 }
 
+/*! \brief SIGHUP handler (just flags a configuration reload, performed later by the watchdog) */
+static volatile gint reload_configuration_pending = 0;
+static void janus_handle_sighup(int signum) {
+	g_atomic_int_set(&reload_configuration_pending, 1);
+}
+static int janus_reload_configuration(json_t **applied_out, json_t **restart_out);
+
 /*! \brief Termination handler (atexit) */
 static void janus_termination_handler(void) {
 	/* Free the instance name, if provided */
@@ -579,6 +649,7 @@ gboolean janus_transport_is_api_secret_valid(janus_transport *plugin, const char
 gboolean janus_transport_is_auth_token_needed(janus_transport *plugin);
 gboolean janus_transport_is_auth_token_valid(janus_transport *plugin, const char *token);
 void janus_transport_notify_event(janus_transport *plugin, void *transport, json_t *event);
+char *janus_transport_get_metrics(void);
 
 static janus_transport_callbacks janus_handler_transport =
 	{
@@ -590,8 +661,9 @@ static janus_transport_callbacks janus_handler_transport =
 		.is_auth_token_valid = janus_transport_is_auth_token_valid,
 		.events_is_enabled = janus_events_is_enabled,
 		.notify_event = janus_transport_notify_event,
+		.get_metrics = janus_transport_get_metrics,
 	};
-static GAsyncQueue *requests = NULL;
+static GAsyncQueue *requests = NULL, *requests_fast = NULL;
 static janus_request exit_message;
 static GThreadPool *tasks = NULL;
 void janus_transport_task(gpointer data, gpointer user_data);
@@ -618,6 +690,7 @@ void janus_plugin_notify_event(janus_plugin *plugin, janus_plugin_session *plugi
 gboolean janus_plugin_auth_is_signed(void);
 gboolean janus_plugin_auth_is_signature_valid(janus_plugin *plugin, const char *token);
 gboolean janus_plugin_auth_signature_contains(janus_plugin *plugin, const char *token, const char *desc);
+void janus_plugin_set_media_bridge(janus_plugin_session *plugin_session, janus_plugin_session *peer_session);
 static janus_callbacks janus_handler_plugin =
 	{
 		.push_event = janus_plugin_push_event,
@@ -634,13 +707,20 @@ static janus_callbacks janus_handler_plugin =
 		.auth_is_signed = janus_plugin_auth_is_signed,
 		.auth_is_signature_valid = janus_plugin_auth_is_signature_valid,
 		.auth_signature_contains = janus_plugin_auth_signature_contains,
+		.set_media_bridge = janus_plugin_set_media_bridge,
 	};
 ///@}
 
 
 /* Core Sessions */
-static janus_mutex sessions_mutex;
-static GHashTable *sessions = NULL;
+/* Sessions are indexed in a lock-striped table: each stripe is a separate
+ * hash table with its own mutex, and sessions are assigned to stripes by
+ * session ID, so that lookups (which happen for every API request, event
+ * and keepalive) don't all serialize on a single global mutex */
+#define JANUS_SESSIONS_STRIPES	64
+#define JANUS_SESSIONS_STRIPE(session_id) ((session_id) & (JANUS_SESSIONS_STRIPES-1))
+static janus_mutex sessions_mutex[JANUS_SESSIONS_STRIPES];
+static GHashTable *sessions[JANUS_SESSIONS_STRIPES];
 static GMainContext *sessions_watchdog_context = NULL;
 
 /* Counters */
@@ -663,9 +743,95 @@ static void janus_session_free(const janus_refcount *session_ref) {
 		janus_request_destroy(session->source);
 		session->source = NULL;
 	}
+	if(session->event_filter != NULL) {
+		g_hash_table_destroy(session->event_filter);
+		session->event_filter = NULL;
+	}
+	if(session->plugin_event_filter != NULL) {
+		g_hash_table_destroy(session->plugin_event_filter);
+		session->plugin_event_filter = NULL;
+	}
 	g_free(session);
 }
 
+/* To avoid scanning all sessions every time the watchdog fires, sessions are
+ * also tracked in a min-heap ordered by the time they may expire next.
+ * Keepalives just refresh last_activity and don't touch the heap: entries are
+ * revalidated (and rescheduled) lazily when they surface, so each sweep only
+ * visits sessions whose deadline actually elapsed, not all of them */
+typedef struct janus_session_sweep_entry {
+	gint64 deadline;
+	janus_session *session;
+} janus_session_sweep_entry;
+static janus_session_sweep_entry *sessions_sweep = NULL;
+static guint sessions_sweep_len = 0, sessions_sweep_size = 0;
+static janus_mutex sessions_sweep_mutex;
+
+static gint64 janus_session_sweep_deadline(janus_session *session, gint64 now) {
+	/* Use either session-specific timeout or global */
+	gint64 timeout = (gint64)session->timeout;
+	if(timeout == -1)
+		timeout = (gint64)global_session_timeout;
+	/* If timeouts are disabled we still revalidate the session periodically
+	 * (the configuration may change at runtime), just much less often */
+	gint64 deadline = (timeout > 0) ?
+		(session->last_activity + timeout*G_USEC_PER_SEC) : (now + 60*G_USEC_PER_SEC);
+	if(g_atomic_int_get(&session->transport_gone)) {
+		gint64 reclaim = session->last_activity + (gint64)reclaim_session_timeout*G_USEC_PER_SEC;
+		if(reclaim < deadline)
+			deadline = reclaim;
+	}
+	/* Cap how far ahead we schedule, so that runtime changes to the global
+	 * session timeout are picked up within a minute */
+	if(deadline > now + 60*G_USEC_PER_SEC)
+		deadline = now + 60*G_USEC_PER_SEC;
+	return deadline;
+}
+
+/* Schedules a session on the sweep heap: takes a reference on its behalf */
+static void janus_session_sweep_schedule(janus_session *session, gint64 deadline) {
+	janus_refcount_increase(&session->ref);
+	janus_mutex_lock(&sessions_sweep_mutex);
+	if(sessions_sweep_len == sessions_sweep_size) {
+		sessions_sweep_size = sessions_sweep_size ? sessions_sweep_size*2 : 1024;
+		sessions_sweep = g_realloc(sessions_sweep, sessions_sweep_size*sizeof(janus_session_sweep_entry));
+	}
+	guint pos = sessions_sweep_len++;
+	while(pos > 0) {
+		guint parent = (pos-1)/2;
+		if(sessions_sweep[parent].deadline <= deadline)
+			break;
+		sessions_sweep[pos] = sessions_sweep[parent];
+		pos = parent;
+	}
+	sessions_sweep[pos].deadline = deadline;
+	sessions_sweep[pos].session = session;
+	janus_mutex_unlock(&sessions_sweep_mutex);
+}
+
+/* Pops the session with the earliest deadline: the caller must be holding the
+ * sweep mutex, and releases the reference the heap owned when done */
+static janus_session *janus_session_sweep_pop(void) {
+	janus_session *session = sessions_sweep[0].session;
+	sessions_sweep_len--;
+	janus_session_sweep_entry last = sessions_sweep[sessions_sweep_len];
+	guint pos = 0;
+	while(TRUE) {
+		guint child = pos*2+1;
+		if(child >= sessions_sweep_len)
+			break;
+		if(child+1 < sessions_sweep_len && sessions_sweep[child+1].deadline < sessions_sweep[child].deadline)
+			child++;
+		if(last.deadline <= sessions_sweep[child].deadline)
+			break;
+		sessions_sweep[pos] = sessions_sweep[child];
+		pos = child;
+	}
+	if(sessions_sweep_len > 0)
+		sessions_sweep[pos] = last;
+	return session;
+}
+
 static janus_request *janus_session_get_request(janus_session *session) {
 	if(session == NULL)
 		return NULL;
@@ -685,47 +851,87 @@ static void janus_request_unref(janus_request *request) {
 }
 
 static gboolean janus_check_sessions(gpointer user_data) {
-	janus_mutex_lock(&sessions_mutex);
-	if(sessions && g_hash_table_size(sessions) > 0) {
-		GHashTableIter iter;
-		gpointer value;
-		g_hash_table_iter_init(&iter, sessions);
-		while (g_hash_table_iter_next(&iter, NULL, &value)) {
-			janus_session *session = (janus_session *) value;
-			if(!session || g_atomic_int_get(&session->destroyed))
-				continue;
-			gint64 now = janus_get_monotonic_time();
-			/* Use either session-specific timeout or global. */
-			gint64 timeout = (gint64)session->timeout;
-			if(timeout == -1)
-				timeout = (gint64)global_session_timeout;
-			if((timeout > 0 && (now - session->last_activity >= timeout * G_USEC_PER_SEC)) ||
-					((g_atomic_int_get(&session->transport_gone) && now - session->last_activity >= (gint64)reclaim_session_timeout * G_USEC_PER_SEC))) {
-				if(g_atomic_int_compare_and_exchange(&session->timedout, 0, 1)) {
-					JANUS_LOG(LOG_INFO, "Timeout expired for session %"SCNu64"...\n", session->session_id);
-					/* Mark the session as over, we'll deal with it later */
-					janus_session_handles_clear(session);
-					/* Notify the transport */
-					janus_request *source = janus_session_get_request(session);
-					if(source) {
-						json_t *event = janus_create_message("timeout", session->session_id, NULL);
-						/* Send this to the transport client and notify the session's over */
-						source->transport->send_message(source->instance, NULL, FALSE, event);
-						source->transport->session_over(source->instance, session->session_id, TRUE, FALSE);
-					}
-					janus_request_unref(source);
-					/* Notify event handlers as well */
-					if(janus_events_is_enabled())
-						janus_events_notify_handlers(JANUS_EVENT_TYPE_SESSION, JANUS_EVENT_SUBTYPE_NONE,
-							session->session_id, "timeout", NULL);
-					/* FIXME Is this safe? apparently it causes hash table errors on the console */
-					g_hash_table_iter_remove(&iter);
-					janus_session_destroy(session);
+	gint64 now = janus_get_monotonic_time();
+#ifdef __GLIBC__
+	/* If configured to, periodically release freed heap pages back to the OS */
+	if(malloc_trim_interval > 0) {
+		static gint64 last_trim = 0;
+		if(last_trim == 0) {
+			last_trim = now;
+		} else if(now - last_trim >= (gint64)malloc_trim_interval*G_USEC_PER_SEC) {
+			last_trim = now;
+			malloc_trim(0);
+		}
+	}
+#endif
+	/* If a SIGHUP flagged a configuration reload, take care of it now */
+	if(g_atomic_int_compare_and_exchange(&reload_configuration_pending, 1, 0)) {
+		json_t *applied = NULL, *restart = NULL;
+		if(janus_reload_configuration(&applied, &restart) == 0) {
+			if(json_array_size(restart) > 0) {
+				char *props = json_dumps(restart, JSON_COMPACT);
+				JANUS_LOG(LOG_WARN, "Some changed configuration properties can only be applied with a restart: %s\n", props);
+				free(props);
+			}
+			json_decref(applied);
+			json_decref(restart);
+		}
+	}
+	/* Collect the sessions whose sweep deadline elapsed: sessions that have
+	 * been kept alive have a deadline in the future and aren't even visited */
+	GSList *check = NULL;
+	janus_mutex_lock(&sessions_sweep_mutex);
+	while(sessions_sweep_len > 0 && sessions_sweep[0].deadline <= now)
+		check = g_slist_prepend(check, janus_session_sweep_pop());
+	janus_mutex_unlock(&sessions_sweep_mutex);
+	GSList *item = check;
+	while(item) {
+		janus_session *session = (janus_session *)item->data;
+		item = item->next;
+		if(g_atomic_int_get(&session->destroyed)) {
+			/* Session's already gone, just drop the reference the heap owned */
+			janus_refcount_decrease(&session->ref);
+			continue;
+		}
+		/* Use either session-specific timeout or global. */
+		gint64 timeout = (gint64)session->timeout;
+		if(timeout == -1)
+			timeout = (gint64)global_session_timeout;
+		if((timeout > 0 && (now - session->last_activity >= timeout * G_USEC_PER_SEC)) ||
+				((g_atomic_int_get(&session->transport_gone) && now - session->last_activity >= (gint64)reclaim_session_timeout * G_USEC_PER_SEC))) {
+			if(g_atomic_int_compare_and_exchange(&session->timedout, 0, 1)) {
+				JANUS_LOG(LOG_INFO, "Timeout expired for session %"SCNu64"...\n", session->session_id);
+				/* Mark the session as over, we'll deal with it later */
+				janus_session_handles_clear(session);
+				/* Notify the transport */
+				janus_request *source = janus_session_get_request(session);
+				if(source) {
+					json_t *event = janus_create_message("timeout", session->session_id, NULL);
+					/* Send this to the transport client and notify the session's over */
+					source->transport->send_message(source->instance, NULL, FALSE, event);
+					source->transport->session_over(source->instance, session->session_id, TRUE, FALSE);
 				}
-			}
+				janus_request_unref(source);
+				/* Notify event handlers as well */
+				if(janus_events_is_enabled())
+					janus_events_notify_handlers(JANUS_EVENT_TYPE_SESSION, JANUS_EVENT_SUBTYPE_NONE,
+						session->session_id, "timeout", NULL);
+				/* Remove the session from its stripe and schedule it for deletion */
+				int stripe = JANUS_SESSIONS_STRIPE(session->session_id);
+				janus_mutex_lock(&sessions_mutex[stripe]);
+				g_hash_table_remove(sessions[stripe], &session->session_id);
+				janus_mutex_unlock(&sessions_mutex[stripe]);
+				janus_session_destroy(session);
+			}
+			janus_refcount_decrease(&session->ref);
+		} else {
+			/* Not expired after all (e.g., a keepalive refreshed the activity
+			 * in the meanwhile): put it back in the heap with a new deadline */
+			janus_session_sweep_schedule(session, janus_session_sweep_deadline(session, now));
+			janus_refcount_decrease(&session->ref);
 		}
 	}
-	janus_mutex_unlock(&sessions_mutex);
+	g_slist_free(check);
 
 	return G_SOURCE_CONTINUE;
 }
@@ -764,6 +970,39 @@ static gboolean janus_status_sessions(gpointer user_data) {
 	return TRUE;
 }
 
+static gboolean janus_state_snapshot(gpointer user_data) {
+	if(!janus_events_is_enabled())
+		return TRUE;
+	/* Periodic state snapshot: we describe the resources that currently
+	 * exist (rooms, mountpoints, etc., as reported by the plugins that
+	 * support it), so that a hot-standby instance consuming the event
+	 * stream can pre-create them and shorten failovers considerably */
+	json_t *info = json_object();
+	json_object_set_new(info, "status", json_string("snapshot"));
+	json_t *details = json_object();
+	json_object_set_new(details, "sessions", json_integer(g_atomic_int_get(&sessions_num)));
+	json_object_set_new(details, "handles", json_integer(g_atomic_int_get(&handles_num)));
+	json_object_set_new(details, "peerconnections", json_integer(janus_ice_get_peerconnection_num()));
+	json_t *state = json_object();
+	if(plugins != NULL) {
+		GHashTableIter iter;
+		gpointer value;
+		g_hash_table_iter_init(&iter, plugins);
+		while(g_hash_table_iter_next(&iter, NULL, &value)) {
+			janus_plugin *plugin = (janus_plugin *)value;
+			if(plugin == NULL || plugin->query_state == NULL)
+				continue;
+			json_t *plugin_state = plugin->query_state();
+			if(plugin_state != NULL)
+				json_object_set_new(state, plugin->get_package(), plugin_state);
+		}
+	}
+	json_object_set_new(details, "plugins", state);
+	json_object_set_new(info, "info", details);
+	janus_events_notify_handlers(JANUS_EVENT_TYPE_CORE, JANUS_EVENT_SUBTYPE_CORE_SNAPSHOT, 0, info);
+	return TRUE;
+}
+
 janus_session *janus_session_create(guint64 session_id) {
 	janus_session *session = NULL;
 	if(session_id == 0) {
@@ -788,28 +1027,75 @@ janus_session *janus_session_create(guint64 session_id) {
 	g_atomic_int_set(&session->transport_gone, 0);
 	session->last_activity = janus_get_monotonic_time();
 	session->ice_handles = NULL;
+	session->event_filter = NULL;
+	session->plugin_event_filter = NULL;
+	janus_rate_limiter_init(&session->api_limiter, session_api_rate_limit);
 	janus_mutex_init(&session->mutex);
-	janus_mutex_lock(&sessions_mutex);
-	g_hash_table_insert(sessions, janus_uint64_dup(session->session_id), session);
+	janus_rwlock_init(&session->handles_lock);
+	int stripe = JANUS_SESSIONS_STRIPE(session->session_id);
+	janus_mutex_lock(&sessions_mutex[stripe]);
+	g_hash_table_insert(sessions[stripe], janus_uint64_dup(session->session_id), session);
 	g_atomic_int_inc(&sessions_num);
-	janus_mutex_unlock(&sessions_mutex);
+	janus_mutex_unlock(&sessions_mutex[stripe]);
+	/* Also schedule the session on the timeout sweep heap */
+	janus_session_sweep_schedule(session, janus_session_sweep_deadline(session, session->last_activity));
 	return session;
 }
 
 janus_session *janus_session_find(guint64 session_id) {
-	janus_mutex_lock(&sessions_mutex);
-	janus_session *session = g_hash_table_lookup(sessions, &session_id);
+	int stripe = JANUS_SESSIONS_STRIPE(session_id);
+	janus_mutex_lock(&sessions_mutex[stripe]);
+	janus_session *session = g_hash_table_lookup(sessions[stripe], &session_id);
 	if(session != NULL) {
 		/* A successful find automatically increases the reference counter:
 		 * it's up to the caller to decrease it again when done */
 		janus_refcount_increase(&session->ref);
 	}
-	janus_mutex_unlock(&sessions_mutex);
+	janus_mutex_unlock(&sessions_mutex[stripe]);
 	return session;
 }
 
+/* Checks an event against the filter a session may have set with a
+ * "filter_events" request: filtered events are dropped before they're
+ * ever handed to the transport, so they cost no serialization at all */
+static gboolean janus_session_event_filtered(janus_session *session, json_t *event) {
+	if(session->event_filter == NULL && session->plugin_event_filter == NULL)
+		return FALSE;
+	const char *type = json_string_value(json_object_get(event, "janus"));
+	if(type == NULL)
+		return FALSE;
+	gboolean filtered = FALSE;
+	janus_mutex_lock(&session->mutex);
+	if(session->event_filter != NULL && !g_hash_table_contains(session->event_filter, type)) {
+		filtered = TRUE;
+	} else if(session->plugin_event_filter != NULL && !strcasecmp(type, "event")) {
+		/* For plugin events, also check if any of the keys the session
+		 * subscribed to appears in the data the plugin sent */
+		json_t *data = json_object_get(json_object_get(event, "plugindata"), "data");
+		if(data != NULL) {
+			filtered = TRUE;
+			GHashTableIter iter;
+			gpointer key;
+			g_hash_table_iter_init(&iter, session->plugin_event_filter);
+			while(g_hash_table_iter_next(&iter, &key, NULL)) {
+				if(json_object_get(data, (const char *)key) != NULL) {
+					filtered = FALSE;
+					break;
+				}
+			}
+		}
+	}
+	janus_mutex_unlock(&session->mutex);
+	return filtered;
+}
+
 void janus_session_notify_event(janus_session *session, json_t *event) {
 	if(session != NULL && !g_atomic_int_get(&session->destroyed)) {
+		if(janus_session_event_filtered(session, event)) {
+			/* The session is not interested in this event, get rid of it */
+			json_decref(event);
+			return;
+		}
 		janus_request *source = janus_session_get_request(session);
 		if(source != NULL && source->transport != NULL) {
 			/* Send this to the transport client */
@@ -843,38 +1129,38 @@ gint janus_session_destroy(janus_session *session) {
 janus_ice_handle *janus_session_handles_find(janus_session *session, guint64 handle_id) {
 	if(session == NULL)
 		return NULL;
-	janus_mutex_lock(&session->mutex);
+	janus_rwlock_rdlock(&session->handles_lock);
 	janus_ice_handle *handle = session->ice_handles ? g_hash_table_lookup(session->ice_handles, &handle_id) : NULL;
 	if(handle != NULL) {
 		/* A successful find automatically increases the reference counter:
 		 * it's up to the caller to decrease it again when done */
 		janus_refcount_increase(&handle->ref);
 	}
-	janus_mutex_unlock(&session->mutex);
+	janus_rwlock_rdunlock(&session->handles_lock);
 	return handle;
 }
 
 void janus_session_handles_insert(janus_session *session, janus_ice_handle *handle) {
-	janus_mutex_lock(&session->mutex);
+	janus_rwlock_wrlock(&session->handles_lock);
 	if(session->ice_handles == NULL)
 		session->ice_handles = g_hash_table_new_full(g_int64_hash, g_int64_equal, (GDestroyNotify)g_free, (GDestroyNotify)janus_ice_handle_dereference);
 	janus_refcount_increase(&handle->ref);
 	g_hash_table_insert(session->ice_handles, janus_uint64_dup(handle->handle_id), handle);
 	g_atomic_int_inc(&handles_num);
-	janus_mutex_unlock(&session->mutex);
+	janus_rwlock_wrunlock(&session->handles_lock);
 }
 
 gint janus_session_handles_remove(janus_session *session, janus_ice_handle *handle) {
-	janus_mutex_lock(&session->mutex);
+	janus_rwlock_wrlock(&session->handles_lock);
 	gint error = janus_ice_handle_destroy(session, handle);
 	if(g_hash_table_remove(session->ice_handles, &handle->handle_id))
 		g_atomic_int_dec_and_test(&handles_num);
-	janus_mutex_unlock(&session->mutex);
+	janus_rwlock_wrunlock(&session->handles_lock);
 	return error;
 }
 
 void janus_session_handles_clear(janus_session *session) {
-	janus_mutex_lock(&session->mutex);
+	janus_rwlock_wrlock(&session->handles_lock);
 	if(session->ice_handles != NULL && g_hash_table_size(session->ice_handles) > 0) {
 		GHashTableIter iter;
 		gpointer value;
@@ -889,12 +1175,12 @@ void janus_session_handles_clear(janus_session *session) {
 			g_atomic_int_dec_and_test(&handles_num);
 		}
 	}
-	janus_mutex_unlock(&session->mutex);
+	janus_rwlock_wrunlock(&session->handles_lock);
 }
 
 json_t *janus_session_handles_list_json(janus_session *session) {
 	json_t *list = json_array();
-	janus_mutex_lock(&session->mutex);
+	janus_rwlock_rdlock(&session->handles_lock);
 	if(session->ice_handles != NULL && g_hash_table_size(session->ice_handles) > 0) {
 		GHashTableIter iter;
 		gpointer value;
@@ -906,7 +1192,7 @@ json_t *janus_session_handles_list_json(janus_session *session) {
 			json_array_append_new(list, json_integer(handle->handle_id));
 		}
 	}
-	janus_mutex_unlock(&session->mutex);
+	janus_rwlock_rdunlock(&session->handles_lock);
 	return list;
 }
 
@@ -984,6 +1270,30 @@ static int janus_request_check_secret(janus_request *request, guint64 session_id
 	return 0;
 }
 
+/* Optional idempotency cache for the Janus API: requests carrying a "dedupe_key"
+ * property get their response cached for a while, so that retries of the same
+ * request (e.g., an orchestrator retrying on timeout) can be answered with the
+ * cached response, instead of being processed (and hitting plugins) again */
+static int dedupe_ttl = 0;
+static GHashTable *dedupe_cache = NULL;
+static janus_mutex dedupe_mutex = JANUS_MUTEX_INITIALIZER;
+typedef struct janus_dedupe_entry {
+	json_t *reply;		/* The cached response (NULL while the original request is still in flight) */
+	gint64 added;		/* When the entry was last updated */
+} janus_dedupe_entry;
+static void janus_dedupe_entry_free(janus_dedupe_entry *entry) {
+	if(entry == NULL)
+		return;
+	if(entry->reply != NULL)
+		json_decref(entry->reply);
+	g_free(entry);
+}
+static gboolean janus_dedupe_entry_expired(gpointer key, gpointer value, gpointer user_data) {
+	janus_dedupe_entry *entry = (janus_dedupe_entry *)value;
+	gint64 now = *((gint64 *)user_data);
+	return (now - entry->added) >= (gint64)dedupe_ttl*G_USEC_PER_SEC;
+}
+
 static void janus_request_ice_handle_answer(janus_ice_handle *handle, char *jsep_sdp) {
 	/* We got our answer */
 	janus_flags_clear(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_PROCESSING_OFFER);
@@ -1081,18 +1391,66 @@ int janus_process_incoming_request(janus_request *request) {
 
 	int error_code = 0;
 	char error_cause[100];
-	/* Get transaction and message request */
-	JANUS_VALIDATE_JSON_OBJECT(root, incoming_request_parameters,
+	/* Get transaction and message request: validation also captures the
+	 * fields, so we don't have to look each of them up again afterwards */
+	json_t *params_view[4] = { NULL };
+	JANUS_VALIDATE_JSON_OBJECT_CAPTURE(root, incoming_request_parameters, params_view,
 		error_code, error_cause, FALSE,
 		JANUS_ERROR_MISSING_MANDATORY_ELEMENT, JANUS_ERROR_INVALID_ELEMENT_TYPE);
 	if(error_code != 0) {
 		ret = janus_process_error_string(request, session_id, NULL, error_code, error_cause);
 		goto jsondone;
 	}
-	json_t *transaction = json_object_get(root, "transaction");
-	const gchar *transaction_text = json_string_value(transaction);
-	json_t *message = json_object_get(root, "janus");
-	const gchar *message_text = json_string_value(message);
+	const gchar *transaction_text = json_string_value(params_view[JANUS_INCOMING_PARAM_TRANSACTION]);
+	const gchar *message_text = json_string_value(params_view[JANUS_INCOMING_PARAM_JANUS]);
+
+	/* Enforce the global API rate limit, if one is configured */
+	if(!janus_rate_limiter_consume(&api_rate_limiter)) {
+		if(janus_rate_limiter_tripped(&api_rate_limiter)) {
+			JANUS_LOG(LOG_WARN, "Global API rate limit exceeded (%d requests per second), rejecting requests\n",
+				api_rate_limiter.rate);
+			if(janus_events_is_enabled()) {
+				json_t *info = json_object();
+				json_object_set_new(info, "ratelimit", json_string("api"));
+				json_object_set_new(info, "rate", json_integer(api_rate_limiter.rate));
+				janus_events_notify_handlers(JANUS_EVENT_TYPE_CORE, JANUS_EVENT_SUBTYPE_CORE_RATELIMIT, 0, info);
+			}
+		}
+		ret = janus_process_error(request, session_id, transaction_text, JANUS_ERROR_TOO_MANY_REQUESTS, NULL);
+		goto jsondone;
+	}
+
+	/* If the request carries an idempotency key, check if we processed it already */
+	const char *dedupe_key = json_string_value(params_view[JANUS_INCOMING_PARAM_DEDUPE_KEY]);
+	if(dedupe_ttl > 0 && dedupe_key != NULL) {
+		gint64 now = janus_get_monotonic_time();
+		janus_mutex_lock(&dedupe_mutex);
+		if(dedupe_cache == NULL)
+			dedupe_cache = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, (GDestroyNotify)janus_dedupe_entry_free);
+		/* Get rid of the entries that expired, first */
+		g_hash_table_foreach_remove(dedupe_cache, janus_dedupe_entry_expired, &now);
+		janus_dedupe_entry *entry = g_hash_table_lookup(dedupe_cache, dedupe_key);
+		if(entry != NULL && entry->reply == NULL) {
+			/* The original request is still being processed, tell the client to retry later */
+			janus_mutex_unlock(&dedupe_mutex);
+			ret = janus_process_error(request, session_id, transaction_text, JANUS_ERROR_REQUEST_PENDING, NULL);
+			goto jsondone;
+		} else if(entry != NULL) {
+			/* We processed this request already, send the cached response back */
+			JANUS_LOG(LOG_VERB, "Returning cached response for request with dedupe key '%s'\n", dedupe_key);
+			json_t *cached = json_deep_copy(entry->reply);
+			janus_mutex_unlock(&dedupe_mutex);
+			json_object_set_new(cached, "transaction", json_string(transaction_text));
+			ret = janus_process_success(request, cached);
+			goto jsondone;
+		}
+		/* First time we see this key, track the in flight request */
+		entry = g_malloc(sizeof(janus_dedupe_entry));
+		entry->reply = NULL;
+		entry->added = now;
+		g_hash_table_insert(dedupe_cache, g_strdup(dedupe_key), entry);
+		janus_mutex_unlock(&dedupe_mutex);
+	}
 
 	if(session_id == 0 && handle_id == 0) {
 		/* Can only be a 'Create new session', a 'Get info' or a 'Ping/Pong' request */
@@ -1122,7 +1480,7 @@ int janus_process_incoming_request(janus_request *request) {
 			goto jsondone;
 		}
 		session_id = 0;
-		json_t *id = json_object_get(root, "id");
+		json_t *id = params_view[JANUS_INCOMING_PARAM_ID];
 		if(id != NULL) {
 			/* The application provided the session ID to use */
 			session_id = json_integer_value(id);
@@ -1197,6 +1555,21 @@ int janus_process_incoming_request(janus_request *request) {
 	}
 	/* Update the last activity timer */
 	session->last_activity = janus_get_monotonic_time();
+	/* Enforce the per-session API rate limit, if one is configured */
+	if(!janus_rate_limiter_consume(&session->api_limiter)) {
+		if(janus_rate_limiter_tripped(&session->api_limiter)) {
+			JANUS_LOG(LOG_WARN, "Session %"SCNu64" exceeded the API rate limit (%d requests per second), rejecting requests\n",
+				session_id, session->api_limiter.rate);
+			if(janus_events_is_enabled()) {
+				json_t *info = json_object();
+				json_object_set_new(info, "ratelimit", json_string("session"));
+				json_object_set_new(info, "rate", json_integer(session->api_limiter.rate));
+				janus_events_notify_handlers(JANUS_EVENT_TYPE_CORE, JANUS_EVENT_SUBTYPE_CORE_RATELIMIT, session_id, info);
+			}
+		}
+		ret = janus_process_error(request, session_id, transaction_text, JANUS_ERROR_TOO_MANY_REQUESTS, NULL);
+		goto jsondone;
+	}
 	handle = NULL;
 	if(handle_id > 0) {
 		handle = janus_session_handles_find(session, handle_id);
@@ -1214,6 +1587,51 @@ int janus_process_incoming_request(janus_request *request) {
 		json_t *reply = janus_create_message("ack", session_id, transaction_text);
 		/* Send the success reply */
 		ret = janus_process_success(request, reply);
+	} else if(!strcasecmp(message_text, "filter_events")) {
+		/* Update the set of events this session wants to receive: events not
+		 * in the list are dropped before they're ever serialized, which can
+		 * save a lot of traffic when clients only care about a subset (an
+		 * empty or missing list clears the filter and restores everything) */
+		JANUS_VALIDATE_JSON_OBJECT(root, event_filter_parameters,
+			error_code, error_cause, FALSE,
+			JANUS_ERROR_MISSING_MANDATORY_ELEMENT, JANUS_ERROR_INVALID_ELEMENT_TYPE);
+		if(error_code != 0) {
+			ret = janus_process_error_string(request, session_id, transaction_text, error_code, error_cause);
+			goto jsondone;
+		}
+		json_t *events = json_object_get(root, "events");
+		GHashTable *filter = NULL;
+		size_t i = 0;
+		if(events != NULL && json_array_size(events) > 0) {
+			filter = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, NULL);
+			for(i = 0; i < json_array_size(events); i++) {
+				const char *etype = json_string_value(json_array_get(events, i));
+				if(etype != NULL)
+					g_hash_table_insert(filter, g_strdup(etype), GUINT_TO_POINTER(1));
+			}
+		}
+		json_t *keys = json_object_get(root, "plugin_keys");
+		GHashTable *plugin_filter = NULL;
+		if(keys != NULL && json_array_size(keys) > 0) {
+			plugin_filter = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, NULL);
+			for(i = 0; i < json_array_size(keys); i++) {
+				const char *key = json_string_value(json_array_get(keys, i));
+				if(key != NULL)
+					g_hash_table_insert(plugin_filter, g_strdup(key), GUINT_TO_POINTER(1));
+			}
+		}
+		janus_mutex_lock(&session->mutex);
+		if(session->event_filter != NULL)
+			g_hash_table_destroy(session->event_filter);
+		session->event_filter = filter;
+		if(session->plugin_event_filter != NULL)
+			g_hash_table_destroy(session->plugin_event_filter);
+		session->plugin_event_filter = plugin_filter;
+		janus_mutex_unlock(&session->mutex);
+		/* Prepare JSON reply */
+		json_t *reply = janus_create_message("success", session_id, transaction_text);
+		/* Send the success reply */
+		ret = janus_process_success(request, reply);
 	} else if(!strcasecmp(message_text, "attach")) {
 		if(handle != NULL) {
 			/* Attach is a session-level command */
@@ -1282,10 +1700,11 @@ int janus_process_incoming_request(janus_request *request) {
 			ret = janus_process_error(request, session_id, transaction_text, JANUS_ERROR_INVALID_REQUEST_PATH, "Unhandled request '%s' at this path", message_text);
 			goto jsondone;
 		}
-		janus_mutex_lock(&sessions_mutex);
-		if(g_hash_table_remove(sessions, &session->session_id))
+		int stripe = JANUS_SESSIONS_STRIPE(session->session_id);
+		janus_mutex_lock(&sessions_mutex[stripe]);
+		if(g_hash_table_remove(sessions[stripe], &session->session_id))
 			g_atomic_int_dec_and_test(&sessions_num);
-		janus_mutex_unlock(&sessions_mutex);
+		janus_mutex_unlock(&sessions_mutex[stripe]);
 		/* Notify the source that the session has been destroyed */
 		janus_request *source = janus_session_get_request(session);
 		if(source && source->transport)
@@ -1573,7 +1992,7 @@ int janus_process_incoming_request(janus_request *request) {
 					}
 				}
 				/* Process the remote SDP */
-				if(janus_sdp_process_remote(handle, parsed_sdp, rids_hml, FALSE) < 0) {
+				if(janus_sdp_process_remote(handle, parsed_sdp, jsep_sdp, rids_hml, FALSE) < 0) {
 					JANUS_LOG(LOG_ERR, "Error processing SDP\n");
 					janus_sdp_destroy(parsed_sdp);
 					g_free(jsep_type);
@@ -1660,7 +2079,7 @@ int janus_process_incoming_request(janus_request *request) {
 				/* FIXME This is a renegotiation: we can currently only handle simple changes in media
 				 * direction and ICE restarts: anything more complex than that will result in an error */
 				JANUS_LOG(LOG_INFO, "[%"SCNu64"] Negotiation update, checking what changed...\n", handle->handle_id);
-				if(janus_sdp_process_remote(handle, parsed_sdp, rids_hml, TRUE) < 0) {
+				if(janus_sdp_process_remote(handle, parsed_sdp, jsep_sdp, rids_hml, TRUE) < 0) {
 					JANUS_LOG(LOG_ERR, "Error processing SDP\n");
 					janus_sdp_destroy(parsed_sdp);
 					g_free(jsep_type);
@@ -2116,6 +2535,220 @@ jsondone:
 	return ret;
 }
 
+/* Helper to sort session IDs, when paginating list_sessions */
+static gint janus_session_id_compare(gconstpointer a, gconstpointer b) {
+	guint64 id_a = *(guint64 *)a, id_b = *(guint64 *)b;
+	return (id_a < id_b) ? -1 : ((id_a > id_b) ? 1 : 0);
+}
+
+/* Configuration properties we can apply live when reloading the
+ * configuration file: everything else requires a restart to take effect */
+static const char *janus_reload_live_properties[] = {
+	"general.debug_level",
+	"general.debug_timestamps",
+	"general.debug_colors",
+	"general.debug_locks",
+	"general.session_timeout",
+	"general.api_secret",
+	"general.admin_secret",
+	"media.min_nack_queue",
+	"media.no_media_timer",
+	"media.slowlink_threshold",
+	"media.twcc_period",
+	"media.pacing_burst",
+	NULL
+};
+static gboolean janus_reload_property_is_live(const char *path) {
+	int i = 0;
+	for(i = 0; janus_reload_live_properties[i] != NULL; i++) {
+		if(!strcasecmp(path, janus_reload_live_properties[i]))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/* Helper to sync an applied property back to the live configuration tree,
+ * so that subsequent reloads don't report it as changed again */
+static void janus_reload_sync_property(const char *category, const char *name, const char *value) {
+	janus_config_category *cat = janus_config_get(config, NULL, janus_config_type_category, category);
+	if(cat != NULL)
+		janus_config_add(config, cat, janus_config_item_create(name, value));
+}
+
+/* Helper to apply the changed properties that are safe to change live */
+static void janus_reload_apply(janus_config *newcfg, json_t *applied) {
+	janus_config_category *c_general = janus_config_get(newcfg, NULL, janus_config_type_category, "general");
+	janus_config_category *c_media = janus_config_get(newcfg, NULL, janus_config_type_category, "media");
+	janus_config_item *item = c_general ? janus_config_get(newcfg, c_general, janus_config_type_item, "debug_level") : NULL;
+	if(item && item->value) {
+		int level = atoi(item->value);
+		if(level >= LOG_NONE && level <= LOG_MAX && level != janus_log_level) {
+			JANUS_LOG(LOG_INFO, "Reload: setting debug_level to %d\n", level);
+			janus_log_level = level;
+			janus_reload_sync_property("general", "debug_level", item->value);
+			json_array_append_new(applied, json_string("general.debug_level"));
+		}
+	}
+	item = c_general ? janus_config_get(newcfg, c_general, janus_config_type_item, "debug_timestamps") : NULL;
+	if(item && item->value && janus_is_true(item->value) != janus_log_timestamps) {
+		janus_log_timestamps = janus_is_true(item->value);
+		JANUS_LOG(LOG_INFO, "Reload: %s debug_timestamps\n", janus_log_timestamps ? "enabling" : "disabling");
+		janus_reload_sync_property("general", "debug_timestamps", item->value);
+		json_array_append_new(applied, json_string("general.debug_timestamps"));
+	}
+	item = c_general ? janus_config_get(newcfg, c_general, janus_config_type_item, "debug_colors") : NULL;
+	if(item && item->value && janus_is_true(item->value) != janus_log_colors) {
+		janus_log_colors = janus_is_true(item->value);
+		JANUS_LOG(LOG_INFO, "Reload: %s debug_colors\n", janus_log_colors ? "enabling" : "disabling");
+		janus_reload_sync_property("general", "debug_colors", item->value);
+		json_array_append_new(applied, json_string("general.debug_colors"));
+	}
+	item = c_general ? janus_config_get(newcfg, c_general, janus_config_type_item, "debug_locks") : NULL;
+	if(item && item->value && janus_is_true(item->value) != lock_debug) {
+		lock_debug = janus_is_true(item->value);
+		JANUS_LOG(LOG_INFO, "Reload: %s debug_locks\n", lock_debug ? "enabling" : "disabling");
+		janus_reload_sync_property("general", "debug_locks", item->value);
+		json_array_append_new(applied, json_string("general.debug_locks"));
+	}
+	item = c_general ? janus_config_get(newcfg, c_general, janus_config_type_item, "session_timeout") : NULL;
+	if(item && item->value) {
+		int st = atoi(item->value);
+		if(st >= 0 && (uint)st != global_session_timeout) {
+			JANUS_LOG(LOG_INFO, "Reload: setting session_timeout to %d\n", st);
+			global_session_timeout = st;
+			janus_reload_sync_property("general", "session_timeout", item->value);
+			json_array_append_new(applied, json_string("general.session_timeout"));
+		}
+	}
+	item = c_general ? janus_config_get(newcfg, c_general, janus_config_type_item, "api_secret") : NULL;
+	if(item && item->value && g_strcmp0(item->value, api_secret)) {
+		JANUS_LOG(LOG_INFO, "Reload: changing the api_secret\n");
+		g_free(api_secret);
+		api_secret = g_strdup(item->value);
+		janus_reload_sync_property("general", "api_secret", item->value);
+		json_array_append_new(applied, json_string("general.api_secret"));
+	}
+	item = c_general ? janus_config_get(newcfg, c_general, janus_config_type_item, "admin_secret") : NULL;
+	if(item && item->value && g_strcmp0(item->value, admin_api_secret)) {
+		JANUS_LOG(LOG_INFO, "Reload: changing the admin_secret\n");
+		g_free(admin_api_secret);
+		admin_api_secret = g_strdup(item->value);
+		janus_reload_sync_property("general", "admin_secret", item->value);
+		json_array_append_new(applied, json_string("general.admin_secret"));
+	}
+	item = c_media ? janus_config_get(newcfg, c_media, janus_config_type_item, "min_nack_queue") : NULL;
+	if(item && item->value) {
+		int mnq = atoi(item->value);
+		if(mnq >= 0 && mnq != (int)janus_get_min_nack_queue()) {
+			JANUS_LOG(LOG_INFO, "Reload: setting min_nack_queue to %d\n", mnq);
+			janus_set_min_nack_queue(mnq);
+			janus_reload_sync_property("media", "min_nack_queue", item->value);
+			json_array_append_new(applied, json_string("media.min_nack_queue"));
+		}
+	}
+	item = c_media ? janus_config_get(newcfg, c_media, janus_config_type_item, "no_media_timer") : NULL;
+	if(item && item->value) {
+		int nmt = atoi(item->value);
+		if(nmt > 0 && nmt != (int)janus_get_no_media_timer()) {
+			JANUS_LOG(LOG_INFO, "Reload: setting no_media_timer to %d\n", nmt);
+			janus_set_no_media_timer(nmt);
+			janus_reload_sync_property("media", "no_media_timer", item->value);
+			json_array_append_new(applied, json_string("media.no_media_timer"));
+		}
+	}
+	item = c_media ? janus_config_get(newcfg, c_media, janus_config_type_item, "slowlink_threshold") : NULL;
+	if(item && item->value) {
+		int st = atoi(item->value);
+		if(st >= 0 && st != (int)janus_get_slowlink_threshold()) {
+			JANUS_LOG(LOG_INFO, "Reload: setting slowlink_threshold to %d\n", st);
+			janus_set_slowlink_threshold(st);
+			janus_reload_sync_property("media", "slowlink_threshold", item->value);
+			json_array_append_new(applied, json_string("media.slowlink_threshold"));
+		}
+	}
+	item = c_media ? janus_config_get(newcfg, c_media, janus_config_type_item, "twcc_period") : NULL;
+	if(item && item->value) {
+		int tp = atoi(item->value);
+		if(tp > 0 && tp != (int)janus_get_twcc_period()) {
+			JANUS_LOG(LOG_INFO, "Reload: setting twcc_period to %d\n", tp);
+			janus_set_twcc_period(tp);
+			janus_reload_sync_property("media", "twcc_period", item->value);
+			json_array_append_new(applied, json_string("media.twcc_period"));
+		}
+	}
+	item = c_media ? janus_config_get(newcfg, c_media, janus_config_type_item, "pacing_burst") : NULL;
+	if(item && item->value) {
+		int pb = atoi(item->value);
+		if(pb >= 0 && pb != janus_ice_get_pacing_burst()) {
+			JANUS_LOG(LOG_INFO, "Reload: setting pacing_burst to %d\n", pb);
+			janus_ice_set_pacing_burst(pb);
+			janus_reload_sync_property("media", "pacing_burst", item->value);
+			json_array_append_new(applied, json_string("media.pacing_burst"));
+		}
+	}
+}
+
+/* Helper to collect the properties that differ between the configuration
+ * file on disk and the configuration we're running with, and that we could
+ * NOT apply live: those will require a restart to take effect. Notice that
+ * we only look at properties present in the new file, so removed ones (and
+ * changes in arrays) are not detected */
+static void janus_reload_diff(janus_config *newcfg, json_t *restart) {
+	char path[512];
+	GList *cats = janus_config_get_categories(newcfg, NULL), *cl = cats;
+	while(cl) {
+		janus_config_category *cat = (janus_config_category *)cl->data;
+		if(cat->name == NULL) {
+			cl = cl->next;
+			continue;
+		}
+		janus_config_category *oldcat = janus_config_get(config, NULL, janus_config_type_category, cat->name);
+		GList *items = janus_config_get_items(newcfg, cat), *il = items;
+		while(il) {
+			janus_config_item *item = (janus_config_item *)il->data;
+			if(item->name != NULL && item->value != NULL) {
+				g_snprintf(path, sizeof(path), "%s.%s", cat->name, item->name);
+				janus_config_item *olditem = oldcat ?
+					janus_config_get(config, oldcat, janus_config_type_item, item->name) : NULL;
+				if((olditem == NULL || olditem->value == NULL || strcmp(olditem->value, item->value)) &&
+						!janus_reload_property_is_live(path))
+					json_array_append_new(restart, json_string(path));
+			}
+			il = il->next;
+		}
+		g_list_free(items);
+		cl = cl->next;
+	}
+	g_list_free(cats);
+}
+
+/* Re-parse the configuration file, apply the properties that are safe to
+ * change live, and report the changed ones that require a restart instead */
+static int janus_reload_configuration(json_t **applied_out, json_t **restart_out) {
+	if(config_file == NULL)
+		return -1;
+	JANUS_LOG(LOG_INFO, "Reloading configuration file (%s)\n", config_file);
+	janus_config *newcfg = janus_config_parse(config_file);
+	if(newcfg == NULL) {
+		JANUS_LOG(LOG_ERR, "Error re-parsing the configuration file, sticking to the current settings\n");
+		return -2;
+	}
+	json_t *applied = json_array();
+	json_t *restart = json_array();
+	janus_reload_apply(newcfg, applied);
+	janus_reload_diff(newcfg, restart);
+	janus_config_destroy(newcfg);
+	if(applied_out != NULL)
+		*applied_out = applied;
+	else
+		json_decref(applied);
+	if(restart_out != NULL)
+		*restart_out = restart;
+	else
+		json_decref(restart);
+	return 0;
+}
+
 /* Admin/monitor WebServer requests handler */
 int janus_process_incoming_admin_request(janus_request *request) {
 	int ret = -1;
@@ -2184,6 +2817,11 @@ int janus_process_incoming_admin_request(janus_request *request) {
 			json_object_set_new(status, "log_timestamps", janus_log_timestamps ? json_true() : json_false());
 			json_object_set_new(status, "log_colors", janus_log_colors ? json_true() : json_false());
 			json_object_set_new(status, "locking_debug", lock_debug ? json_true() : json_false());
+#ifdef JANUS_LOCK_PROFILER
+			json_object_set_new(status, "lock_profiler", json_true());
+#else
+			json_object_set_new(status, "lock_profiler", json_false());
+#endif
 			json_object_set_new(status, "refcount_debug", refcount_debug ? json_true() : json_false());
 			json_object_set_new(status, "libnice_debug", janus_ice_is_ice_debugging_enabled() ? json_true() : json_false());
 			json_object_set_new(status, "min_nack_queue", json_integer(janus_get_min_nack_queue()));
@@ -2194,6 +2832,24 @@ int janus_process_incoming_admin_request(janus_request *request) {
 			/* Send the success reply */
 			ret = janus_process_success(request, reply);
 			goto jsondone;
+		} else if(!strcasecmp(message_text, "lock_profile")) {
+			/* Return the lock contention recorded so far, per lock site (only
+			 * available if the server was built with --enable-lock-profiler) */
+#ifdef JANUS_LOCK_PROFILER
+			json_t *reply = janus_create_message("success", 0, transaction_text);
+			json_object_set_new(reply, "locks", janus_lock_profiler_summary());
+			/* In case we've been asked to, reset the counters as well, so
+			 * that the next query only covers the traffic from now on */
+			json_t *reset = json_object_get(root, "reset");
+			if(json_is_true(reset))
+				janus_lock_profiler_reset();
+			/* Send the success reply */
+			ret = janus_process_success(request, reply);
+#else
+			ret = janus_process_error(request, session_id, transaction_text, JANUS_ERROR_UNKNOWN,
+				"Lock profiling not compiled in (rebuild with --enable-lock-profiler)");
+#endif
+			goto jsondone;
 		} else if(!strcasecmp(message_text, "set_session_timeout")) {
 			JANUS_VALIDATE_JSON_OBJECT(root, timeout_parameters,
 				error_code, error_cause, FALSE,
@@ -2411,6 +3067,21 @@ int janus_process_incoming_admin_request(janus_request *request) {
 			/* Send the success reply */
 			ret = janus_process_success(request, reply);
 			goto jsondone;
+		} else if(!strcasecmp(message_text, "reload_configuration")) {
+			/* Re-parse the configuration file and apply what's safe to change live */
+			json_t *applied = NULL, *restart = NULL;
+			if(janus_reload_configuration(&applied, &restart) < 0) {
+				ret = janus_process_error(request, session_id, transaction_text,
+					JANUS_ERROR_UNKNOWN, "Error re-parsing the configuration file");
+				goto jsondone;
+			}
+			/* Prepare JSON reply */
+			json_t *reply = janus_create_message("success", 0, transaction_text);
+			json_object_set_new(reply, "applied", applied);
+			json_object_set_new(reply, "restart_needed", restart);
+			/* Send the success reply */
+			ret = janus_process_success(request, reply);
+			goto jsondone;
 		} else if(!strcasecmp(message_text, "accept_new_sessions")) {
 			/* Configure whether we should accept new incoming sessions or not:
 			 * this can be particularly useful whenever, e.g., we want to stop
@@ -2618,29 +3289,186 @@ int janus_process_incoming_admin_request(janus_request *request) {
 			ret = janus_process_success(request, reply);
 			goto jsondone;
 		} else if(!strcasecmp(message_text, "list_sessions")) {
-			/* List sessions */
+			/* List sessions: to keep the response (and the transient JSON)
+			 * bounded on loaded servers, the list can be paginated by passing
+			 * a limit; since session IDs are random, their numeric order is a
+			 * stable iteration key, so each page returns the lowest IDs above
+			 * the provided cursor, plus the cursor to resume from */
+			JANUS_VALIDATE_JSON_OBJECT(root, list_parameters,
+				error_code, error_cause, FALSE,
+				JANUS_ERROR_MISSING_MANDATORY_ELEMENT, JANUS_ERROR_INVALID_ELEMENT_TYPE);
+			if(error_code != 0) {
+				ret = janus_process_error_string(request, session_id, transaction_text, error_code, error_cause);
+				goto jsondone;
+			}
+			guint limit = (guint)json_integer_value(json_object_get(root, "limit"));
+			guint64 cursor = (guint64)json_integer_value(json_object_get(root, "cursor"));
 			session_id = 0;
 			json_t *list = json_array();
-			if(sessions != NULL && g_hash_table_size(sessions) > 0) {
-				janus_mutex_lock(&sessions_mutex);
-				GHashTableIter iter;
-				gpointer value;
-				g_hash_table_iter_init(&iter, sessions);
-				while (g_hash_table_iter_next(&iter, NULL, &value)) {
-					janus_session *session = value;
-					if(session == NULL) {
-						continue;
+			GArray *ids = (limit > 0) ? g_array_new(FALSE, FALSE, sizeof(guint64)) : NULL;
+			int stripe = 0;
+			for(stripe = 0; stripe < JANUS_SESSIONS_STRIPES; stripe++) {
+				janus_mutex_lock(&sessions_mutex[stripe]);
+				if(sessions[stripe] != NULL && g_hash_table_size(sessions[stripe]) > 0) {
+					GHashTableIter iter;
+					gpointer value;
+					g_hash_table_iter_init(&iter, sessions[stripe]);
+					while (g_hash_table_iter_next(&iter, NULL, &value)) {
+						janus_session *session = value;
+						if(session == NULL) {
+							continue;
+						}
+						if(ids != NULL) {
+							/* Paginating: just collect the IDs past the cursor for now */
+							if(session->session_id > cursor)
+								g_array_append_val(ids, session->session_id);
+						} else {
+							json_array_append_new(list, json_integer(session->session_id));
+						}
 					}
-					json_array_append_new(list, json_integer(session->session_id));
 				}
-				janus_mutex_unlock(&sessions_mutex);
+				janus_mutex_unlock(&sessions_mutex[stripe]);
 			}
 			/* Prepare JSON reply */
 			json_t *reply = janus_create_message("success", 0, transaction_text);
+			if(ids != NULL) {
+				/* Sort the collected IDs and only return the requested page */
+				g_array_sort(ids, janus_session_id_compare);
+				guint i = 0;
+				for(i = 0; i < ids->len && i < limit; i++)
+					json_array_append_new(list, json_integer(g_array_index(ids, guint64, i)));
+				if(ids->len > limit) {
+					/* There's more: tell the client where to resume from */
+					json_object_set_new(reply, "next_cursor", json_integer(g_array_index(ids, guint64, limit-1)));
+				}
+				g_array_free(ids, TRUE);
+			}
 			json_object_set_new(reply, "sessions", list);
 			/* Send the success reply */
 			ret = janus_process_success(request, reply);
 			goto jsondone;
+		} else if(!strcasecmp(message_text, "query_handles")) {
+			/* Query all handles on the server with server-side filtering:
+			 * this replaces the per-handle round trips (list_sessions, then
+			 * list_handles per session, then handle_info per handle) that
+			 * fetching the state of, e.g., a large room would need otherwise */
+			JANUS_VALIDATE_JSON_OBJECT(root, queryhandles_parameters,
+				error_code, error_cause, FALSE,
+				JANUS_ERROR_MISSING_MANDATORY_ELEMENT, JANUS_ERROR_INVALID_ELEMENT_TYPE);
+			if(error_code != 0) {
+				ret = janus_process_error_string(request, session_id, transaction_text, error_code, error_cause);
+				goto jsondone;
+			}
+			const char *plugin_filter = json_string_value(json_object_get(root, "plugin"));
+			const char *opaqueid_filter = json_string_value(json_object_get(root, "opaque_id"));
+			json_t *ready_filter = json_object_get(root, "ready");
+			json_t *audio_filter = json_object_get(root, "has_audio");
+			json_t *video_filter = json_object_get(root, "has_video");
+			gboolean plugin_info = json_is_true(json_object_get(root, "plugin_info"));
+			guint limit = (guint)json_integer_value(json_object_get(root, "limit"));
+			session_id = 0;
+			json_t *list = json_array();
+			GSList *query_handles = NULL, *query_infos = NULL;
+			gboolean truncated = FALSE;
+			int stripe = 0;
+			for(stripe = 0; stripe < JANUS_SESSIONS_STRIPES && !truncated; stripe++) {
+				janus_mutex_lock(&sessions_mutex[stripe]);
+				if(sessions[stripe] != NULL && g_hash_table_size(sessions[stripe]) > 0) {
+					GHashTableIter s_iter;
+					gpointer s_value;
+					g_hash_table_iter_init(&s_iter, sessions[stripe]);
+					while(!truncated && g_hash_table_iter_next(&s_iter, NULL, &s_value)) {
+						janus_session *s = s_value;
+						if(s == NULL)
+							continue;
+						janus_rwlock_rdlock(&s->handles_lock);
+						if(s->ice_handles != NULL && g_hash_table_size(s->ice_handles) > 0) {
+							GHashTableIter h_iter;
+							gpointer h_value;
+							g_hash_table_iter_init(&h_iter, s->ice_handles);
+							while(g_hash_table_iter_next(&h_iter, NULL, &h_value)) {
+								janus_ice_handle *h = h_value;
+								if(h == NULL)
+									continue;
+								/* Apply the filters, cheapest checks first */
+								janus_plugin *plugin = (janus_plugin *)h->app;
+								if(plugin_filter != NULL && (plugin == NULL || strcasecmp(plugin_filter, plugin->get_package())))
+									continue;
+								if(opaqueid_filter != NULL && (h->opaque_id == NULL || strcmp(opaqueid_filter, h->opaque_id)))
+									continue;
+								gboolean ready = janus_flags_is_set(&h->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_READY),
+									has_audio = janus_flags_is_set(&h->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_HAS_AUDIO),
+									has_video = janus_flags_is_set(&h->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_HAS_VIDEO);
+								if(ready_filter != NULL && json_is_true(ready_filter) != ready)
+									continue;
+								if(audio_filter != NULL && json_is_true(audio_filter) != has_audio)
+									continue;
+								if(video_filter != NULL && json_is_true(video_filter) != has_video)
+									continue;
+								if(limit > 0 && json_array_size(list) >= limit) {
+									/* Tell the client there were more matches than this */
+									truncated = TRUE;
+									break;
+								}
+								json_t *o = json_object();
+								json_object_set_new(o, "session_id", json_integer(s->session_id));
+								json_object_set_new(o, "handle_id", json_integer(h->handle_id));
+								if(h->opaque_id != NULL)
+									json_object_set_new(o, "opaque_id", json_string(h->opaque_id));
+								if(plugin != NULL)
+									json_object_set_new(o, "plugin", json_string(plugin->get_package()));
+								json_object_set_new(o, "created", json_integer(h->created));
+								json_object_set_new(o, "webrtc-ready", ready ? json_true() : json_false());
+								json_object_set_new(o, "has-audio", has_audio ? json_true() : json_false());
+								json_object_set_new(o, "has-video", has_video ? json_true() : json_false());
+								json_array_append_new(list, o);
+								if(plugin_info && plugin != NULL && plugin->query_session != NULL) {
+									/* We'll ask the plugin once we've dropped all the locks:
+									 * keep a reference to the handle and its summary (the
+									 * lists are consumed in parallel, so they stay paired) */
+									janus_refcount_increase(&h->ref);
+									query_handles = g_slist_prepend(query_handles, h);
+									query_infos = g_slist_prepend(query_infos, o);
+								}
+							}
+						}
+						janus_rwlock_rdunlock(&s->handles_lock);
+					}
+				}
+				janus_mutex_unlock(&sessions_mutex[stripe]);
+			}
+			/* Now that no lock is held, add the plugin-specific info, if needed */
+			GSList *h_item = query_handles, *o_item = query_infos;
+			while(h_item != NULL && o_item != NULL) {
+				janus_ice_handle *h = (janus_ice_handle *)h_item->data;
+				json_t *o = (json_t *)o_item->data;
+				if(h->app != NULL && janus_plugin_session_is_alive(h->app_handle)) {
+					janus_plugin *plugin = (janus_plugin *)h->app;
+					json_t *query = plugin->query_session(h->app_handle);
+					if(query != NULL) {
+						/* Make sure this is a JSON object */
+						if(!json_is_object(query)) {
+							JANUS_LOG(LOG_WARN, "Ignoring invalid query response from the plugin (not an object)\n");
+							json_decref(query);
+						} else {
+							json_object_set_new(o, "plugin_specific", query);
+						}
+					}
+				}
+				janus_refcount_decrease(&h->ref);
+				h_item = h_item->next;
+				o_item = o_item->next;
+			}
+			g_slist_free(query_handles);
+			g_slist_free(query_infos);
+			/* Prepare JSON reply */
+			json_t *reply = janus_create_message("success", 0, transaction_text);
+			json_object_set_new(reply, "handles", list);
+			if(truncated)
+				json_object_set_new(reply, "truncated", json_true());
+			/* Send the success reply */
+			ret = janus_process_success(request, reply);
+			goto jsondone;
 		} else if(!strcasecmp(message_text, "add_token")) {
 			/* Add a token valid for authentication */
 			ret = janus_request_allow_token(request, session_id, transaction_text, TRUE, TRUE);
@@ -2809,6 +3637,96 @@ int janus_process_incoming_admin_request(janus_request *request) {
 			/* Send the success reply */
 			ret = janus_process_success(request, reply);
 			goto jsondone;
+		} else if(!strcasecmp(message_text, "loops_rebalance")) {
+			/* Ask the Janus core to rebalance the static event loops, if enabled:
+			 * loops that dispatched much more traffic than the others since the
+			 * last rebalance are flagged as busy, and new handles will avoid
+			 * them; will return an empty list if static loops are disabled */
+			json_t *list = janus_ice_static_event_loops_rebalance();
+			/* Prepare JSON reply */
+			json_t *reply = janus_create_message("success", 0, transaction_text);
+			json_object_set_new(reply, "loops", list);
+			/* Send the success reply */
+			ret = janus_process_success(request, reply);
+			goto jsondone;
+		} else if(!strcasecmp(message_text, "media_stats")) {
+			/* Bulk media statistics: snapshot the per-medium counters of all
+			 * handles in a single pass, without taking any per-handle mutex
+			 * (counters are plain integers updated by the media threads, so
+			 * reads may be slightly stale but are safe); meant for frequent
+			 * polling by external monitoring without impacting the media path */
+			json_t *list = json_array();
+			guint64 total_packets_in = 0, total_packets_out = 0,
+				total_bytes_in = 0, total_bytes_out = 0;
+			int stripe = 0;
+			for(stripe = 0; stripe < JANUS_SESSIONS_STRIPES; stripe++) {
+				janus_mutex_lock(&sessions_mutex[stripe]);
+				if(sessions[stripe] == NULL || g_hash_table_size(sessions[stripe]) == 0) {
+					janus_mutex_unlock(&sessions_mutex[stripe]);
+					continue;
+				}
+				GHashTableIter iter;
+				gpointer value;
+				g_hash_table_iter_init(&iter, sessions[stripe]);
+				while(g_hash_table_iter_next(&iter, NULL, &value)) {
+					janus_session *session = value;
+					if(session == NULL || g_atomic_int_get(&session->destroyed))
+						continue;
+					janus_rwlock_rdlock(&session->handles_lock);
+					if(session->ice_handles != NULL && g_hash_table_size(session->ice_handles) > 0) {
+						GHashTableIter hiter;
+						gpointer hvalue;
+						g_hash_table_iter_init(&hiter, session->ice_handles);
+						while(g_hash_table_iter_next(&hiter, NULL, &hvalue)) {
+							janus_ice_handle *handle = hvalue;
+							if(handle == NULL || handle->pc == NULL || handle->pc->media == NULL)
+								continue;
+							json_t *h = json_object();
+							json_object_set_new(h, "session_id", json_integer(session->session_id));
+							json_object_set_new(h, "handle_id", json_integer(handle->handle_id));
+							json_t *media = json_array();
+							uint mi = 0;
+							for(mi = 0; mi < g_hash_table_size(handle->pc->media); mi++) {
+								janus_ice_peerconnection_medium *medium = g_hash_table_lookup(handle->pc->media, GUINT_TO_POINTER(mi));
+								if(medium == NULL)
+									continue;
+								json_t *m = json_object();
+								json_object_set_new(m, "mindex", json_integer(medium->mindex));
+								json_object_set_new(m, "type", json_string(janus_media_type_str(medium->type)));
+								json_object_set_new(m, "packets-in", json_integer(medium->in_stats.info[0].packets));
+								json_object_set_new(m, "bytes-in", json_integer(medium->in_stats.info[0].bytes));
+								json_object_set_new(m, "packets-out", json_integer(medium->out_stats.info[0].packets));
+								json_object_set_new(m, "bytes-out", json_integer(medium->out_stats.info[0].bytes));
+								if(medium->type != JANUS_MEDIA_DATA) {
+									json_object_set_new(m, "bytes-lastsec-in", json_integer(medium->in_stats.info[0].bytes_lastsec));
+									json_object_set_new(m, "bytes-lastsec-out", json_integer(medium->out_stats.info[0].bytes_lastsec));
+								}
+								total_packets_in += medium->in_stats.info[0].packets;
+								total_bytes_in += medium->in_stats.info[0].bytes;
+								total_packets_out += medium->out_stats.info[0].packets;
+								total_bytes_out += medium->out_stats.info[0].bytes;
+								json_array_append_new(media, m);
+							}
+							json_object_set_new(h, "media", media);
+							json_array_append_new(list, h);
+						}
+					}
+					janus_rwlock_rdunlock(&session->handles_lock);
+				}
+				janus_mutex_unlock(&sessions_mutex[stripe]);
+			}
+			json_t *totals = json_object();
+			json_object_set_new(totals, "packets-in", json_integer(total_packets_in));
+			json_object_set_new(totals, "bytes-in", json_integer(total_bytes_in));
+			json_object_set_new(totals, "packets-out", json_integer(total_packets_out));
+			json_object_set_new(totals, "bytes-out", json_integer(total_bytes_out));
+			/* Prepare JSON reply */
+			json_t *reply = janus_create_message("success", 0, transaction_text);
+			json_object_set_new(reply, "handles", list);
+			json_object_set_new(reply, "totals", totals);
+			/* Send the success reply */
+			ret = janus_process_success(request, reply);
+			goto jsondone;
 		} else {
 			/* No message we know of */
 			ret = janus_process_error(request, session_id, transaction_text, JANUS_ERROR_INVALID_REQUEST_PATH, "Unhandled request '%s' at this path", message_text);
@@ -2857,10 +3775,11 @@ int janus_process_incoming_admin_request(janus_request *request) {
 	if(handle == NULL) {
 		/* Session-related */
 		if(!strcasecmp(message_text, "destroy_session")) {
-			janus_mutex_lock(&sessions_mutex);
-			if(g_hash_table_remove(sessions, &session->session_id))
+			int stripe = JANUS_SESSIONS_STRIPE(session->session_id);
+			janus_mutex_lock(&sessions_mutex[stripe]);
+			if(g_hash_table_remove(sessions[stripe], &session->session_id))
 				g_atomic_int_dec_and_test(&sessions_num);
-			janus_mutex_unlock(&sessions_mutex);
+			janus_mutex_unlock(&sessions_mutex[stripe]);
 			/* Notify the source that the session has been destroyed */
 			janus_request *source = janus_session_get_request(session);
 			if(source && source->transport)
@@ -3100,6 +4019,11 @@ int janus_process_incoming_admin_request(janus_request *request) {
 			json_object_set_new(info, "pending-trickles", json_integer(g_list_length(handle->pending_trickles)));
 		if(handle->queued_packets)
 			json_object_set_new(info, "queued-packets", json_integer(g_async_queue_length(handle->queued_packets)));
+		if(handle->packet_ring) {
+			json_object_set_new(info, "ring-packets", json_integer(janus_ice_get_packet_ring_depth(handle)));
+			json_object_set_new(info, "ring-hwm", json_integer(janus_ice_get_packet_ring_hwm(handle)));
+			json_object_set_new(info, "ring-drops", json_integer(g_atomic_int_get(&handle->ring_drops)));
+		}
 		if(g_atomic_int_get(&handle->dump_packets) && handle->text2pcap) {
 			if(handle->text2pcap->text) {
 				json_object_set_new(info, "dump-to-text2pcap", json_true());
@@ -3138,6 +4062,26 @@ int janus_process_success(janus_request *request, json_t *payload)
 {
 	if(!request || !payload)
 		return -1;
+	if(!request->admin && dedupe_ttl > 0 && request->message != NULL) {
+		/* If the request carried an idempotency key, cache the response for a while */
+		const char *dedupe_key = json_string_value(json_object_get(request->message, "dedupe_key"));
+		if(dedupe_key != NULL) {
+			janus_mutex_lock(&dedupe_mutex);
+			if(dedupe_cache == NULL)
+				dedupe_cache = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, (GDestroyNotify)janus_dedupe_entry_free);
+			janus_dedupe_entry *entry = g_hash_table_lookup(dedupe_cache, dedupe_key);
+			if(entry == NULL) {
+				entry = g_malloc(sizeof(janus_dedupe_entry));
+				entry->reply = NULL;
+				g_hash_table_insert(dedupe_cache, g_strdup(dedupe_key), entry);
+			}
+			if(entry->reply != NULL)
+				json_decref(entry->reply);
+			entry->reply = json_deep_copy(payload);
+			entry->added = janus_get_monotonic_time();
+			janus_mutex_unlock(&dedupe_mutex);
+		}
+	}
 	/* Pass to the right transport plugin */
 	JANUS_LOG(LOG_HUGE, "Sending %s API response to %s (%p)\n", request->admin ? "admin" : "Janus", request->transport->get_package(), request->instance);
 	return request->transport->send_message(request->instance, request->request_id, request->admin, payload);
@@ -3147,6 +4091,19 @@ static int janus_process_error_string(janus_request *request, uint64_t session_i
 {
 	if(!request)
 		return -1;
+	if(!request->admin && dedupe_ttl > 0 && error != JANUS_ERROR_REQUEST_PENDING && request->message != NULL) {
+		/* Errors are not cached: drop the in flight entry, if any, so that a retry can be processed */
+		const char *dedupe_key = json_string_value(json_object_get(request->message, "dedupe_key"));
+		if(dedupe_key != NULL) {
+			janus_mutex_lock(&dedupe_mutex);
+			if(dedupe_cache != NULL) {
+				janus_dedupe_entry *entry = g_hash_table_lookup(dedupe_cache, dedupe_key);
+				if(entry != NULL && entry->reply == NULL)
+					g_hash_table_remove(dedupe_cache, dedupe_key);
+			}
+			janus_mutex_unlock(&dedupe_mutex);
+		}
+	}
 	/* Done preparing error */
 	JANUS_LOG(LOG_VERB, "[%s] Returning %s API error %d (%s)\n", transaction, request->admin ? "admin" : "Janus", error, error_string);
 	/* Prepare JSON error */
@@ -3218,6 +4175,10 @@ json_t *janus_admin_peerconnection_summary(janus_ice_peerconnection *pc) {
 	}
 	if(pc->selected_pair) {
 		json_object_set_new(i, "selected-pair", json_string(pc->selected_pair));
+		if(pc->selected_pair_changes > 0) {
+			json_object_set_new(i, "selected-pair-changes", json_integer(pc->selected_pair_changes));
+			json_object_set_new(i, "selected-pair-changed", json_integer(pc->selected_pair_changed));
+		}
 	}
 	json_object_set_new(i, "ready", json_integer(pc->cdone));
 	json_object_set_new(w, "ice", i);
@@ -3243,6 +4204,11 @@ json_t *janus_admin_peerconnection_summary(janus_ice_peerconnection *pc) {
 #ifdef HAVE_SCTP
 		/* FIXME Actually check if this succeeded? */
 		json_object_set_new(d, "sctp-association", dtls->sctp ? json_true() : json_false());
+		if(dtls->sctp != NULL) {
+			json_t *channels = janus_sctp_summary(dtls->sctp);
+			if(channels != NULL)
+				json_object_set_new(d, "data-channels", channels);
+		}
 #endif
 		json_t *stats = json_object();
 		json_t *in_stats = json_object();
@@ -3416,6 +4382,37 @@ json_t *janus_admin_peerconnection_medium_summary(janus_ice_peerconnection_mediu
 		if(rtcp_stats != NULL)
 			json_object_set_new(m, "rtcp", rtcp_stats);
 	}
+	/* RTP switching context(s), i.e., the seq/ts continuity state: this is
+	 * what an orchestrator needs to read out in order to re-seed a stream
+	 * coherently when moving a session to another instance (the SRTP keys
+	 * themselves derive from the DTLS handshake, so the target instance
+	 * will always negotiate its own via a renegotiation) */
+	if(medium->type != JANUS_MEDIA_DATA) {
+		json_t *rtp_ctx = NULL;
+		for(vindex=0; vindex<3; vindex++) {
+			janus_rtp_switching_context *context = &medium->rtp_ctx[vindex];
+			if(context->last_ssrc == 0)
+				continue;
+			if(rtp_ctx == NULL)
+				rtp_ctx = json_object();
+			json_t *c = json_object();
+			json_object_set_new(c, "last-ssrc", json_integer(context->last_ssrc));
+			json_object_set_new(c, "last-seq", json_integer(context->last_seq));
+			json_object_set_new(c, "last-ts", json_integer(context->last_ts));
+			json_object_set_new(c, "base-seq", json_integer(context->base_seq));
+			json_object_set_new(c, "base-ts", json_integer(context->base_ts));
+			json_object_set_new(c, "seq-offset", json_integer(context->seq_offset));
+			json_object_set_new(c, "ts-offset", json_integer(context->ts_offset));
+			if(vindex == 0)
+				json_object_set_new(rtp_ctx, "main", c);
+			else if(vindex == 1)
+				json_object_set_new(rtp_ctx, "sim1", c);
+			else
+				json_object_set_new(rtp_ctx, "sim2", c);
+		}
+		if(rtp_ctx != NULL)
+			json_object_set_new(m, "rtp-context", rtp_ctx);
+	}
 	/* Media stats */
 	json_t *stats = json_object();
 	json_t *in_stats = json_object();
@@ -3473,18 +4470,31 @@ void janus_transport_incoming_request(janus_transport *plugin, janus_transport_s
 	JANUS_LOG(LOG_VERB, "Got %s API request from %s (%p)\n", admin ? "an admin" : "a Janus", plugin->get_package(), transport);
 	/* Create a janus_request instance to handle the request */
 	janus_request *request = janus_request_new(plugin, transport, request_id, admin, message, message ? NULL : error);
-	/* Enqueue the request, the thread will pick it up */
-	g_async_queue_push(requests, request);
+	/* Keepalives and trickle candidates are cheap to serve but latency
+	 * sensitive (a trickle stuck in the queue behind a burst of heavy
+	 * requests delays ICE setup), so they get their own fast lane queue
+	 * and handler thread; everything else goes to the regular queue */
+	json_t *header = message ? json_object_get(message, "janus") : NULL;
+	const char *header_text = json_string_value(header);
+	if(!admin && header_text && (!strcasecmp(header_text, "keepalive") || !strcasecmp(header_text, "trickle")))
+		g_async_queue_push(requests_fast, request);
+	else
+		g_async_queue_push(requests, request);
 }
 
 void janus_transport_gone(janus_transport *plugin, janus_transport_session *transport) {
 	/* Get rid of sessions this transport was handling */
 	JANUS_LOG(LOG_VERB, "A %s transport instance has gone away (%p)\n", plugin->get_package(), transport);
-	janus_mutex_lock(&sessions_mutex);
-	if(sessions && g_hash_table_size(sessions) > 0) {
+	int stripe = 0;
+	for(stripe = 0; stripe < JANUS_SESSIONS_STRIPES; stripe++) {
+		janus_mutex_lock(&sessions_mutex[stripe]);
+		if(sessions[stripe] == NULL || g_hash_table_size(sessions[stripe]) == 0) {
+			janus_mutex_unlock(&sessions_mutex[stripe]);
+			continue;
+		}
 		GHashTableIter iter;
 		gpointer value;
-		g_hash_table_iter_init(&iter, sessions);
+		g_hash_table_iter_init(&iter, sessions[stripe]);
 		while(g_hash_table_iter_next(&iter, NULL, &value)) {
 			janus_session *session = (janus_session *) value;
 			if(!session || g_atomic_int_get(&session->destroyed) || g_atomic_int_get(&session->timedout) || session->last_activity == 0)
@@ -3499,11 +4509,14 @@ void janus_transport_gone(janus_transport *plugin, janus_transport_session *tran
 				} else {
 					/* Set flag for transport_gone. The Janus sessions watchdog will clean this up if not reclaimed */
 					g_atomic_int_set(&session->transport_gone, 1);
+					/* Reschedule the session on the sweep heap, as the reclaim
+					 * timeout is typically shorter than the session timeout */
+					janus_session_sweep_schedule(session, janus_session_sweep_deadline(session, janus_get_monotonic_time()));
 				}
 			}
 		}
+		janus_mutex_unlock(&sessions_mutex[stripe]);
 	}
-	janus_mutex_unlock(&sessions_mutex);
 }
 
 gboolean janus_transport_is_api_secret_needed(janus_transport *plugin) {
@@ -3539,6 +4552,12 @@ void janus_transport_notify_event(janus_transport *plugin, void *transport, json
 	}
 }
 
+char *janus_transport_get_metrics(void) {
+	/* A transport asked for the aggregate metrics (e.g., to serve a scrape):
+	 * the media counters live in metrics.c, we just add the core gauges */
+	return janus_metrics_render(g_atomic_int_get(&sessions_num), g_atomic_int_get(&handles_num));
+}
+
 void janus_transport_task(gpointer data, gpointer user_data) {
 	JANUS_LOG(LOG_VERB, "Transport task pool, serving request\n");
 	janus_request *request = (janus_request *)data;
@@ -3555,13 +4574,17 @@ void janus_transport_task(gpointer data, gpointer user_data) {
 }
 
 
-/* Thread to handle incoming requests: may involve an asynchronous task for plugin messaging */
+/* Thread to handle incoming requests: may involve an asynchronous task for plugin messaging.
+ * There's two instances of this thread, each draining its own queue: one for
+ * the latency sensitive fast lane (keepalives and trickles) and one for everything else */
 static void *janus_transport_requests(void *data) {
-	JANUS_LOG(LOG_INFO, "Joining Janus requests handler thread\n");
+	GAsyncQueue *queue = (GAsyncQueue *)data;
+	JANUS_LOG(LOG_INFO, "Joining Janus requests handler thread (%s)\n",
+		queue == requests_fast ? "fast lane" : "regular");
 	janus_request *request = NULL;
 	gboolean destroy = FALSE;
 	while(!g_atomic_int_get(&stop)) {
-		request = g_async_queue_pop(requests);
+		request = g_async_queue_pop(queue);
 		if(request == &exit_message)
 			break;
 		/* Should we process the request synchronously or with a task from the thread pool? */
@@ -3595,7 +4618,8 @@ static void *janus_transport_requests(void *data) {
 		if(destroy)
 			janus_request_destroy(request);
 	}
-	JANUS_LOG(LOG_INFO, "Leaving Janus requests handler thread\n");
+	JANUS_LOG(LOG_INFO, "Leaving Janus requests handler thread (%s)\n",
+		queue == requests_fast ? "fast lane" : "regular");
 	return NULL;
 }
 
@@ -3706,7 +4730,14 @@ int janus_plugin_push_event(janus_plugin_session *plugin_session, janus_plugin *
 	}
 	/* Reference the payload, as the plugin may still need it and will do a decref itself */
 	json_incref(message);
-	/* Prepare JSON event */
+	/* Prepare JSON event.
+	 * Note: when a plugin fans the same payload out to many recipients, the
+	 * shared body is re-encoded by the transport once per recipient, as part
+	 * of each per-recipient envelope (different session_id/sender/transaction).
+	 * Serializing the body once and splicing it into the envelopes would need
+	 * raw-fragment support in jansson (we support down to 2.5, which has none)
+	 * and a transport API change, and would break whenever a plugin tweaks the
+	 * payload between pushes (e.g., per-participant fields), so we don't */
 	json_t *event = janus_create_message("event", session->session_id, transaction);
 	json_object_set_new(event, "sender", json_integer(ice_handle->handle_id));
 	if(janus_is_opaqueid_in_api_enabled() && ice_handle->opaque_id != NULL)
@@ -4040,6 +5071,21 @@ json_t *janus_plugin_handle_sdp(janus_plugin_session *plugin_session, janus_plug
 				JANUS_LOG(LOG_WARN, "[%"SCNu64"] Waited 5s for candidates, that's way too much... going on with what we have (WebRTC setup might fail)\n", ice_handle->handle_id);
 				break;
 			}
+			if(waiting && (waiting % 100) == 0 && ice_handle->agent != NULL &&
+					janus_flags_is_set(&ice_handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_TRICKLE)) {
+				/* The peer supports trickle: if we already have local candidates
+				 * (host ones typically show up right away, STUN/TURN can take
+				 * much longer), send the SDP with those now, and trickle the
+				 * remaining candidates as they're gathered */
+				GSList *candidates = nice_agent_get_local_candidates(ice_handle->agent, ice_handle->stream_id, 1);
+				guint count = g_slist_length(candidates);
+				g_slist_free_full(candidates, (GDestroyNotify)nice_candidate_free);
+				if(count > 0) {
+					JANUS_LOG(LOG_VERB, "[%"SCNu64"] Gathering still in progress, but we have %u candidate(s) and the peer supports trickle: not waiting any longer\n",
+						ice_handle->handle_id, count);
+					break;
+				}
+			}
 			if(waiting && (waiting % 1000) == 0) {
 				JANUS_LOG(LOG_WARN, "[%"SCNu64"] %s for candidates-done callback... (slow gathering, are you using STUN or TURN for Janus too, instead of just for users? Consider enabling full-trickle instead)\n",
 					ice_handle->handle_id, (waiting == 1000 ? "Waiting" : "Still waiting"));
@@ -4202,6 +5248,8 @@ json_t *janus_plugin_handle_sdp(janus_plugin_session *plugin_session, janus_plug
 	json_object_set_new(jsep, "sdp", json_string(sdp_merged));
 	char *tmp = ice_handle->local_sdp;
 	ice_handle->local_sdp = sdp_merged;
+	/* Any local candidate gathered from now on will have to be trickled */
+	janus_flags_set(&ice_handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_SDP_SENT);
 	janus_mutex_unlock(&ice_handle->mutex);
 	g_free(tmp);
 	return jsep;
@@ -4244,6 +5292,24 @@ void janus_plugin_relay_data(janus_plugin_session *plugin_session, janus_plugin_
 #endif
 }
 
+void janus_plugin_set_media_bridge(janus_plugin_session *plugin_session, janus_plugin_session *peer_session) {
+	if((plugin_session < (janus_plugin_session *)0x1000) || g_atomic_int_get(&plugin_session->stopped))
+		return;
+	janus_ice_handle *handle = (janus_ice_handle *)plugin_session->gateway_handle;
+	if(!handle)
+		return;
+	janus_ice_handle *peer = NULL;
+	if(peer_session != NULL) {
+		if((peer_session < (janus_plugin_session *)0x1000) || g_atomic_int_get(&peer_session->stopped))
+			return;
+		peer = (janus_ice_handle *)peer_session->gateway_handle;
+		if(!peer || janus_flags_is_set(&peer->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_STOP)
+				|| janus_flags_is_set(&peer->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ALERT))
+			return;
+	}
+	janus_ice_set_media_bridge(handle, peer);
+}
+
 void janus_plugin_send_pli(janus_plugin_session *plugin_session) {
 	if((plugin_session < (janus_plugin_session *)0x1000) || g_atomic_int_get(&plugin_session->stopped))
 		return;
@@ -4398,6 +5464,36 @@ gboolean janus_plugin_auth_signature_contains(janus_plugin *plugin, const char *
 }
 
 
+/* When parallel plugin initialization is enabled, each plugin's init is
+ * invoked on its own thread at startup, and we join them all before
+ * moving on: sequential initialization remains the default, as plugins
+ * may share global dependencies that don't like concurrent setup */
+typedef struct janus_plugin_init_task {
+	janus_plugin *instance;
+	void *so;
+	GThread *thread;
+	int res;
+} janus_plugin_init_task;
+
+static void *janus_plugin_init_thread(void *data) {
+	janus_plugin_init_task *task = (janus_plugin_init_task *)data;
+	task->res = task->instance->init(&janus_handler_plugin, configs_folder);
+	return NULL;
+}
+
+/* When shutting down, sessions are torn down in parallel on a thread
+ * pool, with a hard deadline (see shutdown_timeout): draining a loaded
+ * node serially can take longer than the init system is willing to
+ * wait, and being SIGKILLed mid-teardown is worse than leaking what's
+ * left, as long as recordings have been flushed to disk first */
+static volatile gint teardown_pending = 0;
+static void janus_session_teardown_task(gpointer data, gpointer user_data) {
+	janus_session *session = (janus_session *)data;
+	janus_session_destroy(session);
+	g_atomic_int_dec_and_test(&teardown_pending);
+}
+
+
 /* Main */
 gint main(int argc, char *argv[]) {
 	/* Core dumps may be disallowed by parent of this process; change that */
@@ -4725,6 +5821,7 @@ gint main(int argc, char *argv[]) {
 	/* Handle SIGINT (CTRL-C), SIGTERM (from service managers) */
 	signal(SIGINT, janus_handle_signal);
 	signal(SIGTERM, janus_handle_signal);
+	signal(SIGHUP, janus_handle_sighup);
 	atexit(janus_termination_handler);
 
 	/* Setup Glib */
@@ -4999,6 +6096,71 @@ gint main(int argc, char *argv[]) {
 		}
 	}
 
+	/* Check if a custom shutdown timeout value was specified */
+	item = janus_config_get(config, config_general, janus_config_type_item, "shutdown_timeout");
+	if(item && item->value) {
+		int st = atoi(item->value);
+		if(st <= 0) {
+			JANUS_LOG(LOG_WARN, "Ignoring shutdown_timeout value as it's not a positive integer\n");
+		} else {
+			shutdown_timeout = st;
+		}
+	}
+
+	/* Check if we should deduplicate retried API requests */
+	item = janus_config_get(config, config_general, janus_config_type_item, "dedupe_ttl");
+	if(item && item->value) {
+		int dt = atoi(item->value);
+		if(dt < 0) {
+			JANUS_LOG(LOG_WARN, "Ignoring dedupe_ttl value as it's not a positive integer\n");
+		} else {
+			dedupe_ttl = dt;
+		}
+	}
+
+	/* Check if we should rate limit incoming API requests */
+	item = janus_config_get(config, config_general, janus_config_type_item, "api_rate_limit");
+	if(item && item->value) {
+		int arl = atoi(item->value);
+		if(arl < 0) {
+			JANUS_LOG(LOG_WARN, "Ignoring api_rate_limit value as it's not a positive integer\n");
+		} else {
+			janus_rate_limiter_init(&api_rate_limiter, arl);
+			if(arl > 0) {
+				JANUS_LOG(LOG_INFO, "Janus API capped to %d requests per second globally\n", arl);
+			}
+		}
+	}
+	item = janus_config_get(config, config_general, janus_config_type_item, "session_rate_limit");
+	if(item && item->value) {
+		int srl = atoi(item->value);
+		if(srl < 0) {
+			JANUS_LOG(LOG_WARN, "Ignoring session_rate_limit value as it's not a positive integer\n");
+		} else {
+			session_api_rate_limit = srl;
+			if(srl > 0) {
+				JANUS_LOG(LOG_INFO, "Janus API capped to %d requests per second per session\n", srl);
+			}
+		}
+	}
+
+	/* Check if we should periodically trim the allocator arenas */
+	item = janus_config_get(config, config_general, janus_config_type_item, "malloc_trim_interval");
+	if(item && item->value) {
+		int mti = atoi(item->value);
+		if(mti < 0) {
+			JANUS_LOG(LOG_WARN, "Ignoring malloc_trim_interval value as it's not a positive integer\n");
+		} else {
+#ifdef __GLIBC__
+			malloc_trim_interval = mti;
+			if(malloc_trim_interval > 0)
+				JANUS_LOG(LOG_INFO, "Will trim the allocator arenas every %u seconds\n", malloc_trim_interval);
+#else
+			JANUS_LOG(LOG_WARN, "Ignoring malloc_trim_interval, malloc_trim is only available with glibc\n");
+#endif
+		}
+	}
+
 	/* Check if a custom candidates timeout value was specified */
 	item = janus_config_get(config, config_general, janus_config_type_item, "candidates_timeout");
 	if(item && item->value) {
@@ -5037,11 +6199,33 @@ gint main(int argc, char *argv[]) {
 		janus_enable_opaqueid_in_api();
 
 	/* Initialize the recorder code */
+	int rec_fsync = 0;
+	item = janus_config_get(config, config_general, janus_config_type_item, "recordings_fsync");
+	if(item && item->value) {
+		rec_fsync = atoi(item->value);
+		if(rec_fsync < 0) {
+			JANUS_LOG(LOG_WARN, "Invalid recordings_fsync value, ignoring\n");
+			rec_fsync = 0;
+		}
+	}
+	gboolean rec_indexed = FALSE;
+	item = janus_config_get(config, config_general, janus_config_type_item, "recordings_indexed");
+	if(item && item->value)
+		rec_indexed = janus_is_true(item->value);
+	int rec_write_budget = 0;
+	item = janus_config_get(config, config_general, janus_config_type_item, "recordings_write_budget");
+	if(item && item->value) {
+		rec_write_budget = atoi(item->value);
+		if(rec_write_budget < 0) {
+			JANUS_LOG(LOG_WARN, "Invalid recordings_write_budget value, ignoring\n");
+			rec_write_budget = 0;
+		}
+	}
 	item = janus_config_get(config, config_general, janus_config_type_item, "recordings_tmp_ext");
 	if(item && item->value) {
-		janus_recorder_init(TRUE, item->value);
+		janus_recorder_init(TRUE, item->value, rec_fsync, rec_indexed, rec_write_budget);
 	} else {
-		janus_recorder_init(FALSE, NULL);
+		janus_recorder_init(FALSE, NULL, rec_fsync, rec_indexed, rec_write_budget);
 	}
 
 	/* Check if we should hide dependencies in "info" requests */
@@ -5199,7 +6383,12 @@ gint main(int argc, char *argv[]) {
 		item = janus_config_get(config, config_general, janus_config_type_item, "allow_loop_indication");
 		if(item && item->value)
 			loops_api = janus_is_true(item->value);
-		janus_ice_set_static_event_loops(loops, loops_api);
+		/* Check if the loop threads should be pinned to specific CPU cores too */
+		gboolean loops_pin = FALSE;
+		item = janus_config_get(config, config_general, janus_config_type_item, "pin_event_loops");
+		if(item && item->value)
+			loops_pin = janus_is_true(item->value);
+		janus_ice_set_static_event_loops(loops, loops_api, loops_pin);
 	}
 	/* Also check if we need a cap on the size of the task pool (default is no limit) */
 	int task_pool_size = -1;
@@ -5209,6 +6398,11 @@ gint main(int argc, char *argv[]) {
 		if(task_pool_size <= 0)
 			task_pool_size = -1;
 	}
+	/* Pre-create the constant strings used in the most common API messages */
+	janus_json_ack = janus_json_immortal_string("ack");
+	janus_json_success = janus_json_immortal_string("success");
+	janus_json_event = janus_json_immortal_string("event");
+
 	/* Initialize the ICE stack now */
 	janus_ice_init(ice_lite, ice_tcp, full_trickle, ignore_mdns, ipv6, ipv6_linklocal, rtp_min_port, rtp_max_port);
 	if(janus_ice_set_stun_server(stun_server, stun_port) < 0) {
@@ -5226,6 +6420,21 @@ gint main(int argc, char *argv[]) {
 		JANUS_LOG(LOG_WARN, "This version of libnice doesn't support setting the ICE nomination mode, ignoring '%s'\n", item->value);
 #else
 		janus_ice_set_nomination_mode(item->value);
+#endif
+	}
+	item = janus_config_get(config, config_nat, janus_config_type_item, "ice_check_initial_timeout");
+	janus_config_item *item2 = janus_config_get(config, config_nat, janus_config_type_item, "ice_check_max_retransmissions");
+	if((item && item->value) || (item2 && item2->value)) {
+#ifndef HAVE_ICE_NOMINATION
+		JANUS_LOG(LOG_WARN, "This version of libnice doesn't support tuning the ICE connectivity check timings, ignoring\n");
+#else
+		int initial_timeout = (item && item->value) ? atoi(item->value) : 0;
+		int max_retransmissions = (item2 && item2->value) ? atoi(item2->value) : 0;
+		if(initial_timeout < 0 || max_retransmissions < 0) {
+			JANUS_LOG(LOG_WARN, "Invalid ICE connectivity check timings, ignoring\n");
+		} else {
+			janus_ice_set_check_timings((guint)initial_timeout, (guint)max_retransmissions);
+		}
 #endif
 	}
 	item = janus_config_get(config, config_nat, janus_config_type_item, "ice_consent_freshness");
@@ -5340,6 +6549,16 @@ gint main(int argc, char *argv[]) {
 			janus_set_no_media_timer(nmt);
 		}
 	}
+	/* Media rate limit */
+	item = janus_config_get(config, config_media, janus_config_type_item, "media_rate_limit");
+	if(item && item->value) {
+		int mrl = atoi(item->value);
+		if(mrl < 0) {
+			JANUS_LOG(LOG_WARN, "Ignoring media_rate_limit value as it's not a positive integer\n");
+		} else {
+			janus_ice_set_media_rate_limit(mrl);
+		}
+	}
 	/* slowlink-threshold value */
 	item = janus_config_get(config, config_media, janus_config_type_item, "slowlink_threshold");
 	if(item && item->value) {
@@ -5360,6 +6579,56 @@ gint main(int argc, char *argv[]) {
 			janus_set_twcc_period(tp);
 		}
 	}
+	/* Pacing burst size */
+	item = janus_config_get(config, config_media, janus_config_type_item, "pacing_burst");
+	if(item && item->value) {
+		int pb = atoi(item->value);
+		if(pb < 0) {
+			JANUS_LOG(LOG_WARN, "Ignoring pacing_burst value as it's not a positive integer\n");
+		} else {
+			janus_ice_set_pacing_burst(pb);
+		}
+	}
+	/* Send batch size */
+	item = janus_config_get(config, config_media, janus_config_type_item, "send_batch_size");
+	if(item && item->value) {
+		int sbs = atoi(item->value);
+		if(sbs < 0) {
+			JANUS_LOG(LOG_WARN, "Ignoring send_batch_size value as it's not a positive integer\n");
+		} else {
+			janus_ice_set_send_batch_size(sbs);
+		}
+	}
+	/* Queued packet pool size */
+	item = janus_config_get(config, config_media, janus_config_type_item, "packet_pool_size");
+	if(item && item->value) {
+		int pps = atoi(item->value);
+		if(pps < 0) {
+			JANUS_LOG(LOG_WARN, "Ignoring packet_pool_size value as it's not a positive integer\n");
+		} else {
+			janus_ice_set_packet_pool_size(pps);
+		}
+	}
+	/* Outgoing RTP ring size */
+	item = janus_config_get(config, config_media, janus_config_type_item, "packet_ring_size");
+	if(item && item->value) {
+		int prs = atoi(item->value);
+		if(prs < 0) {
+			JANUS_LOG(LOG_WARN, "Ignoring packet_ring_size value as it's not a positive integer\n");
+		} else {
+			janus_ice_set_packet_ring_size(prs);
+		}
+	}
+	/* SRTP helper threads */
+	item = janus_config_get(config, config_media, janus_config_type_item, "srtp_helpers");
+	if(item && item->value) {
+		int sh = atoi(item->value);
+		if(sh < 0) {
+			JANUS_LOG(LOG_WARN, "Ignoring srtp_helpers value as it's not a positive integer\n");
+		} else {
+			janus_ice_set_srtp_helpers(sh);
+		}
+	}
 
 	/* Setup OpenSSL stuff */
 	const char *server_pem;
@@ -5405,6 +6674,15 @@ gint main(int argc, char *argv[]) {
 		JANUS_LOG(LOG_WARN, "Invalid DTLS timeout: %s (falling back to default)\n", item->value);
 		dtls_timeout = 1000;
 	}
+	item = janus_config_get(config, config_media, janus_config_type_item, "srtp_replay_window");
+	if(item && item->value) {
+		int srtp_replay_window = atoi(item->value);
+		if(srtp_replay_window <= 0) {
+			JANUS_LOG(LOG_WARN, "Invalid SRTP replay window: %s (ignoring)\n", item->value);
+		} else {
+			janus_dtls_set_srtp_replay_window((guint)srtp_replay_window);
+		}
+	}
 	gboolean rsa_private_key = FALSE;
 	item = janus_config_get(config, config_certs, janus_config_type_item, "rsa_private_key");
 	if(item && item->value)
@@ -5413,7 +6691,11 @@ gint main(int argc, char *argv[]) {
 	item = janus_config_get(config, config_certs, janus_config_type_item, "dtls_accept_selfsigned");
 	if(item && item->value)
 		dtls_accept_selfsigned = janus_is_true(item->value);
-	if(janus_dtls_srtp_init(server_pem, server_key, password, dtls_ciphers, dtls_timeout, rsa_private_key, dtls_accept_selfsigned) < 0) {
+	const char *cert_cache_dir = NULL;
+	item = janus_config_get(config, config_certs, janus_config_type_item, "cert_cache_dir");
+	if(item && item->value)
+		cert_cache_dir = item->value;
+	if(janus_dtls_srtp_init(server_pem, server_key, password, dtls_ciphers, dtls_timeout, rsa_private_key, dtls_accept_selfsigned, cert_cache_dir) < 0) {
 		janus_options_destroy();
 		exit(1);
 	}
@@ -5439,8 +6721,12 @@ gint main(int argc, char *argv[]) {
 	}
 
 	/* Sessions */
-	sessions = g_hash_table_new_full(g_int64_hash, g_int64_equal, (GDestroyNotify)g_free, NULL);
-	janus_mutex_init(&sessions_mutex);
+	int stripe = 0;
+	for(stripe = 0; stripe < JANUS_SESSIONS_STRIPES; stripe++) {
+		sessions[stripe] = g_hash_table_new_full(g_int64_hash, g_int64_equal, (GDestroyNotify)g_free, NULL);
+		janus_mutex_init(&sessions_mutex[stripe]);
+	}
+	janus_mutex_init(&sessions_sweep_mutex);
 	/* Start the sessions timeout watchdog */
 	sessions_watchdog_context = g_main_context_new();
 	GMainLoop *watchdog_loop = g_main_loop_new(sessions_watchdog_context, FALSE);
@@ -5453,9 +6739,11 @@ gint main(int argc, char *argv[]) {
 		janus_options_destroy();
 		exit(1);
 	}
-	/* Start the thread that will dispatch incoming requests */
+	/* Start the threads that will dispatch incoming requests: one for the
+	 * keepalive/trickle fast lane, and one for all the other requests */
 	requests = g_async_queue_new_full((GDestroyNotify)janus_request_destroy);
-	GThread *requests_thread = g_thread_try_new("sessions requests", &janus_transport_requests, NULL, &error);
+	requests_fast = g_async_queue_new_full((GDestroyNotify)janus_request_destroy);
+	GThread *requests_thread = g_thread_try_new("sessions requests", &janus_transport_requests, requests, &error);
 	if(error != NULL) {
 		JANUS_LOG(LOG_FATAL, "Got error %d (%s) trying to start requests thread...\n",
 			error->code, error->message ? error->message : "??");
@@ -5463,6 +6751,14 @@ gint main(int argc, char *argv[]) {
 		janus_options_destroy();
 		exit(1);
 	}
+	GThread *requests_fast_thread = g_thread_try_new("fastlane requests", &janus_transport_requests, requests_fast, &error);
+	if(error != NULL) {
+		JANUS_LOG(LOG_FATAL, "Got error %d (%s) trying to start fast lane requests thread...\n",
+			error->code, error->message ? error->message : "??");
+		g_error_free(error);
+		janus_options_destroy();
+		exit(1);
+	}
 	/* Create a thread pool to handle asynchronous requests, no matter what the transport */
 	error = NULL;
 	tasks = g_thread_pool_new(janus_transport_task, NULL, task_pool_size, FALSE, &error);
@@ -5485,6 +6781,16 @@ gint main(int argc, char *argv[]) {
 	gboolean enable_events = FALSE;
 	if(item && item->value)
 		enable_events = janus_is_true(item->value);
+	/* Check if we should batch events for handlers that support batched delivery */
+	item = janus_config_get(config, config_events, janus_config_type_item, "batching");
+	int events_batching = 0;
+	if(item && item->value) {
+		events_batching = atoi(item->value);
+		if(events_batching < 0) {
+			JANUS_LOG(LOG_WARN, "Invalid events batching window '%s', disabling batching\n", item->value);
+			events_batching = 0;
+		}
+	}
 	if(!enable_events) {
 		JANUS_LOG(LOG_INFO, "Event handlers support disabled\n");
 	} else {
@@ -5520,6 +6826,17 @@ gint main(int argc, char *argv[]) {
 				if(combine)
 					JANUS_LOG(LOG_INFO, "Event handler configured to send media stats combined in a single event\n");
 			}
+			item = janus_config_get(config, config_events, janus_config_type_item, "state_snapshots");
+			if(item && item->value) {
+				/* Check if we should send periodic state snapshots (e.g., for hot-standby replication) */
+				int period = atoi(item->value);
+				if(period < 0) {
+					JANUS_LOG(LOG_WARN, "Invalid state snapshots period, disabling state snapshots\n");
+				} else if(period > 0) {
+					state_snapshots_period = period;
+					JANUS_LOG(LOG_INFO, "Sending state snapshots to event handlers every %d seconds\n", period);
+				}
+			}
 			/* Any event handlers to ignore? */
 			item = janus_config_get(config, config_events, janus_config_type_item, "disable");
 			if(item && item->value)
@@ -5638,7 +6955,7 @@ gint main(int argc, char *argv[]) {
 			g_strfreev(disabled_eventhandlers);
 		disabled_eventhandlers = NULL;
 		/* Initialize the event broadcaster */
-		if(janus_events_init(enable_events, (server_name ? server_name : (char *)JANUS_SERVER_NAME), eventhandlers) < 0) {
+		if(janus_events_init(enable_events, events_batching, (server_name ? server_name : (char *)JANUS_SERVER_NAME), eventhandlers) < 0) {
 			JANUS_LOG(LOG_FATAL, "Error initializing the Event handlers mechanism...\n");
 			janus_options_destroy();
 			exit(1);
@@ -5648,6 +6965,13 @@ gint main(int argc, char *argv[]) {
 		g_source_set_callback(timeout_source, janus_status_sessions, sessions_watchdog_context, NULL);
 		g_source_attach(timeout_source, sessions_watchdog_context);
 		g_source_unref(timeout_source);
+		if(state_snapshots_period > 0) {
+			/* Also send the periodic state snapshots */
+			timeout_source = g_timeout_source_new_seconds(state_snapshots_period);
+			g_source_set_callback(timeout_source, janus_state_snapshot, sessions_watchdog_context, NULL);
+			g_source_attach(timeout_source, sessions_watchdog_context);
+			g_source_unref(timeout_source);
+		}
 	}
 
 	/* Load plugins */
@@ -5667,6 +6991,12 @@ gint main(int argc, char *argv[]) {
 	item = janus_config_get(config, config_plugins, janus_config_type_item, "disable");
 	if(item && item->value)
 		disabled_plugins = g_strsplit(item->value, ",", -1);
+	/* Should we initialize the plugins in parallel, rather than one by one? */
+	gboolean parallel_plugin_init = FALSE;
+	item = janus_config_get(config, config_plugins, janus_config_type_item, "parallel_init");
+	if(item && item->value)
+		parallel_plugin_init = janus_is_true(item->value);
+	GList *plugin_init_tasks = NULL;
 	/* Open the shared objects */
 	struct dirent *pluginent = NULL;
 	char pluginpath[1024];
@@ -5747,35 +7077,73 @@ gint main(int argc, char *argv[]) {
 					janus_plugin->get_package(), janus_plugin->get_api_compatibility(), JANUS_PLUGIN_API_VERSION);
 				continue;
 			}
-			if(janus_plugin->init(&janus_handler_plugin, configs_folder) < 0) {
-				JANUS_LOG(LOG_WARN, "The '%s' plugin could not be initialized\n", janus_plugin->get_package());
-				dlclose(plugin);
-				continue;
-			}
-			JANUS_LOG(LOG_VERB, "\tVersion: %d (%s)\n", janus_plugin->get_version(), janus_plugin->get_version_string());
-			JANUS_LOG(LOG_VERB, "\t   [%s] %s\n", janus_plugin->get_package(), janus_plugin->get_name());
-			JANUS_LOG(LOG_VERB, "\t   %s\n", janus_plugin->get_description());
-			JANUS_LOG(LOG_VERB, "\t   Plugin API version: %d\n", janus_plugin->get_api_compatibility());
-			if(!janus_plugin->incoming_rtp && !janus_plugin->incoming_rtcp && !janus_plugin->incoming_data) {
-				JANUS_LOG(LOG_WARN, "The '%s' plugin doesn't implement any callback for RTP/RTCP/data... is this on purpose?\n",
-					janus_plugin->get_package());
-			}
-			if(!janus_plugin->incoming_rtp && !janus_plugin->incoming_rtcp && janus_plugin->incoming_data) {
-				JANUS_LOG(LOG_WARN, "The '%s' plugin will only handle data channels (no RTP/RTCP)... is this on purpose?\n",
-					janus_plugin->get_package());
-			}
-			if(plugins == NULL)
-				plugins = g_hash_table_new(g_str_hash, g_str_equal);
-			g_hash_table_insert(plugins, (gpointer)janus_plugin->get_package(), janus_plugin);
-			if(plugins_so == NULL)
-				plugins_so = g_hash_table_new(g_str_hash, g_str_equal);
-			g_hash_table_insert(plugins_so, (gpointer)janus_plugin->get_package(), plugin);
+			/* Track this plugin: we'll initialize all of them at the end of the scan */
+			janus_plugin_init_task *task = g_malloc0(sizeof(janus_plugin_init_task));
+			task->instance = janus_plugin;
+			task->so = plugin;
+			plugin_init_tasks = g_list_append(plugin_init_tasks, task);
 		}
 	}
 	closedir(dir);
 	if(disabled_plugins != NULL)
 		g_strfreev(disabled_plugins);
 	disabled_plugins = NULL;
+	/* Initialize the plugins we found: by default one by one, but on separate
+	 * threads if parallel initialization was enabled in the configuration */
+	if(parallel_plugin_init && plugin_init_tasks != NULL && plugin_init_tasks->next != NULL) {
+		JANUS_LOG(LOG_INFO, "Initializing %d plugins in parallel\n", g_list_length(plugin_init_tasks));
+		GList *t = plugin_init_tasks;
+		while(t) {
+			janus_plugin_init_task *task = (janus_plugin_init_task *)t->data;
+			error = NULL;
+			task->thread = g_thread_try_new("plugin init", &janus_plugin_init_thread, task, &error);
+			if(error != NULL) {
+				/* We couldn't spawn a thread, we'll initialize this plugin in the loop below instead */
+				JANUS_LOG(LOG_WARN, "Got error %d (%s) trying to initialize the '%s' plugin on a thread, will do that later\n",
+					error->code, error->message ? error->message : "??", task->instance->get_package());
+				g_error_free(error);
+			}
+			t = t->next;
+		}
+	}
+	GList *t = plugin_init_tasks;
+	while(t) {
+		janus_plugin_init_task *task = (janus_plugin_init_task *)t->data;
+		t = t->next;
+		janus_plugin *janus_plugin = task->instance;
+		void *plugin = task->so;
+		if(task->thread != NULL)
+			g_thread_join(task->thread);
+		else
+			task->res = janus_plugin->init(&janus_handler_plugin, configs_folder);
+		if(task->res < 0) {
+			JANUS_LOG(LOG_WARN, "The '%s' plugin could not be initialized\n", janus_plugin->get_package());
+			dlclose(plugin);
+			g_free(task);
+			continue;
+		}
+		g_free(task);
+		JANUS_LOG(LOG_VERB, "\tVersion: %d (%s)\n", janus_plugin->get_version(), janus_plugin->get_version_string());
+		JANUS_LOG(LOG_VERB, "\t   [%s] %s\n", janus_plugin->get_package(), janus_plugin->get_name());
+		JANUS_LOG(LOG_VERB, "\t   %s\n", janus_plugin->get_description());
+		JANUS_LOG(LOG_VERB, "\t   Plugin API version: %d\n", janus_plugin->get_api_compatibility());
+		if(!janus_plugin->incoming_rtp && !janus_plugin->incoming_rtcp && !janus_plugin->incoming_data) {
+			JANUS_LOG(LOG_WARN, "The '%s' plugin doesn't implement any callback for RTP/RTCP/data... is this on purpose?\n",
+				janus_plugin->get_package());
+		}
+		if(!janus_plugin->incoming_rtp && !janus_plugin->incoming_rtcp && janus_plugin->incoming_data) {
+			JANUS_LOG(LOG_WARN, "The '%s' plugin will only handle data channels (no RTP/RTCP)... is this on purpose?\n",
+				janus_plugin->get_package());
+		}
+		if(plugins == NULL)
+			plugins = g_hash_table_new(g_str_hash, g_str_equal);
+		g_hash_table_insert(plugins, (gpointer)janus_plugin->get_package(), janus_plugin);
+		if(plugins_so == NULL)
+			plugins_so = g_hash_table_new(g_str_hash, g_str_equal);
+		g_hash_table_insert(plugins_so, (gpointer)janus_plugin->get_package(), plugin);
+	}
+	g_list_free(plugin_init_tasks);
+	plugin_init_tasks = NULL;
 
 	/* Load transports */
 	gboolean janus_api_enabled = FALSE, admin_api_enabled = FALSE;
@@ -5974,14 +7342,70 @@ gint main(int argc, char *argv[]) {
 	}
 	/* Get rid of requests tasks and thread too */
 	g_thread_pool_free(tasks, FALSE, FALSE);
-	JANUS_LOG(LOG_INFO, "Ending requests thread...\n");
+	JANUS_LOG(LOG_INFO, "Ending requests threads...\n");
 	g_async_queue_push(requests, &exit_message);
 	g_thread_join(requests_thread);
 	requests_thread = NULL;
 	g_async_queue_unref(requests);
+	g_async_queue_push(requests_fast, &exit_message);
+	g_thread_join(requests_fast_thread);
+	requests_fast_thread = NULL;
+	g_async_queue_unref(requests_fast);
+
+	/* Make sure all open recordings are safely on disk before we start
+	 * tearing sessions down: everything after this point may be slow,
+	 * and if the init system gives up and SIGKILLs us mid-teardown we
+	 * don't want that to corrupt media files */
+	janus_recorder_close_all();
 
 	JANUS_LOG(LOG_INFO, "Destroying sessions...\n");
-	g_clear_pointer(&sessions, g_hash_table_destroy);
+	janus_mutex_lock(&sessions_sweep_mutex);
+	while(sessions_sweep_len > 0) {
+		janus_session *session = janus_session_sweep_pop();
+		janus_refcount_decrease(&session->ref);
+	}
+	g_clear_pointer(&sessions_sweep, g_free);
+	janus_mutex_unlock(&sessions_sweep_mutex);
+	/* Tear the remaining sessions down in parallel, with a hard deadline */
+	GThreadPool *teardown_pool = g_thread_pool_new(janus_session_teardown_task, NULL,
+		MAX(1, (gint)g_get_num_processors()/2), FALSE, NULL);
+	for(stripe = 0; stripe < JANUS_SESSIONS_STRIPES; stripe++) {
+		if(sessions[stripe] == NULL)
+			continue;
+		janus_mutex_lock(&sessions_mutex[stripe]);
+		GHashTableIter siter;
+		gpointer value;
+		g_hash_table_iter_init(&siter, sessions[stripe]);
+		while(g_hash_table_iter_next(&siter, NULL, &value)) {
+			janus_session *session = (janus_session *)value;
+			if(session == NULL || g_atomic_int_get(&session->destroyed))
+				continue;
+			if(teardown_pool != NULL) {
+				g_atomic_int_inc(&teardown_pending);
+				g_thread_pool_push(teardown_pool, session, NULL);
+			} else {
+				/* No thread pool, tear this session down right away */
+				janus_session_destroy(session);
+			}
+		}
+		janus_mutex_unlock(&sessions_mutex[stripe]);
+	}
+	if(teardown_pool != NULL) {
+		gint64 teardown_deadline = janus_get_monotonic_time() + (gint64)shutdown_timeout*G_USEC_PER_SEC;
+		while(g_atomic_int_get(&teardown_pending) > 0 && janus_get_monotonic_time() < teardown_deadline)
+			g_usleep(100000);
+		if(g_atomic_int_get(&teardown_pending) > 0) {
+			JANUS_LOG(LOG_WARN, "Shutdown deadline (%us) reached with %d session(s) not torn down yet, moving on...\n",
+				shutdown_timeout, g_atomic_int_get(&teardown_pending));
+		}
+		/* Discard what's still queued, but wait for the tasks in flight */
+		g_thread_pool_free(teardown_pool, TRUE, TRUE);
+	}
+	for(stripe = 0; stripe < JANUS_SESSIONS_STRIPES; stripe++)
+		g_clear_pointer(&sessions[stripe], g_hash_table_destroy);
+	janus_mutex_lock(&dedupe_mutex);
+	g_clear_pointer(&dedupe_cache, g_hash_table_destroy);
+	janus_mutex_unlock(&dedupe_mutex);
 	janus_ice_deinit();
 	JANUS_LOG(LOG_INFO, "Freeing crypto resources...\n");
 	janus_dtls_srtp_cleanup();
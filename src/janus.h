@@ -30,6 +30,7 @@
 
 #include "mutex.h"
 #include "ice.h"
+#include "ratelimit.h"
 #include "refcount.h"
 #include "transports/transport.h"
 #include "events/eventhandler.h"
@@ -56,8 +57,19 @@ typedef struct janus_session {
 	gint timeout;
 	/*! \brief Flag to notify that transport is gone */
 	volatile gint transport_gone;
-	/*! \brief Mutex to lock/unlock this session */
+	/*! \brief Optional set of event types ("janus" names) this session wants to
+	 * receive, NULL means everything is delivered (see the "filter_events" request) */
+	GHashTable *event_filter;
+	/*! \brief Optional set of keys at least one of which must appear in the data
+	 * of plugin events for them to be delivered, NULL means no key check is done */
+	GHashTable *plugin_event_filter;
+	/*! \brief Rate limiter for API requests on this session, if a cap is configured */
+	janus_rate_limiter api_limiter;
+	/*! \brief Mutex to lock/unlock this session (request source and timeout) */
 	janus_mutex mutex;
+	/*! \brief Read/write lock protecting the map of handles, so that concurrent
+	 * lookups on the same session don't serialize on the session mutex */
+	janus_rwlock handles_lock;
 	/*! \brief Atomic flag to check if this instance has been destroyed */
 	volatile gint destroyed;
 	/*! \brief Reference counter for this instance */
@@ -0,0 +1,97 @@
+/*! \file    lockprofiler.c
+ * \author   Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief    Lock contention profiler
+ * \details  Optional profiler for the mutexes wrapped by \c janus_mutex:
+ * when the server is built with \c --enable-lock-profiler, every
+ * \c janus_mutex_lock that can't acquire its mutex right away records
+ * how long it had to wait, aggregated per lock site (the file and line
+ * the lock was taken from). The aggregate counters can be queried (and
+ * reset) at runtime via the \c lock_profile Admin API request.
+ *
+ * \ingroup core
+ * \ref core
+ */
+
+#ifdef JANUS_LOCK_PROFILER
+
+#include <string.h>
+
+#include "lockprofiler.h"
+
+/* Per-site counters: one instance per file:line a contended lock was taken from */
+typedef struct janus_lock_profiler_site {
+	/*! \brief Lock site (file:line string, as composed by the janus_mutex_lock macro) */
+	char *site;
+	/*! \brief Number of contended acquisitions recorded at this site */
+	guint64 contended;
+	/*! \brief Total time spent waiting at this site, in microseconds */
+	gint64 wait_total;
+	/*! \brief Longest single wait recorded at this site, in microseconds */
+	gint64 wait_max;
+} janus_lock_profiler_site;
+static void janus_lock_profiler_free_site(janus_lock_profiler_site *site) {
+	if(site == NULL)
+		return;
+	g_free(site->site);
+	g_free(site);
+}
+
+/* Map of lock sites we've seen so far: notice that, to avoid recursing
+ * into the profiler itself, we guard it with a raw GMutex rather than a
+ * janus_mutex; since we only ever get here after a trylock already
+ * failed (i.e., on the slow path), the extra serialization doesn't
+ * affect the uncontended case at all */
+static GHashTable *sites = NULL;
+static GMutex profiler_mutex;
+
+void janus_lock_profiler_record(const char *site, gint64 wait) {
+	if(site == NULL)
+		return;
+	g_mutex_lock(&profiler_mutex);
+	if(sites == NULL) {
+		sites = g_hash_table_new_full(g_str_hash, g_str_equal,
+			NULL, (GDestroyNotify)janus_lock_profiler_free_site);
+	}
+	janus_lock_profiler_site *s = g_hash_table_lookup(sites, site);
+	if(s == NULL) {
+		s = g_malloc0(sizeof(janus_lock_profiler_site));
+		s->site = g_strdup(site);
+		g_hash_table_insert(sites, s->site, s);
+	}
+	s->contended++;
+	s->wait_total += wait;
+	if(wait > s->wait_max)
+		s->wait_max = wait;
+	g_mutex_unlock(&profiler_mutex);
+}
+
+json_t *janus_lock_profiler_summary(void) {
+	json_t *list = json_array();
+	g_mutex_lock(&profiler_mutex);
+	if(sites != NULL) {
+		GHashTableIter iter;
+		gpointer value;
+		g_hash_table_iter_init(&iter, sites);
+		while(g_hash_table_iter_next(&iter, NULL, &value)) {
+			janus_lock_profiler_site *s = value;
+			json_t *l = json_object();
+			json_object_set_new(l, "site", json_string(s->site));
+			json_object_set_new(l, "contended", json_integer(s->contended));
+			json_object_set_new(l, "wait-total-us", json_integer(s->wait_total));
+			json_object_set_new(l, "wait-max-us", json_integer(s->wait_max));
+			json_array_append_new(list, l);
+		}
+	}
+	g_mutex_unlock(&profiler_mutex);
+	return list;
+}
+
+void janus_lock_profiler_reset(void) {
+	g_mutex_lock(&profiler_mutex);
+	if(sites != NULL)
+		g_hash_table_remove_all(sites);
+	g_mutex_unlock(&profiler_mutex);
+}
+
+#endif
@@ -0,0 +1,43 @@
+/*! \file    lockprofiler.h
+ * \author   Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief    Lock contention profiler (headers)
+ * \details  Optional profiler for the mutexes wrapped by \c janus_mutex:
+ * when the server is built with \c --enable-lock-profiler, every
+ * \c janus_mutex_lock that can't acquire its mutex right away records
+ * how long it had to wait, aggregated per lock site (the file and line
+ * the lock was taken from). The aggregate counters can be queried (and
+ * reset) at runtime via the \c lock_profile Admin API request, which is
+ * a much more direct way of finding the contended locks than eyeballing
+ * the \c locking_debug console spam. Uncontended acquisitions are never
+ * recorded, so the steady-state overhead is a single trylock per lock.
+ * \note This implementation is optional, as the extra trylock on every
+ * acquisition is not entirely free either: don't enable it in builds
+ * meant for production use.
+ *
+ * \ingroup core
+ * \ref core
+ */
+
+#ifndef JANUS_LOCKPROFILER_H
+#define JANUS_LOCKPROFILER_H
+
+#include <glib.h>
+#include <jansson.h>
+
+/*! \brief Record a contended lock acquisition
+ * \note This is only meant to be invoked by the \c janus_mutex_lock
+ * macro in mutex.h, which only gets here when a trylock failed
+ * @param[in] site Lock site the acquisition came from (a \c file:line
+ * string literal, as composed by the macro itself)
+ * @param[in] wait How long the lock kept us waiting, in microseconds */
+void janus_lock_profiler_record(const char *site, gint64 wait);
+/*! \brief Summarize the contention recorded so far, per lock site
+ * @returns A json_t array of objects, each containing the lock site,
+ * the number of contended acquisitions, and the total and maximum wait
+ * times in microseconds */
+json_t *janus_lock_profiler_summary(void);
+/*! \brief Reset the profiler, dropping all the recorded lock sites */
+void janus_lock_profiler_reset(void);
+
+#endif
@@ -4,7 +4,9 @@
  * \brief     Buffered logging
  * \details   Implementation of a simple buffered logger designed to remove
  * I/O wait from threads that may be sensitive to such delays. Buffers are
- * saved and reused to reduce allocation calls. The logger output can then
+ * saved and reused to reduce allocation calls, and all the queueing is
+ * done via lock-free stacks and thread-local caches, so that threads
+ * issuing logs never contend on a mutex. The logger output can then
  * be printed to stdout and/or a log file. If external loggers are added
  * to the core, the logger output is passed to those as well.
  *
@@ -48,9 +50,25 @@ static size_t maxbuffersz = 8000;
 static GMutex lock;
 static GCond cond;
 static GThread *printthread = NULL;
-static janus_log_buffer *printhead = NULL;
-static janus_log_buffer *printtail = NULL;
-static janus_log_buffer *bufferpool = NULL;
+/* Pending messages are pushed to a lock-free LIFO stack, that the writer
+ * thread grabs (and reverses) in bulk: threads issuing logs never take a
+ * mutex, so they can't contend with each other on the way in */
+static janus_log_buffer *pending = NULL;
+/* Buffers the writer thread is done with are recycled through another
+ * lock-free stack, that threads needing a buffer steal in bulk and then
+ * consume from a thread-local cache, again without any locking */
+static janus_log_buffer *recycled = NULL;
+
+static void janus_log_freecache(gpointer data) {
+	janus_log_buffer *list = data;
+	janus_log_buffer *b = NULL;
+	while(list) {
+		b = list;
+		list = b->next;
+		g_free(b);
+	}
+}
+static GPrivate buffercache = G_PRIVATE_INIT(janus_log_freecache);
 
 
 gboolean janus_log_is_stdout_enabled(void) {
@@ -78,36 +96,50 @@ static void janus_log_freebuffers(janus_log_buffer **list) {
 }
 
 static janus_log_buffer *janus_log_getbuf(void) {
-	janus_log_buffer *b;
-
-	g_mutex_lock(&lock);
-	b = bufferpool;
-	if (b) {
-		bufferpool = b->next;
-		b->next = NULL;
-	} else {
-		poolsz++;
+	/* Check the thread-local cache of buffers first */
+	janus_log_buffer *b = g_private_get(&buffercache);
+	if (b == NULL) {
+		/* Nothing cached: steal everything the writer thread recycled.
+		 * The pool size counter is only approximate, as other threads
+		 * may be stealing too, but it's just a soft cap anyway */
+		b = g_atomic_pointer_exchange(&recycled, NULL);
+		if (b != NULL)
+			g_atomic_int_set(&poolsz, 0);
 	}
-	g_mutex_unlock(&lock);
 	if (b == NULL) {
 		b = g_malloc(INITIAL_BUFSZ + sizeof(*b));
 		b->allocated = INITIAL_BUFSZ;
 		b->next = NULL;
+		return b;
 	}
+	g_private_set(&buffercache, b->next);
+	b->next = NULL;
 	return b;
 }
 
+/* Helper to reverse the pending stack, as messages are pushed there in
+ * LIFO order and we want to print them in the order they were issued */
+static janus_log_buffer *janus_log_reverse(janus_log_buffer *head) {
+	janus_log_buffer *prev = NULL, *next = NULL;
+	while (head) {
+		next = head->next;
+		head->next = prev;
+		prev = head;
+		head = next;
+	}
+	return prev;
+}
+
 static void *janus_log_thread(void *ctx) {
-	janus_log_buffer *head, *b, *tofree = NULL;
+	janus_log_buffer *head, *b, *r, *tofree = NULL;
 
 	while (!g_atomic_int_get(&stopping)) {
 		g_mutex_lock(&lock);
-		if (!printhead) {
+		if (g_atomic_pointer_get(&pending) == NULL) {
 			g_cond_wait(&cond, &lock);
 		}
-		head = printhead;
-		printhead = printtail = NULL;
 		g_mutex_unlock(&lock);
+		head = janus_log_reverse(g_atomic_pointer_exchange(&pending, NULL));
 
 		if (head) {
 			for (b = head; b; b = b->next) {
@@ -127,20 +159,21 @@ static void *janus_log_thread(void *ctx) {
 					}
 				}
 			}
-			g_mutex_lock(&lock);
 			while (head) {
 				b = head;
 				head = b->next;
-				if (poolsz >= maxpoolsz || b->allocated > maxbuffersz) {
+				if (g_atomic_int_get(&poolsz) >= maxpoolsz || b->allocated > maxbuffersz) {
 					b->next = tofree;
 					tofree = b;
-					poolsz--;
 				} else {
-					b->next = bufferpool;
-					bufferpool = b;
+					/* Push the buffer back to the recycled stack */
+					do {
+						r = g_atomic_pointer_get(&recycled);
+						b->next = r;
+					} while (!g_atomic_pointer_compare_and_exchange(&recycled, r, b));
+					g_atomic_int_inc(&poolsz);
 				}
 			}
-			g_mutex_unlock(&lock);
 			if(janus_log_console)
 				fflush(stdout);
 			if(janus_log_file)
@@ -149,7 +182,8 @@ static void *janus_log_thread(void *ctx) {
 		}
 	}
 	/* print any remaining messages, stdout flushed on exit */
-	for (b = printhead; b; b = b->next) {
+	head = janus_log_reverse(g_atomic_pointer_exchange(&pending, NULL));
+	for (b = head; b; b = b->next) {
 		if(janus_log_console)
 			fputs(b->str, stdout);
 		if(janus_log_file)
@@ -171,8 +205,9 @@ static void *janus_log_thread(void *ctx) {
 		fflush(stdout);
 	if(janus_log_file)
 		fflush(janus_log_file);
-	janus_log_freebuffers(&printhead);
-	janus_log_freebuffers(&bufferpool);
+	janus_log_freebuffers(&head);
+	r = g_atomic_pointer_exchange(&recycled, NULL);
+	janus_log_freebuffers(&r);
 	g_mutex_clear(&lock);
 	g_cond_clear(&cond);
 
@@ -204,15 +239,18 @@ void janus_vprintf(const char *format, ...) {
 	}
 	va_end(ap2);
 
-	g_mutex_lock(&lock);
-	if (!printhead) {
-		printhead = printtail = b;
-	} else {
-		printtail->next = b;
-		printtail = b;
+	/* Queue the message for the writer thread (lock-free push) */
+	janus_log_buffer *head = NULL;
+	do {
+		head = g_atomic_pointer_get(&pending);
+		b->next = head;
+	} while (!g_atomic_pointer_compare_and_exchange(&pending, head, b));
+	if (head == NULL) {
+		/* The queue was empty, so the writer thread may be asleep */
+		g_mutex_lock(&lock);
+		g_cond_signal(&cond);
+		g_mutex_unlock(&lock);
 	}
-	g_cond_signal(&cond);
-	g_mutex_unlock(&lock);
 }
 
 int janus_log_init(gboolean daemon, gboolean console, const char *logfile) {
@@ -0,0 +1,104 @@
+/*! \file    metrics.c
+ * \author   Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief    Aggregate metrics for monitoring
+ * \details  Global, pre-aggregated counters for the media path (RTP
+ * packets and bytes relayed, NACKs, ring drops), maintained with atomic
+ * operations so that the hot path never takes a lock to account them,
+ * and rendered in the Prometheus text exposition format.
+ *
+ * \ingroup core
+ * \ref core
+ */
+
+#include "metrics.h"
+
+/* GLib only has atomics for int- and pointer-sized values, so we use the
+ * pointer-sized family for the counters: they're 64 bits wide on 64-bit
+ * platforms, and simply wrap around earlier on 32-bit ones (which
+ * Prometheus rate() handles gracefully anyway) */
+typedef volatile gsize janus_metrics_counter;
+#define janus_metrics_counter_add(c, v) g_atomic_pointer_add(&(c), (gssize)(v))
+#define janus_metrics_counter_get(c) ((gsize)g_atomic_pointer_get(&(c)))
+
+/* RTP traffic counters, indexed by direction and media type */
+static janus_metrics_counter rtp_packets[2][2];
+static janus_metrics_counter rtp_bytes[2][2];
+/* NACK counters, indexed by direction */
+static janus_metrics_counter rtp_nacks[2];
+/* Packets dropped because an outgoing RTP ring was full */
+static janus_metrics_counter ring_drops;
+/* TURN REST API requests, indexed by where they were served from
+ * (backend or cache), plus the cumulative backend latency */
+static janus_metrics_counter turnrest_requests[2];
+static janus_metrics_counter turnrest_latency_us;
+
+void janus_metrics_account_rtp(gboolean outgoing, gboolean video, gsize bytes) {
+	janus_metrics_counter_add(rtp_packets[outgoing ? 1 : 0][video ? 1 : 0], 1);
+	janus_metrics_counter_add(rtp_bytes[outgoing ? 1 : 0][video ? 1 : 0], bytes);
+}
+
+void janus_metrics_account_nacks(gboolean outgoing, gsize nacks) {
+	janus_metrics_counter_add(rtp_nacks[outgoing ? 1 : 0], nacks);
+}
+
+void janus_metrics_account_ring_drop(void) {
+	janus_metrics_counter_add(ring_drops, 1);
+}
+
+void janus_metrics_account_turnrest(gboolean cached, gsize latency_us) {
+	janus_metrics_counter_add(turnrest_requests[cached ? 1 : 0], 1);
+	if(!cached)
+		janus_metrics_counter_add(turnrest_latency_us, latency_us);
+}
+
+char *janus_metrics_render(guint sessions, guint handles) {
+	GString *text = g_string_sized_new(2048);
+	g_string_append(text, "# HELP janus_sessions Number of active sessions\n");
+	g_string_append(text, "# TYPE janus_sessions gauge\n");
+	g_string_append_printf(text, "janus_sessions %u\n", sessions);
+	g_string_append(text, "# HELP janus_handles Number of active plugin handles\n");
+	g_string_append(text, "# TYPE janus_handles gauge\n");
+	g_string_append_printf(text, "janus_handles %u\n", handles);
+	g_string_append(text, "# HELP janus_rtp_packets_total RTP packets relayed\n");
+	g_string_append(text, "# TYPE janus_rtp_packets_total counter\n");
+	int direction = 0, video = 0;
+	for(direction = 0; direction < 2; direction++) {
+		for(video = 0; video < 2; video++) {
+			g_string_append_printf(text, "janus_rtp_packets_total{direction=\"%s\",media=\"%s\"} %"G_GSIZE_FORMAT"\n",
+				direction ? "out" : "in", video ? "video" : "audio",
+				janus_metrics_counter_get(rtp_packets[direction][video]));
+		}
+	}
+	g_string_append(text, "# HELP janus_rtp_bytes_total RTP bytes relayed\n");
+	g_string_append(text, "# TYPE janus_rtp_bytes_total counter\n");
+	for(direction = 0; direction < 2; direction++) {
+		for(video = 0; video < 2; video++) {
+			g_string_append_printf(text, "janus_rtp_bytes_total{direction=\"%s\",media=\"%s\"} %"G_GSIZE_FORMAT"\n",
+				direction ? "out" : "in", video ? "video" : "audio",
+				janus_metrics_counter_get(rtp_bytes[direction][video]));
+		}
+	}
+	g_string_append(text, "# HELP janus_nacks_total NACKs sent and received\n");
+	g_string_append(text, "# TYPE janus_nacks_total counter\n");
+	for(direction = 0; direction < 2; direction++) {
+		g_string_append_printf(text, "janus_nacks_total{direction=\"%s\"} %"G_GSIZE_FORMAT"\n",
+			direction ? "out" : "in", janus_metrics_counter_get(rtp_nacks[direction]));
+	}
+	g_string_append(text, "# HELP janus_ring_drops_total Packets dropped because an outgoing RTP ring was full\n");
+	g_string_append(text, "# TYPE janus_ring_drops_total counter\n");
+	g_string_append_printf(text, "janus_ring_drops_total %"G_GSIZE_FORMAT"\n",
+		janus_metrics_counter_get(ring_drops));
+	g_string_append(text, "# HELP janus_turnrest_requests_total TURN REST API credentials requests\n");
+	g_string_append(text, "# TYPE janus_turnrest_requests_total counter\n");
+	int cached = 0;
+	for(cached = 0; cached < 2; cached++) {
+		g_string_append_printf(text, "janus_turnrest_requests_total{source=\"%s\"} %"G_GSIZE_FORMAT"\n",
+			cached ? "cache" : "backend", janus_metrics_counter_get(turnrest_requests[cached]));
+	}
+	g_string_append(text, "# HELP janus_turnrest_latency_us_total Cumulative latency of TURN REST API backend requests, in microseconds\n");
+	g_string_append(text, "# TYPE janus_turnrest_latency_us_total counter\n");
+	g_string_append_printf(text, "janus_turnrest_latency_us_total %"G_GSIZE_FORMAT"\n",
+		janus_metrics_counter_get(turnrest_latency_us));
+	return g_string_free(text, FALSE);
+}
@@ -0,0 +1,43 @@
+/*! \file    metrics.h
+ * \author   Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief    Aggregate metrics for monitoring (headers)
+ * \details  Global, pre-aggregated counters for the media path (RTP
+ * packets and bytes relayed, NACKs, ring drops), maintained with atomic
+ * operations so that the hot path never takes a lock to account them,
+ * and rendered in the Prometheus text exposition format. Transports can
+ * serve the rendered text directly (e.g., the HTTP transport on its
+ * \c metrics_path endpoint), which is much cheaper for both sides than
+ * scraping the Admin API per session/handle and parsing the JSON.
+ *
+ * \ingroup core
+ * \ref core
+ */
+
+#ifndef JANUS_METRICS_H
+#define JANUS_METRICS_H
+
+#include <glib.h>
+
+/*! \brief Account a relayed RTP packet
+ * @param[in] outgoing Whether the packet was sent or received
+ * @param[in] video Whether this is a video or audio packet
+ * @param[in] bytes The size of the packet */
+void janus_metrics_account_rtp(gboolean outgoing, gboolean video, gsize bytes);
+/*! \brief Account one or more NACKs
+ * @param[in] outgoing Whether we sent the NACKs or received them
+ * @param[in] nacks How many NACKs to account */
+void janus_metrics_account_nacks(gboolean outgoing, gsize nacks);
+/*! \brief Account a packet dropped because an outgoing RTP ring was full */
+void janus_metrics_account_ring_drop(void);
+/*! \brief Account a TURN REST API credentials request
+ * @param[in] cached Whether the request was served from the credentials cache
+ * @param[in] latency_us How long the backend request took, in microseconds (0 if cached) */
+void janus_metrics_account_turnrest(gboolean cached, gsize latency_us);
+/*! \brief Render all the metrics in the Prometheus text exposition format
+ * @param[in] sessions The current number of sessions (tracked by the core)
+ * @param[in] handles The current number of handles (tracked by the core)
+ * @returns A heap-allocated string to free with g_free() when done */
+char *janus_metrics_render(guint sessions, guint handles);
+
+#endif
@@ -17,6 +17,11 @@
 
 extern int lock_debug;
 
+#ifdef JANUS_LOCK_PROFILER
+/*! \brief Record a contended lock acquisition (see lockprofiler.h) */
+void janus_lock_profiler_record(const char *site, gint64 wait);
+#endif
+
 #ifdef USE_PTHREAD_MUTEX
 
 /*! \brief Janus mutex implementation */
@@ -31,8 +36,21 @@ typedef pthread_mutex_t janus_mutex;
 #define janus_mutex_lock_nodebug(a) pthread_mutex_lock(a)
 /*! \brief Janus mutex lock with debug (prints the line that locked a mutex) */
 #define janus_mutex_lock_debug(a) { JANUS_PRINT("[%s:%s:%d:lock] %p\n", __FILE__, __FUNCTION__, __LINE__, a); pthread_mutex_lock(a); }
+#ifdef JANUS_LOCK_PROFILER
+/*! \brief Janus mutex lock with contention profiling (records how long the lock kept us waiting, per lock site) */
+#define janus_mutex_lock_profiled(a) { \
+	if(pthread_mutex_trylock(a) != 0) { \
+		gint64 jlp_before = g_get_monotonic_time(); \
+		pthread_mutex_lock(a); \
+		janus_lock_profiler_record(__FILE__ ":" G_STRINGIFY(__LINE__), g_get_monotonic_time() - jlp_before); \
+	} \
+}
+/*! \brief Janus mutex lock wrapper (selective locking debug) */
+#define janus_mutex_lock(a) { if(!lock_debug) { janus_mutex_lock_profiled(a); } else { janus_mutex_lock_debug(a); } }
+#else
 /*! \brief Janus mutex lock wrapper (selective locking debug) */
 #define janus_mutex_lock(a) { if(!lock_debug) { janus_mutex_lock_nodebug(a); } else { janus_mutex_lock_debug(a); } }
+#endif
 /*! \brief Janus mutex try lock without debug */
 #define janus_mutex_trylock_nodebug(a) { ret = !pthread_mutex_trylock(a); }
 /*! \brief Janus mutex try lock with debug (prints the line that tried to lock a mutex) */
@@ -46,6 +64,37 @@ typedef pthread_mutex_t janus_mutex;
 /*! \brief Janus mutex unlock wrapper (selective locking debug) */
 #define janus_mutex_unlock(a) { if(!lock_debug) { janus_mutex_unlock_nodebug(a); } else { janus_mutex_unlock_debug(a); } }
 
+/*! \brief Janus read/write lock implementation */
+typedef pthread_rwlock_t janus_rwlock;
+/*! \brief Janus read/write lock initialization */
+#define janus_rwlock_init(a) pthread_rwlock_init(a,NULL)
+/*! \brief Janus read/write lock destruction */
+#define janus_rwlock_destroy(a) pthread_rwlock_destroy(a)
+/*! \brief Janus read/write lock reader lock without debug */
+#define janus_rwlock_rdlock_nodebug(a) pthread_rwlock_rdlock(a)
+/*! \brief Janus read/write lock reader lock with debug (prints the line that locked it) */
+#define janus_rwlock_rdlock_debug(a) { JANUS_PRINT("[%s:%s:%d:rdlock] %p\n", __FILE__, __FUNCTION__, __LINE__, a); pthread_rwlock_rdlock(a); }
+/*! \brief Janus read/write lock reader lock wrapper (selective locking debug) */
+#define janus_rwlock_rdlock(a) { if(!lock_debug) { janus_rwlock_rdlock_nodebug(a); } else { janus_rwlock_rdlock_debug(a); } }
+/*! \brief Janus read/write lock writer lock without debug */
+#define janus_rwlock_wrlock_nodebug(a) pthread_rwlock_wrlock(a)
+/*! \brief Janus read/write lock writer lock with debug (prints the line that locked it) */
+#define janus_rwlock_wrlock_debug(a) { JANUS_PRINT("[%s:%s:%d:wrlock] %p\n", __FILE__, __FUNCTION__, __LINE__, a); pthread_rwlock_wrlock(a); }
+/*! \brief Janus read/write lock writer lock wrapper (selective locking debug) */
+#define janus_rwlock_wrlock(a) { if(!lock_debug) { janus_rwlock_wrlock_nodebug(a); } else { janus_rwlock_wrlock_debug(a); } }
+/*! \brief Janus read/write lock reader unlock without debug */
+#define janus_rwlock_rdunlock_nodebug(a) pthread_rwlock_unlock(a)
+/*! \brief Janus read/write lock reader unlock with debug (prints the line that unlocked it) */
+#define janus_rwlock_rdunlock_debug(a) { JANUS_PRINT("[%s:%s:%d:rdunlock] %p\n", __FILE__, __FUNCTION__, __LINE__, a); pthread_rwlock_unlock(a); }
+/*! \brief Janus read/write lock reader unlock wrapper (selective locking debug) */
+#define janus_rwlock_rdunlock(a) { if(!lock_debug) { janus_rwlock_rdunlock_nodebug(a); } else { janus_rwlock_rdunlock_debug(a); } }
+/*! \brief Janus read/write lock writer unlock without debug */
+#define janus_rwlock_wrunlock_nodebug(a) pthread_rwlock_unlock(a)
+/*! \brief Janus read/write lock writer unlock with debug (prints the line that unlocked it) */
+#define janus_rwlock_wrunlock_debug(a) { JANUS_PRINT("[%s:%s:%d:wrunlock] %p\n", __FILE__, __FUNCTION__, __LINE__, a); pthread_rwlock_unlock(a); }
+/*! \brief Janus read/write lock writer unlock wrapper (selective locking debug) */
+#define janus_rwlock_wrunlock(a) { if(!lock_debug) { janus_rwlock_wrunlock_nodebug(a); } else { janus_rwlock_wrunlock_debug(a); } }
+
 /*! \brief Janus condition implementation */
 typedef pthread_cond_t janus_condition;
 /*! \brief Janus condition initialization */
@@ -81,8 +130,21 @@ typedef GMutex janus_mutex;
 #define janus_mutex_lock_nodebug(a) g_mutex_lock(a)
 /*! \brief Janus mutex lock with debug (prints the line that locked a mutex) */
 #define janus_mutex_lock_debug(a) { JANUS_PRINT("[%s:%s:%d:lock] %p\n", __FILE__, __FUNCTION__, __LINE__, a); g_mutex_lock(a); }
+#ifdef JANUS_LOCK_PROFILER
+/*! \brief Janus mutex lock with contention profiling (records how long the lock kept us waiting, per lock site) */
+#define janus_mutex_lock_profiled(a) { \
+	if(!g_mutex_trylock(a)) { \
+		gint64 jlp_before = g_get_monotonic_time(); \
+		g_mutex_lock(a); \
+		janus_lock_profiler_record(__FILE__ ":" G_STRINGIFY(__LINE__), g_get_monotonic_time() - jlp_before); \
+	} \
+}
+/*! \brief Janus mutex lock wrapper (selective locking debug) */
+#define janus_mutex_lock(a) { if(!lock_debug) { janus_mutex_lock_profiled(a); } else { janus_mutex_lock_debug(a); } }
+#else
 /*! \brief Janus mutex lock wrapper (selective locking debug) */
 #define janus_mutex_lock(a) { if(!lock_debug) { janus_mutex_lock_nodebug(a); } else { janus_mutex_lock_debug(a); } }
+#endif
 /*! \brief Janus mutex try lock without debug */
 #define janus_mutex_trylock_nodebug(a) { ret = g_mutex_trylock(a); }
 /*! \brief Janus mutex try lock with debug (prints the line that tried to lock a mutex) */
@@ -96,6 +158,37 @@ typedef GMutex janus_mutex;
 /*! \brief Janus mutex unlock wrapper (selective locking debug) */
 #define janus_mutex_unlock(a) { if(!lock_debug) { janus_mutex_unlock_nodebug(a); } else { janus_mutex_unlock_debug(a); } }
 
+/*! \brief Janus read/write lock implementation */
+typedef GRWLock janus_rwlock;
+/*! \brief Janus read/write lock initialization */
+#define janus_rwlock_init(a) g_rw_lock_init(a)
+/*! \brief Janus read/write lock destruction */
+#define janus_rwlock_destroy(a) g_rw_lock_clear(a)
+/*! \brief Janus read/write lock reader lock without debug */
+#define janus_rwlock_rdlock_nodebug(a) g_rw_lock_reader_lock(a)
+/*! \brief Janus read/write lock reader lock with debug (prints the line that locked it) */
+#define janus_rwlock_rdlock_debug(a) { JANUS_PRINT("[%s:%s:%d:rdlock] %p\n", __FILE__, __FUNCTION__, __LINE__, a); g_rw_lock_reader_lock(a); }
+/*! \brief Janus read/write lock reader lock wrapper (selective locking debug) */
+#define janus_rwlock_rdlock(a) { if(!lock_debug) { janus_rwlock_rdlock_nodebug(a); } else { janus_rwlock_rdlock_debug(a); } }
+/*! \brief Janus read/write lock writer lock without debug */
+#define janus_rwlock_wrlock_nodebug(a) g_rw_lock_writer_lock(a)
+/*! \brief Janus read/write lock writer lock with debug (prints the line that locked it) */
+#define janus_rwlock_wrlock_debug(a) { JANUS_PRINT("[%s:%s:%d:wrlock] %p\n", __FILE__, __FUNCTION__, __LINE__, a); g_rw_lock_writer_lock(a); }
+/*! \brief Janus read/write lock writer lock wrapper (selective locking debug) */
+#define janus_rwlock_wrlock(a) { if(!lock_debug) { janus_rwlock_wrlock_nodebug(a); } else { janus_rwlock_wrlock_debug(a); } }
+/*! \brief Janus read/write lock reader unlock without debug */
+#define janus_rwlock_rdunlock_nodebug(a) g_rw_lock_reader_unlock(a)
+/*! \brief Janus read/write lock reader unlock with debug (prints the line that unlocked it) */
+#define janus_rwlock_rdunlock_debug(a) { JANUS_PRINT("[%s:%s:%d:rdunlock] %p\n", __FILE__, __FUNCTION__, __LINE__, a); g_rw_lock_reader_unlock(a); }
+/*! \brief Janus read/write lock reader unlock wrapper (selective locking debug) */
+#define janus_rwlock_rdunlock(a) { if(!lock_debug) { janus_rwlock_rdunlock_nodebug(a); } else { janus_rwlock_rdunlock_debug(a); } }
+/*! \brief Janus read/write lock writer unlock without debug */
+#define janus_rwlock_wrunlock_nodebug(a) g_rw_lock_writer_unlock(a)
+/*! \brief Janus read/write lock writer unlock with debug (prints the line that unlocked it) */
+#define janus_rwlock_wrunlock_debug(a) { JANUS_PRINT("[%s:%s:%d:wrunlock] %p\n", __FILE__, __FUNCTION__, __LINE__, a); g_rw_lock_writer_unlock(a); }
+/*! \brief Janus read/write lock writer unlock wrapper (selective locking debug) */
+#define janus_rwlock_wrunlock(a) { if(!lock_debug) { janus_rwlock_wrunlock_nodebug(a); } else { janus_rwlock_wrunlock_debug(a); } }
+
 /*! \brief Janus condition implementation */
 typedef GCond janus_condition;
 /*! \brief Janus condition initialization */
@@ -113,4 +206,45 @@ typedef GCond janus_condition;
 
 #endif
 
+/*! \brief Hint to the CPU that we're in a spin-wait loop */
+#if defined(__x86_64__) || defined(__i386__)
+#define janus_cpu_relax() __asm__ __volatile__("pause")
+#elif defined(__aarch64__) || defined(__arm__)
+#define janus_cpu_relax() __asm__ __volatile__("yield")
+#else
+#define janus_cpu_relax() do { } while(0)
+#endif
+
+/*! \brief How many rounds an adaptive lock spins before parking on the mutex */
+#define JANUS_MUTEX_ADAPTIVE_SPINS	64
+
+/*! \brief Janus adaptive mutex lock: spin briefly before blocking
+ * \details Some hot locks (e.g., the ones serializing the relay paths) only
+ * protect critical sections that are held for a handful of nanoseconds, but
+ * under contention a plain lock still pays a full futex round trip (syscall,
+ * context switch) to acquire them. This variant first spins on a trylock with
+ * exponential backoff, and only falls back to the regular (parking) lock if
+ * the owner doesn't release the mutex quickly: uncontended acquisitions cost
+ * the same single trylock, short contentions never leave user space. Use it
+ * on lock sites that profiling shows are contended but briefly held; lock
+ * debugging and profiling behave as with janus_mutex_lock */
+#define janus_mutex_lock_adaptive(a) { \
+	if(!janus_mutex_trylock(a)) { \
+		int jma_spins = 0, jma_backoff = 1, jma_i = 0; \
+		while(jma_spins < JANUS_MUTEX_ADAPTIVE_SPINS) { \
+			for(jma_i = 0; jma_i < jma_backoff; jma_i++) \
+				janus_cpu_relax(); \
+			if(jma_backoff < 1024) \
+				jma_backoff = jma_backoff << 1; \
+			if(janus_mutex_trylock(a)) \
+				break; \
+			jma_spins++; \
+		} \
+		if(jma_spins == JANUS_MUTEX_ADAPTIVE_SPINS) { \
+			/* Still locked after spinning, park on the mutex */ \
+			janus_mutex_lock(a); \
+		} \
+	} \
+}
+
 #endif
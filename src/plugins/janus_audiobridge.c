@@ -33,12 +33,16 @@ room-<unique room ID>: {
 	pin = <optional password needed for joining the room>
 	sampling_rate = <sampling rate> (e.g., 16000 for wideband mixing)
 	spatial_audio = true|false (if true, the mix will be stereo to spatially place users, default=false)
+	shared_encoding = true|false (if true, muted Opus participants will share a single
+		encode of the full mix instead of one encode each, default=false)
 	audiolevel_ext = true|false (whether the ssrc-audio-level RTP extension must be
 		negotiated/used or not for new joins, default=true)
 	audiolevel_event = true|false (whether to emit event to other users or not, default=false)
 	audio_active_packets = 100 (number of packets with audio level, default=100, 2 seconds)
 	audio_level_average = 25 (average value of audio level, 127=muted, 0='too loud', default=25)
 	default_expectedloss = percent of packets we expect participants may miss, to help with outgoing FEC (default=0, max=20; automatically used for forwarders too)
+	adaptive_fec = true|false (whether the outgoing FEC overhead should adapt to the loss each participant reports via RTCP, so that
+				redundancy is only paid for on lossy downlinks; overrides the expected_loss participants may have configured, default=false)
 	default_bitrate = default bitrate in bps to use for the all participants (default=0, which means libopus decides; automatically used for forwarders too)
 	denoise = true|false (whether denoising via RNNoise should be performed for each participant by default)
 	record = true|false (whether this room should be recorded, default=false)
@@ -137,11 +141,13 @@ room-<unique room ID>: {
 	"allowed" : [ array of string tokens users can use to join this room, optional],
 	"sampling_rate" : <sampling rate of the room, optional, 16000 by default>,
 	"spatial_audio" : <true|false, whether the mix should spatially place users, default=false>,
+	"shared_encoding" : <true|false, whether muted Opus participants should share a single encode of the full mix, default=false>,
 	"audiolevel_ext" : <true|false, whether the ssrc-audio-level RTP extension must be negotiated for new joins, default=true>,
 	"audiolevel_event" : <true|false (whether to emit event to other users or not)>,
 	"audio_active_packets" : <number of packets with audio level (default=100, 2 seconds)>,
 	"audio_level_average" : <average value of audio level (127=muted, 0='too loud', default=25)>,
 	"default_expectedloss" : <percent of packets we expect participants may miss, to help with outgoing FEC (default=0, max=20; automatically used for forwarders too)>,
+	"adaptive_fec" : <true|false, whether the outgoing FEC overhead should adapt to the loss each participant reports via RTCP (default=false)>,
 	"default_bitrate" : <bitrate in bps to use for the all participants (default=0, which means libopus decides; automatically used for forwarders too)>,
 	"denoise" : <true|false, whether denoising via RNNoise should be performed for each participant by default, default=false>,
 	"record" : <true|false, whether to record the room or not, default=false>,
@@ -1151,6 +1157,13 @@ room-<unique room ID>: {
 #include <netdb.h>
 #include <sys/time.h>
 #include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "../debug.h"
 #include "../apierror.h"
@@ -1274,6 +1287,7 @@ static struct janus_json_parameter create_parameters[] = {
 	{"sampling_rate", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"sampling", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},	/* We keep this to be backwards compatible */
 	{"spatial_audio", JANUS_JSON_BOOL, 0},
+	{"shared_encoding", JANUS_JSON_BOOL, 0},
 	{"record", JANUS_JSON_BOOL, 0},
 	{"record_file", JSON_STRING, 0},
 	{"record_dir", JSON_STRING, 0},
@@ -1286,6 +1300,7 @@ static struct janus_json_parameter create_parameters[] = {
 	{"audio_active_packets", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"audio_level_average", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"default_expectedloss", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	{"adaptive_fec", JANUS_JSON_BOOL, 0},
 	{"default_bitrate", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"denoise", JANUS_JSON_BOOL, 0},
 	{"groups", JSON_ARRAY, 0}
@@ -1415,6 +1430,18 @@ static void *janus_audiobridge_mixer_thread(void *data);
 static void *janus_audiobridge_participant_thread(void *data);
 static void janus_audiobridge_hangup_media_internal(janus_plugin_session *handle);
 
+#ifdef HAVE_RNNOISE
+/* When denoising is enabled, we delegate the actual RNNoise processing to a
+ * bounded thread pool, rather than doing it inline in the decode loop of each
+ * participant thread: frames are handed over on a per-participant queue, and
+ * queued for the mixer as soon as they've been processed */
+static GThreadPool *denoise_pool = NULL;
+static void janus_audiobridge_denoise_task(gpointer data, gpointer user_data);
+/* How long a decoded frame can sit in the pool before we give up on
+ * denoising it and just pass it through as it is (in milliseconds) */
+#define DENOISER_LATENCY_BUDGET	20
+#endif
+
 /* Extension to add while recording (e.g., "tmp" --> ".wav.tmp") */
 static char *rec_tempext = NULL;
 
@@ -1451,7 +1478,9 @@ typedef struct janus_audiobridge_room {
 	gboolean audiolevel_ext;	/* Whether the ssrc-audio-level extension must be negotiated or not for new joins */
 	gboolean audiolevel_event;	/* Whether to emit event to other users about audiolevel */
 	uint default_expectedloss;	/* Percent of packets we expect participants may miss, to help with outgoing FEC: can be overridden per-participant */
+	gboolean adaptive_fec;		/* Whether the outgoing FEC overhead should adapt to the loss each participant reports via RTCP */
 	int32_t default_bitrate;	/* Default bitrate to use for all Opus streams when encoding */
+	gboolean shared_encoding;	/* Whether muted Opus participants should share a single encode of the full mix, rather than one each */
 	int audio_active_packets;	/* Amount of packets with audio level for checkup */
 	int audio_level_average;	/* Average audio level */
 #ifdef HAVE_RNNOISE
@@ -1474,6 +1503,10 @@ typedef struct janus_audiobridge_room {
 	gboolean muted;				/* Whether the room is globally muted (except for admins and played files) */
 	GHashTable *allowed;		/* Map of participants (as tokens) allowed to join */
 	GThread *thread;			/* Mixer thread for this room */
+	guint64 mixer_ticks;		/* Number of mixer iterations performed so far (only updated by the mixer thread) */
+	guint64 mixer_overruns;		/* Number of times the mixer missed its 20ms deadline entirely */
+	guint64 mixer_jitter[5];	/* Histogram of how late mixer ticks fired (<1ms, <2ms, <5ms, <10ms, more) */
+	gint64 mixer_late_max;		/* Worst tick lateness observed so far, in microseconds */
 	volatile gint destroyed;	/* Whether this room has been destroyed */
 	janus_mutex mutex;			/* Mutex to lock this room instance */
 	/* RTP forwarders for this room's mix */
@@ -1490,6 +1523,7 @@ static janus_mutex rooms_mutex = JANUS_MUTEX_INITIALIZER;
 static char *admin_key = NULL;
 static gboolean lock_rtpfwd = FALSE;
 static gboolean lock_playfile = FALSE;
+static int mixer_priority = 0;
 
 typedef struct janus_audiobridge_session {
 	janus_plugin_session *handle;
@@ -1668,11 +1702,24 @@ typedef struct janus_audiobridge_plainrtp_media {
 	gboolean audio_send;
 	janus_rtp_switching_context context;
 	int pipefd[2];
-	GThread *thread;
+	volatile gint polling;
+	gboolean started;
+	int pollerrs;
 } janus_audiobridge_plainrtp_media;
 static void janus_audiobridge_plainrtp_media_cleanup(janus_audiobridge_plainrtp_media *media);
 static int janus_audiobridge_plainrtp_allocate_port(janus_audiobridge_plainrtp_media *media);
-static void *janus_audiobridge_plainrtp_relay_thread(void *data);
+/* Rather than a dedicated relay thread per plain RTP participant, a single
+ * shared poller thread services all plain RTP sockets in the plugin: with
+ * SIP-trunk-heavy deployments there may be hundreds of such participants,
+ * and spawning a thread each just to read packets doesn't scale */
+static GThread *plainrtp_poller = NULL;
+static GSList *plainrtp_poller_participants = NULL;
+static volatile gint plainrtp_poller_update = 0;
+static int plainrtp_poller_pipe[2] = { -1, -1 };
+static janus_mutex plainrtp_poller_mutex = JANUS_MUTEX_INITIALIZER;
+static void *janus_audiobridge_plainrtp_poller_thread(void *data);
+static int janus_audiobridge_plainrtp_poller_add(struct janus_audiobridge_participant *participant);
+static void janus_audiobridge_plainrtp_poller_wakeup(void);
 
 /* AudioBridge participant */
 typedef struct janus_audiobridge_participant {
@@ -1702,10 +1749,20 @@ typedef struct janus_audiobridge_participant {
 	opus_int16 *upsample_buffer;		/* Buffer for upsampling */
 	opus_int16 *downsample_buffer;		/* Buffer for downsampling */
 	float *denoiser_buffer[2];			/* Buffer for denoising */
+	GAsyncQueue *denoise_jobs;			/* Decoded frames waiting to be denoised by the thread pool */
+	volatile gint denoising;			/* Whether a denoising task for this participant is scheduled in the pool */
 #endif
 	/* RTP stuff */
 	JitterBuffer *jitter;	/* Jitter buffer of incoming audio packets */
 	gint64 jitter_next_check;	/* Timestamp to perform next jitter buffer size check */
+	/* Incoming packets are staged in a small wait-free ring by the RTP receive
+	 * path, and moved to the jitter buffer by the participant thread at each
+	 * tick, so that packet insertion never contends on the queue mutex */
+#define JANUS_AUDIOBRIDGE_JITTER_RING	32	/* Must be a power of two */
+	struct janus_audiobridge_buffer_packet *jitter_ring[JANUS_AUDIOBRIDGE_JITTER_RING];
+	volatile gint jitter_head;	/* Next slot to write (only the RTP receive path updates this) */
+	volatile gint jitter_tail;	/* Next slot to read (only the participant thread updates this) */
+	guint32 jitter_overflows;	/* Number of packets dropped because the ring was full */
 	GList *inbuf;			/* Decoded audio from this participant, to feed to the mixer */
 	GAsyncQueue *outbuf;	/* Mixed audio to send to this participant */
 	janus_mutex qmutex;		/* Incoming queue mutex */
@@ -1756,8 +1813,19 @@ typedef struct janus_audiobridge_rtp_relay_packet {
 	uint32_t timestamp;
 	uint16_t seq_number;
 	gboolean silence;
+	gboolean encoded;	/* Whether this already contains an encoded Opus frame (shared mix), rather than raw samples */
 } janus_audiobridge_rtp_relay_packet;
 
+#ifdef HAVE_RNNOISE
+/* Decoded frame handed over to the denoising thread pool */
+typedef struct janus_audiobridge_denoise_job {
+	/* Decoded packet to denoise and then queue for the mixer */
+	janus_audiobridge_rtp_relay_packet *pkt;
+	/* Monotonic insert time, to enforce the latency budget */
+	int64_t inserted;
+} janus_audiobridge_denoise_job;
+#endif
+
 /* Buffered audio/video packet */
 typedef struct janus_audiobridge_buffer_packet {
 	/* Pointer to the packet data, if RTP */
@@ -1783,7 +1851,22 @@ static void janus_audiobridge_buffer_packet_destroy(janus_audiobridge_buffer_pac
 static void janus_audiobridge_participant_istalking(janus_audiobridge_session *session,
 	janus_audiobridge_participant *participant, janus_plugin_rtp *packet, gboolean *silence);
 
+static void janus_audiobridge_participant_clear_jitter_ring(janus_audiobridge_participant *participant) {
+	/* Note: this is only safe to call when the RTP receive path can't be
+	 * enqueueing anymore (participant inactive or being destroyed) */
+	gint head = g_atomic_int_get(&participant->jitter_head);
+	gint tail = g_atomic_int_get(&participant->jitter_tail);
+	while(tail != head) {
+		janus_audiobridge_buffer_packet *pkt = participant->jitter_ring[tail & (JANUS_AUDIOBRIDGE_JITTER_RING-1)];
+		participant->jitter_ring[tail & (JANUS_AUDIOBRIDGE_JITTER_RING-1)] = NULL;
+		janus_audiobridge_buffer_packet_destroy(pkt);
+		tail++;
+	}
+	g_atomic_int_set(&participant->jitter_tail, tail);
+}
+
 static void janus_audiobridge_participant_clear_jitter_buffer(janus_audiobridge_participant *participant) {
+	janus_audiobridge_participant_clear_jitter_ring(participant);
 	if(participant->jitter) {
 		jitter_buffer_reset(participant->jitter);
 	}
@@ -1804,6 +1887,18 @@ static void janus_audiobridge_participant_clear_inbuf(janus_audiobridge_particip
 	}
 }
 
+static void janus_audiobridge_participant_queue_in(janus_audiobridge_participant *participant, janus_audiobridge_rtp_relay_packet *pkt) {
+	janus_mutex_lock(&participant->qmutex);
+	/* Do not let queue-in grow too much */
+	guint count = g_list_length(participant->inbuf);
+	if(count > QUEUE_IN_MAX_PACKETS) {
+		JANUS_LOG(LOG_WARN, "Participant queue-in contains too many packets, clearing now (count=%u)\n", count);
+		janus_audiobridge_participant_clear_inbuf(participant);
+	}
+	participant->inbuf = g_list_append(participant->inbuf, pkt);
+	janus_mutex_unlock(&participant->qmutex);
+}
+
 static void janus_audiobridge_participant_clear_outbuf(janus_audiobridge_participant *participant) {
 	while(participant->outbuf && g_async_queue_length(participant->outbuf) > 0) {
 		janus_audiobridge_rtp_relay_packet *pkt = g_async_queue_pop(participant->outbuf);
@@ -1837,6 +1932,7 @@ static void janus_audiobridge_participant_free(const janus_refcount *participant
 		opus_encoder_destroy(participant->encoder);
 	if(participant->decoder)
 		opus_decoder_destroy(participant->decoder);
+	janus_audiobridge_participant_clear_jitter_ring(participant);
 	if(participant->jitter)
 		jitter_buffer_destroy(participant->jitter);
 	janus_audiobridge_participant_clear_inbuf(participant);
@@ -1861,6 +1957,15 @@ static void janus_audiobridge_participant_free(const janus_refcount *participant
 		g_free(participant->upsample_buffer);
 	if(participant->downsample_buffer)
 		g_free(participant->downsample_buffer);
+	if(participant->denoise_jobs != NULL) {
+		janus_audiobridge_denoise_job *job = NULL;
+		while((job = g_async_queue_try_pop(participant->denoise_jobs)) != NULL) {
+			g_free(job->pkt->data);
+			g_free(job->pkt);
+			g_free(job);
+		}
+		g_async_queue_unref(participant->denoise_jobs);
+	}
 #endif
 	g_free(participant->mjr_base);
 #ifdef HAVE_LIBOGG
@@ -1874,6 +1979,7 @@ static void janus_audiobridge_participant_free(const janus_refcount *participant
 
 #ifdef HAVE_RNNOISE
 static void janus_audiobridge_participant_denoise(janus_audiobridge_participant *participant, char *data, int len);
+static void janus_audiobridge_participant_denoise_queue(janus_audiobridge_participant *participant, janus_audiobridge_rtp_relay_packet *pkt);
 static void janus_audiobridge_participant_upsample(janus_audiobridge_participant *participant, opus_int16 *input, int *in_len, opus_int16 *output, int *out_len);
 static void janus_audiobridge_participant_downsample(janus_audiobridge_participant *participant, opus_int16 *input, int *in_len, opus_int16 *output, int *out_len);
 #endif
@@ -2483,6 +2589,14 @@ int janus_audiobridge_init(janus_callbacks *callback, const char *config_path) {
 		janus_config_item *ext = janus_config_get(config, config_general, janus_config_type_item, "record_tmp_ext");
 		if(ext != NULL && ext->value != NULL)
 			rec_tempext = g_strdup(ext->value);
+		janus_config_item *mp = janus_config_get(config, config_general, janus_config_type_item, "mixer_priority");
+		if(mp != NULL && mp->value != NULL) {
+			mixer_priority = atoi(mp->value);
+			if(mixer_priority < 0 || mixer_priority > 99) {
+				JANUS_LOG(LOG_WARN, "Invalid mixer priority %s, mixer threads will stay best-effort\n", mp->value);
+				mixer_priority = 0;
+			}
+		}
 		janus_config_item *events = janus_config_get(config, config_general, janus_config_type_item, "events");
 		if(events != NULL && events->value != NULL)
 			notify_events = janus_is_true(events->value);
@@ -2575,11 +2689,13 @@ int janus_audiobridge_init(janus_callbacks *callback, const char *config_path) {
 			janus_config_item *priv = janus_config_get(config, cat, janus_config_type_item, "is_private");
 			janus_config_item *sampling = janus_config_get(config, cat, janus_config_type_item, "sampling_rate");
 			janus_config_item *spatial = janus_config_get(config, cat, janus_config_type_item, "spatial_audio");
+			janus_config_item *sharedenc = janus_config_get(config, cat, janus_config_type_item, "shared_encoding");
 			janus_config_item *audiolevel_ext = janus_config_get(config, cat, janus_config_type_item, "audiolevel_ext");
 			janus_config_item *audiolevel_event = janus_config_get(config, cat, janus_config_type_item, "audiolevel_event");
 			janus_config_item *audio_active_packets = janus_config_get(config, cat, janus_config_type_item, "audio_active_packets");
 			janus_config_item *audio_level_average = janus_config_get(config, cat, janus_config_type_item, "audio_level_average");
 			janus_config_item *default_expectedloss = janus_config_get(config, cat, janus_config_type_item, "default_expectedloss");
+			janus_config_item *adaptive_fec = janus_config_get(config, cat, janus_config_type_item, "adaptive_fec");
 			janus_config_item *default_bitrate = janus_config_get(config, cat, janus_config_type_item, "default_bitrate");
 			janus_config_item *denoise = janus_config_get(config, cat, janus_config_type_item, "denoise");
 			janus_config_item *secret = janus_config_get(config, cat, janus_config_type_item, "secret");
@@ -2655,6 +2771,7 @@ int janus_audiobridge_init(janus_callbacks *callback, const char *config_path) {
 					continue;
 			}
 			audiobridge->spatial_audio = spatial && spatial->value && janus_is_true(spatial->value);
+			audiobridge->shared_encoding = sharedenc && sharedenc->value && janus_is_true(sharedenc->value);
 			audiobridge->audiolevel_ext = TRUE;
 			if(audiolevel_ext != NULL && audiolevel_ext->value != NULL)
 				audiobridge->audiolevel_ext = janus_is_true(audiolevel_ext->value);
@@ -2688,6 +2805,9 @@ int janus_audiobridge_init(janus_callbacks *callback, const char *config_path) {
 					audiobridge->default_expectedloss = expectedloss;
 				}
 			}
+			audiobridge->adaptive_fec = FALSE;
+			if(adaptive_fec != NULL && adaptive_fec->value != NULL)
+				audiobridge->adaptive_fec = janus_is_true(adaptive_fec->value);
 			audiobridge->default_bitrate = 0;
 			if(default_bitrate != NULL && default_bitrate->value != NULL) {
 				audiobridge->default_bitrate = atoi(default_bitrate->value);
@@ -2844,8 +2964,23 @@ int janus_audiobridge_init(janus_callbacks *callback, const char *config_path) {
 
 	g_atomic_int_set(&initialized, 1);
 
-	/* Launch the thread that will handle incoming messages */
 	GError *error = NULL;
+#ifdef HAVE_RNNOISE
+	/* Create the bounded thread pool we'll use for denoising */
+	denoise_pool = g_thread_pool_new(janus_audiobridge_denoise_task, NULL,
+		MAX(1, (gint)g_get_num_processors()/2), FALSE, &error);
+	if(error != NULL) {
+		g_atomic_int_set(&initialized, 0);
+		JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to create the denoising thread pool...\n",
+			error->code, error->message ? error->message : "??");
+		g_error_free(error);
+		janus_config_destroy(config);
+		return -1;
+	}
+#endif
+
+	/* Launch the thread that will handle incoming messages */
+	error = NULL;
 	handler_thread = g_thread_try_new("audiobridge handler", janus_audiobridge_handler, NULL, &error);
 	if(error != NULL) {
 		g_atomic_int_set(&initialized, 0);
@@ -2869,6 +3004,25 @@ void janus_audiobridge_destroy(void) {
 		g_thread_join(handler_thread);
 		handler_thread = NULL;
 	}
+	if(plainrtp_poller != NULL) {
+		/* Wake the shared plain RTP poller up, and wait for it to release its participants */
+		janus_audiobridge_plainrtp_poller_wakeup();
+		g_thread_join(plainrtp_poller);
+		plainrtp_poller = NULL;
+		if(plainrtp_poller_pipe[0] > 0)
+			close(plainrtp_poller_pipe[0]);
+		plainrtp_poller_pipe[0] = -1;
+		if(plainrtp_poller_pipe[1] > 0)
+			close(plainrtp_poller_pipe[1]);
+		plainrtp_poller_pipe[1] = -1;
+	}
+#ifdef HAVE_RNNOISE
+	if(denoise_pool != NULL) {
+		/* Wait for pending denoising tasks, they hold participant references */
+		g_thread_pool_free(denoise_pool, FALSE, TRUE);
+		denoise_pool = NULL;
+	}
+#endif
 	/* FIXME We should destroy the sessions cleanly */
 	janus_mutex_lock(&sessions_mutex);
 	g_hash_table_destroy(sessions);
@@ -3025,6 +3179,8 @@ json_t *janus_audiobridge_query_session(janus_plugin_session *handle) {
 		json_object_set_new(info, "buffer-in", json_integer(count));
 		json_object_set_new(info, "queue-in", json_integer(g_list_length(participant->inbuf)));
 		janus_mutex_unlock(&participant->qmutex);
+		if(participant->jitter_overflows > 0)
+			json_object_set_new(info, "buffer-in-overflows", json_integer(participant->jitter_overflows));
 		if(participant->outbuf)
 			json_object_set_new(info, "queue-out", json_integer(g_async_queue_length(participant->outbuf)));
 		if(participant->stereo)
@@ -3163,11 +3319,13 @@ static json_t *janus_audiobridge_process_synchronous_request(janus_audiobridge_s
 		if(sampling == NULL)
 			sampling = json_object_get(root, "sampling");
 		json_t *spatial = json_object_get(root, "spatial_audio");
+		json_t *sharedenc = json_object_get(root, "shared_encoding");
 		json_t *audiolevel_ext = json_object_get(root, "audiolevel_ext");
 		json_t *audiolevel_event = json_object_get(root, "audiolevel_event");
 		json_t *audio_active_packets = json_object_get(root, "audio_active_packets");
 		json_t *audio_level_average = json_object_get(root, "audio_level_average");
 		json_t *default_expectedloss = json_object_get(root, "default_expectedloss");
+		json_t *adaptive_fec = json_object_get(root, "adaptive_fec");
 		json_t *default_bitrate = json_object_get(root, "default_bitrate");
 		json_t *denoise = json_object_get(root, "denoise");
 		json_t *groups = json_object_get(root, "groups");
@@ -3302,6 +3460,7 @@ static json_t *janus_audiobridge_process_synchronous_request(janus_audiobridge_s
 		else
 			audiobridge->sampling_rate = 16000;
 		audiobridge->spatial_audio = spatial ? json_is_true(spatial) : FALSE;
+		audiobridge->shared_encoding = sharedenc ? json_is_true(sharedenc) : FALSE;
 		audiobridge->audiolevel_ext = audiolevel_ext ? json_is_true(audiolevel_ext) : TRUE;
 		audiobridge->audiolevel_event = audiolevel_event ? json_is_true(audiolevel_event) : FALSE;
 		if(audiobridge->audiolevel_event) {
@@ -3329,6 +3488,7 @@ static json_t *janus_audiobridge_process_synchronous_request(janus_audiobridge_s
 				audiobridge->default_expectedloss = expectedloss;
 			}
 		}
+		audiobridge->adaptive_fec = adaptive_fec ? json_is_true(adaptive_fec) : FALSE;
 		audiobridge->default_bitrate = 0;
 		if(default_bitrate != NULL) {
 			audiobridge->default_bitrate = json_integer_value(default_bitrate);
@@ -3518,6 +3678,10 @@ static json_t *janus_audiobridge_process_synchronous_request(janus_audiobridge_s
 				janus_config_add(config, c, janus_config_item_create("mjrs_dir", audiobridge->mjrs_dir));
 			if(audiobridge->spatial_audio)
 				janus_config_add(config, c, janus_config_item_create("spatial_audio", "yes"));
+			if(audiobridge->shared_encoding)
+				janus_config_add(config, c, janus_config_item_create("shared_encoding", "yes"));
+			if(audiobridge->adaptive_fec)
+				janus_config_add(config, c, janus_config_item_create("adaptive_fec", "yes"));
 			/* Save modified configuration */
 			if(janus_config_save(config, config_folder, JANUS_AUDIOBRIDGE_PACKAGE) < 0)
 				save = FALSE;	/* This will notify the user the room is not permanent */
@@ -3699,6 +3863,10 @@ static json_t *janus_audiobridge_process_synchronous_request(janus_audiobridge_s
 				janus_config_add(config, c, janus_config_item_create("mjrs_dir", audiobridge->mjrs_dir));
 			if(audiobridge->spatial_audio)
 				janus_config_add(config, c, janus_config_item_create("spatial_audio", "yes"));
+			if(audiobridge->shared_encoding)
+				janus_config_add(config, c, janus_config_item_create("shared_encoding", "yes"));
+			if(audiobridge->adaptive_fec)
+				janus_config_add(config, c, janus_config_item_create("adaptive_fec", "yes"));
 			/* Save modified configuration */
 			if(janus_config_save(config, config_folder, JANUS_AUDIOBRIDGE_PACKAGE) < 0)
 				save = FALSE;	/* This will notify the user the room changes are not permanent */
@@ -4001,6 +4169,21 @@ static json_t *janus_audiobridge_process_synchronous_request(janus_audiobridge_s
 			json_object_set_new(rl, "record", g_atomic_int_get(&room->record) ? json_true() : json_false());
 			json_object_set_new(rl, "muted", room->muted ? json_true() : json_false());
 			json_object_set_new(rl, "num_participants", json_integer(g_hash_table_size(room->participants)));
+			if(session == NULL) {
+				/* When invoked via Admin API, add the mixer timing stats as well */
+				json_t *mixer = json_object();
+				json_object_set_new(mixer, "ticks", json_integer(room->mixer_ticks));
+				json_object_set_new(mixer, "overruns", json_integer(room->mixer_overruns));
+				json_object_set_new(mixer, "max_lateness_us", json_integer(room->mixer_late_max));
+				json_t *jitter = json_object();
+				json_object_set_new(jitter, "lt1ms", json_integer(room->mixer_jitter[0]));
+				json_object_set_new(jitter, "lt2ms", json_integer(room->mixer_jitter[1]));
+				json_object_set_new(jitter, "lt5ms", json_integer(room->mixer_jitter[2]));
+				json_object_set_new(jitter, "lt10ms", json_integer(room->mixer_jitter[3]));
+				json_object_set_new(jitter, "gt10ms", json_integer(room->mixer_jitter[4]));
+				json_object_set_new(mixer, "tick_jitter", jitter);
+				json_object_set_new(rl, "mixer", mixer);
+			}
 			json_array_append_new(list, rl);
 			janus_refcount_decrease(&room->ref);
 		}
@@ -6069,17 +6252,22 @@ void janus_audiobridge_incoming_rtp(janus_plugin_session *handle, janus_plugin_r
 				rtp->type, participant->codec == JANUS_AUDIOCODEC_PCMA ? 8 : 0);
 			return;
 		}
-		/* Queue the audio packet in the jitter buffer (we won't decode now, there might be buffering involved) */
+		/* Stage the audio packet in the inbound ring (we won't decode or touch the
+		 * jitter buffer here, the participant thread will at its next tick): this
+		 * way receiving media never contends on the queue mutex */
 		if(participant->jitter) {
-			janus_audiobridge_buffer_packet *pkt = janus_audiobridge_buffer_packet_create(packet);
-			janus_mutex_lock(&participant->qmutex);
-			JitterBufferPacket jbp = {0};
-			jbp.data = (char *)pkt;
-			jbp.len = 0;
-			jbp.timestamp = ntohl(rtp->timestamp);
-			jbp.span = (participant->codec == JANUS_AUDIOCODEC_OPUS ? 960 : 160);
-			jitter_buffer_put(participant->jitter, &jbp);
-			janus_mutex_unlock(&participant->qmutex);
+			gint head = g_atomic_int_get(&participant->jitter_head);
+			gint tail = g_atomic_int_get(&participant->jitter_tail);
+			if(head - tail >= JANUS_AUDIOBRIDGE_JITTER_RING) {
+				/* The ring is full, which means the participant thread isn't draining it */
+				participant->jitter_overflows++;
+				JANUS_LOG(LOG_HUGE, "Inbound ring full for participant %s, dropping packet (%"SCNu32" drops)\n",
+					participant->user_id_str, participant->jitter_overflows);
+				return;
+			}
+			participant->jitter_ring[head & (JANUS_AUDIOBRIDGE_JITTER_RING-1)] =
+				janus_audiobridge_buffer_packet_create(packet);
+			g_atomic_int_set(&participant->jitter_head, head+1);
 		}
 	}
 }
@@ -6087,7 +6275,30 @@ void janus_audiobridge_incoming_rtp(janus_plugin_session *handle, janus_plugin_r
 void janus_audiobridge_incoming_rtcp(janus_plugin_session *handle, janus_plugin_rtcp *packet) {
 	if(handle == NULL || g_atomic_int_get(&handle->stopped) || g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized))
 		return;
-	/* FIXME Should we care? */
+	janus_audiobridge_session *session = (janus_audiobridge_session *)handle->plugin_handle;
+	if(session == NULL || g_atomic_int_get(&session->destroyed))
+		return;
+	janus_audiobridge_participant *participant = (janus_audiobridge_participant *)session->participant;
+	if(participant == NULL || participant->room == NULL || !participant->room->adaptive_fec ||
+			participant->codec != JANUS_AUDIOCODEC_OPUS || !participant->fec || participant->encoder == NULL)
+		return;
+	/* The room uses adaptive FEC: check if this packet carries a receiver
+	 * report, and if so use the fraction of packets this participant says
+	 * they lost to tune how much redundancy we pay for on their encoder:
+	 * participants on clean paths get no FEC overhead at all, lossy ones
+	 * get redundancy proportional to what they're actually missing */
+	int fraction = janus_rtcp_get_fraction_lost(packet->buffer, packet->length);
+	if(fraction < 0)
+		return;
+	int loss = (fraction*100)/256;
+	if(loss > 20)
+		loss = 20;
+	if(loss != participant->expected_loss) {
+		JANUS_LOG(LOG_VERB, "Adapting outgoing FEC for participant (%s), expected loss %d%% --> %d%%\n",
+			participant->display ? participant->display : "??", participant->expected_loss, loss);
+		participant->expected_loss = loss;
+		opus_encoder_ctl(participant->encoder, OPUS_SET_PACKET_LOSS_PERC(loss));
+	}
 }
 
 static void janus_audiobridge_recorder_create(janus_audiobridge_participant *participant) {
@@ -6156,14 +6367,9 @@ static void janus_audiobridge_hangup_media_internal(janus_plugin_session *handle
 		return;
 	/* Get rid of participant */
 	janus_audiobridge_participant *participant = (janus_audiobridge_participant *)session->participant;
-	/* If this was a plain RTP participant, notify the thread that it's time to go */
-	if(participant->plainrtp_media.pipefd[1] > 0) {
-		int code = 1;
-		ssize_t res = 0;
-		do {
-			res = write(participant->plainrtp_media.pipefd[1], &code, sizeof(int));
-		} while(res == -1 && errno == EINTR);
-	}
+	/* If this was a plain RTP participant, notify the poller that it's time to let it go */
+	if(g_atomic_int_get(&participant->plainrtp_media.polling))
+		janus_audiobridge_plainrtp_poller_wakeup();
 	janus_mutex_lock(&rooms_mutex);
 	janus_audiobridge_room *audiobridge = participant->room;
 	gboolean removed = FALSE;
@@ -6834,24 +7040,16 @@ static void *janus_audiobridge_handler(void *data) {
 					g_error_free(error);
 				}
 			}
-			if(participant->plainrtp_media.audio_rtp_fd != -1 && participant->plainrtp_media.thread == NULL) {
-				/* Spawn a thread for incoming plain RTP traffic too */
-				GError *error = NULL;
-				char roomtrunc[5], parttrunc[5];
-				g_snprintf(roomtrunc, sizeof(roomtrunc), "%s", audiobridge->room_id_str);
-				g_snprintf(parttrunc, sizeof(parttrunc), "%s", participant->user_id_str);
-				char tname[16];
-				g_snprintf(tname, sizeof(tname), "rtp %s %s", roomtrunc, parttrunc);
+			if(participant->plainrtp_media.audio_rtp_fd != -1 &&
+					!g_atomic_int_get(&participant->plainrtp_media.polling)) {
+				/* Have the shared poller service incoming plain RTP traffic too */
 				janus_refcount_increase(&session->ref);
 				janus_refcount_increase(&participant->ref);
-				participant->plainrtp_media.thread = g_thread_try_new(tname, &janus_audiobridge_plainrtp_relay_thread, participant, &error);
-				if(error != NULL) {
+				if(janus_audiobridge_plainrtp_poller_add(participant) < 0) {
 					janus_refcount_decrease(&participant->ref);
 					janus_refcount_decrease(&session->ref);
 					/* FIXME We should fail here... */
-					JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the plain RTP participant thread...\n",
-						error->code, error->message ? error->message : "??");
-					g_error_free(error);
+					JANUS_LOG(LOG_ERR, "Error registering the participant with the plain RTP poller...\n");
 				}
 			}
 			/* If a PeerConnection exists, make sure to update the RTP headers */
@@ -8082,6 +8280,131 @@ static void janus_audiobridge_update_wav_header(janus_audiobridge_room *audiobri
 }
 
 /* Thread to mix the contributions from all participants */
+/* Mixing kernels: the hot per-sample loops of the mixer thread go through
+ * these helpers, which process whole 10/20ms blocks with the gain checks
+ * hoisted out of the loops instead of evaluated on every sample; the common
+ * unity-gain case is vectorized explicitly (SSE2 and NEON are baseline on
+ * x86_64 and aarch64 respectively, so no special build flag is needed),
+ * while the gained variants are tight loops compilers can optimize on their
+ * own. Samples are always accumulated in the 32-bit mix buffers */
+static void janus_audiobridge_mixer_add(opus_int32 *mix, opus_int16 *pcm, int samples, int gain) {
+	int i = 0;
+	if(gain == 100) {
+#if defined(__SSE2__)
+		__m128i zero = _mm_setzero_si128();
+		for(; i+8 <= samples; i += 8) {
+			/* Widen 8 samples to 32-bit and accumulate */
+			__m128i s = _mm_loadu_si128((__m128i *)&pcm[i]);
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(zero, s), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(zero, s), 16);
+			_mm_storeu_si128((__m128i *)&mix[i],
+				_mm_add_epi32(_mm_loadu_si128((__m128i *)&mix[i]), lo));
+			_mm_storeu_si128((__m128i *)&mix[i+4],
+				_mm_add_epi32(_mm_loadu_si128((__m128i *)&mix[i+4]), hi));
+		}
+#elif defined(__ARM_NEON)
+		for(; i+8 <= samples; i += 8) {
+			int16x8_t s = vld1q_s16(&pcm[i]);
+			vst1q_s32(&mix[i], vaddq_s32(vld1q_s32(&mix[i]), vmovl_s16(vget_low_s16(s))));
+			vst1q_s32(&mix[i+4], vaddq_s32(vld1q_s32(&mix[i+4]), vmovl_s16(vget_high_s16(s))));
+		}
+#endif
+		for(; i<samples; i++)
+			mix[i] += pcm[i];
+	} else {
+		for(; i<samples; i++)
+			mix[i] += (pcm[i]*gain)/100;
+	}
+}
+
+static void janus_audiobridge_mixer_add_stereo(opus_int32 *mix, opus_int16 *pcm,
+		int samples, int gain, int lgain, int rgain) {
+	if(lgain == 100 && rgain == 100) {
+		/* Centered, same as a plain mix */
+		janus_audiobridge_mixer_add(mix, pcm, samples, gain);
+		return;
+	}
+	int i = 0;
+	opus_int32 l = 0, r = 0;
+	for(i=0; i<samples; i += 2) {
+		l = (lgain == 100) ? pcm[i] : (pcm[i]*lgain)/100;
+		r = (rgain == 100) ? pcm[i+1] : (pcm[i+1]*rgain)/100;
+		if(gain != 100) {
+			l = (l*gain)/100;
+			r = (r*gain)/100;
+		}
+		mix[i] += l;
+		mix[i+1] += r;
+	}
+}
+
+static void janus_audiobridge_mixer_merge(opus_int32 *mix, opus_int32 *submix, int samples) {
+	int i = 0;
+#if defined(__SSE2__)
+	for(; i+4 <= samples; i += 4) {
+		_mm_storeu_si128((__m128i *)&mix[i],
+			_mm_add_epi32(_mm_loadu_si128((__m128i *)&mix[i]), _mm_loadu_si128((__m128i *)&submix[i])));
+	}
+#elif defined(__ARM_NEON)
+	for(; i+4 <= samples; i += 4)
+		vst1q_s32(&mix[i], vaddq_s32(vld1q_s32(&mix[i]), vld1q_s32(&submix[i])));
+#endif
+	for(; i<samples; i++)
+		mix[i] += submix[i];
+}
+
+static void janus_audiobridge_mixer_sub(opus_int32 *sum, opus_int32 *mix, opus_int16 *pcm, int samples, int gain) {
+	if(pcm == NULL) {
+		/* Nothing to remove from the mix */
+		memcpy(sum, mix, samples*sizeof(opus_int32));
+		return;
+	}
+	int i = 0;
+	if(gain == 100) {
+#if defined(__SSE2__)
+		__m128i zero = _mm_setzero_si128();
+		for(; i+8 <= samples; i += 8) {
+			__m128i s = _mm_loadu_si128((__m128i *)&pcm[i]);
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(zero, s), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(zero, s), 16);
+			_mm_storeu_si128((__m128i *)&sum[i],
+				_mm_sub_epi32(_mm_loadu_si128((__m128i *)&mix[i]), lo));
+			_mm_storeu_si128((__m128i *)&sum[i+4],
+				_mm_sub_epi32(_mm_loadu_si128((__m128i *)&mix[i+4]), hi));
+		}
+#elif defined(__ARM_NEON)
+		for(; i+8 <= samples; i += 8) {
+			int16x8_t s = vld1q_s16(&pcm[i]);
+			vst1q_s32(&sum[i], vsubq_s32(vld1q_s32(&mix[i]), vmovl_s16(vget_low_s16(s))));
+			vst1q_s32(&sum[i+4], vsubq_s32(vld1q_s32(&mix[i+4]), vmovl_s16(vget_high_s16(s))));
+		}
+#endif
+		for(; i<samples; i++)
+			sum[i] = mix[i] - pcm[i];
+	} else {
+		for(; i<samples; i++)
+			sum[i] = mix[i] - (pcm[i]*gain)/100;
+	}
+}
+
+static void janus_audiobridge_mixer_sub_stereo(opus_int32 *sum, opus_int32 *mix, opus_int16 *pcm,
+		int samples, int lgain, int rgain) {
+	if(pcm == NULL) {
+		/* Nothing to remove from the mix */
+		memcpy(sum, mix, samples*sizeof(opus_int32));
+		return;
+	}
+	if(lgain == 100 && rgain == 100) {
+		janus_audiobridge_mixer_sub(sum, mix, pcm, samples, 100);
+		return;
+	}
+	int i = 0;
+	for(i=0; i<samples; i += 2) {
+		sum[i] = mix[i] - ((lgain == 100) ? pcm[i] : (pcm[i]*lgain)/100);
+		sum[i+1] = mix[i+1] - ((rgain == 100) ? pcm[i+1] : (pcm[i+1]*rgain)/100);
+	}
+}
+
 static void *janus_audiobridge_mixer_thread(void *data) {
 	JANUS_LOG(LOG_VERB, "Audio bridge thread starting...\n");
 	janus_audiobridge_room *audiobridge = (janus_audiobridge_room *)data;
@@ -8093,6 +8416,22 @@ static void *janus_audiobridge_mixer_thread(void *data) {
 	JANUS_LOG(LOG_VERB, "Thread is for mixing room %s (%s) at rate %"SCNu32"...\n",
 		audiobridge->room_id_str, audiobridge->room_name, audiobridge->sampling_rate);
 
+	if(mixer_priority > 0) {
+		/* We were asked to run mixer threads at real-time priority */
+#ifdef __linux__
+		struct sched_param params = { .sched_priority = mixer_priority };
+		if(pthread_setschedparam(pthread_self(), SCHED_FIFO, &params) != 0) {
+			JANUS_LOG(LOG_WARN, "Error elevating the mixer thread for room %s to SCHED_FIFO priority %d (%d), staying best-effort\n",
+				audiobridge->room_id_str, mixer_priority, errno);
+		} else {
+			JANUS_LOG(LOG_VERB, "Mixer thread for room %s running at SCHED_FIFO priority %d\n",
+				audiobridge->room_id_str, mixer_priority);
+		}
+#else
+		JANUS_LOG(LOG_WARN, "Real-time priority for mixer threads is only supported on Linux\n");
+#endif
+	}
+
 	/* Buffer (we allocate assuming 48kHz, although we'll likely use less than that) */
 	int samples = audiobridge->sampling_rate/50;
 	if(audiobridge->spatial_audio)
@@ -8145,10 +8484,47 @@ static void *janus_audiobridge_mixer_thread(void *data) {
 		}
 	}
 
+	/* If shared encoding is enabled, muted Opus participants all get the
+	 * same encode of the full mix, rather than one personalized encode
+	 * each: since they contribute nothing, their mixes are identical */
+	OpusEncoder *mixEncoder = NULL;
+	opus_int32 sharedLen = 0;
+	uint8_t sharedFrame[1500];
+	if(audiobridge->shared_encoding) {
+		int error = 0;
+		mixEncoder = opus_encoder_create(audiobridge->sampling_rate,
+			audiobridge->spatial_audio ? 2 : 1, OPUS_APPLICATION_VOIP, &error);
+		if(error != OPUS_OK) {
+			JANUS_LOG(LOG_WARN, "Error creating the shared Opus encoder, falling back to per-participant encodes (%d)\n", error);
+			mixEncoder = NULL;
+		} else {
+			if(audiobridge->sampling_rate == 8000) {
+				opus_encoder_ctl(mixEncoder, OPUS_SET_MAX_BANDWIDTH(OPUS_BANDWIDTH_NARROWBAND));
+			} else if(audiobridge->sampling_rate == 12000) {
+				opus_encoder_ctl(mixEncoder, OPUS_SET_MAX_BANDWIDTH(OPUS_BANDWIDTH_MEDIUMBAND));
+			} else if(audiobridge->sampling_rate == 16000) {
+				opus_encoder_ctl(mixEncoder, OPUS_SET_MAX_BANDWIDTH(OPUS_BANDWIDTH_WIDEBAND));
+			} else if(audiobridge->sampling_rate == 24000) {
+				opus_encoder_ctl(mixEncoder, OPUS_SET_MAX_BANDWIDTH(OPUS_BANDWIDTH_SUPERWIDEBAND));
+			} else if(audiobridge->sampling_rate == 48000) {
+				opus_encoder_ctl(mixEncoder, OPUS_SET_MAX_BANDWIDTH(OPUS_BANDWIDTH_FULLBAND));
+			} else {
+				opus_encoder_ctl(mixEncoder, OPUS_SET_MAX_BANDWIDTH(OPUS_BANDWIDTH_WIDEBAND));
+			}
+			if(audiobridge->default_expectedloss > 0) {
+				opus_encoder_ctl(mixEncoder, OPUS_SET_INBAND_FEC(TRUE));
+				opus_encoder_ctl(mixEncoder, OPUS_SET_PACKET_LOSS_PERC(audiobridge->default_expectedloss));
+			}
+			if(audiobridge->default_bitrate > 0)
+				opus_encoder_ctl(mixEncoder, OPUS_SET_BITRATE(audiobridge->default_bitrate));
+		}
+	}
+
 	/* Base RTP packets, in case there are forwarders involved */
 	gboolean have_opus[JANUS_AUDIOBRIDGE_MAX_GROUPS+1],
 		have_alaw[JANUS_AUDIOBRIDGE_MAX_GROUPS+1],
 		have_ulaw[JANUS_AUDIOBRIDGE_MAX_GROUPS+1];
+	opus_int32 opuslen[JANUS_AUDIOBRIDGE_MAX_GROUPS+1];
 	unsigned char *rtpbuffer = g_malloc0(1500 * (groups_num+1));
 	janus_rtp_header *rtph = NULL;
 	/* In case we need G.711 forwarders */
@@ -8181,10 +8557,36 @@ static void *janus_audiobridge_mixer_thread(void *data) {
 			--d_s;
 		}
 		passed = d_s*1000000 + d_us;
-		if(passed < 15000) {	/* Let's wait about 15ms at max */
-			g_usleep(5000);
+		if(passed < 20000) {
+			/* Sleep until the next deadline, rather than polling every 5ms:
+			 * this keeps the tick jitter down to the sleep accuracy itself */
+			g_usleep(20000 - passed);
 			continue;
 		}
+		/* Update the tick timing stats: how late past the deadline did we fire? */
+		gint64 late = passed - 20000;
+		audiobridge->mixer_ticks++;
+		if(late > audiobridge->mixer_late_max)
+			audiobridge->mixer_late_max = late;
+		if(late < 1000)
+			audiobridge->mixer_jitter[0]++;
+		else if(late < 2000)
+			audiobridge->mixer_jitter[1]++;
+		else if(late < 5000)
+			audiobridge->mixer_jitter[2]++;
+		else if(late < 10000)
+			audiobridge->mixer_jitter[3]++;
+		else
+			audiobridge->mixer_jitter[4]++;
+		if(late >= 20000) {
+			/* We missed (at least) a whole tick, all participants will perceive
+			 * this one: take note it happened, and warn every now and then */
+			audiobridge->mixer_overruns++;
+			if(audiobridge->mixer_overruns == 1 || audiobridge->mixer_overruns % 100 == 0) {
+				JANUS_LOG(LOG_WARN, "Mixer for room %s overran its deadline by %"SCNi64"ms (%"SCNu64" overruns so far)\n",
+					audiobridge->room_id_str, late/1000, audiobridge->mixer_overruns);
+			}
+		}
 		/* If we're recording to a wav file, update the info */
 		if(g_atomic_int_get(&audiobridge->record) && !g_atomic_int_get(&audiobridge->wav_header_added)) {
 			JANUS_LOG(LOG_VERB, "Adding WAV header for recording %s (%s)...\n", audiobridge->room_id_str, audiobridge->room_name);
@@ -8239,8 +8641,7 @@ static void *janus_audiobridge_mixer_thread(void *data) {
 			ps = ps->next;
 		}
 		janus_mutex_unlock_nodebug(&audiobridge->mutex);
-		for(i=0; i<samples; i++)
-			buffer[i] = 0;
+		memset(buffer, 0, samples*sizeof(opus_int32));
 		if(groups_num > 0)
 			memset(groupBuffers, 0, groupBuffersSize);
 		ps = participants_list;
@@ -8268,99 +8669,15 @@ static void *janus_audiobridge_mixer_thread(void *data) {
 					memcpy(pkt->data, resampled, pkt->length*2);
 				}
 				curBuffer = (opus_int16 *)pkt->data;
-				if(groups_num == 0) {
-					/* Add to the main mix */
-					if(!p->stereo) {
-						for(i=0; i<samples; i++) {
-							if(p->volume_gain == 100) {
-								buffer[i] += curBuffer[i];
-							} else {
-								buffer[i] += (curBuffer[i]*p->volume_gain)/100;
-							}
-						}
-					} else {
-						diff = 50 - p->spatial_position;
-						lgain = 50 + diff;
-						rgain = 50 - diff;
-						for(i=0; i<samples; i++) {
-							if(i%2 == 0) {
-								if(lgain == 100) {
-									if(p->volume_gain == 100) {
-										buffer[i] += curBuffer[i];
-									} else {
-										buffer[i] += (curBuffer[i]*p->volume_gain)/100;
-									}
-								} else {
-									if(p->volume_gain == 100) {
-										buffer[i] += (curBuffer[i]*lgain)/100;
-									} else {
-										buffer[i] += (((curBuffer[i]*lgain)/100)*p->volume_gain)/100;
-									}
-								}
-							} else {
-								if(rgain == 100) {
-									if(p->volume_gain == 100) {
-										buffer[i] += curBuffer[i];
-									} else {
-										buffer[i] += (curBuffer[i]*p->volume_gain)/100;
-									}
-								} else {
-									if(p->volume_gain == 100) {
-										buffer[i] += (curBuffer[i]*rgain)/100;
-									} else {
-										buffer[i] += (((curBuffer[i]*rgain)/100)*p->volume_gain)/100;
-									}
-								}
-							}
-						}
-					}
+				/* Add to the main mix, or to the group submix */
+				opus_int32 *mix = (groups_num == 0) ? buffer : (groupBuffers + (p->group-1)*samples);
+				if(!p->stereo) {
+					janus_audiobridge_mixer_add(mix, curBuffer, samples, p->volume_gain);
 				} else {
-					/* Add to the group submix */
-					int index = p->group-1;
-					if(!p->stereo) {
-						for(i=0; i<samples; i++) {
-							if(p->volume_gain == 100) {
-								*(groupBuffers + index*samples + i) += curBuffer[i];
-							} else {
-								*(groupBuffers + index*samples + i) += (curBuffer[i]*p->volume_gain)/100;
-							}
-						}
-					} else {
-						diff = 50 - p->spatial_position;
-						lgain = 50 + diff;
-						rgain = 50 - diff;
-						for(i=0; i<samples; i++) {
-							if(i%2 == 0) {
-								if(lgain == 100) {
-									if(p->volume_gain == 100) {
-										*(groupBuffers + index*samples + i) += curBuffer[i];
-									} else {
-										*(groupBuffers + index*samples + i) += (curBuffer[i]*p->volume_gain)/100;
-									}
-								} else {
-									if(p->volume_gain == 100) {
-										*(groupBuffers + index*samples + i) += (curBuffer[i]*lgain)/100;
-									} else {
-										*(groupBuffers + index*samples + i) += (((curBuffer[i]*lgain)/100)*p->volume_gain)/100;
-									}
-								}
-							} else {
-								if(rgain == 100) {
-									if(p->volume_gain == 100) {
-										*(groupBuffers + index*samples + i) += curBuffer[i];
-									} else {
-										*(groupBuffers + index*samples + i) += (curBuffer[i]*p->volume_gain)/100;
-									}
-								} else {
-									if(p->volume_gain == 100) {
-										*(groupBuffers + index*samples + i) += (curBuffer[i]*rgain)/100;
-									} else {
-										*(groupBuffers + index*samples + i) += (((curBuffer[i]*rgain)/100)*p->volume_gain)/100;
-									}
-								}
-							}
-						}
-					}
+					diff = 50 - p->spatial_position;
+					lgain = 50 + diff;
+					rgain = 50 - diff;
+					janus_audiobridge_mixer_add_stereo(mix, curBuffer, samples, p->volume_gain, lgain, rgain);
 				}
 			}
 			janus_mutex_unlock(&p->qmutex);
@@ -8429,26 +8746,9 @@ static void *janus_audiobridge_mixer_thread(void *data) {
 						gateway->notify_event(&janus_audiobridge_plugin, NULL, info);
 					}
 				}
-				if(groups_num == 0) {
-					/* Add to the main mix */
-					for(i=0; i<samples; i++) {
-						if(p->volume_gain == 100) {
-							buffer[i] += resampled[i];
-						} else {
-							buffer[i] += (resampled[i]*p->volume_gain)/100;
-						}
-					}
-				} else {
-					/* Add to the group submix */
-					index = p->group-1;
-					for(i=0; i<samples; i++) {
-						if(p->volume_gain == 100) {
-							*(groupBuffers + index*samples + i) += resampled[i];
-						} else {
-							*(groupBuffers + index*samples + i) += (resampled[i]*p->volume_gain)/100;
-						}
-					}
-				}
+				/* Add to the main mix, or to the group submix */
+				janus_audiobridge_mixer_add(groups_num == 0 ? buffer : (groupBuffers + (p->group-1)*samples),
+					resampled, samples, p->volume_gain);
 				ps = ps->next;
 			}
 			g_list_free_full(anncs_list, (GDestroyNotify)janus_audiobridge_participant_unref);
@@ -8457,10 +8757,8 @@ static void *janus_audiobridge_mixer_thread(void *data) {
 		/* If groups are in use, put them together in the main mix */
 		if(groups_num > 0) {
 			/* Mix all submixes */
-			for(index=0; index<groups_num; index++) {
-				for(i=0; i<samples; i++)
-					buffer[i] += *(groupBuffers + index*samples + i);
-			}
+			for(index=0; index<groups_num; index++)
+				janus_audiobridge_mixer_merge(buffer, groupBuffers + index*samples, samples);
 		}
 		/* Are we recording the mix? (only do it if there's someone in, though...) */
 		if(audiobridge->recording != NULL && g_list_length(participants_list) > 0) {
@@ -8489,6 +8787,7 @@ static void *janus_audiobridge_mixer_thread(void *data) {
 			}
 		}
 		/* Send proper packet to each participant (remove own contribution) */
+		sharedLen = 0;	/* We'll encode the shared frame lazily, if anyone needs it */
 		ps = participants_list;
 		while(ps) {
 			janus_audiobridge_participant *p = (janus_audiobridge_participant *)ps->data;
@@ -8506,34 +8805,43 @@ static void *janus_audiobridge_mixer_thread(void *data) {
 				p->inbuf = g_list_delete_link(p->inbuf, first);
 			}
 			janus_mutex_unlock(&p->qmutex);
+			if(mixEncoder != NULL && pkt == NULL && p->muted && p->codec == JANUS_AUDIOCODEC_OPUS &&
+					p->stereo == audiobridge->spatial_audio) {
+				/* This participant is muted, so their personalized mix is just
+				 * the full mix: encode it once and share the resulting frame */
+				if(sharedLen == 0) {
+					for(i=0; i<samples; i++)
+						outBuffer[i] = buffer[i];
+					sharedLen = opus_encode(mixEncoder, outBuffer,
+						audiobridge->spatial_audio ? samples/2 : samples, sharedFrame, sizeof(sharedFrame));
+					if(sharedLen < 0)
+						JANUS_LOG(LOG_ERR, "[Opus] Ops! got an error encoding the Opus frame: %d (%s)\n", sharedLen, opus_strerror(sharedLen));
+				}
+				if(sharedLen > 0) {
+					janus_audiobridge_rtp_relay_packet *mixedpkt = g_malloc(sizeof(janus_audiobridge_rtp_relay_packet));
+					mixedpkt->data = g_malloc(sharedLen);
+					memcpy(mixedpkt->data, sharedFrame, sharedLen);
+					mixedpkt->length = sharedLen;	/* For encoded frames this is the data length */
+					mixedpkt->timestamp = ts;
+					mixedpkt->seq_number = seq;
+					mixedpkt->ssrc = audiobridge->room_ssrc;
+					mixedpkt->silence = FALSE;
+					mixedpkt->encoded = TRUE;
+					g_async_queue_push(p->outbuf, mixedpkt);
+					janus_refcount_decrease(&p->ref);
+					ps = ps->next;
+					continue;
+				}
+			}
 			/* Remove the participant's own contribution */
 			curBuffer = (opus_int16 *)((pkt && pkt->length && !pkt->silence) ? pkt->data : NULL);
 			if(!p->stereo) {
-				for(i=0; i<samples; i++) {
-					if(p->volume_gain == 100)
-						sumBuffer[i] = buffer[i] - (curBuffer ? (curBuffer[i]) : 0);
-					else
-						sumBuffer[i] = buffer[i] - (curBuffer ? (curBuffer[i]*p->volume_gain)/100 : 0);
-				}
+				janus_audiobridge_mixer_sub(sumBuffer, buffer, curBuffer, samples, p->volume_gain);
 			} else {
 				diff = 50 - p->spatial_position;
 				lgain = 50 + diff;
 				rgain = 50 - diff;
-				for(i=0; i<samples; i++) {
-					if(i%2 == 0) {
-						if(lgain == 100) {
-							sumBuffer[i] = buffer[i] - (curBuffer ? (curBuffer[i]) : 0);
-						} else {
-							sumBuffer[i] = buffer[i] - (curBuffer ? (curBuffer[i]*lgain)/100 : 0);
-						}
-					} else {
-						if(rgain == 100) {
-							sumBuffer[i] = buffer[i] - (curBuffer ? (curBuffer[i]) : 0);
-						} else {
-							sumBuffer[i] = buffer[i] - (curBuffer ? (curBuffer[i]*rgain)/100 : 0);
-						}
-					}
-				}
+				janus_audiobridge_mixer_sub_stereo(sumBuffer, buffer, curBuffer, samples, lgain, rgain);
 			}
 			for(i=0; i<samples; i++)
 				/* FIXME Smoothen/Normalize instead of truncating? */
@@ -8561,6 +8869,7 @@ static void *janus_audiobridge_mixer_thread(void *data) {
 			mixedpkt->seq_number = seq;
 			mixedpkt->ssrc = audiobridge->room_ssrc;
 			mixedpkt->silence = FALSE;
+			mixedpkt->encoded = FALSE;
 			g_async_queue_push(p->outbuf, mixedpkt);
 			if(pkt) {
 				g_free(pkt->data);
@@ -8611,6 +8920,7 @@ static void *janus_audiobridge_mixer_thread(void *data) {
 				gpointer key, value;
 				g_hash_table_iter_init(&iter, audiobridge->rtp_forwarders);
 				opus_int32 length = 0;
+				janus_rtp_forwarder_batch_begin();
 				while(audiobridge->rtp_udp_sock > 0 && g_hash_table_iter_next(&iter, &key, &value)) {
 					janus_rtp_forwarder *rf = (janus_rtp_forwarder *)value;
 					janus_audiobridge_rtp_forwarder_metadata *rfm = (janus_audiobridge_rtp_forwarder_metadata *)rf->metadata;
@@ -8632,17 +8942,21 @@ static void *janus_audiobridge_mixer_thread(void *data) {
 					if(rfm->codec == JANUS_AUDIOCODEC_OPUS) {
 						/* This is an Opus forwarder, check if we have a version for that already */
 						if(!have_opus[rfm->group]) {
-							/* We don't, encode now */
+							/* We don't, encode now: the frame (and its length) is
+							 * cached, so that all the other Opus forwarders of this
+							 * group mix reuse it rather than encoding it again */
 							OpusEncoder *rtp_encoder = (rfm->group == 0 ? audiobridge->rtp_encoder : groupEncoders[rfm->group-1]);
-							length = opus_encode(rtp_encoder, outBuffer,
+							opuslen[rfm->group] = opus_encode(rtp_encoder, outBuffer,
 								audiobridge->spatial_audio ? samples/2 : samples,
 								rtpbuffer + rfm->group*1500 + 12, 1500-12);
-							if(length < 0) {
-								JANUS_LOG(LOG_ERR, "[Opus] Ops! got an error encoding the Opus frame: %d (%s)\n", length, opus_strerror(length));
+							if(opuslen[rfm->group] < 0) {
+								JANUS_LOG(LOG_ERR, "[Opus] Ops! got an error encoding the Opus frame: %d (%s)\n",
+									opuslen[rfm->group], opus_strerror(opuslen[rfm->group]));
 								continue;
 							}
 							have_opus[rfm->group] = TRUE;
 						}
+						length = opuslen[rfm->group];
 						rtph = (janus_rtp_header *)(rtpbuffer + rfm->group*1500);
 						rtph->version = 2;
 					} else if(rfm->codec == JANUS_AUDIOCODEC_PCMA || rfm->codec == JANUS_AUDIOCODEC_PCMU) {
@@ -8687,6 +9001,7 @@ static void *janus_audiobridge_mixer_thread(void *data) {
 					/* Forward the packet */
 					janus_rtp_forwarder_send_rtp(rf, (char *)rtph, length+12, -1);
 				}
+				janus_rtp_forwarder_batch_flush();
 			}
 		}
 		janus_mutex_unlock(&audiobridge->rtp_mutex);
@@ -8707,6 +9022,8 @@ static void *janus_audiobridge_mixer_thread(void *data) {
 		}
 		g_free(groupEncoders);
 	}
+	if(mixEncoder)
+		opus_encoder_destroy(mixEncoder);
 	JANUS_LOG(LOG_VERB, "Leaving mixer thread for room %s (%s)...\n", audiobridge->room_id_str, audiobridge->room_name);
 
 	janus_refcount_decrease(&audiobridge->ref);
@@ -8768,6 +9085,22 @@ static void *janus_audiobridge_participant_thread(void *data) {
 			before += 20000;
 			if(participant->jitter) {
 				janus_mutex_lock(&participant->qmutex);
+				/* First move what the RTP receive path staged in the ring to the jitter buffer */
+				gint head = g_atomic_int_get(&participant->jitter_head);
+				gint tail = g_atomic_int_get(&participant->jitter_tail);
+				while(tail != head) {
+					janus_audiobridge_buffer_packet *inpkt = participant->jitter_ring[tail & (JANUS_AUDIOBRIDGE_JITTER_RING-1)];
+					participant->jitter_ring[tail & (JANUS_AUDIOBRIDGE_JITTER_RING-1)] = NULL;
+					tail++;
+					janus_rtp_header *header = (janus_rtp_header *)inpkt->rtp->buffer;
+					JitterBufferPacket jbin = {0};
+					jbin.data = (char *)inpkt;
+					jbin.len = 0;
+					jbin.timestamp = ntohl(header->timestamp);
+					jbin.span = (participant->codec == JANUS_AUDIOCODEC_OPUS ? 960 : 160);
+					jitter_buffer_put(participant->jitter, &jbin);
+				}
+				g_atomic_int_set(&participant->jitter_tail, tail);
 				ret = jitter_buffer_get(participant->jitter, &jbp, participant->codec == JANUS_AUDIOCODEC_OPUS ? 960 : 160, NULL);
 				jitter_ticks++;
 				/* Adjust the buffer size every 50 ticks (~1 second) */
@@ -8798,11 +9131,6 @@ static void *janus_audiobridge_participant_thread(void *data) {
 						pkt->silence = FALSE;
 						janus_audiobridge_participant_istalking(session, participant, NULL, NULL);
 						pkt->length = opus_decode(participant->decoder, NULL, 0, (opus_int16 *)pkt->data, output_samples, 0);
-#ifdef HAVE_RNNOISE
-						/* Check if we need to denoise this packet */
-						if(participant->denoise)
-							janus_audiobridge_participant_denoise(participant, (char *)pkt->data, pkt->length);
-#endif
 						/* Update the details */
 						participant->last_seq = pkt->seq_number;
 						participant->last_timestamp = pkt->timestamp;
@@ -8813,16 +9141,19 @@ static void *janus_audiobridge_participant_thread(void *data) {
 							g_free(pkt);
 							break;
 						}
-						/* Queue the decoded packet for the mixer */
-						janus_mutex_lock(&participant->qmutex);
-						/* Do not let queue-in grow too much */
-						guint count = g_list_length(participant->inbuf);
-						if((int) count > QUEUE_IN_MAX_PACKETS) {
-							JANUS_LOG(LOG_WARN, "Participant queue-in contains too many packets, clearing now (count=%u)\n", count);
-							janus_audiobridge_participant_clear_inbuf(participant);
+#ifdef HAVE_RNNOISE
+						if(participant->denoise) {
+							/* Hand the decoded frame to the denoising pool:
+							 * it will be queued for the mixer when done */
+							janus_audiobridge_participant_denoise_queue(participant, pkt);
+						} else {
+							/* Queue the decoded packet for the mixer */
+							janus_audiobridge_participant_queue_in(participant, pkt);
 						}
-						participant->inbuf = g_list_append(participant->inbuf, pkt);
-						janus_mutex_unlock(&participant->qmutex);
+#else
+						/* Queue the decoded packet for the mixer */
+						janus_audiobridge_participant_queue_in(participant, pkt);
+#endif
 					} else {
 						/* No packet in the jitter buffer? Move on the talking detection, if needed */
 						janus_audiobridge_participant_istalking(session, participant, NULL, NULL);
@@ -8886,11 +9217,6 @@ static void *janus_audiobridge_participant_thread(void *data) {
 						}
 						pkt->length = 320;
 					}
-#ifdef HAVE_RNNOISE
-					/* Check if we need to denoise this packet */
-					if(participant->denoise)
-						janus_audiobridge_participant_denoise(participant, (char *)pkt->data, pkt->length);
-#endif
 					/* Get rid of the buffered packet */
 					janus_audiobridge_buffer_packet_destroy(bpkt);
 					/* Update the details */
@@ -8907,16 +9233,19 @@ static void *janus_audiobridge_participant_thread(void *data) {
 						g_free(pkt);
 						break;
 					}
-					/* Queue the decoded packet for the mixer */
-					janus_mutex_lock(&participant->qmutex);
-					/* Do not let queue-in grow too much */
-					guint count = g_list_length(participant->inbuf);
-					if(count > QUEUE_IN_MAX_PACKETS) {
-						JANUS_LOG(LOG_WARN, "Participant queue-in contains too many packets, clearing now (count=%u)\n", count);
-						janus_audiobridge_participant_clear_inbuf(participant);
+#ifdef HAVE_RNNOISE
+					if(participant->denoise) {
+						/* Hand the decoded frame to the denoising pool:
+						 * it will be queued for the mixer when done */
+						janus_audiobridge_participant_denoise_queue(participant, pkt);
+					} else {
+						/* Queue the decoded packet for the mixer */
+						janus_audiobridge_participant_queue_in(participant, pkt);
 					}
-					participant->inbuf = g_list_append(participant->inbuf, pkt);
-					janus_mutex_unlock(&participant->qmutex);
+#else
+					/* Queue the decoded packet for the mixer */
+					janus_audiobridge_participant_queue_in(participant, pkt);
+#endif
 				}
 			}
 		}
@@ -8953,6 +9282,21 @@ static void *janus_audiobridge_participant_thread(void *data) {
 				outpkt->timestamp = mixedpkt->timestamp/6;
 				outpkt->seq_number = mixedpkt->seq_number;
 				janus_audiobridge_relay_rtp_packet(participant->session, outpkt);
+			} else if(g_atomic_int_get(&participant->active) && mixedpkt->encoded) {
+				/* The mixer already encoded this frame (shared full mix), just packetize it */
+				memcpy(payload+12, mixedpkt->data, mixedpkt->length);
+				outpkt->length = mixedpkt->length + 12;	/* Take the RTP header into consideration */
+				/* Update RTP header */
+				outpkt->data->version = 2;
+				outpkt->data->markerbit = 0;	/* FIXME Should be 1 for the first packet */
+				outpkt->data->seq_number = htons(mixedpkt->seq_number);
+				outpkt->data->timestamp = htonl(mixedpkt->timestamp);
+				outpkt->data->ssrc = htonl(mixedpkt->ssrc);	/* The Janus core will fix this anyway */
+				/* Backup the actual timestamp and sequence number set by the audiobridge, in case a room is changed */
+				outpkt->ssrc = mixedpkt->ssrc;
+				outpkt->timestamp = mixedpkt->timestamp;
+				outpkt->seq_number = mixedpkt->seq_number;
+				janus_audiobridge_relay_rtp_packet(participant->session, outpkt);
 			} else if(g_atomic_int_get(&participant->active) && participant->encoder &&
 					g_atomic_int_compare_and_exchange(&participant->encoding, 0, 1)) {
 				/* Encode raw frame to Opus */
@@ -9054,6 +9398,8 @@ static void janus_audiobridge_plainrtp_media_cleanup(janus_audiobridge_plainrtp_
 	media->remote_audio_ip = NULL;
 	media->audio_ssrc = 0;
 	media->audio_ssrc_peer = 0;
+	media->started = FALSE;
+	media->pollerrs = 0;
 	if(media->pipefd[0] > 0)
 		close(media->pipefd[0]);
 	media->pipefd[0] = -1;
@@ -9119,66 +9465,142 @@ static int janus_audiobridge_plainrtp_allocate_port(janus_audiobridge_plainrtp_m
 	}
 	return -1;
 }
-/* Thread to relay RTP/RTCP frames coming from the peer */
-static void *janus_audiobridge_plainrtp_relay_thread(void *data) {
-	janus_audiobridge_participant *participant = (janus_audiobridge_participant *)data;
-	if(!participant) {
-		JANUS_LOG(LOG_ERR, "Invalid participant!\n");
-		g_thread_unref(g_thread_self());
-		return NULL;
+/* Shared poller thread servicing RTP frames coming from all plain RTP participants */
+static void janus_audiobridge_plainrtp_poller_wakeup(void) {
+	g_atomic_int_set(&plainrtp_poller_update, 1);
+	if(plainrtp_poller_pipe[1] > 0) {
+		int code = 1;
+		ssize_t res = 0;
+		do {
+			res = write(plainrtp_poller_pipe[1], &code, sizeof(int));
+		} while(res == -1 && errno == EINTR);
 	}
-	janus_audiobridge_session *session = participant->session;
-	JANUS_LOG(LOG_INFO, "[AudioBridge-%p] Starting Plain RTP participant thread\n", session);
+}
+static int janus_audiobridge_plainrtp_poller_add(janus_audiobridge_participant *participant) {
+	janus_mutex_lock(&plainrtp_poller_mutex);
+	if(plainrtp_poller == NULL) {
+		/* We still have to spawn the shared poller thread, do it now */
+		if(pipe(plainrtp_poller_pipe) < 0) {
+			JANUS_LOG(LOG_ERR, "Error creating plain RTP poller pipe... %d (%s)\n", errno, g_strerror(errno));
+			janus_mutex_unlock(&plainrtp_poller_mutex);
+			return -1;
+		}
+		GError *error = NULL;
+		plainrtp_poller = g_thread_try_new("rtp poller", &janus_audiobridge_plainrtp_poller_thread, NULL, &error);
+		if(error != NULL) {
+			JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the plain RTP poller thread...\n",
+				error->code, error->message ? error->message : "??");
+			g_error_free(error);
+			close(plainrtp_poller_pipe[0]);
+			close(plainrtp_poller_pipe[1]);
+			plainrtp_poller_pipe[0] = -1;
+			plainrtp_poller_pipe[1] = -1;
+			janus_mutex_unlock(&plainrtp_poller_mutex);
+			return -1;
+		}
+	}
+	g_atomic_int_set(&participant->plainrtp_media.polling, 1);
+	plainrtp_poller_participants = g_slist_append(plainrtp_poller_participants, participant);
+	janus_mutex_unlock(&plainrtp_poller_mutex);
+	janus_audiobridge_plainrtp_poller_wakeup();
+	return 0;
+}
+static void *janus_audiobridge_plainrtp_poller_thread(void *data) {
+	JANUS_LOG(LOG_INFO, "Starting shared plain RTP poller thread\n");
 
-	/* File descriptors */
+	/* File descriptors: one pollfd per participant, plus our wakeup pipe */
+	struct pollfd *fds = NULL;
+	janus_audiobridge_participant **owners = NULL;
+	int size = 0, num = 0, i = 0;
 	socklen_t addrlen;
 	struct sockaddr_storage remote = { 0 };
-	int resfd = 0, bytes = 0, pollerrs = 0;
-	struct pollfd fds[2];
-	int pipe_fd = participant->plainrtp_media.pipefd[0];
+	int resfd = 0, bytes = 0;
 	char buffer[1500];
 	memset(buffer, 0, 1500);
-	/* Loop */
-	int num = 0;
-	gboolean first = TRUE, goon = TRUE;
 
 	/* Fake RTP packet */
 	janus_plugin_rtp packet = { .video = FALSE, .buffer = buffer, .length = 0 };
 	janus_plugin_rtp_extensions_reset(&packet.extensions);
 
-	while(goon && session != NULL && !g_atomic_int_get(&session->destroyed) && !g_atomic_int_get(&session->hangingup)) {
-		/* Prepare poll */
-		num = 0;
-		if(participant->plainrtp_media.audio_rtp_fd != -1) {
-			fds[num].fd = participant->plainrtp_media.audio_rtp_fd;
-			fds[num].events = POLLIN;
-			fds[num].revents = 0;
-			num++;
-		}
-		if(pipe_fd != -1) {
-			fds[num].fd = pipe_fd;
+	/* Loop */
+	g_atomic_int_set(&plainrtp_poller_update, 1);
+	while(!g_atomic_int_get(&stopping)) {
+		if(g_atomic_int_compare_and_exchange(&plainrtp_poller_update, 1, 0)) {
+			/* The set of plain RTP participants changed, rebuild the poll list */
+			janus_mutex_lock(&plainrtp_poller_mutex);
+			int count = (int)g_slist_length(plainrtp_poller_participants);
+			if(count+1 > size) {
+				size = count+1;
+				fds = g_realloc(fds, size*sizeof(struct pollfd));
+				owners = g_realloc(owners, size*sizeof(janus_audiobridge_participant *));
+			}
+			num = 0;
+			fds[num].fd = plainrtp_poller_pipe[0];
 			fds[num].events = POLLIN;
 			fds[num].revents = 0;
+			owners[num] = NULL;
 			num++;
+			GSList *item = plainrtp_poller_participants;
+			while(item) {
+				janus_audiobridge_participant *p = (janus_audiobridge_participant *)item->data;
+				GSList *next = item->next;
+				janus_audiobridge_session *session = p->session;
+				if(session == NULL || g_atomic_int_get(&session->destroyed) ||
+						g_atomic_int_get(&session->hangingup) || p->plainrtp_media.audio_rtp_fd == -1) {
+					/* This participant is gone, get rid of its media and our references */
+					plainrtp_poller_participants = g_slist_delete_link(plainrtp_poller_participants, item);
+					g_atomic_int_set(&p->plainrtp_media.polling, 0);
+					janus_mutex_lock(&p->pmutex);
+					janus_audiobridge_plainrtp_media_cleanup(&p->plainrtp_media);
+					janus_mutex_unlock(&p->pmutex);
+					janus_refcount_decrease(&p->ref);
+					if(session != NULL)
+						janus_refcount_decrease(&session->ref);
+					item = next;
+					continue;
+				}
+				fds[num].fd = p->plainrtp_media.audio_rtp_fd;
+				fds[num].events = POLLIN;
+				fds[num].revents = 0;
+				owners[num] = p;
+				num++;
+				item = next;
+			}
+			janus_mutex_unlock(&plainrtp_poller_mutex);
 		}
 		/* Wait for some data */
 		resfd = poll(fds, num, 1000);
 		if(resfd < 0) {
 			if(errno == EINTR) {
-				JANUS_LOG(LOG_HUGE, "[AudioBridge-%p] Got an EINTR (%s), ignoring...\n", session, g_strerror(errno));
+				JANUS_LOG(LOG_HUGE, "Got an EINTR (%s) polling the plain RTP sockets, ignoring...\n", g_strerror(errno));
 				continue;
 			}
-			JANUS_LOG(LOG_ERR, "[AudioBridge-%p] Error polling...\n", session);
-			JANUS_LOG(LOG_ERR, "[AudioBridge-%p]   -- %d (%s)\n", session, errno, g_strerror(errno));
+			JANUS_LOG(LOG_ERR, "Error polling the plain RTP sockets...\n");
+			JANUS_LOG(LOG_ERR, "  -- %d (%s)\n", errno, g_strerror(errno));
 			break;
 		} else if(resfd == 0) {
-			/* No data, keep going */
+			/* No data, re-check the participants at the next iteration */
+			g_atomic_int_set(&plainrtp_poller_update, 1);
 			continue;
 		}
-		if(session == NULL || g_atomic_int_get(&session->destroyed))
-			break;
-		int i = 0;
 		for(i=0; i<num; i++) {
+			if(fds[i].revents == 0)
+				continue;
+			if(owners[i] == NULL) {
+				/* Something was written on our pipe, we'll rebuild the poll list */
+				if(fds[i].revents & POLLIN) {
+					int code = 0;
+					(void)read(plainrtp_poller_pipe[0], &code, sizeof(int));
+				}
+				continue;
+			}
+			janus_audiobridge_participant *participant = owners[i];
+			janus_audiobridge_session *session = participant->session;
+			if(fds[i].revents & POLLNVAL) {
+				/* Socket was closed under us (e.g., a renegotiation), rebuild */
+				g_atomic_int_set(&plainrtp_poller_update, 1);
+				continue;
+			}
 			if(fds[i].revents & (POLLERR | POLLHUP)) {
 				/* Check the socket error */
 				int error = 0;
@@ -9189,24 +9611,17 @@ static void *janus_audiobridge_plainrtp_relay_thread(void *data) {
 					continue;
 				}
 				/* FIXME Should we be more tolerant of ICMP errors on RTP sockets as well? */
-				pollerrs++;
-				if(pollerrs < 100)
+				participant->plainrtp_media.pollerrs++;
+				if(participant->plainrtp_media.pollerrs < 100)
 					continue;
-				JANUS_LOG(LOG_ERR, "[AudioBridge-%p] Too many errors polling %d (socket #%d): %s...\n", session,
-					fds[i].fd, i, fds[i].revents & POLLERR ? "POLLERR" : "POLLHUP");
+				JANUS_LOG(LOG_ERR, "[AudioBridge-%p] Too many errors polling %d: %s...\n", session,
+					fds[i].fd, fds[i].revents & POLLERR ? "POLLERR" : "POLLHUP");
 				JANUS_LOG(LOG_ERR, "[AudioBridge-%p]   -- %d (%s)\n", session, error, g_strerror(error));
-				/* Can we assume it's pretty much over, after a POLLERR? */
-				goon = FALSE;
-				/* Close the channel */
+				/* Can we assume it's pretty much over, after a POLLERR? Close
+				 * the channel: the next rebuild will get rid of the participant */
 				janus_audiobridge_hangup_media(session->handle);
-				break;
+				continue;
 			} else if(fds[i].revents & POLLIN) {
-				if(pipe_fd != -1 && fds[i].fd == pipe_fd) {
-					/* Poll interrupted for a reason, go on */
-					int code = 0;
-					(void)read(pipe_fd, &code, sizeof(int));
-					break;
-				}
 				/* Got an RTP packet */
 				addrlen = sizeof(remote);
 				bytes = recvfrom(fds[i].fd, buffer, 1500, 0, (struct sockaddr *)&remote, &addrlen);
@@ -9219,13 +9634,13 @@ static void *janus_audiobridge_plainrtp_relay_thread(void *data) {
 					/* Not an RTP packet? */
 					continue;
 				}
-				/* If this is the first packet we receive, simulate a setup_media event */
-				if(first) {
-					first = FALSE;
+				/* If this is the first packet we receive from this participant, simulate a setup_media event */
+				if(!participant->plainrtp_media.started) {
+					participant->plainrtp_media.started = TRUE;
 					janus_audiobridge_setup_media(session->handle);
 				}
 				/* Handle the packet */
-				pollerrs = 0;
+				participant->plainrtp_media.pollerrs = 0;
 				rtp_header *header = (rtp_header *)buffer;
 				if(participant->plainrtp_media.audio_ssrc_peer != ntohl(header->ssrc)) {
 					participant->plainrtp_media.audio_ssrc_peer = ntohl(header->ssrc);
@@ -9241,16 +9656,27 @@ static void *janus_audiobridge_plainrtp_relay_thread(void *data) {
 			}
 		}
 	}
-	/* Cleanup the media session */
-	participant->plainrtp_media.thread = NULL;
-	janus_mutex_lock(&participant->pmutex);
-	janus_audiobridge_plainrtp_media_cleanup(&participant->plainrtp_media);
-	janus_mutex_unlock(&participant->pmutex);
-	/* Done */
-	JANUS_LOG(LOG_INFO, "[AudioBridge-%p] Leaving Plain RTP participant thread\n", session);
-	janus_refcount_decrease(&participant->ref);
-	janus_refcount_decrease(&session->ref);
-	g_thread_unref(g_thread_self());
+	/* We're done: release all the participants we were still servicing */
+	janus_mutex_lock(&plainrtp_poller_mutex);
+	GSList *item = plainrtp_poller_participants;
+	while(item) {
+		janus_audiobridge_participant *p = (janus_audiobridge_participant *)item->data;
+		janus_audiobridge_session *session = p->session;
+		g_atomic_int_set(&p->plainrtp_media.polling, 0);
+		janus_mutex_lock(&p->pmutex);
+		janus_audiobridge_plainrtp_media_cleanup(&p->plainrtp_media);
+		janus_mutex_unlock(&p->pmutex);
+		janus_refcount_decrease(&p->ref);
+		if(session != NULL)
+			janus_refcount_decrease(&session->ref);
+		item = item->next;
+	}
+	g_slist_free(plainrtp_poller_participants);
+	plainrtp_poller_participants = NULL;
+	janus_mutex_unlock(&plainrtp_poller_mutex);
+	g_free(fds);
+	g_free(owners);
+	JANUS_LOG(LOG_INFO, "Leaving shared plain RTP poller thread\n");
 	return NULL;
 }
 
@@ -9322,6 +9748,72 @@ static void janus_audiobridge_participant_istalking(janus_audiobridge_session *s
 }
 
 #ifdef HAVE_RNNOISE
+static void janus_audiobridge_participant_denoise_queue(janus_audiobridge_participant *participant, janus_audiobridge_rtp_relay_packet *pkt) {
+	if(participant->denoise_jobs == NULL)
+		participant->denoise_jobs = g_async_queue_new();
+	janus_audiobridge_denoise_job *job = g_malloc(sizeof(janus_audiobridge_denoise_job));
+	job->pkt = pkt;
+	job->inserted = janus_get_monotonic_time();
+	g_async_queue_push(participant->denoise_jobs, job);
+	/* Schedule a task for this participant, unless one is scheduled already:
+	 * a single task at a time processes all the frames a participant has
+	 * queued, since the RNNoise state is sequential */
+	if(g_atomic_int_compare_and_exchange(&participant->denoising, 0, 1)) {
+		janus_refcount_increase(&participant->ref);
+		GError *error = NULL;
+		g_thread_pool_push(denoise_pool, participant, &error);
+		if(error != NULL) {
+			JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to schedule denoising task...\n",
+				error->code, error->message ? error->message : "??");
+			g_error_free(error);
+			g_atomic_int_set(&participant->denoising, 0);
+			janus_refcount_decrease(&participant->ref);
+			/* As a fallback, process the frame inline like we used to */
+			job = g_async_queue_try_pop(participant->denoise_jobs);
+			if(job != NULL) {
+				janus_audiobridge_participant_denoise(participant, (char *)job->pkt->data, job->pkt->length);
+				janus_audiobridge_participant_queue_in(participant, job->pkt);
+				g_free(job);
+			}
+		}
+	}
+}
+
+static void janus_audiobridge_denoise_task(gpointer data, gpointer user_data) {
+	janus_audiobridge_participant *participant = (janus_audiobridge_participant *)data;
+	janus_audiobridge_denoise_job *job = NULL;
+	while((job = g_async_queue_try_pop(participant->denoise_jobs)) != NULL) {
+		janus_audiobridge_rtp_relay_packet *pkt = job->pkt;
+		if(participant->denoise && (janus_get_monotonic_time() - job->inserted) <= DENOISER_LATENCY_BUDGET*1000) {
+			janus_audiobridge_participant_denoise(participant, (char *)pkt->data, pkt->length);
+		} else {
+			/* Denoising was disabled in the meanwhile, or we're past the
+			 * latency budget already: pass the frame through as it is */
+			JANUS_LOG(LOG_HUGE, "Skipping denoising for a frame (%s)\n",
+				participant->denoise ? "latency budget exceeded" : "denoising disabled");
+		}
+		/* Queue the frame for the mixer */
+		janus_audiobridge_participant_queue_in(participant, pkt);
+		g_free(job);
+	}
+	g_atomic_int_set(&participant->denoising, 0);
+	/* Frames may have been queued while we were winding down: reschedule if so */
+	if(g_async_queue_length(participant->denoise_jobs) > 0 &&
+			g_atomic_int_compare_and_exchange(&participant->denoising, 0, 1)) {
+		janus_refcount_increase(&participant->ref);
+		GError *error = NULL;
+		g_thread_pool_push(denoise_pool, participant, &error);
+		if(error != NULL) {
+			JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to reschedule denoising task...\n",
+				error->code, error->message ? error->message : "??");
+			g_error_free(error);
+			g_atomic_int_set(&participant->denoising, 0);
+			janus_refcount_decrease(&participant->ref);
+		}
+	}
+	janus_refcount_decrease(&participant->ref);
+}
+
 static void janus_audiobridge_participant_denoise(janus_audiobridge_participant *participant, char *data, int len) {
 	if(len < 0 || data == NULL)
 		return;
@@ -76,6 +76,30 @@
  * \c temporalLayerChanged() callbacks: this may be useful to track
  * which layer is actually being sent, vs. what was requested.
  *
+ * \note One of the reasons why handling RTP and RTCP packets in the script
+ * is discouraged is that a single Duktape heap serves all sessions, meaning
+ * every packet of every user contends for the same interpreter lock. If
+ * you do need \c incomingRtp() and/or \c incomingRtcp(), you can mitigate
+ * this by setting the \c rtp_state_pool property in the configuration
+ * file: when set to a value higher than 0, the script is loaded in that
+ * many additional isolated heaps too, and each session is pinned to one
+ * of them (by session identifier) for its RTP/RTCP callbacks, so that
+ * media from different sessions can be processed in parallel. All other
+ * callbacks (messages, data channels, etc.) keep running on the main
+ * heap. Be aware that globals are NOT shared across heaps: each pool
+ * heap loads the script on its own, but \c init() is only invoked on the
+ * main heap; scripts can check the \c statePoolIndex global (0 on the
+ * main heap, 1 and above on pool workers; \c statePoolSize returns the
+ * pool size) to detect where they're being loaded, and can use the
+ * \c sharedSet() and \c sharedGet() functions to exchange string values
+ * across heaps when needed. Finally, since loading the same script
+ * multiple times means compiling it multiple times, you can also set the
+ * \c bytecode_cache property to have the plugin dump the compiled script
+ * to a bytecode file next to the script itself, and reuse it for the
+ * other heaps and across restarts, for a faster startup: the cache is
+ * automatically invalidated whenever the script is more recent than the
+ * bytecode, or the Duktape version changed.
+ *
  * \section dtcapi C interfaces
  *
  * Just as the JavaScript script needs to expose callbacks that the C code can
@@ -101,7 +125,9 @@
  * - \c startRecording(): start recording audio, video and or data for a user;
  * - \c stopRecording(): start recording audio, video and or data for a user;
  * - \c pokeScheduler(): notify the C code that there's a coroutine to resume;
- * - \c timeCallback(): trigger the execution of a JavaScript function after X milliseconds.
+ * - \c timeCallback(): trigger the execution of a JavaScript function after X milliseconds;
+ * - \c sharedSet(): store a string value in the key-value store shared across Duktape heaps;
+ * - \c sharedGet(): read a string value from the key-value store shared across Duktape heaps.
  *
  * As anticipated in the previous section, almost all these methods also
  * expect the unique session identifier to address a specific user in the
@@ -190,6 +216,8 @@ timeCallback("resumeScheduler", null, 0);
  * can register your own C functions.
  */
 
+#include <sys/stat.h>
+
 #include <jansson.h>
 
 /* Session definition and hashtable */
@@ -272,6 +300,22 @@ static char *duktape_folder = NULL;
 /* Duktape stuff */
 duk_context *duktape_ctx = NULL;
 janus_mutex duktape_mutex = JANUS_MUTEX_INITIALIZER;
+/* When the script handles media directly (incomingRtp() and friends),
+ * every packet of every session is serialized on the single heap lock
+ * above: to scale beyond one core, the script can optionally be loaded
+ * in a small pool of additional isolated heaps too, with each session
+ * pinned to one of them for its media callbacks. Pool heaps run the
+ * same script but their globals are private: scripts can detect they're
+ * being loaded as a pool worker via the statePoolIndex global (0 in the
+ * main heap), and can share data across heaps with the sharedSet()
+ * and sharedGet() functions */
+#define JANUS_DUKTAPE_MAX_POOL_SIZE	32
+static int duktape_pool_size = 0;
+static duk_context *duktape_pool[JANUS_DUKTAPE_MAX_POOL_SIZE];
+static janus_mutex duktape_pool_mutex[JANUS_DUKTAPE_MAX_POOL_SIZE];
+/* Cross-heap key-value store, and the mutex to protect it */
+static GHashTable *duktape_shared = NULL;
+static janus_mutex duktape_shared_mutex = JANUS_MUTEX_INITIALIZER;
 static const char *duktape_functions[] = {
 	"init", "destroy", "resumeScheduler",
 	"createSession", "destroySession", "querySession",
@@ -489,6 +533,57 @@ static duk_ret_t janus_duktape_method_readfile(duk_context *ctx) {
 	return 1;
 }
 
+static duk_ret_t janus_duktape_method_sharedset(duk_context *ctx) {
+	/* This method allows the JS script to store a string in a key-value
+	 * store that is shared across all the Duktape heaps of the pool */
+	if(duk_get_type(ctx, 0) != DUK_TYPE_STRING) {
+		duk_push_error_object(ctx, DUK_RET_TYPE_ERROR, "Invalid argument (expected %s, got %s)\n",
+			janus_duktape_type_string(DUK_TYPE_STRING), janus_duktape_type_string(duk_get_type(ctx, 0)));
+		return duk_throw(ctx);
+	}
+	if(duk_get_type(ctx, 1) != DUK_TYPE_STRING && duk_get_type(ctx, 1) != DUK_TYPE_NULL
+			&& duk_get_type(ctx, 1) != DUK_TYPE_UNDEFINED) {
+		duk_push_error_object(ctx, DUK_RET_TYPE_ERROR, "Invalid argument (expected %s, got %s)\n",
+			janus_duktape_type_string(DUK_TYPE_STRING), janus_duktape_type_string(duk_get_type(ctx, 1)));
+		return duk_throw(ctx);
+	}
+	const char *key = duk_get_string(ctx, 0);
+	const char *value = duk_get_string(ctx, 1);
+	janus_mutex_lock(&duktape_shared_mutex);
+	if(duktape_shared == NULL)
+		duktape_shared = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, (GDestroyNotify)g_free);
+	if(value == NULL) {
+		/* A null value removes the key */
+		g_hash_table_remove(duktape_shared, key);
+	} else {
+		g_hash_table_insert(duktape_shared, g_strdup(key), g_strdup(value));
+	}
+	janus_mutex_unlock(&duktape_shared_mutex);
+	duk_push_int(ctx, 0);
+	return 1;
+}
+
+static duk_ret_t janus_duktape_method_sharedget(duk_context *ctx) {
+	/* This method allows the JS script to read a string from the key-value
+	 * store that is shared across all the Duktape heaps of the pool */
+	if(duk_get_type(ctx, 0) != DUK_TYPE_STRING) {
+		duk_push_error_object(ctx, DUK_RET_TYPE_ERROR, "Invalid argument (expected %s, got %s)\n",
+			janus_duktape_type_string(DUK_TYPE_STRING), janus_duktape_type_string(duk_get_type(ctx, 0)));
+		return duk_throw(ctx);
+	}
+	const char *key = duk_get_string(ctx, 0);
+	janus_mutex_lock(&duktape_shared_mutex);
+	char *value = duktape_shared ? g_strdup(g_hash_table_lookup(duktape_shared, key)) : NULL;
+	janus_mutex_unlock(&duktape_shared_mutex);
+	if(value == NULL) {
+		duk_push_null(ctx);
+	} else {
+		duk_push_string(ctx, value);
+		g_free(value);
+	}
+	return 1;
+}
+
 static duk_ret_t janus_duktape_method_pokescheduler(duk_context *ctx) {
 	/* This method allows the JavaScript script to poke the scheduler and have it wake up ASAP */
 	g_async_queue_push(events, GUINT_TO_POINTER(janus_duktape_event_resume));
@@ -1481,6 +1576,178 @@ static duk_ret_t janus_duktape_method_stoprecording(duk_context *ctx) {
 
 
 /* Plugin implementation */
+/* Helper to register all the functions we expose in a Duktape context: we use
+ * it for the main heap and, when a pool is configured, for each pool heap too */
+static void janus_duktape_register_methods(duk_context *ctx) {
+	duk_push_c_function(ctx, janus_duktape_method_getmodulesfolder, 0);
+	duk_put_global_string(ctx, "getModulesFolder");
+	duk_push_c_function(ctx, janus_duktape_method_readfile, 1);
+	duk_put_global_string(ctx, "readFile");
+	duk_push_c_function(ctx, janus_duktape_method_sharedset, 2);
+	duk_put_global_string(ctx, "sharedSet");
+	duk_push_c_function(ctx, janus_duktape_method_sharedget, 1);
+	duk_put_global_string(ctx, "sharedGet");
+	duk_push_c_function(ctx, janus_duktape_method_pokescheduler, 0);
+	duk_put_global_string(ctx, "pokeScheduler");
+	duk_push_c_function(ctx, janus_duktape_method_timecallback, 3);
+	duk_put_global_string(ctx, "timeCallback");
+	duk_push_c_function(ctx, janus_duktape_method_pushevent, 4);
+	duk_put_global_string(ctx, "pushEvent");
+	duk_push_c_function(ctx, janus_duktape_method_notifyevent, 2);
+	duk_put_global_string(ctx, "notifyEvent");
+	duk_push_c_function(ctx, janus_duktape_method_eventsisenabled, 0);
+	duk_put_global_string(ctx, "eventsIsEnabled");
+	duk_push_c_function(ctx, janus_duktape_method_closepc, 1);
+	duk_put_global_string(ctx, "closePc");
+	duk_push_c_function(ctx, janus_duktape_method_endsession, 1);
+	duk_put_global_string(ctx, "endSession");
+	duk_push_c_function(ctx, janus_duktape_method_configuremedium, 4);
+	duk_put_global_string(ctx, "configureMedium");
+	duk_push_c_function(ctx, janus_duktape_method_addrecipient, 2);
+	duk_put_global_string(ctx, "addRecipient");
+	duk_push_c_function(ctx, janus_duktape_method_removerecipient, 2);
+	duk_put_global_string(ctx, "removeRecipient");
+	duk_push_c_function(ctx, janus_duktape_method_setbitrate, 2);
+	duk_put_global_string(ctx, "setBitrate");
+	duk_push_c_function(ctx, janus_duktape_method_setplifreq, 2);
+	duk_put_global_string(ctx, "setPliFreq");
+	duk_push_c_function(ctx, janus_duktape_method_setsubstream, 2);
+	duk_put_global_string(ctx, "setSubstream");
+	duk_push_c_function(ctx, janus_duktape_method_settemporallayer, 2);
+	duk_put_global_string(ctx, "setTemporalLayer");
+	duk_push_c_function(ctx, janus_duktape_method_sendpli, 1);
+	duk_put_global_string(ctx, "sendPli");
+	duk_push_c_function(ctx, janus_duktape_method_relayrtp, 4);
+	duk_put_global_string(ctx, "relayRtp");
+	duk_push_c_function(ctx, janus_duktape_method_relayrtcp, 4);
+	duk_put_global_string(ctx, "relayRtcp");
+	duk_push_c_function(ctx, janus_duktape_method_relaydata, 5);	/* Legacy function, deprecated */
+	duk_put_global_string(ctx, "relayData");
+	duk_push_c_function(ctx, janus_duktape_method_relaytextdata, 5);
+	duk_put_global_string(ctx, "relayTextData");
+	duk_push_c_function(ctx, janus_duktape_method_relaybinarydata, 5);
+	duk_put_global_string(ctx, "relayBinaryData");
+	duk_push_c_function(ctx, janus_duktape_method_startrecording, 13);
+	duk_put_global_string(ctx, "startRecording");
+	duk_push_c_function(ctx, janus_duktape_method_stoprecording, 4);
+	duk_put_global_string(ctx, "stopRecording");
+	duk_push_c_function(ctx, janus_duktape_method_getversion, 0);
+	duk_put_global_string(ctx, "getDuktapeVersion");
+	/* Register all extra functions, if any were added */
+	janus_duktape_register_extra_functions(ctx);
+}
+
+/* Magic string we prefix to cached bytecode files: the Duktape bytecode
+ * format is not guaranteed to be stable across versions, so we refuse to
+ * load a cache that was generated by a different Duktape */
+#define JANUS_DUKTAPE_BYTECODE_MAGIC	"janus-duktape-bytecode"
+
+/* Helper to load the configured script in a Duktape context, either by
+ * compiling the source or, when a bytecode cache file is provided, by
+ * loading the bytecode we dumped on a previous startup: since the same
+ * script may have to be loaded in several heaps (see the pool), skipping
+ * the compilation makes startup faster. Returns 0 on success, and a
+ * negative integer otherwise (it's up to the caller to clean up) */
+static int janus_duktape_load_script(duk_context *ctx, const char *file, const char *cache_file) {
+	/* If there's a cached bytecode copy of the script that is not older
+	 * than the script itself, try loading that instead of compiling */
+	if(cache_file != NULL) {
+		struct stat sbuf = { 0 }, cbuf = { 0 };
+		if(stat(file, &sbuf) == 0 && stat(cache_file, &cbuf) == 0 && cbuf.st_mtime >= sbuf.st_mtime) {
+			FILE *cf = fopen(cache_file, "rb");
+			if(cf != NULL) {
+				char magic[sizeof(JANUS_DUKTAPE_BYTECODE_MAGIC)-1];
+				uint32_t version = 0;
+				long int hlen = sizeof(magic)+sizeof(version);
+				fseek(cf, 0, SEEK_END);
+				long int cs = ftell(cf);
+				fseek(cf, 0, SEEK_SET);
+				if(cs > hlen && fread(magic, 1, sizeof(magic), cf) == sizeof(magic) &&
+						memcmp(magic, JANUS_DUKTAPE_BYTECODE_MAGIC, sizeof(magic)) == 0 &&
+						fread(&version, 1, sizeof(version), cf) == sizeof(version) &&
+						version == (uint32_t)DUK_VERSION) {
+					size_t blen = cs - hlen;
+					void *bytecode = duk_push_fixed_buffer(ctx, blen);
+					if(fread(bytecode, 1, blen, cf) == blen) {
+						fclose(cf);
+						duk_load_function(ctx);
+						if(duk_pcall(ctx, 0) != 0) {
+							JANUS_LOG(LOG_ERR, "Error running cached bytecode %s: %s\n",
+								cache_file, duk_safe_to_string(ctx, -1));
+							return -1;
+						}
+						duk_pop(ctx);
+						JANUS_LOG(LOG_VERB, "Loaded JS script %s from cached bytecode (%s)\n", file, cache_file);
+						return 0;
+					}
+					duk_pop(ctx);
+				}
+				fclose(cf);
+				JANUS_LOG(LOG_WARN, "Stale or invalid bytecode cache %s, compiling the script instead\n", cache_file);
+			}
+		}
+	}
+	/* Read and compile the script (FIXME badly) */
+	FILE *f = fopen(file, "rb");
+	if(f == NULL) {
+		JANUS_LOG(LOG_ERR, "Error loading JS script %s: no such file\n", file);
+		return -1;
+	}
+	fseek(f, 0, SEEK_END);
+	long int fs = ftell(f);
+	if(fs < 1) {
+		JANUS_LOG(LOG_ERR, "Error loading JS script %s: empty file\n", file);
+		fclose(f);
+		return -1;
+	}
+	size_t len = fs;
+	char *buf = (char *)g_malloc0(len);
+	fseek(f, 0, SEEK_SET);
+	if(fread((void *)buf, 1, len, f) < len) {
+		JANUS_LOG(LOG_ERR, "Error reading JS script %s: %s\n", file, g_strerror(errno));
+		g_free(buf);
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+	duk_push_lstring(ctx, (const char *)buf, (duk_size_t)len);
+	g_free(buf);
+	duk_push_string(ctx, file);
+	if(duk_pcompile(ctx, 0) != 0) {
+		JANUS_LOG(LOG_ERR, "Error loading JS script %s: %s\n", file, duk_safe_to_string(ctx, -1));
+		return -1;
+	}
+	/* If a bytecode cache was configured, dump the compiled program to
+	 * disk, so that the next load (and the next startup) can skip this */
+	if(cache_file != NULL) {
+		duk_dup_top(ctx);
+		duk_dump_function(ctx);
+		duk_size_t blen = 0;
+		void *bytecode = duk_get_buffer(ctx, -1, &blen);
+		FILE *cf = fopen(cache_file, "wb");
+		if(cf == NULL) {
+			JANUS_LOG(LOG_WARN, "Couldn't write bytecode cache %s: %s\n", cache_file, g_strerror(errno));
+		} else {
+			uint32_t version = (uint32_t)DUK_VERSION;
+			if(fwrite(JANUS_DUKTAPE_BYTECODE_MAGIC, 1, sizeof(JANUS_DUKTAPE_BYTECODE_MAGIC)-1, cf) != sizeof(JANUS_DUKTAPE_BYTECODE_MAGIC)-1 ||
+					fwrite(&version, 1, sizeof(version), cf) != sizeof(version) ||
+					fwrite(bytecode, 1, blen, cf) != blen) {
+				JANUS_LOG(LOG_WARN, "Error writing bytecode cache %s: %s\n", cache_file, g_strerror(errno));
+				unlink(cache_file);
+			}
+			fclose(cf);
+		}
+		duk_pop(ctx);
+	}
+	/* Now run the compiled program */
+	if(duk_pcall(ctx, 0) != 0) {
+		JANUS_LOG(LOG_ERR, "Error loading JS script %s: %s\n", file, duk_safe_to_string(ctx, -1));
+		return -1;
+	}
+	duk_pop(ctx);
+	return 0;
+}
+
 int janus_duktape_init(janus_callbacks *callback, const char *config_path) {
 	if(g_atomic_int_get(&duktape_stopping)) {
 		/* Still stopping from before */
@@ -1524,6 +1791,19 @@ int janus_duktape_init(janus_callbacks *callback, const char *config_path) {
 	janus_config_item *conf = janus_config_get(config, config_general, janus_config_type_item, "config");
 	if(conf && conf->value)
 		duktape_config = g_strdup(conf->value);
+	char *duktape_bytecode = NULL;
+	janus_config_item *bytecode = janus_config_get(config, config_general, janus_config_type_item, "bytecode_cache");
+	if(bytecode && bytecode->value && janus_is_true(bytecode->value))
+		duktape_bytecode = g_strdup_printf("%s.bc", duktape_file);
+	int pool_size = 0;
+	janus_config_item *pool = janus_config_get(config, config_general, janus_config_type_item, "rtp_state_pool");
+	if(pool && pool->value) {
+		pool_size = atoi(pool->value);
+		if(pool_size < 0 || pool_size > JANUS_DUKTAPE_MAX_POOL_SIZE) {
+			JANUS_LOG(LOG_WARN, "Invalid rtp_state_pool value (%s), ignoring...\n", pool->value);
+			pool_size = 0;
+		}
+	}
 	janus_config_destroy(config);
 
 	/* Initialize Duktape */
@@ -1537,101 +1817,22 @@ int janus_duktape_init(janus_callbacks *callback, const char *config_path) {
 	duk_module_duktape_init(duktape_ctx);
 
 	/* Register our functions */
-	duk_push_c_function(duktape_ctx, janus_duktape_method_getmodulesfolder, 0);
-	duk_put_global_string(duktape_ctx, "getModulesFolder");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_readfile, 1);
-	duk_put_global_string(duktape_ctx, "readFile");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_pokescheduler, 0);
-	duk_put_global_string(duktape_ctx, "pokeScheduler");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_timecallback, 3);
-	duk_put_global_string(duktape_ctx, "timeCallback");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_pushevent, 4);
-	duk_put_global_string(duktape_ctx, "pushEvent");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_notifyevent, 2);
-	duk_put_global_string(duktape_ctx, "notifyEvent");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_eventsisenabled, 0);
-	duk_put_global_string(duktape_ctx, "eventsIsEnabled");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_closepc, 1);
-	duk_put_global_string(duktape_ctx, "closePc");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_endsession, 1);
-	duk_put_global_string(duktape_ctx, "endSession");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_configuremedium, 4);
-	duk_put_global_string(duktape_ctx, "configureMedium");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_addrecipient, 2);
-	duk_put_global_string(duktape_ctx, "addRecipient");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_removerecipient, 2);
-	duk_put_global_string(duktape_ctx, "removeRecipient");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_setbitrate, 2);
-	duk_put_global_string(duktape_ctx, "setBitrate");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_setplifreq, 2);
-	duk_put_global_string(duktape_ctx, "setPliFreq");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_setsubstream, 2);
-	duk_put_global_string(duktape_ctx, "setSubstream");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_settemporallayer, 2);
-	duk_put_global_string(duktape_ctx, "setTemporalLayer");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_sendpli, 1);
-	duk_put_global_string(duktape_ctx, "sendPli");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_relayrtp, 4);
-	duk_put_global_string(duktape_ctx, "relayRtp");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_relayrtcp, 4);
-	duk_put_global_string(duktape_ctx, "relayRtcp");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_relaydata, 5);	/* Legacy function, deprecated */
-	duk_put_global_string(duktape_ctx, "relayData");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_relaytextdata, 5);
-	duk_put_global_string(duktape_ctx, "relayTextData");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_relaybinarydata, 5);
-	duk_put_global_string(duktape_ctx, "relayBinaryData");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_startrecording, 13);
-	duk_put_global_string(duktape_ctx, "startRecording");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_stoprecording, 4);
-	duk_put_global_string(duktape_ctx, "stopRecording");
-	duk_push_c_function(duktape_ctx, janus_duktape_method_getversion, 0);
-	duk_put_global_string(duktape_ctx, "getDuktapeVersion");
-	/* Register all extra functions, if any were added */
-	janus_duktape_register_extra_functions(duktape_ctx);
-
-	/* Now load the script (FIXME badly) */
-	FILE *f = fopen(duktape_file, "rb");
-	if(f == NULL) {
-		JANUS_LOG(LOG_ERR, "Error loading JS script %s: no such file\n", duktape_file);
-		duk_destroy_heap(duktape_ctx);
-		g_free(duktape_folder);
-		g_free(duktape_file);
-		return -1;
-	}
-	fseek(f, 0, SEEK_END);
-	long int fs = ftell(f);
-	if(fs < 1) {
-		JANUS_LOG(LOG_ERR, "Error loading JS script %s: empty file\n", duktape_file);
-		fclose(f);
-		duk_destroy_heap(duktape_ctx);
-		g_free(duktape_folder);
-		g_free(duktape_file);
-		return -1;
-	}
-	size_t len = fs;
-	char *buf = (char *)g_malloc0(len);
-	fseek(f, 0, SEEK_SET);
-	if(fread((void *)buf, 1, len, f) < len) {
-		JANUS_LOG(LOG_ERR, "Error reading JS script %s: %s\n", duktape_file, g_strerror(errno));
-		g_free(buf);
-		fclose(f);
-		duk_destroy_heap(duktape_ctx);
-		g_free(duktape_folder);
-		g_free(duktape_file);
-		return -1;
-	}
-	fclose(f);
-	duk_push_lstring(duktape_ctx, (const char *)buf, (duk_size_t)len);
-	g_free(buf);
-	if(duk_peval(duktape_ctx) != 0) {
-		JANUS_LOG(LOG_ERR, "Error loading JS script %s: %s\n", duktape_file, duk_safe_to_string(duktape_ctx, -1));
+	janus_duktape_register_methods(duktape_ctx);
+	/* Tell the script about the heap pool: the main heap is index 0 */
+	duk_push_int(duktape_ctx, 0);
+	duk_put_global_string(duktape_ctx, "statePoolIndex");
+	duk_push_int(duktape_ctx, pool_size);
+	duk_put_global_string(duktape_ctx, "statePoolSize");
+
+	/* Now load the script */
+	if(janus_duktape_load_script(duktape_ctx, duktape_file, duktape_bytecode) < 0) {
 		duk_destroy_heap(duktape_ctx);
 		g_free(duktape_folder);
 		g_free(duktape_file);
+		g_free(duktape_config);
+		g_free(duktape_bytecode);
 		return -1;
 	}
-	duk_pop(duktape_ctx);
 	/* Make sure that all the functions we need are there */
 	uint i=0;
 	for(i=0; i<duktape_funcsize; i++) {
@@ -1641,6 +1842,7 @@ int janus_duktape_init(janus_callbacks *callback, const char *config_path) {
 			duk_destroy_heap(duktape_ctx);
 			g_free(duktape_folder);
 			g_free(duktape_file);
+			g_free(duktape_bytecode);
 			return -1;
 		}
 	}
@@ -1699,6 +1901,65 @@ int janus_duktape_init(janus_callbacks *callback, const char *config_path) {
 	if(duk_is_function(duktape_ctx, duk_get_top(duktape_ctx)-1) != 0)
 		has_temporal_changed = TRUE;
 
+	/* If a pool of Duktape heaps was configured and the script does handle
+	 * media directly, load the script in each of those additional heaps too:
+	 * each session will then be pinned to one of the heaps for its RTP and
+	 * RTCP callbacks, so that media processing can actually happen in
+	 * parallel, while everything else (signalling, data) stays on the main
+	 * heap. Notice that, since the bytecode cache was populated above when
+	 * enabled, these additional loads can skip the compilation entirely */
+	if(pool_size > 0 && !has_incoming_rtp && !has_incoming_rtcp) {
+		JANUS_LOG(LOG_WARN, "A heap pool was configured (rtp_state_pool) but the script doesn't handle RTP/RTCP, ignoring...\n");
+		pool_size = 0;
+		duk_push_int(duktape_ctx, 0);
+		duk_put_global_string(duktape_ctx, "statePoolSize");
+	}
+	int p = 0;
+	for(p=0; p<pool_size; p++) {
+		duk_context *pctx = duk_create_heap_default();
+		if(pctx == NULL) {
+			JANUS_LOG(LOG_ERR, "Error creating Duktape heap %d for the pool...\n", p+1);
+			while(--p >= 0) {
+				duk_destroy_heap(duktape_pool[p]);
+				duktape_pool[p] = NULL;
+			}
+			duk_destroy_heap(duktape_ctx);
+			g_free(duktape_folder);
+			g_free(duktape_file);
+			g_free(duktape_config);
+			g_free(duktape_bytecode);
+			return -1;
+		}
+		duk_console_init(pctx, DUK_CONSOLE_PROXY_WRAPPER);
+		duk_module_duktape_init(pctx);
+		janus_duktape_register_methods(pctx);
+		/* Let the script know it's being loaded as a pool worker (index 1..N) */
+		duk_push_int(pctx, p+1);
+		duk_put_global_string(pctx, "statePoolIndex");
+		duk_push_int(pctx, pool_size);
+		duk_put_global_string(pctx, "statePoolSize");
+		if(janus_duktape_load_script(pctx, duktape_file, duktape_bytecode) < 0) {
+			JANUS_LOG(LOG_ERR, "Error loading JS script %s in pool heap %d\n", duktape_file, p+1);
+			duk_destroy_heap(pctx);
+			while(--p >= 0) {
+				duk_destroy_heap(duktape_pool[p]);
+				duktape_pool[p] = NULL;
+			}
+			duk_destroy_heap(duktape_ctx);
+			g_free(duktape_folder);
+			g_free(duktape_file);
+			g_free(duktape_config);
+			g_free(duktape_bytecode);
+			return -1;
+		}
+		duktape_pool[p] = pctx;
+		janus_mutex_init(&duktape_pool_mutex[p]);
+	}
+	duktape_pool_size = pool_size;
+	if(duktape_pool_size > 0)
+		JANUS_LOG(LOG_INFO, "Loaded the JS script in a pool of %d additional heaps for RTP/RTCP handling\n", duktape_pool_size);
+	g_free(duktape_bytecode);
+
 	duktape_sessions = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_duktape_session_destroy);
 	duktape_ids = g_hash_table_new(NULL, NULL);
 	events = g_async_queue_new();
@@ -1819,6 +2080,22 @@ void janus_duktape_destroy(void) {
 	duk_destroy_heap(duktape_ctx);
 	duktape_ctx = NULL;
 	janus_mutex_unlock(&duktape_mutex);
+	/* Get rid of the heap pool too, if we created one: we don't invoke the
+	 * script destroy() callback there, as workers never had init() invoked */
+	int p = 0;
+	for(p=0; p<duktape_pool_size; p++) {
+		janus_mutex_lock(&duktape_pool_mutex[p]);
+		duk_destroy_heap(duktape_pool[p]);
+		duktape_pool[p] = NULL;
+		janus_mutex_unlock(&duktape_pool_mutex[p]);
+	}
+	duktape_pool_size = 0;
+	janus_mutex_lock(&duktape_shared_mutex);
+	if(duktape_shared != NULL) {
+		g_hash_table_destroy(duktape_shared);
+		duktape_shared = NULL;
+	}
+	janus_mutex_unlock(&duktape_shared_mutex);
 
 	g_free(duktape_script_version_string);
 	g_free(duktape_script_description);
@@ -2387,6 +2664,20 @@ void janus_duktape_setup_media(janus_plugin_session *handle) {
 	janus_refcount_decrease(&session->ref);
 }
 
+/* Helper to get the Duktape heap a session's media callbacks should run on,
+ * and the mutex protecting it: when the heap pool is enabled, each session is
+ * pinned to one of the pool heaps by its ID, so that different sessions can
+ * be served in parallel; otherwise, we just fall back to the main heap */
+static duk_context *janus_duktape_media_ctx(janus_duktape_session *session, janus_mutex **mutex) {
+	if(duktape_pool_size > 0) {
+		int index = session->id % duktape_pool_size;
+		*mutex = &duktape_pool_mutex[index];
+		return duktape_pool[index];
+	}
+	*mutex = &duktape_mutex;
+	return duktape_ctx;
+}
+
 void janus_duktape_incoming_rtp(janus_plugin_session *handle, janus_plugin_rtp *rtp_packet) {
 	if(handle == NULL || handle->stopped || g_atomic_int_get(&duktape_stopping) || !g_atomic_int_get(&duktape_initialized))
 		return;
@@ -2403,9 +2694,11 @@ void janus_duktape_incoming_rtp(janus_plugin_session *handle, janus_plugin_rtp *
 	/* Check if the JS script wants to handle/manipulate RTP packets itself */
 	if(has_incoming_rtp) {
 		/* Yep, pass the data to the JS script and return */
-		janus_mutex_lock(&duktape_mutex);
-		duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-		duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+		janus_mutex *ctx_mutex = NULL;
+		duk_context *ctx = janus_duktape_media_ctx(session, &ctx_mutex);
+		janus_mutex_lock(ctx_mutex);
+		duk_idx_t thr_idx = duk_push_thread(ctx);
+		duk_context *t = duk_get_context(ctx, thr_idx);
 		duk_get_global_string(t, "incomingRtp");
 		duk_push_number(t, session->id);
 		duk_push_boolean(t, video);
@@ -2417,8 +2710,8 @@ void janus_duktape_incoming_rtp(janus_plugin_session *handle, janus_plugin_rtp *
 			JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 		}
 		duk_pop(t);
-		duk_pop(duktape_ctx);
-		janus_mutex_unlock(&duktape_mutex);
+		duk_pop(ctx);
+		janus_mutex_unlock(ctx_mutex);
 		return;
 	}
 	/* Is this session allowed to send media? */
@@ -2520,9 +2813,11 @@ void janus_duktape_incoming_rtcp(janus_plugin_session *handle, janus_plugin_rtcp
 	/* Check if the JS script wants to handle/manipulate RTCP packets itself */
 	if(has_incoming_rtcp) {
 		/* Yep, pass the data to the JS script and return */
-		janus_mutex_lock(&duktape_mutex);
-		duk_idx_t thr_idx = duk_push_thread(duktape_ctx);
-		duk_context *t = duk_get_context(duktape_ctx, thr_idx);
+		janus_mutex *ctx_mutex = NULL;
+		duk_context *ctx = janus_duktape_media_ctx(session, &ctx_mutex);
+		janus_mutex_lock(ctx_mutex);
+		duk_idx_t thr_idx = duk_push_thread(ctx);
+		duk_context *t = duk_get_context(ctx, thr_idx);
 		duk_get_global_string(t, "incomingRtcp");
 		duk_push_number(t, session->id);
 		duk_push_boolean(t, video);
@@ -2534,8 +2829,8 @@ void janus_duktape_incoming_rtcp(janus_plugin_session *handle, janus_plugin_rtcp
 			JANUS_LOG(LOG_ERR, "Duktape error: %s\n", duk_safe_to_string(t, -1));
 		}
 		duk_pop(t);
-		duk_pop(duktape_ctx);
-		janus_mutex_unlock(&duktape_mutex);
+		duk_pop(ctx);
+		janus_mutex_unlock(ctx_mutex);
 		return;
 	}
 	/* If a REMB arrived, make sure we cap it to our configuration, and send it as a video RTCP */
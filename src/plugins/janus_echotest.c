@@ -233,6 +233,18 @@ typedef struct janus_echotest_message {
 static GAsyncQueue *messages = NULL;
 static janus_echotest_message exit_message;
 
+/* Number of buckets used to track how long echoed packets spend in the plugin */
+#define JANUS_ECHOTEST_LATENCY_BUCKETS	8
+/* Upper edge of each bucket, in microseconds (the last bucket is unbounded) */
+static const gint64 janus_echotest_latency_edges[JANUS_ECHOTEST_LATENCY_BUCKETS-1] =
+	{ 10, 25, 50, 100, 250, 500, 1000 };
+typedef struct janus_echotest_latency_stats {
+	guint64 buckets[JANUS_ECHOTEST_LATENCY_BUCKETS];	/* Histogram of dwell times */
+	guint64 count;	/* Number of packets tracked so far */
+	guint64 sum;	/* Sum of all dwell times, to compute the average */
+	gint64 max;		/* Worst dwell time seen so far */
+} janus_echotest_latency_stats;
+
 typedef struct janus_echotest_session {
 	janus_plugin_session *handle;
 	gboolean has_audio;
@@ -260,6 +272,7 @@ typedef struct janus_echotest_session {
 	janus_mutex rec_mutex;	/* Mutex to protect the recorders from race conditions */
 	guint16 slowlink_count;
 	int16_t min_delay, max_delay;
+	janus_echotest_latency_stats latency[2];	/* Dwell time stats for audio (0) and video (1) packets */
 	volatile gint hangingup;
 	volatile gint destroyed;
 	janus_refcount ref;
@@ -483,6 +496,48 @@ void janus_echotest_destroy_session(janus_plugin_session *handle, int *error) {
 	return;
 }
 
+/* Helpers to track the dwell time of echoed packets, i.e., how long the plugin
+ * keeps them from the moment the core hands them over at ingress to the moment
+ * they're queued for delivery again: each session keeps separate histograms for
+ * audio and video, which makes every echo session double as a latency probe of
+ * the media relaying machinery */
+static json_t *janus_echotest_latency_summary(janus_echotest_latency_stats *stats) {
+	json_t *summary = json_object();
+	json_object_set_new(summary, "packets", json_integer(stats->count));
+	json_object_set_new(summary, "avg-us", json_integer(stats->count > 0 ? (gint64)(stats->sum / stats->count) : 0));
+	json_object_set_new(summary, "max-us", json_integer(stats->max));
+	json_t *edges = json_array(), *histogram = json_array();
+	int i = 0;
+	for(i = 0; i < JANUS_ECHOTEST_LATENCY_BUCKETS; i++) {
+		if(i < JANUS_ECHOTEST_LATENCY_BUCKETS-1)
+			json_array_append_new(edges, json_integer(janus_echotest_latency_edges[i]));
+		json_array_append_new(histogram, json_integer(stats->buckets[i]));
+	}
+	json_object_set_new(summary, "buckets-us", edges);
+	json_object_set_new(summary, "histogram", histogram);
+	return summary;
+}
+static void janus_echotest_latency_track(janus_echotest_session *session, gboolean video, gint64 ingress) {
+	janus_echotest_latency_stats *stats = &session->latency[video ? 1 : 0];
+	gint64 dwell = janus_get_monotonic_time() - ingress;
+	int bucket = 0;
+	while(bucket < JANUS_ECHOTEST_LATENCY_BUCKETS-1 && dwell > janus_echotest_latency_edges[bucket])
+		bucket++;
+	stats->buckets[bucket]++;
+	stats->count++;
+	stats->sum += dwell;
+	if(dwell > stats->max)
+		stats->max = dwell;
+	/* Every once in a while, also notify event handlers about the histogram */
+	if(stats->count % 5000 == 0 && notify_events && gateway->events_is_enabled()) {
+		json_t *info = json_object();
+		json_object_set_new(info, "event", json_string("latency"));
+		json_object_set_new(info, "media", json_string(video ? "video" : "audio"));
+		json_object_set_new(info, "dwell", janus_echotest_latency_summary(stats));
+		gateway->notify_event(&janus_echotest_plugin, session->handle, info);
+	}
+}
+
 json_t *janus_echotest_query_session(janus_plugin_session *handle) {
 	if(g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized)) {
 		return NULL;
@@ -509,6 +564,15 @@ json_t *janus_echotest_query_session(janus_plugin_session *handle) {
 		json_object_set_new(info, "video_codec", json_string(janus_videocodec_name(session->vcodec)));
 	json_object_set_new(info, "bitrate", json_integer(session->bitrate));
 	json_object_set_new(info, "peer-bitrate", json_integer(session->peer_bitrate));
+	if(session->latency[0].count > 0 || session->latency[1].count > 0) {
+		/* Summarize how long echoed packets have been spending in the plugin */
+		json_t *latency = json_object();
+		if(session->latency[0].count > 0)
+			json_object_set_new(latency, "audio", janus_echotest_latency_summary(&session->latency[0]));
+		if(session->latency[1].count > 0)
+			json_object_set_new(latency, "video", janus_echotest_latency_summary(&session->latency[1]));
+		json_object_set_new(info, "latency", latency);
+	}
 	if(session->ssrc[0] != 0 || session->rid[0] != NULL) {
 		json_object_set_new(info, "simulcast", json_true());
 		json_object_set_new(info, "substream", json_integer(session->sim_context.substream));
@@ -598,6 +662,8 @@ void janus_echotest_incoming_rtp(janus_plugin_session *handle, janus_plugin_rtp
 		return;
 	/* Simple echo test */
 	if(gateway) {
+		/* Take note of when we got the packet, to track how long we keep it */
+		gint64 ingress = janus_get_monotonic_time();
 		/* Honour the audio/video active flags */
 		janus_echotest_session *session = (janus_echotest_session *)handle->plugin_handle;
 		if(!session) {
@@ -687,6 +753,7 @@ void janus_echotest_incoming_rtp(janus_plugin_session *handle, janus_plugin_rtp
 			janus_recorder_save_frame(session->vrc, buf, len);
 			/* Send the frame back */
 			gateway->relay_rtp(handle, packet);
+			janus_echotest_latency_track(session, video, ingress);
 			/* Restore header or core statistics will be messed up */
 			header->ssrc = htonl(ssrc);
 			header->timestamp = htonl(timestamp);
@@ -697,6 +764,7 @@ void janus_echotest_incoming_rtp(janus_plugin_session *handle, janus_plugin_rtp
 				janus_recorder_save_frame(video ? session->vrc : session->arc, buf, len);
 				/* Send the frame back */
 				gateway->relay_rtp(handle, packet);
+				janus_echotest_latency_track(session, video, ingress);
 			}
 		}
 	}
@@ -905,6 +973,7 @@ static void janus_echotest_hangup_media_internal(janus_plugin_session *handle) {
 	janus_vp8_simulcast_context_reset(&session->vp8_context);
 	session->min_delay = -1;
 	session->max_delay = -1;
+	memset(session->latency, 0, sizeof(session->latency));
 	g_atomic_int_set(&session->hangingup, 0);
 }
 
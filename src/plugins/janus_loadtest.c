@@ -0,0 +1,826 @@
+/*! \file   janus_loadtest.c
+ * \author Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief  Janus LoadTest plugin
+ * \details Check the \ref loadtest for more details.
+ *
+ * \ingroup plugins
+ * \ref plugins
+ *
+ * \page loadtest LoadTest plugin documentation
+ * This is a synthetic load generator plugin for Janus, meant to help
+ * with capacity testing. A peer attaching to this plugin negotiates a
+ * recvonly PeerConnection, and the plugin then synthesizes RTP traffic
+ * towards it at a configurable rate: since the generated packets go
+ * through the same machinery real media does (queueing, SRTP, ICE),
+ * this allows you to estimate how many streams a Janus instance can
+ * sustain without needing a fleet of real WebRTC publishers; just
+ * attach as many handles as the virtual subscribers you want to
+ * simulate, and watch the CPU. Notice that the generated payloads are
+ * not valid media frames, so don't expect to render anything on the
+ * receiving end: this is about stressing the relay path, not the
+ * decoders.
+ *
+ * \section loadtestapi LoadTest API
+ *
+ * All requests are asynchronous, which means all responses (successes
+ * and errors) will be delivered as events with the same transaction.
+ *
+ * \c start starts generating traffic on the PeerConnection (a JSEP
+ * offer can be attached to negotiate it at the same time), \c configure
+ * updates the generator properties while it's running, and \c stop
+ * stops the generator without tearing the PeerConnection down.
+ *
+ * The \c start and \c configure requests accept the same properties,
+ * all of which are optional:
+ *
+\verbatim
+{
+	"request" : "start|configure|stop",
+	"audio" : true|false (whether audio should be generated, default=true),
+	"video" : true|false (whether video should be generated, default=true),
+	"packet_size" : <size in bytes of the video payloads, default=1200>,
+	"video_pps" : <video packets to generate per second, default=90>,
+	"layers" : <number of simulcast-like layers to emulate (1-3, default=1);
+		each additional layer multiplies the generated video packets,
+		to approximate the load of a simulcast publisher>,
+	"loss" : <percentage of video packets to drop before relaying (0-100,
+		default=0); lost packets still consume a sequence number, so the
+		receiver will see real gaps and trigger the NACK machinery>
+}
+\endverbatim
+ *
+ * A successful request will result in an \c ok event:
+ *
+\verbatim
+{
+	"loadtest" : "event",
+	"result": "ok"
+}
+\endverbatim
+ *
+ * An error instead will provide both an error code and a more verbose
+ * description of the cause of the issue:
+ *
+\verbatim
+{
+	"loadtest" : "event",
+	"error_code" : <numeric ID, check Macros below>,
+	"error" : "<error description as a string>"
+}
+\endverbatim
+ *
+ * When the generator stops (because of a \c stop request or the
+ * PeerConnection going away), an event summarizing the generated
+ * traffic is triggered:
+ *
+\verbatim
+{
+	"loadtest" : "event",
+	"result": "stopped",
+	"packets" : <number of RTP packets generated>,
+	"bytes" : <number of payload bytes generated>
+}
+\endverbatim
+ */
+
+#include "plugin.h"
+
+#include <jansson.h>
+
+#include "../debug.h"
+#include "../apierror.h"
+#include "../config.h"
+#include "../mutex.h"
+#include "../rtp.h"
+#include "../rtcp.h"
+#include "../sdp-utils.h"
+#include "../utils.h"
+
+
+/* Plugin information */
+#define JANUS_LOADTEST_VERSION			1
+#define JANUS_LOADTEST_VERSION_STRING	"0.0.1"
+#define JANUS_LOADTEST_DESCRIPTION		"This is a synthetic load generator plugin for Janus, useful for capacity testing."
+#define JANUS_LOADTEST_NAME				"JANUS LoadTest plugin"
+#define JANUS_LOADTEST_AUTHOR			"Meetecho s.r.l."
+#define JANUS_LOADTEST_PACKAGE			"janus.plugin.loadtest"
+
+/* Plugin methods */
+janus_plugin *create(void);
+int janus_loadtest_init(janus_callbacks *callback, const char *config_path);
+void janus_loadtest_destroy(void);
+int janus_loadtest_get_api_compatibility(void);
+int janus_loadtest_get_version(void);
+const char *janus_loadtest_get_version_string(void);
+const char *janus_loadtest_get_description(void);
+const char *janus_loadtest_get_name(void);
+const char *janus_loadtest_get_author(void);
+const char *janus_loadtest_get_package(void);
+void janus_loadtest_create_session(janus_plugin_session *handle, int *error);
+struct janus_plugin_result *janus_loadtest_handle_message(janus_plugin_session *handle, char *transaction, json_t *message, json_t *jsep);
+void janus_loadtest_setup_media(janus_plugin_session *handle);
+void janus_loadtest_incoming_rtp(janus_plugin_session *handle, janus_plugin_rtp *packet);
+void janus_loadtest_incoming_rtcp(janus_plugin_session *handle, janus_plugin_rtcp *packet);
+void janus_loadtest_hangup_media(janus_plugin_session *handle);
+void janus_loadtest_destroy_session(janus_plugin_session *handle, int *error);
+json_t *janus_loadtest_query_session(janus_plugin_session *handle);
+
+/* Plugin setup */
+static janus_plugin janus_loadtest_plugin =
+	JANUS_PLUGIN_INIT (
+		.init = janus_loadtest_init,
+		.destroy = janus_loadtest_destroy,
+
+		.get_api_compatibility = janus_loadtest_get_api_compatibility,
+		.get_version = janus_loadtest_get_version,
+		.get_version_string = janus_loadtest_get_version_string,
+		.get_description = janus_loadtest_get_description,
+		.get_name = janus_loadtest_get_name,
+		.get_author = janus_loadtest_get_author,
+		.get_package = janus_loadtest_get_package,
+
+		.create_session = janus_loadtest_create_session,
+		.handle_message = janus_loadtest_handle_message,
+		.setup_media = janus_loadtest_setup_media,
+		.incoming_rtp = janus_loadtest_incoming_rtp,
+		.incoming_rtcp = janus_loadtest_incoming_rtcp,
+		.hangup_media = janus_loadtest_hangup_media,
+		.destroy_session = janus_loadtest_destroy_session,
+		.query_session = janus_loadtest_query_session,
+	);
+
+/* Plugin creator */
+janus_plugin *create(void) {
+	JANUS_LOG(LOG_VERB, "%s created!\n", JANUS_LOADTEST_NAME);
+	return &janus_loadtest_plugin;
+}
+
+/* Parameter validation */
+static struct janus_json_parameter request_parameters[] = {
+	{"request", JSON_STRING, JANUS_JSON_PARAM_REQUIRED},
+	{"audio", JANUS_JSON_BOOL, 0},
+	{"video", JANUS_JSON_BOOL, 0},
+	{"packet_size", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	{"video_pps", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	{"layers", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	{"loss", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE}
+};
+
+/* Useful stuff */
+static volatile gint initialized = 0, stopping = 0;
+static gboolean notify_events = TRUE;
+static janus_callbacks *gateway = NULL;
+static GThread *handler_thread;
+static void *janus_loadtest_handler(void *data);
+static void *janus_loadtest_generator(void *data);
+static void janus_loadtest_hangup_media_internal(janus_plugin_session *handle);
+
+typedef struct janus_loadtest_message {
+	janus_plugin_session *handle;
+	char *transaction;
+	json_t *message;
+	json_t *jsep;
+} janus_loadtest_message;
+static GAsyncQueue *messages = NULL;
+static janus_loadtest_message exit_message;
+
+typedef struct janus_loadtest_session {
+	janus_plugin_session *handle;
+	gboolean has_audio;
+	gboolean has_video;
+	gboolean audio;			/* Whether audio traffic should be generated */
+	gboolean video;			/* Whether video traffic should be generated */
+	volatile gint packet_size;	/* Size of the generated video payloads */
+	volatile gint video_pps;	/* Video packets to generate per second */
+	volatile gint layers;	/* Simulcast-like layers to emulate (multiplies the video packets) */
+	volatile gint loss;		/* Percentage of video packets to drop before relaying */
+	int audio_pt, video_pt;	/* Negotiated payload types to use in the generated packets */
+	guint64 packets, bytes;	/* Amount of traffic we generated on this session */
+	GThread *generator;		/* Generator thread, when the session is active */
+	volatile gint generating;
+	volatile gint media_ready;
+	volatile gint active;
+	volatile gint hangingup;
+	volatile gint destroyed;
+	janus_refcount ref;
+} janus_loadtest_session;
+static GHashTable *sessions;
+static janus_mutex sessions_mutex = JANUS_MUTEX_INITIALIZER;
+
+static void janus_loadtest_session_destroy(janus_loadtest_session *session) {
+	if(session && g_atomic_int_compare_and_exchange(&session->destroyed, 0, 1))
+		janus_refcount_decrease(&session->ref);
+}
+
+static void janus_loadtest_session_free(const janus_refcount *session_ref) {
+	janus_loadtest_session *session = janus_refcount_containerof(session_ref, janus_loadtest_session, ref);
+	/* Remove the reference to the core plugin session */
+	janus_refcount_decrease(&session->handle->ref);
+	/* This session can be destroyed, free all the resources */
+	g_free(session);
+}
+
+static void janus_loadtest_message_free(janus_loadtest_message *msg) {
+	if(!msg || msg == &exit_message)
+		return;
+
+	if(msg->handle && msg->handle->plugin_handle) {
+		janus_loadtest_session *session = (janus_loadtest_session *)msg->handle->plugin_handle;
+		janus_refcount_decrease(&session->ref);
+	}
+	msg->handle = NULL;
+
+	g_free(msg->transaction);
+	msg->transaction = NULL;
+	if(msg->message)
+		json_decref(msg->message);
+	msg->message = NULL;
+	if(msg->jsep)
+		json_decref(msg->jsep);
+	msg->jsep = NULL;
+
+	g_free(msg);
+}
+
+/* Helper to spawn the generator thread, if the session is active and
+ * the PeerConnection is ready (we may get here from either side) */
+static void janus_loadtest_start_generator(janus_loadtest_session *session) {
+	if(!g_atomic_int_get(&session->active) || !g_atomic_int_get(&session->media_ready))
+		return;
+	if(!g_atomic_int_compare_and_exchange(&session->generating, 0, 1))
+		return;
+	janus_refcount_increase(&session->ref);
+	GError *error = NULL;
+	session->generator = g_thread_try_new("loadtest generator", janus_loadtest_generator, session, &error);
+	if(error != NULL) {
+		g_atomic_int_set(&session->generating, 0);
+		janus_refcount_decrease(&session->ref);
+		JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the LoadTest generator thread...\n",
+			error->code, error->message ? error->message : "??");
+		g_error_free(error);
+	}
+}
+
+
+/* Error codes */
+#define JANUS_LOADTEST_ERROR_NO_MESSAGE			491
+#define JANUS_LOADTEST_ERROR_INVALID_JSON		492
+#define JANUS_LOADTEST_ERROR_INVALID_ELEMENT	493
+#define JANUS_LOADTEST_ERROR_INVALID_SDP		494
+#define JANUS_LOADTEST_ERROR_INVALID_REQUEST	495
+#define JANUS_LOADTEST_ERROR_MISSING_ELEMENT	496
+
+
+/* Plugin implementation */
+int janus_loadtest_init(janus_callbacks *callback, const char *config_path) {
+	if(g_atomic_int_get(&stopping)) {
+		/* Still stopping from before */
+		return -1;
+	}
+	if(callback == NULL || config_path == NULL) {
+		/* Invalid arguments */
+		return -1;
+	}
+
+	/* Read configuration */
+	char filename[255];
+	g_snprintf(filename, 255, "%s/%s.jcfg", config_path, JANUS_LOADTEST_PACKAGE);
+	JANUS_LOG(LOG_VERB, "Configuration file: %s\n", filename);
+	janus_config *config = janus_config_parse(filename);
+	if(config != NULL) {
+		janus_config_print(config);
+		janus_config_category *config_general = janus_config_get_create(config, NULL, janus_config_type_category, "general");
+		janus_config_item *events = janus_config_get(config, config_general, janus_config_type_item, "events");
+		if(events != NULL && events->value != NULL)
+			notify_events = janus_is_true(events->value);
+		if(!notify_events && callback->events_is_enabled()) {
+			JANUS_LOG(LOG_WARN, "Notification of events to handlers disabled for %s\n", JANUS_LOADTEST_NAME);
+		}
+	}
+	janus_config_destroy(config);
+	config = NULL;
+
+	sessions = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_loadtest_session_destroy);
+	messages = g_async_queue_new_full((GDestroyNotify) janus_loadtest_message_free);
+	/* This is the callback we'll need to invoke to contact the server */
+	gateway = callback;
+	g_atomic_int_set(&initialized, 1);
+
+	/* Launch the thread that will handle incoming messages */
+	GError *error = NULL;
+	handler_thread = g_thread_try_new("loadtest handler", janus_loadtest_handler, NULL, &error);
+	if(error != NULL) {
+		g_atomic_int_set(&initialized, 0);
+		JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the LoadTest handler thread...\n", error->code, error->message ? error->message : "??");
+		g_error_free(error);
+		return -1;
+	}
+	JANUS_LOG(LOG_INFO, "%s initialized!\n", JANUS_LOADTEST_NAME);
+	return 0;
+}
+
+void janus_loadtest_destroy(void) {
+	if(!g_atomic_int_get(&initialized))
+		return;
+	g_atomic_int_set(&stopping, 1);
+
+	g_async_queue_push(messages, &exit_message);
+	if(handler_thread != NULL) {
+		g_thread_join(handler_thread);
+		handler_thread = NULL;
+	}
+
+	/* FIXME We should destroy the sessions cleanly */
+	janus_mutex_lock(&sessions_mutex);
+	g_hash_table_destroy(sessions);
+	sessions = NULL;
+	janus_mutex_unlock(&sessions_mutex);
+	g_async_queue_unref(messages);
+	messages = NULL;
+
+	g_atomic_int_set(&initialized, 0);
+	g_atomic_int_set(&stopping, 0);
+	JANUS_LOG(LOG_INFO, "%s destroyed!\n", JANUS_LOADTEST_NAME);
+}
+
+int janus_loadtest_get_api_compatibility(void) {
+	/* Important! This is what your plugin MUST always return: don't lie here or bad things will happen */
+	return JANUS_PLUGIN_API_VERSION;
+}
+
+int janus_loadtest_get_version(void) {
+	return JANUS_LOADTEST_VERSION;
+}
+
+const char *janus_loadtest_get_version_string(void) {
+	return JANUS_LOADTEST_VERSION_STRING;
+}
+
+const char *janus_loadtest_get_description(void) {
+	return JANUS_LOADTEST_DESCRIPTION;
+}
+
+const char *janus_loadtest_get_name(void) {
+	return JANUS_LOADTEST_NAME;
+}
+
+const char *janus_loadtest_get_author(void) {
+	return JANUS_LOADTEST_AUTHOR;
+}
+
+const char *janus_loadtest_get_package(void) {
+	return JANUS_LOADTEST_PACKAGE;
+}
+
+static janus_loadtest_session *janus_loadtest_lookup_session(janus_plugin_session *handle) {
+	janus_loadtest_session *session = NULL;
+	if (g_hash_table_contains(sessions, handle)) {
+		session = (janus_loadtest_session *)handle->plugin_handle;
+	}
+	return session;
+}
+
+void janus_loadtest_create_session(janus_plugin_session *handle, int *error) {
+	if(g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized)) {
+		*error = -1;
+		return;
+	}
+	janus_loadtest_session *session = g_malloc0(sizeof(janus_loadtest_session));
+	session->handle = handle;
+	session->audio = TRUE;
+	session->video = TRUE;
+	g_atomic_int_set(&session->packet_size, 1200);
+	g_atomic_int_set(&session->video_pps, 90);
+	g_atomic_int_set(&session->layers, 1);
+	g_atomic_int_set(&session->loss, 0);
+	session->audio_pt = -1;
+	session->video_pt = -1;
+	g_atomic_int_set(&session->hangingup, 0);
+	g_atomic_int_set(&session->destroyed, 0);
+	janus_refcount_init(&session->ref, janus_loadtest_session_free);
+	handle->plugin_handle = session;
+	janus_mutex_lock(&sessions_mutex);
+	g_hash_table_insert(sessions, handle, session);
+	janus_mutex_unlock(&sessions_mutex);
+
+	return;
+}
+
+void janus_loadtest_destroy_session(janus_plugin_session *handle, int *error) {
+	if(g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized)) {
+		*error = -1;
+		return;
+	}
+	janus_mutex_lock(&sessions_mutex);
+	janus_loadtest_session *session = janus_loadtest_lookup_session(handle);
+	if(!session) {
+		janus_mutex_unlock(&sessions_mutex);
+		JANUS_LOG(LOG_ERR, "No session associated with this handle...\n");
+		*error = -2;
+		return;
+	}
+	JANUS_LOG(LOG_VERB, "Removing Load Test session...\n");
+	janus_loadtest_hangup_media_internal(handle);
+	g_hash_table_remove(sessions, handle);
+	janus_mutex_unlock(&sessions_mutex);
+	return;
+}
+
+json_t *janus_loadtest_query_session(janus_plugin_session *handle) {
+	if(g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized)) {
+		return NULL;
+	}
+	janus_mutex_lock(&sessions_mutex);
+	janus_loadtest_session *session = janus_loadtest_lookup_session(handle);
+	if(!session) {
+		janus_mutex_unlock(&sessions_mutex);
+		JANUS_LOG(LOG_ERR, "No session associated with this handle...\n");
+		return NULL;
+	}
+	janus_refcount_increase(&session->ref);
+	janus_mutex_unlock(&sessions_mutex);
+	/* Provide the generator settings and the traffic counters */
+	json_t *info = json_object();
+	json_object_set_new(info, "audio", session->audio ? json_true() : json_false());
+	json_object_set_new(info, "video", session->video ? json_true() : json_false());
+	json_object_set_new(info, "packet_size", json_integer(g_atomic_int_get(&session->packet_size)));
+	json_object_set_new(info, "video_pps", json_integer(g_atomic_int_get(&session->video_pps)));
+	json_object_set_new(info, "layers", json_integer(g_atomic_int_get(&session->layers)));
+	json_object_set_new(info, "loss", json_integer(g_atomic_int_get(&session->loss)));
+	json_object_set_new(info, "generating", g_atomic_int_get(&session->generating) ? json_true() : json_false());
+	json_object_set_new(info, "packets", json_integer(session->packets));
+	json_object_set_new(info, "bytes", json_integer(session->bytes));
+	json_object_set_new(info, "hangingup", json_integer(g_atomic_int_get(&session->hangingup)));
+	json_object_set_new(info, "destroyed", json_integer(g_atomic_int_get(&session->destroyed)));
+	janus_refcount_decrease(&session->ref);
+	return info;
+}
+
+struct janus_plugin_result *janus_loadtest_handle_message(janus_plugin_session *handle, char *transaction, json_t *message, json_t *jsep) {
+	if(g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized))
+		return janus_plugin_result_new(JANUS_PLUGIN_ERROR, g_atomic_int_get(&stopping) ? "Shutting down" : "Plugin not initialized", NULL);
+	janus_loadtest_session *session = (janus_loadtest_session *)handle->plugin_handle;
+	if(!session)
+		return janus_plugin_result_new(JANUS_PLUGIN_ERROR, "No session associated with this handle", NULL);
+	janus_loadtest_message *msg = g_malloc(sizeof(janus_loadtest_message));
+	/* Increase the reference counter for this session: we'll decrease it after we handle the message */
+	janus_refcount_increase(&session->ref);
+
+	msg->handle = handle;
+	msg->transaction = transaction;
+	msg->message = message;
+	msg->jsep = jsep;
+	g_async_queue_push(messages, msg);
+
+	/* All the requests to this plugin are handled asynchronously */
+	return janus_plugin_result_new(JANUS_PLUGIN_OK_WAIT, NULL, NULL);
+}
+
+void janus_loadtest_setup_media(janus_plugin_session *handle) {
+	JANUS_LOG(LOG_INFO, "[%s-%p] WebRTC media is now available\n", JANUS_LOADTEST_PACKAGE, handle);
+	if(g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized))
+		return;
+	janus_mutex_lock(&sessions_mutex);
+	janus_loadtest_session *session = janus_loadtest_lookup_session(handle);
+	if(!session) {
+		janus_mutex_unlock(&sessions_mutex);
+		JANUS_LOG(LOG_ERR, "No session associated with this handle...\n");
+		return;
+	}
+	if(g_atomic_int_get(&session->destroyed)) {
+		janus_mutex_unlock(&sessions_mutex);
+		return;
+	}
+	g_atomic_int_set(&session->hangingup, 0);
+	g_atomic_int_set(&session->media_ready, 1);
+	janus_mutex_unlock(&sessions_mutex);
+	/* If a start request already arrived, we can begin generating traffic */
+	janus_loadtest_start_generator(session);
+}
+
+void janus_loadtest_incoming_rtp(janus_plugin_session *handle, janus_plugin_rtp *packet) {
+	/* We're the ones generating traffic, just ignore anything we receive */
+}
+
+void janus_loadtest_incoming_rtcp(janus_plugin_session *handle, janus_plugin_rtcp *packet) {
+	/* The core takes care of the feedback the generated traffic will
+	 * cause (e.g., retransmissions), nothing to do here ourselves */
+}
+
+void janus_loadtest_hangup_media(janus_plugin_session *handle) {
+	JANUS_LOG(LOG_INFO, "[%s-%p] No WebRTC media anymore\n", JANUS_LOADTEST_PACKAGE, handle);
+	janus_mutex_lock(&sessions_mutex);
+	janus_loadtest_hangup_media_internal(handle);
+	janus_mutex_unlock(&sessions_mutex);
+}
+
+static void janus_loadtest_hangup_media_internal(janus_plugin_session *handle) {
+	if(g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized))
+		return;
+	janus_loadtest_session *session = janus_loadtest_lookup_session(handle);
+	if(!session) {
+		JANUS_LOG(LOG_ERR, "No session associated with this handle...\n");
+		return;
+	}
+	if(g_atomic_int_get(&session->destroyed))
+		return;
+	if(!g_atomic_int_compare_and_exchange(&session->hangingup, 0, 1))
+		return;
+	/* Stop the generator: the thread will detect this and leave */
+	g_atomic_int_set(&session->active, 0);
+	g_atomic_int_set(&session->media_ready, 0);
+	session->has_audio = FALSE;
+	session->has_video = FALSE;
+	session->audio_pt = -1;
+	session->video_pt = -1;
+	g_atomic_int_set(&session->hangingup, 0);
+}
+
+/* Thread that synthesizes the RTP traffic for a session */
+static void *janus_loadtest_generator(void *data) {
+	janus_loadtest_session *session = (janus_loadtest_session *)data;
+	JANUS_LOG(LOG_VERB, "[%s-%p] Starting load generator\n", JANUS_LOADTEST_PACKAGE, session->handle);
+	/* Craft the packet templates: the payloads are just dummy bytes, as
+	 * we only care about stressing the relay path, not decodability */
+	char abuf[200], vbuf[1500];
+	memset(abuf, 0xA0, sizeof(abuf));
+	memset(vbuf, 0xB0, sizeof(vbuf));
+	janus_rtp_header *artp = (janus_rtp_header *)abuf;
+	janus_rtp_header *vrtp = (janus_rtp_header *)vbuf;
+	memset(abuf, 0, 12);
+	memset(vbuf, 0, 12);
+	artp->version = 2;
+	artp->type = session->audio_pt > 0 ? session->audio_pt : 111;
+	artp->ssrc = htonl(janus_random_uint32());
+	vrtp->version = 2;
+	vrtp->markerbit = 1;
+	vrtp->type = session->video_pt > 0 ? session->video_pt : 96;
+	vrtp->ssrc = htonl(janus_random_uint32());
+	uint16_t aseq = 0, vseq = 0;
+	uint32_t ats = 0, vts = 0;
+	guint64 packets = 0, bytes = 0;
+	gint64 now = janus_get_monotonic_time(), before = now;
+	/* We generate the traffic in 20ms ticks */
+	while(g_atomic_int_get(&session->active) && !g_atomic_int_get(&session->destroyed) &&
+			!g_atomic_int_get(&stopping)) {
+		/* Sleep until the next tick */
+		now = janus_get_monotonic_time();
+		if(now - before < G_USEC_PER_SEC/50) {
+			g_usleep(G_USEC_PER_SEC/50 - (now - before));
+			now = janus_get_monotonic_time();
+		}
+		before += G_USEC_PER_SEC/50;
+		if(session->audio) {
+			/* One audio packet per tick (as Opus would do) */
+			aseq++;
+			ats += 960;
+			artp->seq_number = htons(aseq);
+			artp->timestamp = htonl(ats);
+			janus_plugin_rtp packet = { .mindex = -1, .video = FALSE, .buffer = abuf, .length = 12+160 };
+			janus_plugin_rtp_extensions_reset(&packet.extensions);
+			gateway->relay_rtp(session->handle, &packet);
+			packets++;
+			bytes += 160;
+		}
+		if(session->video) {
+			/* Spread the requested packet rate across the ticks, and
+			 * multiply it by the number of layers we're emulating */
+			int pps = g_atomic_int_get(&session->video_pps) * g_atomic_int_get(&session->layers),
+				size = g_atomic_int_get(&session->packet_size),
+				loss = g_atomic_int_get(&session->loss),
+				tosend = pps/50, i = 0;
+			if(size > (int)sizeof(vbuf)-12)
+				size = (int)sizeof(vbuf)-12;
+			if(tosend < 1)
+				tosend = 1;
+			vts += 90000/50;
+			vrtp->timestamp = htonl(vts);
+			for(i=0; i<tosend; i++) {
+				/* Lost packets still consume a sequence number, so that
+				 * the receiver sees a real gap and NACKs it */
+				vseq++;
+				if(loss > 0 && (int)(janus_random_uint32() % 100) < loss)
+					continue;
+				vrtp->seq_number = htons(vseq);
+				janus_plugin_rtp packet = { .mindex = -1, .video = TRUE, .buffer = vbuf, .length = 12+size };
+				janus_plugin_rtp_extensions_reset(&packet.extensions);
+				gateway->relay_rtp(session->handle, &packet);
+				packets++;
+				bytes += size;
+			}
+		}
+	}
+	session->packets += packets;
+	session->bytes += bytes;
+	g_atomic_int_set(&session->generating, 0);
+	/* Notify the user we're done, with a summary of the generated traffic */
+	json_t *event = json_object();
+	json_object_set_new(event, "loadtest", json_string("event"));
+	json_object_set_new(event, "result", json_string("stopped"));
+	json_object_set_new(event, "packets", json_integer(packets));
+	json_object_set_new(event, "bytes", json_integer(bytes));
+	gateway->push_event(session->handle, &janus_loadtest_plugin, NULL, event, NULL);
+	json_decref(event);
+	JANUS_LOG(LOG_VERB, "[%s-%p] Leaving load generator (%"SCNu64" packets, %"SCNu64" bytes)\n",
+		JANUS_LOADTEST_PACKAGE, session->handle, packets, bytes);
+	session->generator = NULL;
+	janus_refcount_decrease(&session->ref);
+	g_thread_unref(g_thread_self());
+	return NULL;
+}
+
+/* Thread to handle incoming messages */
+static void *janus_loadtest_handler(void *data) {
+	JANUS_LOG(LOG_VERB, "Joining LoadTest handler thread\n");
+	janus_loadtest_message *msg = NULL;
+	int error_code = 0;
+	char error_cause[512];
+	json_t *root = NULL;
+	while(g_atomic_int_get(&initialized) && !g_atomic_int_get(&stopping)) {
+		msg = g_async_queue_pop(messages);
+		if(msg == &exit_message)
+			break;
+		if(msg->handle == NULL) {
+			janus_loadtest_message_free(msg);
+			continue;
+		}
+		janus_mutex_lock(&sessions_mutex);
+		janus_loadtest_session *session = janus_loadtest_lookup_session(msg->handle);
+		if(!session) {
+			janus_mutex_unlock(&sessions_mutex);
+			JANUS_LOG(LOG_ERR, "No session associated with this handle...\n");
+			janus_loadtest_message_free(msg);
+			continue;
+		}
+		if(g_atomic_int_get(&session->destroyed)) {
+			janus_mutex_unlock(&sessions_mutex);
+			janus_loadtest_message_free(msg);
+			continue;
+		}
+		janus_mutex_unlock(&sessions_mutex);
+		/* Handle request */
+		error_code = 0;
+		root = msg->message;
+		if(msg->message == NULL) {
+			JANUS_LOG(LOG_ERR, "No message??\n");
+			error_code = JANUS_LOADTEST_ERROR_NO_MESSAGE;
+			g_snprintf(error_cause, 512, "%s", "No message??");
+			goto error;
+		}
+		if(!json_is_object(root)) {
+			JANUS_LOG(LOG_ERR, "JSON error: not an object\n");
+			error_code = JANUS_LOADTEST_ERROR_INVALID_JSON;
+			g_snprintf(error_cause, 512, "JSON error: not an object");
+			goto error;
+		}
+		/* Parse request */
+		JANUS_VALIDATE_JSON_OBJECT(root, request_parameters,
+			error_code, error_cause, TRUE,
+			JANUS_LOADTEST_ERROR_MISSING_ELEMENT, JANUS_LOADTEST_ERROR_INVALID_ELEMENT);
+		if(error_code != 0)
+			goto error;
+		const char *request_text = json_string_value(json_object_get(root, "request"));
+		if(strcasecmp(request_text, "start") && strcasecmp(request_text, "configure") &&
+				strcasecmp(request_text, "stop")) {
+			JANUS_LOG(LOG_ERR, "Unknown request (%s)\n", request_text);
+			error_code = JANUS_LOADTEST_ERROR_INVALID_REQUEST;
+			g_snprintf(error_cause, 512, "Unknown request (%s)", request_text);
+			goto error;
+		}
+		/* Enforce the generator properties, if provided */
+		json_t *audio = json_object_get(root, "audio");
+		json_t *video = json_object_get(root, "video");
+		json_t *packet_size = json_object_get(root, "packet_size");
+		json_t *video_pps = json_object_get(root, "video_pps");
+		json_t *layers = json_object_get(root, "layers");
+		json_t *loss = json_object_get(root, "loss");
+		if(layers && (json_integer_value(layers) < 1 || json_integer_value(layers) > 3)) {
+			JANUS_LOG(LOG_ERR, "Invalid element (layers should be 1, 2 or 3)\n");
+			error_code = JANUS_LOADTEST_ERROR_INVALID_ELEMENT;
+			g_snprintf(error_cause, 512, "Invalid value (layers should be 1, 2 or 3)");
+			goto error;
+		}
+		if(loss && json_integer_value(loss) > 100) {
+			JANUS_LOG(LOG_ERR, "Invalid element (loss should be 0-100)\n");
+			error_code = JANUS_LOADTEST_ERROR_INVALID_ELEMENT;
+			g_snprintf(error_cause, 512, "Invalid value (loss should be 0-100)");
+			goto error;
+		}
+		if(packet_size && json_integer_value(packet_size) > 1450) {
+			JANUS_LOG(LOG_ERR, "Invalid element (packet_size can't exceed 1450)\n");
+			error_code = JANUS_LOADTEST_ERROR_INVALID_ELEMENT;
+			g_snprintf(error_cause, 512, "Invalid value (packet_size can't exceed 1450)");
+			goto error;
+		}
+		if(audio)
+			session->audio = json_is_true(audio);
+		if(video)
+			session->video = json_is_true(video);
+		if(packet_size)
+			g_atomic_int_set(&session->packet_size, json_integer_value(packet_size));
+		if(video_pps)
+			g_atomic_int_set(&session->video_pps, json_integer_value(video_pps));
+		if(layers)
+			g_atomic_int_set(&session->layers, json_integer_value(layers));
+		if(loss)
+			g_atomic_int_set(&session->loss, json_integer_value(loss));
+
+		const char *msg_sdp_type = json_string_value(json_object_get(msg->jsep, "type"));
+		const char *msg_sdp = json_string_value(json_object_get(msg->jsep, "sdp"));
+
+		/* Prepare JSON event */
+		json_t *event = json_object();
+		json_object_set_new(event, "loadtest", json_string("event"));
+		json_object_set_new(event, "result", json_string("ok"));
+		if(!msg_sdp) {
+			int ret = gateway->push_event(msg->handle, &janus_loadtest_plugin, msg->transaction, event, NULL);
+			JANUS_LOG(LOG_VERB, "  >> %d (%s)\n", ret, janus_get_api_error(ret));
+			json_decref(event);
+		} else {
+			/* Answer the offer and pass it to the core, to set the PeerConnection up */
+			JANUS_LOG(LOG_VERB, "This is involving a negotiation (%s) as well:\n%s\n", msg_sdp_type, msg_sdp);
+			char error_str[512];
+			janus_sdp *offer = janus_sdp_parse(msg_sdp, error_str, sizeof(error_str));
+			if(offer == NULL) {
+				json_decref(event);
+				JANUS_LOG(LOG_ERR, "Error parsing offer: %s\n", error_str);
+				error_code = JANUS_LOADTEST_ERROR_INVALID_SDP;
+				g_snprintf(error_cause, 512, "Error parsing offer: %s", error_str);
+				goto error;
+			}
+			janus_sdp *answer = janus_sdp_generate_answer(offer);
+			GList *temp = offer->m_lines;
+			while(temp) {
+				janus_sdp_mline *m = (janus_sdp_mline *)temp->data;
+				janus_sdp_generate_answer_mline(offer, answer, m,
+					JANUS_SDP_OA_MLINE, m->type,
+					JANUS_SDP_OA_ACCEPT_EXTMAP, JANUS_RTP_EXTMAP_MID,
+					JANUS_SDP_OA_DONE);
+				temp = temp->next;
+			}
+			/* Check which codecs we ended up with, to craft coherent packets */
+			const char *acodec = NULL, *vcodec = NULL;
+			janus_sdp_find_first_codec(answer, JANUS_SDP_AUDIO, -1, &acodec);
+			if(acodec)
+				session->audio_pt = janus_sdp_get_codec_pt(answer, -1, acodec);
+			janus_sdp_find_first_codec(answer, JANUS_SDP_VIDEO, -1, &vcodec);
+			if(vcodec)
+				session->video_pt = janus_sdp_get_codec_pt(answer, -1, vcodec);
+			session->has_audio = (session->audio_pt > 0);
+			session->has_video = (session->video_pt > 0);
+			/* Done */
+			char *sdp = janus_sdp_write(answer);
+			janus_sdp_destroy(offer);
+			janus_sdp_destroy(answer);
+			json_t *jsep = json_pack("{ssss}", "type", "answer", "sdp", sdp);
+			g_atomic_int_set(&session->hangingup, 0);
+			int res = gateway->push_event(msg->handle, &janus_loadtest_plugin, msg->transaction, event, jsep);
+			JANUS_LOG(LOG_VERB, "  >> Pushing event: %d (%s)\n", res, janus_get_api_error(res));
+			g_free(sdp);
+			/* We don't need the event and jsep anymore */
+			json_decref(event);
+			json_decref(jsep);
+		}
+		/* Start or stop the generator, if needed */
+		if(!strcasecmp(request_text, "start")) {
+			g_atomic_int_set(&session->active, 1);
+			janus_loadtest_start_generator(session);
+		} else if(!strcasecmp(request_text, "stop")) {
+			g_atomic_int_set(&session->active, 0);
+		}
+		janus_loadtest_message_free(msg);
+
+		if(notify_events && gateway->events_is_enabled()) {
+			/* Update event handlers on the generator configuration */
+			json_t *info = json_object();
+			json_object_set_new(info, "audio", session->audio ? json_true() : json_false());
+			json_object_set_new(info, "video", session->video ? json_true() : json_false());
+			json_object_set_new(info, "packet_size", json_integer(g_atomic_int_get(&session->packet_size)));
+			json_object_set_new(info, "video_pps", json_integer(g_atomic_int_get(&session->video_pps)));
+			json_object_set_new(info, "layers", json_integer(g_atomic_int_get(&session->layers)));
+			json_object_set_new(info, "loss", json_integer(g_atomic_int_get(&session->loss)));
+			json_object_set_new(info, "generating", g_atomic_int_get(&session->generating) ? json_true() : json_false());
+			gateway->notify_event(&janus_loadtest_plugin, session->handle, info);
+		}
+
+		/* Done, on to the next request */
+		continue;
+
+error:
+		{
+			/* Prepare JSON error event */
+			json_t *event = json_object();
+			json_object_set_new(event, "loadtest", json_string("event"));
+			json_object_set_new(event, "error_code", json_integer(error_code));
+			json_object_set_new(event, "error", json_string(error_cause));
+			int ret = gateway->push_event(msg->handle, &janus_loadtest_plugin, msg->transaction, event, NULL);
+			JANUS_LOG(LOG_VERB, "  >> %d (%s)\n", ret, janus_get_api_error(ret));
+			janus_loadtest_message_free(msg);
+			/* We don't need the event anymore */
+			json_decref(event);
+		}
+	}
+	JANUS_LOG(LOG_VERB, "Leaving LoadTest handler thread\n");
+	return NULL;
+}
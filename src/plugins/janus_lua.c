@@ -76,6 +76,24 @@
  * \c temporalLayerChanged() callbacks: this may be useful to track
  * which layer is actually being sent, vs. what was requested.
  *
+ * \note One of the reasons why handling RTP and RTCP packets in the script
+ * is discouraged is that a single Lua state serves all sessions, meaning
+ * every packet of every user contends for the same interpreter lock. If
+ * you do need \c incomingRtp() and/or \c incomingRtcp(), you can mitigate
+ * this by setting the \c rtp_state_pool property in the configuration
+ * file: when set to a value higher than 0, the script is loaded in that
+ * many additional Lua states too, and each session is pinned to one of
+ * them (by session identifier) for its RTP/RTCP callbacks, so that media
+ * from different sessions can be processed in parallel. All other
+ * callbacks (messages, data channels, etc.) keep running on the main
+ * state. Be aware that globals are NOT shared across states: each pool
+ * state loads the script on its own, but \c init() is only invoked on the
+ * main state; scripts can check the \c statePoolIndex global (0 on the
+ * main state, 1 and above on pool workers; \c statePoolSize returns the
+ * pool size) to detect where they're being loaded, and can use the
+ * \c sharedSet() and \c sharedGet() functions to exchange string values
+ * across states when needed.
+ *
  * \section capi C interfaces
  *
  * Just as the Lua script needs to expose callbacks that the C code can
@@ -102,7 +120,9 @@
  * - \c startRecording(): start recording audio, video and or data for a user;
  * - \c stopRecording(): start recording audio, video and or data for a user;
  * - \c pokeScheduler(): notify the C code that there's a coroutine to resume;
- * - \c timeCallback(): trigger the execution of a Lua function after X milliseconds.
+ * - \c timeCallback(): trigger the execution of a Lua function after X milliseconds;
+ * - \c sharedSet(): store a string value in the key-value store shared across Lua states;
+ * - \c sharedGet(): read a string value from the key-value store shared across Lua states.
  *
  * As anticipated in the previous section, almost all these methods also
  * expect the unique session identifier to address a specific user in the
@@ -272,6 +292,22 @@ janus_callbacks *lua_janus_core = NULL;
 /* Lua stuff */
 lua_State *lua_state = NULL;
 janus_mutex lua_mutex = JANUS_MUTEX_INITIALIZER;
+/* When the script handles media directly (incomingRtp() and friends),
+ * every packet of every session is serialized on the single interpreter
+ * lock above: to scale beyond one core, the script can optionally be
+ * loaded in a small pool of additional Lua states too, with each session
+ * pinned to one of them for its media callbacks. Pool states run the
+ * same script but their globals are private: scripts can detect they're
+ * being loaded as a pool worker via the statePoolIndex global (0 in the
+ * main state), and can share data across states with the sharedSet()
+ * and sharedGet() primitives */
+#define JANUS_LUA_MAX_POOL_SIZE	32
+static int lua_pool_size = 0;
+static lua_State *lua_pool[JANUS_LUA_MAX_POOL_SIZE];
+static janus_mutex lua_pool_mutex[JANUS_LUA_MAX_POOL_SIZE];
+/* Cross-state key-value store, and the mutex to protect it */
+static GHashTable *lua_shared = NULL;
+static janus_mutex lua_shared_mutex = JANUS_MUTEX_INITIALIZER;
 static const char *lua_functions[] = {
 	"init", "destroy", "resumeScheduler",
 	"createSession", "destroySession", "querySession",
@@ -435,6 +471,63 @@ static int janus_lua_method_januslog(lua_State *s) {
 	return 0;
 }
 
+static int janus_lua_method_sharedset(lua_State *s) {
+	/* This method allows the Lua script to store a string in a key-value
+	 * store that is shared across all the Lua states of the pool */
+	int n = lua_gettop(s);
+	if(n != 2) {
+		JANUS_LOG(LOG_ERR, "Wrong number of arguments: %d (expected 2)\n", n);
+		lua_pushnumber(s, -1);
+		return 1;
+	}
+	const char *key = lua_tostring(s, 1);
+	if(key == NULL) {
+		JANUS_LOG(LOG_ERR, "Invalid argument (missing key)\n");
+		lua_pushnumber(s, -1);
+		return 1;
+	}
+	const char *value = lua_tostring(s, 2);
+	janus_mutex_lock(&lua_shared_mutex);
+	if(lua_shared == NULL)
+		lua_shared = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, (GDestroyNotify)g_free);
+	if(value == NULL) {
+		/* A nil value removes the key */
+		g_hash_table_remove(lua_shared, key);
+	} else {
+		g_hash_table_insert(lua_shared, g_strdup(key), g_strdup(value));
+	}
+	janus_mutex_unlock(&lua_shared_mutex);
+	lua_pushnumber(s, 0);
+	return 1;
+}
+
+static int janus_lua_method_sharedget(lua_State *s) {
+	/* This method allows the Lua script to read a string from the key-value
+	 * store that is shared across all the Lua states of the pool */
+	int n = lua_gettop(s);
+	if(n != 1) {
+		JANUS_LOG(LOG_ERR, "Wrong number of arguments: %d (expected 1)\n", n);
+		lua_pushnumber(s, -1);
+		return 1;
+	}
+	const char *key = lua_tostring(s, 1);
+	if(key == NULL) {
+		JANUS_LOG(LOG_ERR, "Invalid argument (missing key)\n");
+		lua_pushnumber(s, -1);
+		return 1;
+	}
+	janus_mutex_lock(&lua_shared_mutex);
+	char *value = lua_shared ? g_strdup(g_hash_table_lookup(lua_shared, key)) : NULL;
+	janus_mutex_unlock(&lua_shared_mutex);
+	if(value == NULL) {
+		lua_pushnil(s);
+	} else {
+		lua_pushstring(s, value);
+		g_free(value);
+	}
+	return 1;
+}
+
 static int janus_lua_method_pokescheduler(lua_State *s) {
 	/* This method allows the Lua script to poke the scheduler and have it wake up ASAP */
 	g_async_queue_push(events, GUINT_TO_POINTER(janus_lua_event_resume));
@@ -1319,6 +1412,38 @@ static int janus_lua_method_stoprecording(lua_State *s) {
 }
 
 
+/* Helper to register all the methods we expose in a Lua state: we use it
+ * for the main state and, when a pool is configured, for each pool state too */
+static void janus_lua_register_methods(lua_State *state) {
+	lua_register(state, "janusLog", janus_lua_method_januslog);
+	lua_register(state, "sharedSet", janus_lua_method_sharedset);
+	lua_register(state, "sharedGet", janus_lua_method_sharedget);
+	lua_register(state, "pokeScheduler", janus_lua_method_pokescheduler);
+	lua_register(state, "timeCallback", janus_lua_method_timecallback);
+	lua_register(state, "pushEvent", janus_lua_method_pushevent);
+	lua_register(state, "notifyEvent", janus_lua_method_notifyevent);
+	lua_register(state, "eventsIsEnabled", janus_lua_method_eventsisenabled);
+	lua_register(state, "closePc", janus_lua_method_closepc);
+	lua_register(state, "endSession", janus_lua_method_endsession);
+	lua_register(state, "configureMedium", janus_lua_method_configuremedium);
+	lua_register(state, "addRecipient", janus_lua_method_addrecipient);
+	lua_register(state, "removeRecipient", janus_lua_method_removerecipient);
+	lua_register(state, "setBitrate", janus_lua_method_setbitrate);
+	lua_register(state, "setPliFreq", janus_lua_method_setplifreq);
+	lua_register(state, "setSubstream", janus_lua_method_setsubstream);
+	lua_register(state, "setTemporalLayer", janus_lua_method_settemporallayer);
+	lua_register(state, "sendPli", janus_lua_method_sendpli);
+	lua_register(state, "relayRtp", janus_lua_method_relayrtp);
+	lua_register(state, "relayRtcp", janus_lua_method_relayrtcp);
+	lua_register(state, "relayData", janus_lua_method_relaydata);	/* Legacy function, deprecated */
+	lua_register(state, "relayTextData", janus_lua_method_relaytextdata);
+	lua_register(state, "relayBinaryData", janus_lua_method_relaybinarydata);
+	lua_register(state, "startRecording", janus_lua_method_startrecording);
+	lua_register(state, "stopRecording", janus_lua_method_stoprecording);
+	/* Register all extra functions, if any were added */
+	janus_lua_register_extra_functions(state);
+}
+
 /* Plugin implementation */
 int janus_lua_init(janus_callbacks *callback, const char *config_path) {
 	if(g_atomic_int_get(&lua_stopping)) {
@@ -1364,6 +1489,15 @@ int janus_lua_init(janus_callbacks *callback, const char *config_path) {
 	janus_config_item *conf = janus_config_get(config, config_general, janus_config_type_item, "config");
 	if(conf && conf->value)
 		lua_config = g_strdup(conf->value);
+	int pool_size = 0;
+	janus_config_item *pool = janus_config_get(config, config_general, janus_config_type_item, "rtp_state_pool");
+	if(pool && pool->value) {
+		pool_size = atoi(pool->value);
+		if(pool_size < 0 || pool_size > JANUS_LUA_MAX_POOL_SIZE) {
+			JANUS_LOG(LOG_WARN, "Invalid rtp_state_pool value (%s), ignoring...\n", pool->value);
+			pool_size = 0;
+		}
+	}
 	janus_config_destroy(config);
 
 	/* Initialize Lua */
@@ -1385,31 +1519,12 @@ int janus_lua_init(janus_callbacks *callback, const char *config_path) {
 	}
 
 	/* Register our functions */
-	lua_register(lua_state, "janusLog", janus_lua_method_januslog);
-	lua_register(lua_state, "pokeScheduler", janus_lua_method_pokescheduler);
-	lua_register(lua_state, "timeCallback", janus_lua_method_timecallback);
-	lua_register(lua_state, "pushEvent", janus_lua_method_pushevent);
-	lua_register(lua_state, "notifyEvent", janus_lua_method_notifyevent);
-	lua_register(lua_state, "eventsIsEnabled", janus_lua_method_eventsisenabled);
-	lua_register(lua_state, "closePc", janus_lua_method_closepc);
-	lua_register(lua_state, "endSession", janus_lua_method_endsession);
-	lua_register(lua_state, "configureMedium", janus_lua_method_configuremedium);
-	lua_register(lua_state, "addRecipient", janus_lua_method_addrecipient);
-	lua_register(lua_state, "removeRecipient", janus_lua_method_removerecipient);
-	lua_register(lua_state, "setBitrate", janus_lua_method_setbitrate);
-	lua_register(lua_state, "setPliFreq", janus_lua_method_setplifreq);
-	lua_register(lua_state, "setSubstream", janus_lua_method_setsubstream);
-	lua_register(lua_state, "setTemporalLayer", janus_lua_method_settemporallayer);
-	lua_register(lua_state, "sendPli", janus_lua_method_sendpli);
-	lua_register(lua_state, "relayRtp", janus_lua_method_relayrtp);
-	lua_register(lua_state, "relayRtcp", janus_lua_method_relayrtcp);
-	lua_register(lua_state, "relayData", janus_lua_method_relaydata);	/* Legacy function, deprecated */
-	lua_register(lua_state, "relayTextData", janus_lua_method_relaytextdata);
-	lua_register(lua_state, "relayBinaryData", janus_lua_method_relaybinarydata);
-	lua_register(lua_state, "startRecording", janus_lua_method_startrecording);
-	lua_register(lua_state, "stopRecording", janus_lua_method_stoprecording);
-	/* Register all extra functions, if any were added */
-	janus_lua_register_extra_functions(lua_state);
+	janus_lua_register_methods(lua_state);
+	/* Tell the script about the state pool: the main state is index 0 */
+	lua_pushnumber(lua_state, 0);
+	lua_setglobal(lua_state, "statePoolIndex");
+	lua_pushnumber(lua_state, pool_size);
+	lua_setglobal(lua_state, "statePoolSize");
 
 	/* Now load the script */
 	int err = luaL_dofile(lua_state, lua_file);
@@ -1487,6 +1602,60 @@ int janus_lua_init(janus_callbacks *callback, const char *config_path) {
 	if(lua_isfunction(lua_state, lua_gettop(lua_state)) != 0)
 		has_temporal_changed = TRUE;
 
+	/* If a pool of Lua states was configured and the script does handle media
+	 * directly, load the script in each of those additional states too: each
+	 * session will then be pinned to one of the states for its RTP and RTCP
+	 * callbacks, so that media processing can actually happen in parallel,
+	 * while everything else (signalling, data) stays on the main state */
+	if(pool_size > 0 && !has_incoming_rtp && !has_incoming_rtcp) {
+		JANUS_LOG(LOG_WARN, "A state pool was configured (rtp_state_pool) but the script doesn't handle RTP/RTCP, ignoring...\n");
+		pool_size = 0;
+		lua_pushnumber(lua_state, 0);
+		lua_setglobal(lua_state, "statePoolSize");
+	}
+	int p = 0;
+	for(p=0; p<pool_size; p++) {
+		lua_State *pls = luaL_newstate();
+		luaL_openlibs(pls);
+		if(lua_folder != NULL) {
+			/* Add the script folder to the path of this state too */
+			lua_getglobal(pls, "package");
+			lua_getfield(pls, -1, "path");
+			const char *cur_path = lua_tostring(pls, -1);
+			char new_path[1024];
+			memset(new_path, 0, sizeof(new_path));
+			g_snprintf(new_path, sizeof(new_path), "%s;%s/?.lua", cur_path, lua_folder);
+			lua_pop(pls, 1);
+			lua_pushstring(pls, new_path);
+			lua_setfield(pls, -2, "path");
+			lua_pop(pls, 1);
+		}
+		janus_lua_register_methods(pls);
+		/* Let the script know it's being loaded as a pool worker (index 1..N) */
+		lua_pushnumber(pls, p+1);
+		lua_setglobal(pls, "statePoolIndex");
+		lua_pushnumber(pls, pool_size);
+		lua_setglobal(pls, "statePoolSize");
+		if(luaL_dofile(pls, lua_file)) {
+			JANUS_LOG(LOG_ERR, "Error loading Lua script %s in pool state %d: %s\n", lua_file, p+1, lua_tostring(pls, -1));
+			lua_close(pls);
+			while(--p >= 0) {
+				lua_close(lua_pool[p]);
+				lua_pool[p] = NULL;
+			}
+			lua_close(lua_state);
+			g_free(lua_folder);
+			g_free(lua_file);
+			g_free(lua_config);
+			return -1;
+		}
+		lua_pool[p] = pls;
+		janus_mutex_init(&lua_pool_mutex[p]);
+	}
+	lua_pool_size = pool_size;
+	if(lua_pool_size > 0)
+		JANUS_LOG(LOG_INFO, "Loaded the Lua script in a pool of %d additional states for RTP/RTCP handling\n", lua_pool_size);
+
 	lua_sessions = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_lua_session_destroy);
 	lua_ids = g_hash_table_new(NULL, NULL);
 	events = g_async_queue_new();
@@ -1590,6 +1759,22 @@ void janus_lua_destroy(void) {
 	lua_close(lua_state);
 	lua_state = NULL;
 	janus_mutex_unlock(&lua_mutex);
+	/* Get rid of the state pool too, if we created one: we don't invoke the
+	 * script destroy() callback there, as workers never had init() invoked */
+	int p = 0;
+	for(p=0; p<lua_pool_size; p++) {
+		janus_mutex_lock(&lua_pool_mutex[p]);
+		lua_close(lua_pool[p]);
+		lua_pool[p] = NULL;
+		janus_mutex_unlock(&lua_pool_mutex[p]);
+	}
+	lua_pool_size = 0;
+	janus_mutex_lock(&lua_shared_mutex);
+	if(lua_shared != NULL) {
+		g_hash_table_destroy(lua_shared);
+		lua_shared = NULL;
+	}
+	janus_mutex_unlock(&lua_shared_mutex);
 
 	g_free(lua_script_version_string);
 	g_free(lua_script_description);
@@ -2051,6 +2236,20 @@ void janus_lua_setup_media(janus_plugin_session *handle) {
 	janus_refcount_decrease(&session->ref);
 }
 
+/* Helper to get the Lua state a session's media callbacks should run on, and
+ * the mutex protecting it: when the state pool is enabled, each session is
+ * pinned to one of the pool states by its ID, so that different sessions can
+ * be served in parallel; otherwise, we just fall back to the main state */
+static lua_State *janus_lua_media_state(janus_lua_session *session, janus_mutex **mutex) {
+	if(lua_pool_size > 0) {
+		int index = session->id % lua_pool_size;
+		*mutex = &lua_pool_mutex[index];
+		return lua_pool[index];
+	}
+	*mutex = &lua_mutex;
+	return lua_state;
+}
+
 void janus_lua_incoming_rtp(janus_plugin_session *handle, janus_plugin_rtp *rtp_packet) {
 	if(handle == NULL || handle->stopped || g_atomic_int_get(&lua_stopping) || !g_atomic_int_get(&lua_initialized))
 		return;
@@ -2067,16 +2266,18 @@ void janus_lua_incoming_rtp(janus_plugin_session *handle, janus_plugin_rtp *rtp_
 	/* Check if the Lua script wants to handle/manipulate RTP packets itself */
 	if(has_incoming_rtp) {
 		/* Yep, pass the data to the Lua script and return */
-		janus_mutex_lock(&lua_mutex);
-		lua_State *t = lua_newthread(lua_state);
+		janus_mutex *state_mutex = NULL;
+		lua_State *state = janus_lua_media_state(session, &state_mutex);
+		janus_mutex_lock(state_mutex);
+		lua_State *t = lua_newthread(state);
 		lua_getglobal(t, "incomingRtp");
 		lua_pushnumber(t, session->id);
 		lua_pushboolean(t, video);
 		lua_pushlstring(t, buf, len);
 		lua_pushnumber(t, len);
 		lua_call(t, 4, 0);
-		lua_pop(lua_state, 1);
-		janus_mutex_unlock(&lua_mutex);
+		lua_pop(state, 1);
+		janus_mutex_unlock(state_mutex);
 		return;
 	}
 	/* Is this session allowed to send media? */
@@ -2180,16 +2381,18 @@ void janus_lua_incoming_rtcp(janus_plugin_session *handle, janus_plugin_rtcp *pa
 	/* Check if the Lua script wants to handle/manipulate RTCP packets itself */
 	if(has_incoming_rtcp) {
 		/* Yep, pass the data to the Lua script and return */
-		janus_mutex_lock(&lua_mutex);
-		lua_State *t = lua_newthread(lua_state);
+		janus_mutex *state_mutex = NULL;
+		lua_State *state = janus_lua_media_state(session, &state_mutex);
+		janus_mutex_lock(state_mutex);
+		lua_State *t = lua_newthread(state);
 		lua_getglobal(t, "incomingRtcp");
 		lua_pushnumber(t, session->id);
 		lua_pushboolean(t, video);
 		lua_pushlstring(t, buf, len);
 		lua_pushnumber(t, len);
 		lua_call(t, 4, 0);
-		lua_pop(lua_state, 1);
-		janus_mutex_unlock(&lua_mutex);
+		lua_pop(state, 1);
+		janus_mutex_unlock(state_mutex);
 		return;
 	}
 	/* If a REMB arrived, make sure we cap it to our configuration, and send it as a video RTCP */
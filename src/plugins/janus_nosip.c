@@ -156,6 +156,9 @@
 #include <sys/socket.h>
 #include <netdb.h>
 #include <poll.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 
 #include <jansson.h>
 
@@ -321,6 +324,7 @@ typedef struct janus_nosip_media {
 	janus_rtp_switching_context acontext, vcontext;
 	int pipefd[2];
 	gboolean updated;
+	int pollerrs;
 	int video_orientation_extension_id;
 	int audio_level_extension_id;
 } janus_nosip_media;
@@ -336,6 +340,8 @@ typedef struct janus_nosip_session {
 	janus_recorder *vrc_peer;	/* The Janus recorder instance for the peer's video, if enabled */
 	janus_mutex rec_mutex;		/* Mutex to protect the recorders from race conditions */
 	GThread *relayer_thread;
+	void *relay_shard;			/* Shard of the shared relay engine serving this session, if any */
+	GSList *relay_fds;			/* File descriptors we registered on the shard */
 	volatile gint hangingup;
 	volatile gint destroyed;
 	janus_refcount ref;
@@ -344,6 +350,31 @@ typedef struct janus_nosip_session {
 static GHashTable *sessions;
 static janus_mutex sessions_mutex = JANUS_MUTEX_INITIALIZER;
 
+#ifdef __linux__
+/* Shared relay engine: when relay_threads is set in the configuration,
+ * sessions are multiplexed on a small number of epoll() loops (shards),
+ * instead of each spawning a dedicated relay thread blocking in poll():
+ * with thousands of gatewaying sessions on a node this saves a lot of
+ * stacks and context switches */
+typedef struct janus_nosip_relay_shard {
+	int id;				/* Shard number */
+	int epollfd;		/* epoll file descriptor the shard blocks on */
+	GThread *thread;	/* Thread running the epoll loop */
+	GList *sessions;	/* Sessions currently served by this shard */
+	janus_mutex mutex;	/* Mutex to lock this structure */
+} janus_nosip_relay_shard;
+/* Small helper struct we attach to each file descriptor we register */
+typedef struct janus_nosip_relay_fd {
+	int fd;
+	janus_nosip_session *session;
+} janus_nosip_relay_fd;
+static janus_nosip_relay_shard *relay_shards = NULL;
+static int relay_shards_num = 0;
+static volatile gint relay_shards_rr = 0;
+static void *janus_nosip_relay_shard_thread(void *data);
+#endif
+static gboolean janus_nosip_relay_register(janus_nosip_session *session);
+
 static void janus_nosip_srtp_cleanup(janus_nosip_session *session);
 
 static void janus_nosip_media_reset(janus_nosip_session *session);
@@ -798,6 +829,50 @@ int janus_nosip_init(janus_callbacks *callback, const char *config_path) {
 			}
 		}
 
+		/* Should we share a few relay threads among sessions, instead of one each? */
+		item = janus_config_get(config, config_general, janus_config_type_item, "relay_threads");
+		if(item && item->value) {
+#ifdef __linux__
+			int relay_threads = atoi(item->value);
+			if(relay_threads < 0) {
+				JANUS_LOG(LOG_WARN, "Invalid number of relay threads (%s), will use dedicated relay threads\n", item->value);
+				relay_threads = 0;
+			}
+			if(relay_threads > 0) {
+				/* Start the shared relay engine */
+				relay_shards = g_malloc0(relay_threads * sizeof(janus_nosip_relay_shard));
+				int i = 0;
+				for(i=0; i<relay_threads; i++) {
+					janus_nosip_relay_shard *shard = &relay_shards[i];
+					shard->id = i+1;
+					shard->epollfd = epoll_create1(0);
+					janus_mutex_init(&shard->mutex);
+					char tname[16];
+					g_snprintf(tname, sizeof(tname), "nosip shard %d", shard->id);
+					GError *error = NULL;
+					if(shard->epollfd > -1)
+						shard->thread = g_thread_try_new(tname, &janus_nosip_relay_shard_thread, shard, &error);
+					if(shard->thread == NULL) {
+						JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to start relay shard #%d, remaining sessions will use dedicated relay threads\n",
+							error ? error->code : errno, error && error->message ? error->message : g_strerror(errno), shard->id);
+						if(error != NULL)
+							g_error_free(error);
+						if(shard->epollfd > -1)
+							close(shard->epollfd);
+						break;
+					}
+					relay_shards_num++;
+				}
+				if(relay_shards_num > 0) {
+					JANUS_LOG(LOG_INFO, "Sharing %d relay thread%s among NoSIP sessions\n",
+						relay_shards_num, relay_shards_num == 1 ? "" : "s");
+				}
+			}
+#else
+			JANUS_LOG(LOG_WARN, "The shared relay engine requires epoll(), sessions will use dedicated relay threads\n");
+#endif
+		}
+
 		janus_config_destroy(config);
 	}
 	config = NULL;
@@ -867,6 +942,21 @@ void janus_nosip_destroy(void) {
 		g_thread_join(handler_thread);
 		handler_thread = NULL;
 	}
+#ifdef __linux__
+	/* Stop the shared relay engine, if it was running */
+	if(relay_shards != NULL) {
+		int i = 0;
+		for(i=0; i<relay_shards_num; i++) {
+			if(relay_shards[i].thread != NULL)
+				g_thread_join(relay_shards[i].thread);
+			if(relay_shards[i].epollfd > -1)
+				close(relay_shards[i].epollfd);
+		}
+		g_free(relay_shards);
+		relay_shards = NULL;
+		relay_shards_num = 0;
+	}
+#endif
 	/* FIXME We should destroy the sessions cleanly */
 	janus_mutex_lock(&sessions_mutex);
 	g_hash_table_destroy(sessions);
@@ -973,6 +1063,9 @@ void janus_nosip_create_session(janus_plugin_session *handle, int *error) {
 	session->media.pipefd[0] = -1;
 	session->media.pipefd[1] = -1;
 	session->media.updated = FALSE;
+	session->media.pollerrs = 0;
+	session->relay_shard = NULL;
+	session->relay_fds = NULL;
 	session->media.audio_remote_policy.ssrc.type = ssrc_any_inbound;
 	session->media.audio_local_policy.ssrc.type = ssrc_any_inbound;
 	session->media.video_remote_policy.ssrc.type = ssrc_any_inbound;
@@ -1598,18 +1691,21 @@ static void *janus_nosip_handler(void *data) {
 			if(!sdp_update && !offer) {
 				/* Start the media */
 				session->media.ready = TRUE;	/* FIXME Maybe we need a better way to signal this */
-				GError *error = NULL;
-				char tname[16];
-				g_snprintf(tname, sizeof(tname), "nosiprtp %p", session);
-				janus_refcount_increase(&session->ref);
-				session->relayer_thread = g_thread_try_new(tname, janus_nosip_relay_thread, session, &error);
-				if(error != NULL) {
-					session->relayer_thread = NULL;
-					session->media.ready = FALSE;
-					janus_refcount_decrease(&session->ref);
-					JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the RTP/RTCP thread...\n",
-						error->code, error->message ? error->message : "??");
-					g_error_free(error);
+				if(!janus_nosip_relay_register(session)) {
+					/* No shared relay engine available, use a dedicated relay thread */
+					GError *error = NULL;
+					char tname[16];
+					g_snprintf(tname, sizeof(tname), "nosiprtp %p", session);
+					janus_refcount_increase(&session->ref);
+					session->relayer_thread = g_thread_try_new(tname, janus_nosip_relay_thread, session, &error);
+					if(error != NULL) {
+						session->relayer_thread = NULL;
+						session->media.ready = FALSE;
+						janus_refcount_decrease(&session->ref);
+						JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the RTP/RTCP thread...\n",
+							error->code, error->message ? error->message : "??");
+						g_error_free(error);
+					}
 				}
 			}
 		} else if(!strcasecmp(request_text, "hangup")) {
@@ -2348,6 +2444,7 @@ static void janus_nosip_media_cleanup(janus_nosip_session *session) {
 		close(session->media.pipefd[1]);
 		session->media.pipefd[1] = -1;
 	}
+	session->media.pollerrs = 0;
 	/* Clean up SRTP stuff, if needed */
 	janus_nosip_srtp_cleanup(session);
 
@@ -2355,6 +2452,388 @@ static void janus_nosip_media_cleanup(janus_nosip_session *session) {
 	janus_nosip_media_reset(session);
 }
 
+/* Helper to (re)connect the media sockets to the peer addresses, when a
+ * session is first set up or is updated by a renegotiation */
+static void janus_nosip_media_update_address(janus_nosip_session *session) {
+	/* Resolve the addresses, if needed */
+	gboolean have_audio_server_ip = FALSE;
+	gboolean have_video_server_ip = FALSE;
+	struct sockaddr_storage audio_server_addr = { 0 }, video_server_addr = { 0 };
+	if(session->media.remote_audio_ip && strcmp(session->media.remote_audio_ip, "0.0.0.0")) {
+		if(janus_network_resolve_address(session->media.remote_audio_ip, &audio_server_addr) < 0) {
+			JANUS_LOG(LOG_ERR, "[NoSIP-%p] Couldn't resolve audio address '%s'\n",
+				session, session->media.remote_audio_ip);
+		} else {
+			/* Address resolved */
+			have_audio_server_ip = TRUE;
+		}
+	}
+	if(session->media.remote_video_ip && strcmp(session->media.remote_video_ip, "0.0.0.0")) {
+		if(janus_network_resolve_address(session->media.remote_video_ip, &video_server_addr) < 0) {
+			JANUS_LOG(LOG_ERR, "[NoSIP-%p] Couldn't resolve video address '%s'\n",
+				session, session->media.remote_video_ip);
+		} else {
+			/* Address resolved */
+			have_video_server_ip = TRUE;
+		}
+	}
+
+	if(have_audio_server_ip || have_video_server_ip) {
+		janus_nosip_connect_sockets(session, have_audio_server_ip ? &audio_server_addr : NULL,
+			have_video_server_ip ? &video_server_addr : NULL);
+	} else if (session->media.remote_audio_ip == NULL && session->media.remote_video_ip == NULL) {
+		JANUS_LOG(LOG_ERR, "[NoSIP-%p] Couldn't update session details: both audio and video remote IP addresses are NULL\n", session);
+	} else {
+		if(session->media.remote_audio_ip)
+			JANUS_LOG(LOG_ERR, "[NoSIP-%p] Couldn't update session details: audio remote IP address (%s) is invalid\n",
+				session, session->media.remote_audio_ip);
+		if(session->media.remote_video_ip)
+			JANUS_LOG(LOG_ERR, "[NoSIP-%p] Couldn't update session details: video remote IP address (%s) is invalid\n",
+				session, session->media.remote_video_ip);
+	}
+}
+
+/* Helper to process an RTP/RTCP packet available on one of the media
+ * sockets of a session, shared by the dedicated relay threads and the
+ * shards of the shared relay engine */
+static void janus_nosip_media_readable(janus_nosip_session *session, int fd) {
+	socklen_t addrlen;
+	struct sockaddr_in remote = { 0 };
+	int bytes = 0;
+	char buffer[1500];
+	/* Got an RTP/RTCP packet */
+	addrlen = sizeof(remote);
+	bytes = recvfrom(fd, buffer, 1500, 0, (struct sockaddr*)&remote, &addrlen);
+	if(bytes < 0) {
+		/* Failed to read? */
+		return;
+	}
+	/* Let's check what this is */
+	gboolean video = fd == session->media.video_rtp_fd || fd == session->media.video_rtcp_fd;
+	gboolean rtcp = fd == session->media.audio_rtcp_fd || fd == session->media.video_rtcp_fd;
+	if(!rtcp) {
+		/* Audio or Video RTP */
+		if(!janus_is_rtp(buffer, bytes)) {
+			/* Not an RTP packet? */
+			return;
+		}
+		session->media.pollerrs = 0;
+		rtp_header *header = (rtp_header *)buffer;
+		if((video && session->media.video_ssrc_peer != ntohl(header->ssrc)) ||
+				(!video && session->media.audio_ssrc_peer != ntohl(header->ssrc))) {
+			if(video && session->media.video_ssrc_peer == 0) {
+				session->media.video_ssrc_peer = ntohl(header->ssrc);
+			} else if(!video && session->media.audio_ssrc_peer == 0) {
+				session->media.audio_ssrc_peer = ntohl(header->ssrc);
+			}
+			JANUS_LOG(LOG_VERB, "[NoSIP-%p] Got SIP peer %s SSRC: %"SCNu32"\n",
+				session, video ? "video" : "audio",
+				video ? session->media.video_ssrc_peer : session->media.audio_ssrc_peer);
+		}
+		/* Is this SRTP? */
+		if(session->media.has_srtp_remote) {
+			int buflen = bytes;
+			srtp_err_status_t res = srtp_unprotect(
+				(video ? session->media.video_srtp_in : session->media.audio_srtp_in),
+				buffer, &buflen);
+			if(res != srtp_err_status_ok && res != srtp_err_status_replay_fail && res != srtp_err_status_replay_old) {
+				guint32 timestamp = ntohl(header->timestamp);
+				guint16 seq = ntohs(header->seq_number);
+				JANUS_LOG(LOG_ERR, "[NoSIP-%p] %s SRTP unprotect error: %s (len=%d-->%d, ts=%"SCNu32", seq=%"SCNu16")\n",
+					session, video ? "Video" : "Audio", janus_srtp_error_str(res), bytes, buflen, timestamp, seq);
+				return;
+			}
+			bytes = buflen;
+		}
+		/* Check if the SSRC changed (e.g., after a re-INVITE or UPDATE) */
+		janus_rtp_header_update(header, video ? &session->media.vcontext : &session->media.acontext, video, 0);
+		/* Save the frame if we're recording */
+		header->ssrc = htonl(video ? session->media.video_ssrc_peer : session->media.audio_ssrc_peer);
+		janus_recorder_save_frame(video ? session->vrc_peer : session->arc_peer, buffer, bytes);
+		/* Relay to browser */
+		janus_plugin_rtp rtp = { .mindex = -1, .video = video, .buffer = buffer, .length = bytes };
+		/* Add audio-level extension, if present */
+		janus_plugin_rtp_extensions_reset(&rtp.extensions);
+		if(!video && session->media.audio_level_extension_id != -1) {
+			gboolean vad = FALSE;
+			int level = -1;
+			if(janus_rtp_header_extension_parse_audio_level(buffer, bytes,
+					session->media.audio_level_extension_id, &vad, &level) == 0) {
+				rtp.extensions.audio_level = level;
+				rtp.extensions.audio_level_vad = vad;
+			}
+		} else if(video && session->media.video_orientation_extension_id > 0) {
+			gboolean c = FALSE, f = FALSE, r1 = FALSE, r0 = FALSE;
+			if(janus_rtp_header_extension_parse_video_orientation(buffer, bytes,
+					session->media.video_orientation_extension_id, &c, &f, &r1, &r0) == 0) {
+				rtp.extensions.video_rotation = 0;
+				if(r1 && r0)
+					rtp.extensions.video_rotation = 270;
+				else if(r1)
+					rtp.extensions.video_rotation = 180;
+				else if(r0)
+					rtp.extensions.video_rotation = 90;
+				rtp.extensions.video_back_camera = c;
+				rtp.extensions.video_flipped = f;
+			}
+		}
+		gateway->relay_rtp(session->handle, &rtp);
+		return;
+	} else {
+		/* Audio or Video RTCP */
+		if(!janus_is_rtcp(buffer, bytes)) {
+			/* Not an RTCP packet? */
+			return;
+		}
+		if(session->media.has_srtp_remote) {
+			int buflen = bytes;
+			srtp_err_status_t res = srtp_unprotect_rtcp(
+				(video ? session->media.video_srtp_in : session->media.audio_srtp_in),
+				buffer, &buflen);
+			if(res != srtp_err_status_ok && res != srtp_err_status_replay_fail && res != srtp_err_status_replay_old) {
+				JANUS_LOG(LOG_ERR, "[NoSIP-%p] %s SRTCP unprotect error: %s (len=%d-->%d)\n",
+					session, video ? "Video" : "Audio", janus_srtp_error_str(res), bytes, buflen);
+				return;
+			}
+			bytes = buflen;
+		}
+		/* Relay to browser */
+		janus_plugin_rtcp rtcp = { .mindex = -1, .video = video, .buffer = buffer, bytes };
+		gateway->relay_rtcp(session->handle, &rtcp);
+		return;
+	}
+}
+
+#ifdef __linux__
+/* Shared relay engine implementation */
+#define JANUS_NOSIP_EPOLL_EVENTS	64
+static gboolean janus_nosip_relay_shard_addfd(janus_nosip_relay_shard *shard,
+		janus_nosip_session *session, int fd) {
+	if(fd < 0)
+		return TRUE;
+	janus_nosip_relay_fd *rfd = g_malloc(sizeof(janus_nosip_relay_fd));
+	rfd->fd = fd;
+	rfd->session = session;
+	struct epoll_event ev = { 0 };
+	ev.events = EPOLLIN;
+	ev.data.ptr = rfd;
+	if(epoll_ctl(shard->epollfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		JANUS_LOG(LOG_ERR, "[NoSIP-%p] Error registering file descriptor on relay shard #%d... %d (%s)\n",
+			session, shard->id, errno, g_strerror(errno));
+		g_free(rfd);
+		return FALSE;
+	}
+	session->relay_fds = g_slist_prepend(session->relay_fds, rfd);
+	return TRUE;
+}
+
+/* Register a session on one of the shards of the shared relay engine:
+ * returns FALSE if the session needs a dedicated relay thread instead */
+static gboolean janus_nosip_relay_register(janus_nosip_session *session) {
+	if(relay_shards_num == 0 || session->media.pipefd[0] == -1)
+		return FALSE;
+	/* Pick a shard, round robin */
+	janus_nosip_relay_shard *shard =
+		&relay_shards[((guint)g_atomic_int_add(&relay_shards_rr, 1)) % relay_shards_num];
+	janus_refcount_increase(&session->ref);
+	session->relay_shard = shard;
+	/* Connect the sockets to the peer, then register all the file descriptors,
+	 * including the pipe we use to interrupt the loop on updates and hangups */
+	session->media.updated = FALSE;
+	janus_nosip_media_update_address(session);
+	gboolean ok = TRUE;
+	ok = ok && janus_nosip_relay_shard_addfd(shard, session, session->media.audio_rtp_fd);
+	ok = ok && janus_nosip_relay_shard_addfd(shard, session, session->media.audio_rtcp_fd);
+	ok = ok && janus_nosip_relay_shard_addfd(shard, session, session->media.video_rtp_fd);
+	ok = ok && janus_nosip_relay_shard_addfd(shard, session, session->media.video_rtcp_fd);
+	ok = ok && janus_nosip_relay_shard_addfd(shard, session, session->media.pipefd[0]);
+	if(!ok) {
+		/* We couldn't register some descriptor: undo everything, the
+		 * session will get a dedicated relay thread instead */
+		GSList *l = session->relay_fds;
+		while(l) {
+			janus_nosip_relay_fd *rfd = (janus_nosip_relay_fd *)l->data;
+			epoll_ctl(shard->epollfd, EPOLL_CTL_DEL, rfd->fd, NULL);
+			g_free(rfd);
+			l = l->next;
+		}
+		g_slist_free(session->relay_fds);
+		session->relay_fds = NULL;
+		session->relay_shard = NULL;
+		janus_refcount_decrease(&session->ref);
+		return FALSE;
+	}
+	janus_mutex_lock(&shard->mutex);
+	shard->sessions = g_list_append(shard->sessions, session);
+	janus_mutex_unlock(&shard->mutex);
+	JANUS_LOG(LOG_VERB, "[NoSIP-%p] Session registered on relay shard #%d\n", session, shard->id);
+	return TRUE;
+}
+
+/* Deregister a session from its shard and cleanup the media (only invoked by the shard thread) */
+static void janus_nosip_relay_unregister(janus_nosip_session *session) {
+	janus_nosip_relay_shard *shard = (janus_nosip_relay_shard *)session->relay_shard;
+	if(shard == NULL)
+		return;
+	GSList *l = session->relay_fds;
+	while(l) {
+		janus_nosip_relay_fd *rfd = (janus_nosip_relay_fd *)l->data;
+		epoll_ctl(shard->epollfd, EPOLL_CTL_DEL, rfd->fd, NULL);
+		g_free(rfd);
+		l = l->next;
+	}
+	g_slist_free(session->relay_fds);
+	session->relay_fds = NULL;
+	session->relay_shard = NULL;
+	janus_mutex_lock(&shard->mutex);
+	shard->sessions = g_list_remove(shard->sessions, session);
+	janus_mutex_unlock(&shard->mutex);
+	/* Cleanup the media session */
+	janus_mutex_lock(&session->mutex);
+	janus_nosip_media_cleanup(session);
+	janus_mutex_unlock(&session->mutex);
+	JANUS_LOG(LOG_VERB, "[NoSIP-%p] Session deregistered from relay shard #%d\n", session, shard->id);
+	janus_refcount_decrease(&session->ref);
+}
+
+/* Re-register the file descriptors of a session after a renegotiation, as ports may have changed */
+static void janus_nosip_relay_update_fds(janus_nosip_relay_shard *shard, janus_nosip_session *session) {
+	GSList *l = session->relay_fds;
+	while(l) {
+		janus_nosip_relay_fd *rfd = (janus_nosip_relay_fd *)l->data;
+		epoll_ctl(shard->epollfd, EPOLL_CTL_DEL, rfd->fd, NULL);
+		g_free(rfd);
+		l = l->next;
+	}
+	g_slist_free(session->relay_fds);
+	session->relay_fds = NULL;
+	gboolean ok = TRUE;
+	ok = ok && janus_nosip_relay_shard_addfd(shard, session, session->media.audio_rtp_fd);
+	ok = ok && janus_nosip_relay_shard_addfd(shard, session, session->media.audio_rtcp_fd);
+	ok = ok && janus_nosip_relay_shard_addfd(shard, session, session->media.video_rtp_fd);
+	ok = ok && janus_nosip_relay_shard_addfd(shard, session, session->media.video_rtcp_fd);
+	ok = ok && janus_nosip_relay_shard_addfd(shard, session, session->media.pipefd[0]);
+	if(!ok) {
+		/* We couldn't re-register some descriptor, close the PeerConnection */
+		JANUS_LOG(LOG_ERR, "[NoSIP-%p] Error updating session on relay shard #%d, closing the PeerConnection\n",
+			session, shard->id);
+		gateway->close_pc(session->handle);
+	}
+}
+
+static void *janus_nosip_relay_shard_thread(void *data) {
+	janus_nosip_relay_shard *shard = (janus_nosip_relay_shard *)data;
+	JANUS_LOG(LOG_VERB, "Starting shared relay engine thread (shard #%d)\n", shard->id);
+	struct epoll_event events[JANUS_NOSIP_EPOLL_EVENTS];
+	int resfd = 0, bytes = 0, i = 0;
+	while(!g_atomic_int_get(&stopping)) {
+		resfd = epoll_wait(shard->epollfd, events, JANUS_NOSIP_EPOLL_EVENTS, 1000);
+		if(resfd < 0) {
+			if(errno == EINTR) {
+				JANUS_LOG(LOG_HUGE, "Got an EINTR (%s) on relay shard #%d, ignoring...\n",
+					g_strerror(errno), shard->id);
+				continue;
+			}
+			JANUS_LOG(LOG_ERR, "Error on epoll_wait for relay shard #%d... %d (%s)\n",
+				shard->id, errno, g_strerror(errno));
+			break;
+		}
+		/* Process the events, deferring deregistrations until we've gone
+		 * through the whole batch, as other events in it may refer to the
+		 * same session and its file descriptors */
+		GSList *leaving = NULL;
+		for(i=0; i<resfd; i++) {
+			janus_nosip_relay_fd *rfd = (janus_nosip_relay_fd *)events[i].data.ptr;
+			janus_nosip_session *session = rfd->session;
+			if(g_slist_find(leaving, session) != NULL)
+				continue;
+			if(g_atomic_int_get(&session->destroyed)) {
+				leaving = g_slist_prepend(leaving, session);
+				continue;
+			}
+			if(events[i].events & (EPOLLERR | EPOLLHUP)) {
+				/* Check the socket error, tolerating ICMP errors on RTCP sockets */
+				int error = 0;
+				socklen_t errlen = sizeof(error);
+				getsockopt(rfd->fd, SOL_SOCKET, SO_ERROR, (void *)&error, &errlen);
+				if(error == 0) {
+					/* Maybe not a breaking error after all? */
+					continue;
+				} else if(error == 111 &&
+						(rfd->fd == session->media.audio_rtcp_fd || rfd->fd == session->media.video_rtcp_fd)) {
+					/* ICMP error? If it's related to RTCP, let's just close the RTCP socket and move on */
+					gboolean video = rfd->fd == session->media.video_rtcp_fd;
+					JANUS_LOG(LOG_WARN, "[NoSIP-%p] Got a '%s' on the %s RTCP socket, closing it\n",
+						session, g_strerror(error), video ? "video" : "audio");
+					epoll_ctl(shard->epollfd, EPOLL_CTL_DEL, rfd->fd, NULL);
+					session->relay_fds = g_slist_remove(session->relay_fds, rfd);
+					janus_mutex_lock(&session->mutex);
+					close(rfd->fd);
+					if(video)
+						session->media.video_rtcp_fd = -1;
+					else
+						session->media.audio_rtcp_fd = -1;
+					janus_mutex_unlock(&session->mutex);
+					g_free(rfd);
+					continue;
+				}
+				session->media.pollerrs++;
+				if(session->media.pollerrs < 100)
+					continue;
+				JANUS_LOG(LOG_ERR, "[NoSIP-%p] Too many errors polling %d on relay shard #%d... %d (%s)\n",
+					session, rfd->fd, shard->id, error, g_strerror(error));
+				/* Close the PeerConnection and stop serving this session */
+				gateway->close_pc(session->handle);
+				leaving = g_slist_prepend(leaving, session);
+				continue;
+			}
+			if(rfd->fd == session->media.pipefd[0]) {
+				/* Poll interrupted for a reason: either the session was
+				 * updated, or it's time to wrap it up */
+				int code = 0;
+				bytes = read(rfd->fd, &code, sizeof(int));
+				(void)bytes;
+				if(g_atomic_int_get(&session->destroyed) || g_atomic_int_get(&session->hangingup) ||
+						!session->media.updated) {
+					leaving = g_slist_prepend(leaving, session);
+				} else {
+					session->media.updated = FALSE;
+					janus_nosip_media_update_address(session);
+					janus_nosip_relay_update_fds(shard, session);
+				}
+				continue;
+			}
+			/* Got an RTP/RTCP packet */
+			janus_nosip_media_readable(session, rfd->fd);
+		}
+		if(leaving != NULL) {
+			GSList *l = leaving;
+			while(l) {
+				janus_nosip_relay_unregister((janus_nosip_session *)l->data);
+				l = l->next;
+			}
+			g_slist_free(leaving);
+		}
+	}
+	/* We're done: deregister any session we were still serving */
+	janus_mutex_lock(&shard->mutex);
+	while(shard->sessions != NULL) {
+		janus_nosip_session *session = (janus_nosip_session *)shard->sessions->data;
+		janus_mutex_unlock(&shard->mutex);
+		janus_nosip_relay_unregister(session);
+		janus_mutex_lock(&shard->mutex);
+	}
+	janus_mutex_unlock(&shard->mutex);
+	JANUS_LOG(LOG_VERB, "Leaving shared relay engine thread (shard #%d)\n", shard->id);
+	return NULL;
+}
+#else
+static gboolean janus_nosip_relay_register(janus_nosip_session *session) {
+	/* No epoll(), sessions keep using dedicated relay threads */
+	return FALSE;
+}
+#endif
+
 /* Thread to relay RTP/RTCP frames coming from the peer */
 static void *janus_nosip_relay_thread(void *data) {
 	janus_nosip_session *session = (janus_nosip_session *)data;
@@ -2365,13 +2844,9 @@ static void *janus_nosip_relay_thread(void *data) {
 	JANUS_LOG(LOG_INFO, "[NoSIP-%p] Starting relay thread\n", session);
 
 	/* File descriptors */
-	socklen_t addrlen;
-	struct sockaddr_in remote = { 0 };
-	int resfd = 0, bytes = 0, pollerrs = 0;
+	int resfd = 0;
 	struct pollfd fds[5];
 	int pipe_fd = session->media.pipefd[0];
-	char buffer[1500];
-	memset(buffer, 0, 1500);
 	if(pipe_fd == -1) {
 		/* If the pipe file descriptor doesn't exist, it means we're done already,
 		 * and/or we may never be notified about sessions being closed, so give up */
@@ -2385,8 +2860,6 @@ static void *janus_nosip_relay_thread(void *data) {
 	gboolean goon = TRUE;
 
 	session->media.updated = TRUE; /* Connect UDP sockets upon loop entry */
-	gboolean have_audio_server_ip = TRUE;
-	gboolean have_video_server_ip = TRUE;
 
 	while(goon && session != NULL &&
 			!g_atomic_int_get(&session->destroyed) && !g_atomic_int_get(&session->hangingup)) {
@@ -2394,43 +2867,7 @@ static void *janus_nosip_relay_thread(void *data) {
 		if(session->media.updated) {
 			/* Apparently there was a session update, or the loop has just been entered */
 			session->media.updated = FALSE;
-
-			/* Resolve the addresses, if needed */
-			have_audio_server_ip = FALSE;
-			have_video_server_ip = FALSE;
-			struct sockaddr_storage audio_server_addr = { 0 }, video_server_addr = { 0 };
-			if(session->media.remote_audio_ip && strcmp(session->media.remote_audio_ip, "0.0.0.0")) {
-				if(janus_network_resolve_address(session->media.remote_audio_ip, &audio_server_addr) < 0) {
-					JANUS_LOG(LOG_ERR, "[NoSIP-%p] Couldn't resolve audio address '%s'\n",
-						session, session->media.remote_audio_ip);
-				} else {
-					/* Address resolved */
-					have_audio_server_ip = TRUE;
-				}
-			}
-			if(session->media.remote_video_ip && strcmp(session->media.remote_video_ip, "0.0.0.0")) {
-				if(janus_network_resolve_address(session->media.remote_video_ip, &video_server_addr) < 0) {
-					JANUS_LOG(LOG_ERR, "[NoSIP-%p] Couldn't resolve video address '%s'\n",
-						session, session->media.remote_video_ip);
-				} else {
-					/* Address resolved */
-					have_video_server_ip = TRUE;
-				}
-			}
-
-			if(have_audio_server_ip || have_video_server_ip) {
-				janus_nosip_connect_sockets(session, have_audio_server_ip ? &audio_server_addr : NULL,
-					have_video_server_ip ? &video_server_addr : NULL);
-			} else if (session->media.remote_audio_ip == NULL && session->media.remote_video_ip == NULL) {
-				JANUS_LOG(LOG_ERR, "[NoSIP-%p] Couldn't update session details: both audio and video remote IP addresses are NULL\n", session);
-			} else {
-				if(session->media.remote_audio_ip)
-					JANUS_LOG(LOG_ERR, "[NoSIP-%p] Couldn't update session details: audio remote IP address (%s) is invalid\n",
-						session, session->media.remote_audio_ip);
-				if(session->media.remote_video_ip)
-					JANUS_LOG(LOG_ERR, "[NoSIP-%p] Couldn't update session details: video remote IP address (%s) is invalid\n",
-						session, session->media.remote_video_ip);
-			}
+			janus_nosip_media_update_address(session);
 		}
 
 		/* Prepare poll */
@@ -2517,8 +2954,8 @@ static void *janus_nosip_relay_thread(void *data) {
 					}
 				}
 				/* FIXME Should we be more tolerant of ICMP errors on RTP sockets as well? */
-				pollerrs++;
-				if(pollerrs < 100)
+				session->media.pollerrs++;
+				if(session->media.pollerrs < 100)
 					continue;
 				JANUS_LOG(LOG_ERR, "[NoSIP-%p] Too many errors polling %d (socket #%d): %s...\n", session,
 					fds[i].fd, i, fds[i].revents & POLLERR ? "POLLERR" : "POLLHUP");
@@ -2536,106 +2973,7 @@ static void *janus_nosip_relay_thread(void *data) {
 					break;
 				}
 				/* Got an RTP/RTCP packet */
-				addrlen = sizeof(remote);
-				bytes = recvfrom(fds[i].fd, buffer, 1500, 0, (struct sockaddr*)&remote, &addrlen);
-				if(bytes < 0) {
-					/* Failed to read? */
-					continue;
-				}
-				/* Let's check what this is */
-				gboolean video = fds[i].fd == session->media.video_rtp_fd || fds[i].fd == session->media.video_rtcp_fd;
-				gboolean rtcp = fds[i].fd == session->media.audio_rtcp_fd || fds[i].fd == session->media.video_rtcp_fd;
-				if(!rtcp) {
-					/* Audio or Video RTP */
-					if(!janus_is_rtp(buffer, bytes)) {
-						/* Not an RTP packet? */
-						continue;
-					}
-					pollerrs = 0;
-					rtp_header *header = (rtp_header *)buffer;
-					if((video && session->media.video_ssrc_peer != ntohl(header->ssrc)) ||
-							(!video && session->media.audio_ssrc_peer != ntohl(header->ssrc))) {
-						if(video && session->media.video_ssrc_peer == 0) {
-							session->media.video_ssrc_peer = ntohl(header->ssrc);
-						} else if(!video && session->media.audio_ssrc_peer == 0) {
-							session->media.audio_ssrc_peer = ntohl(header->ssrc);
-						}
-						JANUS_LOG(LOG_VERB, "[NoSIP-%p] Got SIP peer %s SSRC: %"SCNu32"\n",
-							session, video ? "video" : "audio",
-							video ? session->media.video_ssrc_peer : session->media.audio_ssrc_peer);
-					}
-					/* Is this SRTP? */
-					if(session->media.has_srtp_remote) {
-						int buflen = bytes;
-						srtp_err_status_t res = srtp_unprotect(
-							(video ? session->media.video_srtp_in : session->media.audio_srtp_in),
-							buffer, &buflen);
-						if(res != srtp_err_status_ok && res != srtp_err_status_replay_fail && res != srtp_err_status_replay_old) {
-							guint32 timestamp = ntohl(header->timestamp);
-							guint16 seq = ntohs(header->seq_number);
-							JANUS_LOG(LOG_ERR, "[NoSIP-%p] %s SRTP unprotect error: %s (len=%d-->%d, ts=%"SCNu32", seq=%"SCNu16")\n",
-								session, video ? "Video" : "Audio", janus_srtp_error_str(res), bytes, buflen, timestamp, seq);
-							continue;
-						}
-						bytes = buflen;
-					}
-					/* Check if the SSRC changed (e.g., after a re-INVITE or UPDATE) */
-					janus_rtp_header_update(header, video ? &session->media.vcontext : &session->media.acontext, video, 0);
-					/* Save the frame if we're recording */
-					header->ssrc = htonl(video ? session->media.video_ssrc_peer : session->media.audio_ssrc_peer);
-					janus_recorder_save_frame(video ? session->vrc_peer : session->arc_peer, buffer, bytes);
-					/* Relay to browser */
-					janus_plugin_rtp rtp = { .mindex = -1, .video = video, .buffer = buffer, .length = bytes };
-					/* Add audio-level extension, if present */
-					janus_plugin_rtp_extensions_reset(&rtp.extensions);
-					if(!video && session->media.audio_level_extension_id != -1) {
-						gboolean vad = FALSE;
-						int level = -1;
-						if(janus_rtp_header_extension_parse_audio_level(buffer, bytes,
-								session->media.audio_level_extension_id, &vad, &level) == 0) {
-							rtp.extensions.audio_level = level;
-							rtp.extensions.audio_level_vad = vad;
-						}
-					} else if(video && session->media.video_orientation_extension_id > 0) {
-						gboolean c = FALSE, f = FALSE, r1 = FALSE, r0 = FALSE;
-						if(janus_rtp_header_extension_parse_video_orientation(buffer, bytes,
-								session->media.video_orientation_extension_id, &c, &f, &r1, &r0) == 0) {
-							rtp.extensions.video_rotation = 0;
-							if(r1 && r0)
-								rtp.extensions.video_rotation = 270;
-							else if(r1)
-								rtp.extensions.video_rotation = 180;
-							else if(r0)
-								rtp.extensions.video_rotation = 90;
-							rtp.extensions.video_back_camera = c;
-							rtp.extensions.video_flipped = f;
-						}
-					}
-					gateway->relay_rtp(session->handle, &rtp);
-					continue;
-				} else {
-					/* Audio or Video RTCP */
-					if(!janus_is_rtcp(buffer, bytes)) {
-						/* Not an RTCP packet? */
-						continue;
-					}
-					if(session->media.has_srtp_remote) {
-						int buflen = bytes;
-						srtp_err_status_t res = srtp_unprotect_rtcp(
-							(video ? session->media.video_srtp_in : session->media.audio_srtp_in),
-							buffer, &buflen);
-						if(res != srtp_err_status_ok && res != srtp_err_status_replay_fail && res != srtp_err_status_replay_old) {
-							JANUS_LOG(LOG_ERR, "[NoSIP-%p] %s SRTCP unprotect error: %s (len=%d-->%d)\n",
-								session, video ? "Video" : "Audio", janus_srtp_error_str(res), bytes, buflen);
-							continue;
-						}
-						bytes = buflen;
-					}
-					/* Relay to browser */
-					janus_plugin_rtcp rtcp = { .mindex = -1, .video = video, .buffer = buffer, bytes };
-					gateway->relay_rtcp(session->handle, &rtcp);
-					continue;
-				}
+				janus_nosip_media_readable(session, fds[i].fd);
 			}
 		}
 	}
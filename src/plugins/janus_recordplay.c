@@ -266,8 +266,15 @@
 
 #include <dirent.h>
 #include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 #include <jansson.h>
 
 #include "../debug.h"
@@ -420,6 +427,9 @@ typedef struct janus_recordplay_recording {
 	gboolean textdata;			/* Whether data format is text */
 	char *offer;				/* The SDP offer that will be sent to watchers */
 	gboolean e2ee;				/* Whether media in the recording is encrypted, e.g., using Insertable Streams */
+	janus_recordplay_frame_packet *aframes;	/* Audio frame index, built once and shared by all viewers */
+	janus_recordplay_frame_packet *vframes;	/* Video frame index, built once and shared by all viewers */
+	janus_recordplay_frame_packet *dframes;	/* Data packet index, built once and shared by all viewers */
 	GList *viewers;				/* List of users watching this recording */
 	volatile gint paused;		/* Whether this recording is paused */
 	volatile gint completed;	/* Whether this recording was completed or still going on */
@@ -429,6 +439,15 @@ typedef struct janus_recordplay_recording {
 } janus_recordplay_recording;
 static GHashTable *recordings = NULL;
 static janus_mutex recordings_mutex = JANUS_MUTEX_INITIALIZER;
+static guint64 janus_recordplay_import_recording(const char *filename, gboolean *added);
+#ifdef __linux__
+/* Where available, we use inotify to keep the recordings list up to date
+ * incrementally, rather than rescanning the whole folder on each update */
+static int inotify_fd = -1;
+static GThread *inotify_thread = NULL;
+static GHashTable *nfofiles = NULL;		/* Map of .nfo filenames to recording IDs, for removals */
+static void *janus_recordplay_inotify_thread(void *data);
+#endif
 
 typedef struct janus_recordplay_session {
 	janus_plugin_session *handle;
@@ -491,9 +510,21 @@ static void janus_recordplay_recording_destroy(janus_recordplay_recording *recor
 		janus_refcount_decrease(&recording->ref);
 }
 
+static void janus_recordplay_free_frames(janus_recordplay_frame_packet *list) {
+	janus_recordplay_frame_packet *tmp = NULL;
+	while(list) {
+		tmp = list->next;
+		g_free(list);
+		list = tmp;
+	}
+}
+
 static void janus_recordplay_recording_free(const janus_refcount *recording_ref) {
 	janus_recordplay_recording *recording = janus_refcount_containerof(recording_ref, janus_recordplay_recording, ref);
 	/* This recording can be destroyed, free all the resources */
+	janus_recordplay_free_frames(recording->aframes);
+	janus_recordplay_free_frames(recording->vframes);
+	janus_recordplay_free_frames(recording->dframes);
 	g_free(recording->name);
 	g_free(recording->date);
 	g_free(recording->arc_file);
@@ -833,7 +864,32 @@ int janus_recordplay_init(janus_callbacks *callback, const char *config_path) {
 		}
 	}
 	recordings = g_hash_table_new_full(g_int64_hash, g_int64_equal, (GDestroyNotify)g_free, (GDestroyNotify)janus_recordplay_recording_destroy);
+#ifdef __linux__
+	nfofiles = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, (GDestroyNotify)g_free);
+#endif
 	janus_recordplay_update_recordings_list();
+#ifdef __linux__
+	/* Let's try and keep the list up to date incrementally via inotify:
+	 * this way "update" requests don't need to rescan the whole folder */
+	inotify_fd = inotify_init1(IN_NONBLOCK);
+	if(inotify_fd < 0) {
+		JANUS_LOG(LOG_WARN, "Couldn't create inotify instance (%s), updates will rescan the recordings folder\n", g_strerror(errno));
+	} else if(inotify_add_watch(inotify_fd, recordings_path, IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM) < 0) {
+		JANUS_LOG(LOG_WARN, "Couldn't watch %s (%s), updates will rescan the recordings folder\n", recordings_path, g_strerror(errno));
+		close(inotify_fd);
+		inotify_fd = -1;
+	} else {
+		GError *ierror = NULL;
+		inotify_thread = g_thread_try_new("recordplay inotify", janus_recordplay_inotify_thread, NULL, &ierror);
+		if(ierror != NULL) {
+			JANUS_LOG(LOG_WARN, "Got error %d (%s) trying to launch the inotify thread, updates will rescan the recordings folder\n",
+				ierror->code, ierror->message ? ierror->message : "??");
+			g_error_free(ierror);
+			close(inotify_fd);
+			inotify_fd = -1;
+		}
+	}
+#endif
 
 	sessions = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_recordplay_session_destroy);
 	messages = g_async_queue_new_full((GDestroyNotify) janus_recordplay_message_free);
@@ -866,12 +922,25 @@ void janus_recordplay_destroy(void) {
 		g_thread_join(handler_thread);
 		handler_thread = NULL;
 	}
+#ifdef __linux__
+	if(inotify_thread != NULL) {
+		g_thread_join(inotify_thread);
+		inotify_thread = NULL;
+	}
+	if(inotify_fd > -1)
+		close(inotify_fd);
+	inotify_fd = -1;
+#endif
 	/* FIXME We should destroy the sessions cleanly */
 	janus_mutex_lock(&sessions_mutex);
 	g_hash_table_destroy(sessions);
 	sessions = NULL;
 	g_hash_table_destroy(recordings);
 	recordings = NULL;
+#ifdef __linux__
+	g_hash_table_destroy(nfofiles);
+	nfofiles = NULL;
+#endif
 	janus_mutex_unlock(&sessions_mutex);
 	g_async_queue_unref(messages);
 	messages = NULL;
@@ -1961,28 +2030,38 @@ recdone:
 				g_snprintf(error_cause, 512, "No such recording");
 				goto error;
 			}
-			/* Access the frames */
+			/* Access the frames: the indexes are built the first time someone
+			 * plays the recording, and then shared by all its viewers, so that
+			 * concurrent playbacks don't pay the file scan over and over */
+			janus_mutex_lock(&rec->mutex);
 			if(rec->arc_file) {
-				session->aframes = janus_recordplay_get_frames(recordings_path, rec->arc_file);
+				if(rec->aframes == NULL)
+					rec->aframes = janus_recordplay_get_frames(recordings_path, rec->arc_file);
+				session->aframes = rec->aframes;
 				if(session->aframes == NULL) {
 					JANUS_LOG(LOG_WARN, "Error opening audio recording, trying to go on anyway\n");
 					warning = "Broken audio file, playing video only";
 				}
 			}
 			if(rec->vrc_file) {
-				session->vframes = janus_recordplay_get_frames(recordings_path, rec->vrc_file);
+				if(rec->vframes == NULL)
+					rec->vframes = janus_recordplay_get_frames(recordings_path, rec->vrc_file);
+				session->vframes = rec->vframes;
 				if(session->vframes == NULL) {
 					JANUS_LOG(LOG_WARN, "Error opening video recording, trying to go on anyway\n");
 					warning = "Broken video file, playing audio only";
 				}
 			}
 			if(rec->drc_file) {
-				session->dframes = janus_recordplay_get_frames(recordings_path, rec->drc_file);
+				if(rec->dframes == NULL)
+					rec->dframes = janus_recordplay_get_frames(recordings_path, rec->drc_file);
+				session->dframes = rec->dframes;
 				if(session->dframes == NULL) {
 					JANUS_LOG(LOG_WARN, "Error opening data recording, trying to go on anyway\n");
 					warning = "Broken data file, playing audio/video only";
 				}
 			}
+			janus_mutex_unlock(&rec->mutex);
 			if(session->aframes == NULL && session->vframes == NULL && session->dframes == NULL) {
 				error_code = JANUS_RECORDPLAY_ERROR_INVALID_RECORDING;
 				g_snprintf(error_cause, 512, "Error opening recording files");
@@ -2139,9 +2218,160 @@ error:
 	return NULL;
 }
 
+/* Helper to import a single .nfo file in the recordings index: the caller
+ * must hold the recordings mutex; returns the recording ID on success, with
+ * "added" telling whether it was a new entry, or 0 if the file is invalid */
+static guint64 janus_recordplay_import_recording(const char *filename, gboolean *added) {
+	if(added)
+		*added = FALSE;
+	char recpath[1024];
+	memset(recpath, 0, 1024);
+	g_snprintf(recpath, 1024, "%s/%s", recordings_path, filename);
+	janus_config *nfo = janus_config_parse(recpath);
+	if(nfo == NULL) {
+		JANUS_LOG(LOG_ERR, "Invalid recording '%s'...\n", filename);
+		return 0;
+	}
+	GList *cl = janus_config_get_categories(nfo, NULL);
+	if(cl == NULL || cl->data == NULL) {
+		JANUS_LOG(LOG_WARN, "No recording info in '%s', skipping...\n", filename);
+		janus_config_destroy(nfo);
+		return 0;
+	}
+	janus_config_category *cat = (janus_config_category *)cl->data;
+	guint64 id = g_ascii_strtoull(cat->name, NULL, 0);
+	if(id == 0) {
+		JANUS_LOG(LOG_WARN, "Invalid ID, skipping...\n");
+		g_list_free(cl);
+		janus_config_destroy(nfo);
+		return 0;
+	}
+	janus_recordplay_recording *rec = g_hash_table_lookup(recordings, &id);
+	if(rec != NULL) {
+		/* This recording is already in the list, just track its .nfo file */
+#ifdef __linux__
+		if(nfofiles != NULL && g_hash_table_lookup(nfofiles, filename) == NULL)
+			g_hash_table_insert(nfofiles, g_strdup(filename), janus_uint64_dup(id));
+#endif
+		g_list_free(cl);
+		janus_config_destroy(nfo);
+		return id;
+	}
+	janus_config_item *name = janus_config_get(nfo, cat, janus_config_type_item, "name");
+	janus_config_item *date = janus_config_get(nfo, cat, janus_config_type_item, "date");
+	janus_config_item *audio = janus_config_get(nfo, cat, janus_config_type_item, "audio");
+	janus_config_item *video = janus_config_get(nfo, cat, janus_config_type_item, "video");
+	janus_config_item *data = janus_config_get(nfo, cat, janus_config_type_item, "data");
+	if(!name || !name->value || strlen(name->value) == 0 || !date || !date->value || strlen(date->value) == 0) {
+		JANUS_LOG(LOG_WARN, "Invalid info for recording %"SCNu64", skipping...\n", id);
+		g_list_free(cl);
+		janus_config_destroy(nfo);
+		return 0;
+	}
+	if((!audio || !audio->value) && (!video || !video->value)) {
+		JANUS_LOG(LOG_WARN, "No audio and no video in recording %"SCNu64", skipping...\n", id);
+		janus_config_destroy(nfo);
+		return 0;
+	}
+	rec = g_malloc0(sizeof(janus_recordplay_recording));
+	rec->id = id;
+	rec->name = g_strdup(name->value);
+	rec->date = g_strdup(date->value);
+	if(audio && audio->value) {
+		rec->arc_file = g_strdup(audio->value);
+		char *ext = strstr(rec->arc_file, ".mjr");
+		if(ext != NULL)
+			*ext = '\0';
+		/* Check which codec is in this recording (and if it's end-to-end encrypted) */
+		gboolean e2ee = FALSE;
+		char fmtp[256];
+		fmtp[0] = '\0';
+		rec->acodec = janus_audiocodec_from_name(janus_recordplay_parse_codec(recordings_path,
+			rec->arc_file, fmtp, sizeof(fmtp), &rec->audiolevel_ext_id, NULL, &rec->opusred_pt, &e2ee));
+		if(strlen(fmtp) > 0)
+			rec->afmtp = g_strdup(fmtp);
+		if(e2ee)
+			rec->e2ee = TRUE;
+	}
+	if(video && video->value) {
+		rec->vrc_file = g_strdup(video->value);
+		char *ext = strstr(rec->vrc_file, ".mjr");
+		if(ext != NULL)
+			*ext = '\0';
+		/* Check which codec is in this recording (and if it's end-to-end encrypted) */
+		gboolean e2ee = FALSE;
+		char fmtp[256];
+		fmtp[0] = '\0';
+		rec->vcodec = janus_videocodec_from_name(janus_recordplay_parse_codec(recordings_path,
+			rec->vrc_file, fmtp, sizeof(fmtp), NULL, &rec->videoorient_ext_id, NULL, &e2ee));
+		if(strlen(fmtp) > 0)
+			rec->vfmtp = g_strdup(fmtp);
+		if(e2ee)
+			rec->e2ee = TRUE;
+	}
+	if(data && data->value) {
+		rec->drc_file = g_strdup(data->value);
+		char *ext = strstr(rec->drc_file, ".mjr");
+		if(ext != NULL)
+			*ext = '\0';
+		const char *textcodec = janus_recordplay_parse_codec(recordings_path,
+			rec->drc_file, NULL, sizeof(NULL), NULL, NULL, NULL, NULL);
+		rec->textdata = textcodec && (!strcasecmp(textcodec, "text"));
+	}
+	rec->audio_pt = AUDIO_PT;
+	if(rec->opusred_pt > 0 && rec->audio_pt == rec->opusred_pt)
+		rec->audio_pt++;
+	if(rec->acodec != JANUS_AUDIOCODEC_NONE) {
+		/* Some audio codecs have a fixed payload type that we can't mess with */
+		if(rec->acodec == JANUS_AUDIOCODEC_PCMU)
+			rec->audio_pt = 0;
+		else if(rec->acodec == JANUS_AUDIOCODEC_PCMA)
+			rec->audio_pt = 8;
+		else if(rec->acodec == JANUS_AUDIOCODEC_G722)
+			rec->audio_pt = 9;
+	}
+	rec->video_pt = VIDEO_PT;
+	rec->viewers = NULL;
+	if(janus_recordplay_generate_offer(rec) < 0) {
+		JANUS_LOG(LOG_WARN, "Could not generate offer for recording %"SCNu64"...\n", rec->id);
+	}
+	g_atomic_int_set(&rec->paused, 0);
+	g_atomic_int_set(&rec->destroyed, 0);
+	g_atomic_int_set(&rec->completed, 1);
+	janus_refcount_init(&rec->ref, janus_recordplay_recording_free);
+	janus_mutex_init(&rec->mutex);
+
+	g_list_free(cl);
+	janus_config_destroy(nfo);
+
+	/* Add to the list of recordings */
+	g_hash_table_insert(recordings, janus_uint64_dup(rec->id), rec);
+#ifdef __linux__
+	if(nfofiles != NULL)
+		g_hash_table_insert(nfofiles, g_strdup(filename), janus_uint64_dup(rec->id));
+#endif
+	if(added)
+		*added = TRUE;
+	return rec->id;
+}
+
+#ifdef __linux__
+static gboolean janus_recordplay_nfo_matches(gpointer key, gpointer value, gpointer user_data) {
+	return *((guint64 *)value) == *((guint64 *)user_data);
+}
+#endif
+
 void janus_recordplay_update_recordings_list(void) {
 	if(recordings_path == NULL)
 		return;
+#ifdef __linux__
+	if(inotify_thread != NULL) {
+		/* The inotify thread is keeping the list up to date incrementally,
+		 * so there's nothing for a full rescan to find */
+		JANUS_LOG(LOG_VERB, "Recordings list kept up to date via inotify, skipping rescan\n");
+		return;
+	}
+#endif
 	JANUS_LOG(LOG_VERB, "Updating recordings list in %s\n", recordings_path);
 	janus_mutex_lock(&recordings_mutex);
 	/* First of all, let's keep track of which recordings are currently available */
@@ -2167,7 +2397,6 @@ void janus_recordplay_update_recordings_list(void) {
 		return;
 	}
 	struct dirent *recent = NULL;
-	char recpath[1024];
 	while((recent = readdir(dir))) {
 		int len = strlen(recent->d_name);
 		if(len < 4)
@@ -2175,126 +2404,17 @@ void janus_recordplay_update_recordings_list(void) {
 		if(strcasecmp(recent->d_name+len-4, ".nfo"))
 			continue;
 		JANUS_LOG(LOG_VERB, "Importing recording '%s'...\n", recent->d_name);
-		memset(recpath, 0, 1024);
-		g_snprintf(recpath, 1024, "%s/%s", recordings_path, recent->d_name);
-		janus_config *nfo = janus_config_parse(recpath);
-		if(nfo == NULL) {
-			JANUS_LOG(LOG_ERR, "Invalid recording '%s'...\n", recent->d_name);
-			continue;
-		}
-		GList *cl = janus_config_get_categories(nfo, NULL);
-		if(cl == NULL || cl->data == NULL) {
-			JANUS_LOG(LOG_WARN, "No recording info in '%s', skipping...\n", recent->d_name);
-			janus_config_destroy(nfo);
-			continue;
-		}
-		janus_config_category *cat = (janus_config_category *)cl->data;
-		guint64 id = g_ascii_strtoull(cat->name, NULL, 0);
-		if(id == 0) {
-			JANUS_LOG(LOG_WARN, "Invalid ID, skipping...\n");
-			g_list_free(cl);
-			janus_config_destroy(nfo);
-			continue;
-		}
-		janus_recordplay_recording *rec = g_hash_table_lookup(recordings, &id);
-		if(rec != NULL) {
+		gboolean added = FALSE;
+		guint64 id = janus_recordplay_import_recording(recent->d_name, &added);
+		if(id != 0 && !added) {
 			JANUS_LOG(LOG_VERB, "Skipping recording with ID %"SCNu64", it's already in the list...\n", id);
-			g_list_free(cl);
-			janus_config_destroy(nfo);
-			/* Mark that we updated this recording */
-			old_recordings = g_list_remove(old_recordings, &rec->id);
-			janus_refcount_decrease(&rec->ref);
-			continue;
-		}
-		janus_config_item *name = janus_config_get(nfo, cat, janus_config_type_item, "name");
-		janus_config_item *date = janus_config_get(nfo, cat, janus_config_type_item, "date");
-		janus_config_item *audio = janus_config_get(nfo, cat, janus_config_type_item, "audio");
-		janus_config_item *video = janus_config_get(nfo, cat, janus_config_type_item, "video");
-		janus_config_item *data = janus_config_get(nfo, cat, janus_config_type_item, "data");
-		if(!name || !name->value || strlen(name->value) == 0 || !date || !date->value || strlen(date->value) == 0) {
-			JANUS_LOG(LOG_WARN, "Invalid info for recording %"SCNu64", skipping...\n", id);
-			g_list_free(cl);
-			janus_config_destroy(nfo);
-			continue;
-		}
-		if((!audio || !audio->value) && (!video || !video->value)) {
-			JANUS_LOG(LOG_WARN, "No audio and no video in recording %"SCNu64", skipping...\n", id);
-			janus_config_destroy(nfo);
-			continue;
-		}
-		rec = g_malloc0(sizeof(janus_recordplay_recording));
-		rec->id = id;
-		rec->name = g_strdup(name->value);
-		rec->date = g_strdup(date->value);
-		if(audio && audio->value) {
-			rec->arc_file = g_strdup(audio->value);
-			char *ext = strstr(rec->arc_file, ".mjr");
-			if(ext != NULL)
-				*ext = '\0';
-			/* Check which codec is in this recording (and if it's end-to-end encrypted) */
-			gboolean e2ee = FALSE;
-			char fmtp[256];
-			fmtp[0] = '\0';
-			rec->acodec = janus_audiocodec_from_name(janus_recordplay_parse_codec(recordings_path,
-				rec->arc_file, fmtp, sizeof(fmtp), &rec->audiolevel_ext_id, NULL, &rec->opusred_pt, &e2ee));
-			if(strlen(fmtp) > 0)
-				rec->afmtp = g_strdup(fmtp);
-			if(e2ee)
-				rec->e2ee = TRUE;
-		}
-		if(video && video->value) {
-			rec->vrc_file = g_strdup(video->value);
-			char *ext = strstr(rec->vrc_file, ".mjr");
-			if(ext != NULL)
-				*ext = '\0';
-			/* Check which codec is in this recording (and if it's end-to-end encrypted) */
-			gboolean e2ee = FALSE;
-			char fmtp[256];
-			fmtp[0] = '\0';
-			rec->vcodec = janus_videocodec_from_name(janus_recordplay_parse_codec(recordings_path,
-				rec->vrc_file, fmtp, sizeof(fmtp), NULL, &rec->videoorient_ext_id, NULL, &e2ee));
-			if(strlen(fmtp) > 0)
-				rec->vfmtp = g_strdup(fmtp);
-			if(e2ee)
-				rec->e2ee = TRUE;
-		}
-		if(data && data->value) {
-			rec->drc_file = g_strdup(data->value);
-			char *ext = strstr(rec->drc_file, ".mjr");
-			if(ext != NULL)
-				*ext = '\0';
-			const char *textcodec = janus_recordplay_parse_codec(recordings_path,
-				rec->drc_file, NULL, sizeof(NULL), NULL, NULL, NULL, NULL);
-			rec->textdata = textcodec && (!strcasecmp(textcodec, "text"));
-		}
-		rec->audio_pt = AUDIO_PT;
-		if(rec->opusred_pt > 0 && rec->audio_pt == rec->opusred_pt)
-			rec->audio_pt++;
-		if(rec->acodec != JANUS_AUDIOCODEC_NONE) {
-			/* Some audio codecs have a fixed payload type that we can't mess with */
-			if(rec->acodec == JANUS_AUDIOCODEC_PCMU)
-				rec->audio_pt = 0;
-			else if(rec->acodec == JANUS_AUDIOCODEC_PCMA)
-				rec->audio_pt = 8;
-			else if(rec->acodec == JANUS_AUDIOCODEC_G722)
-				rec->audio_pt = 9;
-		}
-		rec->video_pt = VIDEO_PT;
-		rec->viewers = NULL;
-		if(janus_recordplay_generate_offer(rec) < 0) {
-			JANUS_LOG(LOG_WARN, "Could not generate offer for recording %"SCNu64"...\n", rec->id);
+			janus_recordplay_recording *rec = g_hash_table_lookup(recordings, &id);
+			if(rec != NULL) {
+				/* Mark that we updated this recording */
+				old_recordings = g_list_remove(old_recordings, &rec->id);
+				janus_refcount_decrease(&rec->ref);
+			}
 		}
-		g_atomic_int_set(&rec->paused, 0);
-		g_atomic_int_set(&rec->destroyed, 0);
-		g_atomic_int_set(&rec->completed, 1);
-		janus_refcount_init(&rec->ref, janus_recordplay_recording_free);
-		janus_mutex_init(&rec->mutex);
-
-		g_list_free(cl);
-		janus_config_destroy(nfo);
-
-		/* Add to the list of recordings */
-		g_hash_table_insert(recordings, janus_uint64_dup(rec->id), rec);
 	}
 	closedir(dir);
 	/* Now let's check if any of the previously existing recordings was removed */
@@ -2306,6 +2426,10 @@ void janus_recordplay_update_recordings_list(void) {
 			if(old_rec != NULL) {
 				/* Remove it */
 				g_hash_table_remove(recordings, &id);
+#ifdef __linux__
+				if(nfofiles != NULL)
+					g_hash_table_foreach_remove(nfofiles, janus_recordplay_nfo_matches, &id);
+#endif
 				janus_refcount_decrease(&old_rec->ref);
 			}
 			old_recordings = old_recordings->next;
@@ -2315,6 +2439,63 @@ void janus_recordplay_update_recordings_list(void) {
 	janus_mutex_unlock(&recordings_mutex);
 }
 
+#ifdef __linux__
+/* Thread to incrementally update the recordings list as .nfo files are
+ * added to, or removed from, the recordings folder */
+static void *janus_recordplay_inotify_thread(void *data) {
+	JANUS_LOG(LOG_VERB, "Joining recordings inotify thread\n");
+	char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	struct pollfd fds = { .fd = inotify_fd, .events = POLLIN };
+	while(!g_atomic_int_get(&stopping)) {
+		int res = poll(&fds, 1, 1000);
+		if(res == 0)
+			continue;
+		if(res < 0) {
+			if(errno == EINTR)
+				continue;
+			JANUS_LOG(LOG_ERR, "Error polling the inotify descriptor... %d (%s)\n", errno, g_strerror(errno));
+			break;
+		}
+		ssize_t bytes = read(inotify_fd, buffer, sizeof(buffer)), offset = 0;
+		if(bytes < 0) {
+			if(errno == EINTR || errno == EAGAIN)
+				continue;
+			JANUS_LOG(LOG_ERR, "Error reading inotify events... %d (%s)\n", errno, g_strerror(errno));
+			break;
+		}
+		while(offset < bytes) {
+			struct inotify_event *event = (struct inotify_event *)(buffer + offset);
+			offset += sizeof(struct inotify_event) + event->len;
+			if(event->len == 0)
+				continue;
+			int len = strlen(event->name);
+			if(len < 4 || strcasecmp(event->name+len-4, ".nfo"))
+				continue;
+			if(event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+				/* A new (or updated) metadata file, import the recording */
+				JANUS_LOG(LOG_VERB, "Importing recording '%s'...\n", event->name);
+				janus_mutex_lock(&recordings_mutex);
+				gboolean added = FALSE;
+				(void)janus_recordplay_import_recording(event->name, &added);
+				janus_mutex_unlock(&recordings_mutex);
+			} else if(event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+				/* The metadata file is gone, get rid of the related recording */
+				janus_mutex_lock(&recordings_mutex);
+				guint64 *id = g_hash_table_lookup(nfofiles, event->name);
+				if(id != NULL) {
+					JANUS_LOG(LOG_VERB, "Recording %"SCNu64" is not available anymore, removing...\n", *id);
+					g_hash_table_remove(recordings, id);
+					g_hash_table_remove(nfofiles, event->name);
+				}
+				janus_mutex_unlock(&recordings_mutex);
+			}
+		}
+	}
+	JANUS_LOG(LOG_VERB, "Leaving recordings inotify thread\n");
+	return NULL;
+}
+#endif
+
 janus_recordplay_frame_packet *janus_recordplay_get_frames(const char *dir, const char *filename) {
 	if(!dir || !filename)
 		return NULL;
@@ -2665,6 +2846,45 @@ janus_recordplay_frame_packet *janus_recordplay_get_frames(const char *dir, cons
 	return list;
 }
 
+/* Helper to memory-map a recording for playback: as the mapping is read-only
+ * and shared, concurrent playbacks of the same file all hit the same pages */
+static char *janus_recordplay_map_recording(const char *filename, int *fd, size_t *size) {
+	char source[1024];
+	if(strstr(filename, ".mjr"))
+		g_snprintf(source, 1024, "%s/%s", recordings_path, filename);
+	else
+		g_snprintf(source, 1024, "%s/%s.mjr", recordings_path, filename);
+	*fd = open(source, O_RDONLY);
+	if(*fd < 0) {
+		JANUS_LOG(LOG_ERR, "Could not open file %s... %s\n", source, g_strerror(errno));
+		return NULL;
+	}
+	struct stat st;
+	if(fstat(*fd, &st) < 0 || st.st_size == 0) {
+		JANUS_LOG(LOG_ERR, "Could not stat file %s... %s\n", source, g_strerror(errno));
+		close(*fd);
+		*fd = -1;
+		return NULL;
+	}
+	char *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, *fd, 0);
+	if(map == MAP_FAILED) {
+		JANUS_LOG(LOG_ERR, "Could not map file %s... %s\n", source, g_strerror(errno));
+		close(*fd);
+		*fd = -1;
+		return NULL;
+	}
+	/* Playback walks the file in order, so ask the kernel for aggressive
+	 * readahead: this keeps the prefetching ahead of the playout clock,
+	 * so that recorders hammering the same volume don't turn every page
+	 * fault into a read stall (and so into a playout underrun) */
+	(void)madvise(map, st.st_size, MADV_SEQUENTIAL);
+	/* Also warm up the head of the file right away, so that the first
+	 * frames don't have to fault on a cold cache mid-playout */
+	(void)madvise(map, st.st_size > (8*1024*1024) ? (8*1024*1024) : st.st_size, MADV_WILLNEED);
+	*size = (size_t)st.st_size;
+	return map;
+}
+
 static void *janus_recordplay_playout_thread(void *sessiondata) {
 	janus_recordplay_session *session = (janus_recordplay_session *)sessiondata;
 	if(!session) {
@@ -2695,8 +2915,10 @@ static void *janus_recordplay_playout_thread(void *sessiondata) {
 		return NULL;
 	}
 	JANUS_LOG(LOG_VERB, "Joining playout thread\n");
-	/* Open the files */
-	FILE *afile = NULL, *vfile = NULL, *dfile = NULL;
+	/* Map the files in memory */
+	int afd = -1, vfd = -1, dfd = -1;
+	char *amap = NULL, *vmap = NULL, *dmap = NULL;
+	size_t asize = 0, vsize = 0, dsize = 0;
 	if(session->aframes) {
 		if(rec->arc_file == NULL) {
 			janus_refcount_decrease(&rec->ref);
@@ -2705,16 +2927,11 @@ static void *janus_recordplay_playout_thread(void *sessiondata) {
 			g_thread_unref(g_thread_self());
 			return NULL;
 		}
-		char source[1024];
-		if(strstr(rec->arc_file, ".mjr"))
-			g_snprintf(source, 1024, "%s/%s", recordings_path, rec->arc_file);
-		else
-			g_snprintf(source, 1024, "%s/%s.mjr", recordings_path, rec->arc_file);
-		afile = fopen(source, "rb");
-		if(afile == NULL) {
+		amap = janus_recordplay_map_recording(rec->arc_file, &afd, &asize);
+		if(amap == NULL) {
 			janus_refcount_decrease(&rec->ref);
 			janus_refcount_decrease(&session->ref);
-			JANUS_LOG(LOG_ERR, "Could not open audio file %s, can't start playout thread...\n", source);
+			JANUS_LOG(LOG_ERR, "Could not map audio file %s, can't start playout thread...\n", rec->arc_file);
 			g_thread_unref(g_thread_self());
 			return NULL;
 		}
@@ -2724,25 +2941,26 @@ static void *janus_recordplay_playout_thread(void *sessiondata) {
 			janus_refcount_decrease(&rec->ref);
 			janus_refcount_decrease(&session->ref);
 			JANUS_LOG(LOG_ERR, "The recording session contains some video packets but seems to lack a recording file name\n");
-			if(afile)
-				fclose(afile);
-			afile = NULL;
+			if(amap)
+				munmap(amap, asize);
+			amap = NULL;
+			if(afd > -1)
+				close(afd);
+			afd = -1;
 			g_thread_unref(g_thread_self());
 			return NULL;
 		}
-		char source[1024];
-		if(strstr(rec->vrc_file, ".mjr"))
-			g_snprintf(source, 1024, "%s/%s", recordings_path, rec->vrc_file);
-		else
-			g_snprintf(source, 1024, "%s/%s.mjr", recordings_path, rec->vrc_file);
-		vfile = fopen(source, "rb");
-		if(vfile == NULL) {
+		vmap = janus_recordplay_map_recording(rec->vrc_file, &vfd, &vsize);
+		if(vmap == NULL) {
 			janus_refcount_decrease(&rec->ref);
 			janus_refcount_decrease(&session->ref);
-			JANUS_LOG(LOG_ERR, "Could not open video file %s, can't start playout thread...\n", source);
-			if(afile)
-				fclose(afile);
-			afile = NULL;
+			JANUS_LOG(LOG_ERR, "Could not map video file %s, can't start playout thread...\n", rec->vrc_file);
+			if(amap)
+				munmap(amap, asize);
+			amap = NULL;
+			if(afd > -1)
+				close(afd);
+			afd = -1;
 			g_thread_unref(g_thread_self());
 			return NULL;
 		}
@@ -2753,31 +2971,38 @@ static void *janus_recordplay_playout_thread(void *sessiondata) {
 			janus_refcount_decrease(&rec->ref);
 			janus_refcount_decrease(&session->ref);
 			JANUS_LOG(LOG_ERR, "The recording session contains some data packets but seems to lack a recording file name\n");
-			if(afile)
-				fclose(afile);
-			afile = NULL;
-			if(vfile)
-				fclose(vfile);
-			vfile = NULL;
+			if(amap)
+				munmap(amap, asize);
+			amap = NULL;
+			if(afd > -1)
+				close(afd);
+			afd = -1;
+			if(vmap)
+				munmap(vmap, vsize);
+			vmap = NULL;
+			if(vfd > -1)
+				close(vfd);
+			vfd = -1;
 			g_thread_unref(g_thread_self());
 			return NULL;
 		}
-		char source[1024];
-		if(strstr(rec->drc_file, ".mjr"))
-			g_snprintf(source, 1024, "%s/%s", recordings_path, rec->drc_file);
-		else
-			g_snprintf(source, 1024, "%s/%s.mjr", recordings_path, rec->drc_file);
-		dfile = fopen(source, "rb");
-		if(dfile == NULL) {
+		dmap = janus_recordplay_map_recording(rec->drc_file, &dfd, &dsize);
+		if(dmap == NULL) {
 			janus_refcount_decrease(&rec->ref);
 			janus_refcount_decrease(&session->ref);
-			JANUS_LOG(LOG_ERR, "Could not open data file %s, can't start playout thread...\n", source);
-			if(afile)
-				fclose(afile);
-			afile = NULL;
-			if(vfile)
-				fclose(vfile);
-			vfile = NULL;
+			JANUS_LOG(LOG_ERR, "Could not map data file %s, can't start playout thread...\n", rec->drc_file);
+			if(amap)
+				munmap(amap, asize);
+			amap = NULL;
+			if(afd > -1)
+				close(afd);
+			afd = -1;
+			if(vmap)
+				munmap(vmap, vsize);
+			vmap = NULL;
+			if(vfd > -1)
+				close(vfd);
+			vfd = -1;
 			g_thread_unref(g_thread_self());
 			return NULL;
 		}
@@ -2816,10 +3041,12 @@ static void *janus_recordplay_playout_thread(void *sessiondata) {
 		if(audio) {
 			if(audio == session->aframes) {
 				/* First packet, send now */
-				fseek(afile, audio->offset, SEEK_SET);
-				bytes = fread(buffer, sizeof(char), audio->len, afile);
-				if(bytes != audio->len)
+				bytes = audio->len;
+				if((size_t)(audio->offset + bytes) > asize) {
+					bytes = audio->offset < (long)asize ? (int)(asize - (size_t)audio->offset) : 0;
 					JANUS_LOG(LOG_WARN, "Didn't manage to read all the bytes we needed (%d < %d)...\n", bytes, audio->len);
+				}
+				memcpy(buffer, amap + audio->offset, bytes);
 				/* Update payload type */
 				janus_rtp_header *rtp = (janus_rtp_header *)buffer;
 				if(rec->opusred_pt == 0 || rtp->type != rec->opusred_pt)
@@ -2878,10 +3105,12 @@ static void *janus_recordplay_playout_thread(void *sessiondata) {
 						abefore.tv_usec -= ts_diff/1000000;
 					}
 					/* Send now */
-					fseek(afile, audio->offset, SEEK_SET);
-					bytes = fread(buffer, sizeof(char), audio->len, afile);
-					if(bytes != audio->len)
+					bytes = audio->len;
+					if((size_t)(audio->offset + bytes) > asize) {
+						bytes = audio->offset < (long)asize ? (int)(asize - (size_t)audio->offset) : 0;
 						JANUS_LOG(LOG_WARN, "Didn't manage to read all the bytes we needed (%d < %d)...\n", bytes, audio->len);
+					}
+					memcpy(buffer, amap + audio->offset, bytes);
 					/* Update payload type */
 					janus_rtp_header *rtp = (janus_rtp_header *)buffer;
 					if(rec->opusred_pt == 0 || rtp->type != rec->opusred_pt)
@@ -2918,10 +3147,12 @@ static void *janus_recordplay_playout_thread(void *sessiondata) {
 				/* First packets: there may be many of them with the same timestamp, send them all */
 				uint64_t ts = video->ts;
 				while(video && video->ts == ts) {
-					fseek(vfile, video->offset, SEEK_SET);
-					bytes = fread(buffer, sizeof(char), video->len, vfile);
-					if(bytes != video->len)
+					bytes = video->len;
+					if((size_t)(video->offset + bytes) > vsize) {
+						bytes = video->offset < (long)vsize ? (int)(vsize - (size_t)video->offset) : 0;
 						JANUS_LOG(LOG_WARN, "Didn't manage to read all the bytes we needed (%d < %d)...\n", bytes, video->len);
+					}
+					memcpy(buffer, vmap + video->offset, bytes);
 					/* Update payload type */
 					janus_rtp_header *rtp = (janus_rtp_header *)buffer;
 					rtp->type = video_pt;
@@ -2964,10 +3195,12 @@ static void *janus_recordplay_playout_thread(void *sessiondata) {
 					uint64_t ts = video->ts;
 					while(video && video->ts == ts) {
 						/* Send now */
-						fseek(vfile, video->offset, SEEK_SET);
-						bytes = fread(buffer, sizeof(char), video->len, vfile);
-						if(bytes != video->len)
+						bytes = video->len;
+						if((size_t)(video->offset + bytes) > vsize) {
+							bytes = video->offset < (long)vsize ? (int)(vsize - (size_t)video->offset) : 0;
 							JANUS_LOG(LOG_WARN, "Didn't manage to read all the bytes we needed (%d < %d)...\n", bytes, video->len);
+						}
+						memcpy(buffer, vmap + video->offset, bytes);
 						/* Update payload type */
 						janus_rtp_header *rtp = (janus_rtp_header *)buffer;
 						rtp->type = video_pt;
@@ -3009,10 +3242,12 @@ static void *janus_recordplay_playout_thread(void *sessiondata) {
 					dbefore.tv_usec -= ts_diff/1000000;
 				}
 				/* Read data packet */
-				fseek(dfile, data->offset, SEEK_SET);
-				bytes = fread(buffer, sizeof(char), data->len, dfile);
-				if(bytes != data->len)
+				bytes = data->len;
+				if((size_t)(data->offset + bytes) > dsize) {
+					bytes = data->offset < (long)dsize ? (int)(dsize - (size_t)data->offset) : 0;
 					JANUS_LOG(LOG_WARN, "Didn't manage to read all the bytes we needed (%d < %d)...\n", bytes, data->len);
+				}
+				memcpy(buffer, dmap + data->offset, bytes);
 				/* Update payload type */
 				janus_plugin_data datapacket = {
 					.label = NULL,
@@ -3030,39 +3265,30 @@ static void *janus_recordplay_playout_thread(void *sessiondata) {
 
 	g_free(buffer);
 
-	/* Get rid of the indexes */
-	janus_recordplay_frame_packet *tmp = NULL;
-	audio = session->aframes;
-	while(audio) {
-		tmp = audio->next;
-		g_free(audio);
-		audio = tmp;
-	}
+	/* The indexes are owned by the recording and shared with other
+	 * viewers, so we just detach from them rather than free them */
 	session->aframes = NULL;
-	video = session->vframes;
-	while(video) {
-		tmp = video->next;
-		g_free(video);
-		video = tmp;
-	}
 	session->vframes = NULL;
-	data = session->dframes;
-	while(data) {
-		tmp = data->next;
-		g_free(data);
-		data = tmp;
-	}
 	session->dframes = NULL;
 
-	if(afile)
-		fclose(afile);
-	afile = NULL;
-	if(vfile)
-		fclose(vfile);
-	vfile = NULL;
-	if(dfile)
-		fclose(dfile);
-	dfile = NULL;
+	if(amap)
+		munmap(amap, asize);
+	amap = NULL;
+	if(afd > -1)
+		close(afd);
+	afd = -1;
+	if(vmap)
+		munmap(vmap, vsize);
+	vmap = NULL;
+	if(vfd > -1)
+		close(vfd);
+	vfd = -1;
+	if(dmap)
+		munmap(dmap, dsize);
+	dmap = NULL;
+	if(dfd > -1)
+		close(dfd);
+	dfd = -1;
 
 	/* Remove from the list of viewers */
 	janus_mutex_lock(&rec->mutex);
@@ -873,6 +873,17 @@ static uint16_t dtmf_keys[] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9',
 
 static gboolean query_contact_header = FALSE;
 
+/* When event_loops is configured, Sofia stacks are sharded on a pool of
+ * shared event loops, instead of each stack getting a dedicated thread */
+typedef struct janus_sip_event_loop {
+	int id;				/* Loop number */
+	su_root_t *root;	/* Sofia root this loop runs */
+	GThread *thread;	/* Thread running the loop */
+} janus_sip_event_loop;
+static janus_sip_event_loop *event_loops = NULL;
+static int num_event_loops = 0;
+static volatile gint next_event_loop = 0;
+
 static GThread *handler_thread;
 static void *janus_sip_handler(void *data);
 static void janus_sip_hangup_media_internal(janus_plugin_session *handle);
@@ -962,6 +973,7 @@ typedef struct ssip_oper_s ssip_oper_t;
 struct ssip_s {
 	su_home_t s_home[1];
 	su_root_t *s_root;
+	janus_sip_event_loop *loop;	/* Shared event loop the stack is sharded on, if any */
 	nua_t *s_nua;
 	nua_handle_t *s_nh_r, *s_nh_i, *s_nh_m;
 	char *contact_header;	/* Only needed for Sofia SIP >= 1.13 */
@@ -1520,6 +1532,11 @@ static void janus_sip_media_reset(janus_sip_session *session) {
 
 /* Sofia Event thread */
 gpointer janus_sip_sofia_thread(gpointer user_data);
+static gpointer janus_sip_loop_thread(gpointer user_data);
+static int janus_sip_loop_break(void *arg);
+static void janus_sip_sofia_stack_init(janus_sip_session *session);
+static int janus_sip_stack_setup(void *arg);
+static void janus_sip_stack_teardown(su_root_magic_t *magic, su_msg_r msg, su_msg_arg_t *arg);
 /* Sofia callbacks */
 void janus_sip_sofia_callback(nua_event_t event, int status, char const *phrase, nua_t *nua, nua_magic_t *magic, nua_handle_t *nh, nua_hmagic_t *hmagic, sip_t const *sip, tagi_t tags[]);
 void janus_sip_save_reason(sip_t const *sip, janus_sip_session *session);
@@ -1531,6 +1548,8 @@ static int janus_sip_allocate_local_ports(janus_sip_session *session, gboolean u
 static void *janus_sip_relay_thread(void *data);
 static void janus_sip_media_cleanup(janus_sip_session *session);
 static void janus_sip_check_rfc2833(janus_sip_session *session, char *buffer, int len);
+/* How many packets we can drain from a media socket per poll wakeup in the relay thread */
+#define JANUS_SIP_RELAY_BATCH_MAX	20
 
 /* URI parsing utilities */
 
@@ -1929,6 +1948,15 @@ int janus_sip_init(janus_callbacks *callback, const char *config_path) {
 			JANUS_LOG(LOG_VERB, "SIP Timer T1X64 set to %d milliseconds\n", sip_timer_t1x64);
 		}
 
+		item = janus_config_get(config, config_general, janus_config_type_item, "event_loops");
+		if(item && item->value) {
+			num_event_loops = atoi(item->value);
+			if(num_event_loops < 0) {
+				JANUS_LOG(LOG_ERR, "Invalid number of event loops: %d (will use a thread per stack)\n", num_event_loops);
+				num_event_loops = 0;
+			}
+		}
+
 		item = janus_config_get(config, config_general, janus_config_type_item, "register_ttl");
 		if(item && item->value)
 			register_ttl = atoi(item->value);
@@ -2045,6 +2073,34 @@ int janus_sip_init(janus_callbacks *callback, const char *config_path) {
 
 	/* Setup sofia */
 	su_init();
+	if(num_event_loops > 0) {
+		/* Create the pool of event loops Sofia stacks will be sharded on */
+		JANUS_LOG(LOG_INFO, "Sharding Sofia stacks on %d shared event loops\n", num_event_loops);
+		event_loops = g_malloc0(num_event_loops * sizeof(janus_sip_event_loop));
+		int i = 0;
+		for(i=0; i<num_event_loops; i++) {
+			event_loops[i].id = i;
+			event_loops[i].root = su_root_create(NULL);
+			GError *error = NULL;
+			char tname[16];
+			g_snprintf(tname, sizeof(tname), "sip loop %d", i);
+			event_loops[i].thread = g_thread_try_new(tname, janus_sip_loop_thread, &event_loops[i], &error);
+			if(error != NULL) {
+				JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch a Sofia event loop thread...\n",
+					error->code, error->message ? error->message : "??");
+				g_error_free(error);
+				su_root_destroy(event_loops[i].root);
+				num_event_loops = i;
+				break;
+			}
+		}
+		if(num_event_loops == 0) {
+			/* We couldn't spawn any loop, fall back to a thread per stack */
+			JANUS_LOG(LOG_WARN, "No Sofia event loop available, falling back to a thread per stack\n");
+			g_free(event_loops);
+			event_loops = NULL;
+		}
+	}
 	if(notify_events && callback->events_is_enabled()) {
 		JANUS_LOG(LOG_WARN, "sofia-sip logs are going to be redirected and they will not be shown in the process output\n");
 		/* Enable the transport logging, as we want to have access to the SIP messages */
@@ -2133,6 +2189,23 @@ void janus_sip_destroy(void) {
 	g_atomic_int_set(&initialized, 0);
 	g_atomic_int_set(&stopping, 0);
 
+	if(event_loops != NULL) {
+		/* Stop the shared event loops and wait for their threads */
+		int i = 0;
+		for(i=0; i<num_event_loops; i++) {
+			su_task_execute(su_root_task(event_loops[i].root), janus_sip_loop_break, event_loops[i].root, NULL);
+			if(event_loops[i].thread != NULL) {
+				g_thread_join(event_loops[i].thread);
+				event_loops[i].thread = NULL;
+			}
+			su_root_destroy(event_loops[i].root);
+			event_loops[i].root = NULL;
+		}
+		g_free(event_loops);
+		event_loops = NULL;
+		num_event_loops = 0;
+	}
+
 	/* Deinitialize sofia */
 	su_deinit();
 
@@ -3209,7 +3282,26 @@ static void *janus_sip_handler(void *data) {
 			}
 
 			session->account.registration_status = janus_sip_registration_status_registering;
-			if(!refresh && session->stack == NULL) {
+			if(!refresh && session->stack == NULL && event_loops != NULL) {
+				/* Shard the new stack on one of the shared event loops (round-robin):
+				 * the nua must be created from the loop thread, so do that synchronously */
+				janus_sip_event_loop *loop = &event_loops[g_atomic_int_add(&next_event_loop, 1) % num_event_loops];
+				session->stack = g_malloc0(sizeof(ssip_t));
+				su_home_init(session->stack->s_home);
+				session->stack->session = session;
+				session->stack->s_root = loop->root;
+				session->stack->loop = loop;
+				janus_mutex_init(&session->stack->smutex);
+				janus_refcount_increase(&session->ref);
+				int res = 0;
+				if(su_task_execute(su_root_task(loop->root), janus_sip_stack_setup, session, &res) != 0 || res != 0) {
+					janus_refcount_decrease(&session->ref);
+					JANUS_LOG(LOG_ERR, "Error setting up the Sofia stack on event loop #%d\n", loop->id);
+					error_code = JANUS_SIP_ERROR_UNKNOWN_ERROR;
+					g_snprintf(error_cause, 512, "Error setting up the Sofia stack on a shared event loop");
+					goto error;
+				}
+			} else if(!refresh && session->stack == NULL) {
 				/* Start the thread first */
 				GError *error = NULL;
 				char tname[16];
@@ -5667,8 +5759,21 @@ void janus_sip_sofia_callback(nua_event_t event, int status, char const *phrase,
 					session->active_calls = g_list_remove(session->active_calls, s);
 				}
 				janus_mutex_unlock(&session->mutex);
-				/* End the event loop: su_root_run() will return */
-				su_root_break(ssip->s_root);
+				if(ssip->loop != NULL) {
+					/* The stack lives on a shared event loop: defer the teardown to
+					 * a message, as we can't destroy the nua from its own callback */
+					su_msg_r msg = SU_MSG_R_INIT;
+					if(su_msg_create(msg, su_root_task(ssip->s_root), su_root_task(ssip->s_root),
+							janus_sip_stack_teardown, sizeof(janus_sip_session *)) == 0) {
+						*(janus_sip_session **)su_msg_data(msg) = session;
+						su_msg_send(msg);
+					} else {
+						JANUS_LOG(LOG_ERR, "[SIP-%s] Error deferring the Sofia stack teardown...\n", session->account.username);
+					}
+				} else {
+					/* End the event loop: su_root_run() will return */
+					su_root_break(ssip->s_root);
+				}
 			}
 			break;
 		case nua_r_terminate:
@@ -7197,169 +7302,206 @@ static void *janus_sip_relay_thread(void *data) {
 				}
 				/* Got an RTP/RTCP packet */
 				if(session->media.audio_rtp_fd != -1 && fds[i].fd == session->media.audio_rtp_fd) {
-					/* Got something audio (RTP) */
-					addrlen = sizeof(remote);
-					bytes = recvfrom(session->media.audio_rtp_fd, buffer, 1500, 0, (struct sockaddr*)&remote, &addrlen);
-					if(bytes < 0 || !janus_is_rtp(buffer, bytes)) {
-						/* Failed to read or not an RTP packet? */
-						continue;
-					}
-					pollerrs = 0;
-					if(!session->media.audio_recv) {
-						/* Dropping audio packet, we weren't expecting anything */
-						continue;
-					}
-					if(session->media.on_hold && session->media.hold_audio_dir != JANUS_SDP_RECVONLY) {
-						/* Dropping video packet, the call is on hold and we're not receiving anything */
-						continue;
-					}
-					janus_rtp_header *header = (janus_rtp_header *)buffer;
-					janus_sip_check_rfc2833(session, buffer, bytes);
-					if(session->media.audio_ssrc_peer == 0) {
-						session->media.audio_ssrc_peer = ntohl(header->ssrc);
-						JANUS_LOG(LOG_VERB, "Got SIP peer audio SSRC: %"SCNu32"\n", session->media.audio_ssrc_peer);
-					}
-					/* Is this SRTP? */
-					if(session->media.has_srtp_remote_audio) {
-						int buflen = bytes;
-						srtp_err_status_t res = srtp_unprotect(session->media.audio_srtp_in, buffer, &buflen);
-						if(res != srtp_err_status_ok && res != srtp_err_status_replay_fail && res != srtp_err_status_replay_old) {
-							guint32 timestamp = ntohl(header->timestamp);
-							guint16 seq = ntohs(header->seq_number);
-							JANUS_LOG(LOG_ERR, "[SIP-%s] Audio SRTP unprotect error: %s (len=%d-->%d, ts=%"SCNu32", seq=%"SCNu16")\n",
-								session->account.username, janus_srtp_error_str(res), bytes, buflen, timestamp, seq);
+					/* Got something audio (RTP): drain what's queued on the socket, so
+					 * that a single poll wakeup can service more than one packet */
+					int pkts = 0;
+					while(pkts < JANUS_SIP_RELAY_BATCH_MAX) {
+						addrlen = sizeof(remote);
+						bytes = recvfrom(session->media.audio_rtp_fd, buffer, 1500,
+							pkts > 0 ? MSG_DONTWAIT : 0, (struct sockaddr*)&remote, &addrlen);
+						if(bytes < 0) {
+							/* Failed to read, or nothing left to read */
+							break;
+						}
+						pkts++;
+						if(!janus_is_rtp(buffer, bytes)) {
+							/* Not an RTP packet? */
 							continue;
 						}
-						bytes = buflen;
-					}
-					/* Check if the SSRC changed (e.g., after a re-INVITE or UPDATE) */
-					janus_rtp_header_update(header, &session->media.acontext, FALSE, 0);
-					/* Save the frame if we're recording */
-					header->ssrc = htonl(session->media.audio_ssrc_peer);
-					janus_recorder_save_frame(session->arc_peer, buffer, bytes);
-					/* Relay to application */
-					janus_plugin_rtp rtp = { .mindex = -1, .video = FALSE, .buffer = buffer, .length = bytes };
-					janus_plugin_rtp_extensions_reset(&rtp.extensions);
-					/* Add audio-level extension, if present */
-					if(session->media.audio_level_extension_id != -1) {
-						gboolean vad = FALSE;
-						int level = -1;
-						if(janus_rtp_header_extension_parse_audio_level(buffer, bytes,
-								session->media.audio_level_extension_id, &vad, &level) == 0) {
-							rtp.extensions.audio_level = level;
-							rtp.extensions.audio_level_vad = vad;
+						pollerrs = 0;
+						if(!session->media.audio_recv) {
+							/* Dropping audio packet, we weren't expecting anything */
+							continue;
+						}
+						if(session->media.on_hold && session->media.hold_audio_dir != JANUS_SDP_RECVONLY) {
+							/* Dropping video packet, the call is on hold and we're not receiving anything */
+							continue;
+						}
+						janus_rtp_header *header = (janus_rtp_header *)buffer;
+						janus_sip_check_rfc2833(session, buffer, bytes);
+						if(session->media.audio_ssrc_peer == 0) {
+							session->media.audio_ssrc_peer = ntohl(header->ssrc);
+							JANUS_LOG(LOG_VERB, "Got SIP peer audio SSRC: %"SCNu32"\n", session->media.audio_ssrc_peer);
+						}
+						/* Is this SRTP? */
+						if(session->media.has_srtp_remote_audio) {
+							int buflen = bytes;
+							srtp_err_status_t res = srtp_unprotect(session->media.audio_srtp_in, buffer, &buflen);
+							if(res != srtp_err_status_ok && res != srtp_err_status_replay_fail && res != srtp_err_status_replay_old) {
+								guint32 timestamp = ntohl(header->timestamp);
+								guint16 seq = ntohs(header->seq_number);
+								JANUS_LOG(LOG_ERR, "[SIP-%s] Audio SRTP unprotect error: %s (len=%d-->%d, ts=%"SCNu32", seq=%"SCNu16")\n",
+									session->account.username, janus_srtp_error_str(res), bytes, buflen, timestamp, seq);
+								continue;
+							}
+							bytes = buflen;
+						}
+						/* Check if the SSRC changed (e.g., after a re-INVITE or UPDATE) */
+						janus_rtp_header_update(header, &session->media.acontext, FALSE, 0);
+						/* Save the frame if we're recording */
+						header->ssrc = htonl(session->media.audio_ssrc_peer);
+						janus_recorder_save_frame(session->arc_peer, buffer, bytes);
+						/* Relay to application */
+						janus_plugin_rtp rtp = { .mindex = -1, .video = FALSE, .buffer = buffer, .length = bytes };
+						janus_plugin_rtp_extensions_reset(&rtp.extensions);
+						/* Add audio-level extension, if present */
+						if(session->media.audio_level_extension_id != -1) {
+							gboolean vad = FALSE;
+							int level = -1;
+							if(janus_rtp_header_extension_parse_audio_level(buffer, bytes,
+									session->media.audio_level_extension_id, &vad, &level) == 0) {
+								rtp.extensions.audio_level = level;
+								rtp.extensions.audio_level_vad = vad;
+							}
 						}
+						gateway->relay_rtp(session->handle, &rtp);
 					}
-					gateway->relay_rtp(session->handle, &rtp);
 					continue;
 				} else if(session->media.audio_rtcp_fd != -1 && fds[i].fd == session->media.audio_rtcp_fd) {
 					/* Got something audio (RTCP) */
-					addrlen = sizeof(remote);
-					bytes = recvfrom(session->media.audio_rtcp_fd, buffer, 1500, 0, (struct sockaddr*)&remote, &addrlen);
-					if(bytes < 0 || !janus_is_rtcp(buffer, bytes)) {
-						/* Failed to read or not an RTCP packet? */
-						continue;
-					}
-					pollerrs = 0;
-					if(!session->media.video_recv) {
-						/* Dropping video packet, we weren't expecting anything */
-						continue;
-					}
-					if(session->media.on_hold && session->media.hold_video_dir != JANUS_SDP_RECVONLY) {
-						/* Dropping video packet, the call is on hold and we're not receiving anything */
-						continue;
-					}
-					/* Is this SRTCP? */
-					if(session->media.has_srtp_remote_audio) {
-						int buflen = bytes;
-						srtp_err_status_t res = srtp_unprotect_rtcp(session->media.audio_srtp_in, buffer, &buflen);
-						if(res != srtp_err_status_ok && res != srtp_err_status_replay_fail && res != srtp_err_status_replay_old) {
-							JANUS_LOG(LOG_ERR, "[SIP-%s] Audio SRTCP unprotect error: %s (len=%d-->%d)\n",
-								session->account.username, janus_srtp_error_str(res), bytes, buflen);
+					int pkts = 0;
+					while(pkts < JANUS_SIP_RELAY_BATCH_MAX) {
+						addrlen = sizeof(remote);
+						bytes = recvfrom(session->media.audio_rtcp_fd, buffer, 1500,
+							pkts > 0 ? MSG_DONTWAIT : 0, (struct sockaddr*)&remote, &addrlen);
+						if(bytes < 0) {
+							/* Failed to read, or nothing left to read */
+							break;
+						}
+						pkts++;
+						if(!janus_is_rtcp(buffer, bytes)) {
+							/* Not an RTCP packet? */
 							continue;
 						}
-						bytes = buflen;
+						pollerrs = 0;
+						if(!session->media.video_recv) {
+							/* Dropping video packet, we weren't expecting anything */
+							continue;
+						}
+						if(session->media.on_hold && session->media.hold_video_dir != JANUS_SDP_RECVONLY) {
+							/* Dropping video packet, the call is on hold and we're not receiving anything */
+							continue;
+						}
+						/* Is this SRTCP? */
+						if(session->media.has_srtp_remote_audio) {
+							int buflen = bytes;
+							srtp_err_status_t res = srtp_unprotect_rtcp(session->media.audio_srtp_in, buffer, &buflen);
+							if(res != srtp_err_status_ok && res != srtp_err_status_replay_fail && res != srtp_err_status_replay_old) {
+								JANUS_LOG(LOG_ERR, "[SIP-%s] Audio SRTCP unprotect error: %s (len=%d-->%d)\n",
+									session->account.username, janus_srtp_error_str(res), bytes, buflen);
+								continue;
+							}
+							bytes = buflen;
+						}
+						/* Relay to application */
+						janus_plugin_rtcp rtcp = { .mindex = -1, .video = FALSE, .buffer = buffer, bytes };
+						gateway->relay_rtcp(session->handle, &rtcp);
 					}
-					/* Relay to application */
-					janus_plugin_rtcp rtcp = { .mindex = -1, .video = FALSE, .buffer = buffer, bytes };
-					gateway->relay_rtcp(session->handle, &rtcp);
 					continue;
 				} else if(session->media.video_rtp_fd != -1 && fds[i].fd == session->media.video_rtp_fd) {
 					/* Got something video (RTP) */
-					addrlen = sizeof(remote);
-					bytes = recvfrom(session->media.video_rtp_fd, buffer, 1500, 0, (struct sockaddr*)&remote, &addrlen);
-					if(bytes < 0 || !janus_is_rtp(buffer, bytes)) {
-						/* Failed to read or not an RTP packet? */
-						continue;
-					}
-					pollerrs = 0;
-					janus_rtp_header *header = (janus_rtp_header *)buffer;
-					if(session->media.video_ssrc_peer == 0) {
-						session->media.video_ssrc_peer = ntohl(header->ssrc);
-						JANUS_LOG(LOG_VERB, "Got SIP peer video SSRC: %"SCNu32"\n", session->media.video_ssrc_peer);
-					}
-					/* Is this SRTP? */
-					if(session->media.has_srtp_remote_video) {
-						int buflen = bytes;
-						srtp_err_status_t res = srtp_unprotect(session->media.video_srtp_in, buffer, &buflen);
-						if(res != srtp_err_status_ok && res != srtp_err_status_replay_fail && res != srtp_err_status_replay_old) {
-							guint32 timestamp = ntohl(header->timestamp);
-							guint16 seq = ntohs(header->seq_number);
-							JANUS_LOG(LOG_ERR, "[SIP-%s] Video SRTP unprotect error: %s (len=%d-->%d, ts=%"SCNu32", seq=%"SCNu16")\n",
-								session->account.username, janus_srtp_error_str(res), bytes, buflen, timestamp, seq);
+					int pkts = 0;
+					while(pkts < JANUS_SIP_RELAY_BATCH_MAX) {
+						addrlen = sizeof(remote);
+						bytes = recvfrom(session->media.video_rtp_fd, buffer, 1500,
+							pkts > 0 ? MSG_DONTWAIT : 0, (struct sockaddr*)&remote, &addrlen);
+						if(bytes < 0) {
+							/* Failed to read, or nothing left to read */
+							break;
+						}
+						pkts++;
+						if(!janus_is_rtp(buffer, bytes)) {
+							/* Not an RTP packet? */
 							continue;
 						}
-						bytes = buflen;
-					}
-					/* Check if the SSRC changed (e.g., after a re-INVITE or UPDATE) */
-					janus_rtp_header_update(header, &session->media.vcontext, TRUE, 0);
-					/* Save the frame if we're recording */
-					header->ssrc = htonl(session->media.video_ssrc_peer);
-					janus_recorder_save_frame(session->vrc_peer, buffer, bytes);
-					/* Relay to application */
-					janus_plugin_rtp rtp = { .mindex = -1, .video = TRUE, .buffer = buffer, .length = bytes };
-					janus_plugin_rtp_extensions_reset(&rtp.extensions);
-					/* Add video-orientation extension, if present */
-					if(session->media.video_orientation_extension_id > 0) {
-						gboolean c = FALSE, f = FALSE, r1 = FALSE, r0 = FALSE;
-						if(janus_rtp_header_extension_parse_video_orientation(buffer, bytes,
-								session->media.video_orientation_extension_id, &c, &f, &r1, &r0) == 0) {
-							rtp.extensions.video_rotation = 0;
-							if(r1 && r0)
-								rtp.extensions.video_rotation = 270;
-							else if(r1)
-								rtp.extensions.video_rotation = 180;
-							else if(r0)
-								rtp.extensions.video_rotation = 90;
-							rtp.extensions.video_back_camera = c;
-							rtp.extensions.video_flipped = f;
+						pollerrs = 0;
+						janus_rtp_header *header = (janus_rtp_header *)buffer;
+						if(session->media.video_ssrc_peer == 0) {
+							session->media.video_ssrc_peer = ntohl(header->ssrc);
+							JANUS_LOG(LOG_VERB, "Got SIP peer video SSRC: %"SCNu32"\n", session->media.video_ssrc_peer);
+						}
+						/* Is this SRTP? */
+						if(session->media.has_srtp_remote_video) {
+							int buflen = bytes;
+							srtp_err_status_t res = srtp_unprotect(session->media.video_srtp_in, buffer, &buflen);
+							if(res != srtp_err_status_ok && res != srtp_err_status_replay_fail && res != srtp_err_status_replay_old) {
+								guint32 timestamp = ntohl(header->timestamp);
+								guint16 seq = ntohs(header->seq_number);
+								JANUS_LOG(LOG_ERR, "[SIP-%s] Video SRTP unprotect error: %s (len=%d-->%d, ts=%"SCNu32", seq=%"SCNu16")\n",
+									session->account.username, janus_srtp_error_str(res), bytes, buflen, timestamp, seq);
+								continue;
+							}
+							bytes = buflen;
+						}
+						/* Check if the SSRC changed (e.g., after a re-INVITE or UPDATE) */
+						janus_rtp_header_update(header, &session->media.vcontext, TRUE, 0);
+						/* Save the frame if we're recording */
+						header->ssrc = htonl(session->media.video_ssrc_peer);
+						janus_recorder_save_frame(session->vrc_peer, buffer, bytes);
+						/* Relay to application */
+						janus_plugin_rtp rtp = { .mindex = -1, .video = TRUE, .buffer = buffer, .length = bytes };
+						janus_plugin_rtp_extensions_reset(&rtp.extensions);
+						/* Add video-orientation extension, if present */
+						if(session->media.video_orientation_extension_id > 0) {
+							gboolean c = FALSE, f = FALSE, r1 = FALSE, r0 = FALSE;
+							if(janus_rtp_header_extension_parse_video_orientation(buffer, bytes,
+									session->media.video_orientation_extension_id, &c, &f, &r1, &r0) == 0) {
+								rtp.extensions.video_rotation = 0;
+								if(r1 && r0)
+									rtp.extensions.video_rotation = 270;
+								else if(r1)
+									rtp.extensions.video_rotation = 180;
+								else if(r0)
+									rtp.extensions.video_rotation = 90;
+								rtp.extensions.video_back_camera = c;
+								rtp.extensions.video_flipped = f;
+							}
 						}
+						gateway->relay_rtp(session->handle, &rtp);
 					}
-					gateway->relay_rtp(session->handle, &rtp);
 					continue;
 				} else if(session->media.video_rtcp_fd != -1 && fds[i].fd == session->media.video_rtcp_fd) {
 					/* Got something video (RTCP) */
-					addrlen = sizeof(remote);
-					bytes = recvfrom(session->media.video_rtcp_fd, buffer, 1500, 0, (struct sockaddr*)&remote, &addrlen);
-					if(bytes < 0 || !janus_is_rtcp(buffer, bytes)) {
-						/* Failed to read or not an RTCP packet? */
-						continue;
-					}
-					pollerrs = 0;
-					/* Is this SRTCP? */
-					if(session->media.has_srtp_remote_video) {
-						int buflen = bytes;
-						srtp_err_status_t res = srtp_unprotect_rtcp(session->media.video_srtp_in, buffer, &buflen);
-						if(res != srtp_err_status_ok && res != srtp_err_status_replay_fail && res != srtp_err_status_replay_old) {
-							JANUS_LOG(LOG_ERR, "[SIP-%s] Video SRTP unprotect error: %s (len=%d-->%d)\n",
-								session->account.username, janus_srtp_error_str(res), bytes, buflen);
+					int pkts = 0;
+					while(pkts < JANUS_SIP_RELAY_BATCH_MAX) {
+						addrlen = sizeof(remote);
+						bytes = recvfrom(session->media.video_rtcp_fd, buffer, 1500,
+							pkts > 0 ? MSG_DONTWAIT : 0, (struct sockaddr*)&remote, &addrlen);
+						if(bytes < 0) {
+							/* Failed to read, or nothing left to read */
+							break;
+						}
+						pkts++;
+						if(!janus_is_rtcp(buffer, bytes)) {
+							/* Not an RTCP packet? */
 							continue;
 						}
-						bytes = buflen;
+						pollerrs = 0;
+						/* Is this SRTCP? */
+						if(session->media.has_srtp_remote_video) {
+							int buflen = bytes;
+							srtp_err_status_t res = srtp_unprotect_rtcp(session->media.video_srtp_in, buffer, &buflen);
+							if(res != srtp_err_status_ok && res != srtp_err_status_replay_fail && res != srtp_err_status_replay_old) {
+								JANUS_LOG(LOG_ERR, "[SIP-%s] Video SRTP unprotect error: %s (len=%d-->%d)\n",
+									session->account.username, janus_srtp_error_str(res), bytes, buflen);
+								continue;
+							}
+							bytes = buflen;
+						}
+						/* Relay to application */
+						janus_plugin_rtcp rtcp = { .mindex = -1, .video = TRUE, .buffer = buffer, bytes };
+						gateway->relay_rtcp(session->handle, &rtcp);
 					}
-					/* Relay to application */
-					janus_plugin_rtcp rtcp = { .mindex = -1, .video = TRUE, .buffer = buffer, bytes };
-					gateway->relay_rtcp(session->handle, &rtcp);
 					continue;
 				}
 			}
@@ -7379,28 +7521,9 @@ static void *janus_sip_relay_thread(void *data) {
 
 
 /* Sofia Event thread */
-gpointer janus_sip_sofia_thread(gpointer user_data) {
-	janus_sip_session *session = (janus_sip_session *)user_data;
-	if(session == NULL) {
-		g_thread_unref(g_thread_self());
-		return NULL;
-	}
-	if(session->account.username == NULL) {
-		janus_refcount_decrease(&session->ref);
-		g_thread_unref(g_thread_self());
-		return NULL;
-	}
-	JANUS_LOG(LOG_VERB, "Joining sofia loop thread (%s)...\n", session->account.username);
-	session->stack = g_malloc0(sizeof(ssip_t));
-	su_home_init(session->stack->s_home);
-	session->stack->session = session;
-	session->stack->s_nua = NULL;
-	session->stack->s_nh_r = NULL;
-	session->stack->s_nh_i = NULL;
-	session->stack->s_nh_m = NULL;
-	session->stack->s_root = su_root_create(session->stack);
-	session->stack->subscriptions = NULL;
-	janus_mutex_init(&session->stack->smutex);
+/* Creates the nua stack of a session on its root: this runs either in the
+ * session's dedicated thread, or on a shared event loop via su_task_execute() */
+static void janus_sip_sofia_stack_init(janus_sip_session *session) {
 	JANUS_LOG(LOG_VERB, "Setting up sofia stack (sip:%s@%s)\n", session->account.username, local_ip);
 	char sip_url[128];
 	char sips_url[128];
@@ -7435,8 +7558,14 @@ gpointer janus_sip_sofia_thread(gpointer user_data) {
 				TAG_NULL());
 	if(query_contact_header)
 		nua_get_params(session->stack->s_nua, SIPTAG_FROM_STR(""), TAG_END());
-	su_root_run(session->stack->s_root);
-	/* When we get here, we're done */
+}
+
+/* Tears a session's nua stack down: on dedicated threads this is invoked
+ * after su_root_run() returns, while on shared event loops it's invoked by
+ * a message the shutdown callback posts to the loop, as we can't destroy
+ * the nua from within its own callback (the root itself is shared with
+ * other stacks there, so it's left alone) */
+static void janus_sip_sofia_stack_free(janus_sip_session *session) {
 	janus_mutex_lock(&session->stack->smutex);
 	nua_t *s_nua = session->stack->s_nua;
 	session->stack->s_nua = NULL;
@@ -7459,9 +7588,69 @@ gpointer janus_sip_sofia_thread(gpointer user_data) {
 	session->stack->subscriptions = NULL;
 	janus_mutex_unlock(&session->stack->smutex);
 	nua_destroy(s_nua);
-	su_root_destroy(session->stack->s_root);
 	session->stack->s_root = NULL;
 	janus_refcount_decrease(&session->ref);
+}
+
+/* Thread running one of the shared event loops, when sharding is enabled */
+static gpointer janus_sip_loop_thread(gpointer user_data) {
+	janus_sip_event_loop *loop = (janus_sip_event_loop *)user_data;
+	JANUS_LOG(LOG_VERB, "Joining Sofia event loop thread #%d...\n", loop->id);
+	su_root_run(loop->root);
+	JANUS_LOG(LOG_VERB, "Leaving Sofia event loop thread #%d...\n", loop->id);
+	return NULL;
+}
+
+/* Helper to break a shared event loop from its own thread, at shutdown */
+static int janus_sip_loop_break(void *arg) {
+	su_root_break((su_root_t *)arg);
+	return 0;
+}
+
+/* Creates a session's nua on the shared event loop it's been sharded on:
+ * executed on the loop thread, synchronously via su_task_execute() */
+static int janus_sip_stack_setup(void *arg) {
+	janus_sip_session *session = (janus_sip_session *)arg;
+	janus_sip_sofia_stack_init(session);
+	return session->stack->s_nua != NULL ? 0 : -1;
+}
+
+/* Deferred teardown of a stack living on a shared event loop */
+static void janus_sip_stack_teardown(su_root_magic_t *magic, su_msg_r msg, su_msg_arg_t *arg) {
+	janus_sip_session *session = *(janus_sip_session **)arg;
+	if(session == NULL || session->stack == NULL)
+		return;
+	janus_sip_sofia_stack_free(session);
+}
+
+gpointer janus_sip_sofia_thread(gpointer user_data) {
+	janus_sip_session *session = (janus_sip_session *)user_data;
+	if(session == NULL) {
+		g_thread_unref(g_thread_self());
+		return NULL;
+	}
+	if(session->account.username == NULL) {
+		janus_refcount_decrease(&session->ref);
+		g_thread_unref(g_thread_self());
+		return NULL;
+	}
+	JANUS_LOG(LOG_VERB, "Joining sofia loop thread (%s)...\n", session->account.username);
+	session->stack = g_malloc0(sizeof(ssip_t));
+	su_home_init(session->stack->s_home);
+	session->stack->session = session;
+	session->stack->s_nua = NULL;
+	session->stack->s_nh_r = NULL;
+	session->stack->s_nh_i = NULL;
+	session->stack->s_nh_m = NULL;
+	session->stack->s_root = su_root_create(session->stack);
+	session->stack->subscriptions = NULL;
+	janus_mutex_init(&session->stack->smutex);
+	janus_sip_sofia_stack_init(session);
+	su_root_run(session->stack->s_root);
+	/* When we get here, we're done */
+	su_root_t *s_root = session->stack->s_root;
+	janus_sip_sofia_stack_free(session);
+	su_root_destroy(s_root);
 	JANUS_LOG(LOG_VERB, "Leaving sofia loop thread...\n");
 	g_thread_unref(g_thread_self());
 	return NULL;
@@ -119,6 +119,9 @@ databuffermsg = true|false (whether the plugin should store the latest
 threads = number of threads to assist with the relaying part, which can help
 	if you expect a lot of viewers that may cause the RTP receiving part
 	in the Streaming plugin to slow down and fail to catch up (default=0)
+dvr = number of seconds of recent packets to keep in memory, so that viewers
+	can ask to start watching from the recent past by adding an "offset"
+	to their "watch" request (default=0, feature disabled)
 
 In case you want to use SRTP for your RTP-based mountpoint, you'll need
 to configure the SRTP-related properties as well, namely the suite to
@@ -159,7 +162,8 @@ rtsp_quirk = Some RTSP servers offer the stream using only the path, instead of
 	If set true, this boolean informs Janus that we should try a path-only DESCRIBE request if the initial request returns 404.
 rtsp_failcheck = whether an error should be returned if connecting to the RTSP server fails (default=true)
 rtspiface = network interface IP address or device name to listen on when receiving RTSP streams
-rtsp_reconnect_delay = after n seconds passed and no media assumed, the RTSP server has gone and schedule a reconnect (default=5s)
+rtsp_reconnect_delay = after n seconds passed and no media assumed, the RTSP server has gone and schedule a reconnect (default=5s;
+		doubled after each failed attempt, up to a minute, until the server is back)
 rtsp_session_timeout = by default the streaming plugin will check the RTSP connection with an OPTIONS query,
 	the value of the timeout comes from the RTSP session initializer and by default
 	this session timeout is the half of this value In some cases this value can be too high (for example more than one minute)
@@ -347,6 +351,9 @@ multistream-test: {
 		"viewers" : <count of current subscribers, if any>,
 		"enabled" : <true|false, depending on whether the mountpoint is currently enabled or not>,
 		"type" : "<type of mountpoint>",
+		"rtsp" : <true, only present if this is an RTSP mountpoint>,
+		"connected" : <true|false, whether the RTSP connection is up; only present for RTSP mountpoints>,
+		"reconnecting" : <true, only present if an RTSP reconnect is currently in progress>,
 		"media" : [
 			{
 				"mid" : "<unique mid of this stream>",
@@ -689,6 +696,7 @@ multistream-test: {
 	"media" : [
 		<array of mids to subscribe to, as strings; optional, missing or empty array subscribes to all mids>
 	]
+	"offset" : <seconds in the past to start watching from; optional, only has an effect on mountpoints with DVR support>,
 	"offer_audio" : <true|false; deprecated; whether or not audio should be negotiated; true by default if the mountpoint has audio>,
 	"offer_video" : <true|false; deprecated; whether or not video should be negotiated; true by default if the mountpoint has video>,
 	"offer_data" : <true|false; deprecated; whether or not datachannels should be negotiated; true by default if the mountpoint has datachannels>
@@ -715,6 +723,13 @@ multistream-test: {
  * of a mid is just interpreted as an "on" switch for that stream, meaning
  * it will be offered in the SDP.
  *
+ * In case the mountpoint was configured with DVR support (a \c dvr number
+ * of seconds of recent packets to keep in memory), the optional \c offset
+ * property allows the viewer to start watching from the recent past: the
+ * buffered history is replayed as soon as the PeerConnection is up, right
+ * before the live stream takes over. Notice that video replayed this way
+ * will only decode from the first keyframe the history contains.
+ *
  * \note For backwards compatibility, the deprecated \c offer_audio ,
  * \c offer_video and \c offer_data properties are also available. They
  * also allow you to only subscribe to a subset of the mountpoint media,
@@ -900,6 +915,10 @@ multistream-test: {
 #include <errno.h>
 #include <netdb.h>
 #include <sys/poll.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 
@@ -921,6 +940,7 @@ multistream-test: {
 #include "../config.h"
 #include "../mutex.h"
 #include "../rtp.h"
+#include "../rtpfwd.h"
 #include "../rtpsrtp.h"
 #include "../rtcp.h"
 #include "../record.h"
@@ -963,6 +983,7 @@ void janus_streaming_data_ready(janus_plugin_session *handle);
 void janus_streaming_hangup_media(janus_plugin_session *handle);
 void janus_streaming_destroy_session(janus_plugin_session *handle, int *error);
 json_t *janus_streaming_query_session(janus_plugin_session *handle);
+json_t *janus_streaming_query_state(void);
 static int janus_streaming_get_fd_port(int fd);
 
 /* Plugin setup */
@@ -989,6 +1010,7 @@ static janus_plugin janus_streaming_plugin =
 		.hangup_media = janus_streaming_hangup_media,
 		.destroy_session = janus_streaming_destroy_session,
 		.query_session = janus_streaming_query_session,
+		.query_state = janus_streaming_query_state,
 	);
 
 /* Plugin creator */
@@ -1017,6 +1039,7 @@ static struct janus_json_parameter watch_parameters[] = {
 	{"pin", JSON_STRING, 0},
 	{"media", JANUS_JSON_ARRAY, 0},
 	{"restart", JANUS_JSON_BOOL, 0},
+	{"offset", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	/* Deprecated parameters: still there only for
 	 * backwards compatibility, but not for long */
 	{"offer_audio", JANUS_JSON_BOOL, 0},
@@ -1054,6 +1077,7 @@ static struct janus_json_parameter create_parameters[] = {
 static struct janus_json_parameter rtp_parameters[] = {
 	{"collision", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"threads", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	{"dvr", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"srtpsuite", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"srtpcrypto", JSON_STRING, 0},
 	{"e2ee", JANUS_JSON_BOOL, 0},
@@ -1103,6 +1127,7 @@ static struct janus_json_parameter rtp_media_parameters[] = {
 	{"label", JANUS_JSON_STRING, 0},
 	{"msid", JANUS_JSON_STRING, 0},
 	{"mcast", JANUS_JSON_STRING, 0},
+	{"pipe", JANUS_JSON_STRING, 0},
 	{"iface", JANUS_JSON_STRING, 0},
 	{"port", JANUS_JSON_INTEGER, JANUS_JSON_PARAM_REQUIRED | JANUS_JSON_PARAM_POSITIVE},
 	{"rtcpport", JANUS_JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
@@ -1238,6 +1263,7 @@ static janus_mutex fd_mutex = JANUS_MUTEX_INITIALIZER;
 
 static void *janus_streaming_ondemand_thread(void *data);
 static void *janus_streaming_filesource_thread(void *data);
+static void *janus_streaming_ondemand_pacer(void *data);
 static void janus_streaming_relay_rtp_packet(gpointer data, gpointer user_data);
 static void janus_streaming_relay_rtcp_packet(gpointer data, gpointer user_data);
 static void *janus_streaming_relay_thread(void *data);
@@ -1285,6 +1311,8 @@ typedef struct janus_streaming_rtp_relay_packet {
 	janus_vp9_svc_info svc_info;
 	/* The following is only relevant for datachannels */
 	gboolean textdata;
+	/* When the packet was received (only set for packets kept in a DVR ring) */
+	gint64 received;
 } janus_streaming_rtp_relay_packet;
 static janus_streaming_rtp_relay_packet exit_packet;
 static void janus_streaming_rtp_relay_packet_free(janus_streaming_rtp_relay_packet *pkt) {
@@ -1330,9 +1358,10 @@ typedef struct janus_streaming_rtp_source {
 	gint64 ka_timeout;
 	char *rtsp_ahost, *rtsp_vhost;
 	janus_streaming_codecs rtsp_acodecs, rtsp_vcodecs;
-	gboolean rtsp_bufferkf, reconnecting;
+	gboolean rtsp_bufferkf, reconnecting, rtsp_connected;
 	gint64 reconnect_timer;
 	gint64 reconnect_delay;
+	gint64 reconnect_wait;
 	gint64 session_timeout;
 	int rtsp_timeout;
 	int rtsp_conn_timeout;
@@ -1387,6 +1416,7 @@ typedef struct janus_streaming_rtp_source_stream {
 	char *mid, *label, *msid, *mstid;
 	janus_streaming_codecs codecs;
 	char *host;
+	char *pipe_name;	/* Name of the local pipe feeding this stream in-process, if any */
 	gint port[3], remote_port;
 	gint rtcp_port, remote_rtcp_port;
 	in_addr_t mcast;
@@ -1414,6 +1444,9 @@ typedef struct janus_streaming_rtp_source_stream {
 	gboolean buffermsg;
 	void *last_msg;
 	janus_mutex buffermsg_mutex;
+	/* If DVR is enabled for the mountpoint, ring of the last few seconds of packets, to serve some of the past to late joiners */
+	GQueue *dvr_packets;
+	janus_mutex dvr_mutex;
 	janus_refcount ref;
 } janus_streaming_rtp_source_stream;
 static void janus_streaming_rtp_source_stream_unref(janus_streaming_rtp_source_stream *stream) {
@@ -1426,6 +1459,8 @@ typedef struct janus_streaming_file_source {
 	char *filename;
 	gboolean opus;
 	janus_streaming_codecs codecs;
+	char *map;			/* Shared memory mapping of the file, if any */
+	size_t map_size;	/* Size of the mapping */
 } janus_streaming_file_source;
 
 /* used for audio/video fd and RTCP fd */
@@ -1434,6 +1469,17 @@ typedef struct multiple_fds {
 	int rtcp_fd;
 } multiple_fds;
 
+/* Read-mostly snapshot of the viewers of a mountpoint (or of a helper
+ * thread): relay threads only hold the mutex for the time it takes to
+ * grab a reference to the current snapshot, and then iterate on it with
+ * no lock held, so viewers joining or leaving (e.g., a join storm on a
+ * popular live event) never stall media distribution for everybody else;
+ * each change to a viewers list simply publishes a new snapshot */
+typedef struct janus_streaming_viewers_snapshot {
+	GList *viewers;		/* Sessions in this snapshot (we keep a reference to each) */
+	janus_refcount ref;
+} janus_streaming_viewers_snapshot;
+
 typedef struct janus_streaming_mountpoint {
 	guint64 id;			/* Unique mountpoint ID (when using integers) */
 	gchar *id_str;		/* Unique mountpoint ID (when using strings) */
@@ -1447,13 +1493,17 @@ typedef struct janus_streaming_mountpoint {
 	gboolean active;
 	gboolean audio, video, data;
 	GThread *thread;	/* A mountpoint may or may not have a thread */
+	void *relay_shard;	/* If the shared relay engine is serving this mountpoint, the shard it's on */
+	GSList *relay_fds;	/* File descriptors we registered on the shard, if any */
 	janus_streaming_type streaming_type;
 	janus_streaming_source streaming_source;
 	void *source;	/* Can differ according to the source type */
 	GDestroyNotify source_destroy;
 	GList *viewers;
+	janus_streaming_viewers_snapshot *viewers_snapshot;	/* Current snapshot of the viewers list */
 	int helper_threads;		/* Only relevant for RTP/RTSP mountpoints */
 	GList *threads;			/* Only relevant for RTP/RTSP mountpoints */
+	int dvr_seconds;		/* How many seconds of recent packets to retain for late joiners (0 disables the feature) */
 	volatile gint destroyed;
 	janus_mutex mutex;
 	janus_refcount ref;
@@ -1468,6 +1518,7 @@ typedef struct janus_streaming_helper {
 	GThread *thread;
 	int num_viewers;
 	GList *viewers;
+	janus_streaming_viewers_snapshot *viewers_snapshot;	/* Current snapshot of the viewers list */
 	GAsyncQueue *queued_packets;
 	volatile gint destroyed;
 	janus_mutex mutex;
@@ -1483,15 +1534,65 @@ static void janus_streaming_helper_free(const janus_refcount *helper_ref) {
 	g_async_queue_unref(helper->queued_packets);
 	if(helper->viewers != NULL)
 		g_list_free(helper->viewers);
+	if(helper->viewers_snapshot != NULL)
+		janus_refcount_decrease(&helper->viewers_snapshot->ref);
 	g_free(helper);
 }
 static void *janus_streaming_helper_thread(void *data);
 static void janus_streaming_helper_rtprtcp_packet(gpointer data, gpointer user_data);
+static void janus_streaming_relay_fanout(janus_streaming_mountpoint *mountpoint,
+	GFunc relay, janus_streaming_rtp_relay_packet *packet);
+
+#ifdef __linux__
+/* Shared relay engine: when relay_threads is set in the configuration,
+ * plain RTP mountpoints are multiplexed on a small number of epoll()
+ * loops (shards), instead of each spawning a dedicated relay thread
+ * blocking in poll(): with many mostly-idle mountpoints this saves a
+ * lot of stacks and context switches, as an idle mountpoint only costs
+ * a few registered file descriptors. RTSP mountpoints keep a dedicated
+ * thread (reconnects and keep-alives are managed in the loop itself),
+ * and so do mountpoints configured with helper threads, as those are
+ * expected to be busy enough to deserve one */
+typedef struct janus_streaming_relay_shard {
+	int id;				/* Shard number */
+	int epollfd;		/* epoll file descriptor the shard blocks on */
+	GThread *thread;	/* Thread running the epoll loop */
+	GList *mountpoints;	/* Mountpoints currently served by this shard */
+	janus_mutex mutex;	/* Mutex to lock this structure */
+} janus_streaming_relay_shard;
+/* Small helper struct we attach to each file descriptor we register */
+typedef struct janus_streaming_relay_fd {
+	int fd;
+	janus_streaming_mountpoint *mp;
+} janus_streaming_relay_fd;
+static janus_streaming_relay_shard *relay_shards = NULL;
+static int relay_shards_num = 0;
+static volatile gint relay_shards_rr = 0;
+static void *janus_streaming_relay_shard_thread(void *data);
+#endif
+static gboolean janus_streaming_relay_register(janus_streaming_mountpoint *mp);
+
+/* On-demand viewers of raw audio file mountpoints don't need a dedicated
+ * thread each: the file is memory-mapped once and shared across viewers,
+ * and a single pacer thread drives the 20ms pacing for all of them, each
+ * viewer only costing its file offset and RTP state. Opus files keep the
+ * per-viewer thread, as parsing the Ogg container is stateful */
+typedef struct janus_streaming_ondemand_viewer {
+	janus_streaming_session *session;
+	janus_streaming_mountpoint *mp;
+	size_t offset;		/* Where we are in the mapped file */
+	guint16 seq;		/* RTP sequence number */
+	guint32 ts;			/* RTP timestamp */
+} janus_streaming_ondemand_viewer;
+static GList *ondemand_viewers = NULL;
+static janus_mutex ondemand_viewers_mutex = JANUS_MUTEX_INITIALIZER;
+static GThread *ondemand_pacer_thread = NULL;
+static gboolean janus_streaming_ondemand_register(janus_streaming_session *session, janus_streaming_mountpoint *mp);
 
 /* Helpers to create an RTP live source (e.g., from gstreamer/ffmpeg/vlc/etc.) */
 janus_streaming_rtp_source_stream *janus_streaming_create_rtp_source_stream(
 		const char *name, int mindex, const char *type, const char *mid, const char *label, const char *msid,
-		char *mcast, char *miface, const janus_network_address *iface,
+		char *mcast, char *pipename, char *miface, const janus_network_address *iface,
 		uint16_t port, uint16_t port2, uint16_t port3, gboolean dortcp, uint16_t rtcpport,
 		uint8_t pt, char *codec, char *fmtp, char *sprop,
 		gboolean doskew, gboolean bufferkf, gboolean simulcast, gboolean svc,
@@ -1499,7 +1600,7 @@ janus_streaming_rtp_source_stream *janus_streaming_create_rtp_source_stream(
 janus_streaming_mountpoint *janus_streaming_create_rtp_source(
 		uint64_t id, char *id_str, char *name, char *desc, char *metadata,
 		GList *media, int srtpsuite, char *srtpcrypto, int threads, int rtp_collision,
-		gboolean e2ee, gboolean playoutdelay_ext, int abscapturetime_src_ext_id);
+		int dvr, gboolean e2ee, gboolean playoutdelay_ext, int abscapturetime_src_ext_id);
 /* Helper to create a file/ondemand live source */
 janus_streaming_mountpoint *janus_streaming_create_file_source(
 		uint64_t id, char *id_str, char *name, char *desc, char *metadata, char *filename, gboolean live,
@@ -1513,6 +1614,17 @@ janus_streaming_mountpoint *janus_streaming_create_rtsp_source(
 		const janus_network_address *iface, int threads,
 		gint64 reconnect_delay, gint64 session_timeout, int rtsp_timeout, int rtsp_conn_timeout,
 		gboolean error_on_failure);
+#ifdef HAVE_LIBCURL
+/* At startup, mountpoints imported from the configuration file connect to their
+ * RTSP servers in parallel, rather than one at a time: each connection may take
+ * several round trips (or a timeout, if the server is unreachable), which would
+ * otherwise delay the whole boot when many mountpoints have to be restored */
+typedef struct janus_streaming_rtsp_startup {
+	janus_streaming_mountpoint *mp;		/* Mountpoint to connect */
+	gboolean error_on_failure;			/* Whether the mountpoint should be destroyed, if connecting fails */
+} janus_streaming_rtsp_startup;
+static void janus_streaming_rtsp_startup_connect(gpointer data, gpointer user_data);
+#endif
 
 typedef struct janus_streaming_message {
 	janus_plugin_session *handle;
@@ -1560,6 +1672,8 @@ typedef struct janus_streaming_session {
 	gboolean playoutdelay_ext;
 	/* Extension header id in RTP source with abs-capture-time */
 	int abscapturetime_src_ext_id;
+	/* How many seconds in the past playback should start from, if the mountpoint has a DVR ring */
+	int dvr_offset;
 	janus_mutex mutex;
 	volatile gint dataready;
 	volatile gint stopping;
@@ -1571,6 +1685,12 @@ typedef struct janus_streaming_session {
 static GHashTable *sessions;
 static janus_mutex sessions_mutex = JANUS_MUTEX_INITIALIZER;
 
+/* Helpers to store and replay the recent history of a stream, when DVR support is enabled on a mountpoint */
+static void janus_streaming_rtp_dvr_save(janus_streaming_rtp_source_stream *stream,
+	int dvr_seconds, janus_streaming_rtp_relay_packet *packet);
+static void janus_streaming_rtp_dvr_replay(janus_streaming_rtp_source_stream *stream,
+	janus_streaming_session *session, int offset);
+
 static void janus_streaming_session_destroy(janus_streaming_session *session) {
 	if(session && g_atomic_int_compare_and_exchange(&session->destroyed, 0, 1))
 		janus_refcount_decrease(&session->ref);
@@ -1584,6 +1704,52 @@ static void janus_streaming_session_free(const janus_refcount *session_ref) {
 	g_free(session);
 }
 
+static void janus_streaming_viewers_snapshot_free(const janus_refcount *snapshot_ref) {
+	janus_streaming_viewers_snapshot *snapshot = janus_refcount_containerof(snapshot_ref, janus_streaming_viewers_snapshot, ref);
+	/* Release the references we kept to the sessions */
+	GList *temp = snapshot->viewers;
+	while(temp) {
+		janus_streaming_session *s = (janus_streaming_session *)temp->data;
+		janus_refcount_decrease(&s->ref);
+		temp = temp->next;
+	}
+	g_list_free(snapshot->viewers);
+	g_free(snapshot);
+}
+
+/* Publish a new snapshot of the provided viewers list, replacing the
+ * previous one: must be invoked with the mutex protecting the list held,
+ * any time the list itself is changed */
+static void janus_streaming_viewers_snapshot_update(GList *viewers, janus_streaming_viewers_snapshot **slot) {
+	janus_streaming_viewers_snapshot *snapshot = g_malloc(sizeof(janus_streaming_viewers_snapshot));
+	snapshot->viewers = NULL;
+	GList *temp = viewers;
+	while(temp) {
+		janus_streaming_session *s = (janus_streaming_session *)temp->data;
+		janus_refcount_increase(&s->ref);
+		snapshot->viewers = g_list_prepend(snapshot->viewers, s);
+		temp = temp->next;
+	}
+	janus_refcount_init(&snapshot->ref, janus_streaming_viewers_snapshot_free);
+	janus_streaming_viewers_snapshot *old = *slot;
+	*slot = snapshot;
+	if(old != NULL)
+		janus_refcount_decrease(&old->ref);
+}
+
+/* Get a reference to the current snapshot of a viewers list: the mutex
+ * is only held for the time it takes to grab the pointer */
+static janus_streaming_viewers_snapshot *janus_streaming_viewers_snapshot_get(janus_mutex *mutex, janus_streaming_viewers_snapshot **slot) {
+	/* This runs once per relayed packet and the lock is held for nanoseconds,
+	 * so spin briefly rather than paying a futex round trip under contention */
+	janus_mutex_lock_adaptive(mutex);
+	janus_streaming_viewers_snapshot *snapshot = *slot;
+	if(snapshot != NULL)
+		janus_refcount_increase(&snapshot->ref);
+	janus_mutex_unlock(mutex);
+	return snapshot;
+}
+
 static void janus_streaming_mountpoint_destroy(janus_streaming_mountpoint *mountpoint) {
 	if(!mountpoint)
 		return;
@@ -1630,6 +1796,8 @@ static void janus_streaming_mountpoint_free(const janus_refcount *mp_ref) {
 	janus_mutex_lock(&mp->mutex);
 	if(mp->viewers != NULL)
 		g_list_free(mp->viewers);
+	if(mp->viewers_snapshot != NULL)
+		janus_refcount_decrease(&mp->viewers_snapshot->ref);
 	if(mp->threads != NULL) {
 		/* Remove the last reference to the helper threads, if any */
 		GList *l = mp->threads;
@@ -2034,6 +2202,49 @@ int janus_streaming_init(janus_callbacks *callback, const char *config_path) {
 		if(string_ids) {
 			JANUS_LOG(LOG_INFO, "Streaming will use alphanumeric IDs, not numeric\n");
 		}
+		/* Should we share a few relay threads among RTP mountpoints, instead of one each? */
+		janus_config_item *rthreads = janus_config_get(config, config_general, janus_config_type_item, "relay_threads");
+		if(rthreads != NULL && rthreads->value != NULL) {
+#ifdef __linux__
+			int relay_threads = atoi(rthreads->value);
+			if(relay_threads < 0) {
+				JANUS_LOG(LOG_WARN, "Invalid number of relay threads (%s), will use dedicated relay threads\n", rthreads->value);
+				relay_threads = 0;
+			}
+			if(relay_threads > 0) {
+				/* Start the shared relay engine */
+				relay_shards = g_malloc0(relay_threads * sizeof(janus_streaming_relay_shard));
+				int i = 0;
+				for(i=0; i<relay_threads; i++) {
+					janus_streaming_relay_shard *shard = &relay_shards[i];
+					shard->id = i+1;
+					shard->epollfd = epoll_create1(0);
+					janus_mutex_init(&shard->mutex);
+					char tname[16];
+					g_snprintf(tname, sizeof(tname), "relay shard %d", shard->id);
+					GError *error = NULL;
+					if(shard->epollfd > -1)
+						shard->thread = g_thread_try_new(tname, &janus_streaming_relay_shard_thread, shard, &error);
+					if(shard->thread == NULL) {
+						JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to start relay shard #%d, remaining mountpoints will use dedicated relay threads\n",
+							error ? error->code : errno, error && error->message ? error->message : g_strerror(errno), shard->id);
+						if(error != NULL)
+							g_error_free(error);
+						if(shard->epollfd > -1)
+							close(shard->epollfd);
+						break;
+					}
+					relay_shards_num++;
+				}
+				if(relay_shards_num > 0) {
+					JANUS_LOG(LOG_INFO, "Sharing %d relay thread%s among RTP mountpoints\n",
+						relay_shards_num, relay_shards_num == 1 ? "" : "s");
+				}
+			}
+#else
+			JANUS_LOG(LOG_WARN, "The shared relay engine requires epoll(), mountpoints will use dedicated relay threads\n");
+#endif
+		}
 	}
 	/* Iterate on all mountpoints */
 	mountpoints = g_hash_table_new_full(string_ids ? g_str_hash : g_int64_hash, string_ids ? g_str_equal : g_int64_equal,
@@ -2041,6 +2252,9 @@ int janus_streaming_init(janus_callbacks *callback, const char *config_path) {
 	mountpoints_temp = g_hash_table_new_full(string_ids ? g_str_hash : g_int64_hash, string_ids ? g_str_equal : g_int64_equal,
 		(GDestroyNotify)g_free, NULL);
 	if(config != NULL) {
+#ifdef HAVE_LIBCURL
+		GList *pending_rtsp = NULL;
+#endif
 		GList *clist = janus_config_get_categories(config, NULL), *cl = clist;
 		while(cl != NULL) {
 			janus_config_category *cat = (janus_config_category *)cl->data;
@@ -2103,6 +2317,7 @@ int janus_streaming_init(janus_callbacks *callback, const char *config_path) {
 				janus_config_item *media = janus_config_get(config, cat, janus_config_type_array, "media");
 				janus_config_item *rtpcollision = janus_config_get(config, cat, janus_config_type_item, "collision");
 				janus_config_item *threads = janus_config_get(config, cat, janus_config_type_item, "threads");
+				janus_config_item *dvr = janus_config_get(config, cat, janus_config_type_item, "dvr");
 				janus_config_item *ssuite = janus_config_get(config, cat, janus_config_type_item, "srtpsuite");
 				janus_config_item *scrypto = janus_config_get(config, cat, janus_config_type_item, "srtpcrypto");
 				janus_config_item *e2ee = janus_config_get(config, cat, janus_config_type_item, "e2ee");
@@ -2124,6 +2339,11 @@ int janus_streaming_init(janus_callbacks *callback, const char *config_path) {
 					cl = cl->next;
 					continue;
 				}
+				if(dvr && dvr->value && atoi(dvr->value) < 0) {
+					JANUS_LOG(LOG_ERR, "Can't add 'rtp' mountpoint '%s', invalid dvr configuration...\n", cat->name);
+					cl = cl->next;
+					continue;
+				}
 				int abscaptime_src_id_int = 0;
 				if(abscaptime_src_id && abscaptime_src_id->value) {
 					abscaptime_src_id_int = atoi(abscaptime_src_id->value);
@@ -2172,6 +2392,7 @@ int janus_streaming_init(janus_callbacks *callback, const char *config_path) {
 						janus_network_address media_iface;
 						janus_config_item *iface = janus_config_get(config, m, janus_config_type_item, "iface");
 						janus_config_item *mcast = janus_config_get(config, m, janus_config_type_item, "mcast");
+						janus_config_item *pipename = janus_config_get(config, m, janus_config_type_item, "pipe");
 						janus_config_item *port = janus_config_get(config, m, janus_config_type_item, "port");
 						janus_config_item *rtcpport = janus_config_get(config, m, janus_config_type_item, "rtcpport");
 						janus_config_item *pt = janus_config_get(config, m, janus_config_type_item, "pt");
@@ -2215,13 +2436,14 @@ int janus_streaming_init(janus_callbacks *callback, const char *config_path) {
 							if(rtpmap && rtpmap->value)
 								streamcodec = janus_sdp_get_rtpmap_codec(rtpmap->value);
 						}
+						gboolean nosocket = (pipename && pipename->value);
 						if((audio || video) &&
-								(port == NULL || port->value == NULL || atoi(port->value) < 0 ||
+								((!nosocket && (port == NULL || port->value == NULL || atoi(port->value) < 0)) ||
 								pt == NULL || pt->value == NULL || streamcodec == NULL)) {
 							JANUS_LOG(LOG_ERR, "Can't add 'rtp' stream '%s', missing mandatory information for audio/video stream...\n", cat->name);
 							failed = TRUE;
 							break;
-						} else if(data && (port == NULL || port->value == NULL || atoi(port->value) < 0)) {
+						} else if(data && !nosocket && (port == NULL || port->value == NULL || atoi(port->value) < 0)) {
 							JANUS_LOG(LOG_ERR, "Can't add 'rtp' stream '%s', missing mandatory information for data stream...\n", cat->name);
 							failed = TRUE;
 							break;
@@ -2244,6 +2466,7 @@ int janus_streaming_init(janus_callbacks *callback, const char *config_path) {
 							type->value, mid->value, (label && label->value ? label->value : type->value),
 							(msid && msid->value ? msid->value : NULL),
 							mcast ? (char *)mcast->value : NULL,
+							pipename ? (char *)pipename->value : NULL,
 							iface && iface->value ? (char *)iface->value : NULL,
 							iface && iface->value ? &media_iface : NULL,
 							(port && port->value) ? atoi(port->value) : 0,
@@ -2448,7 +2671,7 @@ int janus_streaming_init(janus_callbacks *callback, const char *config_path) {
 						janus_streaming_rtp_source_stream *stream = janus_streaming_create_rtp_source_stream(
 							cat->name, g_list_length(streams),
 							"audio", "a", "audio", NULL,
-							amcast ? (char *)amcast->value : NULL,
+							amcast ? (char *)amcast->value : NULL, NULL,
 							aiface && aiface->value ? (char *)aiface->value : NULL,
 							aiface && aiface->value ? &audio_iface : NULL,
 							(aport && aport->value) ? atoi(aport->value) : 0, 0, 0,
@@ -2470,7 +2693,7 @@ int janus_streaming_init(janus_callbacks *callback, const char *config_path) {
 						janus_streaming_rtp_source_stream *stream = janus_streaming_create_rtp_source_stream(
 							cat->name, g_list_length(streams),
 							"video", "v", "video", NULL,
-							vmcast ? (char *)vmcast->value : NULL,
+							vmcast ? (char *)vmcast->value : NULL, NULL,
 							viface && viface->value ? (char *)viface->value : NULL,
 							viface && viface->value ? &video_iface : NULL,
 							(vport && vport->value) ? atoi(vport->value) : 0,
@@ -2495,7 +2718,7 @@ int janus_streaming_init(janus_callbacks *callback, const char *config_path) {
 						janus_streaming_rtp_source_stream *stream = janus_streaming_create_rtp_source_stream(
 							cat->name, g_list_length(streams),
 							"data", "d", "data", NULL,
-							dmcast ? (char *)dmcast->value : NULL,
+							dmcast ? (char *)dmcast->value : NULL, NULL,
 							diface && diface->value ? (char *)diface->value : NULL,
 							diface && diface->value ? &data_iface : NULL,
 							(dport && dport->value) ? atoi(dport->value) : 0,
@@ -2523,6 +2746,7 @@ int janus_streaming_init(janus_callbacks *callback, const char *config_path) {
 						scrypto && scrypto->value ? (char *)scrypto->value : NULL,
 						(threads && threads->value) ? atoi(threads->value) : 0,
 						(rtpcollision && rtpcollision->value) ?  atoi(rtpcollision->value) : 0,
+						(dvr && dvr->value) ? atoi(dvr->value) : 0,
 						(e2ee && e2ee->value) ? janus_is_true(e2ee->value) : FALSE,
 						(pd && pd->value) ? janus_is_true(pd->value) : FALSE,
 						abscaptime_src_id_int)) == NULL) {
@@ -2787,7 +3011,7 @@ int janus_streaming_init(janus_callbacks *callback, const char *config_path) {
 						((session_timeout && session_timeout->value) ? atoi(session_timeout->value) : JANUS_STREAMING_DEFAULT_SESSION_TIMEOUT) * G_USEC_PER_SEC,
 						((rtsp_timeout && rtsp_timeout->value) ? atoi(rtsp_timeout->value) : JANUS_STREAMING_DEFAULT_CURL_TIMEOUT),
 						((rtsp_conn_timeout && rtsp_conn_timeout->value) ? atoi(rtsp_conn_timeout->value) : JANUS_STREAMING_DEFAULT_CURL_CONNECT_TIMEOUT),
-						error_on_failure)) == NULL) {
+						FALSE)) == NULL) {	/* We'll connect to the server ourselves, in parallel */
 					JANUS_LOG(LOG_ERR, "Error creating 'rtsp' mountpoint '%s'...\n", cat->name);
 					cl = cl->next;
 					continue;
@@ -2797,6 +3021,14 @@ int janus_streaming_init(janus_callbacks *callback, const char *config_path) {
 					mp->secret = g_strdup(secret->value);
 				if(pin && pin->value)
 					mp->pin = g_strdup(pin->value);
+				/* Queue the mountpoint for a parallel connection attempt, once we're done with the file */
+				janus_streaming_rtp_source *mp_source = mp->source;
+				mp_source->reconnecting = TRUE;
+				janus_streaming_rtsp_startup *pending = g_malloc0(sizeof(janus_streaming_rtsp_startup));
+				janus_refcount_increase(&mp->ref);
+				pending->mp = mp;
+				pending->error_on_failure = error_on_failure;
+				pending_rtsp = g_list_prepend(pending_rtsp, pending);
 #endif
 			} else {
 				JANUS_LOG(LOG_WARN, "Ignoring unknown mountpoint type '%s' (%s)...\n", type->value, cat->name);
@@ -2804,6 +3036,36 @@ int janus_streaming_init(janus_callbacks *callback, const char *config_path) {
 			cl = cl->next;
 		}
 		g_list_free(clist);
+#ifdef HAVE_LIBCURL
+		if(pending_rtsp != NULL) {
+			/* Connect to the RTSP servers of the mountpoints we just restored, in parallel:
+			 * we wait for all the connection attempts to get done before moving on, so that
+			 * all mountpoints are in a known state before transports accept any traffic */
+			guint pending_num = g_list_length(pending_rtsp);
+			JANUS_LOG(LOG_INFO, "Connecting to the RTSP servers of %u mountpoints\n", pending_num);
+			GError *pool_error = NULL;
+			GThreadPool *pool = g_thread_pool_new(janus_streaming_rtsp_startup_connect, NULL,
+				pending_num < 16 ? (gint)pending_num : 16, FALSE, &pool_error);
+			if(pool_error != NULL) {
+				/* No thread pool? We'll connect serially, as we used to */
+				JANUS_LOG(LOG_WARN, "Got error %d (%s) trying to create the RTSP startup pool, connecting serially...\n",
+					pool_error->code, pool_error->message ? pool_error->message : "??");
+				g_error_free(pool_error);
+				pool = NULL;
+			}
+			GList *pl = pending_rtsp;
+			while(pl) {
+				if(pool != NULL)
+					g_thread_pool_push(pool, pl->data, NULL);
+				else
+					janus_streaming_rtsp_startup_connect(pl->data, NULL);
+				pl = pl->next;
+			}
+			if(pool != NULL)
+				g_thread_pool_free(pool, FALSE, TRUE);
+			g_list_free(pending_rtsp);
+		}
+#endif
 		/* Done: we keep the configuration file open in case we get a "create" or "destroy" with permanent=true */
 	}
 	if(ifas) {
@@ -2855,6 +3117,13 @@ void janus_streaming_destroy(void) {
 		g_thread_join(handler_thread);
 		handler_thread = NULL;
 	}
+	/* Stop the on-demand pacer thread, if it was running */
+	janus_mutex_lock(&ondemand_viewers_mutex);
+	GThread *pacer = ondemand_pacer_thread;
+	ondemand_pacer_thread = NULL;
+	janus_mutex_unlock(&ondemand_viewers_mutex);
+	if(pacer != NULL)
+		g_thread_join(pacer);
 
 	/* Remove all mountpoints */
 	janus_mutex_lock(&mountpoints_mutex);
@@ -2863,6 +3132,21 @@ void janus_streaming_destroy(void) {
 	g_hash_table_destroy(mountpoints_temp);
 	mountpoints_temp = NULL;
 	janus_mutex_unlock(&mountpoints_mutex);
+#ifdef __linux__
+	/* Stop the shared relay engine, if it was running */
+	if(relay_shards != NULL) {
+		int i = 0;
+		for(i=0; i<relay_shards_num; i++) {
+			if(relay_shards[i].thread != NULL)
+				g_thread_join(relay_shards[i].thread);
+			if(relay_shards[i].epollfd > -1)
+				close(relay_shards[i].epollfd);
+		}
+		g_free(relay_shards);
+		relay_shards = NULL;
+		relay_shards_num = 0;
+	}
+#endif
 	janus_mutex_lock(&sessions_mutex);
 	g_hash_table_destroy(sessions);
 	sessions = NULL;
@@ -3042,6 +3326,89 @@ json_t *janus_streaming_query_session(janus_plugin_session *handle) {
 	return info;
 }
 
+json_t *janus_streaming_query_state(void) {
+	if(g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized))
+		return NULL;
+	/* Describe all existing mountpoints (private ones too), with the
+	 * properties needed to re-create them on a standby instance: unlike
+	 * "list", this includes credentials and per-stream details */
+	json_t *list = json_array();
+	janus_mutex_lock(&mountpoints_mutex);
+	GHashTableIter iter;
+	gpointer value;
+	g_hash_table_iter_init(&iter, mountpoints);
+	while(g_hash_table_iter_next(&iter, NULL, &value)) {
+		janus_streaming_mountpoint *mp = value;
+		if(!mp || g_atomic_int_get(&mp->destroyed))
+			continue;
+		janus_refcount_increase(&mp->ref);
+		json_t *ml = json_object();
+		json_object_set_new(ml, "id", string_ids ? json_string(mp->id_str) : json_integer(mp->id));
+		if(mp->name)
+			json_object_set_new(ml, "name", json_string(mp->name));
+		if(mp->description)
+			json_object_set_new(ml, "description", json_string(mp->description));
+		if(mp->metadata)
+			json_object_set_new(ml, "metadata", json_string(mp->metadata));
+		if(mp->secret)
+			json_object_set_new(ml, "secret", json_string(mp->secret));
+		if(mp->pin)
+			json_object_set_new(ml, "pin", json_string(mp->pin));
+		json_object_set_new(ml, "is_private", mp->is_private ? json_true() : json_false());
+		json_object_set_new(ml, "enabled", mp->enabled ? json_true() : json_false());
+		json_object_set_new(ml, "type", json_string(mp->streaming_type == janus_streaming_type_live ? "live" : "on demand"));
+		if(mp->streaming_source == janus_streaming_source_rtp) {
+			janus_streaming_rtp_source *source = mp->source;
+			json_t *media = json_array();
+			GList *temp = source->media;
+			while(temp) {
+				janus_streaming_rtp_source_stream *stream = (janus_streaming_rtp_source_stream *)temp->data;
+				json_t *info = json_object();
+				json_object_set_new(info, "type", json_string(janus_streaming_media_str(stream->type)));
+				json_object_set_new(info, "mid", json_string(stream->mid));
+				if(stream->label)
+					json_object_set_new(info, "label", json_string(stream->label));
+				if(stream->mcast_str)
+					json_object_set_new(info, "mcast", json_string(stream->mcast_str));
+				if(stream->iface_str)
+					json_object_set_new(info, "iface", json_string(stream->iface_str));
+				json_object_set_new(info, "port", json_integer(stream->port[0]));
+				if(stream->rtcp_port > -1)
+					json_object_set_new(info, "rtcpport", json_integer(stream->rtcp_port));
+				if(stream->type != JANUS_STREAMING_MEDIA_DATA) {
+					json_object_set_new(info, "pt", json_integer(stream->codecs.pt));
+					if(stream->codecs.audio_codec != JANUS_AUDIOCODEC_NONE)
+						json_object_set_new(info, "codec", json_string(janus_audiocodec_name(stream->codecs.audio_codec)));
+					else if(stream->codecs.video_codec != JANUS_VIDEOCODEC_NONE)
+						json_object_set_new(info, "codec", json_string(janus_videocodec_name(stream->codecs.video_codec)));
+					if(stream->codecs.fmtp)
+						json_object_set_new(info, "fmtp", json_string(stream->codecs.fmtp));
+				}
+				if(stream->simulcast) {
+					json_object_set_new(info, "simulcast", json_true());
+					if(stream->port[1] > 0)
+						json_object_set_new(info, "port2", json_integer(stream->port[1]));
+					if(stream->port[2] > 0)
+						json_object_set_new(info, "port3", json_integer(stream->port[2]));
+				}
+				if(stream->svc)
+					json_object_set_new(info, "svc", json_true());
+				if(stream->skew)
+					json_object_set_new(info, "skew", json_true());
+				json_array_append_new(media, info);
+				temp = temp->next;
+			}
+			json_object_set_new(ml, "media", media);
+		}
+		json_array_append_new(list, ml);
+		janus_refcount_decrease(&mp->ref);
+	}
+	janus_mutex_unlock(&mountpoints_mutex);
+	json_t *state = json_object();
+	json_object_set_new(state, "mountpoints", list);
+	return state;
+}
+
 /* Helper method to process synchronous requests */
 static json_t *janus_streaming_process_synchronous_request(janus_streaming_session *session, json_t *message) {
 	json_t *request = json_object_get(message, "request");
@@ -3052,7 +3419,7 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 	char error_cause[512];
 	json_t *root = message;
 	json_t *response = NULL;
-	struct ifaddrs *ifas = NULL;
+	const struct ifaddrs *ifas = NULL;
 
 	if(!strcasecmp(request_text, "list")) {
 		JANUS_LOG(LOG_VERB, "Request for the list of mountpoints\n");
@@ -3214,6 +3581,10 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 #ifdef HAVE_LIBCURL
 			if(source->rtsp) {
 				json_object_set_new(ml, "rtsp", json_true());
+				/* Surface the health of the RTSP connection too */
+				json_object_set_new(ml, "connected", source->rtsp_connected ? json_true() : json_false());
+				if(source->reconnecting)
+					json_object_set_new(ml, "reconnecting", json_true());
 				if(admin) {
 					if(source->rtsp_url)
 						json_object_set_new(ml, "url", json_string(source->rtsp_url));
@@ -3233,6 +3604,8 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 				json_object_set_new(ml, "collision", json_integer(source->rtp_collision));
 			if(mp->helper_threads > 0)
 				json_object_set_new(ml, "threads", json_integer(mp->helper_threads));
+			if(mp->dvr_seconds > 0)
+				json_object_set_new(ml, "dvr", json_integer(mp->dvr_seconds));
 			/* Iterate on media now */
 			GList *temp = source->media;
 			while(temp) {
@@ -3279,6 +3652,8 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 				if(admin) {
 					if(stream->host)
 						json_object_set_new(ml, "host", json_string(stream->host));
+					if(stream->pipe_name)
+						json_object_set_new(info, "pipe", json_string(stream->pipe_name));
 					json_object_set_new(info, "port", json_integer(stream->port[0]));
 					if(stream->rtcp_port > -1)
 						json_object_set_new(info, "rtcpport", json_integer(stream->rtcp_port));
@@ -3337,7 +3712,7 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 				goto prepare_response;
 		}
 
-		if(getifaddrs(&ifas) == -1) {
+		if((ifas = janus_network_acquire_ifaddrs()) == NULL) {
 			JANUS_LOG(LOG_ERR, "Unable to acquire list of network devices/interfaces; some configurations may not work as expected... %d (%s)\n",
 				errno, g_strerror(errno));
 		}
@@ -3416,6 +3791,7 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 			json_t *is_private = json_object_get(root, "is_private");
 			json_t *rtpcollision = json_object_get(root, "collision");
 			json_t *threads = json_object_get(root, "threads");
+			json_t *dvr = json_object_get(root, "dvr");
 			json_t *ssuite = json_object_get(root, "srtpsuite");
 			json_t *scrypto = json_object_get(root, "srtpcrypto");
 			json_t *e2ee = json_object_get(root, "e2ee");
@@ -3469,7 +3845,7 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 					uint16_t port = 0, port2 = 0, port3 = 0;
 					uint16_t rtcpport = 0;
 					uint8_t pt = 0;
-					char *mtype = NULL, *mid = NULL, *label = NULL, *msid = NULL, *codec = NULL, *fmtp = NULL, *sps = NULL, *mcast = NULL, *miface = NULL;
+					char *mtype = NULL, *mid = NULL, *label = NULL, *msid = NULL, *codec = NULL, *fmtp = NULL, *sps = NULL, *mcast = NULL, *pipename = NULL, *miface = NULL;
 					gboolean doskew = FALSE, bufferkf = FALSE, simulcast = FALSE, dosvc = FALSE, textdata = TRUE, buffermsg = FALSE;
 					json_t *jmtype = json_object_get(m, "type");
 					mtype = (char *)json_string_value(jmtype);
@@ -3491,6 +3867,8 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 					msid = (char *)json_string_value(jmsid);
 					json_t *jmcast = json_object_get(m, "mcast");
 					mcast = (char *)json_string_value(jmcast);
+					json_t *jpipe = json_object_get(m, "pipe");
+					pipename = (char *)json_string_value(jpipe);
 					json_t *jport = json_object_get(m, "port");
 					port = json_integer_value(jport);
 					json_t *jrtcpport = json_object_get(m, "rtcpport");
@@ -3567,7 +3945,7 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 					/* Create the data source stream */
 					janus_streaming_rtp_source_stream *stream = janus_streaming_create_rtp_source_stream(
 						name ? (char *)json_string_value(name) : NULL, g_list_length(streams),
-						mtype, mid, label ? label : mtype, msid, mcast, miface, &iface,
+						mtype, mid, label ? label : mtype, msid, mcast, pipename, miface, &iface,
 						port, port2, port3, jrtcpport != NULL, rtcpport,
 						pt, codec, fmtp, sps, doskew, bufferkf, simulcast, dosvc, textdata, buffermsg);
 					if(stream == NULL) {
@@ -3657,7 +4035,7 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 					janus_streaming_rtp_source_stream *stream = janus_streaming_create_rtp_source_stream(
 						name ? (char *)json_string_value(name) : NULL, g_list_length(streams),
 						"audio", "a", "audio", NULL,
-						amcast, amiface, &audio_iface,
+						amcast, NULL, amiface, &audio_iface,
 						aport, 0, 0, audiortcpport != NULL, artcpport,
 						apt, acodec, afmtp, NULL, doaskew, FALSE, FALSE, FALSE, FALSE, FALSE);
 					if(stream == NULL) {
@@ -3745,7 +4123,7 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 						name ? (char *)json_string_value(name) : NULL,
 						g_list_length(streams),
 						"video", "v", "video", NULL,
-						vmcast, vmiface, &video_iface,
+						vmcast, NULL, vmiface, &video_iface,
 						vport, vport2, vport3, videortcpport != NULL, vrtcpport,
 						vpt, vcodec, vfmtp, vsps, dovskew, bufferkf, simulcast, dosvc, FALSE, FALSE);
 					if(stream == NULL) {
@@ -3817,7 +4195,7 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 						name ? (char *)json_string_value(name) : NULL,
 						g_list_length(streams),
 						"data", "d", "data", NULL,
-						dmcast, dmiface, &data_iface,
+						dmcast, NULL, dmiface, &data_iface,
 						dport, 0, 0, FALSE, 0,
 						0, NULL, NULL, NULL, FALSE, FALSE, FALSE, FALSE, textdata, buffermsg);
 					if(stream == NULL) {
@@ -3853,6 +4231,7 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 					scrypto ? (char *)json_string_value(scrypto) : NULL,
 					threads ? json_integer_value(threads) : 0,
 					rtpcollision ? json_integer_value(rtpcollision) : 0,
+					dvr ? json_integer_value(dvr) : 0,
 					e2ee ? json_is_true(e2ee) : FALSE,
 					pd ? json_is_true(pd) : FALSE,
 					abscaptime_src_id ? json_integer_value(abscaptime_src_id) : 0);
@@ -4209,6 +4588,10 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 					g_snprintf(value, BUFSIZ, "%d", mp->helper_threads);
 					janus_config_add(config, c, janus_config_item_create("threads", value));
 				}
+				if(mp->dvr_seconds > 0) {
+					g_snprintf(value, BUFSIZ, "%d", mp->dvr_seconds);
+					janus_config_add(config, c, janus_config_item_create("dvr", value));
+				}
 				if(source->e2ee)
 					janus_config_add(config, c, janus_config_item_create("e2ee", "true"));
 				if(source->playoutdelay_ext)
@@ -4233,6 +4616,8 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 						g_snprintf(msid, sizeof(msid), "%s %s", stream->msid, stream->mstid);
 						janus_config_add(config, m, janus_config_item_create("msid", msid));
 					}
+					if(stream->pipe_name)
+						janus_config_add(config, m, janus_config_item_create("pipe", stream->pipe_name));
 					if(stream->port[0] > 0) {
 						g_snprintf(value, BUFSIZ, "%d", stream->port[0]);
 						janus_config_add(config, m, janus_config_item_create("port", value));
@@ -4359,6 +4744,8 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 					if(stream->fd[0] != -1) {
 						if(stream->host)
 							json_object_set_new(ml, "host", json_string(stream->host));
+						if(stream->pipe_name)
+							json_object_set_new(info, "pipe", json_string(stream->pipe_name));
 						json_object_set_new(info, "port", json_integer(stream->port[0]));
 					}
 					if(stream->rtcp_fd != -1) {
@@ -4612,6 +4999,10 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 						g_snprintf(value, BUFSIZ, "%d", mp->helper_threads);
 						janus_config_add(config, c, janus_config_item_create("threads", value));
 					}
+					if(mp->dvr_seconds > 0) {
+						g_snprintf(value, BUFSIZ, "%d", mp->dvr_seconds);
+						janus_config_add(config, c, janus_config_item_create("dvr", value));
+					}
 					if(source->e2ee)
 						janus_config_add(config, c, janus_config_item_create("e2ee", "true"));
 					if(source->playoutdelay_ext)
@@ -4823,6 +5214,7 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 						if(g_list_find(ht->viewers, s) != NULL) {
 							ht->num_viewers--;
 							ht->viewers = g_list_remove_all(ht->viewers, s);
+							janus_streaming_viewers_snapshot_update(ht->viewers, &ht->viewers_snapshot);
 							janus_mutex_unlock(&ht->mutex);
 							JANUS_LOG(LOG_VERB, "Removing viewer from helper thread #%d (destroy)\n", ht->id);
 							break;
@@ -4838,6 +5230,7 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 			janus_refcount_decrease(&mp->ref);
 		}
 		json_decref(event);
+		janus_streaming_viewers_snapshot_update(mp->viewers, &mp->viewers_snapshot);
 		janus_mutex_unlock(&mp->mutex);
 		janus_refcount_decrease(&mp->ref);
 		/* Also notify event handlers */
@@ -4951,6 +5344,7 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 						if(g_list_find(ht->viewers, s) != NULL) {
 							ht->num_viewers--;
 							ht->viewers = g_list_remove_all(ht->viewers, s);
+							janus_streaming_viewers_snapshot_update(ht->viewers, &ht->viewers_snapshot);
 							janus_mutex_unlock(&ht->mutex);
 							JANUS_LOG(LOG_VERB, "Removing viewer from helper thread #%d (destroy)\n", ht->id);
 							break;
@@ -4967,6 +5361,7 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 			janus_refcount_decrease(&mp->ref);
 		}
 		json_decref(event);
+		janus_streaming_viewers_snapshot_update(mp->viewers, &mp->viewers_snapshot);
 		janus_mutex_unlock(&mp->mutex);
 		if(save) {
 			/* This change is permanent: save to the configuration file too
@@ -5388,7 +5783,7 @@ static json_t *janus_streaming_process_synchronous_request(janus_streaming_sessi
 prepare_response:
 		{
 			if(ifas) {
-				freeifaddrs(ifas);
+				janus_network_release_ifaddrs(ifas);
 			}
 
 			if(error_code == 0 && !response) {
@@ -5596,11 +5991,19 @@ void janus_streaming_setup_media(janus_plugin_session *handle) {
 				}
 				janus_mutex_unlock(&stream->buffermsg_mutex);
 			}
+			if(session->dvr_offset > 0 && mountpoint->dvr_seconds > 0 && stream->type != JANUS_STREAMING_MEDIA_DATA) {
+				/* The viewer asked to start in the past, replay the DVR ring from there:
+				 * notice that, if this is video, decoding will only resume from the
+				 * first keyframe the replayed history happens to contain */
+				janus_streaming_rtp_dvr_replay(stream, session,
+					session->dvr_offset > mountpoint->dvr_seconds ? mountpoint->dvr_seconds : session->dvr_offset);
+			}
 			/* If this mountpoint has RTCP support, send a PLI */
 			if(stream->type == JANUS_STREAMING_MEDIA_VIDEO)
 				janus_streaming_rtcp_pli_send(stream);
 			temp = temp->next;
 		}
+		session->dvr_offset = 0;
 	}
 	g_atomic_int_set(&session->started, 1);
 	/* Prepare JSON event */
@@ -5721,6 +6124,7 @@ static void janus_streaming_hangup_media_internal(janus_plugin_session *handle)
 			janus_refcount_decrease(&session->ref);
 		}
 		mp->viewers = g_list_remove_all(mp->viewers, session);
+		janus_streaming_viewers_snapshot_update(mp->viewers, &mp->viewers_snapshot);
 		if(mp->streaming_source == janus_streaming_source_rtp) {
 			/* Remove the viewer from the helper threads too, if any */
 			if(mp->helper_threads > 0) {
@@ -5731,6 +6135,7 @@ static void janus_streaming_hangup_media_internal(janus_plugin_session *handle)
 					if(g_list_find(ht->viewers, session) != NULL) {
 						ht->num_viewers--;
 						ht->viewers = g_list_remove_all(ht->viewers, session);
+						janus_streaming_viewers_snapshot_update(ht->viewers, &ht->viewers_snapshot);
 						janus_mutex_unlock(&ht->mutex);
 						JANUS_LOG(LOG_VERB, "Removing viewer from helper thread #%d\n", ht->id);
 						break;
@@ -5869,6 +6274,9 @@ static void *janus_streaming_handler(void *data) {
 			/* There may be an ICE restart request involved */
 			json_t *restart = json_object_get(root, "restart");
 			do_restart = restart ? json_is_true(restart) : FALSE;
+			/* The viewer may also ask to start from the recent past, if the mountpoint has DVR support */
+			json_t *offset = json_object_get(root, "offset");
+			session->dvr_offset = offset ? json_integer_value(offset) : 0;
 			/* Find the mountpoint and go on */
 			janus_mutex_lock(&mountpoints_mutex);
 			janus_streaming_mountpoint *mp = g_hash_table_lookup(mountpoints,
@@ -6036,8 +6444,9 @@ static void *janus_streaming_handler(void *data) {
 					session->streams_byid = g_hash_table_new(NULL, NULL);
 				g_hash_table_insert(session->streams_byid, GINT_TO_POINTER(s->mindex), s);
 			}
-			if(mp->streaming_type == janus_streaming_type_on_demand) {
-				/* Spawn a thread */
+			if(mp->streaming_type == janus_streaming_type_on_demand &&
+					!janus_streaming_ondemand_register(session, mp)) {
+				/* The shared pacer can't serve this viewer, spawn a thread */
 				GError *error = NULL;
 				char tname[16];
 				g_snprintf(tname, sizeof(tname), "mp %s", mp->id_str);
@@ -6278,6 +6687,7 @@ done:
 			/* Add the user to the list of watchers and we're done */
 			if(g_list_find(mp->viewers, session) == NULL) {
 				mp->viewers = g_list_append(mp->viewers, session);
+				janus_streaming_viewers_snapshot_update(mp->viewers, &mp->viewers_snapshot);
 				if(mp->streaming_source == janus_streaming_source_rtp) {
 					/* If we're using helper threads, add the viewer to one of those */
 					if(mp->helper_threads > 0) {
@@ -6295,6 +6705,7 @@ done:
 						janus_mutex_lock(&helper->mutex);
 						helper->viewers = g_list_append(helper->viewers, session);
 						helper->num_viewers++;
+						janus_streaming_viewers_snapshot_update(helper->viewers, &helper->viewers_snapshot);
 						janus_mutex_unlock(&helper->mutex);
 						JANUS_LOG(LOG_VERB, "Added viewer to helper thread #%d (%d viewers)\n",
 							helper->id, helper->num_viewers);
@@ -6555,8 +6966,9 @@ done:
 			if(subscribed == NULL) {
 				/* FIXME Ended up not subscribing to any stream? */
 				JANUS_LOG(LOG_WARN, "Not subscribed to any stream (all m-lines rejected)\n");
-			} else if(mp->streaming_type == janus_streaming_type_on_demand) {
-				/* Spawn a thread */
+			} else if(mp->streaming_type == janus_streaming_type_on_demand &&
+					!janus_streaming_ondemand_register(session, mp)) {
+				/* The shared pacer can't serve this viewer, spawn a thread */
 				GError *error = NULL;
 				char tname[16];
 				g_snprintf(tname, sizeof(tname), "mp %s", mp->id_str);
@@ -6583,6 +6995,7 @@ done:
 			/* Add the user to the list of watchers and we're done */
 			if(g_list_find(mp->viewers, session) == NULL) {
 				mp->viewers = g_list_append(mp->viewers, session);
+				janus_streaming_viewers_snapshot_update(mp->viewers, &mp->viewers_snapshot);
 				if(mp->streaming_source == janus_streaming_source_rtp) {
 					/* If we're using helper threads, add the viewer to one of those */
 					if(mp->helper_threads > 0) {
@@ -6600,6 +7013,7 @@ done:
 						janus_mutex_lock(&helper->mutex);
 						helper->viewers = g_list_append(helper->viewers, session);
 						helper->num_viewers++;
+						janus_streaming_viewers_snapshot_update(helper->viewers, &helper->viewers_snapshot);
 						janus_mutex_unlock(&helper->mutex);
 						JANUS_LOG(LOG_VERB, "Added viewer to helper thread #%d (%d viewers)\n",
 							helper->id, helper->num_viewers);
@@ -7013,6 +7427,7 @@ done:
 					if(g_list_find(ht->viewers, session) != NULL) {
 						ht->num_viewers--;
 						ht->viewers = g_list_remove_all(ht->viewers, session);
+						janus_streaming_viewers_snapshot_update(ht->viewers, &ht->viewers_snapshot);
 						janus_mutex_unlock(&ht->mutex);
 						JANUS_LOG(LOG_VERB, "Removing viewer from helper thread #%d (switching)\n", ht->id);
 						break;
@@ -7021,6 +7436,7 @@ done:
 					l = l->next;
 				}
 			}
+			janus_streaming_viewers_snapshot_update(oldmp->viewers, &oldmp->viewers_snapshot);
 			janus_refcount_decrease(&oldmp->ref);	/* This is for the user going away */
 			janus_mutex_unlock(&oldmp->mutex);
 			/* Subscribe to the new one */
@@ -7028,6 +7444,7 @@ done:
 			janus_mutex_lock(&session->mutex);
 			janus_refcount_increase(&mp->ref);
 			mp->viewers = g_list_append(mp->viewers, session);
+			janus_streaming_viewers_snapshot_update(mp->viewers, &mp->viewers_snapshot);
 			/* If we're using helper threads, add the viewer to one of those */
 			if(mp->helper_threads > 0) {
 				int viewers = -1;
@@ -7045,6 +7462,7 @@ done:
 				janus_mutex_lock(&helper->mutex);
 				helper->viewers = g_list_append(helper->viewers, session);
 				helper->num_viewers++;
+				janus_streaming_viewers_snapshot_update(helper->viewers, &helper->viewers_snapshot);
 				janus_mutex_unlock(&helper->mutex);
 			}
 			session->mountpoint = mp;
@@ -7375,6 +7793,10 @@ static void janus_streaming_rtp_source_stream_free(const janus_refcount *st_ref)
 		close(stream->fd[2]);
 	if(stream->rtcp_fd > -1)
 		close(stream->rtcp_fd);
+	if(stream->pipe_name != NULL) {
+		janus_rtp_pipe_unregister(stream->pipe_name);
+		g_free(stream->pipe_name);
+	}
 	g_free(stream->host);
 	janus_mutex_lock(&stream->keyframe.mutex);
 	if(stream->keyframe.latest_keyframe != NULL)
@@ -7386,6 +7808,11 @@ static void janus_streaming_rtp_source_stream_free(const janus_refcount *st_ref)
 		janus_streaming_rtp_relay_packet_free((janus_streaming_rtp_relay_packet *)stream->last_msg);
 	stream->last_msg = NULL;
 	janus_mutex_unlock(&stream->buffermsg_mutex);
+	janus_mutex_lock(&stream->dvr_mutex);
+	if(stream->dvr_packets != NULL)
+		g_queue_free_full(stream->dvr_packets, (GDestroyNotify)janus_streaming_rtp_relay_packet_free);
+	stream->dvr_packets = NULL;
+	janus_mutex_unlock(&stream->dvr_mutex);
 	g_free(stream->codecs.fmtp);
 	g_free(stream->h264_spspps);
 	g_free(stream->mid);
@@ -7443,6 +7870,8 @@ static void janus_streaming_rtp_source_free(janus_streaming_rtp_source *source)
 }
 
 static void janus_streaming_file_source_free(janus_streaming_file_source *source) {
+	if(source->map != NULL)
+		munmap(source->map, source->map_size);
 	g_free(source->codecs.fmtp);
 	g_free(source->filename);
 	g_free(source);
@@ -7452,7 +7881,7 @@ static void janus_streaming_file_source_free(janus_streaming_file_source *source
 /* Helpers to create an RTP live source (e.g., from gstreamer/ffmpeg/vlc/etc.) */
 janus_streaming_rtp_source_stream *janus_streaming_create_rtp_source_stream(
 		const char *name, int mindex, const char *type, const char *mid, const char *label, const char *msid,
-		char *mcast, char *miface, const janus_network_address *iface,
+		char *mcast, char *pipename, char *miface, const janus_network_address *iface,
 		uint16_t port, uint16_t port2, uint16_t port3, gboolean dortcp, uint16_t rtcpport,
 		uint8_t pt, char *codec, char *fmtp, char *sprop,
 		gboolean doskew, gboolean bufferkf, gboolean simulcast, gboolean svc,
@@ -7481,50 +7910,79 @@ janus_streaming_rtp_source_stream *janus_streaming_create_rtp_source_stream(
 	int rtcp_fd = -1;
 	char host[46];
 	host[0] = '\0';
-	fd[0] = janus_streaming_create_fd(port, mcast ? inet_addr(mcast) : INADDR_ANY, iface,
-		host, sizeof(host), type, type, name, port == 0);
-	if(fd[0] < 0) {
-		JANUS_LOG(LOG_ERR, "[%s] Can't bind to port %d...\n", name, port);
-		return NULL;
-	}
-	port = janus_streaming_get_fd_port(fd[0]);
-	if(dortcp) {
-		rtcp_fd = janus_streaming_create_fd(rtcpport, mcast ? inet_addr(mcast) : INADDR_ANY, iface,
-			NULL, 0, type, type, name, rtcpport == 0);
-		if(rtcp_fd < 0) {
-			JANUS_LOG(LOG_ERR, "[%s] Can't bind to port %d for RTCP...\n", name, rtcpport);
-			if(fd[0] > -1)
-				close(fd[0]);
-			return NULL;
+	if(pipename != NULL) {
+		/* This stream will be fed in-process by RTP forwarders targeting the
+		 * named pipe, so instead of binding a port we create a socket pair:
+		 * we read from one end, and register the other with the core */
+		if(dortcp) {
+			JANUS_LOG(LOG_WARN, "[%s] RTCP is not supported on 'pipe' streams, ignoring...\n", name);
+			dortcp = FALSE;
+			rtcpport = 0;
 		}
-		rtcpport = janus_streaming_get_fd_port(rtcp_fd);
-	}
-	if(mtype == JANUS_STREAMING_MEDIA_VIDEO) {
 		if(simulcast) {
-			fd[1] = janus_streaming_create_fd(port2, mcast ? inet_addr(mcast) : INADDR_ANY, iface,
-				NULL, 0, "Video", "video", name, FALSE);
-			if(fd[1] < 0) {
-				JANUS_LOG(LOG_ERR, "[%s] Can't bind to port %d for video (2nd port)...\n", name, port2);
+			JANUS_LOG(LOG_WARN, "[%s] Simulcast is not supported on 'pipe' streams, ignoring...\n", name);
+			simulcast = FALSE;
+		}
+		int pfd[2] = {-1, -1};
+		if(socketpair(AF_UNIX, SOCK_DGRAM, 0, pfd) < 0) {
+			JANUS_LOG(LOG_ERR, "[%s] Error creating socket pair for pipe '%s'... %d (%s)\n",
+				name, pipename, errno, g_strerror(errno));
+			return NULL;
+		}
+		if(janus_rtp_pipe_register(pipename, pfd[1]) < 0) {
+			JANUS_LOG(LOG_ERR, "[%s] Error registering local pipe '%s'...\n", name, pipename);
+			close(pfd[0]);
+			close(pfd[1]);
+			return NULL;
+		}
+		fd[0] = pfd[0];
+		port = 0;
+	} else {
+		fd[0] = janus_streaming_create_fd(port, mcast ? inet_addr(mcast) : INADDR_ANY, iface,
+			host, sizeof(host), type, type, name, port == 0);
+		if(fd[0] < 0) {
+			JANUS_LOG(LOG_ERR, "[%s] Can't bind to port %d...\n", name, port);
+			return NULL;
+		}
+		port = janus_streaming_get_fd_port(fd[0]);
+		if(dortcp) {
+			rtcp_fd = janus_streaming_create_fd(rtcpport, mcast ? inet_addr(mcast) : INADDR_ANY, iface,
+				NULL, 0, type, type, name, rtcpport == 0);
+			if(rtcp_fd < 0) {
+				JANUS_LOG(LOG_ERR, "[%s] Can't bind to port %d for RTCP...\n", name, rtcpport);
 				if(fd[0] > -1)
 					close(fd[0]);
-				if(rtcp_fd > -1)
-					close(rtcp_fd);
 				return NULL;
 			}
-			port2 = janus_streaming_get_fd_port(fd[1]);
-			fd[2] = janus_streaming_create_fd(port3, mcast ? inet_addr(mcast) : INADDR_ANY, iface,
-				NULL, 0, "Video", "video", name, FALSE);
-			if(fd[2] < 0) {
-				JANUS_LOG(LOG_ERR, "[%s] Can't bind to port %d for video (3rd port)...\n", name, port3);
-				if(fd[0] > -1)
-					close(fd[0]);
-				if(rtcp_fd > -1)
-					close(rtcp_fd);
-				if(fd[1] > -1)
-					close(fd[1]);
-				return NULL;
+			rtcpport = janus_streaming_get_fd_port(rtcp_fd);
+		}
+		if(mtype == JANUS_STREAMING_MEDIA_VIDEO) {
+			if(simulcast) {
+				fd[1] = janus_streaming_create_fd(port2, mcast ? inet_addr(mcast) : INADDR_ANY, iface,
+					NULL, 0, "Video", "video", name, FALSE);
+				if(fd[1] < 0) {
+					JANUS_LOG(LOG_ERR, "[%s] Can't bind to port %d for video (2nd port)...\n", name, port2);
+					if(fd[0] > -1)
+						close(fd[0]);
+					if(rtcp_fd > -1)
+						close(rtcp_fd);
+					return NULL;
+				}
+				port2 = janus_streaming_get_fd_port(fd[1]);
+				fd[2] = janus_streaming_create_fd(port3, mcast ? inet_addr(mcast) : INADDR_ANY, iface,
+					NULL, 0, "Video", "video", name, FALSE);
+				if(fd[2] < 0) {
+					JANUS_LOG(LOG_ERR, "[%s] Can't bind to port %d for video (3rd port)...\n", name, port3);
+					if(fd[0] > -1)
+						close(fd[0]);
+					if(rtcp_fd > -1)
+						close(rtcp_fd);
+					if(fd[1] > -1)
+						close(fd[1]);
+					return NULL;
+				}
+				port3 = janus_streaming_get_fd_port(fd[2]);
 			}
-			port3 = janus_streaming_get_fd_port(fd[2]);
 		}
 	}
 	/* Create the stream */
@@ -7579,6 +8037,7 @@ janus_streaming_rtp_source_stream *janus_streaming_create_rtp_source_stream(
 	stream->mcast_str = mcast ? g_strdup(mcast) : NULL;
 	if(strlen(host) > 0)
 		stream->host = g_strdup(host);
+	stream->pipe_name = pipename ? g_strdup(pipename) : NULL;
 	stream->port[0] = port;
 	stream->rtcp_port = rtcpport ? rtcpport : -1;
 	stream->port[1] = stream->simulcast ? port2 : -1;
@@ -7609,6 +8068,8 @@ janus_streaming_rtp_source_stream *janus_streaming_create_rtp_source_stream(
 		stream->last_msg = NULL;
 		janus_mutex_init(&stream->buffermsg_mutex);
 	}
+	stream->dvr_packets = NULL;
+	janus_mutex_init(&stream->dvr_mutex);
 	janus_refcount_init(&stream->ref, janus_streaming_rtp_source_stream_free);
 	return stream;
 }
@@ -7616,7 +8077,7 @@ janus_streaming_rtp_source_stream *janus_streaming_create_rtp_source_stream(
 janus_streaming_mountpoint *janus_streaming_create_rtp_source(
 		uint64_t id, char *id_str, char *name, char *desc, char *metadata,
 		GList *media, int srtpsuite, char *srtpcrypto, int threads, int rtp_collision,
-		gboolean e2ee, gboolean playoutdelay_ext, int abscapturetime_src_ext_id) {
+		int dvr, gboolean e2ee, gboolean playoutdelay_ext, int abscapturetime_src_ext_id) {
 	char id_num[30];
 	if(!string_ids) {
 		g_snprintf(id_num, sizeof(id_num), "%"SCNu64, id);
@@ -7741,10 +8202,24 @@ janus_streaming_mountpoint *janus_streaming_create_rtp_source(
 	janus_mutex_init(&live_rtp_source->rec_mutex);
 	live_rtp_source->rtp_collision = rtp_collision;
 	live_rtp_source->e2ee = e2ee;
+	if(e2ee) {
+		/* Media is end-to-end encrypted, so we can't detect keyframes: disable
+		 * any keyframe buffering that may have been enabled on the streams */
+		temp = media;
+		while(temp) {
+			janus_streaming_rtp_source_stream *stream = (janus_streaming_rtp_source_stream *)temp->data;
+			if(stream->keyframe.enabled) {
+				JANUS_LOG(LOG_WARN, "[%s] Disabling keyframe buffering, media is end-to-end encrypted\n", name);
+				stream->keyframe.enabled = FALSE;
+			}
+			temp = temp->next;
+		}
+	}
 	live_rtp_source->playoutdelay_ext = playoutdelay_ext;
 	live_rtp_source->abscapturetime_src_ext_id = abscapturetime_src_ext_id;
 	live_rtp->source = live_rtp_source;
 	live_rtp->source_destroy = (GDestroyNotify) janus_streaming_rtp_source_free;
+	live_rtp->dvr_seconds = dvr > 0 ? dvr : 0;
 	live_rtp->viewers = NULL;
 	g_atomic_int_set(&live_rtp->destroyed, 0);
 	janus_refcount_init(&live_rtp->ref, janus_streaming_mountpoint_free);
@@ -7790,17 +8265,21 @@ janus_streaming_mountpoint *janus_streaming_create_rtp_source(
 		}
 	}
 	janus_mutex_unlock(&mountpoints_mutex);
-	/* Finally, create the mountpoint thread itself */
-	g_snprintf(tname, sizeof(tname), "mp %s", live_rtp->id_str);
-	janus_refcount_increase(&live_rtp->ref);
-	live_rtp->thread = g_thread_try_new(tname, &janus_streaming_relay_thread, live_rtp, &error);
-	if(error != NULL) {
-		JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the RTP thread...\n",
-			error->code, error->message ? error->message : "??");
-		g_error_free(error);
-		janus_refcount_decrease(&live_rtp->ref);	/* This is for the failed thread */
-		janus_streaming_mountpoint_destroy(live_rtp);
-		return NULL;
+	/* Finally, create the mountpoint thread itself, unless the shared relay
+	 * engine can serve this mountpoint instead: mountpoints using helper
+	 * threads are expected to be busy enough to deserve a dedicated one */
+	if(!janus_streaming_relay_register(live_rtp)) {
+		g_snprintf(tname, sizeof(tname), "mp %s", live_rtp->id_str);
+		janus_refcount_increase(&live_rtp->ref);
+		live_rtp->thread = g_thread_try_new(tname, &janus_streaming_relay_thread, live_rtp, &error);
+		if(error != NULL) {
+			JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the RTP thread...\n",
+				error->code, error->message ? error->message : "??");
+			g_error_free(error);
+			janus_refcount_decrease(&live_rtp->ref);	/* This is for the failed thread */
+			janus_streaming_mountpoint_destroy(live_rtp);
+			return NULL;
+		}
 	}
 	return live_rtp;
 }
@@ -8776,6 +9255,35 @@ static int janus_streaming_rtsp_play(janus_streaming_rtp_source *source) {
 	return 0;
 }
 
+/* Thread pool worker used at startup to connect an RTSP mountpoint that was
+ * just restored from the configuration file: the relay thread is kept waiting
+ * (via the reconnecting flag) until we're done, so that it doesn't attempt a
+ * connection of its own in the meanwhile */
+static void janus_streaming_rtsp_startup_connect(gpointer data, gpointer user_data) {
+	janus_streaming_rtsp_startup *pending = (janus_streaming_rtsp_startup *)data;
+	janus_streaming_mountpoint *mp = pending->mp;
+	janus_streaming_rtp_source *source = mp->source;
+	/* Connect to the RTSP server and send a PLAY, now */
+	if(janus_streaming_rtsp_connect_to_server(mp) < 0 || janus_streaming_rtsp_play(source) < 0) {
+		if(pending->error_on_failure) {
+			/* Error connecting, get rid of the mountpoint */
+			JANUS_LOG(LOG_ERR, "Error connecting to 'rtsp' mountpoint '%s', destroying it...\n", mp->name);
+			janus_mutex_lock(&mountpoints_mutex);
+			g_hash_table_remove(mountpoints, string_ids ? (gpointer)mp->id_str : (gpointer)&mp->id);
+			janus_mutex_unlock(&mountpoints_mutex);
+		} else {
+			/* The relay thread will try reconnecting on its own */
+			JANUS_LOG(LOG_WARN, "Error connecting to 'rtsp' mountpoint '%s', will retry later...\n", mp->name);
+		}
+	} else {
+		source->rtsp_connected = TRUE;
+	}
+	source->reconnect_timer = janus_get_monotonic_time();
+	source->reconnecting = FALSE;
+	janus_refcount_decrease(&mp->ref);
+	g_free(pending);
+}
+
 /* Helper to create an RTSP source */
 janus_streaming_mountpoint *janus_streaming_create_rtsp_source(
 		uint64_t id, char *id_str, char *name, char *desc, char *metadata,
@@ -8866,6 +9374,7 @@ janus_streaming_mountpoint *janus_streaming_create_rtsp_source(
 	live_rtsp_source->rtsp_bufferkf = bufferkf;
 	live_rtsp_source->ka_timeout = session_timeout;
 	live_rtsp_source->reconnect_delay = reconnect_delay;
+	live_rtsp_source->reconnect_wait = reconnect_delay;
 	live_rtsp_source->session_timeout = session_timeout;
 	live_rtsp_source->rtsp_timeout = rtsp_timeout;
 	live_rtsp_source->rtsp_conn_timeout = rtsp_conn_timeout;
@@ -8908,6 +9417,7 @@ janus_streaming_mountpoint *janus_streaming_create_rtsp_source(
 			janus_refcount_decrease(&live_rtsp->ref);
 			return NULL;
 		}
+		live_rtsp_source->rtsp_connected = TRUE;
 	}
 	/* If we need helper threads, spawn them now */
 	GError *error = NULL;
@@ -8985,6 +9495,175 @@ janus_streaming_mountpoint *janus_streaming_create_rtsp_source(
 #endif
 
 /* Thread to send RTP packets from a file (on demand) */
+/* Register an on-demand viewer with the shared pacer thread: returns FALSE
+ * if the viewer needs a dedicated on-demand thread instead */
+static gboolean janus_streaming_ondemand_register(janus_streaming_session *session, janus_streaming_mountpoint *mp) {
+	janus_streaming_file_source *source = mp->source;
+	if(source == NULL || source->filename == NULL || source->opus) {
+		/* Parsing the Ogg container is stateful, keep a dedicated thread */
+		return FALSE;
+	}
+	janus_mutex_lock(&ondemand_viewers_mutex);
+	if(source->map == NULL) {
+		/* Map the file the first time someone watches this mountpoint */
+		FILE *audio = fopen(source->filename, "rb");
+		if(audio == NULL) {
+			janus_mutex_unlock(&ondemand_viewers_mutex);
+			JANUS_LOG(LOG_ERR, "[%s] Ooops, audio file missing!\n", mp->name);
+			return FALSE;
+		}
+		fseek(audio, 0, SEEK_END);
+		long int size = ftell(audio);
+		if(size <= 0) {
+			fclose(audio);
+			janus_mutex_unlock(&ondemand_viewers_mutex);
+			JANUS_LOG(LOG_ERR, "[%s] Ooops, empty audio file!\n", mp->name);
+			return FALSE;
+		}
+		char *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fileno(audio), 0);
+		fclose(audio);
+		if(map == MAP_FAILED) {
+			janus_mutex_unlock(&ondemand_viewers_mutex);
+			JANUS_LOG(LOG_WARN, "[%s] Error mapping audio file (%s), falling back to a dedicated thread\n",
+				mp->name, g_strerror(errno));
+			return FALSE;
+		}
+		source->map = map;
+		source->map_size = (size_t)size;
+		JANUS_LOG(LOG_VERB, "[%s] Memory-mapped %s (%zu bytes)\n", mp->name, source->filename, source->map_size);
+	}
+	/* Start the shared pacer thread, if we haven't already */
+	if(ondemand_pacer_thread == NULL) {
+		GError *error = NULL;
+		ondemand_pacer_thread = g_thread_try_new("ondemand pacer", &janus_streaming_ondemand_pacer, NULL, &error);
+		if(error != NULL) {
+			JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the on-demand pacer thread...\n",
+				error->code, error->message ? error->message : "??");
+			g_error_free(error);
+			janus_mutex_unlock(&ondemand_viewers_mutex);
+			return FALSE;
+		}
+	}
+	janus_streaming_ondemand_viewer *viewer = g_malloc0(sizeof(janus_streaming_ondemand_viewer));
+	viewer->session = session;
+	viewer->mp = mp;
+	viewer->seq = 1;
+	janus_refcount_increase(&session->ref);
+	janus_refcount_increase(&mp->ref);
+	ondemand_viewers = g_list_append(ondemand_viewers, viewer);
+	janus_mutex_unlock(&ondemand_viewers_mutex);
+	return TRUE;
+}
+
+/* Thread pacing the RTP packets of all the on-demand viewers sharing a mapped file */
+static void *janus_streaming_ondemand_pacer(void *data) {
+	JANUS_LOG(LOG_VERB, "Starting on-demand pacer thread\n");
+	/* Buffer */
+	char buf[1500];
+	memset(buf, 0, sizeof(buf));
+	janus_rtp_header *header = (janus_rtp_header *)buf;
+	/* Timer */
+	struct timeval now, before;
+	gettimeofday(&before, NULL);
+	now.tv_sec = before.tv_sec;
+	now.tv_usec = before.tv_usec;
+	time_t passed, d_s, d_us;
+	/* Loop */
+	janus_streaming_rtp_relay_packet packet;
+	while(!g_atomic_int_get(&stopping)) {
+		/* See if it's time to prepare a frame */
+		gettimeofday(&now, NULL);
+		d_s = now.tv_sec - before.tv_sec;
+		d_us = now.tv_usec - before.tv_usec;
+		if(d_us < 0) {
+			d_us += 1000000;
+			--d_s;
+		}
+		passed = d_s*1000000 + d_us;
+		if(passed < 18000) {	/* Let's wait about 18ms */
+			g_usleep(5000);
+			continue;
+		}
+		/* Update the reference time */
+		before.tv_usec += 20000;
+		if(before.tv_usec > 1000000) {
+			before.tv_sec++;
+			before.tv_usec -= 1000000;
+		}
+		/* Send each viewer its next frame */
+		janus_mutex_lock(&ondemand_viewers_mutex);
+		GList *temp = ondemand_viewers;
+		while(temp) {
+			janus_streaming_ondemand_viewer *viewer = (janus_streaming_ondemand_viewer *)temp->data;
+			GList *next = temp->next;
+			janus_streaming_session *session = viewer->session;
+			janus_streaming_mountpoint *mountpoint = viewer->mp;
+			if(g_atomic_int_get(&mountpoint->destroyed) || g_atomic_int_get(&session->stopping) ||
+					g_atomic_int_get(&session->destroyed)) {
+				/* This viewer is gone */
+				ondemand_viewers = g_list_delete_link(ondemand_viewers, temp);
+				janus_refcount_decrease(&session->ref);
+				janus_refcount_decrease(&mountpoint->ref);
+				g_free(viewer);
+				temp = next;
+				continue;
+			}
+			/* If not started or paused, wait some more */
+			if(!g_atomic_int_get(&session->started) || g_atomic_int_get(&session->paused) || !mountpoint->enabled) {
+				temp = next;
+				continue;
+			}
+			janus_streaming_file_source *source = mountpoint->source;
+			if(viewer->offset + 160 > source->map_size) {
+				/* FIXME We're doing this forever... should this be configurable? */
+				JANUS_LOG(LOG_HUGE, "[%s] Rewind! (%s)\n", mountpoint->name, source->filename);
+				viewer->offset = 0;
+			}
+			if(mountpoint->active == FALSE)
+				mountpoint->active = TRUE;
+			/* Prepare the RTP packet with this viewer's next frame */
+			memcpy(buf + RTP_HEADER_SIZE, source->map + viewer->offset, 160);
+			viewer->offset += 160;
+			header->version = 2;
+			header->markerbit = (viewer->seq == 1);
+			header->type = source->codecs.pt;
+			header->seq_number = htons(viewer->seq);
+			header->timestamp = htonl(viewer->ts);
+			header->ssrc = htonl(1);	/* The gateway will fix this anyway */
+			/* Relay to the listener */
+			packet.mindex = -1;
+			packet.data = header;
+			packet.length = RTP_HEADER_SIZE + 160;
+			packet.is_rtp = TRUE;
+			packet.is_video = FALSE;
+			packet.is_keyframe = FALSE;
+			/* Backup the actual payload type, timestamp and sequence number */
+			packet.ptype = packet.data->type;
+			packet.timestamp = ntohl(packet.data->timestamp);
+			packet.seq_number = ntohs(packet.data->seq_number);
+			/* Go! */
+			janus_streaming_relay_rtp_packet(session, &packet);
+			/* Update the RTP state of this viewer */
+			viewer->seq++;
+			viewer->ts += 160;
+			temp = next;
+		}
+		janus_mutex_unlock(&ondemand_viewers_mutex);
+	}
+	/* We're done, get rid of any viewer we were still serving */
+	janus_mutex_lock(&ondemand_viewers_mutex);
+	while(ondemand_viewers != NULL) {
+		janus_streaming_ondemand_viewer *viewer = (janus_streaming_ondemand_viewer *)ondemand_viewers->data;
+		janus_refcount_decrease(&viewer->session->ref);
+		janus_refcount_decrease(&viewer->mp->ref);
+		g_free(viewer);
+		ondemand_viewers = g_list_delete_link(ondemand_viewers, ondemand_viewers);
+	}
+	janus_mutex_unlock(&ondemand_viewers_mutex);
+	JANUS_LOG(LOG_VERB, "Leaving on-demand pacer thread\n");
+	return NULL;
+}
+
 static void *janus_streaming_ondemand_thread(void *data) {
 	JANUS_LOG(LOG_VERB, "Filesource (on demand) RTP thread starting...\n");
 	janus_streaming_session *session = (janus_streaming_session *)data;
@@ -9283,9 +9962,7 @@ static void *janus_streaming_filesource_thread(void *data) {
 		packet.timestamp = ntohl(packet.data->timestamp);
 		packet.seq_number = ntohs(packet.data->seq_number);
 		/* Go! */
-		janus_mutex_lock_nodebug(&mountpoint->mutex);
-		g_list_foreach(mountpoint->viewers, janus_streaming_relay_rtp_packet, &packet);
-		janus_mutex_unlock_nodebug(&mountpoint->mutex);
+		janus_streaming_relay_fanout(mountpoint, janus_streaming_relay_rtp_packet, &packet);
 		/* Update header */
 		seq++;
 		header->seq_number = htons(seq);
@@ -9305,67 +9982,838 @@ static void *janus_streaming_filesource_thread(void *data) {
 }
 
 /* Thread to relay RTP frames coming from gstreamer/ffmpeg/others */
-static void *janus_streaming_relay_thread(void *data) {
-	JANUS_LOG(LOG_VERB, "Starting streaming relay thread\n");
-	janus_streaming_mountpoint *mountpoint = (janus_streaming_mountpoint *)data;
-	if(!mountpoint) {
-		JANUS_LOG(LOG_ERR, "Invalid mountpoint!\n");
-		return NULL;
-	}
-	if(mountpoint->streaming_source != janus_streaming_source_rtp) {
-		JANUS_LOG(LOG_ERR, "[%s] Not an RTP source mountpoint!\n", mountpoint->name);
-		janus_refcount_decrease(&mountpoint->ref);
-		return NULL;
+/* Helper to relay a packet to all the viewers of a mountpoint: thanks to
+ * the viewers snapshot we never hold the mountpoint mutex while iterating,
+ * so viewers joining or leaving can't stall media distribution */
+static void janus_streaming_relay_fanout(janus_streaming_mountpoint *mountpoint,
+		GFunc relay, janus_streaming_rtp_relay_packet *packet) {
+	if(mountpoint->helper_threads > 0) {
+		/* We're using helper threads, queue the packet on each of them
+		 * (the threads list never changes while the mountpoint is live) */
+		g_list_foreach(mountpoint->threads, janus_streaming_helper_rtprtcp_packet, packet);
+		return;
 	}
+	janus_streaming_viewers_snapshot *snapshot =
+		janus_streaming_viewers_snapshot_get(&mountpoint->mutex, &mountpoint->viewers_snapshot);
+	if(snapshot == NULL)
+		return;
+	g_list_foreach(snapshot->viewers, relay, packet);
+	janus_refcount_decrease(&snapshot->ref);
+}
+
+/* Helper to react to an error on one of the sockets of a mountpoint */
+static void janus_streaming_relay_error(janus_streaming_mountpoint *mountpoint) {
 	janus_streaming_rtp_source *source = mountpoint->source;
-	if(source == NULL) {
-		JANUS_LOG(LOG_ERR, "[%s] Invalid RTP source mountpoint!\n", mountpoint->name);
-		janus_refcount_decrease(&mountpoint->ref);
-		return NULL;
-	}
+	mountpoint->enabled = FALSE;
+	janus_mutex_lock(&source->rec_mutex);
+	GList *temp = source->media;
+	while(temp) {
+		janus_streaming_rtp_source_stream *stream = (janus_streaming_rtp_source_stream *)temp->data;
+		janus_recorder_close(stream->rc);
+		JANUS_LOG(LOG_INFO, "[%s] Closed %s recording %s (%s)\n", mountpoint->name,
+			janus_streaming_media_str(stream->type), stream->rc->filename, stream->mid);
+		janus_recorder *tmp = stream->rc;
+		stream->rc = NULL;
+		janus_recorder_destroy(tmp);
+		break;
+	}
+	janus_mutex_unlock(&source->rec_mutex);
+}
 
-	/* Check how many file descriptors we'll need to monitor */
-	int num = 0;
-	janus_streaming_rtp_source_stream *stream = NULL;
+/* Helper to check if there's any PLI and/or REMB we should send back to a source */
+static void janus_streaming_relay_rtcp_checks(janus_streaming_rtp_source *source) {
 	GList *temp = source->media;
 	while(temp) {
 		janus_streaming_rtp_source_stream *stream = (janus_streaming_rtp_source_stream *)temp->data;
-		if(stream->fd[0] != -1)
-			num++;
-		if(stream->fd[1] != -1)
-			num++;
-		if(stream->fd[2] != -1)
-			num++;
-		if(stream->rtcp_fd != -1)
-			num++;
+		if(stream->type == JANUS_STREAMING_MEDIA_VIDEO) {
+			if(g_atomic_int_get(&stream->need_pli))
+				janus_streaming_rtcp_pli_send(stream);
+			if(stream->rtcp_fd > -1 && source->lowest_bitrate > 0) {
+				gint64 now = janus_get_monotonic_time();
+				if(source->remb_latest == 0)
+					source->remb_latest = now;
+				else if(now - source->remb_latest >= G_USEC_PER_SEC)
+					janus_streaming_rtcp_remb_send(source, stream);
+			}
+		}
 		temp = temp->next;
 	}
-	num++;	/* There's the pipe too */
+}
 
-	/* Add a reference to the helper threads, if needed */
-	if(mountpoint->helper_threads > 0) {
-		GList *l = mountpoint->threads;
-		while(l) {
-			janus_streaming_helper *ht = (janus_streaming_helper *)l->data;
-			janus_refcount_increase(&ht->ref);
-			l = l->next;
+/* Store a copy of a packet in the DVR ring of a stream, getting rid of the entries that are now too old */
+static void janus_streaming_rtp_dvr_save(janus_streaming_rtp_source_stream *stream,
+		int dvr_seconds, janus_streaming_rtp_relay_packet *packet) {
+	janus_streaming_rtp_relay_packet *pkt = g_malloc0(sizeof(janus_streaming_rtp_relay_packet));
+	*pkt = *packet;
+	pkt->data = g_malloc(packet->length);
+	memcpy(pkt->data, packet->data, packet->length);
+	pkt->received = janus_get_monotonic_time();
+	gint64 oldest = pkt->received - (gint64)dvr_seconds*G_USEC_PER_SEC;
+	janus_mutex_lock(&stream->dvr_mutex);
+	if(stream->dvr_packets == NULL)
+		stream->dvr_packets = g_queue_new();
+	g_queue_push_tail(stream->dvr_packets, pkt);
+	janus_streaming_rtp_relay_packet *head = NULL;
+	while((head = g_queue_peek_head(stream->dvr_packets)) != NULL && head->received < oldest) {
+		g_queue_pop_head(stream->dvr_packets);
+		janus_streaming_rtp_relay_packet_free(head);
+	}
+	janus_mutex_unlock(&stream->dvr_mutex);
+}
+
+/* Replay the part of the DVR ring of a stream the viewer asked for: the per-session
+ * RTP switching context will rewrite timestamps and sequence numbers, so that the
+ * transition from the replayed history to the live stream looks seamless */
+static void janus_streaming_rtp_dvr_replay(janus_streaming_rtp_source_stream *stream,
+		janus_streaming_session *session, int offset) {
+	gint64 from = janus_get_monotonic_time() - (gint64)offset*G_USEC_PER_SEC;
+	janus_mutex_lock(&stream->dvr_mutex);
+	if(stream->dvr_packets != NULL) {
+		JANUS_LOG(LOG_HUGE, "Replaying up to %u packets from the DVR ring (%s)\n",
+			g_queue_get_length(stream->dvr_packets), stream->mid);
+		GList *temp = stream->dvr_packets->head;
+		while(temp) {
+			janus_streaming_rtp_relay_packet *pkt = (janus_streaming_rtp_relay_packet *)temp->data;
+			if(pkt->received >= from)
+				janus_streaming_relay_rtp_packet(session, pkt);
+			temp = temp->next;
 		}
 	}
+	janus_mutex_unlock(&stream->dvr_mutex);
+}
 
-	char *name = g_strdup(mountpoint->name ? mountpoint->name : "??");
-	/* Needed to fix seq and ts */
-	uint32_t ssrc = 0;
-	/* File descriptors */
+/* Helper to handle an incoming packet on one of the sockets of a mountpoint:
+ * returns FALSE if the mountpoint was interrupted via its pipe, TRUE otherwise */
+static gboolean janus_streaming_relay_readable(janus_streaming_mountpoint *mountpoint, int fd) {
+	janus_streaming_rtp_source *source = mountpoint->source;
+	const char *name = mountpoint->name ? mountpoint->name : "??";
 	socklen_t addrlen;
 	struct sockaddr_storage remote;
-	int resfd = 0, bytes = 0;
-	struct pollfd *fds = g_malloc(num * sizeof(struct pollfd));
+	int bytes = 0;
+	uint32_t ssrc = 0;
 	char buffer[1500];
-	memset(buffer, 0, 1500);
-	/* We'll have a dynamic number of streams */
+	janus_streaming_rtp_relay_packet packet;
+	memset(&packet, 0, sizeof(packet));
+	if(fd == source->pipefd[0]) {
+		/* We're done here */
+		int code = 0;
+		bytes = read(fd, &code, sizeof(int));
+		JANUS_LOG(LOG_VERB, "[%s] Interrupting mountpoint\n", mountpoint->name);
+		return FALSE;
+	}
+	/* Check which stream this file descriptor belongs to */
+	janus_streaming_rtp_source_stream *stream = g_hash_table_lookup(source->media_byfd, GINT_TO_POINTER(fd));
+	if(stream == NULL) {
+		/* No stream..? Shouldn't happen, read the bytes and dump them */
+		addrlen = sizeof(remote);
+		(void)recvfrom(fd, buffer, 1500, 0, (struct sockaddr *)&remote, &addrlen);
+		return TRUE;
+	}
+	if(stream->type == JANUS_STREAMING_MEDIA_AUDIO && fd == stream->fd[0]) {
+		/* Got something audio (RTP) */
+		if(mountpoint->active == FALSE)
+			mountpoint->active = TRUE;
+		gint64 now = janus_get_monotonic_time();
 #ifdef HAVE_LIBCURL
-	/* In case this is an RTSP restreamer, we may have to send keep-alive from time to time */
-	gint64 now = janus_get_monotonic_time(), before = now, ka_timeout = 0;
+		source->reconnect_timer = now;
+#endif
+		addrlen = sizeof(remote);
+		bytes = recvfrom(fd, buffer, 1500, 0, (struct sockaddr *)&remote, &addrlen);
+		if(bytes < 0 || !janus_is_rtp(buffer, bytes)) {
+			/* Failed to read or not an RTP packet? */
+			return TRUE;
+		}
+		janus_rtp_header *rtp = (janus_rtp_header *)buffer;
+		ssrc = ntohl(rtp->ssrc);
+		if(source->rtp_collision > 0 && stream->last_ssrc[0] && ssrc != stream->last_ssrc[0] &&
+				(now-stream->last_received[0]) < (gint64)1000*source->rtp_collision) {
+			JANUS_LOG(LOG_WARN, "[%s] RTP collision on audio mountpoint, dropping packet (#%d, ssrc=%"SCNu32")\n",
+				name, stream->mindex, ssrc);
+			return TRUE;
+		}
+		stream->last_received[0] = now;
+		/* Do we have a new stream? */
+		if(ssrc != stream->last_ssrc[0]) {
+			stream->ssrc = stream->last_ssrc[0] = ssrc;
+			JANUS_LOG(LOG_INFO, "[%s] New audio stream! (#%d, ssrc=%"SCNu32")\n", name, stream->mindex, ssrc);
+		}
+		/* If paused, ignore this packet */
+		if(!mountpoint->enabled && !stream->rc)
+			return TRUE;
+		/* Is this SRTP? */
+		if(source->is_srtp) {
+			int buflen = bytes;
+			srtp_err_status_t res = srtp_unprotect(source->srtp_ctx, buffer, &buflen);
+			if(res != srtp_err_status_ok) {
+				guint32 timestamp = ntohl(rtp->timestamp);
+				guint16 seq = ntohs(rtp->seq_number);
+				JANUS_LOG(LOG_ERR, "[%s] Audio (#%d) SRTP unprotect error: %s (len=%d-->%d, ts=%"SCNu32", seq=%"SCNu16")\n",
+					name, stream->mindex, janus_srtp_error_str(res), bytes, buflen, timestamp, seq);
+				return TRUE;
+			}
+			bytes = buflen;
+		}
+		/* Relay on all sessions */
+		packet.mindex = stream->mindex;
+		packet.data = rtp;
+		packet.length = bytes;
+		packet.is_rtp = TRUE;
+		packet.is_video = FALSE;
+		packet.is_keyframe = FALSE;
+		packet.data->type = stream->codecs.pt;
+		/* Is there a recorder? */
+		janus_rtp_header_update(packet.data, &stream->context[0], FALSE, 0);
+		if(stream->skew) {
+			int ret = janus_rtp_skew_compensate_audio(packet.data, &stream->context[0], now);
+			if(ret < 0) {
+				JANUS_LOG(LOG_WARN, "[%s] Dropping %d packets, audio source clock is too fast (#%d, ssrc=%"SCNu32")\n",
+					name, -ret, stream->mindex, ssrc);
+				return TRUE;
+			} else if(ret > 0) {
+				JANUS_LOG(LOG_WARN, "[%s] Jumping %d RTP sequence numbers, audio source clock is too slow (#%d, ssrc=%"SCNu32")\n",
+					name, ret, stream->mindex, ssrc);
+			}
+		}
+		if(stream->rc) {
+			packet.data->ssrc = htonl((uint32_t)mountpoint->id);
+			janus_recorder_save_frame(stream->rc, buffer, bytes);
+		}
+		if(mountpoint->enabled) {
+			packet.data->ssrc = htonl(ssrc);
+			/* Backup the actual payload type, timestamp and sequence number set by the restreamer, in case switching is involved */
+			packet.ptype = packet.data->type;
+			packet.timestamp = ntohl(packet.data->timestamp);
+			packet.seq_number = ntohs(packet.data->seq_number);
+			/* Go! */
+			janus_streaming_relay_fanout(mountpoint, janus_streaming_relay_rtp_packet, &packet);
+			/* Are we keeping the recent history too, for late joiners? */
+			if(mountpoint->dvr_seconds > 0)
+				janus_streaming_rtp_dvr_save(stream, mountpoint->dvr_seconds, &packet);
+		}
+		return TRUE;
+	} else if(stream->type == JANUS_STREAMING_MEDIA_VIDEO && ((fd == stream->fd[0]) ||
+			(fd == stream->fd[1]) || (fd == stream->fd[2]))) {
+		/* Got something video (RTP) */
+		int index = -1;
+		if(fd == stream->fd[0])
+			index = 0;
+		else if(fd == stream->fd[1])
+			index = 1;
+		else if(fd == stream->fd[2])
+			index = 2;
+		if(mountpoint->active == FALSE)
+			mountpoint->active = TRUE;
+		gint64 now = janus_get_monotonic_time();
+#ifdef HAVE_LIBCURL
+		source->reconnect_timer = now;
+#endif
+		addrlen = sizeof(remote);
+		bytes = recvfrom(fd, buffer, 1500, 0, (struct sockaddr *)&remote, &addrlen);
+		if(bytes < 0 || !janus_is_rtp(buffer, bytes)) {
+			/* Failed to read or not an RTP packet? */
+			return TRUE;
+		}
+		janus_rtp_header *rtp = (janus_rtp_header *)buffer;
+		ssrc = ntohl(rtp->ssrc);
+		if(source->rtp_collision > 0 && stream->last_ssrc[index] && ssrc != stream->last_ssrc[index] &&
+				(now-stream->last_received[index]) < (gint64)1000*source->rtp_collision) {
+			JANUS_LOG(LOG_WARN, "[%s] RTP collision on video mountpoint, dropping packet (#%d, ssrc=%"SCNu32")\n",
+				name, stream->mindex, ssrc);
+			return TRUE;
+		}
+		stream->last_received[index] = now;
+		/* Do we have a new stream? */
+		if(ssrc != stream->last_ssrc[index]) {
+			stream->last_ssrc[index] = ssrc;
+			if(index == 0)
+				stream->ssrc = ssrc;
+			JANUS_LOG(LOG_INFO, "[%s] New video stream! (#%d, ssrc=%"SCNu32", index %d)\n",
+				name, stream->mindex, ssrc, index);
+		}
+		/* Is this SRTP? */
+		if(source->is_srtp) {
+			int buflen = bytes;
+			srtp_err_status_t res = srtp_unprotect(source->srtp_ctx, buffer, &buflen);
+			if(res != srtp_err_status_ok) {
+				guint32 timestamp = ntohl(rtp->timestamp);
+				guint16 seq = ntohs(rtp->seq_number);
+				JANUS_LOG(LOG_ERR, "[%s] Video (#%d) SRTP unprotect error: %s (len=%d-->%d, ts=%"SCNu32", seq=%"SCNu16")\n",
+					name, stream->mindex, janus_srtp_error_str(res), bytes, buflen, timestamp, seq);
+				return TRUE;
+			}
+			bytes = buflen;
+		}
+		/* First of all, let's check if this is (part of) a keyframe that we may need to save it for future reference */
+		if(index == 0 && stream->keyframe.enabled) {
+			if(stream->keyframe.temp_ts > 0 && ntohl(rtp->timestamp) != stream->keyframe.temp_ts) {
+				/* We received the last part of the keyframe, get rid of the old one and use this from now on */
+				JANUS_LOG(LOG_HUGE, "[%s] ... ... last part of keyframe received! ts=%"SCNu32", %d packets\n",
+					name, stream->keyframe.temp_ts, g_list_length(stream->keyframe.temp_keyframe));
+				stream->keyframe.temp_ts = 0;
+				janus_mutex_lock(&stream->keyframe.mutex);
+				if(stream->keyframe.latest_keyframe != NULL)
+					g_list_free_full(stream->keyframe.latest_keyframe, (GDestroyNotify)janus_streaming_rtp_relay_packet_free);
+				stream->keyframe.latest_keyframe = stream->keyframe.temp_keyframe;
+				stream->keyframe.temp_keyframe = NULL;
+				janus_mutex_unlock(&stream->keyframe.mutex);
+			} else if(ntohl(rtp->timestamp) == stream->keyframe.temp_ts) {
+				/* Part of the keyframe we're currently saving, store */
+				janus_mutex_lock(&stream->keyframe.mutex);
+				JANUS_LOG(LOG_HUGE, "[%s] ... other part of keyframe received! ts=%"SCNu32"\n", name, stream->keyframe.temp_ts);
+				janus_streaming_rtp_relay_packet *pkt = g_malloc0(sizeof(janus_streaming_rtp_relay_packet));
+				pkt->mindex = stream->mindex;
+				pkt->data = g_malloc(bytes);
+				memcpy(pkt->data, buffer, bytes);
+				pkt->data->ssrc = htons(1);
+				pkt->data->type = stream->codecs.pt;
+				pkt->is_rtp = TRUE;
+				pkt->is_video = TRUE;
+				pkt->is_keyframe = TRUE;
+				pkt->length = bytes;
+				pkt->ptype = rtp->type;
+				pkt->timestamp = stream->keyframe.temp_ts;
+				pkt->seq_number = ntohs(rtp->seq_number);
+				stream->keyframe.temp_keyframe = g_list_append(stream->keyframe.temp_keyframe, pkt);
+				janus_mutex_unlock(&stream->keyframe.mutex);
+			} else {
+				gboolean kf = FALSE;
+				/* Parse RTP header first */
+				janus_rtp_header *header = (janus_rtp_header *)buffer;
+				guint32 timestamp = ntohl(header->timestamp);
+				guint16 seq = ntohs(header->seq_number);
+				JANUS_LOG(LOG_HUGE, "Checking if packet (size=%d, seq=%"SCNu16", ts=%"SCNu32") is a key frame...\n",
+					bytes, seq, timestamp);
+				int plen = 0;
+				char *payload = janus_rtp_payload(buffer, bytes, &plen);
+				if(payload) {
+					switch(stream->codecs.video_codec) {
+						case JANUS_VIDEOCODEC_VP8:
+							kf = janus_vp8_is_keyframe(payload, plen);
+							break;
+						case JANUS_VIDEOCODEC_VP9:
+							kf = janus_vp9_is_keyframe(payload, plen);
+							break;
+						case JANUS_VIDEOCODEC_H264:
+							kf = janus_h264_is_keyframe(payload, plen);
+							break;
+						case JANUS_VIDEOCODEC_AV1:
+							kf = janus_av1_is_keyframe(payload, plen);
+							break;
+						case JANUS_VIDEOCODEC_H265:
+							kf = janus_h265_is_keyframe(payload, plen);
+							break;
+						default:
+							break;
+					}
+					if(kf) {
+						/* New keyframe, start saving it */
+						stream->keyframe.temp_ts = ntohl(rtp->timestamp);
+						JANUS_LOG(LOG_HUGE, "[%s] New keyframe received! ts=%"SCNu32"\n", name, stream->keyframe.temp_ts);
+						janus_mutex_lock(&stream->keyframe.mutex);
+						janus_streaming_rtp_relay_packet *pkt = g_malloc0(sizeof(janus_streaming_rtp_relay_packet));
+						pkt->mindex = stream->mindex;
+						pkt->data = g_malloc(bytes);
+						memcpy(pkt->data, buffer, bytes);
+						pkt->data->ssrc = htons(1);
+						pkt->data->type = stream->codecs.pt;
+						pkt->is_rtp = TRUE;
+						pkt->is_video = TRUE;
+						pkt->is_keyframe = TRUE;
+						pkt->length = bytes;
+						pkt->ptype = rtp->type;
+						pkt->timestamp = stream->keyframe.temp_ts;
+						pkt->seq_number = ntohs(rtp->seq_number);
+						stream->keyframe.temp_keyframe = g_list_append(stream->keyframe.temp_keyframe, pkt);
+						janus_mutex_unlock(&stream->keyframe.mutex);
+					}
+				}
+			}
+		}
+		/* If paused, ignore this packet */
+		if(!mountpoint->enabled && !stream->rc)
+			return TRUE;
+		/* Relay on all sessions */
+		packet.mindex = stream->mindex;
+		packet.data = rtp;
+		packet.length = bytes;
+		packet.is_rtp = TRUE;
+		packet.is_video = TRUE;
+		packet.is_keyframe = FALSE;
+		packet.simulcast = stream->simulcast;
+		packet.substream = index;
+		packet.codec = stream->codecs.video_codec;
+		packet.svc = FALSE;
+		if(stream->svc) {
+			/* We're doing SVC: let's parse this packet to see which layers are there */
+			int plen = 0;
+			char *payload = janus_rtp_payload(buffer, bytes, &plen);
+			if(payload) {
+				gboolean found = FALSE;
+				memset(&packet.svc_info, 0, sizeof(packet.svc_info));
+				if(janus_vp9_parse_svc(payload, plen, &found, &packet.svc_info) == 0) {
+					packet.svc = found;
+				}
+			}
+		}
+		packet.data->type = stream->codecs.pt;
+		/* Is there a recorder? (FIXME notice we only record the first substream, if simulcasting) */
+		janus_rtp_header_update(packet.data, &stream->context[index], TRUE, 0);
+		if(stream->skew) {
+			int ret = janus_rtp_skew_compensate_video(packet.data, &stream->context[index], now);
+			if(ret < 0) {
+				JANUS_LOG(LOG_WARN, "[%s] Dropping %d packets, video source clock is too fast (#%d, ssrc=%"SCNu32", index %d)\n",
+					name, -ret, stream->mindex, ssrc, index);
+				return TRUE;
+			} else if(ret > 0) {
+				JANUS_LOG(LOG_WARN, "[%s] Jumping %d RTP sequence numbers, video source clock is too slow (#%d, ssrc=%"SCNu32", index %d)\n",
+					name, ret, stream->mindex, ssrc, index);
+			}
+		}
+		if(stream->h264_spspps) {
+			int plen = 0;
+			char *payload = janus_rtp_payload((char *)packet.data, bytes, &plen);
+			/* We have our own SPS/PPS to send, check if we just received a keyframe */
+			if(payload && janus_h264_is_i_frame(payload, plen)) {
+				/* This is an I-frame: prepend an SPS/PPS packet */
+				janus_rtp_header *sps_rtp = (janus_rtp_header *)stream->h264_spspps;
+				sps_rtp->type = rtp->type;
+				sps_rtp->seq_number = rtp->seq_number;
+				rtp->seq_number = htons(ntohs(rtp->seq_number) + 1);
+				stream->context[index].base_seq--;
+				sps_rtp->timestamp = rtp->timestamp;
+				/* Save the packet, if needed */
+				sps_rtp->ssrc = htonl((uint32_t)mountpoint->id);
+				janus_recorder_save_frame(stream->rc, stream->h264_spspps, stream->h264_spspps_len);
+				sps_rtp->ssrc = rtp->ssrc;
+				/* Relay on all sessions */
+				janus_streaming_rtp_relay_packet spspkt = { 0 };
+				spspkt.mindex = stream->mindex;
+				spspkt.data = sps_rtp;
+				spspkt.length = stream->h264_spspps_len;
+				spspkt.is_rtp = TRUE;
+				spspkt.is_video = TRUE;
+				spspkt.is_keyframe = FALSE;
+				spspkt.simulcast = FALSE;
+				spspkt.codec = stream->codecs.video_codec;
+				spspkt.svc = FALSE;
+				spspkt.ptype = spspkt.data->type;
+				spspkt.timestamp = ntohl(spspkt.data->timestamp);
+				spspkt.seq_number = ntohs(spspkt.data->seq_number);
+				JANUS_LOG(LOG_HUGE, "[%s] Sending SPS/PPS (seq=%"SCNu16", ts=%"SCNu32")\n", name,
+					ntohs(spspkt.data->seq_number), ntohl(spspkt.data->timestamp));
+				janus_streaming_relay_fanout(mountpoint, janus_streaming_relay_rtp_packet, &spspkt);
+			}
+		}
+		if(index == 0 && stream->rc) {
+			packet.data->ssrc = htonl((uint32_t)mountpoint->id);
+			janus_recorder_save_frame(stream->rc, buffer, bytes);
+		}
+		if(mountpoint->enabled) {
+			packet.data->ssrc = htonl(ssrc);
+			/* Backup the actual payload type, timestamp and sequence number set by the restreamer, in case switching is involved */
+			packet.ptype = packet.data->type;
+			packet.timestamp = ntohl(packet.data->timestamp);
+			packet.seq_number = ntohs(packet.data->seq_number);
+			/* Take note of the simulcast SSRCs */
+			if(stream->simulcast) {
+				packet.ssrc[0] = stream->last_ssrc[0];
+				packet.ssrc[1] = stream->last_ssrc[1];
+				packet.ssrc[2] = stream->last_ssrc[2];
+			}
+			/* Go! */
+			janus_streaming_relay_fanout(mountpoint, janus_streaming_relay_rtp_packet, &packet);
+			/* Are we keeping the recent history too, for late joiners? (substreams are not buffered) */
+			if(mountpoint->dvr_seconds > 0 && index == 0)
+				janus_streaming_rtp_dvr_save(stream, mountpoint->dvr_seconds, &packet);
+		}
+		return TRUE;
+	} else if(stream->type == JANUS_STREAMING_MEDIA_DATA && fd == stream->fd[0]) {
+		/* Got something data (text) */
+		if(mountpoint->active == FALSE)
+			mountpoint->active = TRUE;
+		stream->last_received[0] = janus_get_monotonic_time();
+#ifdef HAVE_LIBCURL
+		source->reconnect_timer = janus_get_monotonic_time();
+#endif
+		addrlen = sizeof(remote);
+		bytes = recvfrom(fd, buffer, 1500, 0, (struct sockaddr *)&remote, &addrlen);
+		if(bytes < 1) {
+			/* Failed to read? */
+			return TRUE;
+		}
+		if(!mountpoint->enabled && !stream->rc)
+			return TRUE;
+		/* Copy the data */
+		char *data = g_malloc(bytes);
+		memcpy(data, buffer, bytes);
+		/* Relay on all sessions */
+		packet.mindex = stream->mindex;
+		packet.data = (janus_rtp_header *)data;
+		packet.length = bytes;
+		packet.is_rtp = FALSE;
+		packet.is_data = TRUE;
+		packet.textdata = stream->textdata;
+		/* Is there a recorder? */
+		janus_recorder_save_frame(stream->rc, data, bytes);
+		if(mountpoint->enabled) {
+			/* Are we keeping track of the last message being relayed? */
+			if(stream->buffermsg) {
+				janus_mutex_lock(&stream->buffermsg_mutex);
+				janus_streaming_rtp_relay_packet *pkt = g_malloc0(sizeof(janus_streaming_rtp_relay_packet));
+				pkt->data = g_malloc(bytes);
+				memcpy(pkt->data, data, bytes);
+				packet.mindex = stream->mindex;
+				packet.is_rtp = FALSE;
+				packet.is_data = TRUE;
+				packet.textdata = stream->textdata;
+				pkt->length = bytes;
+				janus_mutex_unlock(&stream->buffermsg_mutex);
+			}
+			/* Go! */
+			janus_streaming_relay_fanout(mountpoint, janus_streaming_relay_rtp_packet, &packet);
+		}
+		g_free(packet.data);
+		packet.data = NULL;
+		return TRUE;
+	} else if(fd == stream->rtcp_fd) {
+		addrlen = sizeof(remote);
+		bytes = recvfrom(fd, buffer, 1500, 0, (struct sockaddr *)&remote, &addrlen);
+		if(bytes < 0 || (!janus_is_rtp(buffer, bytes) && !janus_is_rtcp(buffer, bytes))) {
+			/* For latching we need an RTP or RTCP packet */
+			return TRUE;
+		}
+		if(!mountpoint->enabled)
+			return TRUE;
+		memcpy(&stream->rtcp_addr, &remote, addrlen);
+		if(!janus_is_rtcp(buffer, bytes)) {
+			/* Failed to read or not an RTCP packet? */
+			return TRUE;
+		}
+		JANUS_LOG(LOG_HUGE, "[%s] Got audio/video RTCP feedback: #%d, SSRC %"SCNu32"\n",
+			name, stream->mindex, janus_rtcp_get_sender_ssrc(buffer, bytes));
+		/* Relay on all sessions */
+		packet.mindex = stream->mindex;
+		packet.is_rtp = FALSE;
+		packet.is_video = (stream->type == JANUS_STREAMING_MEDIA_VIDEO);
+		packet.data = (janus_rtp_header *)buffer;
+		packet.length = bytes;
+		/* Go! */
+		janus_streaming_relay_fanout(mountpoint, janus_streaming_relay_rtcp_packet, &packet);
+	}
+	return TRUE;
+}
+
+/* Helper to close the sockets of a mountpoint and notify its viewers it's gone */
+static void janus_streaming_relay_leave(janus_streaming_mountpoint *mountpoint) {
+	janus_streaming_rtp_source *source = mountpoint->source;
+	/* Close the ports we bound to */
+	GList *temp = source->media;
+	while(temp) {
+		janus_streaming_rtp_source_stream *stream = (janus_streaming_rtp_source_stream *)temp->data;
+		if(stream->fd[0] > -1)
+			close(stream->fd[0]);
+		stream->fd[0] = -1;
+		if(stream->fd[1] > -1)
+			close(stream->fd[1]);
+		stream->fd[1] = -1;
+		if(stream->fd[2] > -1)
+			close(stream->fd[2]);
+		stream->fd[2] = -1;
+		if(stream->rtcp_fd > -1)
+			close(stream->rtcp_fd);
+		stream->rtcp_fd = -1;
+		temp = temp->next;
+	}
+	/* Notify users this mountpoint is done */
+	janus_mutex_lock(&mountpoint->mutex);
+	GList *viewer = g_list_first(mountpoint->viewers);
+	/* Prepare JSON event */
+	json_t *event = json_object();
+	json_object_set_new(event, "streaming", json_string("event"));
+	json_t *result = json_object();
+	json_object_set_new(result, "status", json_string("stopped"));
+	json_object_set_new(event, "result", result);
+	while(viewer) {
+		janus_streaming_session *session = (janus_streaming_session *)viewer->data;
+		if(session == NULL) {
+			mountpoint->viewers = g_list_remove_all(mountpoint->viewers, session);
+			viewer = g_list_first(mountpoint->viewers);
+			continue;
+		}
+		janus_mutex_lock(&session->mutex);
+		if(session->mountpoint != mountpoint) {
+			mountpoint->viewers = g_list_remove_all(mountpoint->viewers, session);
+			viewer = g_list_first(mountpoint->viewers);
+			janus_mutex_unlock(&session->mutex);
+			continue;
+		}
+		g_atomic_int_set(&session->stopping, 1);
+		g_atomic_int_set(&session->started, 0);
+		g_atomic_int_set(&session->paused, 0);
+		session->mountpoint = NULL;
+		/* Tell the core to tear down the PeerConnection, hangup_media will do the rest */
+		gateway->push_event(session->handle, &janus_streaming_plugin, NULL, event, NULL);
+		gateway->close_pc(session->handle);
+		janus_refcount_decrease(&session->ref);
+		janus_refcount_decrease(&mountpoint->ref);
+		mountpoint->viewers = g_list_remove_all(mountpoint->viewers, session);
+		viewer = g_list_first(mountpoint->viewers);
+		janus_mutex_unlock(&session->mutex);
+	}
+	json_decref(event);
+	janus_streaming_viewers_snapshot_update(mountpoint->viewers, &mountpoint->viewers_snapshot);
+	janus_mutex_unlock(&mountpoint->mutex);
+}
+
+#ifdef __linux__
+/* Shared relay engine implementation */
+#define JANUS_STREAMING_EPOLL_EVENTS	64
+static gboolean janus_streaming_relay_shard_addfd(janus_streaming_relay_shard *shard,
+		janus_streaming_mountpoint *mp, int fd) {
+	if(fd < 0)
+		return TRUE;
+	janus_streaming_relay_fd *rfd = g_malloc(sizeof(janus_streaming_relay_fd));
+	rfd->fd = fd;
+	rfd->mp = mp;
+	struct epoll_event ev = { 0 };
+	ev.events = EPOLLIN;
+	ev.data.ptr = rfd;
+	if(epoll_ctl(shard->epollfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		JANUS_LOG(LOG_ERR, "[%s] Error registering file descriptor on relay shard #%d... %d (%s)\n",
+			mp->name, shard->id, errno, g_strerror(errno));
+		g_free(rfd);
+		return FALSE;
+	}
+	mp->relay_fds = g_slist_prepend(mp->relay_fds, rfd);
+	return TRUE;
+}
+
+/* Register a mountpoint on one of the shards of the shared relay engine:
+ * returns FALSE if the mountpoint needs a dedicated relay thread instead */
+static gboolean janus_streaming_relay_register(janus_streaming_mountpoint *mp) {
+	if(relay_shards_num == 0 || mp->streaming_source != janus_streaming_source_rtp || mp->helper_threads > 0)
+		return FALSE;
+	janus_streaming_rtp_source *source = mp->source;
+	if(source == NULL)
+		return FALSE;
+#ifdef HAVE_LIBCURL
+	/* RTSP mountpoints keep a dedicated thread, as reconnects and
+	 * keep-alives are managed in the relay loop itself */
+	if(source->rtsp)
+		return FALSE;
+#endif
+	/* Pick a shard, round robin */
+	janus_streaming_relay_shard *shard =
+		&relay_shards[((guint)g_atomic_int_add(&relay_shards_rr, 1)) % relay_shards_num];
+	janus_refcount_increase(&mp->ref);
+	mp->relay_shard = shard;
+	/* Register all the file descriptors of this mountpoint, including
+	 * the pipe we use to interrupt the loop when it's destroyed */
+	gboolean ok = TRUE;
+	GList *temp = source->media;
+	while(ok && temp) {
+		janus_streaming_rtp_source_stream *stream = (janus_streaming_rtp_source_stream *)temp->data;
+		ok = ok && janus_streaming_relay_shard_addfd(shard, mp, stream->fd[0]);
+		ok = ok && janus_streaming_relay_shard_addfd(shard, mp, stream->fd[1]);
+		ok = ok && janus_streaming_relay_shard_addfd(shard, mp, stream->fd[2]);
+		ok = ok && janus_streaming_relay_shard_addfd(shard, mp, stream->rtcp_fd);
+		temp = temp->next;
+	}
+	ok = ok && janus_streaming_relay_shard_addfd(shard, mp, source->pipefd[0]);
+	if(!ok) {
+		/* We couldn't register some descriptor: undo everything, the
+		 * mountpoint will get a dedicated relay thread instead */
+		GSList *l = mp->relay_fds;
+		while(l) {
+			janus_streaming_relay_fd *rfd = (janus_streaming_relay_fd *)l->data;
+			epoll_ctl(shard->epollfd, EPOLL_CTL_DEL, rfd->fd, NULL);
+			g_free(rfd);
+			l = l->next;
+		}
+		g_slist_free(mp->relay_fds);
+		mp->relay_fds = NULL;
+		mp->relay_shard = NULL;
+		janus_refcount_decrease(&mp->ref);
+		return FALSE;
+	}
+	janus_mutex_lock(&shard->mutex);
+	shard->mountpoints = g_list_append(shard->mountpoints, mp);
+	janus_mutex_unlock(&shard->mutex);
+	JANUS_LOG(LOG_VERB, "[%s] Mountpoint registered on relay shard #%d\n", mp->name, shard->id);
+	return TRUE;
+}
+
+/* Deregister a mountpoint from its shard (only invoked by the shard thread) */
+static void janus_streaming_relay_unregister(janus_streaming_mountpoint *mp) {
+	janus_streaming_relay_shard *shard = (janus_streaming_relay_shard *)mp->relay_shard;
+	if(shard == NULL)
+		return;
+	GSList *l = mp->relay_fds;
+	while(l) {
+		janus_streaming_relay_fd *rfd = (janus_streaming_relay_fd *)l->data;
+		epoll_ctl(shard->epollfd, EPOLL_CTL_DEL, rfd->fd, NULL);
+		g_free(rfd);
+		l = l->next;
+	}
+	g_slist_free(mp->relay_fds);
+	mp->relay_fds = NULL;
+	mp->relay_shard = NULL;
+	janus_mutex_lock(&shard->mutex);
+	shard->mountpoints = g_list_remove(shard->mountpoints, mp);
+	janus_mutex_unlock(&shard->mutex);
+	/* Notify the viewers this mountpoint is done */
+	janus_streaming_relay_leave(mp);
+	JANUS_LOG(LOG_VERB, "[%s] Mountpoint deregistered from relay shard #%d\n", mp->name, shard->id);
+	janus_refcount_decrease(&mp->ref);
+}
+
+static void *janus_streaming_relay_shard_thread(void *data) {
+	janus_streaming_relay_shard *shard = (janus_streaming_relay_shard *)data;
+	JANUS_LOG(LOG_VERB, "Starting shared relay engine thread (shard #%d)\n", shard->id);
+	struct epoll_event events[JANUS_STREAMING_EPOLL_EVENTS];
+	int resfd = 0, bytes = 0, i = 0;
+	gint64 checks = 0;
+	while(!g_atomic_int_get(&stopping)) {
+		resfd = epoll_wait(shard->epollfd, events, JANUS_STREAMING_EPOLL_EVENTS, 1000);
+		if(resfd < 0) {
+			if(errno == EINTR) {
+				JANUS_LOG(LOG_HUGE, "Got an EINTR (%s) on relay shard #%d, ignoring...\n",
+					g_strerror(errno), shard->id);
+				continue;
+			}
+			JANUS_LOG(LOG_ERR, "Error on epoll_wait for relay shard #%d... %d (%s)\n",
+				shard->id, errno, g_strerror(errno));
+			break;
+		}
+		/* Process the events, deferring deregistrations until we've gone
+		 * through the whole batch, as other events in it may refer to the
+		 * same mountpoint and its file descriptors */
+		GSList *leaving = NULL;
+		for(i=0; i<resfd; i++) {
+			janus_streaming_relay_fd *rfd = (janus_streaming_relay_fd *)events[i].data.ptr;
+			janus_streaming_mountpoint *mp = rfd->mp;
+			janus_streaming_rtp_source *source = mp->source;
+			if(g_slist_find(leaving, mp) != NULL)
+				continue;
+			if(events[i].events & (EPOLLERR | EPOLLHUP)) {
+				/* Socket error? */
+				JANUS_LOG(LOG_ERR, "[%s] Error polling: %s... %d (%s)\n", mp->name,
+					events[i].events & EPOLLERR ? "EPOLLERR" : "EPOLLHUP", errno, g_strerror(errno));
+				janus_streaming_relay_error(mp);
+				leaving = g_slist_prepend(leaving, mp);
+				continue;
+			}
+			if(rfd->fd == source->pipefd[0]) {
+				/* The mountpoint has been destroyed */
+				int code = 0;
+				bytes = read(rfd->fd, &code, sizeof(int));
+				(void)bytes;
+				JANUS_LOG(LOG_VERB, "[%s] Interrupting mountpoint\n", mp->name);
+				leaving = g_slist_prepend(leaving, mp);
+				continue;
+			}
+			if(g_atomic_int_get(&mp->destroyed)) {
+				leaving = g_slist_prepend(leaving, mp);
+				continue;
+			}
+			janus_streaming_relay_readable(mp, rfd->fd);
+		}
+		if(leaving != NULL) {
+			GSList *l = leaving;
+			while(l) {
+				janus_streaming_relay_unregister((janus_streaming_mountpoint *)l->data);
+				l = l->next;
+			}
+			g_slist_free(leaving);
+		}
+		/* A few times per second, check if we owe PLI or REMB feedback to a source */
+		gint64 now = janus_get_monotonic_time();
+		if(now - checks >= G_USEC_PER_SEC/5) {
+			checks = now;
+			janus_mutex_lock(&shard->mutex);
+			GList *m = shard->mountpoints;
+			while(m) {
+				janus_streaming_mountpoint *mp = (janus_streaming_mountpoint *)m->data;
+				if(!g_atomic_int_get(&mp->destroyed))
+					janus_streaming_relay_rtcp_checks(mp->source);
+				m = m->next;
+			}
+			janus_mutex_unlock(&shard->mutex);
+		}
+	}
+	/* We're done: deregister any mountpoint we were still serving */
+	janus_mutex_lock(&shard->mutex);
+	while(shard->mountpoints != NULL) {
+		janus_streaming_mountpoint *mp = (janus_streaming_mountpoint *)shard->mountpoints->data;
+		janus_mutex_unlock(&shard->mutex);
+		janus_streaming_relay_unregister(mp);
+		janus_mutex_lock(&shard->mutex);
+	}
+	janus_mutex_unlock(&shard->mutex);
+	JANUS_LOG(LOG_VERB, "Leaving shared relay engine thread (shard #%d)\n", shard->id);
+	return NULL;
+}
+#else
+static gboolean janus_streaming_relay_register(janus_streaming_mountpoint *mp) {
+	/* No epoll(), mountpoints keep using dedicated relay threads */
+	return FALSE;
+}
+#endif
+
+static void *janus_streaming_relay_thread(void *data) {
+	JANUS_LOG(LOG_VERB, "Starting streaming relay thread\n");
+	janus_streaming_mountpoint *mountpoint = (janus_streaming_mountpoint *)data;
+	if(!mountpoint) {
+		JANUS_LOG(LOG_ERR, "Invalid mountpoint!\n");
+		return NULL;
+	}
+	if(mountpoint->streaming_source != janus_streaming_source_rtp) {
+		JANUS_LOG(LOG_ERR, "[%s] Not an RTP source mountpoint!\n", mountpoint->name);
+		janus_refcount_decrease(&mountpoint->ref);
+		return NULL;
+	}
+	janus_streaming_rtp_source *source = mountpoint->source;
+	if(source == NULL) {
+		JANUS_LOG(LOG_ERR, "[%s] Invalid RTP source mountpoint!\n", mountpoint->name);
+		janus_refcount_decrease(&mountpoint->ref);
+		return NULL;
+	}
+
+	/* Check how many file descriptors we'll need to monitor */
+	int num = 0;
+	GList *temp = source->media;
+	while(temp) {
+		janus_streaming_rtp_source_stream *stream = (janus_streaming_rtp_source_stream *)temp->data;
+		if(stream->fd[0] != -1)
+			num++;
+		if(stream->fd[1] != -1)
+			num++;
+		if(stream->fd[2] != -1)
+			num++;
+		if(stream->rtcp_fd != -1)
+			num++;
+		temp = temp->next;
+	}
+	num++;	/* There's the pipe too */
+
+	/* Add a reference to the helper threads, if needed */
+	if(mountpoint->helper_threads > 0) {
+		GList *l = mountpoint->threads;
+		while(l) {
+			janus_streaming_helper *ht = (janus_streaming_helper *)l->data;
+			janus_refcount_increase(&ht->ref);
+			l = l->next;
+		}
+	}
+
+	char *name = g_strdup(mountpoint->name ? mountpoint->name : "??");
+	/* File descriptors */
+	int resfd = 0;
+	struct pollfd *fds = g_malloc(num * sizeof(struct pollfd));
+	/* We'll have a dynamic number of streams */
+#ifdef HAVE_LIBCURL
+	/* In case this is an RTSP restreamer, we may have to send keep-alive from time to time */
+	gint64 now = janus_get_monotonic_time(), before = now, ka_timeout = 0;
 	if(source->rtsp) {
 		source->reconnect_timer = now;
 		ka_timeout = source->ka_timeout;
@@ -9373,7 +10821,6 @@ static void *janus_streaming_relay_thread(void *data) {
 	gboolean connected = TRUE;
 #endif
 	/* Loop */
-	janus_streaming_rtp_relay_packet packet;
 	while(!g_atomic_int_get(&stopping) && !g_atomic_int_get(&mountpoint->destroyed)) {
 #ifdef HAVE_LIBCURL
 		/* Let's check regularly if the RTSP server seems to be gone */
@@ -9384,7 +10831,7 @@ static void *janus_streaming_relay_thread(void *data) {
 				continue;
 			}
 			now = janus_get_monotonic_time();
-			if(!source->reconnecting && (now - source->reconnect_timer > source->reconnect_delay)) {
+			if(!source->reconnecting && (now - source->reconnect_timer > source->reconnect_wait)) {
 				/*  Assume the RTSP server has gone and schedule a reconnect */
 				JANUS_LOG(LOG_WARN, "[%s] %"SCNi64"s passed with no media, trying to reconnect the RTSP stream\n",
 					name, (now - source->reconnect_timer)/G_USEC_PER_SEC);
@@ -9415,6 +10862,7 @@ static void *janus_streaming_relay_thread(void *data) {
 				}
 				source->reconnect_timer = now;
 				connected = FALSE;
+				source->rtsp_connected = FALSE;
 				source->reconnecting = TRUE;
 				/* Let's clean up the source first */
 				curl_easy_cleanup(source->curl);
@@ -9430,19 +10878,33 @@ static void *janus_streaming_relay_thread(void *data) {
 				/* Now let's try to reconnect */
 				if(janus_streaming_rtsp_connect_to_server(mountpoint) < 0) {
 					/* Reconnection failed? Let's try again later */
-					JANUS_LOG(LOG_WARN, "[%s] Reconnection of the RTSP stream failed, trying again in a few seconds...\n", name);
+					JANUS_LOG(LOG_WARN, "[%s] Reconnection of the RTSP stream failed, trying again in %"SCNi64"s...\n",
+						name, source->reconnect_wait/G_USEC_PER_SEC);
 				} else {
 					/* We're connected, let's send a PLAY */
 					if(janus_streaming_rtsp_play(source) < 0) {
 						/* Error trying to play? Let's try again later */
-						JANUS_LOG(LOG_WARN, "[%s] RTSP PLAY failed, trying again in a few seconds...\n", name);
+						JANUS_LOG(LOG_WARN, "[%s] RTSP PLAY failed, trying again in %"SCNi64"s...\n",
+							name, source->reconnect_wait/G_USEC_PER_SEC);
 					} else {
 						/* Everything should be back to normal */
 						JANUS_LOG(LOG_INFO, "[%s] Reconnected to the RTSP server, streaming again\n", name);
 						ka_timeout = source->ka_timeout;
 						connected = TRUE;
+						source->rtsp_connected = TRUE;
 					}
 				}
+				if(connected) {
+					/* Reset the backoff, the next outage will start from the configured delay */
+					source->reconnect_wait = source->reconnect_delay;
+				} else {
+					/* Exponential backoff: if the server keeps on being unreachable,
+					 * wait a bit more between attempts (up to a minute), so that a
+					 * prolonged outage doesn't keep us busy with doomed connects */
+					source->reconnect_wait = source->reconnect_wait*2;
+					if(source->reconnect_wait > 60*G_USEC_PER_SEC)
+						source->reconnect_wait = 60*G_USEC_PER_SEC;
+				}
 				source->reconnect_timer = janus_get_monotonic_time();
 				source->reconnecting = FALSE;
 				continue;
@@ -9505,20 +10967,10 @@ static void *janus_streaming_relay_thread(void *data) {
 				fds[num].revents = 0;
 				num++;
 			}
-			/* Any PLI and/or REMB we should send back to the source? */
-			if(stream->type == JANUS_STREAMING_MEDIA_VIDEO) {
-				if(g_atomic_int_get(&stream->need_pli))
-					janus_streaming_rtcp_pli_send(stream);
-				if(stream->rtcp_fd > -1 && source->lowest_bitrate > 0) {
-					gint64 now = janus_get_monotonic_time();
-					if(source->remb_latest == 0)
-						source->remb_latest = now;
-					else if(now - source->remb_latest >= G_USEC_PER_SEC)
-						janus_streaming_rtcp_remb_send(source, stream);
-				}
-			}
 			temp = temp->next;
 		}
+		/* Any PLI and/or REMB we should send back to the source? */
+		janus_streaming_relay_rtcp_checks(source);
 		if(source->pipefd[0] != -1) {
 			fds[num].fd = source->pipefd[0];
 			fds[num].events = POLLIN;
@@ -9533,20 +10985,7 @@ static void *janus_streaming_relay_thread(void *data) {
 				continue;
 			}
 			JANUS_LOG(LOG_ERR, "[%s] Error polling... %d (%s)\n", name, errno, g_strerror(errno));
-			mountpoint->enabled = FALSE;
-			janus_mutex_lock(&source->rec_mutex);
-			GList *temp = source->media;
-			while(temp) {
-				janus_streaming_rtp_source_stream *stream = (janus_streaming_rtp_source_stream *)temp->data;
-				janus_recorder_close(stream->rc);
-				JANUS_LOG(LOG_INFO, "[%s] Closed %s recording %s (%s)\n", mountpoint->name,
-					janus_streaming_media_str(stream->type), stream->rc->filename, stream->mid);
-				janus_recorder *tmp = stream->rc;
-				stream->rc = NULL;
-				janus_recorder_destroy(tmp);
-				break;
-			}
-			janus_mutex_unlock(&source->rec_mutex);
+			janus_streaming_relay_error(mountpoint);
 			break;
 		} else if(resfd == 0) {
 			/* No data, keep going */
@@ -9558,506 +10997,22 @@ static void *janus_streaming_relay_thread(void *data) {
 				/* Socket error? */
 				JANUS_LOG(LOG_ERR, "[%s] Error polling: %s... %d (%s)\n", name,
 					fds[i].revents & POLLERR ? "POLLERR" : "POLLHUP", errno, g_strerror(errno));
-				mountpoint->enabled = FALSE;
-				janus_mutex_lock(&source->rec_mutex);
-				GList *temp = source->media;
-				while(temp) {
-					janus_streaming_rtp_source_stream *stream = (janus_streaming_rtp_source_stream *)temp->data;
-					janus_recorder_close(stream->rc);
-					JANUS_LOG(LOG_INFO, "[%s] Closed %s recording %s (%s)\n", mountpoint->name,
-						janus_streaming_media_str(stream->type), stream->rc->filename, stream->mid);
-					janus_recorder *tmp = stream->rc;
-					stream->rc = NULL;
-					janus_recorder_destroy(tmp);
-					break;
-				}
-				janus_mutex_unlock(&source->rec_mutex);
+				janus_streaming_relay_error(mountpoint);
 				break;
 			} else if(fds[i].revents & POLLIN) {
-				/* Got an RTP or data packet */
-				if(fds[i].fd == source->pipefd[0]) {
+				/* Got an RTP or data packet to handle, or an interrupt */
+				if(!janus_streaming_relay_readable(mountpoint, fds[i].fd)) {
 					/* We're done here */
-					int code = 0;
-					bytes = read(fds[i].fd, &code, sizeof(int));
-					JANUS_LOG(LOG_VERB, "[%s] Interrupting mountpoint\n", mountpoint->name);
 					break;
-				} else {
-					/* Check which stream this file descriptor belongs to */
-					stream = g_hash_table_lookup(source->media_byfd, GINT_TO_POINTER(fds[i].fd));
-				}
-				if(stream == NULL) {
-					/* No stream..? Shouldn't happen, read the bytes and dump them */
-					addrlen = sizeof(remote);
-					(void)recvfrom(fds[i].fd, buffer, 1500, 0, (struct sockaddr *)&remote, &addrlen);
-					continue;
-				}
-				if(stream->type == JANUS_STREAMING_MEDIA_AUDIO && fds[i].fd == stream->fd[0]) {
-					/* Got something audio (RTP) */
-					if(mountpoint->active == FALSE)
-						mountpoint->active = TRUE;
-					gint64 now = janus_get_monotonic_time();
-#ifdef HAVE_LIBCURL
-					source->reconnect_timer = now;
-#endif
-					addrlen = sizeof(remote);
-					bytes = recvfrom(fds[i].fd, buffer, 1500, 0, (struct sockaddr *)&remote, &addrlen);
-					if(bytes < 0 || !janus_is_rtp(buffer, bytes)) {
-						/* Failed to read or not an RTP packet? */
-						continue;
-					}
-					janus_rtp_header *rtp = (janus_rtp_header *)buffer;
-					ssrc = ntohl(rtp->ssrc);
-					if(source->rtp_collision > 0 && stream->last_ssrc[0] && ssrc != stream->last_ssrc[0] &&
-							(now-stream->last_received[0]) < (gint64)1000*source->rtp_collision) {
-						JANUS_LOG(LOG_WARN, "[%s] RTP collision on audio mountpoint, dropping packet (#%d, ssrc=%"SCNu32")\n",
-							name, stream->mindex, ssrc);
-						continue;
-					}
-					stream->last_received[0] = now;
-					/* Do we have a new stream? */
-					if(ssrc != stream->last_ssrc[0]) {
-						stream->ssrc = stream->last_ssrc[0] = ssrc;
-						JANUS_LOG(LOG_INFO, "[%s] New audio stream! (#%d, ssrc=%"SCNu32")\n", name, stream->mindex, ssrc);
-					}
-					/* If paused, ignore this packet */
-					if(!mountpoint->enabled && !stream->rc)
-						continue;
-					/* Is this SRTP? */
-					if(source->is_srtp) {
-						int buflen = bytes;
-						srtp_err_status_t res = srtp_unprotect(source->srtp_ctx, buffer, &buflen);
-						if(res != srtp_err_status_ok) {
-							guint32 timestamp = ntohl(rtp->timestamp);
-							guint16 seq = ntohs(rtp->seq_number);
-							JANUS_LOG(LOG_ERR, "[%s] Audio (#%d) SRTP unprotect error: %s (len=%d-->%d, ts=%"SCNu32", seq=%"SCNu16")\n",
-								name, stream->mindex, janus_srtp_error_str(res), bytes, buflen, timestamp, seq);
-							continue;
-						}
-						bytes = buflen;
-					}
-					/* Relay on all sessions */
-					packet.mindex = stream->mindex;
-					packet.data = rtp;
-					packet.length = bytes;
-					packet.is_rtp = TRUE;
-					packet.is_video = FALSE;
-					packet.is_keyframe = FALSE;
-					packet.data->type = stream->codecs.pt;
-					/* Is there a recorder? */
-					janus_rtp_header_update(packet.data, &stream->context[0], FALSE, 0);
-					if(stream->skew) {
-						int ret = janus_rtp_skew_compensate_audio(packet.data, &stream->context[0], now);
-						if(ret < 0) {
-							JANUS_LOG(LOG_WARN, "[%s] Dropping %d packets, audio source clock is too fast (#%d, ssrc=%"SCNu32")\n",
-								name, -ret, stream->mindex, ssrc);
-							continue;
-						} else if(ret > 0) {
-							JANUS_LOG(LOG_WARN, "[%s] Jumping %d RTP sequence numbers, audio source clock is too slow (#%d, ssrc=%"SCNu32")\n",
-								name, ret, stream->mindex, ssrc);
-						}
-					}
-					if(stream->rc) {
-						packet.data->ssrc = htonl((uint32_t)mountpoint->id);
-						janus_recorder_save_frame(stream->rc, buffer, bytes);
-					}
-					if(mountpoint->enabled) {
-						packet.data->ssrc = htonl(ssrc);
-						/* Backup the actual payload type, timestamp and sequence number set by the restreamer, in case switching is involved */
-						packet.ptype = packet.data->type;
-						packet.timestamp = ntohl(packet.data->timestamp);
-						packet.seq_number = ntohs(packet.data->seq_number);
-						/* Go! */
-						janus_mutex_lock(&mountpoint->mutex);
-						g_list_foreach(mountpoint->helper_threads == 0 ? mountpoint->viewers : mountpoint->threads,
-							mountpoint->helper_threads == 0 ? janus_streaming_relay_rtp_packet : janus_streaming_helper_rtprtcp_packet,
-							&packet);
-						janus_mutex_unlock(&mountpoint->mutex);
-					}
-					continue;
-				} else if(stream->type == JANUS_STREAMING_MEDIA_VIDEO && ((fds[i].fd == stream->fd[0]) ||
-						(fds[i].fd == stream->fd[1]) || (fds[i].fd == stream->fd[2]))) {
-					/* Got something video (RTP) */
-					int index = -1;
-					if(fds[i].fd == stream->fd[0])
-						index = 0;
-					else if(fds[i].fd == stream->fd[1])
-						index = 1;
-					else if(fds[i].fd == stream->fd[2])
-						index = 2;
-					if(mountpoint->active == FALSE)
-						mountpoint->active = TRUE;
-					gint64 now = janus_get_monotonic_time();
-#ifdef HAVE_LIBCURL
-					source->reconnect_timer = now;
-#endif
-					addrlen = sizeof(remote);
-					bytes = recvfrom(fds[i].fd, buffer, 1500, 0, (struct sockaddr *)&remote, &addrlen);
-					if(bytes < 0 || !janus_is_rtp(buffer, bytes)) {
-						/* Failed to read or not an RTP packet? */
-						continue;
-					}
-					janus_rtp_header *rtp = (janus_rtp_header *)buffer;
-					ssrc = ntohl(rtp->ssrc);
-					if(source->rtp_collision > 0 && stream->last_ssrc[index] && ssrc != stream->last_ssrc[index] &&
-							(now-stream->last_received[index]) < (gint64)1000*source->rtp_collision) {
-						JANUS_LOG(LOG_WARN, "[%s] RTP collision on video mountpoint, dropping packet (#%d, ssrc=%"SCNu32")\n",
-							name, stream->mindex, ssrc);
-						continue;
-					}
-					stream->last_received[index] = now;
-					/* Do we have a new stream? */
-					if(ssrc != stream->last_ssrc[index]) {
-						stream->last_ssrc[index] = ssrc;
-						if(index == 0)
-							stream->ssrc = ssrc;
-						JANUS_LOG(LOG_INFO, "[%s] New video stream! (#%d, ssrc=%"SCNu32", index %d)\n",
-							name, stream->mindex, ssrc, index);
-					}
-					/* Is this SRTP? */
-					if(source->is_srtp) {
-						int buflen = bytes;
-						srtp_err_status_t res = srtp_unprotect(source->srtp_ctx, buffer, &buflen);
-						if(res != srtp_err_status_ok) {
-							guint32 timestamp = ntohl(rtp->timestamp);
-							guint16 seq = ntohs(rtp->seq_number);
-							JANUS_LOG(LOG_ERR, "[%s] Video (#%d) SRTP unprotect error: %s (len=%d-->%d, ts=%"SCNu32", seq=%"SCNu16")\n",
-								name, stream->mindex, janus_srtp_error_str(res), bytes, buflen, timestamp, seq);
-							continue;
-						}
-						bytes = buflen;
-					}
-					/* First of all, let's check if this is (part of) a keyframe that we may need to save it for future reference */
-					if(index == 0 && stream->keyframe.enabled) {
-						if(stream->keyframe.temp_ts > 0 && ntohl(rtp->timestamp) != stream->keyframe.temp_ts) {
-							/* We received the last part of the keyframe, get rid of the old one and use this from now on */
-							JANUS_LOG(LOG_HUGE, "[%s] ... ... last part of keyframe received! ts=%"SCNu32", %d packets\n",
-								name, stream->keyframe.temp_ts, g_list_length(stream->keyframe.temp_keyframe));
-							stream->keyframe.temp_ts = 0;
-							janus_mutex_lock(&stream->keyframe.mutex);
-							if(stream->keyframe.latest_keyframe != NULL)
-								g_list_free_full(stream->keyframe.latest_keyframe, (GDestroyNotify)janus_streaming_rtp_relay_packet_free);
-							stream->keyframe.latest_keyframe = stream->keyframe.temp_keyframe;
-							stream->keyframe.temp_keyframe = NULL;
-							janus_mutex_unlock(&stream->keyframe.mutex);
-						} else if(ntohl(rtp->timestamp) == stream->keyframe.temp_ts) {
-							/* Part of the keyframe we're currently saving, store */
-							janus_mutex_lock(&stream->keyframe.mutex);
-							JANUS_LOG(LOG_HUGE, "[%s] ... other part of keyframe received! ts=%"SCNu32"\n", name, stream->keyframe.temp_ts);
-							janus_streaming_rtp_relay_packet *pkt = g_malloc0(sizeof(janus_streaming_rtp_relay_packet));
-							pkt->mindex = stream->mindex;
-							pkt->data = g_malloc(bytes);
-							memcpy(pkt->data, buffer, bytes);
-							pkt->data->ssrc = htons(1);
-							pkt->data->type = stream->codecs.pt;
-							pkt->is_rtp = TRUE;
-							pkt->is_video = TRUE;
-							pkt->is_keyframe = TRUE;
-							pkt->length = bytes;
-							pkt->ptype = rtp->type;
-							pkt->timestamp = stream->keyframe.temp_ts;
-							pkt->seq_number = ntohs(rtp->seq_number);
-							stream->keyframe.temp_keyframe = g_list_append(stream->keyframe.temp_keyframe, pkt);
-							janus_mutex_unlock(&stream->keyframe.mutex);
-						} else {
-							gboolean kf = FALSE;
-							/* Parse RTP header first */
-							janus_rtp_header *header = (janus_rtp_header *)buffer;
-							guint32 timestamp = ntohl(header->timestamp);
-							guint16 seq = ntohs(header->seq_number);
-							JANUS_LOG(LOG_HUGE, "Checking if packet (size=%d, seq=%"SCNu16", ts=%"SCNu32") is a key frame...\n",
-								bytes, seq, timestamp);
-							int plen = 0;
-							char *payload = janus_rtp_payload(buffer, bytes, &plen);
-							if(payload) {
-								switch(stream->codecs.video_codec) {
-									case JANUS_VIDEOCODEC_VP8:
-										kf = janus_vp8_is_keyframe(payload, plen);
-										break;
-									case JANUS_VIDEOCODEC_VP9:
-										kf = janus_vp9_is_keyframe(payload, plen);
-										break;
-									case JANUS_VIDEOCODEC_H264:
-										kf = janus_h264_is_keyframe(payload, plen);
-										break;
-									case JANUS_VIDEOCODEC_AV1:
-										kf = janus_av1_is_keyframe(payload, plen);
-										break;
-									case JANUS_VIDEOCODEC_H265:
-										kf = janus_h265_is_keyframe(payload, plen);
-										break;
-									default:
-										break;
-								}
-								if(kf) {
-									/* New keyframe, start saving it */
-									stream->keyframe.temp_ts = ntohl(rtp->timestamp);
-									JANUS_LOG(LOG_HUGE, "[%s] New keyframe received! ts=%"SCNu32"\n", name, stream->keyframe.temp_ts);
-									janus_mutex_lock(&stream->keyframe.mutex);
-									janus_streaming_rtp_relay_packet *pkt = g_malloc0(sizeof(janus_streaming_rtp_relay_packet));
-									pkt->mindex = stream->mindex;
-									pkt->data = g_malloc(bytes);
-									memcpy(pkt->data, buffer, bytes);
-									pkt->data->ssrc = htons(1);
-									pkt->data->type = stream->codecs.pt;
-									pkt->is_rtp = TRUE;
-									pkt->is_video = TRUE;
-									pkt->is_keyframe = TRUE;
-									pkt->length = bytes;
-									pkt->ptype = rtp->type;
-									pkt->timestamp = stream->keyframe.temp_ts;
-									pkt->seq_number = ntohs(rtp->seq_number);
-									stream->keyframe.temp_keyframe = g_list_append(stream->keyframe.temp_keyframe, pkt);
-									janus_mutex_unlock(&stream->keyframe.mutex);
-								}
-							}
-						}
-					}
-					/* If paused, ignore this packet */
-					if(!mountpoint->enabled && !stream->rc)
-						continue;
-					/* Relay on all sessions */
-					packet.mindex = stream->mindex;
-					packet.data = rtp;
-					packet.length = bytes;
-					packet.is_rtp = TRUE;
-					packet.is_video = TRUE;
-					packet.is_keyframe = FALSE;
-					packet.simulcast = stream->simulcast;
-					packet.substream = index;
-					packet.codec = stream->codecs.video_codec;
-					packet.svc = FALSE;
-					if(stream->svc) {
-						/* We're doing SVC: let's parse this packet to see which layers are there */
-						int plen = 0;
-						char *payload = janus_rtp_payload(buffer, bytes, &plen);
-						if(payload) {
-							gboolean found = FALSE;
-							memset(&packet.svc_info, 0, sizeof(packet.svc_info));
-							if(janus_vp9_parse_svc(payload, plen, &found, &packet.svc_info) == 0) {
-								packet.svc = found;
-							}
-						}
-					}
-					packet.data->type = stream->codecs.pt;
-					/* Is there a recorder? (FIXME notice we only record the first substream, if simulcasting) */
-					janus_rtp_header_update(packet.data, &stream->context[index], TRUE, 0);
-					if(stream->skew) {
-						int ret = janus_rtp_skew_compensate_video(packet.data, &stream->context[index], now);
-						if(ret < 0) {
-							JANUS_LOG(LOG_WARN, "[%s] Dropping %d packets, video source clock is too fast (#%d, ssrc=%"SCNu32", index %d)\n",
-								name, -ret, stream->mindex, ssrc, index);
-							continue;
-						} else if(ret > 0) {
-							JANUS_LOG(LOG_WARN, "[%s] Jumping %d RTP sequence numbers, video source clock is too slow (#%d, ssrc=%"SCNu32", index %d)\n",
-								name, ret, stream->mindex, ssrc, index);
-						}
-					}
-					if(stream->h264_spspps) {
-						int plen = 0;
-						char *payload = janus_rtp_payload((char *)packet.data, bytes, &plen);
-						/* We have our own SPS/PPS to send, check if we just received a keyframe */
-						if(payload && janus_h264_is_i_frame(payload, plen)) {
-							/* This is an I-frame: prepend an SPS/PPS packet */
-							janus_rtp_header *sps_rtp = (janus_rtp_header *)stream->h264_spspps;
-							sps_rtp->type = rtp->type;
-							sps_rtp->seq_number = rtp->seq_number;
-							rtp->seq_number = htons(ntohs(rtp->seq_number) + 1);
-							stream->context[index].base_seq--;
-							sps_rtp->timestamp = rtp->timestamp;
-							/* Save the packet, if needed */
-							sps_rtp->ssrc = htonl((uint32_t)mountpoint->id);
-							janus_recorder_save_frame(stream->rc, stream->h264_spspps, stream->h264_spspps_len);
-							sps_rtp->ssrc = rtp->ssrc;
-							/* Relay on all sessions */
-							janus_streaming_rtp_relay_packet spspkt = { 0 };
-							spspkt.mindex = stream->mindex;
-							spspkt.data = sps_rtp;
-							spspkt.length = stream->h264_spspps_len;
-							spspkt.is_rtp = TRUE;
-							spspkt.is_video = TRUE;
-							spspkt.is_keyframe = FALSE;
-							spspkt.simulcast = FALSE;
-							spspkt.codec = stream->codecs.video_codec;
-							spspkt.svc = FALSE;
-							spspkt.ptype = spspkt.data->type;
-							spspkt.timestamp = ntohl(spspkt.data->timestamp);
-							spspkt.seq_number = ntohs(spspkt.data->seq_number);
-							janus_mutex_lock(&mountpoint->mutex);
-							JANUS_LOG(LOG_HUGE, "[%s] Sending SPS/PPS (seq=%"SCNu16", ts=%"SCNu32")\n", name,
-								ntohs(spspkt.data->seq_number), ntohl(spspkt.data->timestamp));
-							g_list_foreach(mountpoint->helper_threads == 0 ? mountpoint->viewers : mountpoint->threads,
-								mountpoint->helper_threads == 0 ? janus_streaming_relay_rtp_packet : janus_streaming_helper_rtprtcp_packet,
-								&spspkt);
-							janus_mutex_unlock(&mountpoint->mutex);
-						}
-					}
-					if(index == 0 && stream->rc) {
-						packet.data->ssrc = htonl((uint32_t)mountpoint->id);
-						janus_recorder_save_frame(stream->rc, buffer, bytes);
-					}
-					if(mountpoint->enabled) {
-						packet.data->ssrc = htonl(ssrc);
-						/* Backup the actual payload type, timestamp and sequence number set by the restreamer, in case switching is involved */
-						packet.ptype = packet.data->type;
-						packet.timestamp = ntohl(packet.data->timestamp);
-						packet.seq_number = ntohs(packet.data->seq_number);
-						/* Take note of the simulcast SSRCs */
-						if(stream->simulcast) {
-							packet.ssrc[0] = stream->last_ssrc[0];
-							packet.ssrc[1] = stream->last_ssrc[1];
-							packet.ssrc[2] = stream->last_ssrc[2];
-						}
-						/* Go! */
-						janus_mutex_lock(&mountpoint->mutex);
-						g_list_foreach(mountpoint->helper_threads == 0 ? mountpoint->viewers : mountpoint->threads,
-							mountpoint->helper_threads == 0 ? janus_streaming_relay_rtp_packet : janus_streaming_helper_rtprtcp_packet,
-							&packet);
-						janus_mutex_unlock(&mountpoint->mutex);
-					}
-					continue;
-				} else if(stream->type == JANUS_STREAMING_MEDIA_DATA && fds[i].fd == stream->fd[0]) {
-					/* Got something data (text) */
-					if(mountpoint->active == FALSE)
-						mountpoint->active = TRUE;
-					stream->last_received[0] = janus_get_monotonic_time();
-#ifdef HAVE_LIBCURL
-					source->reconnect_timer = janus_get_monotonic_time();
-#endif
-					addrlen = sizeof(remote);
-					bytes = recvfrom(fds[i].fd, buffer, 1500, 0, (struct sockaddr *)&remote, &addrlen);
-					if(bytes < 1) {
-						/* Failed to read? */
-						continue;
-					}
-					if(!mountpoint->enabled && !stream->rc)
-						continue;
-					/* Copy the data */
-					char *data = g_malloc(bytes);
-					memcpy(data, buffer, bytes);
-					/* Relay on all sessions */
-					packet.mindex = stream->mindex;
-					packet.data = (janus_rtp_header *)data;
-					packet.length = bytes;
-					packet.is_rtp = FALSE;
-					packet.is_data = TRUE;
-					packet.textdata = stream->textdata;
-					/* Is there a recorder? */
-					janus_recorder_save_frame(stream->rc, data, bytes);
-					if(mountpoint->enabled) {
-						/* Are we keeping track of the last message being relayed? */
-						if(stream->buffermsg) {
-							janus_mutex_lock(&stream->buffermsg_mutex);
-							janus_streaming_rtp_relay_packet *pkt = g_malloc0(sizeof(janus_streaming_rtp_relay_packet));
-							pkt->data = g_malloc(bytes);
-							memcpy(pkt->data, data, bytes);
-							packet.mindex = stream->mindex;
-							packet.is_rtp = FALSE;
-							packet.is_data = TRUE;
-							packet.textdata = stream->textdata;
-							pkt->length = bytes;
-							janus_mutex_unlock(&stream->buffermsg_mutex);
-						}
-						/* Go! */
-						janus_mutex_lock(&mountpoint->mutex);
-						g_list_foreach(mountpoint->helper_threads == 0 ? mountpoint->viewers : mountpoint->threads,
-							mountpoint->helper_threads == 0 ? janus_streaming_relay_rtp_packet : janus_streaming_helper_rtprtcp_packet,
-							&packet);
-						janus_mutex_unlock(&mountpoint->mutex);
-					}
-					g_free(packet.data);
-					packet.data = NULL;
-					continue;
-				} else if(fds[i].fd == stream->rtcp_fd) {
-					addrlen = sizeof(remote);
-					bytes = recvfrom(fds[i].fd, buffer, 1500, 0, (struct sockaddr *)&remote, &addrlen);
-					if(bytes < 0 || (!janus_is_rtp(buffer, bytes) && !janus_is_rtcp(buffer, bytes))) {
-						/* For latching we need an RTP or RTCP packet */
-						continue;
-					}
-					if(!mountpoint->enabled)
-						continue;
-					memcpy(&stream->rtcp_addr, &remote, addrlen);
-					if(!janus_is_rtcp(buffer, bytes)) {
-						/* Failed to read or not an RTCP packet? */
-						continue;
-					}
-					JANUS_LOG(LOG_HUGE, "[%s] Got audio/video RTCP feedback: #%d, SSRC %"SCNu32"\n",
-						name, stream->mindex, janus_rtcp_get_sender_ssrc(buffer, bytes));
-					/* Relay on all sessions */
-					packet.mindex = stream->mindex;
-					packet.is_rtp = FALSE;
-					packet.is_video = (stream->type == JANUS_STREAMING_MEDIA_VIDEO);
-					packet.data = (janus_rtp_header *)buffer;
-					packet.length = bytes;
-					/* Go! */
-					janus_mutex_lock(&mountpoint->mutex);
-					g_list_foreach(mountpoint->helper_threads == 0 ? mountpoint->viewers : mountpoint->threads,
-						mountpoint->helper_threads == 0 ? janus_streaming_relay_rtcp_packet : janus_streaming_helper_rtprtcp_packet,
-						&packet);
-					janus_mutex_unlock(&mountpoint->mutex);
 				}
 			}
 		}
 	}
 
-	/* Close the ports we bound to */
-	temp = source->media;
-	while(temp) {
-		janus_streaming_rtp_source_stream *stream = (janus_streaming_rtp_source_stream *)temp->data;
-		if(stream->fd[0] > -1)
-			close(stream->fd[0]);
-		stream->fd[0] = -1;
-		if(stream->fd[1] > -1)
-			close(stream->fd[1]);
-		stream->fd[1] = -1;
-		if(stream->fd[2] > -1)
-			close(stream->fd[2]);
-		stream->fd[2] = -1;
-		if(stream->rtcp_fd > -1)
-			close(stream->rtcp_fd);
-		stream->rtcp_fd = -1;
-		temp = temp->next;
-	}
 	g_free(fds);
 
-	/* Notify users this mountpoint is done */
-	janus_mutex_lock(&mountpoint->mutex);
-	GList *viewer = g_list_first(mountpoint->viewers);
-	/* Prepare JSON event */
-	json_t *event = json_object();
-	json_object_set_new(event, "streaming", json_string("event"));
-	json_t *result = json_object();
-	json_object_set_new(result, "status", json_string("stopped"));
-	json_object_set_new(event, "result", result);
-	while(viewer) {
-		janus_streaming_session *session = (janus_streaming_session *)viewer->data;
-		if(session == NULL) {
-			mountpoint->viewers = g_list_remove_all(mountpoint->viewers, session);
-			viewer = g_list_first(mountpoint->viewers);
-			continue;
-		}
-		janus_mutex_lock(&session->mutex);
-		if(session->mountpoint != mountpoint) {
-			mountpoint->viewers = g_list_remove_all(mountpoint->viewers, session);
-			viewer = g_list_first(mountpoint->viewers);
-			janus_mutex_unlock(&session->mutex);
-			continue;
-		}
-		g_atomic_int_set(&session->stopping, 1);
-		g_atomic_int_set(&session->started, 0);
-		g_atomic_int_set(&session->paused, 0);
-		session->mountpoint = NULL;
-		/* Tell the core to tear down the PeerConnection, hangup_media will do the rest */
-		gateway->push_event(session->handle, &janus_streaming_plugin, NULL, event, NULL);
-		gateway->close_pc(session->handle);
-		janus_refcount_decrease(&session->ref);
-		janus_refcount_decrease(&mountpoint->ref);
-		mountpoint->viewers = g_list_remove_all(mountpoint->viewers, session);
-		viewer = g_list_first(mountpoint->viewers);
-		janus_mutex_unlock(&session->mutex);
-	}
-	json_decref(event);
-	janus_mutex_unlock(&mountpoint->mutex);
+	/* Close the ports we bound to, and notify users this mountpoint is done */
+	janus_streaming_relay_leave(mountpoint);
 
 	/* Unref the helper threads */
 	if(mountpoint->helper_threads > 0) {
@@ -10478,11 +11433,14 @@ static void *janus_streaming_helper_thread(void *data) {
 		pkt = g_async_queue_pop(helper->queued_packets);
 		if(pkt == &exit_packet)
 			break;
-		janus_mutex_lock(&helper->mutex);
-		g_list_foreach(helper->viewers,
-			pkt->is_rtp || pkt->is_data ? janus_streaming_relay_rtp_packet : janus_streaming_relay_rtcp_packet,
-			pkt);
-		janus_mutex_unlock(&helper->mutex);
+		janus_streaming_viewers_snapshot *snapshot =
+			janus_streaming_viewers_snapshot_get(&helper->mutex, &helper->viewers_snapshot);
+		if(snapshot != NULL) {
+			g_list_foreach(snapshot->viewers,
+				pkt->is_rtp || pkt->is_data ? janus_streaming_relay_rtp_packet : janus_streaming_relay_rtcp_packet,
+				pkt);
+			janus_refcount_decrease(&snapshot->ref);
+		}
 		janus_streaming_rtp_relay_packet_free(pkt);
 	}
 	JANUS_LOG(LOG_INFO, "[%s/#%d] Leaving Streaming helper thread\n", mp->name, helper->id);
@@ -1598,6 +1598,10 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 			/* Everybody in the room */
 			JANUS_LOG(LOG_VERB, "To everybody in %s: %s\n", room_id_str, message);
 			if(textroom->participants) {
+				/* Share the serialized message across all recipients: the core
+				 * will reference the buffer, and only materialize a private
+				 * copy in each handle's send loop */
+				janus_plugin_buffer *shared = janus_plugin_buffer_new(msg_text, strlen(msg_text));
 				GHashTableIter iter;
 				gpointer value;
 				g_hash_table_iter_init(&iter, textroom->participants);
@@ -1605,10 +1609,14 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 					janus_textroom_participant *top = value;
 					JANUS_LOG(LOG_VERB, "  >> To %s in %s: %s\n", top->username, room_id_str, message);
 					janus_refcount_increase(&top->ref);
-					janus_plugin_data data = { .label = NULL, .protocol = NULL, .binary = FALSE, .buffer = msg_text, .length = strlen(msg_text) };
+					janus_plugin_data data = { .label = NULL, .protocol = NULL, .binary = FALSE,
+						.buffer = shared ? shared->buffer : msg_text,
+						.length = shared ? shared->length : strlen(msg_text),
+						.shared = shared };
 					gateway->relay_data(top->session->handle, &data);
 					janus_refcount_decrease(&top->ref);
 				}
+				janus_plugin_buffer_unref(shared);
 			}
 			if(textroom->history && history_text) {
 				/* Store in the history */
@@ -2365,6 +2373,8 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 		}
 		/* Send the announcement to everybody in the room */
 		if(textroom->participants) {
+			/* Share the serialized announcement across all recipients */
+			janus_plugin_buffer *shared = janus_plugin_buffer_new(msg_text, strlen(msg_text));
 			GHashTableIter iter;
 			gpointer value;
 			g_hash_table_iter_init(&iter, textroom->participants);
@@ -2372,10 +2382,14 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 				janus_textroom_participant *top = value;
 				JANUS_LOG(LOG_VERB, "  >> To %s in %s: %s\n", top->username, room_id_str, message);
 				janus_refcount_increase(&top->ref);
-				janus_plugin_data data = { .label = NULL, .protocol = NULL, .binary = FALSE, .buffer = msg_text, .length = strlen(msg_text) };
+				janus_plugin_data data = { .label = NULL, .protocol = NULL, .binary = FALSE,
+					.buffer = shared ? shared->buffer : msg_text,
+					.length = shared ? shared->length : strlen(msg_text),
+					.shared = shared };
 				gateway->relay_data(top->session->handle, &data);
 				janus_refcount_decrease(&top->ref);
 			}
+			janus_plugin_buffer_unref(shared);
 		}
 		if(textroom->history) {
 			/* Store in the history */
@@ -350,6 +350,7 @@ static struct janus_json_parameter set_parameters[] = {
 /* Useful stuff */
 static volatile gint initialized = 0, stopping = 0;
 static gboolean notify_events = TRUE;
+static gboolean direct_bridge = FALSE;
 static janus_callbacks *gateway = NULL;
 static GThread *handler_thread;
 static void *janus_videocall_handler(void *data);
@@ -390,6 +391,7 @@ typedef struct janus_videocall_session {
 	gboolean e2ee;			/* Whether media is encrypted, e.g., using Insertable Streams */
 	janus_mutex rec_mutex;	/* Mutex to protect the recorders from race conditions */
 	volatile gint incall;
+	volatile gint bridged;
 	volatile gint dataready;
 	volatile gint hangingup;
 	volatile gint destroyed;
@@ -492,6 +494,12 @@ int janus_videocall_init(janus_callbacks *callback, const char *config_path) {
 		if(!notify_events && callback->events_is_enabled()) {
 			JANUS_LOG(LOG_WARN, "Notification of events to handlers disabled for %s\n", JANUS_VIDEOCALL_NAME);
 		}
+		janus_config_item *bridge = janus_config_get(config, config_general, janus_config_type_item, "direct_bridge");
+		if(bridge != NULL && bridge->value != NULL)
+			direct_bridge = janus_is_true(bridge->value);
+		if(direct_bridge) {
+			JANUS_LOG(LOG_INFO, "Eligible calls will have their media bridged directly by the core\n");
+		}
 	}
 	janus_config_destroy(config);
 	config = NULL;
@@ -729,6 +737,34 @@ struct janus_plugin_result *janus_videocall_handle_message(janus_plugin_session
 	return janus_plugin_result_new(JANUS_PLUGIN_OK_WAIT, NULL, NULL);
 }
 
+/* Helper to check whether a call is eligible for core-level bridging of its media
+ * (1:1, audio and video active on both sides, no simulcast and no recording), and
+ * to ask the core to set the bridge up or tear it down accordingly: while a call
+ * is bridged, our incoming_rtp callback is not invoked at all, since the core
+ * relays the RTP packets between the two PeerConnections itself */
+static void janus_videocall_update_bridge(janus_videocall_session *session) {
+	if(!direct_bridge || gateway->set_media_bridge == NULL)
+		return;
+	if(session == NULL || session->peer == NULL)
+		return;
+	janus_videocall_session *peer = session->peer;
+	gboolean bridge = !g_atomic_int_get(&session->destroyed) && !g_atomic_int_get(&peer->destroyed) &&
+		!g_atomic_int_get(&session->hangingup) && !g_atomic_int_get(&peer->hangingup) &&
+		session->audio_active && session->video_active && peer->audio_active && peer->video_active &&
+		session->arc == NULL && session->vrc == NULL && peer->arc == NULL && peer->vrc == NULL &&
+		session->ssrc[0] == 0 && session->rid[0] == NULL && peer->ssrc[0] == 0 && peer->rid[0] == NULL;
+	if(bridge == (gboolean)g_atomic_int_get(&session->bridged))
+		return;	/* Nothing changed */
+	JANUS_LOG(LOG_INFO, "%s the direct media bridge between %s and %s\n",
+		bridge ? "Setting up" : "Tearing down",
+		session->username ? session->username : "??",
+		peer->username ? peer->username : "??");
+	g_atomic_int_set(&session->bridged, bridge);
+	g_atomic_int_set(&peer->bridged, bridge);
+	gateway->set_media_bridge(session->handle, bridge ? peer->handle : NULL);
+	gateway->set_media_bridge(peer->handle, bridge ? session->handle : NULL);
+}
+
 void janus_videocall_setup_media(janus_plugin_session *handle) {
 	JANUS_LOG(LOG_INFO, "[%s-%p] WebRTC media is now available\n", JANUS_VIDEOCALL_PACKAGE, handle);
 	if(g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized))
@@ -745,6 +781,8 @@ void janus_videocall_setup_media(janus_plugin_session *handle) {
 		return;
 	}
 	g_atomic_int_set(&session->hangingup, 0);
+	/* Check if the core can bridge media between the two parties directly */
+	janus_videocall_update_bridge(session);
 	janus_mutex_unlock(&sessions_mutex);
 	/* We really don't care, as we only relay RTP/RTCP we get in the first place anyway */
 }
@@ -1002,6 +1040,8 @@ static void janus_videocall_hangup_media_internal(janus_plugin_session *handle)
 	if(!g_atomic_int_compare_and_exchange(&session->hangingup, 0, 1))
 		return;
 	g_atomic_int_set(&session->dataready, 0);
+	/* If the core was bridging media for this call, tear the bridge down */
+	janus_videocall_update_bridge(session);
 	/* Get rid of the recorders, if available */
 	janus_mutex_lock(&session->rec_mutex);
 	janus_videocall_recorder_close(session);
@@ -1732,6 +1772,8 @@ static void *janus_videocall_handler(void *data) {
 				}
 				gateway->notify_event(&janus_videocall_plugin, session->handle, info);
 			}
+			/* Check if the new settings affect core-level bridging of this call */
+			janus_videocall_update_bridge(session);
 			/* Send an ack back */
 			result = json_object();
 			json_object_set_new(result, "event", json_string("set"));
@@ -81,6 +81,15 @@ room-<unique room ID>: {
 	bitrate = <max video bitrate for senders> (e.g., 128000)
 	bitrate_cap = <true|false, whether the above cap should act as a limit to dynamic bitrate changes by publishers, default=false>,
 	fir_freq = <send a FIR to publishers every fir_freq seconds> (0=disable)
+	pli_throttle = <deliver at most one keyframe request per publisher stream in this time window, in milliseconds, default=1000>
+	cache_keyframes = true|false (whether the latest keyframe of each publisher stream should be cached
+				and served to late joiners locally, instead of asking the publisher for a new one;
+				ignored for simulcast/SVC streams, default=false)
+	bitrate_quota = <max aggregate bitrate this room is allowed to relay to subscribers, in bps;
+				when the quota is exceeded, video packets are dropped until the rate
+				falls below the threshold again> (0=no limit)
+	pps_quota = <max aggregate packet rate this room is allowed to relay to subscribers,
+				in packets per second; enforced like bitrate_quota> (0=no limit)
 	audiocodec = opus|g722|pcmu|pcma|isac32|isac16 (audio codec to force on publishers, default=opus
 				can be a comma separated list in order of preference, e.g., opus,pcmu)
 	videocodec = vp8|vp9|h264|av1|h265 (video codec to force on publishers, default=vp8
@@ -102,6 +111,9 @@ room-<unique room ID>: {
 		negotiated/used or not for new publishers, default=true)
 	record = true|false (whether this room should be recorded, default=false)
 	rec_dir = <folder where recordings should be stored, when enabled>
+	rec_shared = true|false (whether all recordings of the room should be muxed in a single
+				shared .mjrs file, rather than one .mjr file per stream; use mjrs2mjr to
+				split the muxed file back into standalone .mjr files, default=false)
 	lock_record = true|false (whether recording can only be started/stopped if the secret
 				is provided, or using the global enable_recording request, default=false)
 	notify_joining = true|false (optional, whether to notify all participants when a new
@@ -241,6 +253,9 @@ room-<unique room ID>: {
 	"new_require_pvtid" : <true|false, whether the room should require private_id from subscribers>,
 	"new_bitrate" : <new bitrate cap to force on all publishers (except those with custom overrides)>,
 	"new_fir_freq" : <new period for regular PLI keyframe requests to publishers>,
+	"new_pli_throttle" : <new time window to coalesce keyframe requests to publishers in, in milliseconds>,
+	"new_bitrate_quota" : <new cap on the aggregate bitrate this room is allowed to relay to subscribers, in bps (0=no limit)>,
+	"new_pps_quota" : <new cap on the aggregate packet rate this room is allowed to relay to subscribers, in packets per second (0=no limit)>,
 	"new_publishers" : <new cap on the number of concurrent active WebRTC publishers>,
 	"new_lock_record" : <true|false, whether recording state can only be changed when providing the room secret>,
 	"new_rec_dir" : "<the new path where the next .mjr files should being saved>",
@@ -444,7 +459,9 @@ room-<unique room ID>: {
 \verbatim
 {
 	"request" : "listparticipants",
-	"room" : <unique numeric ID of the room>
+	"room" : <unique numeric ID of the room>,
+	"cursor" : <room version to use as a changed-since filter, as returned by a previous response; optional>,
+	"count" : <maximum number of participants to return, for pagination purposes; optional>
 }
 \endverbatim
  *
@@ -463,9 +480,18 @@ room-<unique room ID>: {
 			"talking" : <true|false, whether user is talking or not (only if audio levels are used)>
 		},
 		// Other participants
-	]
+	],
+	"version" : <current version of the room, incremented every time a participant joins, leaves or changes>,
+	"next_cursor" : <cursor to pass to a follow-up request to get the next page (only if "count" truncated the list)>
 }
 \endverbatim
+ *
+ * Dashboards polling crowded rooms can pass the \c version they got in
+ * a previous response as a \c cursor , to only be returned the
+ * participants that changed in the meanwhile (an unchanged \c version
+ * means nothing changed at all, e.g., when someone left), and/or use
+ * \c count to page through large rooms rather than downloading the
+ * whole list every time.
  *
  * This covers almost all the synchronous requests. All the asynchronous requests,
  * plus a couple of additional synchronous requests we'll cover later, refer
@@ -1095,6 +1121,13 @@ room-<unique room ID>: {
  * \c offer_data named properties, they're now deprecated and so you're
  * highly encouraged to use this new drill-down \c streams list instead.
  *
+ * In case you want to subscribe to all the streams of many publishers at
+ * once (e.g., to build a grid view of the room with a single offer/answer
+ * cycle), you can also pass a \c publishers array of feed IDs in place of
+ * \c streams : it's just a shorthand that the plugin expands to the
+ * equivalent \c streams array, subscribing to every stream of each listed
+ * publisher, and works in the \c subscribe request too.
+ *
  * As anticipated, if successful this request will generate a new JSEP SDP
  * offer, which will accompany an \c attached event:
  *
@@ -1194,6 +1227,20 @@ room-<unique room ID>: {
 		// Other new streams to subscribe to
 	]
 }
+\endverbatim
+ *
+ * As a shorthand for bulk subscriptions, e.g., when building a grid view
+ * of a large room, a \c publishers array of feed IDs can be passed in
+ * place of \c streams : this subscribes to all the streams of each listed
+ * publisher, exactly as if a \c streams entry with only a \c feed had
+ * been provided for each of them, and still results in a single
+ * renegotiation covering the whole batch:
+ *
+\verbatim
+{
+	"request" : "subscribe",
+	"publishers" : [ <feed ID #1>, <feed ID #2>, .. ]
+}
 \endverbatim
  *
  * This means the exact same considerations we made on \c streams before
@@ -1383,6 +1430,7 @@ room-<unique room ID>: {
 			"audio_active_packets" : "<if provided, overrides the room audio_active_packets for this user; optional>",
 			"min_delay" : <minimum delay to enforce via the playout-delay RTP extension, in blocks of 10ms; optional>,
 			"max_delay" : <maximum delay to enforce via the playout-delay RTP extension, in blocks of 10ms; optional>,
+			"autoadapt" : <true|false, whether the plugin should automatically step the substream/spatial layer down on congestion, and back up when the link recovers; optional>,
 		},
 		// Other streams, if any
 	],
@@ -1401,7 +1449,14 @@ room-<unique room ID>: {
  * subscription may be receiving simulcast stream from multiple publishers.
  * The \c spatial_layer and \c temporal_layer have exactly the same meaning,
  * but within the context of SVC publishers, and will have no effect
- * on subscriptions associated to regular publishers.
+ * on subscriptions associated to regular publishers. The \c autoadapt
+ * property, when enabled, tells the plugin to manage the substream (or
+ * spatial layer) autonomously: when the Janus core reports congestion
+ * towards the subscriber, the plugin steps the layer down by itself, and
+ * steps it back up towards the originally requested target once the link
+ * has been clean for a while, without requiring any action from the
+ * application; explicitly setting a new \c substream or \c spatial_layer
+ * simply updates the target the adaptation will aim for.
  *
  * As anticipated, \c configure is also the request you use when you want
  * to trigger an ICE restart for a subscriber: in fact, while publishers
@@ -1527,11 +1582,15 @@ room-<unique room ID>: {
 #include "../rtpfwd.h"
 #include "../record.h"
 #include "../sdp-utils.h"
+#include "../tracepoints.h"
 #include "../utils.h"
 #include "../ip-utils.h"
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <poll.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 
 
 /* Plugin information */
@@ -1565,6 +1624,7 @@ void janus_videoroom_slow_link(janus_plugin_session *handle, int mindex, gboolea
 void janus_videoroom_hangup_media(janus_plugin_session *handle);
 void janus_videoroom_destroy_session(janus_plugin_session *handle, int *error);
 json_t *janus_videoroom_query_session(janus_plugin_session *handle);
+json_t *janus_videoroom_query_state(void);
 
 /* Plugin setup */
 static janus_plugin janus_videoroom_plugin =
@@ -1592,6 +1652,7 @@ static janus_plugin janus_videoroom_plugin =
 		.hangup_media = janus_videoroom_hangup_media,
 		.destroy_session = janus_videoroom_destroy_session,
 		.query_session = janus_videoroom_query_session,
+		.query_state = janus_videoroom_query_state,
 	);
 
 /* Plugin creator */
@@ -1618,6 +1679,10 @@ static struct janus_json_parameter create_parameters[] = {
 	{"bitrate", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"bitrate_cap", JANUS_JSON_BOOL, 0},
 	{"fir_freq", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	{"pli_throttle", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	{"cache_keyframes", JANUS_JSON_BOOL, 0},
+	{"bitrate_quota", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	{"pps_quota", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"publishers", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"audiocodec", JSON_STRING, 0},
 	{"videocodec", JSON_STRING, 0},
@@ -1634,6 +1699,7 @@ static struct janus_json_parameter create_parameters[] = {
 	{"transport_wide_cc_ext", JANUS_JSON_BOOL, 0},
 	{"record", JANUS_JSON_BOOL, 0},
 	{"rec_dir", JSON_STRING, 0},
+	{"rec_shared", JANUS_JSON_BOOL, 0},
 	{"lock_record", JANUS_JSON_BOOL, 0},
 	{"permanent", JANUS_JSON_BOOL, 0},
 	{"notify_joining", JANUS_JSON_BOOL, 0},
@@ -1651,6 +1717,9 @@ static struct janus_json_parameter edit_parameters[] = {
 	{"new_require_pvtid", JANUS_JSON_BOOL, 0},
 	{"new_bitrate", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"new_fir_freq", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	{"new_pli_throttle", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	{"new_bitrate_quota", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	{"new_pps_quota", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"new_publishers", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"new_lock_record", JANUS_JSON_BOOL, 0},
 	{"new_rec_dir", JSON_STRING, 0},
@@ -1701,6 +1770,10 @@ static struct janus_json_parameter feedstropt_parameters[] = {
 static struct janus_json_parameter destroy_parameters[] = {
 	{"permanent", JANUS_JSON_BOOL, 0}
 };
+static struct janus_json_parameter listparticipants_parameters[] = {
+	{"cursor", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	{"count", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE}
+};
 static struct janus_json_parameter allowed_parameters[] = {
 	{"secret", JSON_STRING, 0},
 	{"action", JSON_STRING, JANUS_JSON_PARAM_REQUIRED},
@@ -1822,6 +1895,8 @@ static struct janus_json_parameter configure_stream_parameters[] = {
 	/* For SVC */
 	{"spatial_layer", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"temporal_layer", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	/* For automatic simulcast/SVC layer adaptation */
+	{"autoadapt", JANUS_JSON_BOOL, 0},
 	/* For the playout-delay RTP extension, if negotiated */
 	{"min_delay", JSON_INTEGER, 0},
 	{"max_delay", JSON_INTEGER, 0},
@@ -1866,6 +1941,8 @@ static struct janus_json_parameter subscriber_stream_parameters[] = {
 	/* For SVC */
 	{"spatial_layer", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"temporal_layer", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	/* For automatic simulcast/SVC layer adaptation */
+	{"autoadapt", JANUS_JSON_BOOL, 0},
 	/* For the playout-delay RTP extension, if negotiated */
 	{"min_delay", JSON_INTEGER, 0},
 	{"max_delay", JSON_INTEGER, 0}
@@ -2028,6 +2105,15 @@ typedef struct janus_videoroom {
 	uint32_t bitrate;			/* Global bitrate limit */
 	gboolean bitrate_cap;		/* Whether the above limit is insormountable */
 	uint16_t fir_freq;			/* Regular FIR frequency (0=disabled) */
+	uint16_t pli_throttle;		/* Minimum interval between keyframe requests to a publisher, in milliseconds (0=default, 1000) */
+	gboolean cache_keyframes;	/* Whether the latest keyframe of video publisher streams should be cached, to serve late joiners locally */
+	uint64_t bitrate_quota;		/* Max aggregate bitrate this room is allowed to relay to subscribers, in bps (0=no limit) */
+	uint32_t pps_quota;			/* Max aggregate packet rate this room is allowed to relay to subscribers, in packets/s (0=no limit) */
+	volatile gint quota_bytes;	/* Bytes relayed to subscribers in the current accounting window */
+	volatile gint quota_packets;	/* Packets relayed to subscribers in the current accounting window */
+	gint64 quota_started;		/* Monotonic time the current accounting window started */
+	volatile gint quota_checking;	/* Small lock to make sure only one thread evaluates the window */
+	volatile gint quota_exceeded;	/* Whether the room is over quota, and so video is being dropped */
 	janus_audiocodec acodec[5];	/* Audio codec(s) to force on publishers */
 	janus_videocodec vcodec[5];	/* Video codec(s) to force on publishers */
 	char *vp9_profile;			/* VP9 codec profile to prefer, if more are negotiated */
@@ -2043,9 +2129,14 @@ typedef struct janus_videoroom {
 	gboolean transport_wide_cc_ext;	/* Whether the transport wide cc extension must be negotiated or not for new publishers */
 	gboolean record;			/* Whether the feeds from publishers in this room should be recorded */
 	char *rec_dir;				/* Where to save the recordings of this room, if enabled */
+	gboolean rec_shared;		/* Whether all recordings of this room should be muxed in a single shared .mjrs file */
+	janus_recorder_sink *rec_sink;	/* Shared recording sink, if rec_shared is in use and recording is active */
 	gboolean lock_record;		/* Whether recording state can only be changed providing the room secret */
 	GHashTable *participants;	/* Map of potential publishers (we get subscribers from them) */
+	guint64 changes;			/* Monotonic counter of participant changes, used by incremental listparticipants requests */
 	GHashTable *private_ids;	/* Map of existing private IDs */
+	GHashTable *offer_templates;	/* Cached serialized subscriber offers, indexed by the set of streams they describe */
+	janus_mutex templates_mutex;	/* Mutex to protect the cached subscriber offers */
 	volatile gint destroyed;	/* Whether this room has been destroyed */
 	gboolean check_allowed;		/* Whether to check tokens when participants join (see below) */
 	GHashTable *allowed;		/* Map of participants (as tokens) allowed to join */
@@ -2120,6 +2211,7 @@ typedef struct janus_videoroom_publisher {
 	int user_audio_active_packets;	/* Participant's audio_active_packets overwriting global room setting */
 	int user_audio_level_average;	/* Participant's audio_level_average overwriting global room setting */
 	gboolean talking; 	/* Whether this participant is currently talking (uses audio levels extension) */
+	guint64 updated;	/* Value of the room changes counter when this participant last changed */
 	gboolean firefox;	/* We send Firefox users a different kind of FIR */
 	GList *streams;				/* List of media streams sent by this publisher (audio, video and/or data) */
 	GHashTable *streams_byid;	/* As above, indexed by mindex */
@@ -2143,6 +2235,8 @@ typedef struct janus_videoroom_publisher {
 	struct sockaddr_storage rtcp_addr;	/* RTCP address of the remote publisher */
 	GThread *remote_thread;		/* Remote publisher incoming packets thread */
 	volatile gint remote_leaving;
+	void *ingest_shard;			/* Ingest shard serving this remote publisher, if any */
+	GSList *ingest_fds;			/* File descriptors we registered on the ingest shard */
 	/* Index of RTP (or data) forwarders for this participant (all streams), if any */
 	GHashTable *rtp_forwarders;
 	janus_mutex rtp_forwarders_mutex;
@@ -2198,10 +2292,19 @@ typedef struct janus_videoroom_publisher_stream {
 	/* RTP (or data) forwarders for this stream, if any */
 	GHashTable *rtp_forwarders;
 	janus_mutex rtp_forwarders_mutex;
-	/* In case this is a stream from a remote publisher */
+	/* PLI throttling state (sending_pli is only used for remote publishers) */
 	volatile gint need_pli;		/* Whether we need to send a PLI later */
 	volatile gint sending_pli;	/* Whether we're currently sending a PLI */
 	gint64 pli_latest;			/* Time of latest sent PLI (to avoid flooding) */
+	/* Latest keyframe of this stream, if caching is enabled for the room (and
+	 * the stream isn't simulcast/SVC): late joiners are served the cached
+	 * keyframe locally, rather than asking the publisher for a fresh one */
+	struct {
+		GList *latest_keyframe;
+		GList *temp_keyframe;
+		guint32 temp_ts;
+		janus_mutex mutex;
+	} keyframe;
 	/* Subscriptions to this publisher stream (who's receiving it)  */
 	GSList *subscribers;
 	janus_mutex subscribers_mutex;
@@ -2234,6 +2337,40 @@ static int janus_videoroom_create_fd(int port, in_addr_t mcast, const janus_netw
 static int janus_videoroom_get_fd_port(int fd);
 /* Thread responsible for a specific remote publisher */
 static void *janus_videoroom_remote_publisher_thread(void *data);
+/* Helper to mark a participant as changed, for incremental listparticipants requests */
+static void janus_videoroom_participant_changed(janus_videoroom_publisher *p);
+/* Helpers shared by the remote publisher thread and the ingest engine */
+static void janus_videoroom_remote_publisher_join(janus_videoroom_publisher *publisher);
+static void janus_videoroom_remote_publisher_readable(janus_videoroom_publisher *publisher, int fd, char *buffer, int buflen);
+static void janus_videoroom_remote_publisher_leave(janus_videoroom_publisher *publisher);
+
+#ifdef __linux__
+/* Shared ingest engine: when remote_ingest_threads is set in the
+ * configuration, the sockets of remote publishers are multiplexed on a
+ * small number of epoll() loops (shards), instead of each remote
+ * publisher spawning a dedicated thread blocking in poll(): cascading
+ * topologies with hundreds of remote publishers per aggregation node
+ * save as many stacks and context switches. Notice that each remote
+ * publisher keeps its own socket pair, as the port is what tells remote
+ * publishers apart on the wire (they all share the same SSRC layout) */
+typedef struct janus_videoroom_ingest_shard {
+	int id;				/* Shard number */
+	int epollfd;		/* epoll file descriptor the shard blocks on */
+	GThread *thread;	/* Thread running the epoll loop */
+	GList *publishers;	/* Remote publishers currently served by this shard */
+	janus_mutex mutex;	/* Mutex to lock this structure */
+} janus_videoroom_ingest_shard;
+/* Small helper struct we attach to each file descriptor we register */
+typedef struct janus_videoroom_ingest_fd {
+	int fd;
+	janus_videoroom_publisher *publisher;
+} janus_videoroom_ingest_fd;
+static janus_videoroom_ingest_shard *ingest_shards = NULL;
+static int ingest_shards_num = 0;
+static volatile gint ingest_shards_rr = 0;
+static void *janus_videoroom_ingest_shard_thread(void *data);
+#endif
+static gboolean janus_videoroom_ingest_register(janus_videoroom_publisher *publisher);
 
 typedef struct janus_videoroom_subscriber {
 	janus_videoroom_session *session;
@@ -2278,8 +2415,24 @@ typedef struct janus_videoroom_subscriber_stream {
 	janus_vp8_simulcast_context vp8_context;
 	/* SVC context */
 	janus_rtp_svc_context svc_context;
+	/* Relay path in use for this stream: which one is right (plain, simulcast
+	 * or SVC, plus codec specific variants) only depends on properties that are
+	 * fixed for as long as we're fed by the same publisher stream, so we resolve
+	 * it once and re-evaluate it only when the source changes (e.g., a switch),
+	 * rather than branching on codec in the relay hot path per packet */
+	void (*relay)(struct janus_videoroom_subscriber_stream *stream,
+		struct janus_videoroom_publisher_stream *ps, struct janus_videoroom_rtp_relay_packet *packet);
+	void *relay_source;		/* Publisher stream the path was picked for (identity check only, no reference held) */
 	/* Playout delays to enforce when relaying this stream, if the extension has been negotiated */
 	int16_t min_delay, max_delay;
+	/* Automatic layer adaptation, if enabled on this subscription: when the core
+	 * reports congestion towards this subscriber (slow_link), we step the simulcast
+	 * substream (or SVC spatial layer) down ourselves, instead of waiting for the
+	 * subscriber to reconfigure, and step back up towards the target the subscriber
+	 * asked for once the link has been clean for a while */
+	gboolean autoadapt;
+	int adapt_target;		/* Substream/spatial layer the subscriber actually asked for */
+	gint64 adapted;			/* Monotonic time of the last automatic step (down or up) */
 	volatile gint ready, destroyed;
 	janus_refcount ref;
 } janus_videoroom_subscriber_stream;
@@ -2309,12 +2462,19 @@ typedef struct janus_videoroom_rtp_relay_packet {
 	janus_vp9_svc_info svc_info;
 	/* The following is only relevant for datachannels */
 	gboolean textdata;
+	/* Refcounted buffer the packet data lives in, if any: when set, we
+	 * pass it to the core too, so that the per-recipient payload copies
+	 * can be deferred to the send loops (see janus_plugin_buffer) */
+	janus_plugin_buffer *shared;
 } janus_videoroom_rtp_relay_packet;
 static janus_videoroom_rtp_relay_packet exit_packet;
 static void janus_videoroom_rtp_relay_packet_free(janus_videoroom_rtp_relay_packet *pkt) {
 	if(pkt == NULL || pkt == &exit_packet)
 		return;
-	g_free(pkt->data);
+	if(pkt->shared != NULL)
+		janus_plugin_buffer_unref(pkt->shared);
+	else
+		g_free(pkt->data);
 	g_free(pkt);
 }
 
@@ -2414,6 +2574,11 @@ static void janus_videoroom_publisher_stream_free(const janus_refcount *ps_ref)
 	janus_mutex_destroy(&ps->subscribers_mutex);
 	janus_mutex_destroy(&ps->rid_mutex);
 	janus_rtp_simulcasting_cleanup(NULL, NULL, ps->rid, NULL);
+	if(ps->keyframe.latest_keyframe != NULL)
+		g_list_free_full(ps->keyframe.latest_keyframe, (GDestroyNotify)janus_videoroom_rtp_relay_packet_free);
+	if(ps->keyframe.temp_keyframe != NULL)
+		g_list_free_full(ps->keyframe.temp_keyframe, (GDestroyNotify)janus_videoroom_rtp_relay_packet_free);
+	janus_mutex_destroy(&ps->keyframe.mutex);
 	g_free(ps);
 }
 
@@ -2546,10 +2711,13 @@ static void janus_videoroom_room_free(const janus_refcount *room_ref) {
 	g_free(room->room_secret);
 	g_free(room->room_pin);
 	g_free(room->rec_dir);
+	if(room->rec_sink != NULL)
+		janus_recorder_sink_destroy(room->rec_sink);
 	g_free(room->vp9_profile);
 	g_free(room->h264_profile);
 	g_hash_table_destroy(room->participants);
 	g_hash_table_destroy(room->private_ids);
+	g_hash_table_destroy(room->offer_templates);
 	g_hash_table_destroy(room->allowed);
 	g_free(room);
 }
@@ -2657,9 +2825,95 @@ static void janus_videoroom_rtcp_pli_send(janus_videoroom_publisher_stream *ps)
 	g_atomic_int_set(&ps->sending_pli, 0);
 }
 
+/* Helper to track the latest keyframe of a publisher stream, when keyframe
+ * caching is enabled for the room: mirrors what the Streaming plugin does
+ * for mountpoints with the bufferkf option */
+static void janus_videoroom_keyframe_cache_rtp(janus_videoroom_publisher_stream *ps, char *buffer, uint16_t len) {
+	janus_rtp_header *rtp = (janus_rtp_header *)buffer;
+	guint32 timestamp = ntohl(rtp->timestamp);
+	if(ps->keyframe.temp_ts > 0 && timestamp != ps->keyframe.temp_ts) {
+		/* We received the last part of the keyframe, get rid of the old one and use this from now on */
+		JANUS_LOG(LOG_HUGE, "Last part of keyframe received! ts=%"SCNu32", %d packets\n",
+			ps->keyframe.temp_ts, g_list_length(ps->keyframe.temp_keyframe));
+		ps->keyframe.temp_ts = 0;
+		janus_mutex_lock_adaptive(&ps->keyframe.mutex);
+		if(ps->keyframe.latest_keyframe != NULL)
+			g_list_free_full(ps->keyframe.latest_keyframe, (GDestroyNotify)janus_videoroom_rtp_relay_packet_free);
+		ps->keyframe.latest_keyframe = ps->keyframe.temp_keyframe;
+		ps->keyframe.temp_keyframe = NULL;
+		janus_mutex_unlock(&ps->keyframe.mutex);
+		return;
+	}
+	if(timestamp != ps->keyframe.temp_ts) {
+		/* Not part of the keyframe we're saving: is this the first packet of a new one? */
+		int plen = 0;
+		char *payload = janus_rtp_payload(buffer, len, &plen);
+		if(payload == NULL)
+			return;
+		gboolean kf = FALSE;
+		switch(ps->vcodec) {
+			case JANUS_VIDEOCODEC_VP8:
+				kf = janus_vp8_is_keyframe(payload, plen);
+				break;
+			case JANUS_VIDEOCODEC_VP9:
+				kf = janus_vp9_is_keyframe(payload, plen);
+				break;
+			case JANUS_VIDEOCODEC_H264:
+				kf = janus_h264_is_keyframe(payload, plen);
+				break;
+			case JANUS_VIDEOCODEC_AV1:
+				kf = janus_av1_is_keyframe(payload, plen);
+				break;
+			case JANUS_VIDEOCODEC_H265:
+				kf = janus_h265_is_keyframe(payload, plen);
+				break;
+			default:
+				return;
+		}
+		if(!kf)
+			return;
+		/* New keyframe, start saving it */
+		ps->keyframe.temp_ts = timestamp;
+		JANUS_LOG(LOG_HUGE, "New keyframe received! ts=%"SCNu32"\n", timestamp);
+	}
+	/* Store a copy of this packet in the keyframe we're saving (the lock is
+	 * per-packet in the video hot path, but only ever briefly held) */
+	janus_mutex_lock_adaptive(&ps->keyframe.mutex);
+	janus_videoroom_rtp_relay_packet *pkt = g_malloc0(sizeof(janus_videoroom_rtp_relay_packet));
+	pkt->source = ps;
+	pkt->data = g_malloc(len);
+	memcpy(pkt->data, buffer, len);
+	pkt->length = len;
+	pkt->is_rtp = TRUE;
+	pkt->is_video = TRUE;
+	pkt->timestamp = timestamp;
+	pkt->seq_number = ntohs(rtp->seq_number);
+	janus_plugin_rtp_extensions_reset(&pkt->extensions);
+	ps->keyframe.temp_keyframe = g_list_append(ps->keyframe.temp_keyframe, pkt);
+	janus_mutex_unlock(&ps->keyframe.mutex);
+}
+
 static void janus_videoroom_reqpli(janus_videoroom_publisher_stream *ps, const char *reason) {
 	if(ps == NULL || g_atomic_int_get(&ps->destroyed) || ps->publisher == NULL || g_atomic_int_get(&ps->publisher->destroyed))
 		return;
+	if(!ps->publisher->remote) {
+		/* When many subscribers lose the same frame, they all ask for a
+		 * keyframe at (almost) the same time, and one keyframe serves them
+		 * all: suppress the extra requests, rather than multiply them
+		 * towards the publisher (the remote publisher helper below does
+		 * its own throttling, with the same properties) */
+		janus_videoroom *room = ps->publisher->room;
+		gint64 throttle = (room != NULL && room->pli_throttle > 0) ?
+			((gint64)room->pli_throttle*1000) : G_USEC_PER_SEC;
+		gint64 now = janus_get_monotonic_time();
+		if(now - ps->pli_latest < throttle) {
+			/* We just sent a PLI less than a second ago, schedule a new delivery later */
+			g_atomic_int_set(&ps->need_pli, 1);
+			return;
+		}
+		g_atomic_int_set(&ps->need_pli, 0);
+		ps->pli_latest = now;
+	}
 	/* Send a PLI */
 	JANUS_LOG(LOG_VERB, "%s sending PLI to %s (#%d, %s)\n", reason,
 		ps->publisher->user_id_str, ps->mindex, ps->publisher->display ? ps->publisher->display : "??");
@@ -2863,6 +3117,7 @@ static void janus_videoroom_create_dummy_publisher(janus_videoroom *room, GHashT
 		janus_refcount_increase(&ps->ref);	/* This is for the id-indexed hashtable */
 		janus_refcount_increase(&ps->ref);	/* This is for the mid-indexed hashtable */
 		janus_mutex_init(&ps->subscribers_mutex);
+		janus_mutex_init(&ps->keyframe.mutex);
 		janus_mutex_init(&ps->rtp_forwarders_mutex);
 		janus_mutex_init(&ps->rid_mutex);
 		ps->rtp_forwarders = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_rtp_forwarder_destroy);
@@ -2910,6 +3165,7 @@ static void janus_videoroom_create_dummy_publisher(janus_videoroom *room, GHashT
 		janus_refcount_increase(&ps->ref);	/* This is for the id-indexed hashtable */
 		janus_refcount_increase(&ps->ref);	/* This is for the mid-indexed hashtable */
 		janus_mutex_init(&ps->subscribers_mutex);
+		janus_mutex_init(&ps->keyframe.mutex);
 		janus_mutex_init(&ps->rtp_forwarders_mutex);
 		janus_mutex_init(&ps->rid_mutex);
 		ps->rtp_forwarders = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_rtp_forwarder_destroy);
@@ -2924,6 +3180,7 @@ static void janus_videoroom_create_dummy_publisher(janus_videoroom *room, GHashT
 	g_hash_table_insert(room->participants,
 		string_ids ? (gpointer)g_strdup(publisher->user_id_str) : (gpointer)janus_uint64_dup(publisher->user_id),
 		publisher);
+	janus_videoroom_participant_changed(publisher);
 }
 
 /* Helpers for subscription streams */
@@ -3278,9 +3535,93 @@ static json_t *janus_videoroom_subscriber_streams_summary(janus_videoroom_subscr
 	return media;
 }
 
+/* Helper to build a string descriptor of the media a subscriber offer will
+ * contain: subscribers attaching to the same set of publisher streams get
+ * byte-identical offers, apart from the session ID and version in the o=
+ * line, so we use the descriptor as a key to cache the serialized SDP at
+ * the room level and avoid regenerating it for each of them (e.g., when
+ * many viewers join for the same publishers at about the same time).
+ * Returns NULL if the descriptor doesn't fit the buffer, meaning the
+ * offer for this subscriber shouldn't be cached at all */
+static char *janus_videoroom_subscriber_offer_key(janus_videoroom_subscriber *subscriber) {
+	char key[2048], descriptor[512];
+	key[0] = '\0';
+	GList *temp = subscriber->streams;
+	while(temp) {
+		janus_videoroom_subscriber_stream *stream = (janus_videoroom_subscriber_stream *)temp->data;
+		janus_videoroom_publisher_stream *ps = stream->publisher_streams ? stream->publisher_streams->data : NULL;
+		gboolean add_msid = (subscriber->use_msid && ps && !ps->disabled);
+		/* Track everything that may end up in the m-line for this stream */
+		g_snprintf(descriptor, sizeof(descriptor), "%d,%s,%s,%s,%d,%d,%d,%s,%s,%d%d%d,%d%d%d;",
+			stream->type, stream->mid ? stream->mid : "-",
+			(add_msid && stream->msid) ? stream->msid : "-",
+			(add_msid && stream->mstid) ? stream->mstid : "-",
+			stream->pt,
+			(stream->type == JANUS_VIDEOROOM_MEDIA_AUDIO ? (int)stream->acodec : (int)stream->vcodec),
+			(ps && !ps->disabled) ? 1 : 0,
+			stream->h264_profile ? stream->h264_profile : "-",
+			stream->vp9_profile ? stream->vp9_profile : "-",
+			(ps && ps->opusfec) ? 1 : 0, (ps && ps->opusdtx) ? 1 : 0, (ps && ps->opusstereo) ? 1 : 0,
+			(ps && ps->audio_level_extmap_id > 0) ? 1 : 0,
+			(ps && ps->video_orient_extmap_id > 0) ? 1 : 0,
+			(ps && ps->playout_delay_extmap_id > 0) ? 1 : 0);
+		if(janus_strlcat(key, descriptor, sizeof(key)) >= sizeof(key)) {
+			/* Descriptor too large, don't cache the offer for this subscriber */
+			return NULL;
+		}
+		temp = temp->next;
+	}
+	return g_strdup(key);
+}
+
+/* Helper to patch the o= line of a cached subscriber offer, replacing the
+ * session ID and version with the ones of the subscriber we're sending it to */
+static char *janus_videoroom_subscriber_offer_patch(const char *cached, guint64 sessid, guint64 version) {
+	const char *o_line = strstr(cached, "\no=");
+	const char *o_end = o_line ? strchr(o_line+1, '\n') : NULL;
+	if(o_end == NULL)
+		return NULL;
+	o_line++;
+	o_end++;
+	/* The o= line is the only part that changes between subscribers */
+	char o_new[100];
+	g_snprintf(o_new, sizeof(o_new), "o=- %"SCNu64" %"SCNu64" IN IP4 0.0.0.0\r\n", sessid, version);
+	size_t prefix = o_line - cached, olen = strlen(o_new);
+	char *sdp = g_malloc(prefix + olen + strlen(o_end) + 1);
+	memcpy(sdp, cached, prefix);
+	memcpy(sdp + prefix, o_new, olen);
+	memcpy(sdp + prefix + olen, o_end, strlen(o_end) + 1);
+	return sdp;
+}
+
 /* Helper to generate a new offer with the subscriber streams */
 static json_t *janus_videoroom_subscriber_offer(janus_videoroom_subscriber *subscriber) {
 	g_atomic_int_set(&subscriber->answered, 0);
+	/* Update (or set) the SDP version */
+	subscriber->session->sdp_version++;
+	/* Check if we have a cached offer for this set of streams already: if
+	 * we do, all we need to do is patch the o= line for this subscriber */
+	janus_videoroom *videoroom = subscriber->room;
+	char *key = janus_videoroom_subscriber_offer_key(subscriber);
+	char *sdp = NULL;
+	if(key != NULL) {
+		janus_mutex_lock(&videoroom->templates_mutex);
+		const char *cached = g_hash_table_lookup(videoroom->offer_templates, key);
+		if(cached != NULL) {
+			sdp = janus_videoroom_subscriber_offer_patch(cached,
+				(guint64)janus_get_real_time(), (guint64)subscriber->session->sdp_version);
+		}
+		janus_mutex_unlock(&videoroom->templates_mutex);
+	}
+	if(sdp != NULL) {
+		g_free(key);
+		json_t *jsep = json_pack("{ssss}", "type", "offer", "sdp", sdp);
+		if(subscriber->e2ee)
+			json_object_set_new(jsep, "e2ee", json_true());
+		g_free(sdp);
+		return jsep;
+	}
+	/* No cached offer, generate one from scratch */
 	char s_name[100], audio_fmtp[256];
 	g_snprintf(s_name, sizeof(s_name), "VideoRoom %s", subscriber->room->room_id_str);
 	janus_sdp *offer = janus_sdp_generate_offer(s_name, "0.0.0.0",
@@ -3341,11 +3682,19 @@ static json_t *janus_videoroom_subscriber_offer(janus_videoroom_subscriber *subs
 			JANUS_SDP_OA_DONE);
 		temp = temp->next;
 	}
-	/* Update (or set) the SDP version */
-	subscriber->session->sdp_version++;
 	offer->o_version = subscriber->session->sdp_version;
-	char *sdp = janus_sdp_write(offer);
+	sdp = janus_sdp_write(offer);
 	janus_sdp_destroy(offer);
+	if(key != NULL) {
+		/* Cache the serialized offer for other subscribers to the same set of streams */
+		janus_mutex_lock(&videoroom->templates_mutex);
+		if(g_hash_table_size(videoroom->offer_templates) >= 32) {
+			/* Don't let stale entries accumulate as publishers come and go */
+			g_hash_table_remove_all(videoroom->offer_templates);
+		}
+		g_hash_table_insert(videoroom->offer_templates, key, g_strdup(sdp));
+		janus_mutex_unlock(&videoroom->templates_mutex);
+	}
 	json_t *jsep = json_pack("{ssss}", "type", "offer", "sdp", sdp);
 	if(subscriber->e2ee)
 		json_object_set_new(jsep, "e2ee", json_true());
@@ -3409,6 +3758,49 @@ int janus_videoroom_init(janus_callbacks *callback, const char *config_path) {
 		if(string_ids) {
 			JANUS_LOG(LOG_INFO, "VideoRoom will use alphanumeric IDs, not numeric\n");
 		}
+		/* Should we share a few ingest threads among remote publishers, instead of one each? */
+		janus_config_item *ithreads = janus_config_get(config, config_general, janus_config_type_item, "remote_ingest_threads");
+		if(ithreads != NULL && ithreads->value != NULL) {
+#ifdef __linux__
+			int ingest_threads = atoi(ithreads->value);
+			if(ingest_threads < 0) {
+				JANUS_LOG(LOG_WARN, "Invalid number of ingest threads (%s), remote publishers will use dedicated threads\n", ithreads->value);
+				ingest_threads = 0;
+			}
+			if(ingest_threads > 0) {
+				/* Start the shared ingest engine */
+				ingest_shards = g_malloc0(ingest_threads * sizeof(janus_videoroom_ingest_shard));
+				int i = 0;
+				for(i=0; i<ingest_threads; i++) {
+					janus_videoroom_ingest_shard *shard = &ingest_shards[i];
+					shard->id = i+1;
+					shard->epollfd = epoll_create1(0);
+					janus_mutex_init(&shard->mutex);
+					char tname[16];
+					g_snprintf(tname, sizeof(tname), "ingest shard %d", shard->id);
+					GError *error = NULL;
+					if(shard->epollfd > -1)
+						shard->thread = g_thread_try_new(tname, &janus_videoroom_ingest_shard_thread, shard, &error);
+					if(shard->thread == NULL) {
+						JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to start ingest shard #%d, remaining remote publishers will use dedicated threads\n",
+							error ? error->code : errno, error && error->message ? error->message : g_strerror(errno), shard->id);
+						if(error != NULL)
+							g_error_free(error);
+						if(shard->epollfd > -1)
+							close(shard->epollfd);
+						break;
+					}
+					ingest_shards_num++;
+				}
+				if(ingest_shards_num > 0) {
+					JANUS_LOG(LOG_INFO, "Sharing %d ingest thread%s among remote publishers\n",
+						ingest_shards_num, ingest_shards_num == 1 ? "" : "s");
+				}
+			}
+#else
+			JANUS_LOG(LOG_WARN, "The shared ingest engine requires epoll(), remote publishers will use dedicated threads\n");
+#endif
+		}
 	}
 	rooms = g_hash_table_new_full(string_ids ? g_str_hash : g_int64_hash, string_ids ? g_str_equal : g_int64_equal,
 		(GDestroyNotify)g_free, (GDestroyNotify)janus_videoroom_room_destroy);
@@ -3432,6 +3824,10 @@ int janus_videoroom_init(janus_callbacks *callback, const char *config_path) {
 			janus_config_item *bitrate_cap = janus_config_get(config, cat, janus_config_type_item, "bitrate_cap");
 			janus_config_item *maxp = janus_config_get(config, cat, janus_config_type_item, "publishers");
 			janus_config_item *firfreq = janus_config_get(config, cat, janus_config_type_item, "fir_freq");
+			janus_config_item *plithrottle = janus_config_get(config, cat, janus_config_type_item, "pli_throttle");
+			janus_config_item *cachekf = janus_config_get(config, cat, janus_config_type_item, "cache_keyframes");
+			janus_config_item *bitratequota = janus_config_get(config, cat, janus_config_type_item, "bitrate_quota");
+			janus_config_item *ppsquota = janus_config_get(config, cat, janus_config_type_item, "pps_quota");
 			janus_config_item *audiocodec = janus_config_get(config, cat, janus_config_type_item, "audiocodec");
 			janus_config_item *videocodec = janus_config_get(config, cat, janus_config_type_item, "videocodec");
 			janus_config_item *vp9profile = janus_config_get(config, cat, janus_config_type_item, "vp9_profile");
@@ -3451,6 +3847,7 @@ int janus_videoroom_init(janus_callbacks *callback, const char *config_path) {
 			janus_config_item *dummy_str = janus_config_get(config, cat, janus_config_type_array, "dummy_streams");
 			janus_config_item *record = janus_config_get(config, cat, janus_config_type_item, "record");
 			janus_config_item *rec_dir = janus_config_get(config, cat, janus_config_type_item, "rec_dir");
+			janus_config_item *rec_shared = janus_config_get(config, cat, janus_config_type_item, "rec_shared");
 			janus_config_item *lock_record = janus_config_get(config, cat, janus_config_type_item, "lock_record");
 			janus_config_item *threads = janus_config_get(config, cat, janus_config_type_item, "threads");
 			/* Create the video room */
@@ -3524,6 +3921,17 @@ int janus_videoroom_init(janus_callbacks *callback, const char *config_path) {
 			videoroom->fir_freq = 0;
 			if(firfreq != NULL && firfreq->value != NULL)
 				videoroom->fir_freq = atol(firfreq->value);
+			videoroom->pli_throttle = 0;
+			if(plithrottle != NULL && plithrottle->value != NULL)
+				videoroom->pli_throttle = atol(plithrottle->value);
+			videoroom->cache_keyframes = cachekf && cachekf->value && janus_is_true(cachekf->value);
+			videoroom->bitrate_quota = 0;
+			if(bitratequota != NULL && bitratequota->value != NULL)
+				videoroom->bitrate_quota = g_ascii_strtoull(bitratequota->value, NULL, 0);
+			videoroom->pps_quota = 0;
+			if(ppsquota != NULL && ppsquota->value != NULL)
+				videoroom->pps_quota = atol(ppsquota->value);
+			videoroom->quota_started = janus_get_monotonic_time();
 			/* By default, we force Opus as the only audio codec */
 			videoroom->acodec[0] = JANUS_AUDIOCODEC_OPUS;
 			videoroom->acodec[1] = JANUS_AUDIOCODEC_NONE;
@@ -3650,9 +4058,21 @@ int janus_videoroom_init(janus_callbacks *callback, const char *config_path) {
 			if(rec_dir && rec_dir->value) {
 				videoroom->rec_dir = g_strdup(rec_dir->value);
 			}
+			if(rec_shared && rec_shared->value) {
+				videoroom->rec_shared = janus_is_true(rec_shared->value);
+			}
 			if(lock_record && lock_record->value) {
 				videoroom->lock_record = janus_is_true(lock_record->value);
 			}
+			if(videoroom->record && videoroom->rec_shared) {
+				/* This room muxes all recordings in a single shared file, create it right away */
+				char mfname[255];
+				g_snprintf(mfname, sizeof(mfname), "videoroom-%s-%"SCNi64".mjrs",
+					videoroom->room_id_str, janus_get_real_time());
+				videoroom->rec_sink = janus_recorder_sink_create(videoroom->rec_dir, mfname);
+				if(videoroom->rec_sink == NULL)
+					JANUS_LOG(LOG_ERR, "Couldn't create shared recording file for room %s...\n", videoroom->room_id_str);
+			}
 			/* By default, the VideoRoom plugin does not notify about participants simply joining the room.
 				It only notifies when the participant actually starts publishing media. */
 			videoroom->notify_joining = FALSE;
@@ -3664,6 +4084,9 @@ int janus_videoroom_init(janus_callbacks *callback, const char *config_path) {
 			videoroom->participants = g_hash_table_new_full(string_ids ? g_str_hash : g_int64_hash, string_ids ? g_str_equal : g_int64_equal,
 				(GDestroyNotify)g_free, (GDestroyNotify)janus_videoroom_publisher_dereference);
 			videoroom->private_ids = g_hash_table_new(NULL, NULL);
+			videoroom->offer_templates = g_hash_table_new_full(g_str_hash, g_str_equal,
+				(GDestroyNotify)g_free, (GDestroyNotify)g_free);
+			janus_mutex_init(&videoroom->templates_mutex);
 			videoroom->check_allowed = FALSE;	/* Static rooms can't have an "allowed" list yet, no hooks to the configuration file */
 			videoroom->allowed = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, NULL);
 			/* Should we create a dummy participant for placeholder m-lines? */
@@ -3829,6 +4252,23 @@ void janus_videoroom_destroy(void) {
 		handler_thread = NULL;
 	}
 
+#ifdef __linux__
+	/* Get rid of the shared ingest engine, if we started it: the shard
+	 * threads take care of any remote publisher they were still serving */
+	if(ingest_shards != NULL) {
+		int i = 0;
+		for(i=0; i<ingest_shards_num; i++) {
+			if(ingest_shards[i].thread != NULL)
+				g_thread_join(ingest_shards[i].thread);
+			if(ingest_shards[i].epollfd > -1)
+				close(ingest_shards[i].epollfd);
+		}
+		g_free(ingest_shards);
+		ingest_shards = NULL;
+		ingest_shards_num = 0;
+	}
+#endif
+
 	/* FIXME We should destroy the sessions cleanly */
 	janus_mutex_lock(&sessions_mutex);
 	g_hash_table_destroy(sessions);
@@ -3948,19 +4388,61 @@ static janus_videoroom_subscriber *janus_videoroom_session_get_subscriber_nodebu
 
 static void janus_videoroom_notify_participants(janus_videoroom_publisher *participant, json_t *msg, gboolean notify_source_participant) {
 	/* participant->room->mutex has to be locked. */
-	if(participant->room == NULL)
+	janus_videoroom *room = participant->room;
+	if(room == NULL || g_atomic_int_get(&room->destroyed))
 		return;
+	/* Take a snapshot of the sessions to notify, so that we can push the
+	 * event without holding the mutex: in large rooms, keeping it locked
+	 * for the whole broadcast delays operations queued behind it */
+	GSList *sessions = NULL;
 	GHashTableIter iter;
 	gpointer value;
-	g_hash_table_iter_init(&iter, participant->room->participants);
-	while (participant->room && !g_atomic_int_get(&participant->room->destroyed) && g_hash_table_iter_next(&iter, NULL, &value)) {
+	g_hash_table_iter_init(&iter, room->participants);
+	while(g_hash_table_iter_next(&iter, NULL, &value)) {
 		janus_videoroom_publisher *p = value;
 		if(p && !g_atomic_int_get(&p->destroyed) && p->session && (p != participant || notify_source_participant)) {
 			JANUS_LOG(LOG_VERB, "Notifying participant %s (%s)\n", p->user_id_str, p->display ? p->display : "??");
-			int ret = gateway->push_event(p->session->handle, &janus_videoroom_plugin, NULL, msg, NULL);
-			JANUS_LOG(LOG_VERB, "  >> %d (%s)\n", ret, janus_get_api_error(ret));
+			janus_refcount_increase(&p->session->ref);
+			sessions = g_slist_prepend(sessions, p->session);
 		}
 	}
+	/* Release the mutex and do the actual broadcast */
+	janus_refcount_increase(&room->ref);
+	janus_mutex_unlock(&room->mutex);
+	GSList *temp = sessions;
+	while(temp) {
+		janus_videoroom_session *session = (janus_videoroom_session *)temp->data;
+		int ret = gateway->push_event(session->handle, &janus_videoroom_plugin, NULL, msg, NULL);
+		JANUS_LOG(LOG_VERB, "  >> %d (%s)\n", ret, janus_get_api_error(ret));
+		janus_refcount_decrease(&session->ref);
+		temp = temp->next;
+	}
+	g_slist_free(sessions);
+	/* Done, the caller expects the mutex to still be locked */
+	janus_mutex_lock(&room->mutex);
+	janus_refcount_decrease(&room->ref);
+}
+
+static void janus_videoroom_participant_changed(janus_videoroom_publisher *p) {
+	/* The room mutex has to be locked: every change gets a new value of
+	 * the room counter, so that the updated property can be used both to
+	 * order participants and as a cursor in listparticipants requests */
+	janus_videoroom *room = p->room;
+	if(room == NULL)
+		return;
+	room->changes++;
+	p->updated = room->changes;
+}
+
+/* Helper to sort participants by when they last changed */
+static gint janus_videoroom_participant_updated_compare(gconstpointer a, gconstpointer b) {
+	const janus_videoroom_publisher *p1 = (const janus_videoroom_publisher *)a;
+	const janus_videoroom_publisher *p2 = (const janus_videoroom_publisher *)b;
+	if(p1->updated < p2->updated)
+		return -1;
+	else if(p1->updated > p2->updated)
+		return 1;
+	return 0;
 }
 
 static void janus_videoroom_notify_about_publisher(janus_videoroom_publisher *p, gboolean update) {
@@ -4034,6 +4516,7 @@ static void janus_videoroom_notify_about_publisher(janus_videoroom_publisher *p,
  	if(room && !g_atomic_int_get(&room->destroyed)) {
  		janus_refcount_increase(&room->ref);
  		janus_mutex_lock(&room->mutex);
+		janus_videoroom_participant_changed(p);
 		janus_videoroom_notify_participants(p, pub, FALSE);
 		janus_mutex_unlock(&room->mutex);
  		janus_refcount_decrease(&room->ref);
@@ -4138,6 +4621,8 @@ static void janus_videoroom_leave_or_unpublish(janus_videoroom_publisher *partic
 		gateway->notify_event(&janus_videoroom_plugin, NULL, info);
 	}
 	if(is_leaving) {
+		/* Leaving is a change too: pollers will notice the version bump */
+		room->changes++;
 		g_hash_table_remove(participant->room->participants,
 			string_ids ? (gpointer)participant->user_id_str : (gpointer)&participant->user_id);
 		g_hash_table_remove(participant->room->private_ids, GUINT_TO_POINTER(participant->pvt_id));
@@ -4328,6 +4813,76 @@ json_t *janus_videoroom_query_session(janus_plugin_session *handle) {
 	return info;
 }
 
+json_t *janus_videoroom_query_state(void) {
+	if(g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized))
+		return NULL;
+	/* Describe all existing rooms (private ones too), with the properties
+	 * needed to re-create them on a standby instance: unlike "list", this
+	 * includes credentials, since a replica wouldn't be faithful without */
+	json_t *list = json_array();
+	janus_mutex_lock(&rooms_mutex);
+	GHashTableIter iter;
+	gpointer value;
+	g_hash_table_iter_init(&iter, rooms);
+	while(g_hash_table_iter_next(&iter, NULL, &value)) {
+		janus_videoroom *room = value;
+		if(!room || g_atomic_int_get(&room->destroyed))
+			continue;
+		janus_refcount_increase(&room->ref);
+		json_t *rl = json_object();
+		json_object_set_new(rl, "room", string_ids ? json_string(room->room_id_str) : json_integer(room->room_id));
+		json_object_set_new(rl, "description", json_string(room->room_name));
+		if(room->room_secret)
+			json_object_set_new(rl, "secret", json_string(room->room_secret));
+		if(room->room_pin)
+			json_object_set_new(rl, "pin", json_string(room->room_pin));
+		json_object_set_new(rl, "is_private", room->is_private ? json_true() : json_false());
+		json_object_set_new(rl, "require_pvtid", room->require_pvtid ? json_true() : json_false());
+		json_object_set_new(rl, "signed_tokens", room->signed_tokens ? json_true() : json_false());
+		json_object_set_new(rl, "require_e2ee", room->require_e2ee ? json_true() : json_false());
+		json_object_set_new(rl, "dummy_publisher", room->dummy_publisher ? json_true() : json_false());
+		json_object_set_new(rl, "publishers", json_integer(room->max_publishers));
+		json_object_set_new(rl, "bitrate", json_integer(room->bitrate));
+		if(room->bitrate_cap)
+			json_object_set_new(rl, "bitrate_cap", json_true());
+		json_object_set_new(rl, "fir_freq", json_integer(room->fir_freq));
+		json_object_set_new(rl, "pli_throttle", json_integer(room->pli_throttle));
+		char audio_codecs[100];
+		char video_codecs[100];
+		janus_videoroom_codecstr(room, audio_codecs, video_codecs, sizeof(audio_codecs), ",");
+		json_object_set_new(rl, "audiocodec", json_string(audio_codecs));
+		json_object_set_new(rl, "videocodec", json_string(video_codecs));
+		if(room->vp9_profile)
+			json_object_set_new(rl, "vp9_profile", json_string(room->vp9_profile));
+		if(room->h264_profile)
+			json_object_set_new(rl, "h264_profile", json_string(room->h264_profile));
+		if(room->do_opusfec)
+			json_object_set_new(rl, "opus_fec", json_true());
+		if(room->do_opusdtx)
+			json_object_set_new(rl, "opus_dtx", json_true());
+		json_object_set_new(rl, "audiolevel_ext", room->audiolevel_ext ? json_true() : json_false());
+		json_object_set_new(rl, "audiolevel_event", room->audiolevel_event ? json_true() : json_false());
+		if(room->audiolevel_event) {
+			json_object_set_new(rl, "audio_active_packets", json_integer(room->audio_active_packets));
+			json_object_set_new(rl, "audio_level_average", json_integer(room->audio_level_average));
+		}
+		json_object_set_new(rl, "videoorient_ext", room->videoorient_ext ? json_true() : json_false());
+		json_object_set_new(rl, "playoutdelay_ext", room->playoutdelay_ext ? json_true() : json_false());
+		json_object_set_new(rl, "transport_wide_cc_ext", room->transport_wide_cc_ext ? json_true() : json_false());
+		json_object_set_new(rl, "record", room->record ? json_true() : json_false());
+		if(room->rec_dir)
+			json_object_set_new(rl, "rec_dir", json_string(room->rec_dir));
+		json_object_set_new(rl, "lock_record", room->lock_record ? json_true() : json_false());
+		json_object_set_new(rl, "notify_joining", room->notify_joining ? json_true() : json_false());
+		json_array_append_new(list, rl);
+		janus_refcount_decrease(&room->ref);
+	}
+	janus_mutex_unlock(&rooms_mutex);
+	json_t *state = json_object();
+	json_object_set_new(state, "rooms", list);
+	return state;
+}
+
 static int janus_videoroom_access_room(json_t *root, gboolean check_modify, gboolean check_join, janus_videoroom **videoroom, char *error_cause, int error_cause_size) {
 	/* rooms_mutex has to be locked */
 	int error_code = 0;
@@ -4445,6 +5000,10 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 		json_t *bitrate = json_object_get(root, "bitrate");
 		json_t *bitrate_cap = json_object_get(root, "bitrate_cap");
 		json_t *fir_freq = json_object_get(root, "fir_freq");
+		json_t *pli_throttle = json_object_get(root, "pli_throttle");
+		json_t *cache_keyframes = json_object_get(root, "cache_keyframes");
+		json_t *bitrate_quota = json_object_get(root, "bitrate_quota");
+		json_t *pps_quota = json_object_get(root, "pps_quota");
 		json_t *publishers = json_object_get(root, "publishers");
 		json_t *allowed = json_object_get(root, "allowed");
 		json_t *audiocodec = json_object_get(root, "audiocodec");
@@ -4507,6 +5066,7 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 		json_t *notify_joining = json_object_get(root, "notify_joining");
 		json_t *record = json_object_get(root, "record");
 		json_t *rec_dir = json_object_get(root, "rec_dir");
+		json_t *rec_shared = json_object_get(root, "rec_shared");
 		json_t *lock_record = json_object_get(root, "lock_record");
 		json_t *permanent = json_object_get(root, "permanent");
 		if(allowed) {
@@ -4626,6 +5186,17 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 		videoroom->fir_freq = 0;
 		if(fir_freq)
 			videoroom->fir_freq = json_integer_value(fir_freq);
+		videoroom->pli_throttle = 0;
+		if(pli_throttle)
+			videoroom->pli_throttle = json_integer_value(pli_throttle);
+		videoroom->cache_keyframes = cache_keyframes ? json_is_true(cache_keyframes) : FALSE;
+		videoroom->bitrate_quota = 0;
+		if(bitrate_quota)
+			videoroom->bitrate_quota = json_integer_value(bitrate_quota);
+		videoroom->pps_quota = 0;
+		if(pps_quota)
+			videoroom->pps_quota = json_integer_value(pps_quota);
+		videoroom->quota_started = janus_get_monotonic_time();
 		/* If we need helper threads, spawn them now */
 		videoroom->helper_threads = json_integer_value(threads);;
 		if(videoroom->helper_threads > 0) {
@@ -4774,15 +5345,30 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 		if(rec_dir) {
 			videoroom->rec_dir = g_strdup(json_string_value(rec_dir));
 		}
+		if(rec_shared) {
+			videoroom->rec_shared = json_is_true(rec_shared);
+		}
 		if(lock_record) {
 			videoroom->lock_record = json_is_true(lock_record);
 		}
+		if(videoroom->record && videoroom->rec_shared) {
+			/* This room muxes all recordings in a single shared file, create it right away */
+			char mfname[255];
+			g_snprintf(mfname, sizeof(mfname), "videoroom-%s-%"SCNi64".mjrs",
+				videoroom->room_id_str, janus_get_real_time());
+			videoroom->rec_sink = janus_recorder_sink_create(videoroom->rec_dir, mfname);
+			if(videoroom->rec_sink == NULL)
+				JANUS_LOG(LOG_ERR, "Couldn't create shared recording file for room %s...\n", videoroom->room_id_str);
+		}
 		g_atomic_int_set(&videoroom->destroyed, 0);
 		janus_mutex_init(&videoroom->mutex);
 		janus_refcount_init(&videoroom->ref, janus_videoroom_room_free);
 		videoroom->participants = g_hash_table_new_full(string_ids ? g_str_hash : g_int64_hash, string_ids ? g_str_equal : g_int64_equal,
 			(GDestroyNotify)g_free, (GDestroyNotify)janus_videoroom_publisher_dereference);
 		videoroom->private_ids = g_hash_table_new(NULL, NULL);
+		videoroom->offer_templates = g_hash_table_new_full(g_str_hash, g_str_equal,
+			(GDestroyNotify)g_free, (GDestroyNotify)g_free);
+		janus_mutex_init(&videoroom->templates_mutex);
 		videoroom->allowed = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, NULL);
 		if(allowed != NULL) {
 			/* Populate the "allowed" list as an ACL for people trying to join */
@@ -4879,6 +5465,20 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 				g_snprintf(value, BUFSIZ, "%"SCNu16, videoroom->fir_freq);
 				janus_config_add(config, c, janus_config_item_create("fir_freq", value));
 			}
+			if(videoroom->pli_throttle) {
+				g_snprintf(value, BUFSIZ, "%"SCNu16, videoroom->pli_throttle);
+				janus_config_add(config, c, janus_config_item_create("pli_throttle", value));
+			}
+			if(videoroom->cache_keyframes)
+				janus_config_add(config, c, janus_config_item_create("cache_keyframes", "yes"));
+			if(videoroom->bitrate_quota) {
+				g_snprintf(value, BUFSIZ, "%"SCNu64, videoroom->bitrate_quota);
+				janus_config_add(config, c, janus_config_item_create("bitrate_quota", value));
+			}
+			if(videoroom->pps_quota) {
+				g_snprintf(value, BUFSIZ, "%"SCNu32, videoroom->pps_quota);
+				janus_config_add(config, c, janus_config_item_create("pps_quota", value));
+			}
 			char video_codecs[100];
 			char audio_codecs[100];
 			janus_videoroom_codecstr(videoroom, audio_codecs, video_codecs, sizeof(audio_codecs), ",");
@@ -4920,6 +5520,8 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 				janus_config_add(config, c, janus_config_item_create("record", "yes"));
 			if(videoroom->rec_dir)
 				janus_config_add(config, c, janus_config_item_create("rec_dir", videoroom->rec_dir));
+			if(videoroom->rec_shared)
+				janus_config_add(config, c, janus_config_item_create("rec_shared", "yes"));
 			if(videoroom->lock_record)
 				janus_config_add(config, c, janus_config_item_create("lock_record", "yes"));
 			if(videoroom->helper_threads > 0) {
@@ -4985,6 +5587,9 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 		json_t *pin = json_object_get(root, "new_pin");
 		json_t *bitrate = json_object_get(root, "new_bitrate");
 		json_t *fir_freq = json_object_get(root, "new_fir_freq");
+		json_t *pli_throttle = json_object_get(root, "new_pli_throttle");
+		json_t *bitrate_quota = json_object_get(root, "new_bitrate_quota");
+		json_t *pps_quota = json_object_get(root, "new_pps_quota");
 		json_t *publishers = json_object_get(root, "new_publishers");
 		json_t *lock_record = json_object_get(root, "new_lock_record");
 		json_t *rec_dir = json_object_get(root, "new_rec_dir");
@@ -5023,6 +5628,12 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 		}
 		if(fir_freq)
 			videoroom->fir_freq = json_integer_value(fir_freq);
+		if(pli_throttle)
+			videoroom->pli_throttle = json_integer_value(pli_throttle);
+		if(bitrate_quota)
+			videoroom->bitrate_quota = json_integer_value(bitrate_quota);
+		if(pps_quota)
+			videoroom->pps_quota = json_integer_value(pps_quota);
 		if(secret && strlen(json_string_value(secret)) > 0) {
 			char *old_secret = videoroom->room_secret;
 			char *new_secret = g_strdup(json_string_value(secret));
@@ -5076,6 +5687,20 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 				g_snprintf(value, BUFSIZ, "%"SCNu16, videoroom->fir_freq);
 				janus_config_add(config, c, janus_config_item_create("fir_freq", value));
 			}
+			if(videoroom->pli_throttle) {
+				g_snprintf(value, BUFSIZ, "%"SCNu16, videoroom->pli_throttle);
+				janus_config_add(config, c, janus_config_item_create("pli_throttle", value));
+			}
+			if(videoroom->cache_keyframes)
+				janus_config_add(config, c, janus_config_item_create("cache_keyframes", "yes"));
+			if(videoroom->bitrate_quota) {
+				g_snprintf(value, BUFSIZ, "%"SCNu64, videoroom->bitrate_quota);
+				janus_config_add(config, c, janus_config_item_create("bitrate_quota", value));
+			}
+			if(videoroom->pps_quota) {
+				g_snprintf(value, BUFSIZ, "%"SCNu32, videoroom->pps_quota);
+				janus_config_add(config, c, janus_config_item_create("pps_quota", value));
+			}
 			char audio_codecs[100];
 			char video_codecs[100];
 			janus_videoroom_codecstr(videoroom, audio_codecs, video_codecs, sizeof(audio_codecs), ",");
@@ -5117,6 +5742,8 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 				janus_config_add(config, c, janus_config_item_create("record", "yes"));
 			if(videoroom->rec_dir)
 				janus_config_add(config, c, janus_config_item_create("rec_dir", videoroom->rec_dir));
+			if(videoroom->rec_shared)
+				janus_config_add(config, c, janus_config_item_create("rec_shared", "yes"));
 			if(videoroom->lock_record)
 				janus_config_add(config, c, janus_config_item_create("lock_record", "yes"));
 			if(videoroom->helper_threads > 0) {
@@ -5405,7 +6032,10 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 		memset(&hints, 0, sizeof(hints));
 		if(family != 0)
 			hints.ai_family = family;
-		if(getaddrinfo(host, NULL, family != 0 ? &hints : NULL, &res) == 0) {
+		if(host != NULL && strstr(host, "pipe:") == host) {
+			/* This is a local pipe, not an address: nothing to resolve */
+			resolved_host = host;
+		} else if(getaddrinfo(host, NULL, family != 0 ? &hints : NULL, &res) == 0) {
 			start = res;
 			while(res != NULL) {
 				if(janus_network_address_from_sockaddr(res->ai_addr, &addr) == 0 &&
@@ -5476,7 +6106,10 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 						hints.ai_family = s_family;
 					start = NULL;
 					res = NULL;
-					if(getaddrinfo(s_host, NULL, s_family != 0 ? &hints : NULL, &res) == 0) {
+					if(strstr(s_host, "pipe:") == s_host) {
+						/* This is a local pipe, not an address: nothing to resolve */
+						resolved_host = s_host;
+					} else if(getaddrinfo(s_host, NULL, s_family != 0 ? &hints : NULL, &res) == 0) {
 						start = res;
 						while(res != NULL) {
 							if(janus_network_address_from_sockaddr(res->ai_addr, &addr) == 0 &&
@@ -6545,14 +7178,47 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 		}
 		janus_refcount_increase(&videoroom->ref);
 		janus_mutex_unlock(&rooms_mutex);
-		/* Return a list of all participants (whether they're publishing or not) */
+		JANUS_VALIDATE_JSON_OBJECT(root, listparticipants_parameters,
+			error_code, error_cause, TRUE,
+			JANUS_VIDEOROOM_ERROR_MISSING_ELEMENT, JANUS_VIDEOROOM_ERROR_INVALID_ELEMENT);
+		if(error_code != 0) {
+			janus_refcount_decrease(&videoroom->ref);
+			goto prepare_response;
+		}
+		/* Return a list of all participants (whether they're publishing or not):
+		 * a cursor can be used to only get the participants that changed after
+		 * a specific version of the room, and to paginate large rooms */
+		guint64 cursor = json_integer_value(json_object_get(root, "cursor"));
+		size_t count = json_integer_value(json_object_get(root, "count"));
 		json_t *list = json_array();
 		GHashTableIter iter;
 		gpointer value;
+		GList *matches = NULL, *mtemp = NULL;
+		gboolean has_more = FALSE;
+		guint64 next_cursor = 0;
 		janus_mutex_lock(&videoroom->mutex);
+		guint64 version = videoroom->changes;
 		g_hash_table_iter_init(&iter, videoroom->participants);
 		while (!g_atomic_int_get(&videoroom->destroyed) && g_hash_table_iter_next(&iter, NULL, &value)) {
 			janus_videoroom_publisher *p = value;
+			if(cursor > 0 && p->updated <= cursor) {
+				/* This participant didn't change since the provided cursor */
+				continue;
+			}
+			matches = g_list_prepend(matches, p);
+		}
+		if(cursor > 0 || count > 0) {
+			/* Return participants in the order they last changed, so that
+			 * the updated property of the last one can be used as a cursor */
+			matches = g_list_sort(matches, janus_videoroom_participant_updated_compare);
+		}
+		mtemp = matches;
+		while(mtemp) {
+			janus_videoroom_publisher *p = (janus_videoroom_publisher *)mtemp->data;
+			if(count > 0 && json_array_size(list) >= count) {
+				has_more = TRUE;
+				break;
+			}
 			json_t *pl = json_object();
 			json_object_set_new(pl, "id", string_ids ? json_string(p->user_id_str) : json_integer(p->user_id));
 			if(p->display)
@@ -6579,13 +7245,19 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 					json_object_set_new(pl, "talking", talking ? json_true() : json_false());
 			}
 			json_array_append_new(list, pl);
+			next_cursor = p->updated;
+			mtemp = mtemp->next;
 		}
+		g_list_free(matches);
 		janus_mutex_unlock(&videoroom->mutex);
 		janus_refcount_decrease(&videoroom->ref);
 		response = json_object();
 		json_object_set_new(response, "videoroom", json_string("participants"));
 		json_object_set_new(response, "room", string_ids ? json_string(room_id_str) : json_integer(room_id));
 		json_object_set_new(response, "participants", list);
+		json_object_set_new(response, "version", json_integer(version));
+		if(has_more)
+			json_object_set_new(response, "next_cursor", json_integer(next_cursor));
 		goto prepare_response;
 	} else if(!strcasecmp(request_text, "listforwarders")) {
 		/* List all forwarders in a room */
@@ -6699,9 +7371,25 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 		janus_mutex_lock(&videoroom->mutex);
 		/* Set recording status */
 		gboolean room_new_recording_active = recording_active;
+		janus_recorder_sink *old_sink = NULL;
 		if (room_new_recording_active != videoroom->record) {
 			/* Room recording state has changed */
 			videoroom->record = room_new_recording_active;
+			if(videoroom->rec_shared) {
+				/* This room muxes all recordings in a single shared file */
+				if(recording_active && videoroom->rec_sink == NULL) {
+					char fname[255];
+					g_snprintf(fname, sizeof(fname), "videoroom-%s-%"SCNi64".mjrs",
+						videoroom->room_id_str, janus_get_real_time());
+					videoroom->rec_sink = janus_recorder_sink_create(videoroom->rec_dir, fname);
+					if(videoroom->rec_sink == NULL)
+						JANUS_LOG(LOG_ERR, "Couldn't create shared recording file for room %s...\n", videoroom->room_id_str);
+				} else if(!recording_active && videoroom->rec_sink != NULL) {
+					/* Get rid of the sink when we're done closing the recorders */
+					old_sink = videoroom->rec_sink;
+					videoroom->rec_sink = NULL;
+				}
+			}
 			/* Iterate over all participants */
 			gpointer value;
 			GHashTableIter iter;
@@ -6739,6 +7427,8 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 			}
 		}
 		janus_mutex_unlock(&videoroom->mutex);
+		if(old_sink != NULL)
+			janus_recorder_sink_destroy(old_sink);
 		janus_refcount_decrease(&videoroom->ref);
 		response = json_object();
 		json_object_set_new(response, "videoroom", json_string("success"));
@@ -7323,8 +8013,8 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 		const char *iface = json_string_value(json_object_get(root, "iface"));
 		janus_network_address miface;
 		if(iface) {
-			struct ifaddrs *ifas = NULL;
-			if(getifaddrs(&ifas) == -1) {
+			const struct ifaddrs *ifas = janus_network_acquire_ifaddrs();
+			if(ifas == NULL) {
 				JANUS_LOG(LOG_ERR, "Unable to acquire list of network devices/interfaces; remote publishers may not work as expected... %d (%s)\n",
 					errno, g_strerror(errno));
 			}
@@ -7332,7 +8022,7 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 				if(user_id_allocated)
 					g_free(user_id_str);
 				if(ifas)
-					freeifaddrs(ifas);
+					janus_network_release_ifaddrs(ifas);
 				janus_mutex_unlock(&videoroom->mutex);
 				janus_refcount_decrease(&videoroom->ref);
 				JANUS_LOG(LOG_ERR, "Invalid network interface configuration for remote publisher...\n");
@@ -7341,7 +8031,7 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 				goto prepare_response;
 			}
 			if(ifas)
-				freeifaddrs(ifas);
+				janus_network_release_ifaddrs(ifas);
 		} else {
 			janus_network_address_nullify(&miface);
 		}
@@ -7518,6 +8208,7 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 			janus_refcount_increase(&ps->ref);	/* This is for the id-indexed hashtable */
 			janus_refcount_increase(&ps->ref);	/* This is for the mid-indexed hashtable */
 			janus_mutex_init(&ps->subscribers_mutex);
+			janus_mutex_init(&ps->keyframe.mutex);
 			janus_mutex_init(&ps->rtp_forwarders_mutex);
 			ps->rtp_forwarders = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_rtp_forwarder_destroy);
 			publisher->streams = g_list_append(publisher->streams, ps);
@@ -7525,28 +8216,31 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 			g_hash_table_insert(publisher->streams_bymid, g_strdup(ps->mid), ps);
 			mindex++;
 		}
-		/* Done, spawn a thread for this remote publisher */
+		/* Done, spawn a thread for this remote publisher, unless the shared
+		 * ingest engine is enabled, in which case we just register the
+		 * publisher sockets on one of its shards instead */
 		janus_refcount_increase(&publisher->ref);
 		janus_refcount_increase(&publisher->session->ref);
-		GError *error = NULL;
-		char tname[16];
-		g_snprintf(tname, sizeof(tname), "vremote %s", publisher->user_id_str);
-		publisher->remote_thread = g_thread_try_new(tname, janus_videoroom_remote_publisher_thread, publisher, &error);
-		if(error != NULL) {
-			/* Something went wrong */
-			janus_mutex_unlock(&videoroom->mutex);
-			janus_refcount_decrease(&videoroom->ref);
-			janus_videoroom_publisher_destroy(publisher);
-			janus_refcount_decrease(&publisher->ref);
-			janus_refcount_decrease(&publisher->session->ref);
-			JANUS_LOG(LOG_ERR, "Could not spawn thread for remote publisher, %d (%s)\n",
-				errno, g_strerror(errno));
-			error_code = JANUS_VIDEOROOM_ERROR_UNKNOWN_ERROR;
-			g_snprintf(error_cause, 512, "Could not spawn thread for remote publisher");
-			goto prepare_response;
+		janus_mutex_unlock(&videoroom->mutex);
+		if(!janus_videoroom_ingest_register(publisher)) {
+			GError *error = NULL;
+			char tname[16];
+			g_snprintf(tname, sizeof(tname), "vremote %s", publisher->user_id_str);
+			publisher->remote_thread = g_thread_try_new(tname, janus_videoroom_remote_publisher_thread, publisher, &error);
+			if(error != NULL) {
+				/* Something went wrong */
+				janus_refcount_decrease(&videoroom->ref);
+				janus_videoroom_publisher_destroy(publisher);
+				janus_refcount_decrease(&publisher->ref);
+				janus_refcount_decrease(&publisher->session->ref);
+				JANUS_LOG(LOG_ERR, "Could not spawn thread for remote publisher, %d (%s)\n",
+					errno, g_strerror(errno));
+				error_code = JANUS_VIDEOROOM_ERROR_UNKNOWN_ERROR;
+				g_snprintf(error_cause, 512, "Could not spawn thread for remote publisher");
+				goto prepare_response;
+			}
 		}
 		/* Done */
-		janus_mutex_unlock(&videoroom->mutex);
 		janus_refcount_decrease(&videoroom->ref);
 		response = json_object();
 		json_object_set_new(response, "videoroom", json_string("success"));
@@ -7794,6 +8488,7 @@ static json_t *janus_videoroom_process_synchronous_request(janus_videoroom_sessi
 			janus_refcount_increase(&ps->ref);	/* This is for the id-indexed hashtable */
 			janus_refcount_increase(&ps->ref);	/* This is for the mid-indexed hashtable */
 			janus_mutex_init(&ps->subscribers_mutex);
+			janus_mutex_init(&ps->keyframe.mutex);
 			janus_mutex_init(&ps->rtp_forwarders_mutex);
 			ps->rtp_forwarders = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_rtp_forwarder_destroy);
 			publisher->streams = g_list_append(publisher->streams, ps);
@@ -8094,6 +8789,20 @@ void janus_videoroom_setup_media(janus_plugin_session *handle) {
 					janus_videoroom_subscriber_stream *ss = (janus_videoroom_subscriber_stream *)temp->data;
 					janus_videoroom_publisher_stream *ps = ss->publisher_streams ? ss->publisher_streams->data : NULL;
 					if(ps && ps->type == JANUS_VIDEOROOM_MEDIA_VIDEO && ps->publisher && ps->publisher->session) {
+						if(!ps->simulcast && !ps->svc) {
+							/* If we have a cached keyframe for this stream, send it to the
+							 * new subscriber right away, instead of asking the publisher */
+							janus_mutex_lock(&ps->keyframe.mutex);
+							if(ps->keyframe.latest_keyframe != NULL) {
+								JANUS_LOG(LOG_HUGE, "Sending cached keyframe for stream mindex %d\n", ps->mindex);
+								GList *kf = ps->keyframe.latest_keyframe;
+								while(kf) {
+									janus_videoroom_relay_rtp_packet(ss, kf->data);
+									kf = kf->next;
+								}
+							}
+							janus_mutex_unlock(&ps->keyframe.mutex);
+						}
 						janus_videoroom_reqpli(ps, "New subscriber available");
 					}
 					temp = temp->next;
@@ -8251,6 +8960,7 @@ static void janus_videoroom_incoming_rtp_internal(janus_videoroom_session *sessi
 		GHashTableIter iter;
 		gpointer value;
 		g_hash_table_iter_init(&iter, ps->rtp_forwarders);
+		janus_rtp_forwarder_batch_begin();
 		while(participant->udp_sock > 0 && g_hash_table_iter_next(&iter, NULL, &value)) {
 			janus_rtp_forwarder *rtp_forward = (janus_rtp_forwarder *)value;
 			if(rtp_forward->is_data || (video && !rtp_forward->is_video) || (!video && rtp_forward->is_video))
@@ -8258,6 +8968,7 @@ static void janus_videoroom_incoming_rtp_internal(janus_videoroom_session *sessi
 			janus_rtp_forwarder_send_rtp_full(rtp_forward, buf, len, sc,
 				ps->vssrc, ps->rid, ps->vcodec, &ps->rid_mutex);
 		}
+		janus_rtp_forwarder_batch_flush();
 		janus_mutex_unlock(&ps->rtp_forwarders_mutex);
 		/* Set the payload type of the publisher */
 		rtp->type = ps->pt;
@@ -8328,7 +9039,19 @@ static void janus_videoroom_incoming_rtp_internal(janus_videoroom_session *sessi
 		if(videoroom->helper_threads > 0) {
 			g_list_foreach(videoroom->threads, janus_videoroom_helper_rtpdata_packet, &packet);
 		} else {
+			if(!packet.svc && !packet.simulcast &&
+					ps->subscribers != NULL && ps->subscribers->next != NULL) {
+				/* More than one subscriber, and no per-viewer payload rewriting
+				 * involved: copy the packet to a refcounted buffer once, so that
+				 * the core can defer the per-recipient copies to the send loops
+				 * instead of doing them all here (only the RTP header, which we
+				 * rewrite and restore for each subscriber, is copied right away) */
+				packet.shared = janus_plugin_buffer_new(buf, len);
+				packet.data = (janus_rtp_header *)packet.shared->buffer;
+			}
 			g_slist_foreach(ps->subscribers, janus_videoroom_relay_rtp_packet, &packet);
+			if(packet.shared != NULL)
+				janus_plugin_buffer_unref(packet.shared);
 		}
 		janus_mutex_unlock_nodebug(&ps->subscribers_mutex);
 
@@ -8360,8 +9083,12 @@ static void janus_videoroom_incoming_rtp_internal(janus_videoroom_session *sessi
 				if(participant->remb_startup == 0)
 					participant->remb_latest = janus_get_monotonic_time();
 			}
+			/* If keyframe caching is enabled for the room, check if this is (part of) a keyframe we should save:
+			 * we can't do that for end-to-end encrypted publishers, since the payload is opaque to us */
+			if(video && videoroom->cache_keyframes && !ps->simulcast && !ps->svc && !participant->e2ee)
+				janus_videoroom_keyframe_cache_rtp(ps, buf, len);
 			/* Generate FIR/PLI too, if needed */
-			if(video && ps->active && !ps->muted && (videoroom->fir_freq > 0)) {
+			if(video && ps->active && !ps->muted && (videoroom->fir_freq > 0 || g_atomic_int_get(&ps->need_pli))) {
 				/* We generate RTCP every tot seconds/frames */
 				gint64 now = janus_get_monotonic_time();
 				/* First check if this is a keyframe, though: if so, we reset the timer */
@@ -8372,7 +9099,10 @@ static void janus_videoroom_incoming_rtp_internal(janus_videoroom_session *sessi
 					janus_refcount_decrease_nodebug(&videoroom->ref);
 					return;
 				}
-				if(ps->vcodec == JANUS_VIDEOCODEC_VP8) {
+				if(participant->e2ee) {
+					/* Media is end-to-end encrypted, don't waste cycles parsing the payload:
+					 * we can't detect keyframes anyway, so we just rely on the regular timer */
+				} else if(ps->vcodec == JANUS_VIDEOCODEC_VP8) {
 					if(janus_vp8_is_keyframe(payload, plen))
 						ps->fir_latest = now;
 				} else if(ps->vcodec == JANUS_VIDEOCODEC_VP9) {
@@ -8388,7 +9118,13 @@ static void janus_videoroom_incoming_rtp_internal(janus_videoroom_session *sessi
 					if(janus_h265_is_keyframe(payload, plen))
 						ps->fir_latest = now;
 				}
-				if((now-ps->fir_latest) >= ((gint64)videoroom->fir_freq*G_USEC_PER_SEC)) {
+				if(ps->fir_latest == now) {
+					/* This was a keyframe: a deferred keyframe request, if any, is satisfied */
+					g_atomic_int_set(&ps->need_pli, 0);
+				} else if(g_atomic_int_get(&ps->need_pli)) {
+					/* We throttled one or more keyframe requests for this stream, try delivering one now */
+					janus_videoroom_reqpli(ps, "Deferred keyframe request");
+				} else if(videoroom->fir_freq > 0 && (now-ps->fir_latest) >= ((gint64)videoroom->fir_freq*G_USEC_PER_SEC)) {
 					/* FIXME We send a FIR every tot seconds */
 					janus_videoroom_reqpli(ps, "Regular keyframe request");
 				}
@@ -8631,12 +9367,39 @@ void janus_videoroom_slow_link(janus_plugin_session *handle, int mindex, gboolea
 				janus_refcount_decrease(&session->ref);
 				return;
 			}
+			if(video && mindex != -1) {
+				/* If automatic layer adaptation is enabled on this stream, try
+				 * to step the simulcast substream (or SVC spatial layer) down */
+				janus_mutex_lock(&subscriber->streams_mutex);
+				janus_videoroom_subscriber_stream *stream = g_hash_table_lookup(subscriber->streams_byid, GINT_TO_POINTER(mindex));
+				if(stream != NULL && stream->autoadapt && stream->type == JANUS_VIDEOROOM_MEDIA_VIDEO) {
+					janus_videoroom_publisher_stream *ps = stream->publisher_streams ? stream->publisher_streams->data : NULL;
+					gint64 now = janus_get_monotonic_time();
+					if(ps != NULL && now - stream->adapted > 2*G_USEC_PER_SEC) {
+						if(ps->simulcast && stream->sim_context.substream_target > 0) {
+							stream->sim_context.substream_target--;
+							stream->adapted = now;
+							JANUS_LOG(LOG_VERB, "Slow link, stepping simulcast substream down to %d for subscriber (mid %s)\n",
+								stream->sim_context.substream_target, stream->mid);
+							janus_videoroom_reqpli(ps, "Automatic adaptation (down)");
+						} else if(ps->svc && stream->svc_context.spatial_target > 0) {
+							stream->svc_context.spatial_target--;
+							stream->adapted = now;
+							JANUS_LOG(LOG_VERB, "Slow link, stepping SVC spatial layer down to %d for subscriber (mid %s)\n",
+								stream->svc_context.spatial_target, stream->mid);
+							janus_videoroom_reqpli(ps, "Automatic adaptation (down)");
+						}
+					}
+				}
+				janus_mutex_unlock(&subscriber->streams_mutex);
+			}
 			/* Send an event on the handle to notify the application: it's
 			 * up to the application to then choose a policy and enforce it */
 			json_t *event = json_object();
 			json_object_set_new(event, "videoroom", json_string("slow_link"));
 			gateway->push_event(session->handle, &janus_videoroom_plugin, NULL, event, NULL);
 			json_decref(event);
+			janus_refcount_decrease(&subscriber->ref);
 		} else {
 			JANUS_LOG(LOG_WARN, "Got a slow downlink on a VideoRoom viewer? Weird, because it doesn't send media...\n");
 		}
@@ -8669,7 +9432,14 @@ static void janus_videoroom_recorder_create(janus_videoroom_publisher_stream *ps
 		ps->rec_simctx.substream_target = 2;
 		ps->rec_simctx.templayer_target = 2;
 		memset(filename, 0, 255);
-		if(participant->recording_base) {
+		if(participant->room->rec_sink != NULL) {
+			/* This room muxes all recordings in a single shared file */
+			rc = janus_recorder_create_muxed(participant->room->rec_sink, type, ps->fmtp);
+			if(rc == NULL) {
+				JANUS_LOG(LOG_ERR, "Couldn't enroll a %s recording in the shared file for this publisher!\n",
+					janus_videoroom_media_str(ps->type));
+			}
+		} else if(participant->recording_base) {
 			/* Use the filename and path we have been provided */
 			g_snprintf(filename, 255, "%s-%s-%d", participant->recording_base,
 				janus_videoroom_media_str(ps->type), ps->mindex);
@@ -9326,6 +10096,7 @@ static void *janus_videoroom_handler(void *data) {
 				g_hash_table_insert(publisher->room->participants,
 					string_ids ? (gpointer)g_strdup(publisher->user_id_str) : (gpointer)janus_uint64_dup(publisher->user_id),
 					publisher);
+				janus_videoroom_participant_changed(publisher);
 				g_hash_table_insert(publisher->room->private_ids, GUINT_TO_POINTER(publisher->pvt_id), publisher);
 				janus_mutex_unlock(&session->mutex);
 				g_hash_table_iter_init(&iter, publisher->room->participants);
@@ -9499,6 +10270,37 @@ static void *janus_videoroom_handler(void *data) {
 				/* The new way of subscribing is specifying the streams we're interested in */
 				json_t *feeds = json_object_get(root, "streams");
 				gboolean legacy = FALSE;
+				if(feeds == NULL || json_array_size(feeds) == 0) {
+					/* A "publishers" array of feed IDs can be passed as a bulk
+					 * shorthand to subscribe to all the streams of a set of
+					 * publishers with a single offer: we just expand it to an
+					 * equivalent "streams" array */
+					json_t *bulk = json_object_get(root, "publishers");
+					if(bulk != NULL && json_is_array(bulk) && json_array_size(bulk) > 0) {
+						json_t *m = json_array();
+						size_t i = 0;
+						for(i=0; i<json_array_size(bulk); i++) {
+							json_t *feed = json_array_get(bulk, i);
+							if((string_ids && !json_is_string(feed)) || (!string_ids && !json_is_integer(feed))) {
+								JANUS_LOG(LOG_ERR, "Invalid element (publishers entries should be %s)\n",
+									string_ids ? "strings" : "integers");
+								error_code = JANUS_VIDEOROOM_ERROR_INVALID_ELEMENT;
+								g_snprintf(error_cause, 512, "Invalid element (publishers entries should be %s)",
+									string_ids ? "strings" : "integers");
+								json_decref(m);
+								janus_mutex_unlock(&videoroom->mutex);
+								janus_mutex_unlock(&sessions_mutex);
+								janus_refcount_decrease(&videoroom->ref);
+								goto error;
+							}
+							json_t *s = json_object();
+							json_object_set(s, "feed", feed);
+							json_array_append_new(m, s);
+						}
+						json_object_set_new(root, "streams", m);
+						feeds = json_object_get(root, "streams");
+					}
+				}
 				if(feeds == NULL || json_array_size(feeds) == 0) {
 					/* For backwards compatibility, we still support the old "feed" property, which means
 					 * "subscribe to all the feeds from this publisher" (depending on offer_audio, etc.) */
@@ -9875,6 +10677,13 @@ static void *janus_videoroom_handler(void *data) {
 							if(temporal)
 								stream->svc_context.temporal_target = json_integer_value(temporal);
 						}
+						json_t *autoadapt = json_object_get(s, "autoadapt");
+						if(stream && ps->type == JANUS_VIDEOROOM_MEDIA_VIDEO && autoadapt) {
+							/* Enable or disable the automatic layer adaptation */
+							stream->autoadapt = json_is_true(autoadapt);
+							stream->adapt_target = ps->svc ?
+								stream->svc_context.spatial_target : stream->sim_context.substream_target;
+						}
 						if(stream && ps->type == JANUS_VIDEOROOM_MEDIA_VIDEO) {
 							/* Override the playout-delay properties */
 							if(min_delay) {
@@ -9960,6 +10769,13 @@ static void *janus_videoroom_handler(void *data) {
 								if(temporal)
 									stream->svc_context.temporal_target = json_integer_value(temporal);
 							}
+							json_t *autoadapt = json_object_get(s, "autoadapt");
+							if(stream && ps->type == JANUS_VIDEOROOM_MEDIA_VIDEO && autoadapt) {
+								/* Enable or disable the automatic layer adaptation */
+								stream->autoadapt = json_is_true(autoadapt);
+								stream->adapt_target = ps->svc ?
+									stream->svc_context.spatial_target : stream->sim_context.substream_target;
+							}
 							if(stream && ps->type == JANUS_VIDEOROOM_MEDIA_VIDEO) {
 								/* Override the playout-delay properties */
 								if(min_delay) {
@@ -10227,6 +11043,9 @@ static void *janus_videoroom_handler(void *data) {
 					json_t *max_delay = json_object_get(root, "max_delay");
 					if(max_delay != NULL)
 						json_object_set_new(stream, "max_delay", json_integer(json_integer_value(max_delay)));
+					json_t *autoadapt = json_object_get(root, "autoadapt");
+					if(autoadapt != NULL)
+						json_object_set_new(stream, "autoadapt", json_is_true(autoadapt) ? json_true() : json_false());
 					json_array_append_new(streams, stream);
 					json_object_set_new(root, "streams", streams);
 				}
@@ -10479,6 +11298,7 @@ static void *janus_videoroom_handler(void *data) {
 							json_string(participant->user_id_str) : json_integer(participant->user_id));
 						json_object_set_new(display_event, "display", json_string(participant->display));
 						if(participant->room && !g_atomic_int_get(&participant->room->destroyed)) {
+							janus_videoroom_participant_changed(participant);
 							janus_videoroom_notify_participants(participant, display_event, FALSE);
 						}
 						json_decref(display_event);
@@ -10601,6 +11421,41 @@ static void *janus_videoroom_handler(void *data) {
 					JANUS_LOG(LOG_VERB, "Removing subscriber streams\n");
 				if(subscribe)
 					JANUS_LOG(LOG_VERB, "Adding new subscriber streams\n");
+				if(subscribe && !update && json_object_get(root, "streams") == NULL) {
+					/* A "publishers" array of feed IDs can be passed as a bulk
+					 * shorthand to subscribe to all the streams of a set of
+					 * publishers in a single renegotiation: we expand it to an
+					 * equivalent "streams" array and let the usual code handle it */
+					json_t *bulk = json_object_get(root, "publishers");
+					if(bulk != NULL) {
+						if(!json_is_array(bulk) || json_array_size(bulk) == 0) {
+							JANUS_LOG(LOG_ERR, "Invalid element (publishers should be a non-empty array)\n");
+							error_code = JANUS_VIDEOROOM_ERROR_INVALID_ELEMENT;
+							g_snprintf(error_cause, 512, "Invalid element (publishers should be a non-empty array)");
+							janus_refcount_decrease(&subscriber->ref);
+							goto error;
+						}
+						json_t *streams = json_array();
+						size_t i = 0;
+						for(i=0; i<json_array_size(bulk); i++) {
+							json_t *feed = json_array_get(bulk, i);
+							if((string_ids && !json_is_string(feed)) || (!string_ids && !json_is_integer(feed))) {
+								JANUS_LOG(LOG_ERR, "Invalid element (publishers entries should be %s)\n",
+									string_ids ? "strings" : "integers");
+								error_code = JANUS_VIDEOROOM_ERROR_INVALID_ELEMENT;
+								g_snprintf(error_cause, 512, "Invalid element (publishers entries should be %s)",
+									string_ids ? "strings" : "integers");
+								json_decref(streams);
+								janus_refcount_decrease(&subscriber->ref);
+								goto error;
+							}
+							json_t *s = json_object();
+							json_object_set(s, "feed", feed);
+							json_array_append_new(streams, s);
+						}
+						json_object_set_new(root, "streams", streams);
+					}
+				}
 				/* Validate the request first */
 				if(update) {
 					JANUS_VALIDATE_JSON_OBJECT(root, subscriber_combined_update_parameters,
@@ -10964,6 +11819,13 @@ static void *janus_videoroom_handler(void *data) {
 									if(temporal)
 										stream->svc_context.temporal_target = json_integer_value(temporal);
 								}
+								json_t *autoadapt = json_object_get(s, "autoadapt");
+								if(ps->type == JANUS_VIDEOROOM_MEDIA_VIDEO && autoadapt) {
+									/* Enable or disable the automatic layer adaptation */
+									stream->autoadapt = json_is_true(autoadapt);
+									stream->adapt_target = ps->svc ?
+										stream->svc_context.spatial_target : stream->sim_context.substream_target;
+								}
 								if(ps->type == JANUS_VIDEOROOM_MEDIA_VIDEO) {
 									/* Override the playout-delay properties */
 									if(min_delay) {
@@ -11023,6 +11885,13 @@ static void *janus_videoroom_handler(void *data) {
 										if(temporal)
 											stream->svc_context.temporal_target = json_integer_value(temporal);
 									}
+									json_t *autoadapt = json_object_get(s, "autoadapt");
+									if(ps->type == JANUS_VIDEOROOM_MEDIA_VIDEO && autoadapt) {
+										/* Enable or disable the automatic layer adaptation */
+										stream->autoadapt = json_is_true(autoadapt);
+										stream->adapt_target = ps->svc ?
+											stream->svc_context.spatial_target : stream->sim_context.substream_target;
+									}
 									if(ps->type == JANUS_VIDEOROOM_MEDIA_VIDEO) {
 										/* Override the playout-delay properties */
 										if(min_delay) {
@@ -11203,6 +12072,9 @@ static void *janus_videoroom_handler(void *data) {
 					json_t *max_delay = json_object_get(root, "max_delay");
 					if(max_delay != NULL)
 						json_object_set_new(stream, "max_delay", json_integer(json_integer_value(max_delay)));
+					json_t *autoadapt = json_object_get(root, "autoadapt");
+					if(autoadapt != NULL)
+						json_object_set_new(stream, "autoadapt", json_is_true(autoadapt) ? json_true() : json_false());
 					json_array_append_new(streams, stream);
 					json_object_set_new(root, "streams", streams);
 				}
@@ -11275,6 +12147,7 @@ static void *janus_videoroom_handler(void *data) {
 					json_t *sc_fallback = json_object_get(s, "fallback");
 					json_t *min_delay = json_object_get(s, "min_delay");
 					json_t *max_delay = json_object_get(s, "max_delay");
+					json_t *autoadapt = json_object_get(s, "autoadapt");
 					GList *temp = subscriber->streams;
 					while(temp) {
 						/* We need more fine grained mechanisms for changing streaming properties */
@@ -11332,6 +12205,10 @@ static void *janus_videoroom_handler(void *data) {
 							int substream_target = sc_substream ? json_integer_value(sc_substream) : -1;
 							if(sc_substream && substream_target >= 0 && substream_target <= 2) {
 								stream->sim_context.substream_target = substream_target;
+								if(stream->autoadapt) {
+									/* This is the new target any automatic adaptation should aim for */
+									stream->adapt_target = substream_target;
+								}
 								JANUS_LOG(LOG_VERB, "Setting video SSRC to let through (simulcast): %"SCNu32" (index %d, was %d)\n",
 									ps->vssrc[stream->sim_context.substream_target],
 									stream->sim_context.substream_target,
@@ -11392,6 +12269,10 @@ static void *janus_videoroom_handler(void *data) {
 									janus_videoroom_reqpli(ps, "Need to downscale spatially");
 								}
 								stream->svc_context.spatial_target = spatial_layer;
+								if(stream->autoadapt) {
+									/* This is the new target any automatic adaptation should aim for */
+									stream->adapt_target = spatial_layer;
+								}
 							}
 							if(temporal) {
 								int temporal_layer = json_integer_value(temporal);
@@ -11413,6 +12294,12 @@ static void *janus_videoroom_handler(void *data) {
 							}
 						}
 						if(stream->type == JANUS_VIDEOROOM_MEDIA_VIDEO) {
+							if(autoadapt) {
+								/* Enable or disable the automatic layer adaptation */
+								stream->autoadapt = json_is_true(autoadapt);
+								stream->adapt_target = (ps && ps->svc) ?
+									stream->svc_context.spatial_target : stream->sim_context.substream_target;
+							}
 							if(min_delay) {
 								int16_t md = json_integer_value(min_delay);
 								if(md < 0) {
@@ -12198,6 +13085,7 @@ static void *janus_videoroom_handler(void *data) {
 						janus_refcount_init(&ps->ref, janus_videoroom_publisher_stream_free);
 						janus_refcount_increase(&ps->ref);	/* This is for the mid-indexed hashtable */
 						janus_mutex_init(&ps->subscribers_mutex);
+						janus_mutex_init(&ps->keyframe.mutex);
 						janus_mutex_init(&ps->rtp_forwarders_mutex);
 						janus_mutex_init(&ps->rid_mutex);
 						ps->rtp_forwarders = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_rtp_forwarder_destroy);
@@ -12668,6 +13556,175 @@ error:
 }
 
 /* Helper to quickly relay RTP packets from publishers to subscribers */
+/* Specialized relay paths: janus_videoroom_relay_rtp_packet picks one of these
+ * per subscriber stream the first time it relays from a publisher stream, and
+ * keeps using it until the source changes, so that the per-packet hot path is
+ * a single indirect call with no codec or simulcast/SVC branching; the VP8
+ * simulcast variant is generated from the same template as the generic one,
+ * letting the compiler inline the descriptor rewrite where it's needed */
+static void janus_videoroom_relay_svc_packet(janus_videoroom_subscriber_stream *stream,
+		janus_videoroom_publisher_stream *ps, janus_videoroom_rtp_relay_packet *packet) {
+	janus_videoroom_subscriber *subscriber = stream->subscriber;
+	janus_videoroom_session *session = subscriber->session;
+	/* Handle SVC: make sure we have a payload to work with */
+	int plen = 0;
+	char *payload = janus_rtp_payload((char *)packet->data, packet->length, &plen);
+	if(payload == NULL)
+		return;
+	/* Process this packet: don't relay if it's not the layer we wanted to handle */
+	char rtph[12];
+	memcpy(&rtph, packet->data, sizeof(rtph));
+	gboolean relay = janus_rtp_svc_context_process_rtp(&stream->svc_context,
+		(char *)packet->data, packet->length, packet->extensions.dd_content, packet->extensions.dd_len,
+		ps->vcodec, &packet->svc_info, &stream->context);
+	if(stream->svc_context.need_pli) {
+		/* Send a PLI */
+		JANUS_LOG(LOG_VERB, "We need a PLI for the SVC context\n");
+		janus_videoroom_reqpli(ps, "SVC change");
+	}
+	/* Do we need to drop this? */
+	if(!relay)
+		return;
+	/* Any event we should notify? */
+	if(stream->svc_context.changed_spatial) {
+		/* Notify the user about the spatial layer change */
+		json_t *event = json_object();
+		json_object_set_new(event, "videoroom", json_string("event"));
+		json_object_set_new(event, "room", string_ids ? json_string(subscriber->room_id_str) : json_integer(subscriber->room_id));
+		json_object_set_new(event, "mid", json_string(stream->mid));
+		json_object_set_new(event, "spatial_layer", json_integer(stream->svc_context.spatial));
+		gateway->push_event(subscriber->session->handle, &janus_videoroom_plugin, NULL, event, NULL);
+		json_decref(event);
+	}
+	if(stream->svc_context.changed_temporal) {
+		/* Notify the user about the temporal layer change */
+		json_t *event = json_object();
+		json_object_set_new(event, "videoroom", json_string("event"));
+		json_object_set_new(event, "room", string_ids ? json_string(subscriber->room_id_str) : json_integer(subscriber->room_id));
+		json_object_set_new(event, "mid", json_string(stream->mid));
+		json_object_set_new(event, "temporal_layer", json_integer(stream->svc_context.temporal));
+		gateway->push_event(subscriber->session->handle, &janus_videoroom_plugin, NULL, event, NULL);
+		json_decref(event);
+	}
+	/* If we got here, update the RTP header and send the packet */
+	janus_rtp_header_update(packet->data, &stream->context, TRUE, 0);
+	/* Send the packet */
+	if(gateway != NULL) {
+		janus_plugin_rtp rtp = { .mindex = stream->mindex, .video = packet->is_video, .buffer = (char *)packet->data, .length = packet->length,
+			.extensions = packet->extensions };
+		if(stream->min_delay > -1 && stream->max_delay > -1) {
+			rtp.extensions.min_delay = stream->min_delay;
+			rtp.extensions.max_delay = stream->max_delay;
+		}
+		gateway->relay_rtp(session->handle, &rtp);
+	}
+	/* Restore the timestamp and sequence number to what the publisher set them to */
+	memcpy(packet->data, &rtph, sizeof(rtph));
+}
+static inline void janus_videoroom_relay_simulcast_internal(janus_videoroom_subscriber_stream *stream,
+		janus_videoroom_publisher_stream *ps, janus_videoroom_rtp_relay_packet *packet, gboolean vp8) {
+	janus_videoroom_subscriber *subscriber = stream->subscriber;
+	janus_videoroom_session *session = subscriber->session;
+	/* Handle simulcast: make sure we have a payload to work with */
+	int plen = 0;
+	char *payload = janus_rtp_payload((char *)packet->data, packet->length, &plen);
+	if(payload == NULL)
+		return;
+	/* Process this packet: don't relay if it's not the SSRC/layer we wanted to handle */
+	gboolean relay = janus_rtp_simulcasting_context_process_rtp(&stream->sim_context,
+		(char *)packet->data, packet->length, packet->extensions.dd_content, packet->extensions.dd_len,
+		packet->ssrc, NULL, ps->vcodec, &stream->context, &ps->rid_mutex);
+	if(!relay) {
+		/* Did a lot of time pass before we could relay a packet? */
+		gint64 now = janus_get_monotonic_time();
+		if((now - stream->sim_context.last_relayed) >= G_USEC_PER_SEC) {
+			g_atomic_int_set(&stream->sim_context.need_pli, 1);
+		}
+	}
+	if(stream->sim_context.need_pli) {
+		/* Send a PLI */
+		JANUS_LOG(LOG_VERB, "We need a PLI for the simulcast context\n");
+		janus_videoroom_reqpli(ps, "Simulcast change");
+	}
+	/* Do we need to drop this? */
+	if(!relay)
+		return;
+	/* Any event we should notify? */
+	if(stream->sim_context.changed_substream) {
+		/* Notify the user about the substream change */
+		json_t *event = json_object();
+		json_object_set_new(event, "videoroom", json_string("event"));
+		json_object_set_new(event, "room", string_ids ? json_string(subscriber->room_id_str) : json_integer(subscriber->room_id));
+		json_object_set_new(event, "mid", json_string(stream->mid));
+		json_object_set_new(event, "substream", json_integer(stream->sim_context.substream));
+		gateway->push_event(subscriber->session->handle, &janus_videoroom_plugin, NULL, event, NULL);
+		json_decref(event);
+	}
+	if(stream->sim_context.changed_temporal) {
+		/* Notify the user about the temporal layer change */
+		json_t *event = json_object();
+		json_object_set_new(event, "videoroom", json_string("event"));
+		json_object_set_new(event, "room", string_ids ? json_string(subscriber->room_id_str) : json_integer(subscriber->room_id));
+		json_object_set_new(event, "mid", json_string(stream->mid));
+		json_object_set_new(event, "temporal", json_integer(stream->sim_context.templayer));
+		gateway->push_event(subscriber->session->handle, &janus_videoroom_plugin, NULL, event, NULL);
+		json_decref(event);
+	}
+	/* If we got here, update the RTP header and send the packet */
+	janus_rtp_header_update(packet->data, &stream->context, TRUE, 0);
+	char vp8pd[6];
+	if(vp8) {
+		/* For VP8, we save the original payload descriptor, to restore it after */
+		memcpy(vp8pd, payload, sizeof(vp8pd));
+		janus_vp8_simulcast_descriptor_update(payload, plen, &stream->vp8_context,
+			stream->sim_context.changed_substream);
+	}
+	/* Send the packet */
+	if(gateway != NULL) {
+		janus_plugin_rtp rtp = { .mindex = stream->mindex, .video = packet->is_video, .buffer = (char *)packet->data, .length = packet->length,
+			.extensions = packet->extensions };
+		if(stream->min_delay > -1 && stream->max_delay > -1) {
+			rtp.extensions.min_delay = stream->min_delay;
+			rtp.extensions.max_delay = stream->max_delay;
+		}
+		gateway->relay_rtp(session->handle, &rtp);
+	}
+	/* Restore the timestamp and sequence number to what the publisher set them to */
+	packet->data->timestamp = htonl(packet->timestamp);
+	packet->data->seq_number = htons(packet->seq_number);
+	if(vp8) {
+		/* Restore the original payload descriptor as well, as it will be needed by the next viewer */
+		memcpy(payload, vp8pd, sizeof(vp8pd));
+	}
+}
+static void janus_videoroom_relay_simulcast_packet(janus_videoroom_subscriber_stream *stream,
+		janus_videoroom_publisher_stream *ps, janus_videoroom_rtp_relay_packet *packet) {
+	janus_videoroom_relay_simulcast_internal(stream, ps, packet, FALSE);
+}
+static void janus_videoroom_relay_simulcast_vp8_packet(janus_videoroom_subscriber_stream *stream,
+		janus_videoroom_publisher_stream *ps, janus_videoroom_rtp_relay_packet *packet) {
+	janus_videoroom_relay_simulcast_internal(stream, ps, packet, TRUE);
+}
+static void janus_videoroom_relay_plain_packet(janus_videoroom_subscriber_stream *stream,
+		janus_videoroom_publisher_stream *ps, janus_videoroom_rtp_relay_packet *packet) {
+	janus_videoroom_session *session = stream->subscriber->session;
+	/* Fix sequence number and timestamp (publisher switching may be involved) */
+	janus_rtp_header_update(packet->data, &stream->context, packet->is_video, 0);
+	/* Send the packet */
+	if(gateway != NULL) {
+		janus_plugin_rtp rtp = { .mindex = stream->mindex, .video = packet->is_video, .buffer = (char *)packet->data, .length = packet->length,
+			.extensions = packet->extensions, .shared = packet->shared };
+		if(packet->is_video && stream->min_delay > -1 && stream->max_delay > -1) {
+			rtp.extensions.min_delay = stream->min_delay;
+			rtp.extensions.max_delay = stream->max_delay;
+		}
+		gateway->relay_rtp(session->handle, &rtp);
+	}
+	/* Restore the timestamp and sequence number to what the publisher set them to */
+	packet->data->timestamp = htonl(packet->timestamp);
+	packet->data->seq_number = htons(packet->seq_number);
+}
+
 static void janus_videoroom_relay_rtp_packet(gpointer data, gpointer user_data) {
 	janus_videoroom_rtp_relay_packet *packet = (janus_videoroom_rtp_relay_packet *)user_data;
 	if(!packet || !packet->data || packet->length < 1) {
@@ -12687,167 +13744,89 @@ static void janus_videoroom_relay_rtp_packet(gpointer data, gpointer user_data)
 		return;
 	janus_videoroom_subscriber *subscriber = stream->subscriber;
 	janus_videoroom_session *session = subscriber->session;
+	JANUS_PROBE(videoroom_relay_rtp, session->handle, packet->is_video, packet->length);
+	janus_videoroom *room = subscriber->room;
+	if(room != NULL && (room->bitrate_quota > 0 || room->pps_quota > 0)) {
+		/* This room has resource quotas: account for this packet, and check
+		 * if a second has passed since we last evaluated the aggregate rates */
+		g_atomic_int_add(&room->quota_packets, 1);
+		g_atomic_int_add(&room->quota_bytes, packet->length);
+		gint64 now = janus_get_monotonic_time();
+		gint64 elapsed = now - room->quota_started;
+		if(elapsed >= G_USEC_PER_SEC && g_atomic_int_compare_and_exchange(&room->quota_checking, 0, 1)) {
+			/* Close the window and compute the aggregate bitrate and packet rate */
+			gint packets = g_atomic_int_and(&room->quota_packets, 0);
+			gint bytes = g_atomic_int_and(&room->quota_bytes, 0);
+			room->quota_started = now;
+			guint64 bitrate = ((guint64)bytes)*8*G_USEC_PER_SEC/elapsed;
+			guint32 pps = ((guint64)packets)*G_USEC_PER_SEC/elapsed;
+			gboolean exceeded = (room->bitrate_quota > 0 && bitrate > room->bitrate_quota) ||
+				(room->pps_quota > 0 && pps > room->pps_quota);
+			if(exceeded != (g_atomic_int_get(&room->quota_exceeded) == 1)) {
+				g_atomic_int_set(&room->quota_exceeded, exceeded ? 1 : 0);
+				JANUS_LOG(LOG_WARN, "VideoRoom room %s is %s its resource quota (%"SCNu64" bps, %"SCNu32" pps)%s\n",
+					room->room_id_str, exceeded ? "over" : "back within", bitrate, pps,
+					exceeded ? ", dropping video" : "");
+				/* Also notify event handlers */
+				if(notify_events && gateway->events_is_enabled()) {
+					json_t *info = json_object();
+					json_object_set_new(info, "event", json_string(exceeded ? "quota_exceeded" : "quota_cleared"));
+					json_object_set_new(info, "room", string_ids ?
+						json_string(room->room_id_str) : json_integer(room->room_id));
+					json_object_set_new(info, "bitrate", json_integer(bitrate));
+					json_object_set_new(info, "pps", json_integer(pps));
+					gateway->notify_event(&janus_videoroom_plugin, NULL, info);
+				}
+			}
+			g_atomic_int_set(&room->quota_checking, 0);
+		}
+		if(packet->is_video && g_atomic_int_get(&room->quota_exceeded)) {
+			/* Over quota: drop video packets, let audio through so that
+			 * conversations survive while the room is misbehaving */
+			return;
+		}
+	}
 
 	/* Make sure there hasn't been a publisher switch by checking the SSRC */
 	if(packet->is_video) {
-		/* Check if there's any SVC info to take into account */
-		if(packet->svc) {
-			/* Handle SVC: make sure we have a payload to work with */
-			int plen = 0;
-			char *payload = janus_rtp_payload((char *)packet->data, packet->length, &plen);
-			if(payload == NULL)
-				return;
-			/* Process this packet: don't relay if it's not the layer we wanted to handle */
-			char rtph[12];
-			memcpy(&rtph, packet->data, sizeof(rtph));
-			gboolean relay = janus_rtp_svc_context_process_rtp(&stream->svc_context,
-				(char *)packet->data, packet->length, packet->extensions.dd_content, packet->extensions.dd_len,
-				ps->vcodec, &packet->svc_info, &stream->context);
-			if(stream->svc_context.need_pli) {
-				/* Send a PLI */
-				JANUS_LOG(LOG_VERB, "We need a PLI for the SVC context\n");
-				janus_videoroom_reqpli(ps, "SVC change");
-			}
-			/* Do we need to drop this? */
-			if(!relay)
-				return;
-			/* Any event we should notify? */
-			if(stream->svc_context.changed_spatial) {
-				/* Notify the user about the spatial layer change */
-				json_t *event = json_object();
-				json_object_set_new(event, "videoroom", json_string("event"));
-				json_object_set_new(event, "room", string_ids ? json_string(subscriber->room_id_str) : json_integer(subscriber->room_id));
-				json_object_set_new(event, "mid", json_string(stream->mid));
-				json_object_set_new(event, "spatial_layer", json_integer(stream->svc_context.spatial));
-				gateway->push_event(subscriber->session->handle, &janus_videoroom_plugin, NULL, event, NULL);
-				json_decref(event);
-			}
-			if(stream->svc_context.changed_temporal) {
-				/* Notify the user about the temporal layer change */
-				json_t *event = json_object();
-				json_object_set_new(event, "videoroom", json_string("event"));
-				json_object_set_new(event, "room", string_ids ? json_string(subscriber->room_id_str) : json_integer(subscriber->room_id));
-				json_object_set_new(event, "mid", json_string(stream->mid));
-				json_object_set_new(event, "temporal_layer", json_integer(stream->svc_context.temporal));
-				gateway->push_event(subscriber->session->handle, &janus_videoroom_plugin, NULL, event, NULL);
-				json_decref(event);
-			}
-			/* If we got here, update the RTP header and send the packet */
-			janus_rtp_header_update(packet->data, &stream->context, TRUE, 0);
-			/* Send the packet */
-			if(gateway != NULL) {
-				janus_plugin_rtp rtp = { .mindex = stream->mindex, .video = packet->is_video, .buffer = (char *)packet->data, .length = packet->length,
-					.extensions = packet->extensions };
-				if(stream->min_delay > -1 && stream->max_delay > -1) {
-					rtp.extensions.min_delay = stream->min_delay;
-					rtp.extensions.max_delay = stream->max_delay;
-				}
-				gateway->relay_rtp(session->handle, &rtp);
-			}
-			/* Restore the timestamp and sequence number to what the publisher set them to */
-			memcpy(packet->data, &rtph, sizeof(rtph));
-		} else if(packet->simulcast) {
-			/* Handle simulcast: make sure we have a payload to work with */
-			int plen = 0;
-			char *payload = janus_rtp_payload((char *)packet->data, packet->length, &plen);
-			if(payload == NULL)
-				return;
-			/* Process this packet: don't relay if it's not the SSRC/layer we wanted to handle */
-			gboolean relay = janus_rtp_simulcasting_context_process_rtp(&stream->sim_context,
-				(char *)packet->data, packet->length, packet->extensions.dd_content, packet->extensions.dd_len,
-				packet->ssrc, NULL, ps->vcodec, &stream->context, &ps->rid_mutex);
-			if(!relay) {
-				/* Did a lot of time pass before we could relay a packet? */
-				gint64 now = janus_get_monotonic_time();
-				if((now - stream->sim_context.last_relayed) >= G_USEC_PER_SEC) {
-					g_atomic_int_set(&stream->sim_context.need_pli, 1);
+		if(stream->autoadapt && stream->adapted > 0) {
+			/* Automatic layer adaptation is enabled and we stepped down in the past:
+			 * if the link has been clean for a while, try to step back up towards
+			 * the substream/spatial layer the subscriber originally asked for */
+			gint64 now = janus_get_monotonic_time();
+			if(now - stream->adapted > 10*G_USEC_PER_SEC) {
+				if(ps->simulcast && stream->sim_context.substream_target < stream->adapt_target) {
+					stream->sim_context.substream_target++;
+					stream->adapted = now;
+					JANUS_LOG(LOG_VERB, "Link is clean, stepping simulcast substream up to %d for subscriber (mid %s)\n",
+						stream->sim_context.substream_target, stream->mid);
+					janus_videoroom_reqpli(ps, "Automatic adaptation (up)");
+				} else if(ps->svc && stream->svc_context.spatial_target < stream->adapt_target) {
+					stream->svc_context.spatial_target++;
+					stream->adapted = now;
+					JANUS_LOG(LOG_VERB, "Link is clean, stepping SVC spatial layer up to %d for subscriber (mid %s)\n",
+						stream->svc_context.spatial_target, stream->mid);
+					janus_videoroom_reqpli(ps, "Automatic adaptation (up)");
 				}
 			}
-			if(stream->sim_context.need_pli) {
-				/* Send a PLI */
-				JANUS_LOG(LOG_VERB, "We need a PLI for the simulcast context\n");
-				janus_videoroom_reqpli(ps, "Simulcast change");
-			}
-			/* Do we need to drop this? */
-			if(!relay)
-				return;
-			/* Any event we should notify? */
-			if(stream->sim_context.changed_substream) {
-				/* Notify the user about the substream change */
-				json_t *event = json_object();
-				json_object_set_new(event, "videoroom", json_string("event"));
-				json_object_set_new(event, "room", string_ids ? json_string(subscriber->room_id_str) : json_integer(subscriber->room_id));
-				json_object_set_new(event, "mid", json_string(stream->mid));
-				json_object_set_new(event, "substream", json_integer(stream->sim_context.substream));
-				gateway->push_event(subscriber->session->handle, &janus_videoroom_plugin, NULL, event, NULL);
-				json_decref(event);
-			}
-			if(stream->sim_context.changed_temporal) {
-				/* Notify the user about the temporal layer change */
-				json_t *event = json_object();
-				json_object_set_new(event, "videoroom", json_string("event"));
-				json_object_set_new(event, "room", string_ids ? json_string(subscriber->room_id_str) : json_integer(subscriber->room_id));
-				json_object_set_new(event, "mid", json_string(stream->mid));
-				json_object_set_new(event, "temporal", json_integer(stream->sim_context.templayer));
-				gateway->push_event(subscriber->session->handle, &janus_videoroom_plugin, NULL, event, NULL);
-				json_decref(event);
-			}
-			/* If we got here, update the RTP header and send the packet */
-			janus_rtp_header_update(packet->data, &stream->context, TRUE, 0);
-			char vp8pd[6];
-			if(ps->vcodec == JANUS_VIDEOCODEC_VP8) {
-				/* For VP8, we save the original payload descriptor, to restore it after */
-				memcpy(vp8pd, payload, sizeof(vp8pd));
-				janus_vp8_simulcast_descriptor_update(payload, plen, &stream->vp8_context,
-					stream->sim_context.changed_substream);
-			}
-			/* Send the packet */
-			if(gateway != NULL) {
-				janus_plugin_rtp rtp = { .mindex = stream->mindex, .video = packet->is_video, .buffer = (char *)packet->data, .length = packet->length,
-					.extensions = packet->extensions };
-				if(stream->min_delay > -1 && stream->max_delay > -1) {
-					rtp.extensions.min_delay = stream->min_delay;
-					rtp.extensions.max_delay = stream->max_delay;
-				}
-				gateway->relay_rtp(session->handle, &rtp);
-			}
-			/* Restore the timestamp and sequence number to what the publisher set them to */
-			packet->data->timestamp = htonl(packet->timestamp);
-			packet->data->seq_number = htons(packet->seq_number);
-			if(ps->vcodec == JANUS_VIDEOCODEC_VP8) {
-				/* Restore the original payload descriptor as well, as it will be needed by the next viewer */
-				memcpy(payload, vp8pd, sizeof(vp8pd));
-			}
-		} else {
-			/* Fix sequence number and timestamp (publisher switching may be involved) */
-			janus_rtp_header_update(packet->data, &stream->context, TRUE, 0);
-			/* Send the packet */
-			if(gateway != NULL) {
-				janus_plugin_rtp rtp = { .mindex = stream->mindex, .video = packet->is_video, .buffer = (char *)packet->data, .length = packet->length,
-					.extensions = packet->extensions };
-				if(stream->min_delay > -1 && stream->max_delay > -1) {
-					rtp.extensions.min_delay = stream->min_delay;
-					rtp.extensions.max_delay = stream->max_delay;
-				}
-				gateway->relay_rtp(session->handle, &rtp);
-			}
-			/* Restore the timestamp and sequence number to what the publisher set them to */
-			packet->data->timestamp = htonl(packet->timestamp);
-			packet->data->seq_number = htons(packet->seq_number);
-		}
-	} else {
-		/* Fix sequence number and timestamp (publisher switching may be involved) */
-		janus_rtp_header_update(packet->data, &stream->context, FALSE, 0);
-		/* Send the packet */
-		if(gateway != NULL) {
-			janus_plugin_rtp rtp = { .mindex = stream->mindex, .video = packet->is_video, .buffer = (char *)packet->data, .length = packet->length,
-				.extensions = packet->extensions };
-			gateway->relay_rtp(session->handle, &rtp);
 		}
-		/* Restore the timestamp and sequence number to what the publisher set them to */
-		packet->data->timestamp = htonl(packet->timestamp);
-		packet->data->seq_number = htons(packet->seq_number);
 	}
+	/* Pick the relay path for this stream, if we haven't already: which one
+	 * to use only depends on properties that are fixed for as long as we're
+	 * fed by the same publisher stream, so we resolve it once and re-evaluate
+	 * it only when the source changes (e.g., after a switch), rather than
+	 * branching on codec and simulcast/SVC state once per relayed packet */
+	if(stream->relay == NULL || stream->relay_source != ps) {
+		if(packet->is_video && packet->svc)
+			stream->relay = janus_videoroom_relay_svc_packet;
+		else if(packet->is_video && packet->simulcast)
+			stream->relay = (ps->vcodec == JANUS_VIDEOCODEC_VP8 ?
+				janus_videoroom_relay_simulcast_vp8_packet : janus_videoroom_relay_simulcast_packet);
+		else
+			stream->relay = janus_videoroom_relay_plain_packet;
+		stream->relay_source = ps;
+	}
+	stream->relay(stream, ps, packet);
 
 	return;
 }
@@ -13140,234 +14119,145 @@ static int janus_videoroom_get_fd_port(int fd) {
 	return ntohs(server.sin6_port);
 }
 /* Thread responsible for a specific remote publisher */
-static void *janus_videoroom_remote_publisher_thread(void *user_data) {
-	janus_videoroom_publisher *publisher = (janus_videoroom_publisher *)user_data;
-	if(publisher == NULL) {
-		JANUS_LOG(LOG_ERR, "Invalid publisher instance\n");
-		g_thread_unref(g_thread_self());
-		return NULL;
-	}
-	JANUS_LOG(LOG_VERB, "[%s/%s] Joining remote publisher thread...\n",
-		publisher->room->room_id_str, publisher->user_id_str);
+/* Helper to add a remote publisher to the room it belongs to, and notify
+ * all other participants: invoked by the thread responsible for the
+ * publisher when it starts, or at registration time when the shared
+ * ingest engine is in use */
+static void janus_videoroom_remote_publisher_join(janus_videoroom_publisher *publisher) {
+	janus_videoroom *videoroom = publisher->room;
+	g_hash_table_insert(videoroom->participants,
+		string_ids ? (gpointer)g_strdup(publisher->user_id_str) : (gpointer)janus_uint64_dup(publisher->user_id),
+		publisher);
+	janus_videoroom_participant_changed(publisher);
+	/* Let's also notify all other participants that the publisher is here */
+	janus_videoroom_notify_about_publisher(publisher, FALSE);
+}
 
-	/* File descriptors */
-	socklen_t addrlen;
+/* Helper to process an incoming packet on one of the sockets of a remote
+ * publisher, and relay it as if it came from a regular publisher */
+static void janus_videoroom_remote_publisher_readable(janus_videoroom_publisher *publisher, int fd, char *buffer, int buflen) {
+	janus_videoroom *videoroom = publisher->room;
+	socklen_t addrlen = 0;
 	struct sockaddr_storage remote = { 0 };
-	int resfd = 0, bytes = 0;
-	struct pollfd fds[3];
-	int pipe_fd = publisher->pipefd[0];
-	char buffer[1500];
-	memset(buffer, 0, 1500);
-	if(pipe_fd == -1) {
-		/* If the pipe file descriptor doesn't exist, it means we're done already,
-		 * and/or we may never be notified about sessions being closed, so give up */
-		JANUS_LOG(LOG_WARN, "[%s/%s] Leaving remote publisher thread, no pipe file descriptor...\n",
-			publisher->room->room_id_str, publisher->user_id_str);
-		janus_videoroom_publisher_destroy(publisher);
-		janus_refcount_decrease(&publisher->session->ref);
-		janus_refcount_decrease(&publisher->ref);
-		g_thread_unref(g_thread_self());
-		return NULL;
-	}
-	/* RTP stuff */
+	int bytes = 0;
 	janus_rtp_header *rtp = NULL;
 	uint32_t ssrc = 0, diff = 0;
 	int mindex = 0, vindex = 0;
 	janus_videoroom_publisher_stream *ps = NULL;
 	janus_plugin_rtp pkt = { 0 };
 	janus_plugin_data data = { 0 };
-	GList *temp = NULL;
-
-	/* As the first thing, we add the remote publisher to the list */
-	janus_refcount_increase(&publisher->ref);
-	janus_refcount_increase(&publisher->session->ref);
-	janus_videoroom *videoroom = publisher->room;
-	janus_refcount_increase(&videoroom->ref);
-	g_hash_table_insert(videoroom->participants,
-		string_ids ? (gpointer)g_strdup(publisher->user_id_str) : (gpointer)janus_uint64_dup(publisher->user_id),
-		publisher);
-	/* Let's also notify all other participants that the publisher is here */
-	janus_videoroom_notify_about_publisher(publisher, FALSE);
-
-	/* Loop */
-	int num = 0, i = 0;
-	while(!g_atomic_int_get(&publisher->remote_leaving) && !g_atomic_int_get(&publisher->destroyed)) {
-		/* Prepare poll */
-		num = 0;
-		if(publisher->remote_fd != -1) {
-			fds[num].fd = publisher->remote_fd;
-			fds[num].events = POLLIN;
-			fds[num].revents = 0;
-			num++;
-		}
-		if(publisher->remote_rtcp_fd != -1) {
-			fds[num].fd = publisher->remote_rtcp_fd;
-			fds[num].events = POLLIN;
-			fds[num].revents = 0;
-			num++;
-		}
-		pipe_fd = publisher->pipefd[0];
-		if(pipe_fd == -1) {
-			/* Pipe was closed? Means the call is over */
-			break;
-		}
-		fds[num].fd = pipe_fd;
-		fds[num].events = POLLIN;
-		fds[num].revents = 0;
-		num++;
-		/* Check if we need to send any PLI */
-		janus_mutex_lock(&publisher->streams_mutex);
-		temp = publisher->streams;
-		while(temp) {
-			ps = (janus_videoroom_publisher_stream *)temp->data;
-			/* Any PLI and/or REMB we should send back to the source? */
-			if(ps->type == JANUS_VIDEOROOM_MEDIA_VIDEO && g_atomic_int_get(&ps->need_pli))
-				janus_videoroom_rtcp_pli_send(ps);
-			temp = temp->next;
+	if(fd == publisher->remote_rtcp_fd) {
+		/* Got Something on the RTCP socket, we only use this for latching */
+		addrlen = sizeof(remote);
+		bytes = recvfrom(fd, buffer, buflen, 0, (struct sockaddr *)&remote, &addrlen);
+		if(bytes < 0 || (!janus_is_rtp(buffer, bytes) && !janus_is_rtcp(buffer, bytes))) {
+			/* For latching we need an RTP or RTCP packet */
+			return;
 		}
+		memcpy(&publisher->rtcp_addr, &remote, addrlen);
+		return;
+	}
+	/* Got an RTP/RTCP packet */
+	addrlen = sizeof(remote);
+	bytes = recvfrom(fd, buffer, buflen, 0, (struct sockaddr *)&remote, &addrlen);
+	if(bytes < 0) {
+		/* Failed to read? */
+		return;
+	}
+	/* Handle packet: check SSRC and do relay_rtp accordingly */
+	if(!janus_is_rtp(buffer, bytes)) {
+		/* Not RTP, drop the packet */
+		return;
+	}
+	rtp = (janus_rtp_header *)buffer;
+	ssrc = ntohl(rtp->ssrc);
+	if(ssrc < REMOTE_PUBLISHER_BASE_SSRC) {
+		/* Can't be one of the SSRCs we're waiting for, innore */
+		JANUS_LOG(LOG_WARN, "[%s/%s] Invalid SSRC (%"SCNu32")\n",
+			videoroom->room_id_str, publisher->user_id_str, ssrc);
+		return;
+	}
+	diff = ssrc - REMOTE_PUBLISHER_BASE_SSRC;
+	mindex = diff/REMOTE_PUBLISHER_SSRC_STEP;
+	vindex = diff - (mindex*REMOTE_PUBLISHER_SSRC_STEP);
+	janus_mutex_lock(&publisher->streams_mutex);
+	ps = g_hash_table_lookup(publisher->streams_byid, GINT_TO_POINTER(mindex));
+	if(ps == NULL) {
 		janus_mutex_unlock(&publisher->streams_mutex);
-		/* Wait for some data */
-		resfd = poll(fds, num, 1000);
-		if(resfd < 0) {
-			if(errno == EINTR) {
-				JANUS_LOG(LOG_HUGE, "[%s/%s] Got an EINTR (%s), ignoring...\n",
-					videoroom->room_id_str, publisher->user_id_str, g_strerror(errno));
-				continue;
-			}
-			JANUS_LOG(LOG_ERR, "[%s/%s] Error polling...\n", videoroom->room_id_str, publisher->user_id_str);
-			JANUS_LOG(LOG_ERR, "[%s/%s]   -- %d (%s)\n",
-				videoroom->room_id_str, publisher->user_id_str, errno, g_strerror(errno));
-			break;
-		} else if(resfd == 0) {
-			/* No data, keep going */
-			continue;
+		JANUS_LOG(LOG_WARN, "[%s/%s] Invalid mindex %d\n",
+			videoroom->room_id_str, publisher->user_id_str, mindex);
+		return;
+	}
+	if((!ps->simulcast && vindex > 0) || vindex > 2) {
+		janus_mutex_unlock(&publisher->streams_mutex);
+		JANUS_LOG(LOG_WARN, "[%s/%s] Invalid substream %d\n",
+			videoroom->room_id_str, publisher->user_id_str, vindex);
+		return;
+	}
+	/* Check if this is an actual RTP packet, or an
+	 * envelope created to relay data channels */
+	if(ps->type == JANUS_VIDEOROOM_MEDIA_DATA) {
+		/* Handle as data channel, stripping the RTP header */
+		janus_refcount_increase_nodebug(&publisher->ref);
+		janus_mutex_unlock(&publisher->streams_mutex);
+		data.label = NULL;
+		data.protocol = NULL;
+		data.binary = rtp->type ? TRUE : FALSE;
+		data.buffer = buffer + 12;
+		data.length = bytes - 12;
+		/* Now handle the packet as if coming from a regular publisher */
+		janus_videoroom_incoming_data_internal(publisher->session, publisher, &data);
+		return;
+	}
+	/* Prepare the RTP packet */
+	pkt.mindex = mindex;
+	pkt.video = (ps->type == JANUS_VIDEOROOM_MEDIA_VIDEO);
+	pkt.buffer = buffer;
+	pkt.length = bytes;
+	janus_plugin_rtp_extensions_reset(&pkt.extensions);
+	janus_refcount_increase_nodebug(&publisher->ref);
+	janus_mutex_unlock(&publisher->streams_mutex);
+	/* Parse RTP extensions before relaying the packet */
+	if(!pkt.video && ps->audio_level_extmap_id > 0) {
+		gboolean vad = FALSE;
+		int level = -1;
+		if(janus_rtp_header_extension_parse_audio_level(buffer, bytes,
+				ps->audio_level_extmap_id, &vad, &level) == 0) {
+			pkt.extensions.audio_level = level;
+			pkt.extensions.audio_level_vad = vad;
 		}
-		if(g_atomic_int_get(&publisher->remote_leaving) || g_atomic_int_get(&publisher->destroyed))
-			break;
-		for(i=0; i<num; i++) {
-			if(fds[i].revents & (POLLERR | POLLHUP)) {
-				/* Socket error? */
-				JANUS_LOG(LOG_ERR, "[%s/%s] Error polling: %s... %d (%s)\n",
-					videoroom->room_id_str, publisher->user_id_str,
-					fds[i].revents & POLLERR ? "POLLERR" : "POLLHUP", errno, g_strerror(errno));
-				break;
-			} else if(fds[i].revents & POLLIN) {
-				if(pipe_fd != -1 && fds[i].fd == pipe_fd) {
-					/* Poll interrupted for a reason, go on */
-					int code = 0;
-					(void)read(pipe_fd, &code, sizeof(int));
-					break;
-				} else if(fds[i].fd == publisher->remote_rtcp_fd) {
-					/* Got Something on the RTCP socket, we only use this for latching */
-					addrlen = sizeof(remote);
-					bytes = recvfrom(fds[i].fd, buffer, 1500, 0, (struct sockaddr *)&remote, &addrlen);
-					if(bytes < 0 || (!janus_is_rtp(buffer, bytes) && !janus_is_rtcp(buffer, bytes))) {
-						/* For latching we need an RTP or RTCP packet */
-						continue;
-					}
-					memcpy(&publisher->rtcp_addr, &remote, addrlen);
-					continue;
-				}
-				/* Got an RTP/RTCP packet */
-				addrlen = sizeof(remote);
-				bytes = recvfrom(fds[i].fd, buffer, 1500, 0, (struct sockaddr *)&remote, &addrlen);
-				if(bytes < 0) {
-					/* Failed to read? */
-					continue;
-				}
-				/* Handle packet: check SSRC and do relay_rtp accordingly */
-				if(!janus_is_rtp(buffer, bytes)) {
-					/* Not RTP, drop the packet */
-					continue;
-				}
-				rtp = (janus_rtp_header *)buffer;
-				ssrc = ntohl(rtp->ssrc);
-				if(ssrc < REMOTE_PUBLISHER_BASE_SSRC) {
-					/* Can't be one of the SSRCs we're waiting for, innore */
-					JANUS_LOG(LOG_WARN, "[%s/%s] Invalid SSRC (%"SCNu32")\n",
-						videoroom->room_id_str, publisher->user_id_str, ssrc);
-					continue;
-				}
-				diff = ssrc - REMOTE_PUBLISHER_BASE_SSRC;
-				mindex = diff/REMOTE_PUBLISHER_SSRC_STEP;
-				vindex = diff - (mindex*REMOTE_PUBLISHER_SSRC_STEP);
-				janus_mutex_lock(&publisher->streams_mutex);
-				ps = g_hash_table_lookup(publisher->streams_byid, GINT_TO_POINTER(mindex));
-				if(ps == NULL) {
-					janus_mutex_unlock(&publisher->streams_mutex);
-					JANUS_LOG(LOG_WARN, "[%s/%s] Invalid mindex %d\n",
-						videoroom->room_id_str, publisher->user_id_str, mindex);
-					continue;
-				}
-				if((!ps->simulcast && vindex > 0) || vindex > 2) {
-					janus_mutex_unlock(&publisher->streams_mutex);
-					JANUS_LOG(LOG_WARN, "[%s/%s] Invalid substream %d\n",
-						videoroom->room_id_str, publisher->user_id_str, vindex);
-					continue;
-				}
-				/* Check if this is an actual RTP packet, or an
-				 * envelope created to relay data channels */
-				if(ps->type == JANUS_VIDEOROOM_MEDIA_DATA) {
-					/* Handle as data channel, stripping the RTP header */
-					janus_refcount_increase_nodebug(&publisher->ref);
-					janus_mutex_unlock(&publisher->streams_mutex);
-					data.label = NULL;
-					data.protocol = NULL;
-					data.binary = rtp->type ? TRUE : FALSE;
-					data.buffer = buffer + 12;
-					data.length = bytes - 12;
-					/* Now handle the packet as if coming from a regular publisher */
-					janus_videoroom_incoming_data_internal(publisher->session, publisher, &data);
-					continue;
-				}
-				/* Prepare the RTP packet */
-				pkt.mindex = mindex;
-				pkt.video = (ps->type == JANUS_VIDEOROOM_MEDIA_VIDEO);
-				pkt.buffer = buffer;
-				pkt.length = bytes;
-				janus_plugin_rtp_extensions_reset(&pkt.extensions);
-				janus_refcount_increase_nodebug(&publisher->ref);
-				janus_mutex_unlock(&publisher->streams_mutex);
-				/* Parse RTP extensions before relaying the packet */
-				if(!pkt.video && ps->audio_level_extmap_id > 0) {
-					gboolean vad = FALSE;
-					int level = -1;
-					if(janus_rtp_header_extension_parse_audio_level(buffer, bytes,
-							ps->audio_level_extmap_id, &vad, &level) == 0) {
-						pkt.extensions.audio_level = level;
-						pkt.extensions.audio_level_vad = vad;
-					}
-				}
-				if(pkt.video && ps->video_orient_extmap_id > 0) {
-					gboolean c = FALSE, f = FALSE, r1 = FALSE, r0 = FALSE;
-					if(janus_rtp_header_extension_parse_video_orientation(buffer, bytes,
-							ps->video_orient_extmap_id, &c, &f, &r1, &r0) == 0) {
-						pkt.extensions.video_rotation = 0;
-						if(r1 && r0)
-							pkt.extensions.video_rotation = 270;
-						else if(r1)
-							pkt.extensions.video_rotation = 180;
-						else if(r0)
-							pkt.extensions.video_rotation = 90;
-						pkt.extensions.video_back_camera = c;
-						pkt.extensions.video_flipped = f;
-					}
-				}
-				if(pkt.video && ps->playout_delay_extmap_id > 0) {
-					uint16_t min = 0, max = 0;
-					if(janus_rtp_header_extension_parse_playout_delay(buffer, bytes,
-							ps->playout_delay_extmap_id, &min, &max) == 0) {
-						pkt.extensions.min_delay = min;
-						pkt.extensions.max_delay = max;
-					}
-				}
-				/* Now handle the packet as if coming from a regular publisher */
-				janus_videoroom_incoming_rtp_internal(publisher->session, publisher, &pkt);
-			}
+	}
+	if(pkt.video && ps->video_orient_extmap_id > 0) {
+		gboolean c = FALSE, f = FALSE, r1 = FALSE, r0 = FALSE;
+		if(janus_rtp_header_extension_parse_video_orientation(buffer, bytes,
+				ps->video_orient_extmap_id, &c, &f, &r1, &r0) == 0) {
+			pkt.extensions.video_rotation = 0;
+			if(r1 && r0)
+				pkt.extensions.video_rotation = 270;
+			else if(r1)
+				pkt.extensions.video_rotation = 180;
+			else if(r0)
+				pkt.extensions.video_rotation = 90;
+			pkt.extensions.video_back_camera = c;
+			pkt.extensions.video_flipped = f;
 		}
 	}
-	/* If we got here, the remote publisher has been removed from the
-	 * room: let's notify all other publishers in the room */
+	if(pkt.video && ps->playout_delay_extmap_id > 0) {
+		uint16_t min = 0, max = 0;
+		if(janus_rtp_header_extension_parse_playout_delay(buffer, bytes,
+				ps->playout_delay_extmap_id, &min, &max) == 0) {
+			pkt.extensions.min_delay = min;
+			pkt.extensions.max_delay = max;
+		}
+	}
+	/* Now handle the packet as if coming from a regular publisher */
+	janus_videoroom_incoming_rtp_internal(publisher->session, publisher, &pkt);
+}
+
+/* Helper to get rid of a remote publisher that left: closes its streams,
+ * updates the involved subscribers, and notifies the other participants */
+static void janus_videoroom_remote_publisher_leave(janus_videoroom_publisher *publisher) {
+	GList *temp = NULL;
 	janus_mutex_lock(&publisher->rec_mutex);
 	g_free(publisher->recording_base);
 	publisher->recording_base = NULL;
@@ -13469,6 +14359,123 @@ static void *janus_videoroom_remote_publisher_thread(void *user_data) {
 	janus_mutex_unlock(&publisher->streams_mutex);
 	janus_videoroom_leave_or_unpublish(publisher, TRUE, FALSE);
 	janus_videoroom_publisher_destroy(publisher);
+}
+
+static void *janus_videoroom_remote_publisher_thread(void *user_data) {
+	janus_videoroom_publisher *publisher = (janus_videoroom_publisher *)user_data;
+	if(publisher == NULL) {
+		JANUS_LOG(LOG_ERR, "Invalid publisher instance\n");
+		g_thread_unref(g_thread_self());
+		return NULL;
+	}
+	JANUS_LOG(LOG_VERB, "[%s/%s] Joining remote publisher thread...\n",
+		publisher->room->room_id_str, publisher->user_id_str);
+
+	/* File descriptors */
+	int resfd = 0;
+	struct pollfd fds[3];
+	int pipe_fd = publisher->pipefd[0];
+	char buffer[1500];
+	memset(buffer, 0, 1500);
+	if(pipe_fd == -1) {
+		/* If the pipe file descriptor doesn't exist, it means we're done already,
+		 * and/or we may never be notified about sessions being closed, so give up */
+		JANUS_LOG(LOG_WARN, "[%s/%s] Leaving remote publisher thread, no pipe file descriptor...\n",
+			publisher->room->room_id_str, publisher->user_id_str);
+		janus_videoroom_publisher_destroy(publisher);
+		janus_refcount_decrease(&publisher->session->ref);
+		janus_refcount_decrease(&publisher->ref);
+		g_thread_unref(g_thread_self());
+		return NULL;
+	}
+	/* RTP stuff */
+	janus_videoroom_publisher_stream *ps = NULL;
+	GList *temp = NULL;
+
+	/* As the first thing, we add the remote publisher to the list */
+	janus_refcount_increase(&publisher->ref);
+	janus_refcount_increase(&publisher->session->ref);
+	janus_videoroom *videoroom = publisher->room;
+	janus_refcount_increase(&videoroom->ref);
+	janus_videoroom_remote_publisher_join(publisher);
+
+	/* Loop */
+	int num = 0, i = 0;
+	while(!g_atomic_int_get(&publisher->remote_leaving) && !g_atomic_int_get(&publisher->destroyed)) {
+		/* Prepare poll */
+		num = 0;
+		if(publisher->remote_fd != -1) {
+			fds[num].fd = publisher->remote_fd;
+			fds[num].events = POLLIN;
+			fds[num].revents = 0;
+			num++;
+		}
+		if(publisher->remote_rtcp_fd != -1) {
+			fds[num].fd = publisher->remote_rtcp_fd;
+			fds[num].events = POLLIN;
+			fds[num].revents = 0;
+			num++;
+		}
+		pipe_fd = publisher->pipefd[0];
+		if(pipe_fd == -1) {
+			/* Pipe was closed? Means the call is over */
+			break;
+		}
+		fds[num].fd = pipe_fd;
+		fds[num].events = POLLIN;
+		fds[num].revents = 0;
+		num++;
+		/* Check if we need to send any PLI */
+		janus_mutex_lock(&publisher->streams_mutex);
+		temp = publisher->streams;
+		while(temp) {
+			ps = (janus_videoroom_publisher_stream *)temp->data;
+			/* Any PLI and/or REMB we should send back to the source? */
+			if(ps->type == JANUS_VIDEOROOM_MEDIA_VIDEO && g_atomic_int_get(&ps->need_pli))
+				janus_videoroom_rtcp_pli_send(ps);
+			temp = temp->next;
+		}
+		janus_mutex_unlock(&publisher->streams_mutex);
+		/* Wait for some data */
+		resfd = poll(fds, num, 1000);
+		if(resfd < 0) {
+			if(errno == EINTR) {
+				JANUS_LOG(LOG_HUGE, "[%s/%s] Got an EINTR (%s), ignoring...\n",
+					videoroom->room_id_str, publisher->user_id_str, g_strerror(errno));
+				continue;
+			}
+			JANUS_LOG(LOG_ERR, "[%s/%s] Error polling...\n", videoroom->room_id_str, publisher->user_id_str);
+			JANUS_LOG(LOG_ERR, "[%s/%s]   -- %d (%s)\n",
+				videoroom->room_id_str, publisher->user_id_str, errno, g_strerror(errno));
+			break;
+		} else if(resfd == 0) {
+			/* No data, keep going */
+			continue;
+		}
+		if(g_atomic_int_get(&publisher->remote_leaving) || g_atomic_int_get(&publisher->destroyed))
+			break;
+		for(i=0; i<num; i++) {
+			if(fds[i].revents & (POLLERR | POLLHUP)) {
+				/* Socket error? */
+				JANUS_LOG(LOG_ERR, "[%s/%s] Error polling: %s... %d (%s)\n",
+					videoroom->room_id_str, publisher->user_id_str,
+					fds[i].revents & POLLERR ? "POLLERR" : "POLLHUP", errno, g_strerror(errno));
+				break;
+			} else if(fds[i].revents & POLLIN) {
+				if(pipe_fd != -1 && fds[i].fd == pipe_fd) {
+					/* Poll interrupted for a reason, go on */
+					int code = 0;
+					(void)read(pipe_fd, &code, sizeof(int));
+					break;
+				}
+				/* Got an RTP/RTCP packet, or something to latch to */
+				janus_videoroom_remote_publisher_readable(publisher, fds[i].fd, buffer, sizeof(buffer));
+			}
+		}
+	}
+	/* If we got here, the remote publisher has been removed from the
+	 * room: let's notify all other publishers in the room */
+	janus_videoroom_remote_publisher_leave(publisher);
 	/* Done */
 	JANUS_LOG(LOG_VERB, "[%s/%s] Leaving remote publisher thread...\n",
 		videoroom->room_id_str, publisher->user_id_str);
@@ -13479,6 +14486,212 @@ static void *janus_videoroom_remote_publisher_thread(void *user_data) {
 	return NULL;
 }
 
+#ifdef __linux__
+/* Shared ingest engine implementation */
+#define JANUS_VIDEOROOM_EPOLL_EVENTS	64
+static gboolean janus_videoroom_ingest_shard_addfd(janus_videoroom_ingest_shard *shard,
+		janus_videoroom_publisher *publisher, int fd) {
+	if(fd < 0)
+		return TRUE;
+	janus_videoroom_ingest_fd *ifd = g_malloc(sizeof(janus_videoroom_ingest_fd));
+	ifd->fd = fd;
+	ifd->publisher = publisher;
+	struct epoll_event ev = { 0 };
+	ev.events = EPOLLIN;
+	ev.data.ptr = ifd;
+	if(epoll_ctl(shard->epollfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		JANUS_LOG(LOG_ERR, "[%s/%s] Error registering file descriptor on ingest shard #%d... %d (%s)\n",
+			publisher->room->room_id_str, publisher->user_id_str, shard->id, errno, g_strerror(errno));
+		g_free(ifd);
+		return FALSE;
+	}
+	publisher->ingest_fds = g_slist_prepend(publisher->ingest_fds, ifd);
+	return TRUE;
+}
+
+/* Register a remote publisher on one of the shards of the shared ingest
+ * engine: returns FALSE if the publisher needs a dedicated thread instead */
+static gboolean janus_videoroom_ingest_register(janus_videoroom_publisher *publisher) {
+	if(ingest_shards_num == 0)
+		return FALSE;
+	if(publisher->pipefd[0] < 0) {
+		/* Without the pipe we could never be told the publisher is leaving */
+		return FALSE;
+	}
+	/* Pick a shard, round robin */
+	janus_videoroom_ingest_shard *shard =
+		&ingest_shards[((guint)g_atomic_int_add(&ingest_shards_rr, 1)) % ingest_shards_num];
+	/* These references are the same a dedicated thread would take */
+	janus_refcount_increase(&publisher->ref);
+	janus_refcount_increase(&publisher->session->ref);
+	janus_refcount_increase(&publisher->room->ref);
+	publisher->ingest_shard = shard;
+	/* Register all the file descriptors of this publisher, including
+	 * the pipe we use to interrupt the loop when it's removed */
+	gboolean ok = TRUE;
+	ok = ok && janus_videoroom_ingest_shard_addfd(shard, publisher, publisher->remote_fd);
+	ok = ok && janus_videoroom_ingest_shard_addfd(shard, publisher, publisher->remote_rtcp_fd);
+	ok = ok && janus_videoroom_ingest_shard_addfd(shard, publisher, publisher->pipefd[0]);
+	if(!ok) {
+		/* We couldn't register some descriptor: undo everything, the
+		 * publisher will get a dedicated thread instead */
+		GSList *l = publisher->ingest_fds;
+		while(l) {
+			janus_videoroom_ingest_fd *ifd = (janus_videoroom_ingest_fd *)l->data;
+			epoll_ctl(shard->epollfd, EPOLL_CTL_DEL, ifd->fd, NULL);
+			g_free(ifd);
+			l = l->next;
+		}
+		g_slist_free(publisher->ingest_fds);
+		publisher->ingest_fds = NULL;
+		publisher->ingest_shard = NULL;
+		janus_refcount_decrease(&publisher->room->ref);
+		janus_refcount_decrease(&publisher->session->ref);
+		janus_refcount_decrease(&publisher->ref);
+		return FALSE;
+	}
+	janus_mutex_lock(&shard->mutex);
+	shard->publishers = g_list_append(shard->publishers, publisher);
+	janus_mutex_unlock(&shard->mutex);
+	/* Add the publisher to the room and notify all other participants */
+	janus_videoroom_remote_publisher_join(publisher);
+	JANUS_LOG(LOG_VERB, "[%s/%s] Remote publisher registered on ingest shard #%d\n",
+		publisher->room->room_id_str, publisher->user_id_str, shard->id);
+	return TRUE;
+}
+
+/* Deregister a remote publisher from its shard (only invoked by the shard thread) */
+static void janus_videoroom_ingest_unregister(janus_videoroom_publisher *publisher) {
+	janus_videoroom_ingest_shard *shard = (janus_videoroom_ingest_shard *)publisher->ingest_shard;
+	if(shard == NULL)
+		return;
+	janus_videoroom *videoroom = publisher->room;
+	GSList *l = publisher->ingest_fds;
+	while(l) {
+		janus_videoroom_ingest_fd *ifd = (janus_videoroom_ingest_fd *)l->data;
+		epoll_ctl(shard->epollfd, EPOLL_CTL_DEL, ifd->fd, NULL);
+		g_free(ifd);
+		l = l->next;
+	}
+	g_slist_free(publisher->ingest_fds);
+	publisher->ingest_fds = NULL;
+	publisher->ingest_shard = NULL;
+	janus_mutex_lock(&shard->mutex);
+	shard->publishers = g_list_remove(shard->publishers, publisher);
+	janus_mutex_unlock(&shard->mutex);
+	/* Get rid of the publisher and notify the other participants */
+	janus_videoroom_remote_publisher_leave(publisher);
+	JANUS_LOG(LOG_VERB, "[%s/%s] Remote publisher deregistered from ingest shard #%d\n",
+		videoroom->room_id_str, publisher->user_id_str, shard->id);
+	janus_refcount_decrease(&videoroom->ref);
+	janus_refcount_decrease(&publisher->session->ref);
+	janus_refcount_decrease(&publisher->ref);
+}
+
+static void *janus_videoroom_ingest_shard_thread(void *data) {
+	janus_videoroom_ingest_shard *shard = (janus_videoroom_ingest_shard *)data;
+	JANUS_LOG(LOG_VERB, "Starting shared ingest engine thread (shard #%d)\n", shard->id);
+	struct epoll_event events[JANUS_VIDEOROOM_EPOLL_EVENTS];
+	char buffer[1500];
+	memset(buffer, 0, 1500);
+	int resfd = 0, bytes = 0, i = 0;
+	gint64 checks = 0;
+	while(!g_atomic_int_get(&stopping)) {
+		resfd = epoll_wait(shard->epollfd, events, JANUS_VIDEOROOM_EPOLL_EVENTS, 1000);
+		if(resfd < 0) {
+			if(errno == EINTR) {
+				JANUS_LOG(LOG_HUGE, "Got an EINTR (%s) on ingest shard #%d, ignoring...\n",
+					g_strerror(errno), shard->id);
+				continue;
+			}
+			JANUS_LOG(LOG_ERR, "Error on epoll_wait for ingest shard #%d... %d (%s)\n",
+				shard->id, errno, g_strerror(errno));
+			break;
+		}
+		/* Process the events, deferring deregistrations until we've gone
+		 * through the whole batch, as other events in it may refer to the
+		 * same publisher and its file descriptors */
+		GSList *leaving = NULL;
+		for(i=0; i<resfd; i++) {
+			janus_videoroom_ingest_fd *ifd = (janus_videoroom_ingest_fd *)events[i].data.ptr;
+			janus_videoroom_publisher *publisher = ifd->publisher;
+			if(g_slist_find(leaving, publisher) != NULL)
+				continue;
+			if(events[i].events & (EPOLLERR | EPOLLHUP)) {
+				/* Socket error? Just log it, as a dedicated thread would */
+				JANUS_LOG(LOG_ERR, "[%s/%s] Error polling: %s... %d (%s)\n",
+					publisher->room->room_id_str, publisher->user_id_str,
+					events[i].events & EPOLLERR ? "EPOLLERR" : "EPOLLHUP", errno, g_strerror(errno));
+				continue;
+			}
+			if(ifd->fd == publisher->pipefd[0]) {
+				/* The remote publisher has been removed */
+				int code = 0;
+				bytes = read(ifd->fd, &code, sizeof(int));
+				(void)bytes;
+				JANUS_LOG(LOG_VERB, "[%s/%s] Interrupting remote publisher\n",
+					publisher->room->room_id_str, publisher->user_id_str);
+				leaving = g_slist_prepend(leaving, publisher);
+				continue;
+			}
+			if(g_atomic_int_get(&publisher->remote_leaving) || g_atomic_int_get(&publisher->destroyed)) {
+				leaving = g_slist_prepend(leaving, publisher);
+				continue;
+			}
+			janus_videoroom_remote_publisher_readable(publisher, ifd->fd, buffer, sizeof(buffer));
+		}
+		if(leaving != NULL) {
+			GSList *l = leaving;
+			while(l) {
+				janus_videoroom_ingest_unregister((janus_videoroom_publisher *)l->data);
+				l = l->next;
+			}
+			g_slist_free(leaving);
+		}
+		/* A few times per second, check if we owe PLI feedback to a publisher */
+		gint64 now = janus_get_monotonic_time();
+		if(now - checks >= G_USEC_PER_SEC/5) {
+			checks = now;
+			janus_mutex_lock(&shard->mutex);
+			GList *p = shard->publishers;
+			while(p) {
+				janus_videoroom_publisher *publisher = (janus_videoroom_publisher *)p->data;
+				if(!g_atomic_int_get(&publisher->remote_leaving) && !g_atomic_int_get(&publisher->destroyed)) {
+					janus_mutex_lock(&publisher->streams_mutex);
+					GList *temp = publisher->streams;
+					while(temp) {
+						janus_videoroom_publisher_stream *ps = (janus_videoroom_publisher_stream *)temp->data;
+						/* Any PLI we should send back to the source? */
+						if(ps->type == JANUS_VIDEOROOM_MEDIA_VIDEO && g_atomic_int_get(&ps->need_pli))
+							janus_videoroom_rtcp_pli_send(ps);
+						temp = temp->next;
+					}
+					janus_mutex_unlock(&publisher->streams_mutex);
+				}
+				p = p->next;
+			}
+			janus_mutex_unlock(&shard->mutex);
+		}
+	}
+	/* We're done: deregister any remote publisher we were still serving */
+	janus_mutex_lock(&shard->mutex);
+	while(shard->publishers != NULL) {
+		janus_videoroom_publisher *publisher = (janus_videoroom_publisher *)shard->publishers->data;
+		janus_mutex_unlock(&shard->mutex);
+		janus_videoroom_ingest_unregister(publisher);
+		janus_mutex_lock(&shard->mutex);
+	}
+	janus_mutex_unlock(&shard->mutex);
+	JANUS_LOG(LOG_VERB, "Leaving shared ingest engine thread (shard #%d)\n", shard->id);
+	return NULL;
+}
+#else
+static gboolean janus_videoroom_ingest_register(janus_videoroom_publisher *publisher) {
+	/* No epoll(), remote publishers keep using dedicated threads */
+	return FALSE;
+}
+#endif
+
 static void janus_videoroom_helper_rtpdata_packet(gpointer data, gpointer user_data) {
 	janus_videoroom_rtp_relay_packet *packet = (janus_videoroom_rtp_relay_packet *)user_data;
 	if(!packet || !packet->data || packet->length < 1) {
@@ -13493,8 +14706,18 @@ static void janus_videoroom_helper_rtpdata_packet(gpointer data, gpointer user_d
 	/* Clone the packet and queue it for delivery on the helper thread */
 	janus_videoroom_rtp_relay_packet *copy = g_malloc0(sizeof(janus_videoroom_rtp_relay_packet));
 	copy->source = packet->source;
-	copy->data = g_malloc(packet->length);
-	memcpy(copy->data, packet->data, packet->length);
+	if(packet->is_rtp && !packet->svc && !packet->simulcast) {
+		/* No per-viewer payload rewriting involved: clone to a refcounted
+		 * buffer, so that the helper thread can let the core defer the
+		 * per-recipient payload copies to the send loops (the buffer is
+		 * still private to this helper, as each helper rewrites the RTP
+		 * header in place when relaying to its own subscribers) */
+		copy->shared = janus_plugin_buffer_new((char *)packet->data, packet->length);
+		copy->data = (janus_rtp_header *)copy->shared->buffer;
+	} else {
+		copy->data = g_malloc(packet->length);
+		memcpy(copy->data, packet->data, packet->length);
+	}
 	copy->length = packet->length;
 	copy->is_rtp = packet->is_rtp;
 	copy->textdata = packet->textdata;
@@ -13510,6 +14733,88 @@ static void janus_videoroom_helper_rtpdata_packet(gpointer data, gpointer user_d
 	g_async_queue_push(helper->queued_packets, copy);
 }
 
+/* How often (in packets) a helper checks whether it should shed load,
+ * and how backed up its queue must be before it actually does */
+#define JANUS_VIDEOROOM_HELPER_BALANCE_CHECK	100
+#define JANUS_VIDEOROOM_HELPER_BALANCE_DEPTH	50
+static void janus_videoroom_helper_rebalance(janus_videoroom_helper *helper) {
+	janus_videoroom *room = helper->room;
+	if(room == NULL || g_atomic_int_get(&room->destroyed))
+		return;
+	gint depth = g_async_queue_length(helper->queued_packets);
+	if(depth < JANUS_VIDEOROOM_HELPER_BALANCE_DEPTH)
+		return;
+	/* Our queue is backed up: look for the most idle sibling */
+	janus_videoroom_helper *target = NULL;
+	gint target_depth = 0;
+	GList *l = room->threads;
+	while(l) {
+		janus_videoroom_helper *ht = (janus_videoroom_helper *)l->data;
+		if(ht != helper && !g_atomic_int_get(&ht->destroyed)) {
+			gint ht_depth = g_async_queue_length(ht->queued_packets);
+			if(target == NULL || ht_depth < target_depth) {
+				target = ht;
+				target_depth = ht_depth;
+			}
+		}
+		l = l->next;
+	}
+	if(target == NULL || target_depth*2 >= depth) {
+		/* No sibling is doing meaningfully better than us */
+		return;
+	}
+	/* Migrate some subscriber streams to the sibling: we always lock the
+	 * two helpers in ID order, so that helpers rebalancing towards each
+	 * other at the same time can't deadlock */
+	janus_videoroom_helper *first = helper->id < target->id ? helper : target;
+	janus_videoroom_helper *second = helper->id < target->id ? target : helper;
+	janus_mutex_lock(&first->mutex);
+	janus_mutex_lock(&second->mutex);
+	/* Pick the publisher stream we serve the most subscribers for */
+	GHashTableIter iter;
+	gpointer key, value;
+	janus_videoroom_publisher_stream *ps = NULL;
+	GList *list = NULL;
+	guint count = 0;
+	g_hash_table_iter_init(&iter, helper->subscribers);
+	while(g_hash_table_iter_next(&iter, &key, &value)) {
+		guint c = g_list_length((GList *)value);
+		if(c > count) {
+			ps = (janus_videoroom_publisher_stream *)key;
+			list = (GList *)value;
+			count = c;
+		}
+	}
+	/* Move half of its subscribers, or all of them if it only has one
+	 * and we're serving other streams anyway */
+	guint tomove = count/2;
+	if(tomove == 0 && count > 0 && g_hash_table_size(helper->subscribers) > 1)
+		tomove = count;
+	if(ps == NULL || tomove == 0) {
+		janus_mutex_unlock(&second->mutex);
+		janus_mutex_unlock(&first->mutex);
+		return;
+	}
+	guint moved = tomove;
+	GList *moving = NULL;
+	while(tomove > 0) {
+		GList *last = g_list_last(list);
+		list = g_list_remove_link(list, last);
+		moving = g_list_concat(last, moving);
+		tomove--;
+	}
+	g_hash_table_insert(helper->subscribers, ps, list);
+	helper->num_subscribers -= moved;
+	GList *tlist = g_hash_table_lookup(target->subscribers, ps);
+	tlist = g_list_concat(tlist, moving);
+	g_hash_table_insert(target->subscribers, ps, tlist);
+	target->num_subscribers += moved;
+	JANUS_LOG(LOG_VERB, "[%s/#%d] Queue backed up (%d packets), moved %u subscriber streams to helper #%d\n",
+		room->room_id_str, helper->id, depth, moved, target->id);
+	janus_mutex_unlock(&second->mutex);
+	janus_mutex_unlock(&first->mutex);
+}
+
 static void *janus_videoroom_helper_thread(void *data) {
 	janus_videoroom_helper *helper = (janus_videoroom_helper *)data;
 	janus_videoroom *room = helper->room;
@@ -13517,6 +14822,7 @@ static void *janus_videoroom_helper_thread(void *data) {
 	GList *subscribers = NULL;
 	JANUS_LOG(LOG_VERB, "[%s/#%d] Joining VideoRoom helper thread\n", room->room_id_str, helper->id);
 	janus_videoroom_rtp_relay_packet *pkt = NULL;
+	int balance_check = 0;
 	while(!g_atomic_int_get(&stopping) && !g_atomic_int_get(&room->destroyed) && !g_atomic_int_get(&helper->destroyed)) {
 		pkt = g_async_queue_pop(helper->queued_packets);
 		if(pkt == &exit_packet)
@@ -13532,6 +14838,12 @@ static void *janus_videoroom_helper_thread(void *data) {
 		}
 		janus_mutex_unlock(&helper->mutex);
 		janus_videoroom_rtp_relay_packet_free(pkt);
+		/* Every now and then, check if we're backed up while siblings idle,
+		 * and shed part of our load to the most idle one if we are */
+		if(room->helper_threads > 1 && ++balance_check >= JANUS_VIDEOROOM_HELPER_BALANCE_CHECK) {
+			balance_check = 0;
+			janus_videoroom_helper_rebalance(helper);
+		}
 	}
 	JANUS_LOG(LOG_VERB, "[%s/#%d] Leaving VideoRoom helper thread\n", room->room_id_str, helper->id);
 	janus_refcount_decrease(&helper->ref);
@@ -72,9 +72,37 @@ janus_plugin_rtp *janus_plugin_rtp_duplicate(janus_plugin_rtp *packet) {
 			p->length = packet->length;
 		}
 		p->extensions = packet->extensions;
+		/* The duplicate owns its own buffer, so it doesn't reference the shared one */
+		p->shared = NULL;
 	}
 	return p;
 }
+
+/* Refcounted buffers */
+static void janus_plugin_buffer_free(const janus_refcount *buffer_ref) {
+	janus_plugin_buffer *buffer = janus_refcount_containerof(buffer_ref, janus_plugin_buffer, ref);
+	g_free(buffer->buffer);
+	g_free(buffer);
+}
+janus_plugin_buffer *janus_plugin_buffer_new(const char *buffer, uint16_t length) {
+	if(length == 0)
+		return NULL;
+	janus_plugin_buffer *b = g_malloc(sizeof(janus_plugin_buffer));
+	b->buffer = g_malloc(length);
+	if(buffer != NULL)
+		memcpy(b->buffer, buffer, length);
+	b->length = length;
+	janus_refcount_init(&b->ref, janus_plugin_buffer_free);
+	return b;
+}
+void janus_plugin_buffer_ref(janus_plugin_buffer *buffer) {
+	if(buffer)
+		janus_refcount_increase(&buffer->ref);
+}
+void janus_plugin_buffer_unref(janus_plugin_buffer *buffer) {
+	if(buffer)
+		janus_refcount_decrease(&buffer->ref);
+}
 void janus_plugin_rtcp_reset(janus_plugin_rtcp *packet) {
 	if(packet) {
 		memset(packet, 0, sizeof(janus_plugin_rtcp));
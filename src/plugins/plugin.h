@@ -171,7 +171,7 @@ janus_plugin *create(void) {
  * Janus instance or it will crash.
  *
  */
-#define JANUS_PLUGIN_API_VERSION	105
+#define JANUS_PLUGIN_API_VERSION	108
 
 /*! \brief Initialization of all plugin properties to NULL
  *
@@ -211,6 +211,7 @@ static janus_plugin janus_echotest_plugin =
 		.hangup_media = NULL,			\
 		.destroy_session = NULL,		\
 		.query_session = NULL, 			\
+		.query_state = NULL,			\
 		## __VA_ARGS__ }
 
 
@@ -231,6 +232,8 @@ typedef struct janus_plugin_rtp_extensions janus_plugin_rtp_extensions;
 typedef struct janus_plugin_rtcp janus_plugin_rtcp;
 /*! \brief Data message exchanged with the core */
 typedef struct janus_plugin_data janus_plugin_data;
+/*! \brief Refcounted buffer an RTP packet may refer to */
+typedef struct janus_plugin_buffer janus_plugin_buffer;
 
 /* Use forward declaration to avoid including jansson.h */
 typedef struct json_t json_t;
@@ -352,6 +355,16 @@ struct janus_plugin {
 	 * @param[in] handle The plugin/gateway session used for this peer
 	 * @returns A json_t object with the requested info */
 	json_t *(* const query_session)(janus_plugin_session *handle);
+	/*! \brief Method to get a description of the plugin's replicable state
+	 * (e.g., the rooms or mountpoints that currently exist), to be shipped
+	 * in periodic core "snapshot" events: a standby instance consuming the
+	 * event stream can use it to pre-create the same resources, so that a
+	 * failover only requires clients to renegotiate their PeerConnections
+	 *  \note This method is optional; notice that, unlike a plugin "list"
+	 * request, the returned info may include credentials (secrets, PINs),
+	 * as a standby needs them to replicate the resources faithfully
+	 * @returns A json_t object with the state info, or NULL if there's none */
+	json_t *(* const query_state)(void);
 
 };
 
@@ -439,6 +452,20 @@ struct janus_callbacks {
 	 * @param[in] desc The descriptor to search for
 	 * @returns TRUE if the token is valid, not expired and contains the descriptor, FALSE otherwise */
 	gboolean (* const auth_signature_contains)(janus_plugin *plugin, const char *token, const char *descriptor);
+
+	/*! \brief Method to ask the core to bridge incoming RTP packets on a handle
+	 * straight to another handle, skipping the plugin callback entirely
+	 * \note Once a bridge is set, \c incoming_rtp is not invoked anymore for
+	 * that handle, so this only makes sense when the plugin would relay the
+	 * packets unmodified anyway (e.g., no simulcast, recording or transformations
+	 * involved). Each call only configures one direction: for a bidirectional
+	 * bridge the method must be invoked twice, swapping the arguments. RTCP and
+	 * datachannel messages keep going through the plugin callbacks in any case,
+	 * and the core tears the bridge down automatically when the PeerConnection
+	 * of the handle is closed.
+	 * @param[in] handle The plugin/gateway session whose incoming RTP should be bridged
+	 * @param[in] peer The plugin/gateway session to relay the packets to (NULL to tear the bridge down) */
+	void (* const set_media_bridge)(janus_plugin_session *handle, janus_plugin_session *peer);
 };
 
 /*! \brief The hook that plugins need to implement to be created from the Janus core */
@@ -590,6 +617,37 @@ struct janus_plugin_rtp_extensions {
 */
 void janus_plugin_rtp_extensions_reset(janus_plugin_rtp_extensions *extensions);
 
+/*! \brief Refcounted buffer an RTP packet may refer to
+ * @note This is meant for plugins that relay the same payload to many
+ * handles (e.g., SFU-like fanout): rather than having the core copy the
+ * buffer at enqueue time for each recipient, the plugin can allocate the
+ * payload in a janus_plugin_buffer once, and set it as the \c shared
+ * property of the janus_plugin_rtp packets it relays. The core will then
+ * keep a reference instead of copying right away, and only materialize a
+ * private copy on the send loop of each handle, right before rewriting
+ * the header and encrypting: packets that get dropped before that (e.g.,
+ * because the PeerConnection isn't ready) are never copied at all. */
+struct janus_plugin_buffer {
+	/*! \brief The buffer data */
+	char *buffer;
+	/*! \brief The buffer length */
+	uint16_t length;
+	/*! \brief Reference counter for this instance */
+	janus_refcount ref;
+};
+/*! \brief Helper method to allocate a refcounted buffer, copying the provided data
+ * @note The returned buffer has a single reference, owned by the caller
+ * @param[in] buffer Data to copy into the new buffer (may be NULL to just allocate)
+ * @param[in] length Size of the buffer to allocate
+ * @returns A pointer to the new janus_plugin_buffer, if successful, or NULL otherwise */
+janus_plugin_buffer *janus_plugin_buffer_new(const char *buffer, uint16_t length);
+/*! \brief Helper method to add a reference to a refcounted buffer
+ * @param[in] buffer Buffer to add a reference to */
+void janus_plugin_buffer_ref(janus_plugin_buffer *buffer);
+/*! \brief Helper method to remove a reference from a refcounted buffer, freeing it when none are left
+ * @param[in] buffer Buffer to remove a reference from */
+void janus_plugin_buffer_unref(janus_plugin_buffer *buffer);
+
 /*! \brief Janus plugin RTP packet */
 struct janus_plugin_rtp {
 	/*! \brief Index of the stream (relative to the SDP)
@@ -607,6 +665,11 @@ struct janus_plugin_rtp {
 	uint16_t length;
 	/*! \brief RTP extensions */
 	janus_plugin_rtp_extensions extensions;
+	/*! \brief Refcounted buffer the packet data lives in, if any: when set
+	 * on a packet passed to relay_rtp, \c buffer must point inside it, and
+	 * the core will reference the buffer and defer its private copy to the
+	 * send loop, rather than copying at enqueue time (see janus_plugin_buffer) */
+	janus_plugin_buffer *shared;
 };
 /*! \brief Helper method to initialise/reset the RTP packet
  * @note The main motivation for this method comes from the presence of the
@@ -658,6 +721,12 @@ struct janus_plugin_data {
 	char *buffer;
 	/*! \brief The message length */
 	uint16_t length;
+	/*! \brief Refcounted buffer the message data lives in, if any: when set
+	 * on a message passed to relay_data, \c buffer must point inside it, and
+	 * the core will reference the buffer and defer its private copy to the
+	 * send loop, rather than copying at enqueue time (see janus_plugin_buffer);
+	 * useful when broadcasting the same message to many recipients */
+	janus_plugin_buffer *shared;
 };
 /*! \brief Helper method to initialise/reset the data message
  * @param[in] packet Pointer to the janus_plugin_data message to reset
@@ -39,6 +39,27 @@
 ./janus-pp-rec --json /path/to/source.mjr
 ./janus-pp-rec --header /path/to/source.mjr
 ./janus-pp-rec --parse /path/to/source.mjr
+\endverbatim
+ *
+ * When many recordings need to be converted at once, you can pass more
+ * than one source file and use the \c --parallel option to have them
+ * processed by multiple worker processes at the same time: in that case
+ * the name of each target file is derived from the related source, with
+ * the extension specified via \c --format, e.g.:
+ *
+\verbatim
+./janus-pp-rec --parallel 8 --format opus /path/to/recordings/*-audio.mjr
+\endverbatim
+ *
+ * If a recording is still in progress, you can use the \c --follow
+ * option to process it as it's being written: the tool will keep
+ * waiting for new packets, and only close the target file once the
+ * recorder has finalized the recording (or nothing new has been written
+ * for a while), meaning the processed file is available moments after
+ * the media session ends, e.g.:
+ *
+\verbatim
+./janus-pp-rec --follow /path/to/source.mjr /path/to/destination.webm
 \endverbatim
  *
  * For a more complete overview of the available command line settings,
@@ -93,6 +114,13 @@ Usage: janus-pp-rec [OPTIONS] source.mjr
                                 Minimum latency of moving average to reach
                                   before starting to correct timestamps.
                                   (default=500)
+  -N, --parallel=count          Process multiple source files in parallel with
+                                  this many worker processes; requires --format,
+                                  as the target names are derived from the
+                                  sources (default=0, process a single file)
+  -w, --follow                  Follow mode: keep waiting for new packets if
+                                  the source file is still being written to,
+                                  and process it as it grows  (default=off)
 \endverbatim
  *
  * \note This utility does not do any form of transcoding. It just
@@ -111,10 +139,14 @@ Usage: janus-pp-rec [OPTIONS] source.mjr
 #else
 #include <endian.h>
 #endif
+#include <errno.h>
 #include <inttypes.h>
 #include <string.h>
 #include <stdlib.h>
 #include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 #include <jansson.h>
 
@@ -144,7 +176,44 @@ static janus_pprec_options options = { 0 };
 static janus_pp_frame_packet *list = NULL, *last = NULL;
 static int working = 0;
 
+/* The source file is memory-mapped, since we have to go through it more
+ * than once (pre-parse first, and then the actual processing) */
+static char *mapped = NULL;
+static size_t mapped_size = 0;
+
+/* Helper to read a portion of the memory-mapped source file */
+static size_t janus_pp_map_read(void *dest, size_t len, long offset) {
+	if(mapped == NULL || offset < 0 || (size_t)offset >= mapped_size)
+		return 0;
+	if(offset + len > mapped_size)
+		len = mapped_size - offset;
+	memcpy(dest, mapped + offset, len);
+	return len;
+}
+
+/* Helper to refresh the mapping of the source file, in case it's still
+ * being written to (follow mode) and has grown since we last mapped it */
+static long janus_pp_map_refresh(FILE *file) {
+	fseek(file, 0L, SEEK_END);
+	long fsize = ftell(file);
+	if(fsize < 0 || (size_t)fsize == mapped_size)
+		return fsize;
+	if(mapped != NULL)
+		munmap(mapped, mapped_size);
+	mapped_size = 0;
+	mapped = mmap(NULL, fsize, PROT_READ, MAP_SHARED, fileno(file), 0);
+	if(mapped == MAP_FAILED) {
+		JANUS_LOG(LOG_ERR, "Could not map file... %s\n", g_strerror(errno));
+		mapped = NULL;
+		return -1;
+	}
+	mapped_size = (size_t)fsize;
+	madvise(mapped, mapped_size, MADV_SEQUENTIAL);
+	return fsize;
+}
+
 #define SKEW_DETECTION_WAIT_TIME_SECS 10
+#define FOLLOW_MAX_WAIT_TIME_SECS 30
 #define DEFAULT_AUDIO_SKEW_TH 0
 #define DEFAULT_SILENCE_DISTANCE 0
 #define DEFAULT_RESTAMP_MULTIPLIER 0
@@ -292,10 +361,96 @@ int main(int argc, char *argv[]) {
 		options.restamp_packets = DEFAULT_RESTAMP_PACKETS;
 	if(options.restamp_min_th < 0)
 		options.restamp_packets = DEFAULT_RESTAMP_MIN_TH;
+	if(options.parallel < 0)
+		options.parallel = 0;
+	if(options.follow && (options.jsonheader_only || options.header_only || options.parse_only || options.extjson_only)) {
+		JANUS_LOG(LOG_ERR, "Follow mode can only be used when actually processing to a target file\n");
+		janus_pprec_options_destroy();
+		exit(1);
+	}
+	if(options.follow && options.parallel > 0) {
+		JANUS_LOG(LOG_ERR, "Follow mode and batch mode can't be combined\n");
+		janus_pprec_options_destroy();
+		exit(1);
+	}
 
 	/* Evaluate arguments to find source and target */
 	char *source = options.paths ? options.paths[0] : NULL;
 	char *destination = (options.paths && options.paths[0]) ? options.paths[1] : NULL;
+	/* If we were asked to process multiple files in parallel (batch mode),
+	 * fork a worker process per source file, and have each run the usual
+	 * single file processing: both our own state and the muxers' live in
+	 * globals, so separate processes are the only safe way to run more
+	 * than one job at a time. The audio and video recordings of the same
+	 * media session can simply both be passed as sources, and will be
+	 * worked on concurrently as independent jobs */
+	if(options.parallel > 0) {
+		if(jsonheader_only || header_only || parse_only) {
+			JANUS_LOG(LOG_ERR, "Batch mode can only be used when actually processing to target files\n");
+			janus_pprec_options_destroy();
+			exit(1);
+		}
+		if(extension == NULL) {
+			JANUS_LOG(LOG_ERR, "Batch mode requires --format, to derive the target file names from the sources\n");
+			janus_pprec_options_destroy();
+			exit(1);
+		}
+		if(source == NULL) {
+			janus_pprec_options_help();
+			janus_pprec_options_destroy();
+			exit(1);
+		}
+		int files = (int)g_strv_length(options.paths);
+		JANUS_LOG(LOG_INFO, "Janus version: %d (%s)\n", janus_version, janus_version_string);
+		JANUS_LOG(LOG_INFO, "Processing %d files with up to %d parallel workers\n\n", files, options.parallel);
+		int i = 0, running = 0, failed = 0, status = 0;
+		gboolean worker = FALSE;
+		for(i = 0; i < files; i++) {
+			while(running >= options.parallel) {
+				/* All workers are busy, wait for one to complete */
+				if(waitpid(-1, &status, 0) < 0)
+					break;
+				running--;
+				if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+					failed++;
+			}
+			pid_t pid = fork();
+			if(pid < 0) {
+				JANUS_LOG(LOG_ERR, "Couldn't fork a worker for %s... %s\n", options.paths[i], g_strerror(errno));
+				failed++;
+				continue;
+			}
+			if(pid == 0) {
+				/* We're the worker: process this file as if it had been the
+				 * only argument, deriving the target name from the source */
+				worker = TRUE;
+				source = options.paths[i];
+				char target[1024];
+				char *ext = strstr(source, ".mjr");
+				if(ext != NULL && strlen(ext) == 4)
+					g_snprintf(target, sizeof(target), "%.*s.%s", (int)(ext-source), source, extension);
+				else
+					g_snprintf(target, sizeof(target), "%s.%s", source, extension);
+				destination = g_strdup(target);
+				break;
+			}
+			running++;
+		}
+		if(!worker) {
+			/* We're the dispatcher: wait for all the workers to complete */
+			while(running > 0) {
+				if(waitpid(-1, &status, 0) < 0)
+					break;
+				running--;
+				if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+					failed++;
+			}
+			if(failed > 0)
+				JANUS_LOG(LOG_ERR, "Couldn't process %d of the %d files\n", failed, files);
+			janus_pprec_options_destroy();
+			exit(failed > 0 ? 1 : 0);
+		}
+	}
 	if(source == NULL || (destination == NULL && !jsonheader_only && !header_only && !parse_only)) {
 		janus_pprec_options_help();
 		janus_pprec_options_destroy();
@@ -326,6 +481,8 @@ int main(int argc, char *argv[]) {
 			JANUS_LOG(LOG_INFO, "  -- Showing header only\n");
 		if(parse_only)
 			JANUS_LOG(LOG_INFO, "  -- Parsing header only\n");
+		if(options.follow)
+			JANUS_LOG(LOG_INFO, "  -- Following the recording as it grows\n");
 		if(destination != NULL)
 			JANUS_LOG(LOG_INFO, "Target file: %s\n", destination);
 		JANUS_LOG(LOG_INFO, "\n");
@@ -359,13 +516,74 @@ int main(int argc, char *argv[]) {
 	fseek(file, 0L, SEEK_END);
 	long fsize = ftell(file);
 	fseek(file, 0L, SEEK_SET);
+	if(options.follow && fsize == 0) {
+		/* In follow mode the file may still be empty, if the recorder
+		 * just created it: wait for something to be written to it */
+		JANUS_LOG(LOG_INFO, "Source file is still empty, waiting for the recorder...\n");
+		while(fsize == 0) {
+			g_usleep(250000);
+			fseek(file, 0L, SEEK_END);
+			fsize = ftell(file);
+		}
+		fseek(file, 0L, SEEK_SET);
+	}
 	if(!jsonheader_only)
 		JANUS_LOG(LOG_INFO, "File is %zu bytes\n", fsize);
+	/* Memory-map the source file: we'll go through it more than once, and
+	 * this way the repeated passes only read it from disk a single time */
+	mapped = mmap(NULL, fsize, PROT_READ, MAP_SHARED, fileno(file), 0);
+	if(mapped == MAP_FAILED) {
+		JANUS_LOG(LOG_ERR, "Could not map file %s... %s\n", source, g_strerror(errno));
+		fclose(file);
+		janus_pprec_options_destroy();
+		exit(1);
+	}
+	mapped_size = (size_t)fsize;
+	/* We'll mostly walk the file in order, let the kernel know */
+	madvise(mapped, mapped_size, MADV_SEQUENTIAL);
+	/* If this is an indexed (v3) recording, there's a block index at the end
+	 * of the file: we build our own ordered index anyway, so all we need is
+	 * making sure we stop parsing frames where the block index starts */
+	gboolean indexed = FALSE;
+	if(fsize > 20 && memcmp(mapped+fsize-4, "MJRI", 4) == 0) {
+		uint64_t index_offset = 0;
+		memcpy(&index_offset, mapped+fsize-12, sizeof(uint64_t));
+		index_offset = ntohll(index_offset);
+		if(index_offset > 0 && index_offset < (uint64_t)fsize) {
+			JANUS_LOG(LOG_VERB, "Indexed recording, ignoring the %ld bytes of block index at the end\n",
+				fsize-(long)index_offset);
+			fsize = (long)index_offset;
+			indexed = TRUE;
+		}
+	}
 
 	/* Handle SIGINT */
 	working = 1;
 	signal(SIGINT, janus_pp_handle_signal);
 
+	/* In follow mode, also wait for the info header to be fully written,
+	 * as everything we do next depends on its contents */
+	if(options.follow && !indexed) {
+		gboolean logged = FALSE;
+		uint16_t hlen = 0;
+		while(working) {
+			if(fsize >= 10 && janus_pp_map_read(&hlen, sizeof(uint16_t), 8) == sizeof(uint16_t) &&
+					fsize >= (long)(10 + ntohs(hlen)))
+				break;
+			if(!logged) {
+				JANUS_LOG(LOG_INFO, "Waiting for the recording info header to be written...\n");
+				logged = TRUE;
+			}
+			g_usleep(250000);
+			fsize = janus_pp_map_refresh(file);
+			if(fsize < 0) {
+				fclose(file);
+				janus_pprec_options_destroy();
+				exit(1);
+			}
+		}
+	}
+
 	/* Pre-parse */
 	if(!jsonheader_only)
 		JANUS_LOG(LOG_INFO, "Pre-parsing file to generate ordered index...\n");
@@ -396,8 +614,7 @@ int main(int argc, char *argv[]) {
 		}
 		/* Read frame header */
 		skip = 0;
-		fseek(file, offset, SEEK_SET);
-		bytes = fread(prebuffer, sizeof(char), 8, file);
+		bytes = janus_pp_map_read(prebuffer, 8, offset);
 		if(bytes != 8 || prebuffer[0] != 'M') {
 			JANUS_LOG(LOG_WARN, "Invalid header at offset %ld (%s), the processing will stop here...\n",
 				offset, bytes != 8 ? "not enough bytes" : "wrong prefix");
@@ -411,7 +628,7 @@ int main(int argc, char *argv[]) {
 		if(prebuffer[1] == 'E') {
 			/* Either the old .mjr format header ('MEETECHO' header followed by 'audio' or 'video'), or a frame */
 			offset += 8;
-			bytes = fread(&len, sizeof(uint16_t), 1, file);
+			bytes = janus_pp_map_read(&len, sizeof(uint16_t), offset);
 			len = ntohs(len);
 			offset += 2;
 			if(len == 5 && !parsed_header) {
@@ -422,7 +639,7 @@ int main(int argc, char *argv[]) {
 					janus_pprec_options_destroy();
 					exit(1);
 				}
-				bytes = fread(prebuffer, sizeof(char), 5, file);
+				bytes = janus_pp_map_read(prebuffer, 5, offset);
 				if(prebuffer[0] == 'v') {
 					JANUS_LOG(LOG_INFO, "This is a video recording, assuming VP8\n");
 					video = TRUE;
@@ -469,18 +686,19 @@ int main(int argc, char *argv[]) {
 		} else if(prebuffer[1] == 'J') {
 			/* New .mjr format, the header may contain useful info */
 			if(prebuffer[2] == 'R' && prebuffer[3] == '0' && prebuffer[4] == '0' &&
-					prebuffer[5] == '0' && prebuffer[6] == '0' && prebuffer[7] == '2') {
-				/* Main header is MJR00002: this means we have timestamps too */
+					prebuffer[5] == '0' && prebuffer[6] == '0' &&
+					(prebuffer[7] == '2' || prebuffer[7] == '3')) {
+				/* Main header is MJR00002 or MJR00003: this means we have timestamps too */
 				has_timestamps = TRUE;
 				JANUS_LOG(LOG_VERB, "New .mjr format, will parse timestamps too\n");
 			}
 			offset += 8;
-			bytes = fread(&len, sizeof(uint16_t), 1, file);
+			bytes = janus_pp_map_read(&len, sizeof(uint16_t), offset);
 			len = ntohs(len);
 			offset += 2;
 			if(len > 0 && !parsed_header) {
 				/* This is the info header */
-				bytes = fread(prebuffer, sizeof(char), len, file);
+				bytes = janus_pp_map_read(prebuffer, len, offset);
 				parsed_header = TRUE;
 				prebuffer[len] = '\0';
 				if(jsonheader_only && !extjson_only) {
@@ -737,6 +955,16 @@ int main(int argc, char *argv[]) {
 		}
 		/* Skip data for now */
 		offset += len;
+		if(parsed_header && (indexed || options.follow) && !header_only) {
+			/* The block index is only appended when a recording is closed
+			 * cleanly, so we know everything after the header is frames:
+			 * no need to walk the whole file a first time to check. The
+			 * same applies when following a recording still being written,
+			 * where we couldn't pre-parse the whole file anyway */
+			JANUS_LOG(LOG_VERB, "%s recording, skipping the rest of the pre-parse pass\n",
+				indexed ? "Indexed" : "In-progress");
+			break;
+		}
 	}
 	if(!working || jsonheader_only) {
 		g_free(metadata);
@@ -782,12 +1010,47 @@ int main(int argc, char *argv[]) {
 	/* Extensions, if any */
 	int audiolevel = 0, rotation = 0, last_rotation = -1, rotated = -1;
 	uint16_t rtp_header_len, rtp_read_n;
+	/* Follow mode state: an already finalized recording is followed as if
+	 * it weren't, since there's nothing to wait for anymore */
+	gboolean finalized = !options.follow || indexed, drained = FALSE;
+	gint64 last_growth = g_get_monotonic_time();
 	/* Start loop */
-	while(working && offset < fsize) {
+	while(working) {
+		if(!finalized && (drained || offset + 10 > fsize)) {
+			/* We've consumed everything that's been written so far: wait
+			 * to see if the file grows, or the recorder finalizes it */
+			drained = FALSE;
+			g_usleep(250000);
+			long newsize = janus_pp_map_refresh(file);
+			if(newsize < 0)
+				break;
+			if(newsize > fsize) {
+				fsize = newsize;
+				last_growth = g_get_monotonic_time();
+				/* Check if the block index has been appended: if so, the
+				 * recording is over, and this is our last batch of packets */
+				if(fsize > 20 && memcmp(mapped+fsize-4, "MJRI", 4) == 0) {
+					uint64_t index_offset = 0;
+					memcpy(&index_offset, mapped+fsize-12, sizeof(uint64_t));
+					index_offset = ntohll(index_offset);
+					if(index_offset > 0 && index_offset < (uint64_t)fsize) {
+						JANUS_LOG(LOG_INFO, "The recording has been finalized, processing the last packets\n");
+						fsize = (long)index_offset;
+						finalized = TRUE;
+					}
+				}
+			} else if(g_get_monotonic_time() - last_growth > FOLLOW_MAX_WAIT_TIME_SECS*G_USEC_PER_SEC) {
+				JANUS_LOG(LOG_WARN, "The recording hasn't grown in %d seconds, assuming it's over\n",
+					FOLLOW_MAX_WAIT_TIME_SECS);
+				finalized = TRUE;
+			}
+			continue;
+		}
+		if(offset >= fsize)
+			break;
 		/* Read frame header */
 		skip = 0;
-		fseek(file, offset, SEEK_SET);
-		bytes = fread(prebuffer, sizeof(char), 8, file);
+		bytes = janus_pp_map_read(prebuffer, 8, offset);
 		if(bytes != 8 || prebuffer[0] != 'M') {
 			/* Broken packet? Stop here */
 			break;
@@ -800,10 +1063,17 @@ int main(int argc, char *argv[]) {
 		prebuffer[(has_timestamps && prebuffer[1] != 'J') ? 4 : 8] = '\0';
 		JANUS_LOG(LOG_VERB, "Header: %s\n", prebuffer);
 		offset += 8;
-		bytes = fread(&len, sizeof(uint16_t), 1, file);
+		bytes = janus_pp_map_read(&len, sizeof(uint16_t), offset);
 		len = ntohs(len);
 		JANUS_LOG(LOG_VERB, "  -- Length: %"SCNu16"\n", len);
 		offset += 2;
+		if(!finalized && offset + len > fsize) {
+			/* The recorder is still writing this frame: rewind to its
+			 * header, and wait for the rest to be flushed to disk */
+			offset -= 10;
+			drained = TRUE;
+			continue;
+		}
 		if(prebuffer[1] == 'J' || (!data && len < 12)) {
 			/* Not RTP, skip */
 			JANUS_LOG(LOG_VERB, "  -- Not RTP, skipping\n");
@@ -828,7 +1098,7 @@ int main(int argc, char *argv[]) {
 		if(data) {
 			/* Things are simpler for data, no reordering is needed: start by the data time */
 			gint64 when = 0;
-			bytes = fread(&when, 1, sizeof(gint64), file);
+			bytes = janus_pp_map_read(&when, sizeof(gint64), offset);
 			if(bytes < (int)sizeof(gint64)) {
 				JANUS_LOG(LOG_WARN, "Missing data timestamp header");
 				break;
@@ -864,7 +1134,7 @@ int main(int argc, char *argv[]) {
 		}
 		/* Only read RTP header */
 		rtp_header_len = 12;
-		bytes = fread(prebuffer, sizeof(char), rtp_header_len, file);
+		bytes = janus_pp_map_read(prebuffer, rtp_header_len, offset);
 		if(bytes < rtp_header_len) {
 			JANUS_LOG(LOG_WARN, "Missing RTP packet header data (%d instead %"SCNu16")\n", bytes, rtp_header_len);
 			break;
@@ -896,7 +1166,7 @@ int main(int argc, char *argv[]) {
 		}
 		if(rtp->csrccount || rtp->extension) {
 			rtp_read_n = (rtp->csrccount + rtp->extension)*4;
-			bytes = fread(prebuffer+rtp_header_len, sizeof(char), rtp_read_n, file);
+			bytes = janus_pp_map_read(prebuffer+rtp_header_len, rtp_read_n, offset+rtp_header_len);
 			if(bytes < rtp_read_n) {
 				JANUS_LOG(LOG_WARN, "Missing RTP packet header data (%d instead %d)\n",
 					rtp_header_len+bytes, rtp_header_len+rtp_read_n);
@@ -913,7 +1183,7 @@ int main(int argc, char *argv[]) {
 				ntohs(ext->type), ntohs(ext->length));
 			rtp_read_n = ntohs(ext->length)*4;
 			skip += 4 + rtp_read_n;
-			bytes = fread(prebuffer+rtp_header_len, sizeof(char), rtp_read_n, file);
+			bytes = janus_pp_map_read(prebuffer+rtp_header_len, rtp_read_n, offset+rtp_header_len);
 			if(bytes < rtp_read_n) {
 				JANUS_LOG(LOG_WARN, "Missing RTP packet header data (%d instead %d)\n",
 					rtp_header_len+bytes, rtp_header_len+rtp_read_n);
@@ -1024,8 +1294,7 @@ int main(int argc, char *argv[]) {
 		}
 		if(rtp->padding) {
 			/* There's padding data, let's check the last byte to see how much data we should skip */
-			fseek(file, offset + len - 1, SEEK_SET);
-			bytes = fread(prebuffer2, sizeof(char), 1, file);
+			bytes = janus_pp_map_read(prebuffer2, 1, offset + len - 1);
 			uint8_t padlen = (uint8_t)prebuffer2[0];
 			JANUS_LOG(LOG_VERB, "Padding at sequence number %hu: %d/%d\n",
 				ntohs(rtp->seq_number), padlen, p->len);
@@ -1514,6 +1783,8 @@ int main(int argc, char *argv[]) {
 			janus_pp_l16_close();
 		}
 	}
+	munmap(mapped, mapped_size);
+	mapped = NULL;
 	fclose(file);
 
 	file = fopen(destination, "rb");
@@ -177,6 +177,22 @@ int main(int argc, char *argv[]) {
 	long fsize = ftell(file);
 	fseek(file, 0L, SEEK_SET);
 	JANUS_LOG(LOG_INFO, "File is %zu bytes\n", fsize);
+	/* If this is an indexed (v3) recording, there's a block index at the end
+	 * of the file: we don't need it, so we just stop parsing frames there */
+	if(fsize > 20) {
+		char trailer[4];
+		fseek(file, fsize-4, SEEK_SET);
+		if(fread(trailer, sizeof(char), 4, file) == 4 && memcmp(trailer, "MJRI", 4) == 0) {
+			uint64_t index_offset = 0;
+			fseek(file, fsize-12, SEEK_SET);
+			if(fread(&index_offset, sizeof(uint64_t), 1, file) == 1) {
+				index_offset = ntohll(index_offset);
+				if(index_offset > 0 && index_offset < (uint64_t)fsize)
+					fsize = (long)index_offset;
+			}
+		}
+		fseek(file, 0L, SEEK_SET);
+	}
 
 	/* Handle SIGINT */
 	working = 1;
@@ -226,8 +242,9 @@ int main(int argc, char *argv[]) {
 		} else if(prebuffer[1] == 'J') {
 			/* New .mjr format, check if this is an RTP recording */
 			if(prebuffer[2] == 'R' && prebuffer[3] == '0' && prebuffer[4] == '0' &&
-					prebuffer[5] == '0' && prebuffer[6] == '0' && prebuffer[7] == '2') {
-				/* Main header is MJR00002: this means we have timestamps too */
+					prebuffer[5] == '0' && prebuffer[6] == '0' &&
+					(prebuffer[7] == '2' || prebuffer[7] == '3')) {
+				/* Main header is MJR00002 or MJR00003: this means we have timestamps too */
 				has_timestamps = TRUE;
 				JANUS_LOG(LOG_VERB, "New .mjr format, will parse timestamps too\n");
 			}
@@ -0,0 +1,171 @@
+/*! \file    mjrs2mjr.c
+ * \author   Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief    Helper tool to split muxed .mjrs recordings into .mjr files
+ * \details  When a shared recording sink is in use (e.g., the \c rec_shared
+ * option in the VideoRoom plugin), all the recordings of a context are
+ * interleaved in a single muxed .mjrs file, rather than saved to one .mjr
+ * file per stream. The \c mjrs2mjr tool is a simple utility that splits
+ * such a muxed file back into standalone .mjr files, one per stream, so
+ * that they can be processed with \c janus-pp-rec as usual.
+ *
+ * Using the utility is quite simple. Just pass, as arguments to the tool,
+ * the path to the .mjrs source file, and the base path to use for the
+ * destination files, e.g.:
+ *
+\verbatim
+./mjrs2mjr /path/to/source.mjrs /path/to/destination-base
+\endverbatim
+ *
+ * This will create one \c destination-base-N.mjr file for each stream
+ * found in the muxed file, where \c N is the stream ID.
+ *
+ * \ingroup postprocessing
+ * \ref postprocessing
+ */
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <signal.h>
+
+#include <glib.h>
+
+#include "../debug.h"
+#include "../version.h"
+
+int janus_log_level = 4;
+gboolean janus_log_timestamps = FALSE;
+gboolean janus_log_colors = TRUE;
+char *janus_log_global_prefix = NULL;
+int lock_debug = 0;
+
+int working = 0;
+
+
+/* Signal handler */
+static void janus_pp_handle_signal(int signum) {
+	working = 0;
+}
+
+/* Helper to close the file of a demuxed stream */
+static void janus_pp_close_stream(gpointer data) {
+	FILE *outfile = (FILE *)data;
+	if(outfile != NULL)
+		fclose(outfile);
+}
+
+
+/* Main Code */
+int main(int argc, char *argv[]) {
+	janus_log_init(FALSE, TRUE, NULL);
+	atexit(janus_log_destroy);
+
+	JANUS_LOG(LOG_INFO, "Janus version: %d (%s)\n", janus_version, janus_version_string);
+	JANUS_LOG(LOG_INFO, "Janus commit: %s\n", janus_build_git_sha);
+	JANUS_LOG(LOG_INFO, "Compiled on:  %s\n\n", janus_build_git_time);
+
+	/* Evaluate arguments */
+	if(argc != 3) {
+		JANUS_LOG(LOG_INFO, "Usage: %s source.mjrs destination-base\n", argv[0]);
+		exit(1);
+	}
+	char *source = NULL, *destination = NULL;
+	source = argv[1];
+	destination = argv[2];
+	JANUS_LOG(LOG_INFO, "%s --> %s-<stream>.mjr\n", source, destination);
+
+	/* Open the source file */
+	FILE *file = fopen(source, "rb");
+	if(file == NULL) {
+		JANUS_LOG(LOG_ERR, "Could not open file %s\n", source);
+		exit(1);
+	}
+	fseek(file, 0L, SEEK_END);
+	long fsize = ftell(file);
+	fseek(file, 0L, SEEK_SET);
+	JANUS_LOG(LOG_INFO, "File is %zu bytes\n", fsize);
+
+	/* Check the file header */
+	char prebuffer[8];
+	memset(prebuffer, 0, sizeof(prebuffer));
+	size_t bytes = fread(prebuffer, sizeof(char), 8, file);
+	if(bytes != 8 || memcmp(prebuffer, "MJRM0001", 8) != 0) {
+		fclose(file);
+		JANUS_LOG(LOG_ERR, "Not a muxed .mjrs recording...\n");
+		exit(1);
+	}
+
+	/* Handle SIGINT */
+	working = 1;
+	signal(SIGINT, janus_pp_handle_signal);
+
+	/* Iterate on all records, and demux them to the target files */
+	GHashTable *streams = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)janus_pp_close_stream);
+	char copybuffer[1500], filename[1024];
+	long offset = 8;
+	uint16_t stream_id = 0;
+	uint32_t len = 0;
+	while(working && offset < fsize) {
+		/* Read the record header: marker, stream ID and length */
+		fseek(file, offset, SEEK_SET);
+		bytes = fread(prebuffer, sizeof(char), 4, file);
+		if(bytes != 4 || memcmp(prebuffer, "MUXF", 4) != 0) {
+			JANUS_LOG(LOG_WARN, "Invalid record at offset %ld (%s), the processing will stop here...\n",
+				offset, bytes != 4 ? "not enough bytes" : "wrong prefix");
+			break;
+		}
+		offset += 4;
+		bytes = fread(&stream_id, sizeof(uint16_t), 1, file);
+		stream_id = ntohs(stream_id);
+		offset += 2;
+		bytes = fread(&len, sizeof(uint32_t), 1, file);
+		len = ntohl(len);
+		offset += 4;
+		if(len == 0 || offset + (long)len > fsize) {
+			JANUS_LOG(LOG_WARN, "Invalid record length %"SCNu32" at offset %ld, the processing will stop here...\n",
+				len, offset);
+			break;
+		}
+		/* Make sure we have a target file for this stream */
+		FILE *outfile = g_hash_table_lookup(streams, GUINT_TO_POINTER(stream_id));
+		if(outfile == NULL) {
+			g_snprintf(filename, sizeof(filename), "%s-%"SCNu16".mjr", destination, stream_id);
+			outfile = fopen(filename, "wb");
+			if(outfile == NULL) {
+				JANUS_LOG(LOG_ERR, "Couldn't open output file %s\n", filename);
+				break;
+			}
+			JANUS_LOG(LOG_INFO, "New stream #%"SCNu16" --> %s\n", stream_id, filename);
+			/* Streams carry the same bytes a standalone recording would, so
+			 * we just need to prefix them with the .mjr file header */
+			fwrite("MJR00002", sizeof(char), 8, outfile);
+			g_hash_table_insert(streams, GUINT_TO_POINTER(stream_id), outfile);
+		}
+		/* Copy the record payload as it is */
+		uint32_t tot = len;
+		while(working && tot > 0) {
+			bytes = fread(copybuffer, sizeof(char), tot > sizeof(copybuffer) ? sizeof(copybuffer) : tot, file);
+			if(bytes == 0) {
+				JANUS_LOG(LOG_ERR, "Error reading record payload...\n");
+				working = 0;
+				break;
+			}
+			if(fwrite(copybuffer, sizeof(char), bytes, outfile) != bytes) {
+				JANUS_LOG(LOG_ERR, "Error writing record payload...\n");
+				working = 0;
+				break;
+			}
+			tot -= bytes;
+		}
+		offset += len;
+	}
+	/* We're done */
+	JANUS_LOG(LOG_INFO, "Demuxed %u stream(s)\n", g_hash_table_size(streams));
+	g_hash_table_destroy(streams);
+	fclose(file);
+
+	JANUS_LOG(LOG_INFO, "Bye!\n");
+	return 0;
+}
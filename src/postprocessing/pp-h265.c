@@ -161,6 +161,38 @@ static uint32_t janus_pp_h265_eg_decode(uint8_t *base, uint32_t *offset) {
 	return res-1;
 }
 
+/* Helper to remove the Emulation Prevention bytes from a NAL unit: rather
+ * than walking the buffer a byte at a time, we let memchr (which C libraries
+ * typically vectorize) skip in bulk to the next zero, since anything before
+ * that can't be part of a 00 00 03 sequence; returns the new length */
+static int janus_pp_h265_remove_emulation(uint8_t *buffer, int len) {
+	uint8_t *end = buffer + len;
+	uint8_t *read = buffer, *write = buffer, *next = NULL;
+	while(read < end) {
+		next = memchr(read, 0x00, end - read);
+		if(next == NULL)
+			next = end;
+		if(next > read) {
+			/* Copy the chunk that can't contain emulation prevention bytes */
+			if(write != read)
+				memmove(write, read, next - read);
+			write += next - read;
+			read = next;
+			continue;
+		}
+		/* We're on a zero: check if an emulation prevention byte follows */
+		if(end - read >= 3 && read[1] == 0x00 && read[2] == 0x03) {
+			/* Found one: keep the two zeros and get rid of the 0x03 */
+			*write++ = 0x00;
+			*write++ = 0x00;
+			read += 3;
+		} else {
+			*write++ = *read++;
+		}
+	}
+	return write - buffer;
+}
+
 /* Helper to parse a SPS (only to get the video resolution) */
 static void janus_pp_h265_parse_sps(char *buffer, int *width, int *height) {
 	/* Get the layer ID first */
@@ -293,26 +325,7 @@ int janus_pp_h265_preprocess(FILE *file, janus_pp_frame_packet *list, json_t *in
 			/* SPS */
 			JANUS_LOG(LOG_HUGE, "[SPS] %u/%u/%u/%u\n", fbit, type, lid, tid);
 			/* Get rid of the Emulation Prevention code, if present */
-			int i = 0, j = 0, zeros = 0;
-			for(i=0; i<len; i++) {
-				if(zeros == 2 && prebuffer[i] == 0x03) {
-					/* Found, get rid of it */
-					i++;
-					zeros = 0;
-				}
-				/* Update the content of the buffer as we go along */
-				prebuffer[j] = prebuffer[i];
-				if(prebuffer[i] == 0x00) {
-					/* Found a zero, may be part of a start code */
-					zeros++;
-				} else {
-					/* Not a zero, so not the beginning of a start code */
-					zeros = 0;
-				}
-				j++;
-			}
-			/* Update the length of the buffer */
-			len = j;
+			len = janus_pp_h265_remove_emulation((uint8_t *)prebuffer, len);
 			/* Parse to get width/height */
 			int width = 0, height = 0;
 			janus_pp_h265_parse_sps(prebuffer, &width, &height);
@@ -361,24 +374,7 @@ int janus_pp_h265_preprocess(FILE *file, janus_pp_frame_packet *list, json_t *in
 					case 33:
 						JANUS_LOG(LOG_HUGE, "[SPS] %u/%u/%u/%u\n", fbit, type, lid, tid);
 						/* Get rid of the Emulation Prevention code, if present */
-						int i = 0, j = 0, zeros = 0;
-						for(i=0; i<payload_len; i++) {
-							if(zeros == 2 && p[i] == 0x03) {
-								/* Found, get rid of it */
-								i++;
-								zeros = 0;
-							}
-							/* Update the content of the buffer as we go along */
-							p[j] = p[i];
-							if(p[i] == 0x00) {
-								/* Found a zero, may be part of a start code */
-								zeros++;
-							} else {
-								/* Not a zero, so not the beginning of a start code */
-								zeros = 0;
-							}
-							j++;
-						}
+						janus_pp_h265_remove_emulation(p, payload_len);
 						/* Parse to get width/height */
 						int width = 0, height = 0;
 						janus_pp_h265_parse_sps((char*)p, &width, &height);
@@ -37,6 +37,8 @@ gboolean janus_pprec_options_parse(janus_pprec_options *options, int argc, char
 		{ "restamp", 'r', 0, G_OPTION_ARG_INT, &options->restamp_multiplier, "If the latency of a packet is bigger than the `moving_average_latency * (<restamp>/1000)` the timestamps will be corrected, disabled if 0 (default=0)", NULL },
 		{ "restamp-packets", 'c', 0, G_OPTION_ARG_INT, &options->restamp_packets, "Number of packets used for calculating moving average latency for timestamp correction (default=10)", NULL },
 		{ "restamp-min-th", 'n', 0, G_OPTION_ARG_INT, &options->restamp_min_th, "Minimum latency of moving average to reach before starting to correct timestamps. (default=500)", NULL },
+		{ "parallel", 'N', 0, G_OPTION_ARG_INT, &options->parallel, "Process multiple source files in parallel with this many worker processes; requires --format, as the target names are derived from the sources (default=0, process a single file)", NULL },
+		{ "follow", 'w', 0, G_OPTION_ARG_NONE, &options->follow, "Follow mode: keep waiting for new packets if the source file is still being written to, and process it as it grows (default=off)", NULL },
 		{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_STRING_ARRAY, &options->paths, NULL, NULL },
 		{ NULL, 0, 0, 0, NULL, NULL, NULL },
 	};
@@ -37,6 +37,8 @@ typedef struct janus_pprec_options {
 	int restamp_multiplier;
 	int restamp_min_th;
 	int restamp_packets;
+	int parallel;
+	gboolean follow;
 	char **paths;
 } janus_pprec_options;
 
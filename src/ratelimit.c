@@ -0,0 +1,49 @@
+/*! \file    ratelimit.c
+ * \author   Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief    Rate limiting helpers
+ * \details  Implementation of simple rate limiters the core can put in
+ * front of hot paths, e.g., to protect the Janus API from request floods
+ * or media loops from publishers sending at arbitrary packet rates.
+ *
+ * \ingroup core
+ * \ref core
+ */
+
+#include "ratelimit.h"
+#include "utils.h"
+
+void janus_rate_limiter_init(janus_rate_limiter *limiter, int rate) {
+	if(limiter == NULL)
+		return;
+	limiter->rate = rate > 0 ? rate : 0;
+	g_atomic_int_set(&limiter->window, 0);
+	g_atomic_int_set(&limiter->count, 0);
+	g_atomic_int_set(&limiter->limited, 0);
+}
+
+gboolean janus_rate_limiter_consume(janus_rate_limiter *limiter) {
+	if(limiter == NULL || limiter->rate == 0)
+		return TRUE;
+	gint now = (gint)(janus_get_monotonic_time() / G_USEC_PER_SEC);
+	gint window = g_atomic_int_get(&limiter->window);
+	if(window != now && g_atomic_int_compare_and_exchange(&limiter->window, window, now)) {
+		/* We're the ones starting the new window: units consumed by other
+		 * threads between the exchange and this reset may get lost, which
+		 * just means we may sporadically allow slightly more than the
+		 * configured rate, never less */
+		g_atomic_int_set(&limiter->count, 0);
+	}
+	if(g_atomic_int_add(&limiter->count, 1) >= limiter->rate)
+		return FALSE;
+	/* Allowed: in case we had tripped before, arm the edge detector again */
+	if(g_atomic_int_get(&limiter->limited))
+		g_atomic_int_set(&limiter->limited, 0);
+	return TRUE;
+}
+
+gboolean janus_rate_limiter_tripped(janus_rate_limiter *limiter) {
+	if(limiter == NULL)
+		return FALSE;
+	return g_atomic_int_compare_and_exchange(&limiter->limited, 0, 1);
+}
@@ -0,0 +1,49 @@
+/*! \file    ratelimit.h
+ * \author   Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief    Rate limiting helpers (headers)
+ * \details  Implementation of simple rate limiters the core can put in
+ * front of hot paths, e.g., to protect the Janus API from request floods
+ * or media loops from publishers sending at arbitrary packet rates. The
+ * accounting is done over fixed one-second windows, and consuming from a
+ * limiter only involves a couple of atomic operations, so limiters can be
+ * checked on a per-packet basis without adding locks to the paths they
+ * protect.
+ *
+ * \ingroup core
+ * \ref core
+ */
+
+#ifndef JANUS_RATELIMIT_H
+#define JANUS_RATELIMIT_H
+
+#include <glib.h>
+
+/*! \brief Rate limiter instance */
+typedef struct janus_rate_limiter {
+	/*! \brief Allowed units (requests, packets) per second, 0 means unlimited */
+	gint rate;
+	/*! \brief Second the current accounting window started at */
+	volatile gint window;
+	/*! \brief Units consumed in the current window */
+	volatile gint count;
+	/*! \brief Whether the limiter is currently rejecting traffic */
+	volatile gint limited;
+} janus_rate_limiter;
+
+/*! \brief Helper to (re)initialize a rate limiter
+ * @param[in] limiter The limiter to initialize
+ * @param[in] rate The allowed units per second, 0 to disable the limiter */
+void janus_rate_limiter_init(janus_rate_limiter *limiter, int rate);
+/*! \brief Helper to consume one unit from a rate limiter
+ * @param[in] limiter The limiter to consume from
+ * @returns TRUE if the unit was allowed, FALSE if the rate has been exceeded */
+gboolean janus_rate_limiter_consume(janus_rate_limiter *limiter);
+/*! \brief Helper to check whether a limiter just started rejecting traffic,
+ * which callers can use to log or notify violations edge-triggered, rather
+ * than once per rejected unit
+ * @param[in] limiter The limiter to check
+ * @returns TRUE only for the first rejection since the limiter last allowed traffic */
+gboolean janus_rate_limiter_tripped(janus_rate_limiter *limiter);
+
+#endif
@@ -20,27 +20,105 @@
 #include <arpa/inet.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <libgen.h>
+#include <unistd.h>
 
 #include <glib.h>
 #include <jansson.h>
 
 #include "record.h"
 #include "debug.h"
+#include "events.h"
 #include "utils.h"
 
 
 /* Info header in the structured recording */
 static const char *header = "MJR00002";
+/* Info header we use when the indexed v3 format is enabled */
+static const char *header_v3 = "MJR00003";
 /* Frame header in the structured recording */
 static const char *frame_header = "MEET";
+/* Marker of the block index, and of its trailer, in indexed recordings */
+static const char *index_marker = "MJRI";
+/* Info header in a muxed recording (shared sink) */
+static const char *mux_header = "MJRM0001";
+/* Per-frame demux prefix in a muxed recording */
+static const char *mux_marker = "MUXF";
 
 /* Whether the filenames should have a temporary extension, while saving, or not (default=false) */
 static gboolean rec_tempname = FALSE;
 /* Extension to add in case tempnames is true (default="tmp" --> ".tmp") */
 static char *rec_tempext = NULL;
+/* How often open recordings should be fsync-ed to disk, in seconds (default=0, only rely on the OS) */
+static int rec_fsync = 0;
+/* Whether new recordings should use the indexed v3 format (default=false) */
+static gboolean rec_indexed = FALSE;
+/* How often a block index entry (timestamp --> file offset) is added, in frames */
+#define JANUS_RECORDER_INDEX_INTERVAL	100
+/* Size of the extents we preallocate as an indexed recording grows */
+#define JANUS_RECORDER_EXTENT_SIZE		(16*1024*1024)
+/* Size of the stdio buffer we use for recording files, so that the writer
+ * thread hits the disk with fewer, larger sequential writes, rather than
+ * with one small write per frame */
+#define JANUS_RECORDER_WRITE_BUFFER		(256*1024)
 
-void janus_recorder_init(gboolean tempnames, const char *extension) {
+/* Frames are serialized in the media path, but actually written to disk
+ * by a dedicated writer thread, so that media threads never block on I/O
+ * (e.g., when saving to a network mounted folder that hiccups) */
+typedef struct janus_recorder_frame {
+	/* Recorder instance the frame belongs to */
+	janus_recorder *recorder;
+	/* Serialized frame (frame header and payload) */
+	char *buffer;
+	/* Size of the serialized frame */
+	int length;
+	/* Frame timestamp (network order), in case a block index entry is due */
+	uint32_t timestamp;
+	/* Offset of the frame header in the buffer (the first frame is prefixed by the JSON header) */
+	int skip;
+} janus_recorder_frame;
+static GAsyncQueue *frames = NULL;
+static janus_recorder_frame exit_frame;
+static GThread *writer_thread = NULL;
+static void *janus_recorder_writer(void *data);
+/* How many frames a single recorder can have waiting for the writer
+ * thread, before we start dropping them */
+#define JANUS_RECORDER_QUEUE_MAX	500
+
+/* Registry of all the recorder instances that are around, so that we
+ * can close and flush the open ones all at once when shutting down */
+static GHashTable *recorders = NULL;
+static janus_mutex recorders_mutex = JANUS_MUTEX_INITIALIZER;
+
+/* When a write budget is configured, recordings saved to the same volume
+ * (device) share an accounting entry: we track the aggregate write rate
+ * over one second windows, and when a volume goes over its budget we drop
+ * frames recorded to it until it's back within, so that a saturated disk
+ * only slows down the recordings on it, instead of starving reads (e.g.,
+ * Record&Play playbacks) and writes for everyone sharing it */
+struct janus_recorder_volume {
+	/* Device ID this volume entry refers to */
+	dev_t device;
+	/* When the current accounting window started */
+	gint64 window_started;
+	/* Bytes accounted for in the current window */
+	gint bytes;
+	/* Whether someone is already closing the current window */
+	volatile gint checking;
+	/* Whether this volume is currently over its write budget */
+	volatile gint exceeded;
+	/* Frames dropped since this volume last went over budget */
+	volatile gint throttled;
+	/* Frames dropped because of the write budget since startup */
+	guint64 throttled_total;
+};
+static GHashTable *volumes = NULL;
+static janus_mutex volumes_mutex = JANUS_MUTEX_INITIALIZER;
+/* The write budget each volume gets, in bytes per second (0 = unlimited) */
+static gint64 rec_write_budget = 0;
+
+void janus_recorder_init(gboolean tempnames, const char *extension, int fsync_secs, gboolean indexed, int write_budget) {
 	JANUS_LOG(LOG_INFO, "Initializing recorder code\n");
 	if(tempnames) {
 		rec_tempname = TRUE;
@@ -52,16 +130,298 @@ void janus_recorder_init(gboolean tempnames, const char *extension) {
 			JANUS_LOG(LOG_INFO, "  -- Using temporary extension .%s\n", rec_tempext);
 		}
 	}
+	if(fsync_secs > 0) {
+		rec_fsync = fsync_secs;
+		JANUS_LOG(LOG_INFO, "  -- Will fsync open recordings every %d seconds\n", rec_fsync);
+	}
+	if(indexed) {
+		rec_indexed = TRUE;
+		JANUS_LOG(LOG_INFO, "  -- Will save recordings in the indexed v3 format\n");
+	}
+	if(write_budget > 0) {
+		rec_write_budget = ((gint64)write_budget)*1024*1024;
+		JANUS_LOG(LOG_INFO, "  -- Will budget recording writes to %d MB/s per volume\n", write_budget);
+		janus_mutex_lock(&volumes_mutex);
+		if(volumes == NULL)
+			volumes = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+				(GDestroyNotify)g_free, (GDestroyNotify)g_free);
+		janus_mutex_unlock(&volumes_mutex);
+	}
+	janus_mutex_lock(&recorders_mutex);
+	if(recorders == NULL)
+		recorders = g_hash_table_new(NULL, NULL);
+	janus_mutex_unlock(&recorders_mutex);
+	/* Launch the thread that will actually write frames to disk */
+	frames = g_async_queue_new();
+	GError *error = NULL;
+	writer_thread = g_thread_try_new("recorder writer", janus_recorder_writer, NULL, &error);
+	if(error != NULL) {
+		JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the recorder writer thread, frames will be written synchronously...\n",
+			error->code, error->message ? error->message : "??");
+		g_error_free(error);
+		g_async_queue_unref(frames);
+		frames = NULL;
+	}
 }
 
 void janus_recorder_deinit(void) {
 	rec_tempname = FALSE;
 	g_free(rec_tempext);
+	if(writer_thread != NULL) {
+		g_async_queue_push(frames, &exit_frame);
+		g_thread_join(writer_thread);
+		writer_thread = NULL;
+	}
+	if(frames != NULL) {
+		g_async_queue_unref(frames);
+		frames = NULL;
+	}
+	janus_mutex_lock(&recorders_mutex);
+	g_clear_pointer(&recorders, g_hash_table_destroy);
+	janus_mutex_unlock(&recorders_mutex);
+	rec_write_budget = 0;
+	janus_mutex_lock(&volumes_mutex);
+	g_clear_pointer(&volumes, g_hash_table_destroy);
+	janus_mutex_unlock(&volumes_mutex);
+}
+
+static void *janus_recorder_writer(void *data) {
+	JANUS_LOG(LOG_VERB, "Recorder writer thread started\n");
+	janus_recorder_frame *frame = NULL;
+	while((frame = g_async_queue_pop(frames)) != NULL) {
+		if(frame == &exit_frame)
+			break;
+		janus_recorder *recorder = frame->recorder;
+		if(recorder->sink != NULL) {
+			/* This recorder is enrolled in a shared sink: interleave the
+			 * frame in the shared file, with a demux prefix */
+			janus_recorder_sink *sink = recorder->sink;
+			uint16_t stream_id = htons(recorder->stream_id);
+			uint32_t mux_len = htonl((uint32_t)frame->length);
+			size_t res = fwrite(mux_marker, sizeof(char), strlen(mux_marker), sink->file);
+			res += fwrite(&stream_id, sizeof(uint16_t), 1, sink->file);
+			res += fwrite(&mux_len, sizeof(uint32_t), 1, sink->file);
+			res += fwrite(frame->buffer, sizeof(char), frame->length, sink->file);
+			if(res != strlen(mux_marker) + 2 + (size_t)frame->length) {
+				JANUS_LOG(LOG_ERR, "Error saving frame... (%s)\n", g_strerror(errno));
+			}
+			if(rec_fsync > 0) {
+				/* A periodic fsync policy is set, check if it's time to sync the shared file */
+				gint64 now = janus_get_monotonic_time();
+				if(now - sink->last_fsync >= ((gint64)rec_fsync)*G_USEC_PER_SEC) {
+					fflush(sink->file);
+					fsync(fileno(sink->file));
+					sink->last_fsync = now;
+				}
+			}
+			g_free(frame->buffer);
+			(void)g_atomic_int_dec_and_test(&recorder->pending);
+			janus_refcount_decrease(&recorder->ref);
+			g_free(frame);
+			continue;
+		}
+		if(recorder->indexed) {
+			long pos = ftell(recorder->file);
+			if(recorder->index != NULL && (recorder->frames_written % JANUS_RECORDER_INDEX_INTERVAL) == 0) {
+				/* Add a block index entry (timestamp --> file offset) for this frame */
+				uint64_t foffset = htonll((uint64_t)(pos + frame->skip));
+				g_byte_array_append(recorder->index, (guint8 *)&frame->timestamp, sizeof(uint32_t));
+				g_byte_array_append(recorder->index, (guint8 *)&foffset, sizeof(uint64_t));
+			}
+			recorder->frames_written++;
+			if(recorder->allocated > 0 && pos + frame->length > recorder->allocated) {
+				/* We're about to outgrow the preallocated space, add a new extent */
+				if(posix_fallocate(fileno(recorder->file), recorder->allocated, JANUS_RECORDER_EXTENT_SIZE) == 0)
+					recorder->allocated += JANUS_RECORDER_EXTENT_SIZE;
+			}
+		}
+		size_t res = fwrite(frame->buffer, sizeof(char), frame->length, recorder->file);
+		if(res != (size_t)frame->length) {
+			JANUS_LOG(LOG_ERR, "Error saving frame... (%s)\n", g_strerror(errno));
+		}
+		if(rec_fsync > 0) {
+			/* A periodic fsync policy is set, check if it's time to sync this recording */
+			gint64 now = janus_get_monotonic_time();
+			if(now - recorder->last_fsync >= ((gint64)rec_fsync)*G_USEC_PER_SEC) {
+				fflush(recorder->file);
+				fsync(fileno(recorder->file));
+				recorder->last_fsync = now;
+			}
+		}
+		g_free(frame->buffer);
+		(void)g_atomic_int_dec_and_test(&recorder->pending);
+		janus_refcount_decrease(&recorder->ref);
+		g_free(frame);
+	}
+	JANUS_LOG(LOG_VERB, "Leaving recorder writer thread\n");
+	return NULL;
+}
+
+/* Helper to get (creating it, if needed) the write accounting entry for the
+ * volume a recording file lives on: returns NULL if no budget is configured */
+static janus_recorder_volume *janus_recorder_volume_get(FILE *file) {
+	if(rec_write_budget == 0 || file == NULL)
+		return NULL;
+	struct stat s;
+	if(fstat(fileno(file), &s) < 0) {
+		JANUS_LOG(LOG_WARN, "fstat error: %d (%s), can't budget writes for this recording\n", errno, g_strerror(errno));
+		return NULL;
+	}
+	gint64 device = (gint64)s.st_dev;
+	janus_mutex_lock(&volumes_mutex);
+	if(volumes == NULL) {
+		janus_mutex_unlock(&volumes_mutex);
+		return NULL;
+	}
+	janus_recorder_volume *volume = g_hash_table_lookup(volumes, &device);
+	if(volume == NULL) {
+		volume = g_malloc0(sizeof(janus_recorder_volume));
+		volume->device = s.st_dev;
+		volume->window_started = janus_get_monotonic_time();
+		gint64 *key = g_malloc(sizeof(gint64));
+		*key = device;
+		g_hash_table_insert(volumes, key, volume);
+	}
+	janus_mutex_unlock(&volumes_mutex);
+	return volume;
+}
+
+/* Helper to account for bytes we're about to record to a volume, and check
+ * whether its write budget is being respected: returns TRUE if the frame
+ * should be dropped instead, to bring the volume back within its budget.
+ * Notice that, since dropped frames are not accounted for, a volume that's
+ * over budget will measure a low rate in the next window and clear the flag
+ * again: the net effect is duty-cycling the recorders writing to it, so
+ * that the average write rate stays around the configured budget */
+static gboolean janus_recorder_volume_account(janus_recorder_volume *volume, int bytes) {
+	if(volume == NULL)
+		return FALSE;
+	gint64 now = janus_get_monotonic_time();
+	gint64 elapsed = now - volume->window_started;
+	if(elapsed >= G_USEC_PER_SEC && g_atomic_int_compare_and_exchange(&volume->checking, 0, 1)) {
+		/* Close the window and compute the aggregate write rate on this volume */
+		gint written = g_atomic_int_and(&volume->bytes, 0);
+		volume->window_started = now;
+		gint64 rate = ((gint64)written)*G_USEC_PER_SEC/elapsed;
+		gboolean exceeded = (rate > rec_write_budget);
+		if(exceeded != (g_atomic_int_get(&volume->exceeded) == 1)) {
+			g_atomic_int_set(&volume->exceeded, exceeded ? 1 : 0);
+			if(exceeded) {
+				JANUS_LOG(LOG_WARN, "Volume %"SCNu64" is over its recording write budget (%"SCNi64" > %"SCNi64" bytes/s), dropping frames\n",
+					(uint64_t)volume->device, rate, rec_write_budget);
+			} else {
+				gint throttled = g_atomic_int_and(&volume->throttled, 0);
+				volume->throttled_total += throttled;
+				JANUS_LOG(LOG_WARN, "Volume %"SCNu64" is back within its recording write budget, %d frame(s) were dropped (%"SCNu64" since startup)\n",
+					(uint64_t)volume->device, throttled, volume->throttled_total);
+			}
+		}
+		g_atomic_int_set(&volume->checking, 0);
+	}
+	if(g_atomic_int_get(&volume->exceeded)) {
+		g_atomic_int_inc(&volume->throttled);
+		return TRUE;
+	}
+	g_atomic_int_add(&volume->bytes, bytes);
+	return FALSE;
+}
+
+static void janus_recorder_sink_free(const janus_refcount *sink_ref) {
+	janus_recorder_sink *sink = janus_refcount_containerof(sink_ref, janus_recorder_sink, ref);
+	/* This sink can be destroyed, free all the resources */
+	g_free(sink->dir);
+	sink->dir = NULL;
+	g_free(sink->filename);
+	sink->filename = NULL;
+	if(sink->file != NULL) {
+		fflush(sink->file);
+		fsync(fileno(sink->file));
+		fclose(sink->file);
+	}
+	sink->file = NULL;
+	janus_mutex_destroy(&sink->mutex);
+	g_free(sink);
+}
+
+janus_recorder_sink *janus_recorder_sink_create(const char *dir, const char *filename) {
+	if(filename == NULL) {
+		JANUS_LOG(LOG_ERR, "Missing filename for the shared recording sink\n");
+		return NULL;
+	}
+	if(dir != NULL) {
+		/* Check if this directory exists, and create it if needed */
+		struct stat s;
+		int err = stat(dir, &s);
+		if(err == -1) {
+			if(ENOENT == errno) {
+				/* Directory does not exist, try creating it */
+				if(janus_mkdir(dir, 0755) < 0) {
+					JANUS_LOG(LOG_ERR, "mkdir (%s) error: %d (%s)\n", dir, errno, g_strerror(errno));
+					return NULL;
+				}
+			} else {
+				JANUS_LOG(LOG_ERR, "stat (%s) error: %d (%s)\n", dir, errno, g_strerror(errno));
+				return NULL;
+			}
+		} else if(!S_ISDIR(s.st_mode)) {
+			/* File exists but it's not a directory? */
+			JANUS_LOG(LOG_ERR, "Not a directory? %s\n", dir);
+			return NULL;
+		}
+	}
+	char path[1024];
+	memset(path, 0, 1024);
+	if(dir != NULL) {
+		g_snprintf(path, 1024, "%s/%s", dir, filename);
+	} else {
+		g_snprintf(path, 1024, "%s", filename);
+	}
+	/* Make sure folder to save to is not protected */
+	if(janus_is_folder_protected(path)) {
+		JANUS_LOG(LOG_ERR, "Target recording path '%s' is in protected folder...\n", path);
+		return NULL;
+	}
+	FILE *file = fopen(path, "wb");
+	if(file == NULL) {
+		JANUS_LOG(LOG_ERR, "fopen error: %d\n", errno);
+		return NULL;
+	}
+	/* Use a large stdio buffer, so that frames reach the disk in fewer,
+	 * larger sequential writes, rather than in one small write each */
+	setvbuf(file, NULL, _IOFBF, JANUS_RECORDER_WRITE_BUFFER);
+	/* Write the muxed header */
+	size_t res = fwrite(mux_header, sizeof(char), strlen(mux_header), file);
+	if(res != strlen(mux_header)) {
+		JANUS_LOG(LOG_ERR, "Couldn't write .mjrs header (%zu != %zu, %s)\n",
+			res, strlen(mux_header), g_strerror(errno));
+		fclose(file);
+		return NULL;
+	}
+	janus_recorder_sink *sink = g_malloc0(sizeof(janus_recorder_sink));
+	janus_refcount_init(&sink->ref, janus_recorder_sink_free);
+	sink->dir = dir ? g_strdup(dir) : NULL;
+	sink->filename = g_strdup(filename);
+	sink->file = file;
+	sink->next_stream = 1;
+	sink->last_fsync = janus_get_monotonic_time();
+	janus_mutex_init(&sink->mutex);
+	g_atomic_int_set(&sink->destroyed, 0);
+	return sink;
+}
+
+void janus_recorder_sink_destroy(janus_recorder_sink *sink) {
+	if(!sink || !g_atomic_int_compare_and_exchange(&sink->destroyed, 0, 1))
+		return;
+	janus_refcount_decrease(&sink->ref);
 }
 
 static void janus_recorder_free(const janus_refcount *recorder_ref) {
 	janus_recorder *recorder = janus_refcount_containerof(recorder_ref, janus_recorder, ref);
 	/* This recorder can be destroyed, free all the resources */
+	janus_mutex_lock(&recorders_mutex);
+	if(recorders != NULL)
+		g_hash_table_remove(recorders, recorder);
+	janus_mutex_unlock(&recorders_mutex);
 	janus_recorder_close(recorder);
 	g_free(recorder->dir);
 	recorder->dir = NULL;
@@ -76,35 +436,45 @@ static void janus_recorder_free(const janus_refcount *recorder_ref) {
 	recorder->fmtp = NULL;
 	if(recorder->extensions != NULL)
 		g_hash_table_destroy(recorder->extensions);
+	if(recorder->index != NULL)
+		g_byte_array_free(recorder->index, TRUE);
+	if(recorder->sink != NULL)
+		janus_refcount_decrease(&recorder->sink->ref);
 	janus_mutex_destroy(&recorder->mutex);
 	g_free(recorder);
 }
 
-janus_recorder *janus_recorder_create(const char *dir, const char *codec, const char *filename) {
-	/* Same as janus_recorder_create_full, but with no fmtp */
-	return janus_recorder_create_full(dir, codec, NULL, filename);
-}
-janus_recorder *janus_recorder_create_full(const char *dir, const char *codec, const char *fmtp, const char *filename) {
-	janus_recorder_medium type = JANUS_RECORDER_AUDIO;
-	if(codec == NULL) {
+static int janus_recorder_medium_find(const char *codec, janus_recorder_medium *type) {
+	if(codec == NULL || type == NULL) {
 		JANUS_LOG(LOG_ERR, "Missing codec information\n");
-		return NULL;
+		return -1;
 	}
 	if(!strcasecmp(codec, "vp8") || !strcasecmp(codec, "vp9") || !strcasecmp(codec, "h264")
 			 || !strcasecmp(codec, "av1") || !strcasecmp(codec, "h265")) {
-		type = JANUS_RECORDER_VIDEO;
+		*type = JANUS_RECORDER_VIDEO;
 	} else if(!strcasecmp(codec, "opus") || !strcasecmp(codec, "multiopus")
 			|| !strcasecmp(codec, "g711") || !strcasecmp(codec, "pcmu") || !strcasecmp(codec, "pcma")
 			|| !strcasecmp(codec, "g722") || !strcasecmp(codec, "l16-48") || !strcasecmp(codec, "l16")) {
-		type = JANUS_RECORDER_AUDIO;
+		*type = JANUS_RECORDER_AUDIO;
 	} else if(!strcasecmp(codec, "text") || !strcasecmp(codec, "binary")) {
 		/* Data channels may be text or binary, so that's what we can save too */
-		type = JANUS_RECORDER_DATA;
+		*type = JANUS_RECORDER_DATA;
 	} else {
 		/* We don't recognize the codec: while we might go on anyway, we'd rather fail instead */
 		JANUS_LOG(LOG_ERR, "Unsupported codec '%s'\n", codec);
-		return NULL;
+		return -1;
 	}
+	return 0;
+}
+
+janus_recorder *janus_recorder_create(const char *dir, const char *codec, const char *filename) {
+	/* Same as janus_recorder_create_full, but with no fmtp */
+	return janus_recorder_create_full(dir, codec, NULL, filename);
+}
+janus_recorder *janus_recorder_create_full(const char *dir, const char *codec, const char *fmtp, const char *filename) {
+	janus_recorder_medium type = JANUS_RECORDER_AUDIO;
+	if(janus_recorder_medium_find(codec, &type) < 0)
+		return NULL;
 	/* Create the recorder */
 	janus_recorder *rc = g_malloc0(sizeof(janus_recorder));
 	janus_refcount_init(&rc->ref, janus_recorder_free);
@@ -116,6 +486,8 @@ janus_recorder *janus_recorder_create_full(const char *dir, const char *codec, c
 	rc->fmtp = fmtp ? g_strdup(fmtp) : NULL;
 	rc->description = NULL;
 	rc->created = janus_get_real_time();
+	rc->last_fsync = janus_get_monotonic_time();
+	rc->indexed = rec_indexed;
 	janus_mutex_init(&rc->mutex);
 	const char *rec_dir = NULL;
 	const char *rec_file = NULL;
@@ -231,30 +603,86 @@ janus_recorder *janus_recorder_create_full(const char *dir, const char *codec, c
 		g_free(copy_for_base);
 		return NULL;
 	}
+	/* Use a large stdio buffer, so that the writer thread hits the disk
+	 * with fewer, larger sequential writes, rather than one per frame */
+	setvbuf(rc->file, NULL, _IOFBF, JANUS_RECORDER_WRITE_BUFFER);
+	/* If a write budget is configured, get the accounting entry for the
+	 * volume this file lives on, to enroll the recording in the budget */
+	rc->volume = janus_recorder_volume_get(rc->file);
 	if(rec_dir)
 		rc->dir = g_strdup(rec_dir);
 	rc->filename = g_strdup(newname);
 	rc->type = type;
 	/* Write the first part of the header */
-	size_t res = fwrite(header, sizeof(char), strlen(header), rc->file);
-	if(res != strlen(header)) {
+	const char *file_header = rc->indexed ? header_v3 : header;
+	size_t res = fwrite(file_header, sizeof(char), strlen(file_header), rc->file);
+	if(res != strlen(file_header)) {
 		JANUS_LOG(LOG_ERR, "Couldn't write .mjr header (%zu != %zu, %s)\n",
-			res, strlen(header), g_strerror(errno));
+			res, strlen(file_header), g_strerror(errno));
 		janus_recorder_destroy(rc);
 		g_free(copy_for_parent);
 		g_free(copy_for_base);
 		return NULL;
 	}
 	g_atomic_int_set(&rc->writable, 1);
+	if(rc->indexed) {
+		rc->index = g_byte_array_new();
+		/* Preallocate a first extent, we'll grow it as frames are written */
+		if(posix_fallocate(fileno(rc->file), 0, JANUS_RECORDER_EXTENT_SIZE) == 0)
+			rc->allocated = JANUS_RECORDER_EXTENT_SIZE;
+	}
 	/* We still need to also write the info header first */
 	g_atomic_int_set(&rc->header, 0);
 	/* Done */
 	g_atomic_int_set(&rc->destroyed, 0);
+	janus_mutex_lock(&recorders_mutex);
+	if(recorders != NULL)
+		g_hash_table_insert(recorders, rc, rc);
+	janus_mutex_unlock(&recorders_mutex);
 	g_free(copy_for_parent);
 	g_free(copy_for_base);
 	return rc;
 }
 
+janus_recorder *janus_recorder_create_muxed(janus_recorder_sink *sink, const char *codec, const char *fmtp) {
+	if(sink == NULL || g_atomic_int_get(&sink->destroyed)) {
+		JANUS_LOG(LOG_ERR, "Invalid shared recording sink\n");
+		return NULL;
+	}
+	janus_recorder_medium type = JANUS_RECORDER_AUDIO;
+	if(janus_recorder_medium_find(codec, &type) < 0)
+		return NULL;
+	/* Create the recorder: no dedicated file, we enroll in the shared sink */
+	janus_recorder *rc = g_malloc0(sizeof(janus_recorder));
+	janus_refcount_init(&rc->ref, janus_recorder_free);
+	janus_rtp_switching_context_reset(&rc->context);
+	rc->codec = g_strdup(codec);
+	rc->fmtp = fmtp ? g_strdup(fmtp) : NULL;
+	rc->created = janus_get_real_time();
+	rc->last_fsync = janus_get_monotonic_time();
+	janus_mutex_init(&rc->mutex);
+	janus_refcount_increase(&sink->ref);
+	rc->sink = sink;
+	/* If a write budget is configured, the recording shares the accounting
+	 * entry of the volume the muxed file lives on */
+	rc->volume = janus_recorder_volume_get(sink->file);
+	janus_mutex_lock(&sink->mutex);
+	rc->stream_id = sink->next_stream;
+	sink->next_stream++;
+	janus_mutex_unlock(&sink->mutex);
+	rc->type = type;
+	g_atomic_int_set(&rc->writable, 1);
+	/* We still need to also write the info header first */
+	g_atomic_int_set(&rc->header, 0);
+	/* Done */
+	g_atomic_int_set(&rc->destroyed, 0);
+	janus_mutex_lock(&recorders_mutex);
+	if(recorders != NULL)
+		g_hash_table_insert(recorders, rc, rc);
+	janus_mutex_unlock(&recorders_mutex);
+	return rc;
+}
+
 int janus_recorder_pause(janus_recorder *recorder) {
 	if(!recorder)
 		return -1;
@@ -334,7 +762,7 @@ int janus_recorder_save_frame(janus_recorder *recorder, char *buffer, uint lengt
 		janus_mutex_unlock_nodebug(&recorder->mutex);
 		return -2;
 	}
-	if(!recorder->file) {
+	if(recorder->file == NULL && recorder->sink == NULL) {
 		janus_mutex_unlock_nodebug(&recorder->mutex);
 		return -3;
 	}
@@ -346,7 +774,22 @@ int janus_recorder_save_frame(janus_recorder *recorder, char *buffer, uint lengt
 		janus_mutex_unlock_nodebug(&recorder->mutex);
 		return -5;
 	}
+	if(frames != NULL && g_atomic_int_get(&recorder->pending) >= JANUS_RECORDER_QUEUE_MAX) {
+		/* The writer thread isn't keeping up (slow storage?), drop this frame */
+		g_atomic_int_inc(&recorder->dropped);
+		JANUS_LOG(LOG_HUGE, "Too many frames waiting to be written, dropping frame... (%s)\n", recorder->filename);
+		janus_mutex_unlock_nodebug(&recorder->mutex);
+		return -6;
+	}
+	if(recorder->volume != NULL && janus_recorder_volume_account(recorder->volume, length)) {
+		/* The volume this recording is saved to is over its write budget, drop this frame */
+		g_atomic_int_inc(&recorder->dropped);
+		JANUS_LOG(LOG_HUGE, "Volume over its recording write budget, dropping frame... (%s)\n", recorder->filename);
+		janus_mutex_unlock_nodebug(&recorder->mutex);
+		return -6;
+	}
 	gint64 now = janus_get_monotonic_time();
+	gchar *info_text = NULL;
 	if(!g_atomic_int_get(&recorder->header)) {
 		/* Write info header as a JSON formatted info */
 		json_t *info = json_object();
@@ -392,89 +835,93 @@ int janus_recorder_save_frame(janus_recorder *recorder, char *buffer, uint lengt
 		/* If media will be end-to-end encrypted, mark it in the recording header */
 		if(recorder->encrypted)
 			json_object_set_new(info, "e", json_true());
-		gchar *info_text = json_dumps(info, JSON_PRESERVE_ORDER);
+		info_text = json_dumps(info, JSON_PRESERVE_ORDER);
 		json_decref(info);
 		if(info_text == NULL) {
 			JANUS_LOG(LOG_ERR, "Error converting header to text...\n");
 			janus_mutex_unlock_nodebug(&recorder->mutex);
 			return -5;
 		}
-		uint16_t info_bytes = htons(strlen(info_text));
-		size_t res = fwrite(&info_bytes, sizeof(uint16_t), 1, recorder->file);
-		if(res != 1) {
-			JANUS_LOG(LOG_WARN, "Couldn't write size of JSON header in .mjr file (%zu != %zu, %s), expect issues post-processing\n",
-				res, sizeof(uint16_t), g_strerror(errno));
-		}
-		res = fwrite(info_text, sizeof(char), strlen(info_text), recorder->file);
-		if(res != strlen(info_text)) {
-			JANUS_LOG(LOG_WARN, "Couldn't write JSON header in .mjr file (%zu != %zu, %s), expect issues post-processing\n",
-				res, strlen(info_text), g_strerror(errno));
-		}
-		free(info_text);
 		/* Done */
 		recorder->started = now;
 		g_atomic_int_set(&recorder->header, 1);
 	}
-	/* Write frame header (fixed part[4], timestamp[4], length[2]) */
-	size_t res = fwrite(frame_header, sizeof(char), strlen(frame_header), recorder->file);
-	if(res != strlen(frame_header)) {
-		JANUS_LOG(LOG_WARN, "Couldn't write frame header in .mjr file (%zu != %zu, %s), expect issues post-processing\n",
-			res, strlen(frame_header), g_strerror(errno));
+	/* Serialize the whole frame in a single buffer: the JSON header if this
+	 * is the first frame, then the frame header (fixed part[4], timestamp[4],
+	 * length[2]) and the payload itself */
+	size_t info_len = info_text ? strlen(info_text) : 0;
+	int frame_len = (info_text ? sizeof(uint16_t) + info_len : 0) +
+		strlen(frame_header) + sizeof(uint32_t) + sizeof(uint16_t) +
+		(recorder->type == JANUS_RECORDER_DATA ? sizeof(gint64) : 0) + length;
+	char *data = g_malloc(frame_len), *p = data;
+	if(info_text != NULL) {
+		uint16_t info_bytes = htons(info_len);
+		memcpy(p, &info_bytes, sizeof(uint16_t));
+		p += sizeof(uint16_t);
+		memcpy(p, info_text, info_len);
+		p += info_len;
+		free(info_text);
 	}
+	memcpy(p, frame_header, strlen(frame_header));
+	p += strlen(frame_header);
 	uint32_t timestamp = (uint32_t)(now > recorder->started ? ((now - recorder->started)/1000) : 0);
 	timestamp = htonl(timestamp);
-	res = fwrite(&timestamp, sizeof(uint32_t), 1, recorder->file);
-	if(res != 1) {
-		JANUS_LOG(LOG_WARN, "Couldn't write frame timestamp in .mjr file (%zu != %zu, %s), expect issues post-processing\n",
-			res, sizeof(uint32_t), g_strerror(errno));
-	}
+	memcpy(p, &timestamp, sizeof(uint32_t));
+	p += sizeof(uint32_t);
 	uint16_t header_bytes = htons(recorder->type == JANUS_RECORDER_DATA ? (length+sizeof(gint64)) : length);
-	res = fwrite(&header_bytes, sizeof(uint16_t), 1, recorder->file);
-	if(res != 1) {
-		JANUS_LOG(LOG_WARN, "Couldn't write size of frame in .mjr file (%zu != %zu, %s), expect issues post-processing\n",
-			res, sizeof(uint16_t), g_strerror(errno));
-	}
+	memcpy(p, &header_bytes, sizeof(uint16_t));
+	p += sizeof(uint16_t);
 	if(recorder->type == JANUS_RECORDER_DATA) {
 		/* If it's data, then we need to prepend timing related info, as it's not there by itself */
-		gint64 now = htonll((uint64_t)janus_get_real_time());
-		res = fwrite(&now, sizeof(gint64), 1, recorder->file);
-		if(res != 1) {
-			JANUS_LOG(LOG_WARN, "Couldn't write data timestamp in .mjr file (%zu != %zu, %s), expect issues post-processing\n",
-				res, sizeof(gint64), g_strerror(errno));
-		}
+		gint64 nowrt = htonll((uint64_t)janus_get_real_time());
+		memcpy(p, &nowrt, sizeof(gint64));
+		p += sizeof(gint64);
 	}
-	/* Edit packet header if needed */
-	janus_rtp_header *header = (janus_rtp_header *)buffer;
-	uint32_t ssrc = 0;
-	uint16_t seq = 0;
+	memcpy(p, buffer, length);
 	if(recorder->type != JANUS_RECORDER_DATA) {
-		ssrc = ntohl(header->ssrc);
-		seq = ntohs(header->seq_number);
-		timestamp = ntohl(header->timestamp);
+		/* Edit the packet header, if needed: since we're working on a
+		 * copy, there's no need to restore the original one afterwards */
+		janus_rtp_header *header = (janus_rtp_header *)p;
 		janus_rtp_header_update(header, &recorder->context, recorder->type == JANUS_RECORDER_VIDEO, 0);
 	}
-	/* Save packet on file */
-	int temp = 0, tot = length;
-	while(tot > 0) {
-		temp = fwrite(buffer+length-tot, sizeof(char), tot, recorder->file);
-		if(temp <= 0) {
-			JANUS_LOG(LOG_ERR, "Error saving frame...\n");
-			if(recorder->type != JANUS_RECORDER_DATA) {
-				/* Restore packet header data */
-				header->ssrc = htonl(ssrc);
-				header->seq_number = htons(seq);
-				header->timestamp = htonl(timestamp);
-			}
+	if(frames != NULL) {
+		/* Hand the serialized frame to the writer thread */
+		janus_recorder_frame *frame = g_malloc(sizeof(janus_recorder_frame));
+		janus_refcount_increase(&recorder->ref);
+		frame->recorder = recorder;
+		frame->buffer = data;
+		frame->length = frame_len;
+		frame->timestamp = timestamp;
+		frame->skip = (info_len > 0 ? (int)(sizeof(uint16_t) + info_len) : 0);
+		g_atomic_int_inc(&recorder->pending);
+		g_async_queue_push(frames, frame);
+	} else if(recorder->sink != NULL) {
+		/* There's no writer thread, write the muxed frame synchronously:
+		 * since multiple media threads may share a sink, we need its mutex */
+		janus_recorder_sink *sink = recorder->sink;
+		uint16_t stream_id = htons(recorder->stream_id);
+		uint32_t mux_len = htonl((uint32_t)frame_len);
+		janus_mutex_lock(&sink->mutex);
+		size_t res = fwrite(mux_marker, sizeof(char), strlen(mux_marker), sink->file);
+		res += fwrite(&stream_id, sizeof(uint16_t), 1, sink->file);
+		res += fwrite(&mux_len, sizeof(uint32_t), 1, sink->file);
+		res += fwrite(data, sizeof(char), frame_len, sink->file);
+		janus_mutex_unlock(&sink->mutex);
+		g_free(data);
+		if(res != strlen(mux_marker) + 2 + (size_t)frame_len) {
+			JANUS_LOG(LOG_ERR, "Error saving frame... (%s)\n", g_strerror(errno));
+			janus_mutex_unlock_nodebug(&recorder->mutex);
+			return -6;
+		}
+	} else {
+		/* There's no writer thread, write the frame synchronously */
+		size_t res = fwrite(data, sizeof(char), frame_len, recorder->file);
+		g_free(data);
+		if(res != (size_t)frame_len) {
+			JANUS_LOG(LOG_ERR, "Error saving frame... (%s)\n", g_strerror(errno));
 			janus_mutex_unlock_nodebug(&recorder->mutex);
 			return -6;
 		}
-		tot -= temp;
-	}
-	if(recorder->type != JANUS_RECORDER_DATA) {
-		/* Restore packet header data */
-		header->ssrc = htonl(ssrc);
-		header->seq_number = htons(seq);
-		header->timestamp = htonl(timestamp);
 	}
 	/* Done */
 	janus_mutex_unlock_nodebug(&recorder->mutex);
@@ -485,13 +932,44 @@ int janus_recorder_close(janus_recorder *recorder) {
 	if(!recorder || !g_atomic_int_compare_and_exchange(&recorder->writable, 1, 0))
 		return -1;
 	janus_mutex_lock_nodebug(&recorder->mutex);
+	if(recorder->file != NULL || recorder->sink != NULL) {
+		/* Wait for the writer thread to get rid of the frames we have pending */
+		while(frames != NULL && g_atomic_int_get(&recorder->pending) > 0)
+			g_usleep(5000);
+		if(g_atomic_int_get(&recorder->dropped) > 0) {
+			JANUS_LOG(LOG_WARN, "%d frame(s) were dropped while saving this recording... (%s)\n",
+				g_atomic_int_get(&recorder->dropped),
+				recorder->filename ? recorder->filename : recorder->sink->filename);
+		}
+	}
+	size_t fsize = 0;
 	if(recorder->file) {
+		if(recorder->indexed && recorder->index != NULL && recorder->index->len > 0) {
+			/* Append the block index, with a trailer pointing at it */
+			uint64_t index_offset = htonll((uint64_t)ftell(recorder->file));
+			uint32_t entries = htonl(recorder->index->len / (sizeof(uint32_t)+sizeof(uint64_t)));
+			size_t res = fwrite(index_marker, sizeof(char), strlen(index_marker), recorder->file);
+			res += fwrite(&entries, sizeof(uint32_t), 1, recorder->file);
+			res += fwrite(recorder->index->data, sizeof(guint8), recorder->index->len, recorder->file);
+			res += fwrite(&index_offset, sizeof(uint64_t), 1, recorder->file);
+			res += fwrite(index_marker, sizeof(char), strlen(index_marker), recorder->file);
+			if(res != strlen(index_marker)*2 + 2 + recorder->index->len) {
+				JANUS_LOG(LOG_WARN, "Couldn't write block index in .mjr file (%s)\n", g_strerror(errno));
+			}
+		}
+		fflush(recorder->file);
+		if(recorder->indexed && recorder->allocated > 0 &&
+				ftruncate(fileno(recorder->file), ftell(recorder->file)) < 0) {
+			/* Get rid of any extra space we preallocated */
+			JANUS_LOG(LOG_WARN, "Error truncating the preallocated space... (%s)\n", g_strerror(errno));
+		}
+		fsync(fileno(recorder->file));
 		fseek(recorder->file, 0L, SEEK_END);
-		size_t fsize = ftell(recorder->file);
+		fsize = ftell(recorder->file);
 		fseek(recorder->file, 0L, SEEK_SET);
 		JANUS_LOG(LOG_INFO, "File is %zu bytes: %s\n", fsize, recorder->filename);
 	}
-	if(rec_tempname) {
+	if(rec_tempname && recorder->filename != NULL) {
 		/* We need to rename the file, to remove the temporary extension */
 		char newname[1024];
 		memset(newname, 0, 1024);
@@ -515,10 +993,68 @@ int janus_recorder_close(janus_recorder *recorder) {
 			recorder->filename = g_strdup(newname);
 		}
 	}
+	if(recorder->file != NULL && janus_events_is_enabled()) {
+		/* Notify event handlers the recording is complete: this way external
+		 * tools (e.g., uploaders) can react right away, instead of having to
+		 * poll the recordings folder to find out when a file is ready */
+		json_t *info = json_object();
+		json_object_set_new(info, "status", json_string("closed"));
+		if(recorder->dir)
+			json_object_set_new(info, "dir", json_string(recorder->dir));
+		if(recorder->filename)
+			json_object_set_new(info, "filename", json_string(recorder->filename));
+		if(recorder->type == JANUS_RECORDER_AUDIO)
+			json_object_set_new(info, "type", json_string("audio"));
+		else if(recorder->type == JANUS_RECORDER_VIDEO)
+			json_object_set_new(info, "type", json_string("video"));
+		else if(recorder->type == JANUS_RECORDER_DATA)
+			json_object_set_new(info, "type", json_string("data"));
+		if(recorder->codec)
+			json_object_set_new(info, "codec", json_string(recorder->codec));
+		json_object_set_new(info, "size", json_integer(fsize));
+		janus_events_notify_handlers(JANUS_EVENT_TYPE_CORE, JANUS_EVENT_SUBTYPE_CORE_RECORDING, 0, info);
+	}
 	janus_mutex_unlock_nodebug(&recorder->mutex);
 	return 0;
 }
 
+void janus_recorder_close_all(void) {
+	/* Snapshot the registry, we don't want to hold the lock while closing */
+	GList *open = NULL;
+	janus_mutex_lock(&recorders_mutex);
+	if(recorders != NULL) {
+		GHashTableIter iter;
+		gpointer value;
+		g_hash_table_iter_init(&iter, recorders);
+		while(g_hash_table_iter_next(&iter, NULL, &value)) {
+			janus_recorder *recorder = (janus_recorder *)value;
+			if(g_atomic_int_get(&recorder->writable)) {
+				janus_refcount_increase(&recorder->ref);
+				open = g_list_prepend(open, recorder);
+			}
+		}
+	}
+	janus_mutex_unlock(&recorders_mutex);
+	if(open == NULL)
+		return;
+	JANUS_LOG(LOG_INFO, "Closing %d open recording(s)\n", g_list_length(open));
+	GList *temp = open;
+	while(temp) {
+		janus_recorder *recorder = (janus_recorder *)temp->data;
+		janus_recorder_close(recorder);
+		if(recorder->sink != NULL && recorder->sink->file != NULL) {
+			/* Shared sinks are normally only fsync-ed when freed, force one now */
+			janus_mutex_lock(&recorder->sink->mutex);
+			fflush(recorder->sink->file);
+			fsync(fileno(recorder->sink->file));
+			janus_mutex_unlock(&recorder->sink->mutex);
+		}
+		janus_refcount_decrease(&recorder->ref);
+		temp = temp->next;
+	}
+	g_list_free(open);
+}
+
 void janus_recorder_destroy(janus_recorder *recorder) {
 	if(!recorder || !g_atomic_int_compare_and_exchange(&recorder->destroyed, 0, 1))
 		return;
@@ -37,6 +37,31 @@ typedef enum janus_recorder_medium {
 	JANUS_RECORDER_DATA
 } janus_recorder_medium;
 
+/*! \brief Opaque per-volume write accounting entry: when a write budget is
+ * configured, recordings saved to the same device share one of these */
+typedef struct janus_recorder_volume janus_recorder_volume;
+
+/*! \brief Structure that represents a shared recording sink, i.e., a single
+ * muxed .mjrs file that multiple recorders can interleave their frames into */
+typedef struct janus_recorder_sink {
+	/*! \brief Absolute path to the directory where the muxed file is stored */
+	char *dir;
+	/*! \brief Filename of the muxed file */
+	char *filename;
+	/*! \brief Muxed recording file */
+	FILE *file;
+	/*! \brief Stream ID to assign to the next recorder enrolled in this sink */
+	uint16_t next_stream;
+	/*! \brief When this file was last fsync-ed, in case a periodic fsync policy is set */
+	gint64 last_fsync;
+	/*! \brief Mutex to lock/unlock this sink instance */
+	janus_mutex mutex;
+	/*! \brief Atomic flag to check if this instance has been destroyed */
+	volatile gint destroyed;
+	/*! \brief Reference counter for this instance */
+	janus_refcount ref;
+} janus_recorder_sink;
+
 /*! \brief Structure that represents a recorder */
 typedef struct janus_recorder {
 	/*! \brief Absolute path to the directory where the recorder file is stored */
@@ -69,6 +94,26 @@ typedef struct janus_recorder {
 	volatile int paused;
 	/*! \brief RTP switching context for rewriting RTP headers */
 	janus_rtp_switching_context context;
+	/*! \brief Number of frames queued for the writer thread */
+	volatile gint pending;
+	/*! \brief Number of frames dropped because the writer thread wasn't keeping up */
+	volatile gint dropped;
+	/*! \brief When this recording was last fsync-ed, in case a periodic fsync policy is set */
+	gint64 last_fsync;
+	/*! \brief Whether this recording uses the indexed v3 format */
+	gboolean indexed;
+	/*! \brief Number of frames written so far (only used by the writer thread) */
+	guint32 frames_written;
+	/*! \brief Block index entries collected so far, if the v3 format is in use */
+	GByteArray *index;
+	/*! \brief How many bytes we've preallocated for this file so far */
+	gint64 allocated;
+	/*! \brief Write accounting entry for the volume this recording is saved to, if write budgets are enabled */
+	janus_recorder_volume *volume;
+	/*! \brief Shared sink this recorder writes to, if this is a muxed recorder (file will be NULL, then) */
+	janus_recorder_sink *sink;
+	/*! \brief Stream ID identifying this recorder within the shared sink, if any */
+	uint16_t stream_id;
 	/*! \brief Mutex to lock/unlock this recorder instance */
 	janus_mutex mutex;
 	/*! \brief Atomic flag to check if this instance has been destroyed */
@@ -79,8 +124,15 @@ typedef struct janus_recorder {
 
 /*! \brief Initialize the recorder code
  * @param[in] tempnames Whether the filenames should have a temporary extension, while saving, or not
- * @param[in] extension Extension to add in case tempnames is true */
-void janus_recorder_init(gboolean tempnames, const char *extension);
+ * @param[in] extension Extension to add in case tempnames is true
+ * @param[in] fsync_secs How often open recordings should be fsync-ed to disk, in seconds (0 to only rely on the OS)
+ * @param[in] indexed Whether recordings should use the indexed v3 .mjr format (preallocated extents,
+ * plus a block index appended when closing the file), rather than the plain v2 one
+ * @param[in] write_budget Write budget each volume (device) gets for recordings, in megabytes
+ * per second: when the aggregate write rate on a volume exceeds the budget, frames recorded to
+ * that volume are dropped until it's back within budget, so that a saturated disk slows down
+ * the recordings on it, rather than starving reads and writes for everyone (0 = unlimited) */
+void janus_recorder_init(gboolean tempnames, const char *extension, int fsync_secs, gboolean indexed, int write_budget);
 /*! \brief De-initialize the recorder code */
 void janus_recorder_deinit(void);
 
@@ -101,6 +153,26 @@ janus_recorder *janus_recorder_create(const char *dir, const char *codec, const
  * @param[in] filename Filename to use for the recording
  * @returns A valid janus_recorder instance in case of success, NULL otherwise */
 janus_recorder *janus_recorder_create_full(const char *dir, const char *codec, const char *fmtp, const char *filename);
+/*! \brief Create a new shared recording sink, i.e., a single muxed .mjrs file
+ * that multiple recorders can interleave their frames into, to avoid dealing
+ * with many concurrently open files for the same context (e.g., a room)
+ * @param[in] dir Path of the directory to save the muxed file into (will try to create it if it doesn't exist)
+ * @param[in] filename Filename to use for the muxed file
+ * @returns A valid janus_recorder_sink instance in case of success, NULL otherwise */
+janus_recorder_sink *janus_recorder_sink_create(const char *dir, const char *filename);
+/*! \brief Destroy a shared recording sink: the file is only actually closed
+ * once all the recorders enrolled in the sink have been destroyed as well
+ * @param[in] sink The janus_recorder_sink instance to destroy */
+void janus_recorder_sink_destroy(janus_recorder_sink *sink);
+/*! \brief Create a new recorder writing to a shared sink, rather than to its own file
+ * \note The recorder is assigned a stream ID within the sink, and its frames are
+ * interleaved in the muxed file: use \c mjrs2mjr to turn the muxed file back
+ * into one standalone .mjr file per stream, for post-processing
+ * @param[in] sink The janus_recorder_sink instance to enroll the new recorder in
+ * @param[in] codec Codec the packets to record are encoded in ("vp8", "opus", "h264", "g711", "vp9")
+ * @param[in] fmtp Codec-specific details (e.g., the H.264 or VP9 profile)
+ * @returns A valid janus_recorder instance in case of success, NULL otherwise */
+janus_recorder *janus_recorder_create_muxed(janus_recorder_sink *sink, const char *codec, const char *fmtp);
 /*! \brief Pause recording packets
  * \note This is to allow pause and resume recorder functionality.
  * @param[in] recorder The janus_recorder to pause
@@ -140,6 +212,10 @@ int janus_recorder_opusred(janus_recorder *recorder, int red_pt);
  * @returns 0 in case of success, a negative integer otherwise */
 int janus_recorder_encrypted(janus_recorder *recorder);
 /*! \brief Save an RTP frame in the recorder
+ * \note The frame is only serialized and queued here: a dedicated writer
+ * thread will take care of actually writing it to disk, so that media
+ * threads never block on I/O (e.g., on network mounted folders). Frames
+ * are dropped if too many of them are waiting for the writer thread
  * @param[in] recorder The janus_recorder instance to save the frame to
  * @param[in] buffer The frame data to save
  * @param[in] length The frame data length
@@ -149,6 +225,11 @@ int janus_recorder_save_frame(janus_recorder *recorder, char *buffer, uint lengt
  * @param[in] recorder The janus_recorder instance to close
  * @returns 0 in case of success, a negative integer otherwise */
 int janus_recorder_close(janus_recorder *recorder);
+/*! \brief Close and flush (fsync) all the recordings that are still open
+ * \note Only meant to be used when shutting down: it makes sure media files
+ * are safely on disk and renamed to their final name before the rest of the
+ * (potentially slow) teardown takes place, in case we're killed mid-way */
+void janus_recorder_close_all(void);
 /*! \brief Destroy the recorder instance
  * @param[in] recorder The janus_recorder instance to destroy */
 void janus_recorder_destroy(janus_recorder *recorder);
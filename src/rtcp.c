@@ -299,11 +299,16 @@ static void janus_rtcp_incoming_transport_cc(janus_rtcp_context *ctx, janus_rtcp
 	num = 0;
 	uint16_t delta = 0;
 	uint32_t delta_us = 0;
+	uint32_t recv_count = 0, lost_count = 0;
 	GList *iter = list;
 	while(iter != NULL && total > 0) {
 		num++;
 		delta = 0;
 		s = GPOINTER_TO_UINT(iter->data);
+		if(s == janus_rtp_packet_status_notreceived)
+			lost_count++;
+		else
+			recv_count++;
 		if(s == janus_rtp_packet_status_smalldelta) {
 			/* Small delta = 1 byte */
 			delta = *data;
@@ -324,7 +329,10 @@ static void janus_rtcp_incoming_transport_cc(janus_rtcp_context *ctx, janus_rtcp
 			janus_rtp_packet_status_description(s), delta_us);
 		iter = iter->next;
 	}
-	/* TODO Update the context with the feedback we got */
+	/* Update the context with the feedback we got: these counters are used,
+	 * e.g., by the pacing of outgoing media to detect congestion */
+	ctx->twcc_received += recv_count;
+	ctx->twcc_lost += lost_count;
 	g_list_free(list);
 }
 
@@ -1356,6 +1364,141 @@ uint32_t janus_rtcp_get_remb(char *packet, int len) {
 	return 0;
 }
 
+int janus_rtcp_get_fraction_lost(char *packet, int len) {
+	if(packet == NULL || len == 0)
+		return -1;
+	janus_rtcp_header *rtcp = (janus_rtcp_header *)packet;
+	/* Get the highest fraction lost reported in SR/RR report blocks, if any */
+	int fraction = -1, total = len;
+	while(rtcp) {
+		if(!janus_rtcp_check_len(rtcp, total))
+			break;
+		if(rtcp->version != 2)
+			break;
+		if(rtcp->type == RTCP_RR && rtcp->rc > 0 && ntohs(rtcp->length) >= 7) {
+			janus_rtcp_rr *rr = (janus_rtcp_rr *)rtcp;
+			int f = (int)(ntohl(rr->rb[0].flcnpl) >> 24);
+			if(f > fraction)
+				fraction = f;
+		} else if(rtcp->type == RTCP_SR && rtcp->rc > 0 && ntohs(rtcp->length) >= 12) {
+			janus_rtcp_sr *sr = (janus_rtcp_sr *)rtcp;
+			int f = (int)(ntohl(sr->rb[0].flcnpl) >> 24);
+			if(f > fraction)
+				fraction = f;
+		}
+		/* Is this a compound packet? */
+		int length = ntohs(rtcp->length);
+		if(length == 0)
+			break;
+		total -= length*4+4;
+		if(total <= 0)
+			break;
+		rtcp = (janus_rtcp_header *)((uint32_t*)rtcp + length + 1);
+	}
+	return fraction;
+}
+
+/* Summarize the feedback in a compound packet with a single walk */
+int janus_rtcp_summarize(char *packet, int len, janus_rtcp_summary *summary) {
+	if(packet == NULL || len == 0 || summary == NULL)
+		return -1;
+	memset(summary, 0, sizeof(janus_rtcp_summary));
+	janus_rtcp_header *rtcp = (janus_rtcp_header *)packet;
+	int total = len;
+	while(rtcp) {
+		if (!janus_rtcp_check_len(rtcp, total))
+			return -1;
+		if(rtcp->version != 2)
+			return -1;
+		switch(rtcp->type) {
+			case RTCP_SR:
+				summary->has_sr = TRUE;
+				break;
+			case RTCP_RR:
+				summary->has_rr = TRUE;
+				break;
+			case RTCP_FIR:
+				summary->has_fir = TRUE;
+				break;
+			case RTCP_PSFB: {
+				gint fmt = rtcp->rc;
+				if(fmt == 1) {
+					/* PLI */
+					summary->has_pli = TRUE;
+				} else if(fmt == 4) {	/* rfc5104 */
+					/* FIR */
+					summary->has_fir = TRUE;
+				} else if(fmt == 15) {
+					/* May be a REMB message */
+					janus_rtcp_fb *rtcpfb = (janus_rtcp_fb *)rtcp;
+					janus_rtcp_fb_remb *remb = (janus_rtcp_fb_remb *)rtcpfb->fci;
+					if(janus_rtcp_check_remb(rtcp, total) && remb->id[0] == 'R' && remb->id[1] == 'E' && remb->id[2] == 'M' && remb->id[3] == 'B') {
+						/* FIXME From rtcp_utility.cc */
+						unsigned char *_ptrRTCPData = (unsigned char *)remb;
+						_ptrRTCPData += 4;	/* Skip unique identifier and num ssrc */
+						uint8_t brExp = (_ptrRTCPData[1] >> 2) & 0x3F;
+						uint32_t brMantissa = (_ptrRTCPData[1] & 0x03) << 16;
+						brMantissa += (_ptrRTCPData[2] << 8);
+						brMantissa += (_ptrRTCPData[3]);
+						summary->remb_bitrate = (uint64_t)brMantissa << brExp;
+						JANUS_LOG(LOG_HUGE, "Got REMB bitrate %"SCNu32"\n", summary->remb_bitrate);
+					}
+				}
+				break;
+			}
+			case RTCP_RTPFB: {
+				gint fmt = rtcp->rc;
+				if(fmt == 1) {
+					/* NACK: the FCI size is 4 bytes */
+					if (!janus_rtcp_check_fci(rtcp, total, 4))
+						return -1;
+					janus_rtcp_fb *rtcpfb = (janus_rtcp_fb *)rtcp;
+					int nacks = ntohs(rtcp->length)-2;	/* Skip SSRCs */
+					if(nacks > 0) {
+						JANUS_LOG(LOG_DBG, "        Got %d nacks\n", nacks);
+						janus_rtcp_nack *nack = NULL;
+						uint16_t pid = 0;
+						uint16_t blp = 0;
+						int i=0, j=0;
+						for(i=0; i<nacks; i++) {
+							nack = (janus_rtcp_nack *)rtcpfb->fci + i;
+							pid = ntohs(nack->pid);
+							if(summary->nacks_count < JANUS_RTCP_SUMMARY_MAX_NACKS)
+								summary->nacks[summary->nacks_count++] = pid;
+							else
+								summary->nacks_truncated = TRUE;
+							blp = ntohs(nack->blp);
+							for(j=0; j<16; j++) {
+								if((blp & ( 1 << j )) >> j) {
+									if(summary->nacks_count < JANUS_RTCP_SUMMARY_MAX_NACKS)
+										summary->nacks[summary->nacks_count++] = pid+j+1;
+									else
+										summary->nacks_truncated = TRUE;
+								}
+							}
+						}
+					}
+				} else if(fmt == 15) {
+					/* Transport wide CC feedback */
+					summary->has_twcc = TRUE;
+				}
+				break;
+			}
+			default:
+				break;
+		}
+		/* Is this a compound packet? */
+		int length = ntohs(rtcp->length);
+		if(length == 0)
+			break;
+		total -= length*4+4;
+		if(total <= 0)
+			break;
+		rtcp = (janus_rtcp_header *)((uint32_t*)rtcp + length + 1);
+	}
+	return 0;
+}
+
 /* Change an existing REMB message */
 int janus_rtcp_cap_remb(char *packet, int len, uint32_t bitrate) {
 	if(packet == NULL || len == 0)
@@ -1900,3 +2043,294 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 	/* Done */
 	return len;
 }
+
+int janus_rtcp_transport_wide_cc_feedback_array(char *packet, size_t size, guint32 ssrc, guint32 media,
+		guint8 feedback_packet_count, janus_rtcp_transport_wide_cc_stats *stats, guint num_stats) {
+	if(packet == NULL || size < sizeof(janus_rtcp_header) || stats == NULL ||
+			num_stats == 0 || num_stats > JANUS_RTCP_TWCC_FEEDBACK_MAX_PACKETS)
+		return -1;
+
+	memset(packet, 0, size);
+	janus_rtcp_header *rtcp = (janus_rtcp_header *)packet;
+	/* Set header */
+	rtcp->version = 2;
+	rtcp->type = RTCP_RTPFB;
+	rtcp->rc = 15;
+	/* Now set FB stuff */
+	janus_rtcp_fb *rtcpfb = (janus_rtcp_fb *)rtcp;
+	rtcpfb->ssrc = htonl(ssrc);
+	rtcpfb->media = htonl(media);
+
+	/* Calculate temporal info */
+	guint16 base_seq_num = stats[0].transport_seq_num;
+	gboolean first_received	= FALSE;
+	guint64 reference_time = 0;
+
+	/* The packet as unsigned */
+	guint8 *data = (guint8 *)packet;
+	/* The start of the feedback data */
+	size_t len = sizeof(janus_rtcp_header) + 8;
+
+	/* Set header data */
+	janus_set2(data, len, base_seq_num);
+	janus_set2(data, len+2, num_stats);
+	/* Set3 referenceTime when first received */
+	size_t reference_time_pos = len + 4;
+	janus_set1(data, len+7, feedback_packet_count);
+
+	/* Next byte */
+	len += 8;
+
+	/* Initial time in us */
+	guint64 timestamp = 0;
+
+	/* Everything is tracked in preallocated storage here, so that building the
+	 * feedback message is a single pass over the stats array with no allocation:
+	 * the pending statuses are kept in a small circular window, since a run can
+	 * span the whole report (the window size must be a power of two larger than
+	 * JANUS_RTCP_TWCC_FEEDBACK_MAX_PACKETS) */
+	gint deltas[JANUS_RTCP_TWCC_FEEDBACK_MAX_PACKETS];
+	guint num_deltas = 0, d = 0;
+	guint8 window[512];
+	guint window_head = 0, window_count = 0;
+	janus_rtp_packet_status last_status = janus_rtp_packet_status_reserved;
+	janus_rtp_packet_status max_status = janus_rtp_packet_status_notreceived;
+	gboolean all_same = TRUE;
+
+	/* For each packet  */
+	guint si = 0;
+	for(si = 0; si < num_stats; si++) {
+		janus_rtcp_transport_wide_cc_stats *stat = &stats[si];
+		janus_rtp_packet_status status = janus_rtp_packet_status_notreceived;
+
+		/* If got packet */
+		if (stat->timestamp) {
+			int delta = 0;
+			/* If first received */
+			if (!first_received) {
+				/* Got it  */
+				first_received = TRUE;
+				/* Set it */
+				reference_time = stat->timestamp / 64000;
+				/* Get initial time */
+				timestamp = reference_time * 64000;
+				/* also in buffer */
+				/* (use only 23 bits of reference_time) */
+				janus_set3(data, reference_time_pos, (reference_time & 0x007FFFFF));
+			}
+
+			/* Get delta */
+			if (stat->timestamp>timestamp)
+				delta = (stat->timestamp-timestamp)/250;
+			else
+				delta = -(int)((timestamp-stat->timestamp)/250);
+			/* If it is negative or too big */
+			if (delta<0 || delta> 255) {
+				/* Big one */
+				status = janus_rtp_packet_status_largeornegativedelta;
+			} else {
+				/* Small */
+				status = janus_rtp_packet_status_smalldelta;
+			}
+			/* Store delta */
+			/* Overflows are possible here */
+			deltas[num_deltas++] = delta;
+			/* Set last time */
+			timestamp = stat->timestamp;
+		}
+
+		/* Check if all previoues ones were equal and this one the first different */
+		if (all_same && last_status!=janus_rtp_packet_status_reserved && status!=last_status) {
+			/* How big was the same run */
+			if (window_count>7) {
+				guint32 word = 0;
+				/* Write run! */
+				word = janus_push_bits(word, 1, 0);
+				word = janus_push_bits(word, 2, last_status);
+				word = janus_push_bits(word, 13, window_count);
+				/* Write word */
+				janus_set2(data, len, word);
+				len += 2;
+				/* Remove all statuses */
+				window_head = 0;
+				window_count = 0;
+				/* Reset status */
+				last_status = janus_rtp_packet_status_reserved;
+				max_status = janus_rtp_packet_status_notreceived;
+				all_same = TRUE;
+			} else {
+				/* Not same */
+				all_same = FALSE;
+			}
+		}
+
+		/* Push back statuses, it will be handled later */
+		window[(window_head+window_count) & 511] = (guint8)status;
+		window_count++;
+
+		/* If it is bigger */
+		if (status>max_status) {
+			/* Store it */
+			max_status = status;
+		}
+		/* Store las status */
+		last_status = status;
+
+		/* Check if we can still be enqueuing for a run */
+		if (!all_same) {
+			/* Check  */
+			if (max_status==janus_rtp_packet_status_largeornegativedelta && window_count>6) {
+				guint32 word = 0;
+				/* Write 2-bit symbols (T=1, S=1) */
+				word = janus_push_bits(word, 1, 1);
+				word = janus_push_bits(word, 1, 1);
+				/* Set next 7 */
+				size_t i = 0;
+				for (i=0;i<7;++i) {
+					/* Get status */
+					janus_rtp_packet_status s = (janus_rtp_packet_status)window[window_head & 511];
+					window_head++;
+					window_count--;
+					/* Write */
+					word = janus_push_bits(word, 2, (guint8)s);
+				}
+				/* Write word */
+				janus_set2(data, len, word);
+				len += 2;
+				/* Reset */
+				last_status = janus_rtp_packet_status_reserved;
+				max_status = janus_rtp_packet_status_notreceived;
+				all_same = TRUE;
+
+				/* We need to restore the values, as there may be more elements on the buffer */
+				for (i=0; i<window_count; ++i) {
+					/* Get status */
+					janus_rtp_packet_status s = (janus_rtp_packet_status)window[(window_head+i) & 511];
+					/* If it is bigger */
+					if (s>max_status) {
+						/* Store it */
+						max_status = s;
+					}
+					//Check if it is the same */
+					if (all_same && last_status!=janus_rtp_packet_status_reserved && s!=last_status) {
+						/* Not the same */
+						all_same = FALSE;
+					}
+					/* Store las status */
+					last_status = s;
+				}
+			} else if (window_count>13) {
+				guint32 word = 0;
+				/* Write 1-bit symbols (T=1, S=0) */
+				word = janus_push_bits(word, 1, 1);
+				word = janus_push_bits(word, 1, 0);
+				/* Set next 14 */
+				guint32 i = 0;
+				for (i=0;i<14;++i) {
+					/* Get status */
+					janus_rtp_packet_status s = (janus_rtp_packet_status)window[window_head & 511];
+					window_head++;
+					window_count--;
+					/* Write */
+					word = janus_push_bits(word, 1, (guint8)s);
+				}
+				/* Write word */
+				janus_set2(data, len, word);
+				len += 2;
+				/* Reset */
+				last_status = janus_rtp_packet_status_reserved;
+				max_status = janus_rtp_packet_status_notreceived;
+				all_same = TRUE;
+			}
+		}
+	}
+
+	/* If not finished yet */
+	if (window_count>0) {
+		/* How big was the same run */
+		if (all_same) {
+			guint32 word = 0;
+			/* Write run! */
+			word = janus_push_bits(word, 1, 0);
+			word = janus_push_bits(word, 2, last_status);
+			word = janus_push_bits(word, 13, window_count);
+			/* Write word */
+			janus_set2(data, len, word);
+			len += 2;
+		} else if (max_status == janus_rtp_packet_status_largeornegativedelta) {
+			guint32 word = 0;
+			/* Write chunk */
+			word = janus_push_bits(word, 1, 1);
+			word = janus_push_bits(word, 1, 1);
+			/* Write all the statuses */
+			unsigned int i = 0;
+			guint pending = window_count;
+			for (i=0;i<pending;i++) {
+				/* Get each status */
+				janus_rtp_packet_status s = (janus_rtp_packet_status)window[(window_head+i) & 511];
+				/* Write */
+				word = janus_push_bits(word, 2, (guint8)s);
+			}
+			/* Write pending */
+			word = janus_push_bits(word, 14-pending*2, 0);
+			/* Write word */
+			janus_set2(data , len, word);
+			len += 2;
+		} else {
+			guint32 word = 0;
+			/* Write chunk */
+			word = janus_push_bits(word, 1, 1);
+			word = janus_push_bits(word, 1, 0);
+			/* Write all the statuses */
+			unsigned int i = 0;
+			guint pending = window_count;
+			for (i=0;i<pending;i++) {
+				/* Get each status */
+				janus_rtp_packet_status s = (janus_rtp_packet_status)window[(window_head+i) & 511];
+				/* Write */
+				word = janus_push_bits(word, 1, (guint8)s);
+			}
+			/* Write pending */
+			word = janus_push_bits(word, 14-pending, 0);
+			/* Write word */
+			janus_set2(data, len, word);
+			len += 2;
+		}
+	}
+
+	/* Write now the deltas */
+	for (d=0; d<num_deltas; d++) {
+		/* Get next delta */
+		gint delta = deltas[d];
+		/* Check size */
+		if (delta<0 || delta>255) {
+			short reported_delta = (short)delta;
+			/* Overflow */
+			if (reported_delta != delta) {
+				reported_delta = delta > 0 ? SHRT_MAX : SHRT_MIN;
+				JANUS_LOG(LOG_ERR, "Delta value (%d) too large, reporting it as %d\n", delta, reported_delta);
+			}
+			/* 2 bytes */
+			janus_set2(data, len, reported_delta);
+			/* Inc */
+			len += 2;
+		} else {
+			/* 1 byte */
+			janus_set1(data, len, (guint8)delta);
+			/* Inc */
+			len ++;
+		}
+	}
+
+	/* Add zero padding */
+	while (len%4) {
+		/* Add padding */
+		janus_set1(data, len++, 0);
+	}
+
+	/* Set RTCP Len */
+	rtcp->length = htons((len/4)-1);
+
+	/* Done */
+	return len;
+}
@@ -160,6 +160,33 @@ typedef struct janus_nack {
 	struct janus_nack *next;
 } janus_nack;
 
+/*! \brief Maximum number of NACKed sequence numbers a janus_rtcp_summary can hold */
+#define JANUS_RTCP_SUMMARY_MAX_NACKS	300
+/*! \brief Summary of the feedback contained in a compound RTCP packet,
+ * as filled in by a single pass of janus_rtcp_summarize: using this
+ * avoids walking the same compound packet multiple times with the
+ * individual janus_rtcp_has_*\/janus_rtcp_get_* helpers */
+typedef struct janus_rtcp_summary {
+	/*! \brief Whether a Sender Report was found */
+	gboolean has_sr;
+	/*! \brief Whether a Receiver Report was found */
+	gboolean has_rr;
+	/*! \brief Whether a PLI request was found */
+	gboolean has_pli;
+	/*! \brief Whether a FIR request was found */
+	gboolean has_fir;
+	/*! \brief Whether a transport wide CC feedback message was found */
+	gboolean has_twcc;
+	/*! \brief Bitrate reported in a REMB message, if any (0 if none was found) */
+	uint32_t remb_bitrate;
+	/*! \brief Number of NACKed sequence numbers collected in the array */
+	uint16_t nacks_count;
+	/*! \brief Whether some NACKed sequence numbers were dropped because the array was full */
+	gboolean nacks_truncated;
+	/*! \brief NACKed sequence numbers, in the order they appeared in the packet */
+	uint16_t nacks[JANUS_RTCP_SUMMARY_MAX_NACKS];
+} janus_rtcp_summary;
+
 
 /*! \brief RTCP REMB (http://tools.ietf.org/html/draft-alvestrand-rmcat-remb-03) */
 typedef struct rtcp_remb
@@ -281,7 +308,10 @@ typedef struct rtcp_context
 	double out_link_quality;
 	double out_media_link_quality;
 
-	/* TODO Incoming transport-wide CC feedback*/
+	/* Incoming transport-wide CC feedback: cumulative counters of how many
+	 * of our outgoing packets the peer reported as received and lost */
+	uint32_t twcc_received;
+	uint32_t twcc_lost;
 
 } rtcp_context;
 typedef rtcp_context janus_rtcp_context;
@@ -471,6 +501,24 @@ int janus_rtcp_remove_nacks(char *packet, int len);
  * @returns The reported bitrate if successful, 0 if no REMB packet was available */
 uint32_t janus_rtcp_get_remb(char *packet, int len);
 
+/*! \brief Inspect an existing RTCP SR/RR message to retrieve the fraction
+ * of packets the peer reported as lost in the latest reporting interval
+ * @param[in] packet The message data
+ * @param[in] len The message data length in bytes
+ * @returns The highest fraction lost (0-255) found in the report blocks,
+ * or -1 if no report block was available */
+int janus_rtcp_get_fraction_lost(char *packet, int len);
+
+/*! \brief Method to summarize the feedback contained in a compound RTCP
+ * packet (SR/RR presence, PLI/FIR requests, REMB bitrate, NACKed sequence
+ * numbers) with a single walk, rather than iterating the same packet once
+ * per janus_rtcp_has_*\/janus_rtcp_get_* helper
+ * @param[in] packet The message data
+ * @param[in] len The message data length in bytes
+ * @param[out] summary The summary to fill in
+ * @returns 0 in case of success, -1 on errors */
+int janus_rtcp_summarize(char *packet, int len, janus_rtcp_summary *summary);
+
 /*! \brief Method to modify an existing RTCP REMB message to cap the reported bitrate
  * @param[in] packet The message data
  * @param[in] len The message data length in bytes
@@ -539,4 +587,23 @@ int janus_rtcp_nacks(char *packet, int len, GSList *nacks);
  * @returns The message data length in bytes, if successful, -1 on errors */
 int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t len, guint32 ssrc, guint32 media, guint8 feedback_packet_count, GQueue *transport_wide_cc_stats);
 
+/*! \brief Maximum number of packets a single transport wide CC feedback message can report */
+#define JANUS_RTCP_TWCC_FEEDBACK_MAX_PACKETS	400
+
+/*! \brief Method to generate a new RTCP transport wide message from an array of
+ * reception stats: unlike janus_rtcp_transport_wide_cc_feedback, this builder
+ * walks the array in a single pass and doesn't allocate anything
+ * @param[in] packet The buffer data (MUST be at least 16 chars)
+ * @param[in] len The message data length in bytes
+ * @param[in] ssrc SSRC of the origin stream
+ * @param[in] media SSRC of the destination stream
+ * @param[in] feedback_packet_count Feedback paccket count
+ * @param[in] stats Array of rtp packet reception stats, ordered by transport
+ * sequence number (a timestamp of 0 means the packet was not received)
+ * @param[in] num_stats Number of entries in the stats array (MUST not be
+ * larger than JANUS_RTCP_TWCC_FEEDBACK_MAX_PACKETS)
+ * @returns The message data length in bytes, if successful, -1 on errors */
+int janus_rtcp_transport_wide_cc_feedback_array(char *packet, size_t len, guint32 ssrc, guint32 media,
+	guint8 feedback_packet_count, janus_rtcp_transport_wide_cc_stats *stats, guint num_stats);
+
 #endif
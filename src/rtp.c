@@ -212,6 +212,97 @@ static int janus_rtp_header_extension_find(char *buf, int len, int id,
 	return -1;
 }
 
+int janus_rtp_header_extensions_index(char *buf, int len, janus_rtp_header_extension_index *extmap) {
+	if(extmap == NULL)
+		return -1;
+	memset(extmap, 0, sizeof(*extmap));
+	if(!buf || len < 12)
+		return -2;
+	janus_rtp_header *rtp = (janus_rtp_header *)buf;
+	if(rtp->version != 2)
+		return -3;
+	int hlen = 12;
+	if(rtp->csrccount)	/* Skip CSRC if needed */
+		hlen += rtp->csrccount*4;
+	int found = 0;
+	if(rtp->extension && (len > hlen + (int)sizeof(janus_rtp_header_extension))) {
+		janus_rtp_header_extension *ext = (janus_rtp_header_extension *)(buf+hlen);
+		int extlen = ntohs(ext->length)*4;
+		hlen += 4;
+		if(len > (hlen + extlen)) {
+			if(ntohs(ext->type) == 0xBEDE) {
+				/* 1-Byte extension */
+				const uint8_t padding = 0x00, reserved = 0xF;
+				uint8_t extid = 0, idlen = 0;
+				int i = 0;
+				while(i < extlen) {
+					extid = (uint8_t)buf[hlen+i] >> 4;
+					if(extid == reserved) {
+						break;
+					} else if(extid == padding) {
+						i++;
+						continue;
+					}
+					idlen = ((uint8_t)buf[hlen+i] & 0xF)+1;
+					i++;
+					if((i+idlen) <= extlen) {
+						extmap->offsets[extid] = hlen+i;
+						extmap->lengths[extid] = idlen;
+						found++;
+					}
+					i += idlen;
+				}
+			} else if(ntohs(ext->type) == 0x1000) {
+				/* 2-Byte extension */
+				const uint8_t padding = 0x00;
+				uint8_t extid = 0, idlen = 0;
+				int i = 0;
+				while(i < extlen) {
+					if((extlen-i) < 2)
+						break;
+					extid = buf[hlen+i];
+					if(extid == padding) {
+						i += 2;
+						continue;
+					}
+					i++;
+					idlen = buf[hlen+i];
+					i++;
+					/* We only index the IDs the offsets array can address */
+					if(extid < 16 && ((i+idlen) <= extlen)) {
+						extmap->offsets[extid] = hlen+i;
+						extmap->lengths[extid] = idlen;
+						found++;
+					}
+					i += idlen;
+				}
+			}
+		}
+	}
+	return found;
+}
+
+/* Static helper to read the data of an indexed extension, with the same
+ * semantics janus_rtp_header_extension_find has when scanning the packet */
+static int janus_rtp_header_extension_find_indexed(janus_rtp_header_extension_index *extmap, char *buf, int id,
+		uint8_t *byte, uint32_t *word, char **ref, uint8_t *idlen) {
+	if(extmap == NULL || buf == NULL || idlen == NULL || id <= 0 || id >= 16)
+		return -1;
+	*idlen = 0;
+	if(extmap->offsets[id] == 0)
+		return -1;
+	*idlen = extmap->lengths[id];
+	if(byte)
+		*byte = (uint8_t)buf[extmap->offsets[id]];
+	if(word && *idlen >= 4) {
+		memcpy(word, buf+extmap->offsets[id], sizeof(uint32_t));
+		*word = ntohl(*word);
+	}
+	if(ref)
+		*ref = &buf[extmap->offsets[id]];
+	return 0;
+}
+
 int janus_rtp_header_extension_parse_audio_level(char *buf, int len, int id, gboolean *vad, int *level) {
 	uint8_t byte = 0, idlen = 0;
 	if(janus_rtp_header_extension_find(buf, len, id, &byte, NULL, NULL, &idlen) < 0)
@@ -227,6 +318,22 @@ int janus_rtp_header_extension_parse_audio_level(char *buf, int len, int id, gbo
 	return 0;
 }
 
+int janus_rtp_header_extension_parse_audio_level_indexed(janus_rtp_header_extension_index *extmap,
+		char *buf, int id, gboolean *vad, int *level) {
+	uint8_t byte = 0, idlen = 0;
+	if(janus_rtp_header_extension_find_indexed(extmap, buf, id, &byte, NULL, NULL, &idlen) < 0)
+		return -1;
+	/* a=extmap:1 urn:ietf:params:rtp-hdrext:ssrc-audio-level */
+	gboolean v = (byte & 0x80) >> 7;
+	int value = byte & 0x7F;
+	JANUS_LOG(LOG_DBG, "%02x --> v=%d, level=%d\n", byte, v, value);
+	if(vad)
+		*vad = v;
+	if(level)
+		*level = value;
+	return 0;
+}
+
 int janus_rtp_header_extension_parse_video_orientation(char *buf, int len, int id,
 		gboolean *c, gboolean *f, gboolean *r1, gboolean *r0) {
 	uint8_t byte = 0, idlen = 0;
@@ -249,6 +356,28 @@ int janus_rtp_header_extension_parse_video_orientation(char *buf, int len, int i
 	return 0;
 }
 
+int janus_rtp_header_extension_parse_video_orientation_indexed(janus_rtp_header_extension_index *extmap,
+		char *buf, int id, gboolean *c, gboolean *f, gboolean *r1, gboolean *r0) {
+	uint8_t byte = 0, idlen = 0;
+	if(janus_rtp_header_extension_find_indexed(extmap, buf, id, &byte, NULL, NULL, &idlen) < 0)
+		return -1;
+	/* a=extmap:4 urn:3gpp:video-orientation */
+	gboolean cbit = (byte & 0x08) >> 3;
+	gboolean fbit = (byte & 0x04) >> 2;
+	gboolean r1bit = (byte & 0x02) >> 1;
+	gboolean r0bit = byte & 0x01;
+	JANUS_LOG(LOG_DBG, "%02x --> c=%d, f=%d, r1=%d, r0=%d\n", byte, cbit, fbit, r1bit, r0bit);
+	if(c)
+		*c = cbit;
+	if(f)
+		*f = fbit;
+	if(r1)
+		*r1 = r1bit;
+	if(r0)
+		*r0 = r0bit;
+	return 0;
+}
+
 int janus_rtp_header_extension_parse_playout_delay(char *buf, int len, int id,
 		uint16_t *min_delay, uint16_t *max_delay) {
 	uint32_t bytes = 0;
@@ -268,6 +397,25 @@ int janus_rtp_header_extension_parse_playout_delay(char *buf, int len, int id,
 	return 0;
 }
 
+int janus_rtp_header_extension_parse_playout_delay_indexed(janus_rtp_header_extension_index *extmap,
+		char *buf, int id, uint16_t *min_delay, uint16_t *max_delay) {
+	uint32_t bytes = 0;
+	uint8_t idlen = 0;
+	if(janus_rtp_header_extension_find_indexed(extmap, buf, id, NULL, &bytes, NULL, &idlen) < 0)
+		return -1;
+	if(idlen < 3)
+		return -2;
+	/* a=extmap:6 http://www.webrtc.org/experiments/rtp-hdrext/playout-delay */
+	uint16_t min = (bytes & 0x00FFF000) >> 12;
+	uint16_t max = bytes & 0x00000FFF;
+	JANUS_LOG(LOG_DBG, "%"SCNu32"x --> min=%"SCNu16", max=%"SCNu16"\n", bytes, min, max);
+	if(min_delay)
+		*min_delay = min;
+	if(max_delay)
+		*max_delay = max;
+	return 0;
+}
+
 int janus_rtp_header_extension_parse_mid(char *buf, int len, int id,
 		char *sdes_item, int sdes_len) {
 	char *ext = NULL;
@@ -334,6 +482,29 @@ int janus_rtp_header_extension_parse_dependency_desc(char *buf, int len, int id,
 	return 0;
 }
 
+int janus_rtp_header_extension_parse_dependency_desc_indexed(janus_rtp_header_extension_index *extmap,
+		char *buf, int len, int id, uint8_t *dd_item, int *dd_len) {
+	char *ext = NULL;
+	uint8_t idlen = 0;
+	int buflen = *dd_len;
+	*dd_len = 0;
+	if(janus_rtp_header_extension_find_indexed(extmap, buf, id, NULL, NULL, &ext, &idlen) < 0)
+		return -1;
+	/* a=extmap:10 https://aomediacodec.github.io/av1-rtp-spec/#dependency-descriptor-rtp-header-extension */
+	if(ext == NULL || idlen < 1)
+		return -2;
+	if(idlen > buflen) {
+		JANUS_LOG(LOG_WARN, "SDES buffer is too small (%d > %d), dependency descriptor will be cut\n", idlen, buflen);
+		idlen = buflen;
+	}
+	if(idlen > len-(ext-buf)-1 ) {
+		return -3;
+	}
+	memcpy(dd_item, ext, idlen);
+	*dd_len = idlen;
+	return 0;
+}
+
 int janus_rtp_header_extension_parse_abs_send_time(char *buf, int len, int id, uint32_t *abs_ts) {
 	char *ext = NULL;
 	uint8_t idlen = 0;
@@ -382,6 +553,24 @@ int janus_rtp_header_extension_parse_abs_capture_time(char *buf, int len, int id
 	return 0;
 }
 
+int janus_rtp_header_extension_parse_abs_capture_time_indexed(janus_rtp_header_extension_index *extmap,
+		char *buf, int id, uint64_t *abs_ts) {
+	char *ext = NULL;
+	uint8_t idlen = 0;
+	if(janus_rtp_header_extension_find_indexed(extmap, buf, id, NULL, NULL, &ext, &idlen) < 0)
+		return -1;
+	/* a=extmap:7 http://www.webrtc.org/experiments/rtp-hdrext/abs-capture-time */
+	if(ext == NULL)
+		return -2;
+	if(idlen < 8)
+		return -3;
+	uint64_t abs64 = 0;
+	memcpy(&abs64, ext, 8);
+	if(abs_ts)
+		*abs_ts = ntohll(abs64);
+	return 0;
+}
+
 int janus_rtp_header_extension_set_abs_capture_time(char *buf, int len, int id, uint64_t abs_ts) {
 	char *ext = NULL;
 	uint8_t idlen = 0;
@@ -1118,6 +1307,76 @@ void janus_rtp_simulcasting_cleanup(int *rid_ext_id, uint32_t *ssrcs, char **rid
 		janus_mutex_unlock(rid_mutex);
 }
 
+/* Helper to (re)compile the per-substream relay decisions for a simulcasting
+ * context: this only happens when the simulcast state actually changes, so
+ * that in steady state processing a packet is mostly a table lookup */
+static void janus_rtp_simulcasting_context_compile(janus_rtp_simulcasting_context *context) {
+	/* If the configured target dropped at or below the temporary one, the latter is moot */
+	if(context->substream_target_temp != -1 && context->substream_target <= context->substream_target_temp)
+		context->substream_target_temp = -1;
+	int target = (context->substream_target_temp == -1) ? context->substream_target : context->substream_target_temp;
+	int s = 0;
+	for(s=0; s<3; s++) {
+		if(context->substream == -1) {
+			/* We're not relaying anything yet: a keyframe on any substream gets us started */
+			context->decision[s] = JANUS_SIMULCAST_SUBSTREAM_CHECK;
+		} else if(context->substream_target_temp != -1 && s > context->substream_target_temp) {
+			/* Media flowing on a substream higher than the one we dropped to
+			 * means we may be able to recover the configured target */
+			context->decision[s] = JANUS_SIMULCAST_SUBSTREAM_CHECK;
+		} else if(s == context->substream) {
+			context->decision[s] = JANUS_SIMULCAST_SUBSTREAM_RELAY;
+		} else if(context->substream != target &&
+				((context->substream < target && s > context->substream) ||
+				(context->substream > target && s < context->substream))) {
+			/* We may switch to this substream, if we see a keyframe on it */
+			context->decision[s] = JANUS_SIMULCAST_SUBSTREAM_CHECK;
+		} else {
+			context->decision[s] = JANUS_SIMULCAST_SUBSTREAM_DROP;
+		}
+	}
+	/* If no temporal layer constraint is set, we can also skip parsing the
+	 * payload descriptor of every relayed packet (only matters for VP8) */
+	context->check_temporal = (context->templayer != -1 || context->templayer_target != -1);
+	/* Keep track of the state the table was compiled against */
+	context->c_substream = context->substream;
+	context->c_substream_target = context->substream_target;
+	context->c_substream_target_temp = context->substream_target_temp;
+	context->c_templayer = context->templayer;
+	context->c_templayer_target = context->templayer_target;
+}
+
+/* Helper to check whether the substream we're supposed to be relaying went
+ * silent, in which case we temporarily fall back to a lower substream */
+static void janus_rtp_simulcasting_context_check_fallback(janus_rtp_simulcasting_context *context, int substream, gint64 now) {
+	if(context->last_relayed == 0) {
+		/* Let's start slow */
+		context->last_relayed = now;
+	} else if(context->substream > 0) {
+		/* Check if too much time went by with no packet relayed */
+		if((now - context->last_relayed) > (context->drop_trigger ? context->drop_trigger : 250000)) {
+			context->last_relayed = now;
+			if(context->substream != substream && context->substream_target_temp != 0) {
+				if(context->substream_target > substream) {
+					int prev_target = context->substream_target_temp;
+					if(context->substream_target_temp == -1)
+						context->substream_target_temp = context->substream_target - 1;
+					else
+						context->substream_target_temp--;
+					if(context->substream_target_temp < 0)
+						context->substream_target_temp = 0;
+					if(context->substream_target_temp != prev_target) {
+						JANUS_LOG(LOG_WARN, "No packet received on substream %d for a while, falling back to %d\n",
+							context->substream, context->substream_target_temp);
+						/* Notify the caller that we (still) need a PLI */
+						context->need_pli = TRUE;
+					}
+				}
+			}
+		}
+	}
+}
+
 gboolean janus_rtp_simulcasting_context_process_rtp(janus_rtp_simulcasting_context *context,
 		char *buf, int len, uint8_t *dd_content, int dd_len, uint32_t *ssrcs, char **rids,
 		janus_videocodec vcodec, janus_rtp_switching_context *sc, janus_mutex *rid_mutex) {
@@ -1166,79 +1425,73 @@ gboolean janus_rtp_simulcasting_context_process_rtp(janus_rtp_simulcasting_conte
 	context->changed_temporal = FALSE;
 	context->need_pli = FALSE;
 	gint64 now = janus_get_monotonic_time();
+	/* If the state the decision table was compiled against changed (e.g., the
+	 * plugin asked for different target layers), recompile the table first */
+	if(context->c_substream != context->substream ||
+			context->c_substream_target != context->substream_target ||
+			context->c_substream_target_temp != context->substream_target_temp ||
+			context->c_templayer != context->templayer ||
+			context->c_templayer_target != context->templayer_target)
+		janus_rtp_simulcasting_context_compile(context);
+	if(context->decision[substream] == JANUS_SIMULCAST_SUBSTREAM_DROP) {
+		/* This is from a substream we're not relaying and can't switch to:
+		 * no need to access the payload at all, we only check whether the
+		 * substream we are relaying went silent before dropping the packet */
+		janus_rtp_simulcasting_context_check_fallback(context, substream, now);
+		JANUS_LOG(LOG_HUGE, "Dropping packet (it's from SSRC %"SCNu32", but we're only relaying SSRC %"SCNu32" now\n",
+			ssrc, *(ssrcs + context->substream));
+		return FALSE;
+	}
 	/* Access the packet payload */
 	int plen = 0;
 	char *payload = janus_rtp_payload(buf, len, &plen);
 	if(payload == NULL)
 		return FALSE;
-	/* Check what's our target */
-	if(context->substream_target_temp != -1 && (substream > context->substream_target_temp ||
-			context->substream_target <= context->substream_target_temp)) {
-		/* We either just received media on a substream that is higher than
-		 * the target we dropped to (which means the one we want is now flowing
-		 * again) or we've been requested a lower substream target instead */
-		context->substream_target_temp = -1;
-	}
-	int target = (context->substream_target_temp == -1) ? context->substream_target : context->substream_target_temp;
-	/* Check what we need to do with the packet */
-	if(context->substream == -1) {
-		if((vcodec == JANUS_VIDEOCODEC_VP8 && janus_vp8_is_keyframe(payload, plen)) ||
-				(vcodec == JANUS_VIDEOCODEC_VP9 && janus_vp9_is_keyframe(payload, plen)) ||
-				(vcodec == JANUS_VIDEOCODEC_H264 && janus_h264_is_keyframe(payload, plen)) ||
-				(vcodec == JANUS_VIDEOCODEC_AV1 && janus_av1_is_keyframe(payload, plen)) ||
-				(vcodec == JANUS_VIDEOCODEC_H265 && janus_h265_is_keyframe(payload, plen))) {
-			context->substream = substream;
-			/* Notify the caller that the substream changed */
-			context->changed_substream = TRUE;
-			context->last_relayed = now;
-		} else {
-			/* Don't relay anything until we get a keyframe */
-			return FALSE;
+	if(context->decision[substream] == JANUS_SIMULCAST_SUBSTREAM_CHECK) {
+		/* A switch may be pending on this substream: check what's our target */
+		if(context->substream_target_temp != -1 && (substream > context->substream_target_temp ||
+				context->substream_target <= context->substream_target_temp)) {
+			/* We either just received media on a substream that is higher than
+			 * the target we dropped to (which means the one we want is now flowing
+			 * again) or we've been requested a lower substream target instead */
+			context->substream_target_temp = -1;
 		}
-	} else if(context->substream != target) {
-		/* We're not on the substream we'd like: let's wait for a keyframe on the target */
-		if(((context->substream < target && substream > context->substream) ||
-				(context->substream > target && substream < context->substream)) &&
-					((vcodec == JANUS_VIDEOCODEC_VP8 && janus_vp8_is_keyframe(payload, plen)) ||
+		int target = (context->substream_target_temp == -1) ? context->substream_target : context->substream_target_temp;
+		/* Check what we need to do with the packet */
+		if(context->substream == -1) {
+			if((vcodec == JANUS_VIDEOCODEC_VP8 && janus_vp8_is_keyframe(payload, plen)) ||
 					(vcodec == JANUS_VIDEOCODEC_VP9 && janus_vp9_is_keyframe(payload, plen)) ||
 					(vcodec == JANUS_VIDEOCODEC_H264 && janus_h264_is_keyframe(payload, plen)) ||
 					(vcodec == JANUS_VIDEOCODEC_AV1 && janus_av1_is_keyframe(payload, plen)) ||
-					(vcodec == JANUS_VIDEOCODEC_H265 && janus_h265_is_keyframe(payload, plen)))) {
-			JANUS_LOG(LOG_VERB, "Received keyframe on #%d (SSRC %"SCNu32"), switching (was #%d/%"SCNu32")\n",
-				substream, ssrc, context->substream, *(ssrcs + context->substream));
-			context->substream = substream;
-			/* Notify the caller that the substream changed */
-			context->changed_substream = TRUE;
-			context->last_relayed = now;
-		}
-	}
-	/* If we haven't received our desired substream yet, let's drop temporarily */
-	if(context->last_relayed == 0) {
-		/* Let's start slow */
-		context->last_relayed = now;
-	} else if(context->substream > 0) {
-		/* Check if too much time went by with no packet relayed */
-		if((now - context->last_relayed) > (context->drop_trigger ? context->drop_trigger : 250000)) {
-			context->last_relayed = now;
-			if(context->substream != substream && context->substream_target_temp != 0) {
-				if(context->substream_target > substream) {
-					int prev_target = context->substream_target_temp;
-					if(context->substream_target_temp == -1)
-						context->substream_target_temp = context->substream_target - 1;
-					else
-						context->substream_target_temp--;
-					if(context->substream_target_temp < 0)
-						context->substream_target_temp = 0;
-					if(context->substream_target_temp != prev_target) {
-						JANUS_LOG(LOG_WARN, "No packet received on substream %d for a while, falling back to %d\n",
-							context->substream, context->substream_target_temp);
-						/* Notify the caller that we (still) need a PLI */
-						context->need_pli = TRUE;
-					}
-				}
+					(vcodec == JANUS_VIDEOCODEC_H265 && janus_h265_is_keyframe(payload, plen))) {
+				context->substream = substream;
+				/* Notify the caller that the substream changed */
+				context->changed_substream = TRUE;
+				context->last_relayed = now;
+			} else {
+				/* Don't relay anything until we get a keyframe */
+				return FALSE;
+			}
+		} else if(context->substream != target) {
+			/* We're not on the substream we'd like: let's wait for a keyframe on the target */
+			if(((context->substream < target && substream > context->substream) ||
+					(context->substream > target && substream < context->substream)) &&
+						((vcodec == JANUS_VIDEOCODEC_VP8 && janus_vp8_is_keyframe(payload, plen)) ||
+						(vcodec == JANUS_VIDEOCODEC_VP9 && janus_vp9_is_keyframe(payload, plen)) ||
+						(vcodec == JANUS_VIDEOCODEC_H264 && janus_h264_is_keyframe(payload, plen)) ||
+						(vcodec == JANUS_VIDEOCODEC_AV1 && janus_av1_is_keyframe(payload, plen)) ||
+						(vcodec == JANUS_VIDEOCODEC_H265 && janus_h265_is_keyframe(payload, plen)))) {
+				JANUS_LOG(LOG_VERB, "Received keyframe on #%d (SSRC %"SCNu32"), switching (was #%d/%"SCNu32")\n",
+					substream, ssrc, context->substream, *(ssrcs + context->substream));
+				context->substream = substream;
+				/* Notify the caller that the substream changed */
+				context->changed_substream = TRUE;
+				context->last_relayed = now;
 			}
 		}
 	}
+	/* If we haven't received our desired substream yet, let's drop temporarily */
+	janus_rtp_simulcasting_context_check_fallback(context, substream, now);
 	/* Do we need to drop this? */
 	if(context->substream < 0)
 		return FALSE;
@@ -1249,7 +1502,7 @@ gboolean janus_rtp_simulcasting_context_process_rtp(janus_rtp_simulcasting_conte
 	}
 	context->last_relayed = janus_get_monotonic_time();
 	/* Temporal layers are only easily available for some codecs */
-	if(vcodec == JANUS_VIDEOCODEC_VP8) {
+	if(vcodec == JANUS_VIDEOCODEC_VP8 && context->check_temporal) {
 		/* Check if there's any temporal scalability to take into account */
 		gboolean m = FALSE;
 		uint16_t picid = 0;
@@ -1313,26 +1566,26 @@ gboolean janus_rtp_simulcasting_context_process_rtp(janus_rtp_simulcasting_conte
 		if(av1ctx != NULL) {
 			uint8_t template = 0;
 			if(janus_av1_svc_context_process_dd(av1ctx, dd_content, dd_len, &template, NULL)) {
-				janus_av1_svc_template *t = g_hash_table_lookup(av1ctx->templates, GUINT_TO_POINTER(template));
-				if(t) {
+				int8_t t_temporal = av1ctx->template_temporal[template];
+				if(t_temporal != -1) {
 					int temporal_layer = context->templayer;
 					if(context->templayer_target > context->templayer) {
 						/* We need to upscale */
-						if(t->temporal > context->templayer && t->temporal <= context->templayer_target) {
-							context->templayer = t->temporal;
+						if(t_temporal > context->templayer && t_temporal <= context->templayer_target) {
+							context->templayer = t_temporal;
 							temporal_layer = context->templayer;
 							context->changed_temporal = TRUE;
 						}
 					} else if(context->templayer_target < context->templayer) {
 						/* We need to downscale */
-						if(t->temporal == context->templayer_target) {
+						if(t_temporal == context->templayer_target) {
 							context->templayer = context->templayer_target;
 							context->changed_temporal = TRUE;
 						}
 					}
-					if(temporal_layer < t->temporal) {
+					if(temporal_layer < t_temporal) {
 						JANUS_LOG(LOG_HUGE, "Dropping packet (it's temporal layer %d, but we're capping at %d)\n",
-							t->temporal, context->templayer);
+							t_temporal, context->templayer);
 						/* We increase the base sequence number, or there will be gaps when delivering later */
 						if(sc)
 							sc->base_seq++;
@@ -1385,8 +1638,9 @@ gboolean janus_rtp_svc_context_process_rtp(janus_rtp_svc_context *context,
 			/* We couldn't parse the Dependency Descriptor, relay as it is */
 			return TRUE;
 		}
-		janus_av1_svc_template *t = g_hash_table_lookup(context->dd_context.templates, GUINT_TO_POINTER(template));
-		if(t == NULL) {
+		int8_t t_spatial = context->dd_context.template_spatial[template],
+			t_temporal = context->dd_context.template_temporal[template];
+		if(t_spatial == -1) {
 			/* We couldn't find the template, relay as it is */
 			return TRUE;
 		}
@@ -1394,8 +1648,8 @@ gboolean janus_rtp_svc_context_process_rtp(janus_rtp_svc_context *context,
 		gboolean keyframe = janus_av1_is_keyframe((const char *)payload, plen);
 		gboolean override_mark_bit = FALSE, has_marker_bit = header->markerbit;
 		int spatial_layer = context->spatial;
-		if(t->spatial >= 0 && t->spatial <= 2)
-			context->last_spatial_layer[t->spatial] = now;
+		if(t_spatial >= 0 && t_spatial <= 2)
+			context->last_spatial_layer[t_spatial] = now;
 		if(context->spatial_target > context->spatial) {
 			JANUS_LOG(LOG_HUGE, "We need to upscale spatially: (%d < %d)\n",
 				context->spatial, context->spatial_target);
@@ -1432,34 +1686,34 @@ gboolean janus_rtp_svc_context_process_rtp(janus_rtp_svc_context *context,
 				context->changed_spatial = TRUE;
 			}
 		}
-		if(spatial_layer < t->spatial) {
+		if(spatial_layer < t_spatial) {
 			/* Drop the packet: update the context to make sure sequence number is increased normally later */
-			JANUS_LOG(LOG_HUGE, "Dropping packet (spatial layer %d < %d)\n", spatial_layer, t->spatial);
+			JANUS_LOG(LOG_HUGE, "Dropping packet (spatial layer %d < %d)\n", spatial_layer, t_spatial);
 			if(sc)
 				sc->base_seq++;
 			return FALSE;
-		} else if(ebit && spatial_layer == t->spatial) {
+		} else if(ebit && spatial_layer == t_spatial) {
 			/* If we stop at layer 0, we need a marker bit now, as the one from layer 1 will not be received */
 			override_mark_bit = TRUE;
 		}
 		int temporal = context->temporal;
 		if(context->temporal_target > context->temporal) {
 			/* We need to upscale */
-			if(t->temporal > context->temporal && t->temporal <= context->temporal_target) {
-				context->temporal = t->temporal;
+			if(t_temporal > context->temporal && t_temporal <= context->temporal_target) {
+				context->temporal = t_temporal;
 				temporal = context->temporal;
 				context->changed_temporal = TRUE;
 			}
 		} else if(context->temporal_target < context->temporal) {
 			/* We need to downscale */
-			if(t->temporal == context->temporal_target) {
+			if(t_temporal == context->temporal_target) {
 				context->temporal = context->temporal_target;
 				context->changed_temporal = TRUE;
 			}
 		}
-		if(temporal < t->temporal) {
+		if(temporal < t_temporal) {
 			JANUS_LOG(LOG_HUGE, "Dropping packet (it's temporal layer %d, but we're capping at %d)\n",
-				t->temporal, context->temporal);
+				t_temporal, context->temporal);
 			/* We increase the base sequence number, or there will be gaps when delivering later */
 			if(sc)
 				sc->base_seq++;
@@ -1468,7 +1722,7 @@ gboolean janus_rtp_svc_context_process_rtp(janus_rtp_svc_context *context,
 		/* If we got here, we can send the frame: this doesn't necessarily mean it's
 		 * one of the layers the user wants, as there may be dependencies involved */
 		JANUS_LOG(LOG_HUGE, "Sending packet (spatial=%d, temporal=%d)\n",
-			t->spatial, t->temporal);
+			t_spatial, t_temporal);
 		if(override_mark_bit && !has_marker_bit)
 			header->markerbit = 1;
 		return TRUE;
@@ -1599,6 +1853,9 @@ void janus_av1_svc_context_reset(janus_av1_svc_context *context) {
 	if(context->templates != NULL)
 		g_hash_table_destroy(context->templates);
 	memset(context, 0, sizeof(*context));
+	/* No known templates, until we see a template structure again */
+	memset(context->template_spatial, -1, sizeof(context->template_spatial));
+	memset(context->template_temporal, -1, sizeof(context->template_temporal));
 }
 
 gboolean janus_av1_svc_context_process_dd(janus_av1_svc_context *context,
@@ -1606,6 +1863,24 @@ gboolean janus_av1_svc_context_process_dd(janus_av1_svc_context *context,
 	if(!context || !dd || dd_len < 3)
 		return FALSE;
 
+	/* If there are no extended fields and we know the templates already,
+	 * take the precomputed fast path: everything we need to resolve the
+	 * packet sits in the first byte, at fixed offsets (s/e bits and the
+	 * 6-bit template ID), so we can skip the bitstream reader entirely */
+	if(dd_len == 3 && context->templates != NULL) {
+		if(ebit)
+			*ebit = (dd[0] >> 6) & 0x01;
+		uint8_t tindex = ((dd[0] & 0x3F) + 64 - context->tioff) % 64;
+		if(context->template_spatial[tindex] == -1) {
+			JANUS_LOG(LOG_WARN, "Invalid template ID '%u' (count is %u), ignoring packet...\n",
+				tindex, context->tcnt);
+			return FALSE;
+		}
+		if(template_id != NULL)
+			*template_id = tindex;
+		return TRUE;
+	}
+
 	/* First of all, let's parse the Dependency Descriptor */
 	size_t blen = dd_len*8;
 	uint32_t offset = 0;
@@ -1667,6 +1942,17 @@ gboolean janus_av1_svc_context_process_dd(janus_av1_svc_context *context,
 			context->tioff = tioff;
 			context->spatial_layers = spatial_layers;
 			context->temporal_layers = temporal_layers;
+			/* Rebuild the flattened template map the hot path relies on */
+			memset(context->template_spatial, -1, sizeof(context->template_spatial));
+			memset(context->template_temporal, -1, sizeof(context->template_temporal));
+			GHashTableIter titer;
+			gpointer tvalue;
+			g_hash_table_iter_init(&titer, context->templates);
+			while(g_hash_table_iter_next(&titer, NULL, &tvalue)) {
+				janus_av1_svc_template *tmpl = (janus_av1_svc_template *)tvalue;
+				context->template_spatial[tmpl->id] = tmpl->spatial;
+				context->template_temporal[tmpl->id] = tmpl->temporal;
+			}
 			/* FIXME We currently don't care about the other fields */
 		}
 	}
@@ -64,6 +64,16 @@ typedef struct janus_rtp_packet {
 	gint64 created;
 	gint64 last_retransmit;
 	janus_plugin_rtp_extensions extensions;
+	/*! \brief Refcounted buffer the payload may live in: when set, \c data
+	 * only holds the packet headers, and the payload (shared with all the
+	 * other recipients of the same source packet, e.g., the subscribers of
+	 * the same publisher in an SFU scenario) is reconstructed from here if
+	 * a retransmission is needed, instead of being stored once per handle */
+	janus_plugin_buffer *shared;
+	/*! \brief Where the payload starts within the shared buffer, if any */
+	char *shared_payload;
+	/*! \brief Length of the payload within the shared buffer, if any */
+	uint16_t shared_plen;
 } janus_rtp_packet;
 
 /*! \brief RTP extension */
@@ -171,6 +181,26 @@ int janus_rtp_header_extension_get_id(const char *sdp, const char *extension);
  * @returns The extension namespace, if found, NULL otherwise */
 const char *janus_rtp_header_extension_get_from_id(const char *sdp, int id);
 
+/*! \brief Helper structure to index all the header extensions carried by an RTP
+ * packet with a single pass on the extension block: once filled, the individual
+ * values can be read with the *_indexed parsing helpers below, without ever
+ * rescanning the packet (useful when several extmaps are negotiated) */
+typedef struct janus_rtp_header_extension_index {
+	/*! \brief Offset in the packet of the data of each extension ID (0 if the ID is not in the packet) */
+	uint16_t offsets[16];
+	/*! \brief Length of the data of each extension ID */
+	uint8_t lengths[16];
+} janus_rtp_header_extension_index;
+
+/*! \brief Helper to index all the header extensions in an RTP packet in a single pass
+ * @note Only extension IDs between 1 and 14 are indexed, which covers all the
+ * IDs a one-byte extension header can carry (and all the ones we negotiate)
+ * @param[in] buf The packet data
+ * @param[in] len The packet data length in bytes
+ * @param[out] extmap The index to fill
+ * @returns The number of indexed extensions, if successful, a negative integer on errors */
+int janus_rtp_header_extensions_index(char *buf, int len, janus_rtp_header_extension_index *extmap);
+
 /*! \brief Helper to parse a ssrc-audio-level RTP extension (https://tools.ietf.org/html/rfc6464)
  * @note Browsers apparently always set the VAD to 1, so it's unreliable and should be ignored:
  * only use this method if you're interested in the audio-level value itself.
@@ -182,6 +212,16 @@ const char *janus_rtp_header_extension_get_from_id(const char *sdp, int id);
  * @returns 0 if found, -1 otherwise */
 int janus_rtp_header_extension_parse_audio_level(char *buf, int len, int id, gboolean *vad, int *level);
 
+/*! \brief Same as janus_rtp_header_extension_parse_audio_level, but reading from an index
+ * @param[in] extmap The index filled by janus_rtp_header_extensions_index
+ * @param[in] buf The packet data
+ * @param[in] id The extension ID to look for
+ * @param[out] vad Whether the encoder thinks there's voice activity
+ * @param[out] level The level value in dBov (0=max, 127=min)
+ * @returns 0 if found, -1 otherwise */
+int janus_rtp_header_extension_parse_audio_level_indexed(janus_rtp_header_extension_index *extmap,
+	char *buf, int id, gboolean *vad, int *level);
+
 /*! \brief Helper to parse a video-orientation RTP extension (http://www.3gpp.org/ftp/Specs/html-info/26114.htm)
  * @param[in] buf The packet data
  * @param[in] len The packet data length in bytes
@@ -194,6 +234,18 @@ int janus_rtp_header_extension_parse_audio_level(char *buf, int len, int id, gbo
 int janus_rtp_header_extension_parse_video_orientation(char *buf, int len, int id,
 	gboolean *c, gboolean *f, gboolean *r1, gboolean *r0);
 
+/*! \brief Same as janus_rtp_header_extension_parse_video_orientation, but reading from an index
+ * @param[in] extmap The index filled by janus_rtp_header_extensions_index
+ * @param[in] buf The packet data
+ * @param[in] id The extension ID to look for
+ * @param[out] c The value of the Camera (C) bit
+ * @param[out] f The value of the Flip (F) bit
+ * @param[out] r1 The value of the first Rotation (R1) bit
+ * @param[out] r0 The value of the second Rotation (R0) bit
+ * @returns 0 if found, -1 otherwise */
+int janus_rtp_header_extension_parse_video_orientation_indexed(janus_rtp_header_extension_index *extmap,
+	char *buf, int id, gboolean *c, gboolean *f, gboolean *r1, gboolean *r0);
+
 /*! \brief Helper to parse a playout-delay RTP extension (https://webrtc.org/experiments/rtp-hdrext/playout-delay)
  * @param[in] buf The packet data
  * @param[in] len The packet data length in bytes
@@ -204,6 +256,16 @@ int janus_rtp_header_extension_parse_video_orientation(char *buf, int len, int i
 int janus_rtp_header_extension_parse_playout_delay(char *buf, int len, int id,
 	uint16_t *min_delay, uint16_t *max_delay);
 
+/*! \brief Same as janus_rtp_header_extension_parse_playout_delay, but reading from an index
+ * @param[in] extmap The index filled by janus_rtp_header_extensions_index
+ * @param[in] buf The packet data
+ * @param[in] id The extension ID to look for
+ * @param[out] min_delay The minimum delay value
+ * @param[out] max_delay The maximum delay value
+ * @returns 0 if found, -1 otherwise */
+int janus_rtp_header_extension_parse_playout_delay_indexed(janus_rtp_header_extension_index *extmap,
+	char *buf, int id, uint16_t *min_delay, uint16_t *max_delay);
+
 /*! \brief Helper to parse a sdes-mid RTP extension (https://tools.ietf.org/html/draft-ietf-mmusic-sdp-bundle-negotiation-54)
  * @param[in] buf The packet data
  * @param[in] len The packet data length in bytes
@@ -234,6 +296,17 @@ int janus_rtp_header_extension_parse_rid(char *buf, int len, int id,
 int janus_rtp_header_extension_parse_dependency_desc(char *buf, int len, int id,
 	uint8_t *dd_item, int *dd_len);
 
+/*! \brief Same as janus_rtp_header_extension_parse_dependency_desc, but reading from an index
+ * @param[in] extmap The index filled by janus_rtp_header_extensions_index
+ * @param[in] buf The packet data
+ * @param[in] len The packet data length in bytes
+ * @param[in] id The extension ID to look for
+ * @param[out] dd_item Buffer where the dependency descriptor will be written
+ * @param[out] dd_len Size of the input/output buffer, will be updated with the size of the data
+ * @returns 0 if found, -1 otherwise */
+int janus_rtp_header_extension_parse_dependency_desc_indexed(janus_rtp_header_extension_index *extmap,
+	char *buf, int len, int id, uint8_t *dd_item, int *dd_len);
+
 /*! \brief Helper to parse an abs-send-time RTP extension (http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time)
  * @param[in] buf The packet data
  * @param[in] len The packet data length in bytes
@@ -258,6 +331,15 @@ int janus_rtp_header_extension_set_abs_send_time(char *buf, int len, int id, uin
  * @returns 0 if found, -1 otherwise */
 int janus_rtp_header_extension_parse_abs_capture_time(char *buf, int len, int id, uint64_t *abs_ts);
 
+/*! \brief Same as janus_rtp_header_extension_parse_abs_capture_time, but reading from an index
+ * @param[in] extmap The index filled by janus_rtp_header_extensions_index
+ * @param[in] buf The packet data
+ * @param[in] id The extension ID to look for
+ * @param[out] abs_ts Variable where the parsed abs-capture-time value will be stored
+ * @returns 0 if found, -1 otherwise */
+int janus_rtp_header_extension_parse_abs_capture_time_indexed(janus_rtp_header_extension_index *extmap,
+	char *buf, int id, uint64_t *abs_ts);
+
 /*! \brief Helper to set an abs-capture-time RTP extension (http://www.webrtc.org/experiments/rtp-hdrext/abs-capture-time)
  * @param[in] buf The packet data
  * @param[in] len The packet data length in bytes
@@ -341,6 +423,11 @@ typedef struct janus_av1_svc_context {
 	uint8_t tioff;
 	/*! \brief Map of templates advertised via Dependency Descriptor, indexed by ID */
 	GHashTable *templates;
+	/*! \brief Flattened per-template spatial/temporal layers (-1 means unknown
+	 * template): rebuilt only when the template structure changes, so that
+	 * steady-state packets resolve their template with two array reads,
+	 * instead of hash table lookups in the relay hot path */
+	int8_t template_spatial[64], template_temporal[64];
 	/*! \brief How many spatial and temporal layers are available */
 	int spatial_layers, temporal_layers;
 	/*! \brief Whether this context changed since the last update */
@@ -382,6 +469,11 @@ gboolean janus_av1_svc_context_process_dd(janus_av1_svc_context *context,
  */
 ///@{
 /*! \brief Helper struct for processing and tracking simulcast streams */
+/*! \brief Precompiled per-substream decisions for simulcast packet processing */
+#define JANUS_SIMULCAST_SUBSTREAM_DROP	0
+#define JANUS_SIMULCAST_SUBSTREAM_RELAY	1
+#define JANUS_SIMULCAST_SUBSTREAM_CHECK	2
+
 typedef struct janus_rtp_simulcasting_context {
 	/*! \brief RTP Stream extension ID, if any */
 	gint rid_ext_id;
@@ -405,6 +497,15 @@ typedef struct janus_rtp_simulcasting_context {
 	gboolean changed_temporal;
 	/*! \brief Whether we need to send the user a keyframe request (PLI) */
 	gboolean need_pli;
+	/*! \brief Precompiled decision for packets of each substream (drop, relay,
+	 * or run the full switching checks), so that in steady state the
+	 * per-packet path is mostly a table lookup */
+	uint8_t decision[3];
+	/*! \brief Whether the temporal layer state requires parsing each relayed packet */
+	gboolean check_temporal;
+	/*! \brief Copy of the state the decision table was compiled against, to
+	 * detect changes (e.g., a plugin updating the target layers) */
+	int c_substream, c_substream_target, c_substream_target_temp, c_templayer, c_templayer_target;
 } janus_rtp_simulcasting_context;
 
 /*! \brief Set (or reset) the context fields to their default values
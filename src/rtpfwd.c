@@ -13,6 +13,15 @@
  * \ref protocols
  */
 
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sys/socket.h>
+#endif
+
+#include <fcntl.h>
+
 #include "rtpfwd.h"
 #include "rtcp.h"
 #include "utils.h"
@@ -21,6 +30,125 @@
 static janus_mutex rtpfwds_mutex;
 static GHashTable *rtpfwds = NULL;
 static gboolean ipv6_disabled = FALSE;
+
+/* Local pipes, for in-process delivery of forwarded packets to another
+ * plugin (e.g., a VideoRoom publisher feeding a Streaming mountpoint,
+ * without a loopback RTP hop and the related SRTP overhead): the table
+ * maps pipe names to the descriptor packets should be written to */
+static GHashTable *rtpfwd_pipes = NULL;
+static janus_mutex rtpfwd_pipes_mutex;
+
+/* Forwarders created with the same SRTP suite and crypto material can
+ * share a single SRTP context, as long as each of them puts a different
+ * SSRC in the packets it sends: encryption state (and outbound replay
+ * protection) is per-SSRC within a context, so distinct streams don't
+ * step on each other, while two forwarders emitting the same SSRC would
+ * trip the replay check. We track the SSRCs enrolled in each shared
+ * context, and forwarders that can't guarantee a unique one (e.g.,
+ * because they pass the peer SSRC through untouched) keep using a
+ * private context as before */
+struct janus_rtp_forwarder_srtp {
+	/* \brief Key of this context in the table ("suite:crypto") */
+	char *id;
+	/* \brief The shared SRTP context */
+	srtp_t ctx;
+	/* \brief The SRTP policy the context was created from */
+	srtp_policy_t policy;
+	/* \brief Set of SSRCs currently enrolled in this context */
+	GHashTable *ssrcs;
+	/* \brief Number of forwarders currently using this context */
+	guint refs;
+	/* \brief Mutex to serialize encryption, as the forwarders sharing
+	 * the context may be sending from different threads */
+	janus_mutex mutex;
+};
+static GHashTable *rtpfwd_srtp = NULL;
+static janus_mutex rtpfwd_srtp_mutex;
+static void janus_rtp_forwarder_srtp_destroy(janus_rtp_forwarder_srtp *shared) {
+	srtp_dealloc(shared->ctx);
+	g_free(shared->policy.key);
+	g_hash_table_destroy(shared->ssrcs);
+	g_free(shared->id);
+	g_free(shared);
+}
+
+/* Per-thread batching of forwarded packets: plugins iterating on many
+ * forwarders for the same packet can bracket the loop with the batch
+ * helpers below, and the sends that use the same socket are then
+ * aggregated and flushed with a single sendmmsg() call, instead of
+ * costing one sendto() each (on platforms missing sendmmsg() the
+ * helpers are no-ops, and sends keep happening right away) */
+#ifdef __linux__
+#define JANUS_RTPFWD_BATCH_MAX	32
+typedef struct janus_rtp_forwarder_batch {
+	gboolean active;
+	int fd;
+	guint count;
+	struct mmsghdr msgs[JANUS_RTPFWD_BATCH_MAX];
+	struct iovec iovs[JANUS_RTPFWD_BATCH_MAX];
+	struct sockaddr_storage addrs[JANUS_RTPFWD_BATCH_MAX];
+	char bufs[JANUS_RTPFWD_BATCH_MAX][1500];
+} janus_rtp_forwarder_batch;
+static GPrivate rtpfwd_batch_key = G_PRIVATE_INIT(g_free);
+static void janus_rtp_forwarder_batch_send(janus_rtp_forwarder_batch *batch) {
+	if(batch->count == 0)
+		return;
+	int sent = sendmmsg(batch->fd, batch->msgs, batch->count, 0);
+	if(sent < (int)batch->count) {
+		JANUS_LOG(LOG_HUGE, "Error forwarding batched RTP packets... %s (sent %d of %u)...\n",
+			g_strerror(errno), sent > 0 ? sent : 0, batch->count);
+	}
+	batch->count = 0;
+	batch->fd = -1;
+}
+/* Helper to add a packet to the current batch, if there is one: returns
+ * FALSE if the packet should just be sent right away instead */
+static gboolean janus_rtp_forwarder_batch_queue(janus_rtp_forwarder *rf, char *buffer, int len,
+		struct sockaddr *address, socklen_t addrlen) {
+	janus_rtp_forwarder_batch *batch = g_private_get(&rtpfwd_batch_key);
+	if(batch == NULL || !batch->active || len <= 0 || len > (int)sizeof(batch->bufs[0]))
+		return FALSE;
+	if(batch->count > 0 && batch->fd != rf->udp_fd) {
+		/* Different socket, flush what we have so far first */
+		janus_rtp_forwarder_batch_send(batch);
+	}
+	batch->fd = rf->udp_fd;
+	guint i = batch->count;
+	memcpy(batch->bufs[i], buffer, len);
+	memcpy(&batch->addrs[i], address, addrlen);
+	batch->iovs[i].iov_base = batch->bufs[i];
+	batch->iovs[i].iov_len = len;
+	memset(&batch->msgs[i], 0, sizeof(struct mmsghdr));
+	batch->msgs[i].msg_hdr.msg_iov = &batch->iovs[i];
+	batch->msgs[i].msg_hdr.msg_iovlen = 1;
+	batch->msgs[i].msg_hdr.msg_name = &batch->addrs[i];
+	batch->msgs[i].msg_hdr.msg_namelen = addrlen;
+	batch->count++;
+	if(batch->count == JANUS_RTPFWD_BATCH_MAX)
+		janus_rtp_forwarder_batch_send(batch);
+	return TRUE;
+}
+#endif
+void janus_rtp_forwarder_batch_begin(void) {
+#ifdef __linux__
+	janus_rtp_forwarder_batch *batch = g_private_get(&rtpfwd_batch_key);
+	if(batch == NULL) {
+		batch = g_malloc0(sizeof(janus_rtp_forwarder_batch));
+		batch->fd = -1;
+		g_private_set(&rtpfwd_batch_key, batch);
+	}
+	batch->active = TRUE;
+#endif
+}
+void janus_rtp_forwarder_batch_flush(void) {
+#ifdef __linux__
+	janus_rtp_forwarder_batch *batch = g_private_get(&rtpfwd_batch_key);
+	if(batch == NULL)
+		return;
+	janus_rtp_forwarder_batch_send(batch);
+	batch->active = FALSE;
+#endif
+}
 /* RTCP stuff */
 static GMainContext *rtcpfwd_ctx = NULL;
 static GMainLoop *rtcpfwd_loop = NULL;
@@ -46,6 +174,12 @@ int janus_rtp_forwarders_init(void) {
 	rtpfwds = g_hash_table_new_full(g_str_hash, g_str_equal,
 		(GDestroyNotify)g_free, (GDestroyNotify)janus_rtp_forwarder_unref);
 	janus_mutex_init(&rtpfwds_mutex);
+	/* Table of shared SRTP contexts (the entries are owned by the forwarders using them) */
+	rtpfwd_srtp = g_hash_table_new(g_str_hash, g_str_equal);
+	janus_mutex_init(&rtpfwd_srtp_mutex);
+	/* Table of local pipe sinks */
+	rtpfwd_pipes = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, NULL);
+	janus_mutex_init(&rtpfwd_pipes_mutex);
 	/* Let's check if IPv6 is disabled, as we may need to know for forwarders */
 	int fd = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
 	if(fd < 0) {
@@ -92,6 +226,53 @@ void janus_rtp_forwarders_deinit(void) {
 	g_hash_table_destroy(rtpfwds);
 	rtpfwds = NULL;
 	janus_mutex_unlock(&rtpfwds_mutex);
+	/* Get rid of the shared SRTP contexts table too: entries that are
+	 * still referenced will be freed by the last forwarder using them */
+	janus_mutex_lock(&rtpfwd_srtp_mutex);
+	g_hash_table_destroy(rtpfwd_srtp);
+	rtpfwd_srtp = NULL;
+	janus_mutex_unlock(&rtpfwd_srtp_mutex);
+	/* Close the local pipe sinks that weren't unregistered */
+	janus_mutex_lock(&rtpfwd_pipes_mutex);
+	GHashTableIter iter;
+	gpointer value;
+	g_hash_table_iter_init(&iter, rtpfwd_pipes);
+	while(g_hash_table_iter_next(&iter, NULL, &value))
+		close(GPOINTER_TO_INT(value));
+	g_hash_table_destroy(rtpfwd_pipes);
+	rtpfwd_pipes = NULL;
+	janus_mutex_unlock(&rtpfwd_pipes_mutex);
+}
+
+/* Local pipe management */
+int janus_rtp_pipe_register(const char *name, int fd) {
+	if(name == NULL || fd < 0)
+		return -1;
+	janus_mutex_lock(&rtpfwd_pipes_mutex);
+	if(rtpfwd_pipes == NULL || g_hash_table_contains(rtpfwd_pipes, name)) {
+		janus_mutex_unlock(&rtpfwd_pipes_mutex);
+		JANUS_LOG(LOG_ERR, "Local pipe '%s' already exists\n", name);
+		return -2;
+	}
+	/* Make sure writes will never block the threads forwarders send from */
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	g_hash_table_insert(rtpfwd_pipes, g_strdup(name), GINT_TO_POINTER(fd));
+	janus_mutex_unlock(&rtpfwd_pipes_mutex);
+	JANUS_LOG(LOG_INFO, "Registered local pipe '%s'\n", name);
+	return 0;
+}
+
+void janus_rtp_pipe_unregister(const char *name) {
+	if(name == NULL)
+		return;
+	janus_mutex_lock(&rtpfwd_pipes_mutex);
+	gpointer value = NULL;
+	if(rtpfwd_pipes != NULL && g_hash_table_lookup_extended(rtpfwd_pipes, name, NULL, &value)) {
+		g_hash_table_remove(rtpfwd_pipes, name);
+		close(GPOINTER_TO_INT(value));
+		JANUS_LOG(LOG_INFO, "Unregistered local pipe '%s'\n", name);
+	}
+	janus_mutex_unlock(&rtpfwd_pipes_mutex);
 }
 
 /* RTCP support in RTP forwarders */
@@ -147,6 +328,12 @@ janus_rtp_forwarder *janus_rtp_forwarder_create(const char *ctx,
 		uint32_t stream_id, int udp_fd, const char *host, int port,
 		uint32_t ssrc, int pt, int srtp_suite, const char *srtp_crypto,
 		gboolean simulcast, int substream, gboolean is_video, gboolean is_data) {
+	if(host != NULL && strstr(host, "pipe:") == host && srtp_suite > 0) {
+		/* In-process pipes never leave the process, and the consuming
+		 * plugin expects plain RTP: encrypting would just waste cycles */
+		JANUS_LOG(LOG_ERR, "SRTP is not supported on local pipe forwarders\n");
+		return NULL;
+	}
 	janus_mutex_lock(&rtpfwds_mutex);
 	if(ctx == NULL)
 		ctx = "default";
@@ -177,47 +364,121 @@ janus_rtp_forwarder *janus_rtp_forwarder_create(const char *ctx,
 	rf->remote_rtcp_port = 0;
 	/* First of all, let's check if we need to setup an SRTP forwarder */
 	if(!is_data && srtp_suite > 0 && srtp_crypto != NULL) {
-		/* Base64 decode the crypto string and set it as the SRTP context */
-		gsize len = 0;
-		guchar *decoded = g_base64_decode(srtp_crypto, &len);
-		if(len < SRTP_MASTER_LENGTH) {
-			janus_mutex_unlock(&rtpfwds_mutex);
-			JANUS_LOG(LOG_ERR, "Invalid SRTP crypto (%s)\n", srtp_crypto);
-			g_free(decoded);
-			g_free(rf);
-			return NULL;
-		}
-		/* Set SRTP policy */
-		srtp_policy_t *policy = &rf->srtp_policy;
-		srtp_crypto_policy_set_rtp_default(&(policy->rtp));
-		if(srtp_suite == 32) {
-			srtp_crypto_policy_set_aes_cm_128_hmac_sha1_32(&(policy->rtp));
-		} else if(srtp_suite == 80) {
-			srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(&(policy->rtp));
+		/* If this forwarder is guaranteed to emit a unique SSRC (either an
+		 * explicit rewrite, or the stream ID used for simulcast receivers),
+		 * we can try enrolling it in a context shared with the other
+		 * forwarders using the same suite and crypto material */
+		uint32_t out_ssrc = ssrc > 0 ? ssrc : (simulcast && is_video ? stream_id : 0);
+		janus_rtp_forwarder_srtp *shared = NULL;
+		if(out_ssrc > 0) {
+			char skey[1024];
+			g_snprintf(skey, sizeof(skey), "%d:%s", srtp_suite, srtp_crypto);
+			janus_mutex_lock(&rtpfwd_srtp_mutex);
+			shared = g_hash_table_lookup(rtpfwd_srtp, skey);
+			if(shared != NULL && g_hash_table_lookup(shared->ssrcs, GUINT_TO_POINTER(out_ssrc)) != NULL) {
+				/* Another forwarder is already sending this SSRC with this
+				 * key: sharing would trip the outbound replay protection,
+				 * so fall back to a private context */
+				shared = NULL;
+				janus_mutex_unlock(&rtpfwd_srtp_mutex);
+			} else if(shared != NULL) {
+				/* Enroll in the existing shared context */
+				g_hash_table_insert(shared->ssrcs, GUINT_TO_POINTER(out_ssrc), GUINT_TO_POINTER(out_ssrc));
+				shared->refs++;
+				janus_mutex_unlock(&rtpfwd_srtp_mutex);
+				rf->srtp_shared = shared;
+				rf->srtp_ctx = shared->ctx;
+				rf->is_srtp = TRUE;
+			} else {
+				/* No shared context for this key yet, create one */
+				gsize len = 0;
+				guchar *decoded = g_base64_decode(srtp_crypto, &len);
+				if(len < SRTP_MASTER_LENGTH) {
+					janus_mutex_unlock(&rtpfwd_srtp_mutex);
+					janus_mutex_unlock(&rtpfwds_mutex);
+					JANUS_LOG(LOG_ERR, "Invalid SRTP crypto (%s)\n", srtp_crypto);
+					g_free(decoded);
+					g_free(rf);
+					return NULL;
+				}
+				shared = g_malloc0(sizeof(janus_rtp_forwarder_srtp));
+				srtp_policy_t *policy = &shared->policy;
+				srtp_crypto_policy_set_rtp_default(&(policy->rtp));
+				if(srtp_suite == 32) {
+					srtp_crypto_policy_set_aes_cm_128_hmac_sha1_32(&(policy->rtp));
+				} else if(srtp_suite == 80) {
+					srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(&(policy->rtp));
+				}
+				policy->ssrc.type = ssrc_any_outbound;
+				policy->key = decoded;
+				policy->next = NULL;
+				srtp_err_status_t res = srtp_create(&shared->ctx, policy);
+				if(res != srtp_err_status_ok) {
+					janus_mutex_unlock(&rtpfwd_srtp_mutex);
+					janus_mutex_unlock(&rtpfwds_mutex);
+					JANUS_LOG(LOG_ERR, "Error creating forwarder SRTP session: %d (%s)\n", res, janus_srtp_error_str(res));
+					g_free(decoded);
+					g_free(shared);
+					g_free(rf);
+					return NULL;
+				}
+				shared->id = g_strdup(skey);
+				shared->ssrcs = g_hash_table_new(NULL, NULL);
+				g_hash_table_insert(shared->ssrcs, GUINT_TO_POINTER(out_ssrc), GUINT_TO_POINTER(out_ssrc));
+				shared->refs = 1;
+				janus_mutex_init(&shared->mutex);
+				g_hash_table_insert(rtpfwd_srtp, shared->id, shared);
+				janus_mutex_unlock(&rtpfwd_srtp_mutex);
+				rf->srtp_shared = shared;
+				rf->srtp_ctx = shared->ctx;
+				rf->is_srtp = TRUE;
+			}
 		}
-		policy->ssrc.type = ssrc_any_outbound;
-		policy->key = decoded;
-		policy->next = NULL;
-		/* Create SRTP context */
-		srtp_err_status_t res = srtp_create(&rf->srtp_ctx, policy);
-		if(res != srtp_err_status_ok) {
-			/* Something went wrong... */
-			janus_mutex_unlock(&rtpfwds_mutex);
-			JANUS_LOG(LOG_ERR, "Error creating forwarder SRTP session: %d (%s)\n", res, janus_srtp_error_str(res));
-			g_free(decoded);
-			policy->key = NULL;
-			g_free(rf);
-			return NULL;
+		if(!rf->is_srtp) {
+			/* Private context: base64 decode the crypto string and set it as the SRTP context */
+			gsize len = 0;
+			guchar *decoded = g_base64_decode(srtp_crypto, &len);
+			if(len < SRTP_MASTER_LENGTH) {
+				janus_mutex_unlock(&rtpfwds_mutex);
+				JANUS_LOG(LOG_ERR, "Invalid SRTP crypto (%s)\n", srtp_crypto);
+				g_free(decoded);
+				g_free(rf);
+				return NULL;
+			}
+			/* Set SRTP policy */
+			srtp_policy_t *policy = &rf->srtp_policy;
+			srtp_crypto_policy_set_rtp_default(&(policy->rtp));
+			if(srtp_suite == 32) {
+				srtp_crypto_policy_set_aes_cm_128_hmac_sha1_32(&(policy->rtp));
+			} else if(srtp_suite == 80) {
+				srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(&(policy->rtp));
+			}
+			policy->ssrc.type = ssrc_any_outbound;
+			policy->key = decoded;
+			policy->next = NULL;
+			/* Create SRTP context */
+			srtp_err_status_t res = srtp_create(&rf->srtp_ctx, policy);
+			if(res != srtp_err_status_ok) {
+				/* Something went wrong... */
+				janus_mutex_unlock(&rtpfwds_mutex);
+				JANUS_LOG(LOG_ERR, "Error creating forwarder SRTP session: %d (%s)\n", res, janus_srtp_error_str(res));
+				g_free(decoded);
+				policy->key = NULL;
+				g_free(rf);
+				return NULL;
+			}
+			rf->is_srtp = TRUE;
 		}
-		rf->is_srtp = TRUE;
 	}
 	rf->is_video = is_video;
 	rf->payload_type = pt;
 	rf->ssrc = ssrc;
 	rf->substream = substream;
 	rf->is_data = is_data;
-	/* Check if the host address is IPv4 or IPv6 */
-	if(strstr(host, ":") != NULL) {
+	/* Check if this is an in-process forwarder, or if the host address is IPv4 or IPv6 */
+	if(strstr(host, "pipe:") == host) {
+		rf->pipe_name = g_strdup(host + strlen("pipe:"));
+	} else if(strstr(host, ":") != NULL) {
 		rf->serv_addr6.sin6_family = AF_INET6;
 		inet_pton(AF_INET6, host, &(rf->serv_addr6.sin6_addr));
 		rf->serv_addr6.sin6_port = htons(port);
@@ -246,7 +507,7 @@ janus_rtp_forwarder *janus_rtp_forwarder_create(const char *ctx,
 /* Add RTCP support to an existing RTP forwarder */
 int janus_rtp_forwarder_add_rtcp(janus_rtp_forwarder *rf, int rtcp_port,
 		void (*rtcp_callback)(janus_rtp_forwarder *rf, char *buffer, int len)) {
-	if(rf == NULL || g_atomic_int_get(&rf->destroyed) || rf->rtcp_fd > 0 || rtcp_port < 1 || rf->is_data)
+	if(rf == NULL || g_atomic_int_get(&rf->destroyed) || rf->rtcp_fd > 0 || rtcp_port < 1 || rf->is_data || rf->pipe_name != NULL)
 		return -1;
 	/* Bind to a port for RTCP */
 	uint16_t local_rtcp_port = 0;
@@ -367,12 +628,30 @@ void janus_rtp_forwarder_send_rtp_full(janus_rtp_forwarder *rf, char *buffer, in
 		rtp->type = rf->payload_type;
 	if(rf->ssrc > 0)
 		rtp->ssrc = htonl(rf->ssrc);
-	/* Check if this is an RTP or SRTP forwarder */
-	if(!rf->is_srtp) {
+	/* Check if this is an in-process, RTP or SRTP forwarder */
+	if(rf->pipe_name != NULL) {
+		/* In-process forwarder: hand the packet to the sink registered
+		 * under this pipe name, if any (holding the mutex while writing
+		 * guarantees the sink can't be unregistered and closed under us) */
+		janus_mutex_lock(&rtpfwd_pipes_mutex);
+		gpointer sink = NULL;
+		if(rtpfwd_pipes != NULL && g_hash_table_lookup_extended(rtpfwd_pipes, rf->pipe_name, NULL, &sink)) {
+			if(write(GPOINTER_TO_INT(sink), buffer, len) < 0) {
+				JANUS_LOG(LOG_HUGE, "Error delivering RTP %s packet to pipe '%s'... %s (len=%d)...\n",
+					(rf->is_video ? "video" : "audio"), rf->pipe_name, g_strerror(errno), len);
+			}
+		}
+		janus_mutex_unlock(&rtpfwd_pipes_mutex);
+	} else if(!rf->is_srtp) {
 		/* Plain RTP */
 		struct sockaddr *address = (rf->serv_addr.sin_family == AF_INET ?
 			(struct sockaddr *)&rf->serv_addr : (struct sockaddr *)&rf->serv_addr6);
 		size_t addrlen = (rf->serv_addr.sin_family == AF_INET ? sizeof(rf->serv_addr) : sizeof(rf->serv_addr6));
+#ifdef __linux__
+		if(janus_rtp_forwarder_batch_queue(rf, buffer, len, address, addrlen)) {
+			/* Queued, it will be sent when the batch is flushed */
+		} else
+#endif
 		if(sendto(rf->udp_fd, buffer, len, 0, address, addrlen) < 0) {
 			JANUS_LOG(LOG_HUGE, "Error forwarding RTP %s packet... %s (len=%d)...\n",
 				(rf->is_video ? "video" : "audio"), g_strerror(errno), len);
@@ -382,7 +661,11 @@ void janus_rtp_forwarder_send_rtp_full(janus_rtp_forwarder *rf, char *buffer, in
 		char sbuf[1500];
 		memcpy(sbuf, buffer, len);
 		int protected = len;
+		if(rf->srtp_shared != NULL)
+			janus_mutex_lock(&rf->srtp_shared->mutex);
 		int res = srtp_protect(rf->srtp_ctx, sbuf, &protected);
+		if(rf->srtp_shared != NULL)
+			janus_mutex_unlock(&rf->srtp_shared->mutex);
 		if(res != srtp_err_status_ok) {
 			janus_rtp_header *header = (janus_rtp_header *)sbuf;
 			guint32 timestamp = ntohl(header->timestamp);
@@ -393,6 +676,11 @@ void janus_rtp_forwarder_send_rtp_full(janus_rtp_forwarder *rf, char *buffer, in
 			struct sockaddr *address = (rf->serv_addr.sin_family == AF_INET ?
 				(struct sockaddr *)&rf->serv_addr : (struct sockaddr *)&rf->serv_addr6);
 			size_t addrlen = (rf->serv_addr.sin_family == AF_INET ? sizeof(rf->serv_addr) : sizeof(rf->serv_addr6));
+#ifdef __linux__
+			if(janus_rtp_forwarder_batch_queue(rf, sbuf, protected, address, addrlen)) {
+				/* Queued, it will be sent when the batch is flushed */
+			} else
+#endif
 			if(sendto(rf->udp_fd, sbuf, protected, 0, address, addrlen) < 0) {
 				JANUS_LOG(LOG_HUGE, "Error forwarding SRTP %s packet... %s (len=%d)...\n",
 					(rf->is_video ? "video" : "audio"), g_strerror(errno), protected);
@@ -434,10 +722,24 @@ static void janus_rtp_forwarder_free(const janus_refcount *f_ref) {
 	janus_rtp_forwarder *rf = janus_refcount_containerof(f_ref, janus_rtp_forwarder, ref);
 	if(rf->rtcp_fd > -1)
 		close(rf->rtcp_fd);
-	if(rf->is_srtp) {
+	if(rf->is_srtp && rf->srtp_shared != NULL) {
+		/* We were using a shared SRTP context, disenroll from it */
+		janus_rtp_forwarder_srtp *shared = rf->srtp_shared;
+		janus_mutex_lock(&rtpfwd_srtp_mutex);
+		uint32_t out_ssrc = rf->ssrc > 0 ? rf->ssrc : rf->stream_id;
+		g_hash_table_remove(shared->ssrcs, GUINT_TO_POINTER(out_ssrc));
+		shared->refs--;
+		if(shared->refs == 0) {
+			if(rtpfwd_srtp != NULL)
+				g_hash_table_remove(rtpfwd_srtp, shared->id);
+			janus_rtp_forwarder_srtp_destroy(shared);
+		}
+		janus_mutex_unlock(&rtpfwd_srtp_mutex);
+	} else if(rf->is_srtp) {
 		srtp_dealloc(rf->srtp_ctx);
 		g_free(rf->srtp_policy.key);
 	}
+	g_free(rf->pipe_name);
 	g_free(rf->context);
 	g_free(rf->metadata);
 	g_free(rf);
@@ -26,6 +26,9 @@ int janus_rtp_forwarders_init(void);
 /*! \brief RTP forwarders code de-initialization */
 void janus_rtp_forwarders_deinit(void);
 
+/*! \brief Opaque shared SRTP context, for forwarders using the same crypto material */
+typedef struct janus_rtp_forwarder_srtp janus_rtp_forwarder_srtp;
+
 /*! \brief Helper struct for implementing RTP forwarders */
 typedef struct janus_rtp_forwarder {
 	/* \brief Opaque pointer to the owner of this forwarder */
@@ -36,6 +39,10 @@ typedef struct janus_rtp_forwarder {
 	uint32_t stream_id;
 	/* \brief Socket used for sending RTP packets */
 	int udp_fd;
+	/* \brief Name of the local pipe to deliver to, in case this is an
+	 * in-process forwarder (in which case the socket and the recipient
+	 * addresses below are not used at all) */
+	char *pipe_name;
 	/* \brief Whether this is a video forwarder */
 	gboolean is_video;
 	/* \brief Whether this is an audio forwarder */
@@ -70,6 +77,9 @@ typedef struct janus_rtp_forwarder {
 	srtp_t srtp_ctx;
 	/* \brief The SRTP policy, in case SRTP is enabled */
 	srtp_policy_t srtp_policy;
+	/* \brief The shared SRTP context this forwarder is enrolled in, if any
+	 * (in which case srtp_ctx points to the shared context, not a private one) */
+	janus_rtp_forwarder_srtp *srtp_shared;
 	/* \brief Opaque metadata property, in case it's useful to the owner
 	 * \note This can be anything (e.g., a string, an allocated struct, etc.),
 	 * as long as it can be freed with a single call to g_free(), as
@@ -132,6 +142,35 @@ void janus_rtp_forwarder_send_rtp(janus_rtp_forwarder *rf, char *buffer, int len
  * @param[in] rid_mutex A mutex that must be acquired before reading the rids array, if any */
 void janus_rtp_forwarder_send_rtp_full(janus_rtp_forwarder *rf, char *buffer, int len, int substream,
 	uint32_t *ssrcs, char **rids, janus_videocodec vcodec, janus_mutex *rid_mutex);
+/*! \brief Register a local pipe sink that forwarders can deliver to in-process
+ * \details RTP forwarders created with \c pipe:<name> as the host deliver their
+ * packets to the sink registered under that name, if any, instead of sending
+ * them via UDP: this allows media to move from one plugin to another (e.g., a
+ * VideoRoom publisher feeding a Streaming mountpoint) without a loopback RTP
+ * hop and the related SRTP overhead. The provided descriptor is typically the
+ * writeable end of a datagram socketpair, whose other end the registering
+ * plugin reads packets from as it would from a media socket: the core takes
+ * ownership of the descriptor, puts it in non-blocking mode (packets are
+ * dropped if the sink can't keep up, as UDP would drop them), and closes it
+ * when the pipe is unregistered
+ * @param[in] name The unique name of the pipe
+ * @param[in] fd The descriptor to write forwarded packets to
+ * @returns 0 if successful, a negative integer otherwise */
+int janus_rtp_pipe_register(const char *name, int fd);
+/*! \brief Unregister a local pipe sink previously registered with janus_rtp_pipe_register
+ * \note Once this returns, no forwarder will touch the descriptor anymore,
+ * and the descriptor itself has been closed by the core
+ * @param[in] name The unique name of the pipe to unregister */
+void janus_rtp_pipe_unregister(const char *name);
+/*! \brief Start batching the packets sent by this thread via the forwarders API
+ * \note When a plugin needs to relay the same packet to many forwarders, it can
+ * bracket the loop with this method and janus_rtp_forwarder_batch_flush: sends
+ * going to the same socket are then aggregated and flushed with a single
+ * sendmmsg() call, instead of costing one sendto() each. On platforms where
+ * sendmmsg() is not available this is a no-op, and packets are sent right away */
+void janus_rtp_forwarder_batch_begin(void);
+/*! \brief Send all the packets this thread batched so far, and stop batching */
+void janus_rtp_forwarder_batch_flush(void);
 /*! \brief Helper method to free a janus_rtp_forwarder instance
  * @param[in] rf The janus_rtp_forwarder instance to free */
 void janus_rtp_forwarder_destroy(janus_rtp_forwarder *rf);
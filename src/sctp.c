@@ -89,6 +89,15 @@ static void janus_sctp_pending_message_free(janus_sctp_pending_message *m) {
 	}
 }
 
+/* Helper to remove a channel from the label map, when closing it: we only
+ * do that if the label currently maps to that specific channel, as labels
+ * aren't guaranteed to be unique and another channel may be using it too */
+static void janus_sctp_channel_unmap(janus_sctp_association *sctp, janus_sctp_channel *channel) {
+	if(sctp->channels_bylabel != NULL && channel->label[0] != '\0' &&
+			g_hash_table_lookup(sctp->channels_bylabel, channel->label) == channel)
+		g_hash_table_remove(sctp->channels_bylabel, channel->label);
+}
+
 /* usrsctp callbacks and methods */
 int janus_sctp_data_to_dtls(void *instance, void *buffer, size_t length, uint8_t tos, uint8_t set_df);
 static int janus_sctp_incoming_data(struct socket *sock, union sctp_sockstore addr, void *data, size_t datalen, struct sctp_rcvinfo rcv, int flags, void *ulp_info);
@@ -168,6 +177,8 @@ static void janus_sctp_association_free(const janus_refcount *sctp_ref) {
 	janus_refcount_decrease(&sctp->dtls->ref);
 	if(sctp->pending_messages != NULL)
 		g_queue_free_full(sctp->pending_messages, (GDestroyNotify)janus_sctp_pending_message_free);
+	if(sctp->channels_bylabel != NULL)
+		g_hash_table_destroy(sctp->channels_bylabel);
 #ifdef DEBUG_SCTP
 	if(sctp->debug_dump != NULL)
 		fclose(sctp->debug_dump);
@@ -221,12 +232,20 @@ janus_sctp_association *janus_sctp_association_create(janus_dtls_srtp *dtls, jan
 		channel->stream = 0;
 		channel->unordered = 0;
 		channel->flags = 0;
+		channel->messages_out = 0;
+		channel->messages_in = 0;
+		channel->bytes_out = 0;
+		channel->bytes_in = 0;
 	}
 	for(i = 0; i < NUMBER_OF_STREAMS; i++) {
 		sctp->stream_channel[i] = NULL;
 		sctp->stream_buffer[i] = 0;
 	}
 	sctp->stream_buffer_counter = 0;
+	sctp->last_channel = -1;
+	/* Channels live in a fixed size array, so mapping labels to channel
+	 * pointers is safe: they're only ever freed with the association */
+	sctp->channels_bylabel = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, NULL);
 
 	/* Create a unique ID to map locally: this is what we'll pass to
 	 * usrsctp_socket, which means that's what we'll get in callbacks
@@ -445,11 +464,32 @@ void janus_sctp_send_data(janus_sctp_association *sctp, char *label, char *proto
 		  sctp->handle_id, len, buf);
 	/* FIXME Is there any open channel we can use? */
 	int i = 0, found = 0;
-	for(i = 0; i < NUMBER_OF_CHANNELS; i++) {
-		if(sctp->channels[i].state != DATA_CHANNEL_CLOSED && !strcmp(sctp->channels[i].label, label)) {
+	/* High rate senders typically use the same channel over and over, so
+	 * before scanning them all check the channel we last sent data on */
+	if(sctp->last_channel >= 0 && sctp->last_channel < NUMBER_OF_CHANNELS) {
+		i = sctp->last_channel;
+		if(sctp->channels[i].state != DATA_CHANNEL_CLOSED && !strcmp(sctp->channels[i].label, label))
+			found = 1;
+	}
+	if(!found) {
+		/* Check the label map, so that we don't have to iterate on all channels */
+		janus_sctp_channel *channel = g_hash_table_lookup(sctp->channels_bylabel, label);
+		if(channel != NULL && channel->state != DATA_CHANNEL_CLOSED) {
+			i = channel->id;
 			found = 1;
 			JANUS_LOG(LOG_VERB, "[%"SCNu64"]   -- Using open channel %i\n", sctp->handle_id, i);
-			break;
+		}
+	}
+	if(!found) {
+		/* Not in the map either, iterate on all channels just in case */
+		for(i = 0; i < NUMBER_OF_CHANNELS; i++) {
+			if(sctp->channels[i].state != DATA_CHANNEL_CLOSED && !strcmp(sctp->channels[i].label, label)) {
+				found = 1;
+				JANUS_LOG(LOG_VERB, "[%"SCNu64"]   -- Using open channel %i\n", sctp->handle_id, i);
+				/* The map was stale for this label, fix it */
+				g_hash_table_insert(sctp->channels_bylabel, g_strdup(label), &sctp->channels[i]);
+				break;
+			}
 		}
 	}
 	if(!found) {
@@ -471,18 +511,28 @@ void janus_sctp_send_data(janus_sctp_association *sctp, char *label, char *proto
 			return;
 		}
 	}
+	sctp->last_channel = i;
 	/* Send the data, whether it's text or binary */
 	if(sctp->pending_messages != NULL && !g_queue_is_empty(sctp->pending_messages)) {
-		/* We couldn't send all pending messages, queue the new one as well */
-		if(buf != NULL && len > 0) {
+		/* There's a backlog of pending messages: rather than waiting for the
+		 * next SCTP_SENDER_DRY_EVENT, try to flush it in a burst right away,
+		 * as some room may have opened up in the meanwhile */
+		janus_sctp_pending_message *m = g_queue_peek_head(sctp->pending_messages);
+		while(m != NULL) {
+			if(janus_sctp_send_text_or_binary(sctp, m->id, m->textdata, m->buf, m->len) == -2)
+				break;
+			(void)g_queue_pop_head(sctp->pending_messages);
+			janus_sctp_pending_message_free(m);
+			m = g_queue_peek_head(sctp->pending_messages);
+		}
+		if(!g_queue_is_empty(sctp->pending_messages)) {
+			/* Still backlogged, queue the new message behind the others */
 			JANUS_LOG(LOG_WARN, "[%"SCNu64"] Couldn't send all pending messages, queueing new message\n",
 				sctp->handle_id);
 			janus_sctp_pending_message *m = janus_sctp_pending_message_create(i, textdata, buf, len);
-			if(sctp->pending_messages == NULL)
-				sctp->pending_messages = g_queue_new();
 			g_queue_push_tail(sctp->pending_messages, m);
+			return;
 		}
-		return;
 	}
 	int res = janus_sctp_send_text_or_binary(sctp, i, textdata, buf, len);
 	if(res == -2) {
@@ -497,6 +547,32 @@ void janus_sctp_send_data(janus_sctp_association *sctp, char *label, char *proto
 }
 
 
+json_t *janus_sctp_summary(janus_sctp_association *sctp) {
+	if(sctp == NULL || g_atomic_int_get(&sctp->destroyed))
+		return NULL;
+	json_t *list = json_array();
+	int i = 0;
+	for(i = 0; i < NUMBER_OF_CHANNELS; i++) {
+		janus_sctp_channel *channel = &sctp->channels[i];
+		if(channel->state == DATA_CHANNEL_CLOSED)
+			continue;
+		json_t *c = json_object();
+		json_object_set_new(c, "label", json_string(channel->label));
+		if(strlen(channel->protocol) > 0)
+			json_object_set_new(c, "protocol", json_string(channel->protocol));
+		json_object_set_new(c, "stream", json_integer(channel->stream));
+		json_object_set_new(c, "state", json_string(channel->state == DATA_CHANNEL_OPEN ? "open" :
+			(channel->state == DATA_CHANNEL_CONNECTING ? "connecting" : "closing")));
+		json_object_set_new(c, "messages-sent", json_integer(channel->messages_out));
+		json_object_set_new(c, "bytes-sent", json_integer(channel->bytes_out));
+		json_object_set_new(c, "messages-received", json_integer(channel->messages_in));
+		json_object_set_new(c, "bytes-received", json_integer(channel->bytes_in));
+		json_array_append_new(list, c);
+	}
+	return list;
+}
+
+
 /* From now on, it's SCTP stuff */
 janus_sctp_channel *janus_sctp_find_channel_by_stream(janus_sctp_association *sctp, uint16_t stream) {
 	if(sctp == NULL)
@@ -758,10 +834,16 @@ int janus_sctp_open_channel(janus_sctp_association *sctp, char *label, char *pro
 	channel->pr_value = pr_value;
 	channel->stream = stream;
 	channel->flags = 0;
+	channel->messages_out = 0;
+	channel->messages_in = 0;
+	channel->bytes_out = 0;
+	channel->bytes_in = 0;
 	g_snprintf(channel->label, sizeof(channel->label), "%s", (label ? label : default_label));
 	channel->protocol[0] = '\0';
 	if(protocol != NULL)
 		g_snprintf(channel->protocol, sizeof(channel->protocol), "%s", protocol);
+	/* Map the label to the channel, for a quicker lookup when sending */
+	g_hash_table_insert(sctp->channels_bylabel, g_strdup(channel->label), channel);
 	if(stream == 0) {
 		janus_sctp_request_more_streams(sctp);
 	} else {
@@ -772,6 +854,7 @@ int janus_sctp_open_channel(janus_sctp_association *sctp, char *label, char *pro
 				sctp->stream_channel[stream] = channel;
 				channel->flags |= DATA_CHANNEL_FLAGS_SEND_REQ;
 			} else {
+				janus_sctp_channel_unmap(sctp, channel);
 				channel->label[0] = '\0';
 				channel->protocol[0] = '\0';
 				channel->state = DATA_CHANNEL_CLOSED;
@@ -829,6 +912,8 @@ int janus_sctp_send_text_or_binary(janus_sctp_association *sctp, uint16_t id, gb
 		return -1;
 	}
 	JANUS_LOG(LOG_VERB, "[%"SCNu64"] Message sent on channel %"SCNu16"\n", sctp->handle_id, id);
+	channel->messages_out++;
+	channel->bytes_out += length;
 	return 0;
 }
 
@@ -971,6 +1056,10 @@ void janus_sctp_handle_open_request_message(janus_sctp_association *sctp, janus_
 	channel->pr_value = pr_value;
 	channel->stream = stream;
 	channel->flags = 0;
+	channel->messages_out = 0;
+	channel->messages_in = 0;
+	channel->bytes_out = 0;
+	channel->bytes_in = 0;
 	sctp->stream_channel[stream] = channel;
 	if(janus_sctp_send_open_ack_message(sctp->sock, stream)) {
 		sctp->stream_channel[stream] = channel;
@@ -1008,6 +1097,10 @@ void janus_sctp_handle_open_request_message(janus_sctp_association *sctp, janus_
 		protocol[plen] = '\0';
 		g_snprintf(channel->protocol, sizeof(channel->protocol), "%s", protocol);
 	}
+	if(channel->state != DATA_CHANNEL_CLOSED) {
+		/* Map the label to the channel, for a quicker lookup when sending */
+		g_hash_table_insert(sctp->channels_bylabel, g_strdup(channel->label), channel);
+	}
 	JANUS_LOG(LOG_VERB, "[%"SCNu64"] Opened channel '%s' (protocol=%s, id=%"SCNu16") (%d/%d/%d)\n",
 		sctp->handle_id, label ? label : "??", protocol ? protocol : "??",
 		channel->stream, channel->unordered, channel->pr_policy, channel->pr_value);
@@ -1094,6 +1187,8 @@ void janus_sctp_handle_data_message(janus_sctp_association *sctp, gboolean textd
 			sctp->handle_id, length, channel->id);
 		JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Incoming SCTP contents: %.*s\n",
 			sctp->handle_id, (int)length, buffer);
+		channel->messages_in++;
+		channel->bytes_in += length;
 		/* Pass this to the core */
 		janus_dtls_notify_sctp_data(sctp->dtls, channel->label,
 			strlen(channel->protocol) ? channel->protocol : NULL,
@@ -1343,6 +1438,7 @@ void janus_sctp_handle_stream_reset_event(janus_sctp_association *sctp, struct s
 						channel->unordered = 0;
 						channel->flags = 0;
 						channel->state = DATA_CHANNEL_CLOSED;
+						janus_sctp_channel_unmap(sctp, channel);
 						channel->label[0] = '\0';
 					} else {
 						if(channel->state == DATA_CHANNEL_OPEN) {
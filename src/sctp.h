@@ -42,6 +42,7 @@
 #include <errno.h>
 #include <usrsctp.h>
 #include <glib.h>
+#include <jansson.h>
 
 #include "mutex.h"
 #include "refcount.h"
@@ -96,6 +97,10 @@ typedef struct janus_sctp_channel {
 	uint8_t state;
 	/*! \brief Flags for this channel */
 	uint32_t flags;
+	/*! \brief Number of messages sent and received on this channel */
+	uint64_t messages_out, messages_in;
+	/*! \brief Number of bytes sent and received on this channel */
+	uint64_t bytes_out, bytes_in;
 } janus_sctp_channel;
 
 typedef struct janus_sctp_association {
@@ -115,6 +120,11 @@ typedef struct janus_sctp_association {
 	uint16_t stream_buffer[NUMBER_OF_STREAMS];
 	/*! \brief Number of stream buffers */
 	uint32_t stream_buffer_counter;
+	/*! \brief Index of the channel we last sent data on (fast path for high rate senders), -1 if none */
+	int last_channel;
+	/*! \brief Map of channels indexed by label, so that outgoing messages
+	 * don't need to iterate on all channels to find the one to use */
+	GHashTable *channels_bylabel;
 	/*! \brief UDP-encapsulation socket related to this association */
 	struct socket *sock;
 	/*! \brief Local port to be used for SCTP */
@@ -207,6 +217,9 @@ void janus_sctp_association_destroy(janus_sctp_association *sctp);
 void janus_sctp_data_from_dtls(janus_sctp_association *sctp, char *buf, int len);
 
 /*! \brief Method to send data via SCTP to the peer
+ * \note Messages the stack can't accept right away (EAGAIN) are queued, and
+ * the backlog is flushed in bursts, both when the sender dry event tells us
+ * there's room again and opportunistically on the next send attempt
  * \param[in] sctp The SCTP association this data is from
  * @param[in] label The label of the data channel to use
  * @param[in] protocol The protocol of the data channel to use
@@ -215,6 +228,11 @@ void janus_sctp_data_from_dtls(janus_sctp_association *sctp, char *buf, int len)
  * \param[in] len The buffer length */
 void janus_sctp_send_data(janus_sctp_association *sctp, char *label, char *protocol, gboolean textdata, char *buf, int len);
 
+/*! \brief Helper method to summarize the state and stats of the data channels (used by the Admin API)
+ * \param[in] sctp The SCTP association to summarize
+ * \returns A json_t array of channel objects, if successful, NULL otherwise */
+json_t *janus_sctp_summary(janus_sctp_association *sctp);
+
 #endif
 
 #endif
@@ -72,6 +72,7 @@ static void janus_sdp_free(const janus_refcount *sdp_ref) {
 	}
 	g_list_free(sdp->m_lines);
 	sdp->m_lines = NULL;
+	g_free(sdp->arena);
 	g_free(sdp);
 }
 
@@ -98,9 +99,13 @@ static void janus_sdp_mline_free(const janus_refcount *mline_ref) {
 
 static void janus_sdp_attribute_free(const janus_refcount *attr_ref) {
 	janus_sdp_attribute *attr = janus_refcount_containerof(attr_ref, janus_sdp_attribute, ref);
-	/* This SDP attribute instance can be destroyed, free all the resources */
-	g_free(attr->name);
-	g_free(attr->value);
+	/* This SDP attribute instance can be destroyed, free all the resources,
+	 * unless name and value are slices of the arena of a parsed SDP, in
+	 * which case they're freed in one shot with the owning janus_sdp */
+	if(!attr->arena) {
+		g_free(attr->name);
+		g_free(attr->value);
+	}
 	g_free(attr);
 }
 
@@ -176,6 +181,7 @@ janus_sdp_attribute *janus_sdp_attribute_create(const char *name, const char *va
 	a->name = g_strdup(name);
 	a->direction = JANUS_SDP_DEFAULT;
 	a->value = NULL;
+	a->arena = FALSE;
 	if(value) {
 		char buffer[2048];
 		va_list ap;
@@ -313,347 +319,341 @@ janus_sdp *janus_sdp_parse(const char *sdp, char *error, size_t errlen) {
 	janus_sdp_mline *mline = NULL;
 	int mlines = 0;
 
-	gchar **parts = g_strsplit(sdp, "\n", -1);
-	if(parts) {
-		int index = 0;
-		char *line = NULL, *cr = NULL;
-		while(success && (line = parts[index]) != NULL) {
-			cr = strchr(line, '\r');
-			if(cr != NULL)
-				*cr = '\0';
-			if(*line == '\0') {
-				if(cr != NULL)
-					*cr = '\r';
-				index++;
-				continue;
-			}
-			if(strnlen(line, 3) < 3) {
-				if(error)
-					g_snprintf(error, errlen, "Invalid line (%zu bytes): %s", strlen(line), line);
-				success = FALSE;
-				break;
-			}
-			if(*(line+1) != '=') {
-				if(error)
-					g_snprintf(error, errlen, "Invalid line (2nd char is not '='): %s", line);
-				success = FALSE;
-				break;
-			}
-			char c = *line;
-			if(mline == NULL) {
-				/* Global stuff */
-				switch(c) {
-					case 'v': {
-						if(sscanf(line, "v=%d", &imported->version) != 1) {
-							if(error)
-								g_snprintf(error, errlen, "Invalid v= line: %s", line);
-							success = FALSE;
-							break;
-						}
+	/* Rather than duplicating every line and attribute name/value separately,
+	 * which results in hundreds of small allocations for a large SDP, we copy
+	 * the whole SDP to a single buffer owned by the new object: the lines we
+	 * iterate on and the attribute strings are all slices of that buffer,
+	 * which is freed in one shot when the object is destroyed */
+	imported->arena = g_strdup(sdp);
+	char *line = imported->arena, *next = NULL, *cr = NULL;
+	while(success && line != NULL) {
+		next = strchr(line, '\n');
+		if(next != NULL)
+			*(next++) = '\0';
+		cr = strchr(line, '\r');
+		if(cr != NULL)
+			*cr = '\0';
+		if(*line == '\0') {
+			line = next;
+			continue;
+		}
+		if(strnlen(line, 3) < 3) {
+			if(error)
+				g_snprintf(error, errlen, "Invalid line (%zu bytes): %s", strlen(line), line);
+			success = FALSE;
+			break;
+		}
+		if(*(line+1) != '=') {
+			if(error)
+				g_snprintf(error, errlen, "Invalid line (2nd char is not '='): %s", line);
+			success = FALSE;
+			break;
+		}
+		char c = *line;
+		if(mline != NULL && c == 'm') {
+			/* Current m-line ended, back to global parsing */
+			if(mline->attributes)
+				mline->attributes = g_list_reverse(mline->attributes);
+			mline = NULL;
+		}
+		if(mline == NULL) {
+			/* Global stuff */
+			switch(c) {
+				case 'v': {
+					if(sscanf(line, "v=%d", &imported->version) != 1) {
+						if(error)
+							g_snprintf(error, errlen, "Invalid v= line: %s", line);
+						success = FALSE;
 						break;
 					}
-					case 'o': {
-						if(imported->o_name || imported->o_addr) {
-							if(error)
-								g_snprintf(error, errlen, "Multiple o= lines: %s", line);
-							success = FALSE;
-							break;
-						}
-						char name[256], addrtype[6], addr[256];
-						if(sscanf(line, "o=%255s %"SCNu64" %"SCNu64" IN %5s %255s",
-								name, &imported->o_sessid, &imported->o_version, addrtype, addr) != 5) {
-							if(error)
-								g_snprintf(error, errlen, "Invalid o= line: %s", line);
-							success = FALSE;
-							break;
-						}
-						if(!strcasecmp(addrtype, "IP4"))
-							imported->o_ipv4 = TRUE;
-						else if(!strcasecmp(addrtype, "IP6"))
-							imported->o_ipv4 = FALSE;
-						else {
-							if(error)
-								g_snprintf(error, errlen, "Invalid o= line (unsupported protocol %s): %s", addrtype, line);
-							success = FALSE;
-							break;
-						}
-						imported->o_name = g_strdup(name);
-						imported->o_addr = g_strdup(addr);
+					break;
+				}
+				case 'o': {
+					if(imported->o_name || imported->o_addr) {
+						if(error)
+							g_snprintf(error, errlen, "Multiple o= lines: %s", line);
+						success = FALSE;
 						break;
 					}
-					case 's': {
-						if(imported->s_name) {
-							if(error)
-								g_snprintf(error, errlen, "Multiple s= lines: %s", line);
-							success = FALSE;
-							break;
-						}
-						imported->s_name = g_strdup(line+2);
+					char name[256], addrtype[6], addr[256];
+					if(sscanf(line, "o=%255s %"SCNu64" %"SCNu64" IN %5s %255s",
+							name, &imported->o_sessid, &imported->o_version, addrtype, addr) != 5) {
+						if(error)
+							g_snprintf(error, errlen, "Invalid o= line: %s", line);
+						success = FALSE;
 						break;
 					}
-					case 't': {
-						if(sscanf(line, "t=%"SCNu64" %"SCNu64, &imported->t_start, &imported->t_stop) != 2) {
-							if(error)
-								g_snprintf(error, errlen, "Invalid t= line: %s", line);
-							success = FALSE;
-							break;
-						}
+					if(!strcasecmp(addrtype, "IP4"))
+						imported->o_ipv4 = TRUE;
+					else if(!strcasecmp(addrtype, "IP6"))
+						imported->o_ipv4 = FALSE;
+					else {
+						if(error)
+							g_snprintf(error, errlen, "Invalid o= line (unsupported protocol %s): %s", addrtype, line);
+						success = FALSE;
 						break;
 					}
-					case 'c': {
-						if(imported->c_addr) {
-							if(error)
-								g_snprintf(error, errlen, "Multiple global c= lines: %s", line);
-							success = FALSE;
-							break;
-						}
-						char addrtype[6], addr[256];
-						if(sscanf(line, "c=IN %5s %255s", addrtype, addr) != 2) {
-							if(error)
-								g_snprintf(error, errlen, "Invalid c= line: %s", line);
-							success = FALSE;
-							break;
-						}
-						if(!strcasecmp(addrtype, "IP4"))
-							imported->c_ipv4 = TRUE;
-						else if(!strcasecmp(addrtype, "IP6"))
-							imported->c_ipv4 = FALSE;
-						else {
-							if(error)
-								g_snprintf(error, errlen, "Invalid c= line (unsupported protocol %s): %s", addrtype, line);
-							success = FALSE;
-							break;
-						}
-						imported->c_addr = g_strdup(addr);
+					imported->o_name = g_strdup(name);
+					imported->o_addr = g_strdup(addr);
+					break;
+				}
+				case 's': {
+					if(imported->s_name) {
+						if(error)
+							g_snprintf(error, errlen, "Multiple s= lines: %s", line);
+						success = FALSE;
 						break;
 					}
-					case 'a': {
-						janus_sdp_attribute *a = g_malloc0(sizeof(janus_sdp_attribute));
-						janus_refcount_init(&a->ref, janus_sdp_attribute_free);
-						line += 2;
-						char *semicolon = strchr(line, ':');
-						if(semicolon == NULL) {
-							a->name = g_strdup(line);
-							a->value = NULL;
-						} else {
-							if(*(semicolon+1) == '\0') {
-								janus_sdp_attribute_destroy(a);
-								if(error)
-									g_snprintf(error, errlen, "Invalid a= line: %s", line);
-								success = FALSE;
-								break;
-							}
-							*semicolon = '\0';
-							a->name = g_strdup(line);
-							a->value = g_strdup(semicolon+1);
-							a->direction = JANUS_SDP_DEFAULT;
-							*semicolon = ':';
-							if(strstr(line, "/sendonly"))
-								a->direction = JANUS_SDP_SENDONLY;
-							else if(strstr(line, "/recvonly"))
-								a->direction = JANUS_SDP_RECVONLY;
-							if(strstr(line, "/inactive"))
-								a->direction = JANUS_SDP_INACTIVE;
-						}
-						imported->attributes = g_list_prepend(imported->attributes, a);
+					imported->s_name = g_strdup(line+2);
+					break;
+				}
+				case 't': {
+					if(sscanf(line, "t=%"SCNu64" %"SCNu64, &imported->t_start, &imported->t_stop) != 2) {
+						if(error)
+							g_snprintf(error, errlen, "Invalid t= line: %s", line);
+						success = FALSE;
 						break;
 					}
-					case 'm': {
-						janus_sdp_mline *m = g_malloc0(sizeof(janus_sdp_mline));
-						g_atomic_int_set(&m->destroyed, 0);
-						janus_refcount_init(&m->ref, janus_sdp_mline_free);
-						/* Start with media type, port and protocol */
-						char type[32];
-						char proto[64];
-						if(strnlen(line, 200 + 1) > 200) {
-							janus_sdp_mline_destroy(m);
-							if(error)
-								g_snprintf(error, errlen, "Invalid m= line (too long): %zu", strlen(line));
-							success = FALSE;
-							break;
-						}
-						if(sscanf(line, "m=%31s %"SCNu16" %63s %*s", type, &m->port, proto) != 3) {
-							janus_sdp_mline_destroy(m);
+					break;
+				}
+				case 'c': {
+					if(imported->c_addr) {
+						if(error)
+							g_snprintf(error, errlen, "Multiple global c= lines: %s", line);
+						success = FALSE;
+						break;
+					}
+					char addrtype[6], addr[256];
+					if(sscanf(line, "c=IN %5s %255s", addrtype, addr) != 2) {
+						if(error)
+							g_snprintf(error, errlen, "Invalid c= line: %s", line);
+						success = FALSE;
+						break;
+					}
+					if(!strcasecmp(addrtype, "IP4"))
+						imported->c_ipv4 = TRUE;
+					else if(!strcasecmp(addrtype, "IP6"))
+						imported->c_ipv4 = FALSE;
+					else {
+						if(error)
+							g_snprintf(error, errlen, "Invalid c= line (unsupported protocol %s): %s", addrtype, line);
+						success = FALSE;
+						break;
+					}
+					imported->c_addr = g_strdup(addr);
+					break;
+				}
+				case 'a': {
+					janus_sdp_attribute *a = g_malloc0(sizeof(janus_sdp_attribute));
+					janus_refcount_init(&a->ref, janus_sdp_attribute_free);
+					a->arena = TRUE;
+					line += 2;
+					char *semicolon = strchr(line, ':');
+					if(semicolon == NULL) {
+						a->name = line;
+						a->value = NULL;
+					} else {
+						if(*(semicolon+1) == '\0') {
+							janus_sdp_attribute_destroy(a);
 							if(error)
-								g_snprintf(error, errlen, "Invalid m= line: %s", line);
+								g_snprintf(error, errlen, "Invalid a= line: %s", line);
 							success = FALSE;
 							break;
 						}
-						m->index = mlines;
-						mlines++;
-						m->type = janus_sdp_parse_mtype(type);
-						if(m->type == JANUS_SDP_OTHER) {
-							janus_sdp_mline_destroy(m);
-							if(error)
-								g_snprintf(error, errlen, "Invalid m= line: %s", line);
-							success = FALSE;
-							break;
+						*semicolon = '\0';
+						a->name = line;
+						a->value = semicolon+1;
+						a->direction = JANUS_SDP_DEFAULT;
+						if(strstr(a->value, "/sendonly"))
+							a->direction = JANUS_SDP_SENDONLY;
+						else if(strstr(a->value, "/recvonly"))
+							a->direction = JANUS_SDP_RECVONLY;
+						if(strstr(a->value, "/inactive"))
+							a->direction = JANUS_SDP_INACTIVE;
+					}
+					imported->attributes = g_list_prepend(imported->attributes, a);
+					break;
+				}
+				case 'm': {
+					janus_sdp_mline *m = g_malloc0(sizeof(janus_sdp_mline));
+					g_atomic_int_set(&m->destroyed, 0);
+					janus_refcount_init(&m->ref, janus_sdp_mline_free);
+					/* Start with media type, port and protocol */
+					char type[32];
+					char proto[64];
+					if(strnlen(line, 200 + 1) > 200) {
+						janus_sdp_mline_destroy(m);
+						if(error)
+							g_snprintf(error, errlen, "Invalid m= line (too long): %zu", strlen(line));
+						success = FALSE;
+						break;
+					}
+					if(sscanf(line, "m=%31s %"SCNu16" %63s %*s", type, &m->port, proto) != 3) {
+						janus_sdp_mline_destroy(m);
+						if(error)
+							g_snprintf(error, errlen, "Invalid m= line: %s", line);
+						success = FALSE;
+						break;
+					}
+					m->index = mlines;
+					mlines++;
+					m->type = janus_sdp_parse_mtype(type);
+					if(m->type == JANUS_SDP_OTHER) {
+						janus_sdp_mline_destroy(m);
+						if(error)
+							g_snprintf(error, errlen, "Invalid m= line: %s", line);
+						success = FALSE;
+						break;
+					}
+					m->type_str = g_strdup(type);
+					m->proto = g_strdup(proto);
+					m->direction = JANUS_SDP_SENDRECV;
+					m->c_ipv4 = TRUE;
+					/* Now let's check the payload types/formats */
+					gchar **mline_parts = g_strsplit(line+2, " ", -1);
+					if(!mline_parts && (m->port > 0 || m->type == JANUS_SDP_APPLICATION)) {
+						janus_sdp_mline_destroy(m);
+						if(error)
+							g_snprintf(error, errlen, "Invalid m= line (no payload types/formats): %s", line);
+						success = FALSE;
+						break;
+					} else {
+						int mindex = 0;
+						while(mline_parts[mindex]) {
+							if(mindex < 3) {
+								/* We've parsed these before */
+								mindex++;
+								continue;
+							}
+							/* Add string fmt */
+							m->fmts = g_list_prepend(m->fmts, g_strdup(mline_parts[mindex]));
+							/* Add numeric payload type */
+							int ptype = atoi(mline_parts[mindex]);
+							if(ptype < 0) {
+								JANUS_LOG(LOG_ERR, "Invalid payload type (%s)\n", mline_parts[mindex]);
+							} else {
+								m->ptypes = g_list_prepend(m->ptypes, GINT_TO_POINTER(ptype));
+							}
+							mindex++;
 						}
-						m->type_str = g_strdup(type);
-						m->proto = g_strdup(proto);
-						m->direction = JANUS_SDP_SENDRECV;
-						m->c_ipv4 = TRUE;
-						/* Now let's check the payload types/formats */
-						gchar **mline_parts = g_strsplit(line+2, " ", -1);
-						if(!mline_parts && (m->port > 0 || m->type == JANUS_SDP_APPLICATION)) {
+						g_strfreev(mline_parts);
+						if(m->fmts == NULL || m->ptypes == NULL) {
 							janus_sdp_mline_destroy(m);
 							if(error)
 								g_snprintf(error, errlen, "Invalid m= line (no payload types/formats): %s", line);
 							success = FALSE;
 							break;
-						} else {
-							int mindex = 0;
-							while(mline_parts[mindex]) {
-								if(mindex < 3) {
-									/* We've parsed these before */
-									mindex++;
-									continue;
-								}
-								/* Add string fmt */
-								m->fmts = g_list_prepend(m->fmts, g_strdup(mline_parts[mindex]));
-								/* Add numeric payload type */
-								int ptype = atoi(mline_parts[mindex]);
-								if(ptype < 0) {
-									JANUS_LOG(LOG_ERR, "Invalid payload type (%s)\n", mline_parts[mindex]);
-								} else {
-									m->ptypes = g_list_prepend(m->ptypes, GINT_TO_POINTER(ptype));
-								}
-								mindex++;
-							}
-							g_strfreev(mline_parts);
-							if(m->fmts == NULL || m->ptypes == NULL) {
-								janus_sdp_mline_destroy(m);
-								if(error)
-									g_snprintf(error, errlen, "Invalid m= line (no payload types/formats): %s", line);
-								success = FALSE;
-								break;
-							}
-							m->fmts = g_list_reverse(m->fmts);
-							m->ptypes = g_list_reverse(m->ptypes);
 						}
-						/* Append to the list of m-lines */
-						imported->m_lines = g_list_prepend(imported->m_lines, m);
-						/* From now on, we parse this m-line */
-						mline = m;
+						m->fmts = g_list_reverse(m->fmts);
+						m->ptypes = g_list_reverse(m->ptypes);
+					}
+					/* Append to the list of m-lines */
+					imported->m_lines = g_list_prepend(imported->m_lines, m);
+					/* From now on, we parse this m-line */
+					mline = m;
+					break;
+				}
+				default:
+					JANUS_LOG(LOG_WARN, "Ignoring '%c' property\n", c);
+					break;
+			}
+		} else {
+			/* m-line stuff */
+			switch(c) {
+				case 'c': {
+					if(mline->c_addr) {
+						if(error)
+							g_snprintf(error, errlen, "Multiple m-line c= lines: %s", line);
+						success = FALSE;
+						break;
+					}
+					char addrtype[6], addr[256];
+					if(sscanf(line, "c=IN %5s %255s", addrtype, addr) != 2) {
+						if(error)
+							g_snprintf(error, errlen, "Invalid c= line: %s", line);
+						success = FALSE;
 						break;
 					}
-					default:
-						JANUS_LOG(LOG_WARN, "Ignoring '%c' property\n", c);
+					if(!strcasecmp(addrtype, "IP4"))
+						mline->c_ipv4 = TRUE;
+					else if(!strcasecmp(addrtype, "IP6"))
+						mline->c_ipv4 = FALSE;
+					else {
+						if(error)
+							g_snprintf(error, errlen, "Invalid c= line (unsupported protocol %s): %s", addrtype, line);
+						success = FALSE;
 						break;
+					}
+					mline->c_addr = g_strdup(addr);
+					break;
 				}
-			} else {
-				/* m-line stuff */
-				switch(c) {
-					case 'c': {
-						if(mline->c_addr) {
-							if(error)
-								g_snprintf(error, errlen, "Multiple m-line c= lines: %s", line);
-							success = FALSE;
-							break;
-						}
-						char addrtype[6], addr[256];
-						if(sscanf(line, "c=IN %5s %255s", addrtype, addr) != 2) {
-							if(error)
-								g_snprintf(error, errlen, "Invalid c= line: %s", line);
-							success = FALSE;
-							break;
-						}
-						if(!strcasecmp(addrtype, "IP4"))
-							mline->c_ipv4 = TRUE;
-						else if(!strcasecmp(addrtype, "IP6"))
-							mline->c_ipv4 = FALSE;
-						else {
-							if(error)
-								g_snprintf(error, errlen, "Invalid c= line (unsupported protocol %s): %s", addrtype, line);
-							success = FALSE;
-							break;
-						}
-						mline->c_addr = g_strdup(addr);
+				case 'b': {
+					if(mline->b_name) {
+						JANUS_LOG(LOG_WARN, "Ignoring extra m-line b= line: %s\n", line);
+						line = next;
+						continue;
+					}
+					line += 2;
+					char *semicolon = strchr(line, ':');
+					if(semicolon == NULL || (*(semicolon+1) == '\0')) {
+						if(error)
+							g_snprintf(error, errlen, "Invalid b= line: %s", line);
+						success = FALSE;
+						break;
+					}
+					*semicolon = '\0';
+					if(strcmp(line, "AS") && strcmp(line, "TIAS")) {
+						/* We only support b=AS and b=TIAS, skip */
 						break;
 					}
-					case 'b': {
-						if(mline->b_name) {
-							JANUS_LOG(LOG_WARN, "Ignoring extra m-line b= line: %s\n", line);
-							if(cr != NULL)
-								*cr = '\r';
-							index++;
-							continue;
+					mline->b_name = g_strdup(line);
+					mline->b_value = atol(semicolon+1);
+					break;
+				}
+				case 'a': {
+					janus_sdp_attribute *a = g_malloc0(sizeof(janus_sdp_attribute));
+					janus_refcount_init(&a->ref, janus_sdp_attribute_free);
+					a->arena = TRUE;
+					line += 2;
+					char *semicolon = strchr(line, ':');
+					if(semicolon == NULL) {
+						/* Is this a media direction attribute? */
+						janus_sdp_mdirection direction = janus_sdp_parse_mdirection(line);
+						if(direction != JANUS_SDP_INVALID) {
+							janus_sdp_attribute_destroy(a);
+							mline->direction = direction;
+							break;
 						}
-						line += 2;
-						char *semicolon = strchr(line, ':');
-						if(semicolon == NULL || (*(semicolon+1) == '\0')) {
+						a->name = line;
+						a->value = NULL;
+					} else {
+						if(*(semicolon+1) == '\0') {
+							janus_sdp_attribute_destroy(a);
 							if(error)
-								g_snprintf(error, errlen, "Invalid b= line: %s", line);
+								g_snprintf(error, errlen, "Invalid a= line: %s", line);
 							success = FALSE;
 							break;
 						}
 						*semicolon = '\0';
-						if(strcmp(line, "AS") && strcmp(line, "TIAS")) {
-							/* We only support b=AS and b=TIAS, skip */
-							break;
-						}
-						mline->b_name = g_strdup(line);
-						mline->b_value = atol(semicolon+1);
-						*semicolon = ':';
-						break;
-					}
-					case 'a': {
-						janus_sdp_attribute *a = g_malloc0(sizeof(janus_sdp_attribute));
-						janus_refcount_init(&a->ref, janus_sdp_attribute_free);
-						line += 2;
-						char *semicolon = strchr(line, ':');
-						if(semicolon == NULL) {
-							/* Is this a media direction attribute? */
-							janus_sdp_mdirection direction = janus_sdp_parse_mdirection(line);
-							if(direction != JANUS_SDP_INVALID) {
-								janus_sdp_attribute_destroy(a);
-								mline->direction = direction;
-								break;
-							}
-							a->name = g_strdup(line);
-							a->value = NULL;
-						} else {
-							if(*(semicolon+1) == '\0') {
-								janus_sdp_attribute_destroy(a);
-								if(error)
-									g_snprintf(error, errlen, "Invalid a= line: %s", line);
-								success = FALSE;
-								break;
-							}
-							*semicolon = '\0';
-							a->name = g_strdup(line);
-							a->value = g_strdup(semicolon+1);
-							a->direction = JANUS_SDP_DEFAULT;
-							*semicolon = ':';
-							if(strstr(line, "/sendonly"))
-								a->direction = JANUS_SDP_SENDONLY;
-							else if(strstr(line, "/recvonly"))
-								a->direction = JANUS_SDP_RECVONLY;
-							if(strstr(line, "/inactive"))
-								a->direction = JANUS_SDP_INACTIVE;
-						}
-						mline->attributes = g_list_prepend(mline->attributes, a);
-						break;
+						a->name = line;
+						a->value = semicolon+1;
+						a->direction = JANUS_SDP_DEFAULT;
+						if(strstr(a->value, "/sendonly"))
+							a->direction = JANUS_SDP_SENDONLY;
+						else if(strstr(a->value, "/recvonly"))
+							a->direction = JANUS_SDP_RECVONLY;
+						if(strstr(a->value, "/inactive"))
+							a->direction = JANUS_SDP_INACTIVE;
 					}
-					case 'm': {
-						/* Current m-line ended, back to global parsing */
-						if(mline && mline->attributes)
-							mline->attributes = g_list_reverse(mline->attributes);
-						mline = NULL;
-						continue;
-					}
-					default:
-						JANUS_LOG(LOG_WARN, "Ignoring '%c' property (m-line)\n", c);
-						break;
+					mline->attributes = g_list_prepend(mline->attributes, a);
+					break;
 				}
+				default:
+					JANUS_LOG(LOG_WARN, "Ignoring '%c' property (m-line)\n", c);
+					break;
 			}
-			if(cr != NULL)
-				*cr = '\r';
-			index++;
 		}
-		if(cr != NULL)
-			*cr = '\r';
-		g_strfreev(parts);
+		line = next;
 	}
 	/* FIXME Do a last check: is all the stuff that's supposed to be there available? */
 	if(success && (imported->o_name == NULL || imported->o_addr == NULL || imported->s_name == NULL || imported->m_lines == NULL)) {
@@ -1350,6 +1350,7 @@ janus_sdp *janus_sdp_new(const char *name, const char *address) {
 	sdp->c_addr = g_strdup(address ? address : "127.0.0.1");
 	sdp->attributes = NULL;
 	sdp->m_lines = NULL;
+	sdp->arena = NULL;
 	/* Done */
 	return sdp;
 }
@@ -1875,6 +1876,7 @@ janus_sdp *janus_sdp_generate_answer(janus_sdp *offer) {
 	answer->c_addr = g_strdup(offer->c_addr ? offer->c_addr : "127.0.0.1");
 	answer->attributes = NULL;
 	answer->m_lines = NULL;
+	answer->arena = NULL;
 
 	/* Iterate on all m-lines to add, if any */
 	GList *temp = offer->m_lines;
@@ -50,6 +50,10 @@ typedef struct janus_sdp {
 	GList *attributes;
 	/*! \brief List of m= m-lines */
 	GList *m_lines;
+	/*! \brief Private copy of the SDP string this object was parsed from, if any:
+	 * attribute names and values are slices of this buffer, meaning they're all
+	 * freed in one shot when the object is destroyed */
+	char *arena;
 	/*! \brief Atomic flag to check if this instance has been destroyed */
 	volatile gint destroyed;
 	/*! \brief Reference counter for this instance */
@@ -202,6 +206,9 @@ typedef struct janus_sdp_attribute {
 	char *value;
 	/*! \brief Attribute direction (e.g., for extmap) */
 	janus_sdp_mdirection direction;
+	/*! \brief Whether name and value are slices of the arena of the janus_sdp this
+	 * attribute was parsed from, and so must not be freed individually */
+	gboolean arena;
 	/*! \brief Atomic flag to check if this instance has been destroyed */
 	volatile gint destroyed;
 	/*! \brief Reference counter for this instance */
@@ -223,6 +230,10 @@ void janus_sdp_attribute_destroy(janus_sdp_attribute *attr);
 int janus_sdp_attribute_add_to_mline(janus_sdp_mline *mline, janus_sdp_attribute *attr);
 
 /*! \brief Method to parse an SDP string to a janus_sdp object
+ * \note The returned object keeps a private copy of the SDP string, and the
+ * names and values of all attributes are slices of it: as such, they're freed
+ * in one shot when the object is destroyed, and must be duplicated in case
+ * they need to outlive it
  * @param[in] sdp The SDP string to parse
  * @param[in,out] error Buffer to receive a reason for an error, if any
  * @param[in] errlen The length of the error buffer
@@ -142,8 +142,48 @@ janus_sdp *janus_sdp_preparse(void *ice_handle, const char *jsep_sdp, char *erro
 	return parsed_sdp;
 }
 
+/* Helper to find the next m-line section in a raw SDP string */
+static const char *janus_sdp_next_mline_section(const char *section) {
+	const char *next = section ? strstr(section, "\nm=") : NULL;
+	return next ? next+1 : NULL;
+}
+
+/* Helper to compare the m-line sections of two raw SDP strings: returns an
+ * array of booleans, one per m-line in the new SDP, each telling whether that
+ * section is textually identical to the same section in the old SDP (the
+ * array is allocated, and must be freed by the caller) */
+static gboolean *janus_sdp_diff_mlines(const char *old_sdp, const char *new_sdp, int *num) {
+	const char *om = strstr(old_sdp, "\nm="), *nm = strstr(new_sdp, "\nm=");
+	if(om == NULL || nm == NULL)
+		return NULL;
+	om++;
+	nm++;
+	/* Count the m-lines in the new SDP first */
+	int count = 0;
+	const char *temp = nm;
+	while(temp) {
+		count++;
+		temp = janus_sdp_next_mline_section(temp);
+	}
+	gboolean *unchanged = g_malloc0(count*sizeof(gboolean));
+	int index = 0;
+	while(om != NULL && nm != NULL && index < count) {
+		const char *oend = janus_sdp_next_mline_section(om),
+			*nend = janus_sdp_next_mline_section(nm);
+		size_t olen = oend ? (size_t)(oend-om) : strlen(om),
+			nlen = nend ? (size_t)(nend-nm) : strlen(nm);
+		if(olen == nlen && memcmp(om, nm, nlen) == 0)
+			unchanged[index] = TRUE;
+		om = oend;
+		nm = nend;
+		index++;
+	}
+	*num = count;
+	return unchanged;
+}
+
 /* Parse remote SDP */
-int janus_sdp_process_remote(void *ice_handle, janus_sdp *remote_sdp, gboolean rids_hml, gboolean update) {
+int janus_sdp_process_remote(void *ice_handle, janus_sdp *remote_sdp, const char *raw_sdp, gboolean rids_hml, gboolean update) {
 	if(!ice_handle || !remote_sdp)
 		return -1;
 	janus_ice_handle *handle = (janus_ice_handle *)ice_handle;
@@ -154,6 +194,14 @@ int janus_sdp_process_remote(void *ice_handle, janus_sdp *remote_sdp, gboolean r
 	gchar *ruser = NULL, *rpass = NULL, *rhashing = NULL, *rfingerprint = NULL;
 	gboolean rtx = FALSE;
 	char *simulcast_rids = NULL;
+	/* If this is a renegotiation, check which m-line sections are textually
+	 * identical to the previous remote SDP: for those there's nothing new to
+	 * derive, and we can skip the whole attribute processing below, which on
+	 * PeerConnections with many m-lines is where most of the time is spent */
+	gboolean *unchanged = NULL;
+	int unchanged_num = 0;
+	if(update && raw_sdp != NULL && handle->remote_sdp != NULL)
+		unchanged = janus_sdp_diff_mlines(handle->remote_sdp, raw_sdp, &unchanged_num);
 	/* Ok, let's start with global attributes */
 	GList *temp = remote_sdp->attributes;
 	while(temp) {
@@ -186,6 +234,21 @@ int janus_sdp_process_remote(void *ice_handle, janus_sdp *remote_sdp, gboolean r
 	temp = remote_sdp->m_lines;
 	while(temp) {
 		janus_sdp_mline *m = (janus_sdp_mline *)temp->data;
+		if(unchanged != NULL && m->index > 0 && m->index < unchanged_num && unchanged[m->index]) {
+			/* This m-line is identical to the one in the previous remote SDP,
+			 * so we can skip it: we only recover the state we'd derive from
+			 * parsing it again (we never skip the first m-line, as that's
+			 * where the mandatory credentials checks are performed) */
+			medium = g_hash_table_lookup(pc->media, GINT_TO_POINTER(m->index));
+			if(medium != NULL) {
+				JANUS_LOG(LOG_HUGE, "[%"SCNu64"] m-line #%d unchanged in renegotiation, skipping\n",
+					handle->handle_id, m->index);
+				if(medium->rtx_payload_types != NULL)
+					rtx = TRUE;
+				temp = temp->next;
+				continue;
+			}
+		}
 		if(m->type == JANUS_SDP_AUDIO || m->type == JANUS_SDP_VIDEO) {
 			/* Audio/Video */
 			if(handle->rtp_profile == NULL && m->proto != NULL)
@@ -308,15 +371,16 @@ int janus_sdp_process_remote(void *ice_handle, janus_sdp *remote_sdp, gboolean r
 					if(strnlen(a->value, 16 + 1) > 16) {
 						JANUS_LOG(LOG_ERR, "[%"SCNu64"] mid on m-line #%d too large: (%zu > 16)\n",
 							handle->handle_id, m->index, strlen(a->value));
+						g_free(unchanged);
 						return -2;
 					}
 					if(medium->mid != NULL && strcasecmp(medium->mid, a->value)) {
 						JANUS_LOG(LOG_WARN, "[%"SCNu64"] mid on m-line #%d changed (%s --> %s), ignoring new value\n",
 							handle->handle_id, m->index, medium->mid, a->value);
 					} else if(medium->mid == NULL) {
-						medium->mid = g_strdup(a->value);
+						medium->mid = g_intern_string(a->value);
 						if(!g_hash_table_lookup(pc->media_bymid, medium->mid)) {
-							g_hash_table_insert(pc->media_bymid, g_strdup(medium->mid), medium);
+							g_hash_table_insert(pc->media_bymid, (gpointer)medium->mid, medium);
 							janus_refcount_increase(&medium->ref);
 						}
 					}
@@ -330,6 +394,7 @@ int janus_sdp_process_remote(void *ice_handle, janus_sdp *remote_sdp, gboolean r
 					if(sscanf(a->value, "%64s %64s", msid, mstid) != 2) {
 						JANUS_LOG(LOG_ERR, "[%"SCNu64"] Invalid msid on m-line #%d\n",
 							handle->handle_id, m->index);
+						g_free(unchanged);
 						return -2;
 					}
 					if(medium->remote_msid == NULL || strcasecmp(medium->remote_msid, msid)) {
@@ -394,6 +459,7 @@ int janus_sdp_process_remote(void *ice_handle, janus_sdp *remote_sdp, gboolean r
 				g_free(rpass);
 				g_free(rhashing);
 				g_free(rfingerprint);
+				g_free(unchanged);
 				return -2;
 			}
 			/* If we received the ICE credentials for the first time, enforce them */
@@ -660,7 +726,7 @@ int janus_sdp_process_remote(void *ice_handle, janus_sdp *remote_sdp, gboolean r
 							medium->rtcp_ctx[vindex]->out_media_link_quality = 100;
 						}
 						if(medium->last_seqs[vindex])
-							janus_seq_list_free(&medium->last_seqs[vindex]);
+							janus_seq_window_reset(medium->last_seqs[vindex]);
 						janus_mutex_unlock(&medium->mutex);
 					}
 					medium->ssrc_peer[vindex] = medium->ssrc_peer_new[vindex];
@@ -749,6 +815,7 @@ int janus_sdp_process_remote(void *ice_handle, janus_sdp *remote_sdp, gboolean r
 	g_free(rpass);
 	g_free(rhashing);
 	g_free(rfingerprint);
+	g_free(unchanged);
 
 	return 0;	/* FIXME Handle errors better */
 }
@@ -796,9 +863,9 @@ int janus_sdp_process_local(void *ice_handle, janus_sdp *remote_sdp, gboolean up
 						JANUS_LOG(LOG_WARN, "[%"SCNu64"] mid on m-line #%d changed (%s --> %s), ignoring new value\n",
 							handle->handle_id, m->index, medium->mid, a->value);
 					} else if(medium->mid == NULL) {
-						medium->mid = g_strdup(a->value);
+						medium->mid = g_intern_string(a->value);
 						if(!g_hash_table_lookup(pc->media_bymid, medium->mid)) {
-							g_hash_table_insert(pc->media_bymid, g_strdup(medium->mid), medium);
+							g_hash_table_insert(pc->media_bymid, (gpointer)medium->mid, medium);
 							janus_refcount_increase(&medium->ref);
 						}
 					}
@@ -862,9 +929,9 @@ int janus_sdp_process_local(void *ice_handle, janus_sdp *remote_sdp, gboolean up
 			char mid[5];
 			memset(mid, 0, sizeof(mid));
 			g_snprintf(mid, sizeof(mid), "%d", m->index);
-			medium->mid = g_strdup(mid);
+			medium->mid = g_intern_string(mid);
 			if(!g_hash_table_lookup(pc->media_bymid, medium->mid)) {
-				g_hash_table_insert(pc->media_bymid, g_strdup(medium->mid), medium);
+				g_hash_table_insert(pc->media_bymid, (gpointer)medium->mid, medium);
 				janus_refcount_increase(&medium->ref);
 			}
 		}
@@ -50,12 +50,17 @@ janus_sdp *janus_sdp_preparse(void *handle, const char *jsep_sdp, char *error_st
 
 /*! \brief Method to process a remote parsed session description
  * \details This method will process a session description coming from a peer, and set up the ICE candidates accordingly
+ * \note When processing a renegotiation, the raw SDP string, if provided, is
+ * compared to the previous remote SDP: m-line sections that are textually
+ * identical to what we processed before are skipped entirely, since there's
+ * nothing new to derive from them
  * @param[in] handle Opaque pointer to the ICE handle this session description will modify
  * @param[in] sdp The Janus SDP object to process
+ * @param[in] raw_sdp The raw SDP string the object was parsed from (optional, only used for renegotiations)
  * @param[in] rids_hml Whether the order of rids in the SDP, if present, will be h-m-l (TRUE) or l-m-h (FALSE)
  * @param[in] update Whether this SDP is an update to an existing session or not
  * @returns 0 in case of success, -1 in case of an error */
-int janus_sdp_process_remote(void *handle, janus_sdp *sdp, gboolean rids_hml, gboolean update);
+int janus_sdp_process_remote(void *handle, janus_sdp *sdp, const char *raw_sdp, gboolean rids_hml, gboolean update);
 
 /*! \brief Method to process a local parsed session description
  * \details This method will process a session description coming from a plugin, and set up the ICE candidates accordingly
@@ -0,0 +1,62 @@
+/*! \file    tracepoints.h
+ * \author   Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief    USDT tracepoints (headers)
+ * \details  Statically defined tracepoints (USDT) that can be compiled
+ * in with \c --enable-usdt, to observe the media hot path with tools
+ * like bpftrace, perf or systemtap without patching the code or
+ * rebuilding with ad-hoc logging. All probes live under the \c janus
+ * provider, and carry the handle ID as their first argument, so that
+ * the traffic of a specific PeerConnection can be isolated; timing can
+ * be derived from the tracer itself (e.g., \c nsecs in bpftrace).
+ *
+ * The probes currently defined on the media path are:
+ *
+ * - \c janus:incoming_rtp (handle ID, video, substream, length), after
+ * an incoming RTP packet has been unprotected;
+ * - \c janus:plugin_handoff (handle ID, video, length), right before an
+ * incoming RTP packet is passed to the plugin;
+ * - \c janus:relay_rtp (handle ID, video, length), when a plugin asks
+ * the core to relay an RTP packet to a handle;
+ * - \c janus:queue_enqueue (handle ID, type, length), when a packet is
+ * queued for the handle loop (or the outgoing RTP ring);
+ * - \c janus:queue_dequeue (handle ID, type, length), when the loop
+ * picks the packet up for processing;
+ * - \c janus:srtp_protect (handle ID, control, length, protected,
+ * result), after a packet has been encrypted (inline or on a helper);
+ * - \c janus:socket_send (handle ID, sent), after a packet (or, in
+ * batched mode, a set of packets, in which case \c sent counts
+ * messages, not bytes) has been passed to libnice.
+ *
+ * The VideoRoom plugin defines a \c janus:videoroom_relay_rtp probe
+ * (plugin session pointer, video, length) in its fan-out loop as well:
+ * plugins only see the opaque plugin session, so correlating it with
+ * the core probes requires matching on the traffic itself (or tracing
+ * the subsequent \c relay_rtp on the same thread).
+ *
+ * As an example, this bpftrace one-liner measures the time packets
+ * spend queued for a specific handle:
+ *
+\verbatim
+usdt:/path/to/janus:janus:queue_enqueue /arg0 == 1234/ { @t[arg0] = nsecs; }
+usdt:/path/to/janus:janus:queue_dequeue /@t[arg0]/ { @queued = hist(nsecs - @t[arg0]); delete(@t[arg0]); }
+\endverbatim
+ *
+ * \ingroup core
+ * \ref core
+ */
+
+#ifndef JANUS_TRACEPOINTS_H
+#define JANUS_TRACEPOINTS_H
+
+#ifdef HAVE_USDT
+#include <sys/sdt.h>
+/*! \brief Emit a statically defined tracepoint under the \c janus provider
+ * \note The arguments should be plain variables or trivial expressions:
+ * they may be evaluated even when no tracer is attached to the probe */
+#define JANUS_PROBE(probe, ...) STAP_PROBEV(janus, probe, ##__VA_ARGS__)
+#else
+#define JANUS_PROBE(probe, ...) do { } while(0)
+#endif
+
+#endif
@@ -13,7 +13,11 @@
  * itself and so on. GET requests instead are used for getting events
  * associated to a Janus session (and as such to all its plugin handles
  * and the events plugins push in the session itself), using a long poll
- * approach. A JavaScript library (janus.js) implements all of this on
+ * approach. Alternatively, a GET request with a \c stream=true query
+ * string argument turns the response into a persistent chunked stream,
+ * where events are written as they become available (one JSON object
+ * per line), saving the cost of re-establishing a long poll for each
+ * event burst. A JavaScript library (janus.js) implements all of this on
  * the client side automatically.
  * \note There's a well known bug in libmicrohttpd that may cause it to
  * spike to 100% of the CPU when using HTTPS on some distributions. In
@@ -114,6 +118,11 @@ janus_transport *create(void) {
 #define DEFAULT_CONNECTION_LIMIT (FD_SETSIZE-4)
 static unsigned int connection_limit = DEFAULT_CONNECTION_LIMIT;
 
+/* Whether the webservers should bind with SO_REUSEPORT, so that multiple
+ * Janus instances on the same host can share the API ports and let the
+ * kernel balance new connections among them (default=off) */
+static gboolean port_sharing = FALSE;
+
 /* Useful stuff */
 static gint initialized = 0, stopping = 0;
 static janus_transport_callbacks *gateway = NULL;
@@ -145,6 +154,7 @@ typedef struct janus_http_msg {
 	struct MHD_Connection *connection;	/* The MHD connection this message came from */
 	volatile int suspended;				/* Whether this connection is currently suspended */
 	volatile void *longpoll;			/* Whether this is a long poll connection for a session */
+	volatile int streaming;				/* Whether this is a persistent event stream connection for a session */
 	int max_events;						/* In case this is a long poll, how many events we should send back */
 	char *acro;							/* Value of the Origin HTTP header, if any (needed for CORS) */
 	char *acrh;							/* Value of the Access-Control-Request-Headers HTTP header, if any (needed for CORS) */
@@ -156,6 +166,7 @@ typedef struct janus_http_msg {
 	gint64 session_id;					/* Janus-Client session identifier this message belongs to */
 	char *response;						/* The response from the core as a string */
 	size_t resplen;						/* Length of the response in octets */
+	size_t respoffset;					/* Amount of the response already written (streaming connections only) */
 	GSource *timeout;					/* Timeout monitor, if any */
 	volatile gint timeout_flag;			/* Whether a timeout hasn't fired yet */
 	volatile gint destroyed;			/* Whether this session has been destroyed */
@@ -281,6 +292,7 @@ static void janus_http_request_completed(void *cls, struct MHD_Connection *conne
 	void **con_cls, enum MHD_RequestTerminationCode toe);
 /* Callback to send data back after resuming a connection */
 static ssize_t janus_http_response_callback(void *cls, uint64_t pos, char *buf, size_t max);
+static ssize_t janus_http_stream_callback(void *cls, uint64_t pos, char *buf, size_t max);
 /* Worker to handle requests that are actually long polls */
 static int janus_http_notifier(janus_http_msg *msg);
 /* Helper to quickly send a success response */
@@ -299,6 +311,9 @@ static char *cert_pem_bytes = NULL, *cert_key_bytes = NULL;
 static struct MHD_Daemon *admin_ws = NULL, *admin_sws = NULL;
 static char *admin_ws_path = NULL;
 
+/* Optional Prometheus metrics endpoint, served on the Janus API web server(s) */
+static char *metrics_path = NULL;
+
 /* Custom Access-Control-Allow-Origin value, if specified */
 static char *allow_origin = NULL;
 static gboolean enforce_cors = FALSE;
@@ -391,6 +406,12 @@ static struct MHD_Daemon *janus_http_create_daemon(gboolean admin, char *path,
 		const char *server_pem, const char *server_key, const char *password, const char *ciphers) {
 	struct MHD_Daemon *daemon = NULL;
 	gboolean secure = server_pem && server_key;
+	/* Extra options we only pass when enabled (e.g., SO_REUSEPORT for port
+	 * sharing): when off, the array starts with MHD_OPTION_END and is a no-op */
+	struct MHD_OptionItem extra_options[] = {
+		{ port_sharing ? MHD_OPTION_LISTENING_ADDRESS_REUSE : MHD_OPTION_END, 1, NULL },
+		{ MHD_OPTION_END, 0, NULL }
+	};
 	/* Any interface or IP address we need to limit ourselves to?
 	 * NOTE WELL: specifying an interface does NOT bind to all IPs associated
 	 * with that interface, but only to the first one that's detected */
@@ -511,6 +532,7 @@ static struct MHD_Daemon *janus_http_create_daemon(gboolean admin, char *path,
 				MHD_OPTION_NOTIFY_COMPLETED, &janus_http_request_completed, NULL,
 				MHD_OPTION_CONNECTION_TIMEOUT, 120,
 				MHD_OPTION_CONNECTION_LIMIT, connection_limit,
+				MHD_OPTION_ARRAY, extra_options,
 				MHD_OPTION_END);
 		} else {
 			/* Bind to the interface that was specified */
@@ -528,6 +550,7 @@ static struct MHD_Daemon *janus_http_create_daemon(gboolean admin, char *path,
 				MHD_OPTION_SOCK_ADDR, ipv6 ? (struct sockaddr *)&addr6 : (struct sockaddr *)&addr,
 				MHD_OPTION_CONNECTION_TIMEOUT, 120,
 				MHD_OPTION_CONNECTION_LIMIT, connection_limit,
+				MHD_OPTION_ARRAY, extra_options,
 				MHD_OPTION_END);
 		}
 	} else {
@@ -554,6 +577,7 @@ static struct MHD_Daemon *janus_http_create_daemon(gboolean admin, char *path,
 				MHD_OPTION_HTTPS_KEY_PASSWORD, password,
 				MHD_OPTION_CONNECTION_TIMEOUT, 120,
 				MHD_OPTION_CONNECTION_LIMIT, connection_limit,
+				MHD_OPTION_ARRAY, extra_options,
 				MHD_OPTION_END);
 		} else {
 			/* Bind to the interface that was specified */
@@ -575,6 +599,7 @@ static struct MHD_Daemon *janus_http_create_daemon(gboolean admin, char *path,
 				MHD_OPTION_SOCK_ADDR, ipv6 ? (struct sockaddr *)&addr6 : (struct sockaddr *)&addr,
 				MHD_OPTION_CONNECTION_TIMEOUT, 120,
 				MHD_OPTION_CONNECTION_LIMIT, connection_limit,
+				MHD_OPTION_ARRAY, extra_options,
 				MHD_OPTION_END);
 		}
 	}
@@ -710,6 +735,20 @@ int janus_http_init(janus_transport_callbacks *callback, const char *config_path
 		} else {
 			admin_ws_path = g_strdup("/admin");
 		}
+		/* Check if we should expose a Prometheus metrics endpoint too */
+		item = janus_config_get(config, config_general, janus_config_type_item, "metrics_path");
+		if(item && item->value) {
+			if(item->value[0] != '/') {
+				JANUS_LOG(LOG_FATAL, "Invalid metrics path %s (it should start with a /, e.g., /metrics\n", item->value);
+				return -1;
+			}
+			metrics_path = g_strdup(item->value);
+			if(strnlen(metrics_path, 1 + 1) > 1 && metrics_path[strlen(metrics_path)-1] == '/') {
+				/* Remove the trailing slash, it makes things harder when we parse requests later */
+				metrics_path[strlen(metrics_path)-1] = '\0';
+			}
+			JANUS_LOG(LOG_INFO, "Going to serve Prometheus metrics on %s\n", metrics_path);
+		}
 		/* Check the open connections limit for mhd */
 		item = janus_config_get(config, config_general, janus_config_type_item, "mhd_connection_limit");
 		if(item && item->value && janus_string_to_uint32(item->value, &connection_limit) < 0) {
@@ -720,6 +759,12 @@ int janus_http_init(janus_transport_callbacks *callback, const char *config_path
 		item = janus_config_get(config, config_general, janus_config_type_item, "mhd_debug");
 		if(item && item->value && janus_is_true(item->value))
 			mhd_debug_flag = MHD_USE_DEBUG;
+		/* Should the webservers share their ports with other instances? */
+		item = janus_config_get(config, config_general, janus_config_type_item, "port_sharing");
+		if(item && item->value && janus_is_true(item->value)) {
+			port_sharing = TRUE;
+			JANUS_LOG(LOG_INFO, "Binding the webservers with SO_REUSEPORT (port sharing)\n");
+		}
 
 		/* Any ACL for either the Janus or Admin API? */
 		item = janus_config_get(config, config_general, janus_config_type_item, "acl");
@@ -1055,12 +1100,22 @@ int janus_http_send_message(janus_transport_session *transport, void *request_id
 		janus_refcount_increase(&session->ref);
 		g_async_queue_push(session->events, message);
 		janus_mutex_unlock(&sessions_mutex);
-		/* Are there long polls waiting? */
+		/* Are there long polls (or event streams) waiting? */
 		janus_mutex_lock(&session->mutex);
 		janus_http_msg *msg = NULL;
-		while(session->longpolls) {
-			transport = (janus_transport_session *)session->longpolls->data;
+		GList *l = session->longpolls;
+		while(l) {
+			GList *next = l->next;
+			transport = (janus_transport_session *)l->data;
 			msg = (janus_http_msg *)(transport ? transport->transport_p : NULL);
+			if(msg && g_atomic_int_get(&msg->streaming)) {
+				/* Persistent event stream: just wake the connection up, if
+				 * it's suspended, its callback will write the new events */
+				if(g_atomic_int_compare_and_exchange(&msg->suspended, 1, 0))
+					MHD_resume_connection(msg->connection);
+				l = next;
+				continue;
+			}
 			/* Is this connection ready to send a response back? */
 			if(msg && g_atomic_pointer_compare_and_exchange(&msg->longpoll, (volatile void *)session, NULL)) {
 				janus_refcount_increase(&msg->ref);
@@ -1074,6 +1129,7 @@ int janus_http_send_message(janus_transport_session *transport, void *request_id
 				janus_refcount_decrease(&msg->ref);
 			}
 			session->longpolls = g_list_remove(session->longpolls, transport);
+			l = next;
 		}
 		janus_mutex_unlock(&session->mutex);
 		janus_refcount_decrease(&session->ref);
@@ -1439,6 +1495,20 @@ static janus_MHD_Result janus_http_handler(void *cls, struct MHD_Connection *con
 		ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
 		MHD_destroy_response(response);
 	}
+	/* Is this a scrape of the metrics endpoint? Those never reach the core as
+	 * requests: we just render the aggregate counters it keeps and serve them */
+	if(metrics_path != NULL && !strcasecmp(method, "GET") && !strcasecmp(url, metrics_path)) {
+		if(firstround)
+			return ret;
+		char *metrics = gateway->get_metrics();
+		response = MHD_create_response_from_buffer(strlen(metrics), metrics, MHD_RESPMEM_MUST_COPY);
+		MHD_add_response_header(response, "Content-Type", "text/plain; version=0.0.4");
+		janus_http_add_cors_headers(msg, response);
+		ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+		MHD_destroy_response(response);
+		g_free(metrics);
+		goto done;
+	}
 	/* Get path components */
 	if(strcasecmp(url, ws_path)) {
 		if(strnlen(ws_path, 1 + 1) > 1) {
@@ -1650,6 +1720,38 @@ static janus_MHD_Result janus_http_handler(void *cls, struct MHD_Connection *con
 				max_events = 1;
 			}
 		}
+		/* Check if the client would rather turn this request into a persistent
+		 * event stream, where events are written to the chunked response as
+		 * they become available, instead of a series of long polls */
+		const char *stream = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "stream");
+		if(stream != NULL && janus_is_true(stream)) {
+			JANUS_LOG(LOG_VERB, "Session %"SCNu64" found... streaming events\n", session_id);
+			janus_mutex_lock(&session->mutex);
+			response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN,
+				4096, &janus_http_stream_callback, msg, NULL);
+			if(response == NULL) {
+				ret = MHD_NO;
+			} else {
+				g_atomic_int_set(&msg->streaming, 1);
+				MHD_add_response_header(response, "Content-Type", "application/json");
+				janus_http_add_cors_headers(msg, response);
+				ret = MHD_queue_response(msg->connection, MHD_HTTP_OK, response);
+				MHD_destroy_response(response);
+				/* We still use the long poll timeout, but as a periodic
+				 * keepalive on the stream, rather than to end the request */
+				janus_refcount_increase(&ts->ref);
+				janus_refcount_increase(&session->ref);
+				g_atomic_int_set(&msg->timeout_flag, 1);
+				msg->timeout = janus_http_request_timeout_create(ts, session, 30);
+				g_source_attach(msg->timeout, httpctx);
+				/* Track this connection along the long polls for this session */
+				session->longpolls = g_list_append(session->longpolls, ts);
+				g_atomic_pointer_set(&msg->longpoll, session);
+			}
+			janus_mutex_unlock(&session->mutex);
+			janus_refcount_decrease(&session->ref);
+			goto done;
+		}
 		JANUS_LOG(LOG_VERB, "Session %"SCNu64" found... returning up to %d messages\n", session_id, max_events);
 		/* Handle GET, taking the first message from the list */
 		janus_mutex_lock(&session->mutex);
@@ -2127,6 +2229,73 @@ static ssize_t janus_http_response_callback(void *cls, uint64_t pos, char *buf,
 	return bytes;
 }
 
+static ssize_t janus_http_stream_callback(void *cls, uint64_t pos, char *buf, size_t max) {
+	janus_http_msg *request = (janus_http_msg *)cls;
+	if(request == NULL)
+		return MHD_CONTENT_READER_END_WITH_ERROR;
+	janus_refcount_increase(&request->ref);
+	janus_http_session *session = (janus_http_session *)g_atomic_pointer_get(&request->longpoll);
+	if(session == NULL || g_atomic_int_get(&session->destroyed) || g_atomic_int_get(&stopping)) {
+		/* Session's gone (or we are), end the stream */
+		janus_refcount_decrease(&request->ref);
+		return MHD_CONTENT_READER_END_OF_STREAM;
+	}
+	size_t sent = 0;
+	/* Anything left over from an event that didn't fit the previous chunk? */
+	if(request->response != NULL) {
+		size_t bytes = request->resplen - request->respoffset;
+		if(bytes > max)
+			bytes = max;
+		memcpy(buf, request->response + request->respoffset, bytes);
+		request->respoffset += bytes;
+		sent += bytes;
+		if(request->respoffset == request->resplen) {
+			g_free(request->response);
+			request->response = NULL;
+			request->resplen = 0;
+			request->respoffset = 0;
+		}
+	}
+	/* Batch as many pending events as fit in this chunk, each on its own line */
+	json_t *event = NULL;
+	while(request->response == NULL && sent < max &&
+			(event = g_async_queue_try_pop(session->events)) != NULL) {
+		char *event_text = json_dumps(event, json_format);
+		json_decref(event);
+		if(event_text == NULL) {
+			JANUS_LOG(LOG_ERR, "Failed to stringify message...\n");
+			continue;
+		}
+		size_t len = strlen(event_text);
+		if(sent + len + 1 <= max) {
+			memcpy(buf + sent, event_text, len);
+			sent += len;
+			buf[sent++] = '\n';
+		} else {
+			/* Send what we can, and keep the rest for the next chunk */
+			size_t bytes = max - sent;
+			memcpy(buf + sent, event_text, bytes);
+			sent += bytes;
+			request->response = g_strdup_printf("%s\n", event_text + bytes);
+			request->resplen = strlen(request->response);
+			request->respoffset = 0;
+		}
+		free(event_text);
+	}
+	if(sent == 0) {
+		/* Nothing to write: suspend the connection until new events arrive
+		 * (or the keepalive timeout fires), double checking the queue in
+		 * case something was pushed while we were suspending */
+		g_atomic_int_set(&request->suspended, 1);
+		MHD_suspend_connection(request->connection);
+		if(g_async_queue_length(session->events) > 0 &&
+				g_atomic_int_compare_and_exchange(&request->suspended, 1, 0))
+			MHD_resume_connection(request->connection);
+	}
+	janus_refcount_decrease(&request->ref);
+	return sent == 0 ? 0 : (ssize_t)sent;
+}
+
 /* Worker to handle notifications */
 static int janus_http_notifier(janus_http_msg *msg) {
 	if(!msg || !msg->connection)
@@ -2278,6 +2447,30 @@ void janus_http_timeout(janus_transport_session *ts, janus_http_session *session
 		return;
 	}
 	request->timeout = NULL;
+	/* Is this a persistent event stream? If so, this is just a periodic keepalive */
+	if(session != NULL && g_atomic_int_get(&request->streaming)) {
+		if(!g_atomic_int_get(&session->destroyed) && !g_atomic_int_get(&stopping)) {
+			/* Queue a keepalive on the stream, wake the connection up
+			 * if it's suspended, and re-arm the timeout: the stream
+			 * itself only ends when the client closes the connection */
+			json_t *event = json_object();
+			json_object_set_new(event, "janus", json_string("keepalive"));
+			g_async_queue_push(session->events, event);
+			if(g_atomic_int_compare_and_exchange(&request->suspended, 1, 0))
+				MHD_resume_connection(request->connection);
+			janus_refcount_increase(&ts->ref);
+			janus_refcount_increase(&session->ref);
+			g_atomic_int_set(&request->timeout_flag, 1);
+			request->timeout = janus_http_request_timeout_create(ts, session, 30);
+			g_source_attach(request->timeout, httpctx);
+		} else {
+			/* The session's gone, wake the connection up so the stream can end */
+			if(g_atomic_int_compare_and_exchange(&request->suspended, 1, 0))
+				MHD_resume_connection(request->connection);
+		}
+		janus_refcount_decrease(&ts->ref);
+		return;
+	}
 	/* Is this a long poll timeout, simply meaning we had nothing to send so far? */
 	if(session != NULL) {
 		janus_refcount_increase(&session->ref);
@@ -162,6 +162,11 @@ typedef struct janus_mqtt_context {
 #ifdef MQTTVERSION_5
 		GArray *proxy_transaction_user_properties;
 		GArray *add_transaction_user_properties;
+		int topic_alias_max;
+		guint16 topic_alias_broker_max;
+		GHashTable *topic_aliases;
+		guint16 next_topic_alias;
+		janus_mutex topic_aliases_mutex;
 #endif
 	} publish;
 	struct {
@@ -229,6 +234,7 @@ int janus_mqtt_client_get_response_code(MQTTAsync_failureData *response);
 #ifdef MQTTVERSION_5
 /* MQTT v5 interface callbacks */
 void janus_mqtt_client_disconnected5(void *context, MQTTProperties *properties, enum MQTTReasonCodes reasonCode);
+void janus_mqtt_client_connect_success5(void *context, MQTTAsync_successData5 *response);
 void janus_mqtt_client_connect_failure5(void *context, MQTTAsync_failureData5 *response);
 void janus_mqtt_client_reconnect_success5(void *context, MQTTAsync_successData5 *response);
 void janus_mqtt_client_reconnect_failure5(void *context, MQTTAsync_failureData5 *response);
@@ -462,6 +468,20 @@ int janus_mqtt_init(janus_transport_callbacks *callback, const char *config_path
 		ctx->connect.max_buffered = 100;
 	}
 
+#ifdef MQTTVERSION_5
+	janus_config_item *topic_alias_max_item = janus_config_get(config, config_general, janus_config_type_item, "topic_alias_max");
+	ctx->publish.topic_alias_max = (topic_alias_max_item && topic_alias_max_item->value) ?
+		atoi(topic_alias_max_item->value) : 0;
+	if(ctx->publish.topic_alias_max < 0) {
+		JANUS_LOG(LOG_ERR, "Invalid topic-alias-max value: %s (disabling topic aliases)\n", topic_alias_max_item->value);
+		ctx->publish.topic_alias_max = 0;
+	}
+	if(ctx->publish.topic_alias_max > 0 && ctx->connect.mqtt_version != MQTTVERSION_5) {
+		JANUS_LOG(LOG_WARN, "Topic aliases require MQTT 5, ignoring topic_alias_max\n");
+		ctx->publish.topic_alias_max = 0;
+	}
+#endif
+
 	janus_config_item *enabled_item = janus_config_get(config, config_general, janus_config_type_item, "enabled");
 	if(enabled_item == NULL) {
 		/* Try legacy property */
@@ -663,6 +683,12 @@ int janus_mqtt_init(janus_transport_callbacks *callback, const char *config_path
 		janus_mqtt_transaction_states = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, janus_mqtt_transaction_state_free);
 		g_rw_lock_init(&janus_mqtt_transaction_states_lock);
 
+		/* Initialize the topic alias cache, if outgoing aliases are enabled */
+		if(ctx->publish.topic_alias_max > 0) {
+			ctx->publish.topic_aliases = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+			janus_mutex_init(&ctx->publish.topic_aliases_mutex);
+		}
+
 		/* Getting vacuum interval from config */
 		janus_config_item *vacuum_interval_item = janus_config_get(config, config_general, janus_config_type_item, "vacuum_interval");
 		ctx->vacuum_interval = (vacuum_interval_item && vacuum_interval_item->value) ? (gint64)atoi(vacuum_interval_item->value) : 60;
@@ -896,12 +922,15 @@ int janus_mqtt_send_message(janus_transport_session *transport, void *request_id
 	rc = janus_mqtt_client_publish_message(ctx, payload, admin);
 #endif
 
+	json_decref(message);
+	free(payload);
 	if(rc != MQTTASYNC_SUCCESS) {
+		/* This includes the case where the library buffer is full (e.g.,
+		 * because the broker can't keep up): surface it to the core as a
+		 * failed delivery instead of silently claiming success */
 		JANUS_LOG(LOG_ERR, "Can't publish to MQTT topic: %s, return code: %d\n", admin ? ctx->admin.publish.topic : ctx->publish.topic, rc);
+		return -1;
 	}
-
-	json_decref(message);
-	free(payload);
 	return 0;
 }
 
@@ -1067,6 +1096,16 @@ void janus_mqtt_client_connected(void *context, char *cause) {
 	JANUS_LOG(LOG_INFO, "Connected to MQTT broker: %s\n", cause);
 	janus_mqtt_context *ctx = (janus_mqtt_context *)context;
 
+#ifdef MQTTVERSION_5
+	/* Topic aliases don't survive reconnections, start binding from scratch */
+	if(ctx->publish.topic_aliases != NULL) {
+		janus_mutex_lock(&ctx->publish.topic_aliases_mutex);
+		g_hash_table_remove_all(ctx->publish.topic_aliases);
+		ctx->publish.next_topic_alias = 0;
+		janus_mutex_unlock(&ctx->publish.topic_aliases_mutex);
+	}
+#endif
+
 	/* Subscribe to one (janus or admin) topic at the time */
 	if(janus_mqtt_api_enabled_) {
 		JANUS_LOG(LOG_INFO, "Subscribing to MQTT topic %s\n", ctx->subscribe.topic);
@@ -1181,6 +1220,7 @@ int janus_mqtt_client_connect(janus_mqtt_context *ctx) {
 		MQTTAsync_connectOptions options5 = MQTTAsync_connectOptions_initializer5;
 		options = options5;
 		options.cleanstart = ctx->connect.cleansession;
+		options.onSuccess5 = janus_mqtt_client_connect_success5;
 		options.onFailure5 = janus_mqtt_client_connect_failure5;
 	} else {
 		options.cleansession = ctx->connect.cleansession;
@@ -1220,6 +1260,26 @@ int janus_mqtt_client_connect(janus_mqtt_context *ctx) {
 	return MQTTAsync_connect(ctx->client, &options);
 }
 
+#ifdef MQTTVERSION_5
+void janus_mqtt_client_connect_success5(void *context, MQTTAsync_successData5 *response) {
+	/* Take note of how many topic aliases the broker allows us to use */
+	janus_mqtt_context *ctx = (janus_mqtt_context *)context;
+	if(ctx->publish.topic_aliases != NULL) {
+		guint16 broker_max = 0;
+		if(MQTTProperties_hasProperty(&response->properties, MQTTPROPERTY_CODE_TOPIC_ALIAS_MAXIMUM))
+			broker_max = MQTTProperties_getNumericValue(&response->properties, MQTTPROPERTY_CODE_TOPIC_ALIAS_MAXIMUM);
+		janus_mutex_lock(&ctx->publish.topic_aliases_mutex);
+		ctx->publish.topic_alias_broker_max = broker_max;
+		janus_mutex_unlock(&ctx->publish.topic_aliases_mutex);
+		if(broker_max == 0) {
+			JANUS_LOG(LOG_WARN, "MQTT broker doesn't allow topic aliases, disabling them\n");
+		} else {
+			JANUS_LOG(LOG_VERB, "MQTT broker allows up to %"SCNu16" topic aliases\n", broker_max);
+		}
+	}
+}
+#endif
+
 void janus_mqtt_client_connect_failure(void *context, MQTTAsync_failureData *response) {
 	int rc = janus_mqtt_client_get_response_code(response);
 	janus_mqtt_client_connect_failure_impl(context, rc);
@@ -1540,6 +1600,36 @@ int janus_mqtt_client_publish_message5(janus_mqtt_context *ctx, char *payload, g
 		topic = ctx->publish.topic;
 	}
 
+	/* If topic aliases are enabled, try shrinking the publish: once a
+	 * topic has been sent with an alias bound to it, later publishes can
+	 * carry the two-byte alias and an empty topic instead of the full
+	 * string (we only do this for our fixed topics, as per-transaction
+	 * response topics would just churn through the alias space) */
+	gboolean alias_only = FALSE;
+	if(custom_topic == NULL && ctx->publish.topic_aliases != NULL) {
+		guint16 alias = 0;
+		janus_mutex_lock(&ctx->publish.topic_aliases_mutex);
+		guint16 alias_max = ctx->publish.topic_alias_broker_max;
+		if(ctx->publish.topic_alias_max > 0 && alias_max > (guint16)ctx->publish.topic_alias_max)
+			alias_max = (guint16)ctx->publish.topic_alias_max;
+		gpointer val = g_hash_table_lookup(ctx->publish.topic_aliases, topic);
+		if(val != NULL) {
+			alias = GPOINTER_TO_UINT(val);
+			alias_only = TRUE;
+		} else if(ctx->publish.next_topic_alias < alias_max) {
+			/* First time we publish to this topic, bind a new alias to it */
+			alias = ++ctx->publish.next_topic_alias;
+			g_hash_table_insert(ctx->publish.topic_aliases, g_strdup(topic), GUINT_TO_POINTER(alias));
+		}
+		janus_mutex_unlock(&ctx->publish.topic_aliases_mutex);
+		if(alias > 0) {
+			MQTTProperty alias_prop;
+			alias_prop.identifier = MQTTPROPERTY_CODE_TOPIC_ALIAS;
+			alias_prop.value.integer2 = alias;
+			MQTTProperties_add(&msg.properties, &alias_prop);
+		}
+	}
+
 	MQTTAsync_responseOptions options = MQTTAsync_responseOptions_initializer;
 	options.context = ctx;
 
@@ -1551,7 +1641,13 @@ int janus_mqtt_client_publish_message5(janus_mqtt_context *ctx, char *payload, g
 		options.onFailure5 = janus_mqtt_client_publish_janus_failure5;
 	}
 
-	return MQTTAsync_sendMessage(ctx->client, topic, &msg, &options);
+	int rc = MQTTAsync_sendMessage(ctx->client, alias_only ? "" : topic, &msg, &options);
+	if(rc != MQTTASYNC_SUCCESS && alias_only) {
+		/* Some Paho releases refuse an empty topic even when an alias is
+		 * attached: retry with the full topic before giving up */
+		rc = MQTTAsync_sendMessage(ctx->client, topic, &msg, &options);
+	}
+	return rc;
 }
 #endif
 
@@ -1685,6 +1781,10 @@ void janus_mqtt_client_destroy_context(janus_mqtt_context **ptr) {
 		g_free(ctx->admin.publish.topic);
 	#ifdef MQTTVERSION_5
 		g_rw_lock_clear(&janus_mqtt_transaction_states_lock);
+		if(ctx->publish.topic_aliases != NULL) {
+			g_hash_table_destroy(ctx->publish.topic_aliases);
+			janus_mutex_destroy(&ctx->publish.topic_aliases_mutex);
+		}
 	#endif
 		g_free(ctx);
 		*ptr = NULL;
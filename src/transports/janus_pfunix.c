@@ -26,6 +26,12 @@
  * \ref transports
  */
 
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#endif
+
 #include "transport.h"
 
 #include <arpa/inet.h>
@@ -114,6 +120,11 @@ static size_t json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
 
 #define BUFFER_SIZE		8192
 
+#ifdef __linux__
+/* How many queued messages we ship with a single sendmmsg() call */
+#define JANUS_PFUNIX_BATCH_MAX	32
+#endif
+
 /* Parameter validation (for tweaking and queries via Admin API) */
 static struct janus_json_parameter request_parameters[] = {
 	{"request", JSON_STRING, JANUS_JSON_PARAM_REQUIRED}
@@ -435,33 +446,39 @@ int janus_pfunix_send_message(janus_transport_session *transport, void *request_
 		json_decref(message);
 		return -1;
 	}
-	/* Make sure this is related to a still valid Unix Sockets session */
 	janus_pfunix_client *client = (janus_pfunix_client *)transport->transport_p;
-	janus_mutex_lock(&clients_mutex);
-	if(g_hash_table_lookup(clients, client) == NULL) {
-		janus_mutex_unlock(&clients_mutex);
-		JANUS_LOG(LOG_WARN, "Outgoing message for invalid client %p\n", client);
-		json_decref(message);
-		message = NULL;
-		return -1;
-	}
-	janus_mutex_unlock(&clients_mutex);
-	/* Convert to string */
+	/* Convert to string before grabbing the global clients mutex */
 	char *payload = json_dumps(message, json_format);
 	json_decref(message);
 	if(payload == NULL) {
 		JANUS_LOG(LOG_ERR, "Failed to stringify message...\n");
 		return -1;
 	}
+	/* Make sure this is related to a still valid Unix Sockets session */
+	janus_mutex_lock(&clients_mutex);
+	if(g_hash_table_lookup(clients, client) == NULL) {
+		janus_mutex_unlock(&clients_mutex);
+		JANUS_LOG(LOG_WARN, "Outgoing message for invalid client %p\n", client);
+		free(payload);
+		return -1;
+	}
 	if(client->fd != -1) {
 		/* SOCK_SEQPACKET, enqueue the packet and have poll tell us when it's time to send it */
 		g_async_queue_push(client->messages, payload);
-		/* Notify the thread there's data to send */
-		int res = 0;
-		do {
-			res = write(write_fd[1], "x", 1);
-		} while(res == -1 && errno == EINTR);
+		/* Only wake the thread up if this was the first message we queued:
+		 * one pending wake-up is enough for the poll loop to notice the
+		 * whole backlog, and eliding the redundant ones saves a syscall
+		 * per message when notifications pile up at a high rate */
+		gboolean wakeup = (g_async_queue_length(client->messages) == 1);
+		janus_mutex_unlock(&clients_mutex);
+		if(wakeup) {
+			int res = 0;
+			do {
+				res = write(write_fd[1], "x", 1);
+			} while(res == -1 && errno == EINTR);
+		}
 	} else {
+		janus_mutex_unlock(&clients_mutex);
 		/* SOCK_DGRAM, send it right away */
 		int res = 0;
 		do {
@@ -713,6 +730,41 @@ void *janus_pfunix_thread(void *data) {
 				janus_mutex_lock(&clients_mutex);
 				janus_pfunix_client *client = g_hash_table_lookup(clients_by_fd, GINT_TO_POINTER(poll_fds[i].fd));
 				if(client != NULL) {
+#ifdef __linux__
+					/* Drain the queue in batches and ship each batch with a
+					 * single sendmmsg() call: message boundaries are kept per
+					 * msghdr, so this is safe on SOCK_SEQPACKET, and it costs
+					 * one syscall every few messages instead of one each */
+					char *payloads[JANUS_PFUNIX_BATCH_MAX];
+					struct mmsghdr msgs[JANUS_PFUNIX_BATCH_MAX];
+					struct iovec iovs[JANUS_PFUNIX_BATCH_MAX];
+					guint count = 0, j = 0;
+					while(client->fd > -1) {
+						count = 0;
+						char *payload = NULL;
+						while(count < JANUS_PFUNIX_BATCH_MAX && (payload = g_async_queue_try_pop(client->messages)) != NULL) {
+							payloads[count] = payload;
+							iovs[count].iov_base = payload;
+							iovs[count].iov_len = strlen(payload);
+							memset(&msgs[count], 0, sizeof(struct mmsghdr));
+							msgs[count].msg_hdr.msg_iov = &iovs[count];
+							msgs[count].msg_hdr.msg_iovlen = 1;
+							count++;
+						}
+						if(count == 0)
+							break;
+						int res = 0;
+						do {
+							res = sendmmsg(client->fd, msgs, count, 0);
+						} while(res == -1 && errno == EINTR);
+						/* FIXME Should we check if sent everything? */
+						JANUS_LOG(LOG_HUGE, "Written %d/%u queued messages on %d\n", res, count, client->fd);
+						for(j=0; j<count; j++)
+							g_free(payloads[j]);
+						if(count < JANUS_PFUNIX_BATCH_MAX)
+							break;
+					}
+#else
 					char *payload = NULL;
 					while((payload = g_async_queue_try_pop(client->messages)) != NULL) {
 						int res = 0;
@@ -725,6 +777,7 @@ void *janus_pfunix_thread(void *data) {
 						JANUS_LOG(LOG_HUGE, "Written %d/%zu bytes on %d\n", res, strlen(payload), client->fd);
 						g_free(payload);
 					}
+#endif
 					if(client->session_timeout) {
 						/* We should actually get rid of this connection, now */
 						shutdown(SHUT_RDWR, poll_fds[i].fd);
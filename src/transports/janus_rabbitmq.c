@@ -149,6 +149,8 @@ static struct janus_json_parameter configure_parameters[] = {
 typedef struct janus_rabbitmq_client {
 	amqp_connection_state_t rmq_conn;		/* AMQP connection state */
 	amqp_channel_t rmq_channel;				/* AMQP channel */
+	uint16_t rmq_publish_channels;			/* How many channels outgoing publishes are spread on */
+	uint16_t rmq_next_channel;				/* Next channel to publish on, when using more than one */
 	gboolean janus_api_enabled;				/* Whether the Janus API via RabbitMQ is enabled */
 	amqp_bytes_t janus_exchange;			/* AMQP exchange for outgoing messages */
 	amqp_bytes_t to_janus_queue;			/* AMQP outgoing messages queue (Janus API) */
@@ -190,6 +192,7 @@ static gboolean declare_outgoing_queue = FALSE, declare_outgoing_queue_admin = F
 amqp_boolean_t queue_durable = 0, queue_exclusive = 0, queue_autodelete = 0,
 	queue_durable_admin = 0, queue_exclusive_admin = 0, queue_autodelete_admin = 0;
 static uint16_t heartbeat = 0;
+static uint16_t publish_channels = 1;
 
 /* Transport implementation */
 int janus_rabbitmq_init(janus_transport_callbacks *callback, const char *config_path) {
@@ -312,6 +315,18 @@ int janus_rabbitmq_init(janus_transport_callbacks *callback, const char *config_
 		heartbeat = 0;
 	}
 
+	/* How many channels we should spread outgoing publishes on */
+	item = janus_config_get(config, config_general, janus_config_type_item, "publish_channels");
+	if(item && item->value) {
+		if(janus_string_to_uint16(item->value, &publish_channels) < 0 || publish_channels == 0) {
+			JANUS_LOG(LOG_ERR, "Invalid number of publish channels (%s), falling back to default (1)\n", item->value);
+			publish_channels = 1;
+		} else if(publish_channels > 16) {
+			JANUS_LOG(LOG_WARN, "Capping number of publish channels to 16 (configured: %"SCNu16")\n", publish_channels);
+			publish_channels = 16;
+		}
+	}
+
 	/* Now check if the Janus API must be supported */
 	item = janus_config_get(config, config_general, janus_config_type_item, "enabled");
 	if(item == NULL) {
@@ -588,6 +603,21 @@ int janus_rabbitmq_connect(void) {
 		JANUS_LOG(LOG_FATAL, "Can't connect to RabbitMQ server: error opening channel... %s, %s\n", amqp_error_string2(result.library_error), amqp_method_name(result.reply.id));
 		return -1;
 	}
+	/* If we're supposed to spread outgoing publishes on more than one
+	 * channel, open the additional ones too (the first is also used for
+	 * consuming): channels are the unit of parallelism on the broker */
+	rmq_client->rmq_publish_channels = publish_channels;
+	rmq_client->rmq_next_channel = 0;
+	uint16_t extra_channel = 0;
+	for(extra_channel = 2; extra_channel <= publish_channels; extra_channel++) {
+		JANUS_LOG(LOG_VERB, "Opening publish channel #%"SCNu16"...\n", extra_channel);
+		amqp_channel_open(rmq_client->rmq_conn, extra_channel);
+		result = amqp_get_rpc_reply(rmq_client->rmq_conn);
+		if(result.reply_type != AMQP_RESPONSE_NORMAL) {
+			JANUS_LOG(LOG_FATAL, "Can't connect to RabbitMQ server: error opening channel... %s, %s\n", amqp_error_string2(result.library_error), amqp_method_name(result.reply.id));
+			return -1;
+		}
+	}
 	rmq_client->janus_exchange = amqp_empty_bytes;
 	if(janus_exchange != NULL) {
 		JANUS_LOG(LOG_VERB, "Declaring exchange...\n");
@@ -1050,39 +1080,55 @@ void *janus_rmq_out_thread(void *data) {
 		janus_rabbitmq_response *response = g_async_queue_pop(rmq_client->messages);
 		if(response == &exit_message)
 			break;
-		if(!rmq_client->destroy && !g_atomic_int_get(&stopping) && response->payload) {
-			janus_mutex_lock(&rmq_client->mutex);
-			/* Gotcha! Convert json_t to string */
-			char *payload_text = response->payload;
-			JANUS_LOG(LOG_VERB, "Sending %s API message to RabbitMQ (%zu bytes) on exchange %s with routing key %s...\n", response->admin ? "Admin" : "Janus", strlen(payload_text), janus_exchange, response->admin ? from_janus_admin : from_janus);
-			JANUS_LOG(LOG_VERB, "%s\n", payload_text);
-			amqp_basic_properties_t props;
-			props._flags = 0;
-			props._flags |= AMQP_BASIC_REPLY_TO_FLAG;
-			props.reply_to = amqp_cstring_bytes("Janus");
-			if(response->correlation_id) {
-				props._flags |= AMQP_BASIC_CORRELATION_ID_FLAG;
-				props.correlation_id = amqp_cstring_bytes(response->correlation_id);
-			}
-			props._flags |= AMQP_BASIC_CONTENT_TYPE_FLAG;
-			props.content_type = amqp_cstring_bytes("application/json");
-			amqp_bytes_t message = amqp_cstring_bytes(payload_text);
-			int status = amqp_basic_publish(rmq_client->rmq_conn, rmq_client->rmq_channel, rmq_client->janus_exchange,
-				response->admin ? amqp_cstring_bytes(from_janus_admin) : amqp_cstring_bytes(from_janus),
-				0, 0, &props, message);
-			if(status != AMQP_STATUS_OK) {
-				JANUS_LOG(LOG_ERR, "Error publishing... %d, %s\n", status, amqp_error_string2(status));
+		/* Drain whatever else is queued and publish the whole batch under
+		 * a single lock: amqp_basic_publish doesn't wait for any reply
+		 * from the broker, so batching amortizes the locking and keeps
+		 * the publishes pipelined on the socket */
+		janus_mutex_lock(&rmq_client->mutex);
+		int batched = 0;
+		while(response != NULL && response != &exit_message) {
+			if(!rmq_client->destroy && !g_atomic_int_get(&stopping) && response->payload) {
+				/* Gotcha! Convert json_t to string */
+				char *payload_text = response->payload;
+				JANUS_LOG(LOG_VERB, "Sending %s API message to RabbitMQ (%zu bytes) on exchange %s with routing key %s...\n", response->admin ? "Admin" : "Janus", strlen(payload_text), janus_exchange, response->admin ? from_janus_admin : from_janus);
+				JANUS_LOG(LOG_VERB, "%s\n", payload_text);
+				amqp_basic_properties_t props;
+				props._flags = 0;
+				props._flags |= AMQP_BASIC_REPLY_TO_FLAG;
+				props.reply_to = amqp_cstring_bytes("Janus");
+				if(response->correlation_id) {
+					props._flags |= AMQP_BASIC_CORRELATION_ID_FLAG;
+					props.correlation_id = amqp_cstring_bytes(response->correlation_id);
+				}
+				props._flags |= AMQP_BASIC_CONTENT_TYPE_FLAG;
+				props.content_type = amqp_cstring_bytes("application/json");
+				amqp_bytes_t message = amqp_cstring_bytes(payload_text);
+				/* Round-robin the outgoing publishes over the available channels */
+				amqp_channel_t channel = (rmq_client->rmq_next_channel++ % rmq_client->rmq_publish_channels) + 1;
+				int status = amqp_basic_publish(rmq_client->rmq_conn, channel, rmq_client->janus_exchange,
+					response->admin ? amqp_cstring_bytes(from_janus_admin) : amqp_cstring_bytes(from_janus),
+					0, 0, &props, message);
+				if(status != AMQP_STATUS_OK) {
+					JANUS_LOG(LOG_ERR, "Error publishing... %d, %s\n", status, amqp_error_string2(status));
+				}
 			}
-			janus_mutex_unlock(&rmq_client->mutex);
+			/* Free the message */
+			g_free(response->correlation_id);
+			response->correlation_id = NULL;
+			if(response->payload != NULL)
+				free(response->payload);
+			response->payload = NULL;
+			g_free(response);
+			response = NULL;
+			/* Never hold the lock for too long, though, or we'd starve the in thread */
+			batched++;
+			if(batched == 100)
+				break;
+			response = g_async_queue_try_pop(rmq_client->messages);
 		}
-		/* Free the message */
-		g_free(response->correlation_id);
-		response->correlation_id = NULL;
-		if(response->payload != NULL)
-			free(response->payload);
-		response->payload = NULL;
-		g_free(response);
-		response = NULL;
+		janus_mutex_unlock(&rmq_client->mutex);
+		if(response == &exit_message)
+			break;
 	}
 	g_async_queue_unref(rmq_client->messages);
 	JANUS_LOG(LOG_INFO, "Leaving RabbitMQ out thread\n");
@@ -0,0 +1,1067 @@
+/*! \file   janus_smem.c
+ * \author Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief  Janus shared memory transport plugin
+ * \details  This is an implementation of a shared memory transport for
+ * the Janus API, aimed at control applications colocated on the same
+ * host (e.g., an orchestration sidecar) for which even Unix Sockets
+ * serialization overhead is measurable at high request rates. Requests
+ * and responses travel through a pair of single-producer/single-consumer
+ * ring buffers living in a \c memfd segment that Janus creates and
+ * shares with each client, so in the steady state exchanging a message
+ * is just a couple of memcpy calls and some atomic index updates, with
+ * no syscalls involved. A named Unix Socket (\c SOCK_SEQPACKET) is still
+ * used, but only as a bootstrap channel: when a client connects, Janus
+ * allocates the segment and sends back a single message containing the
+ * segment layout in the payload, and the \c memfd plus two \c eventfd
+ * descriptors as \c SCM_RIGHTS ancillary data. After that, the socket is
+ * only kept around to detect the client going away. Wake-ups work in
+ * both directions via the eventfds, but only when the consumer has
+ * flagged itself as blocked in the ring header: a consumer that is
+ * keeping up with the traffic (or busy polling) never causes the
+ * producer to issue the \c write() at all.
+ *
+ * The segment starts with a \ref janus_smem_header, followed by two
+ * rings, each made of a \ref janus_smem_ring header and \c ring_size
+ * bytes of data: the first ring carries client-to-Janus requests, the
+ * second Janus-to-client responses and events. Messages are framed in
+ * the data area as a 4-byte native-endian length followed by the JSON
+ * payload, wrapping around the end of the area. As with the Unix
+ * Sockets transport, requests need to address sessions and handles
+ * explicitly, via \c session_id and \c handle_id fields in the JSON
+ * payload, and sessions created through this transport are implicitly
+ * subscribed to their events.
+ *
+ * \note This transport is only built on Linux, as it relies on
+ * \c memfd_create() and \c eventfd().
+ *
+ * \ingroup transports
+ * \ref transports
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "transport.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+
+#include "../debug.h"
+#include "../apierror.h"
+#include "../config.h"
+#include "../mutex.h"
+#include "../utils.h"
+
+
+/* Transport plugin information */
+#define JANUS_SMEM_VERSION			1
+#define JANUS_SMEM_VERSION_STRING	"0.0.1"
+#define JANUS_SMEM_DESCRIPTION		"This transport plugin adds shared memory support to the Janus API, for colocated clients."
+#define JANUS_SMEM_NAME				"JANUS shared memory transport plugin"
+#define JANUS_SMEM_AUTHOR			"Meetecho s.r.l."
+#define JANUS_SMEM_PACKAGE			"janus.transport.smem"
+
+/* Transport methods */
+janus_transport *create(void);
+int janus_smem_init(janus_transport_callbacks *callback, const char *config_path);
+void janus_smem_destroy(void);
+int janus_smem_get_api_compatibility(void);
+int janus_smem_get_version(void);
+const char *janus_smem_get_version_string(void);
+const char *janus_smem_get_description(void);
+const char *janus_smem_get_name(void);
+const char *janus_smem_get_author(void);
+const char *janus_smem_get_package(void);
+gboolean janus_smem_is_janus_api_enabled(void);
+gboolean janus_smem_is_admin_api_enabled(void);
+int janus_smem_send_message(janus_transport_session *transport, void *request_id, gboolean admin, json_t *message);
+void janus_smem_session_created(janus_transport_session *transport, guint64 session_id);
+void janus_smem_session_over(janus_transport_session *transport, guint64 session_id, gboolean timeout, gboolean claimed);
+void janus_smem_session_claimed(janus_transport_session *transport, guint64 session_id);
+json_t *janus_smem_query_transport(json_t *request);
+
+
+/* Transport setup */
+static janus_transport janus_smem_transport =
+	JANUS_TRANSPORT_INIT (
+		.init = janus_smem_init,
+		.destroy = janus_smem_destroy,
+
+		.get_api_compatibility = janus_smem_get_api_compatibility,
+		.get_version = janus_smem_get_version,
+		.get_version_string = janus_smem_get_version_string,
+		.get_description = janus_smem_get_description,
+		.get_name = janus_smem_get_name,
+		.get_author = janus_smem_get_author,
+		.get_package = janus_smem_get_package,
+
+		.is_janus_api_enabled = janus_smem_is_janus_api_enabled,
+		.is_admin_api_enabled = janus_smem_is_admin_api_enabled,
+
+		.send_message = janus_smem_send_message,
+		.session_created = janus_smem_session_created,
+		.session_over = janus_smem_session_over,
+		.session_claimed = janus_smem_session_claimed,
+
+		.query_transport = janus_smem_query_transport,
+	);
+
+/* Transport creator */
+janus_transport *create(void) {
+	JANUS_LOG(LOG_VERB, "%s created!\n", JANUS_SMEM_NAME);
+	return &janus_smem_transport;
+}
+
+
+/* Useful stuff */
+static gint initialized = 0, stopping = 0;
+static janus_transport_callbacks *gateway = NULL;
+static gboolean notify_events = TRUE;
+
+/* JSON serialization options (compact by default: the payload never
+ * travels on the wire, so indentation would just waste ring space) */
+static size_t json_format = JSON_COMPACT | JSON_PRESERVE_ORDER;
+
+/* Parameter validation (for tweaking and queries via Admin API) */
+static struct janus_json_parameter request_parameters[] = {
+	{"request", JSON_STRING, JANUS_JSON_PARAM_REQUIRED}
+};
+static struct janus_json_parameter configure_parameters[] = {
+	{"events", JANUS_JSON_BOOL, 0},
+	{"json", JSON_STRING, 0},
+};
+/* Error codes (for the tweaking and queries via Admin API) */
+#define JANUS_SMEM_ERROR_INVALID_REQUEST		411
+#define JANUS_SMEM_ERROR_MISSING_ELEMENT		412
+#define JANUS_SMEM_ERROR_INVALID_ELEMENT		413
+#define JANUS_SMEM_ERROR_UNKNOWN_ERROR			499
+
+
+struct sockaddr_un sizecheck;
+#ifndef UNIX_PATH_MAX
+#define UNIX_PATH_MAX sizeof(sizecheck.sun_path)
+#endif
+
+/* Shared segment layout: this is what clients see too, so the structures
+ * below are part of the transport protocol and must not change without
+ * bumping the version in the header */
+#define JANUS_SMEM_MAGIC			0x4A534D31	/* "JSM1" */
+#define JANUS_SMEM_LAYOUT_VERSION	1
+
+typedef struct janus_smem_header {
+	guint32 magic;			/* Must be JANUS_SMEM_MAGIC */
+	guint32 version;		/* Layout version (JANUS_SMEM_LAYOUT_VERSION) */
+	guint32 ring_size;		/* Size in bytes of each ring data area (power of two) */
+	guint32 reserved;		/* Unused, keeps the rings 16-byte aligned */
+} janus_smem_header;
+
+typedef struct janus_smem_ring {
+	guint32 size;			/* Data area size in bytes (power of two): this is
+							 * informational for the client, we never read it
+							 * back ourselves, as the whole segment is writable
+							 * by the client and so can't be trusted */
+	volatile gint head;		/* Producer index (free running, wrapped on access) */
+	volatile gint tail;		/* Consumer index (free running, wrapped on access) */
+	volatile gint waiting;	/* Whether the consumer is blocked on its eventfd:
+							 * producers only write the eventfd when this is set */
+} janus_smem_ring;
+
+/* Default and boundary values for the ring data areas */
+#define JANUS_SMEM_RING_DEFAULT_SIZE	(512*1024)
+#define JANUS_SMEM_RING_MIN_SIZE		(16*1024)
+#define JANUS_SMEM_RING_MAX_SIZE		(64*1024*1024)
+static guint32 ring_size = JANUS_SMEM_RING_DEFAULT_SIZE;
+
+/* Shared memory service thread */
+static GThread *smem_thread = NULL;
+void *janus_smem_thread(void *data);
+
+/* Bootstrap Unix Sockets servers (Janus and Admin API) */
+static int pfd = -1, admin_pfd = -1;
+/* Socket pair to wake the service thread up for housekeeping */
+static int write_fd[2];
+
+/* Shared memory client session */
+typedef struct janus_smem_client {
+	int fd;							/* Bootstrap socket, kept to detect disconnections */
+	int shm_fd;						/* memfd backing the shared segment */
+	int in_efd;						/* eventfd the client kicks when it queued requests */
+	int out_efd;					/* eventfd we kick when we queued responses/events */
+	char *shm;						/* Mapping of the shared segment */
+	size_t shm_size;				/* Size of the mapping */
+	guint32 ring_size;				/* Trusted copy of the ring data area size: ring
+									 * accesses always use this one, never anything
+									 * re-read from the client-writable segment */
+	janus_smem_ring *in_ring;		/* Client-to-Janus ring (we're the consumer) */
+	janus_smem_ring *out_ring;		/* Janus-to-client ring (we're the producer) */
+	janus_mutex wmutex;				/* Mutex to serialize writes to the outgoing ring */
+	gboolean admin;					/* Whether this client is for the Admin or Janus API */
+	gboolean session_timeout;		/* Whether a Janus session timeout occurred in the core */
+	janus_transport_session *ts;	/* Janus core-transport session */
+} janus_smem_client;
+static GHashTable *clients = NULL, *clients_by_fd = NULL;
+static janus_mutex clients_mutex = JANUS_MUTEX_INITIALIZER;
+
+static void janus_smem_client_free(void *client_ref) {
+	if(!client_ref)
+		return;
+	JANUS_LOG(LOG_INFO, "Freeing shared memory client\n");
+	janus_smem_client *client = (janus_smem_client *)client_ref;
+	if(client->shm != NULL && client->shm != MAP_FAILED)
+		munmap(client->shm, client->shm_size);
+	if(client->shm_fd > -1)
+		close(client->shm_fd);
+	if(client->in_efd > -1)
+		close(client->in_efd);
+	if(client->out_efd > -1)
+		close(client->out_efd);
+	g_free(client);
+}
+
+
+/* Ring buffer helpers: single producer, single consumer, indices are
+ * free running 32-bit counters wrapped with a power-of-two mask. The
+ * data area size is always passed in from our own trusted copy: the
+ * client can rewrite anything in the shared segment, including the ring
+ * headers, so nothing read from there may ever be used to compute an
+ * offset or a length (a forged size would otherwise send our memcpy
+ * calls out of the mapping); the worst a client messing with its own
+ * indices can do this way is corrupt its own message stream */
+static void janus_smem_ring_copyin(janus_smem_ring *ring, guint32 size, guint32 pos, const char *src, guint32 len) {
+	char *data = (char *)(ring + 1);
+	guint32 offset = pos & (size - 1);
+	guint32 chunk = size - offset;
+	if(chunk > len)
+		chunk = len;
+	memcpy(data + offset, src, chunk);
+	if(len > chunk)
+		memcpy(data, src + chunk, len - chunk);
+}
+
+static void janus_smem_ring_copyout(janus_smem_ring *ring, guint32 size, guint32 pos, char *dst, guint32 len) {
+	char *data = (char *)(ring + 1);
+	guint32 offset = pos & (size - 1);
+	guint32 chunk = size - offset;
+	if(chunk > len)
+		chunk = len;
+	memcpy(dst, data + offset, chunk);
+	if(len > chunk)
+		memcpy(dst + chunk, data, len - chunk);
+}
+
+/* Append a framed message to a ring we produce into: returns FALSE if
+ * there's not enough room, in which case nothing is written at all */
+static gboolean janus_smem_ring_write(janus_smem_ring *ring, guint32 size, int efd, const char *payload, guint32 len) {
+	guint32 head = (guint32)g_atomic_int_get(&ring->head),
+		tail = (guint32)g_atomic_int_get(&ring->tail);
+	guint32 used = head - tail;
+	if(used > size || sizeof(guint32) + len > size - used)
+		return FALSE;
+	janus_smem_ring_copyin(ring, size, head, (const char *)&len, sizeof(guint32));
+	janus_smem_ring_copyin(ring, size, head + sizeof(guint32), payload, len);
+	/* Publish the new head: g_atomic_int_set() is a full barrier, so the
+	 * payload is visible to the consumer before the index moves */
+	g_atomic_int_set(&ring->head, (gint)(head + sizeof(guint32) + len));
+	/* Only pay for the eventfd write if the consumer flagged itself as
+	 * blocked: a consumer that's keeping up costs us zero syscalls */
+	if(g_atomic_int_get(&ring->waiting)) {
+		guint64 one = 1;
+		int res = 0;
+		do {
+			res = write(efd, &one, sizeof(one));
+		} while(res == -1 && errno == EINTR);
+	}
+	return TRUE;
+}
+
+/* Extract the next framed message from a ring we consume from: returns
+ * a NUL-terminated copy to free with g_free(), or NULL if the ring is
+ * empty; a corrupted frame resets the ring, as we can't resync */
+static char *janus_smem_ring_read(janus_smem_ring *ring, guint32 size) {
+	guint32 head = (guint32)g_atomic_int_get(&ring->head),
+		tail = (guint32)g_atomic_int_get(&ring->tail);
+	if(head == tail)
+		return NULL;
+	/* The head is under the client's control: a ring can never hold more
+	 * than its size, so anything beyond that is a forged index, and must
+	 * be caught before we size an allocation on it */
+	guint32 used = head - tail;
+	if(used > size) {
+		JANUS_LOG(LOG_ERR, "Invalid indices in shared memory ring (%"SCNu32" bytes used), resetting it\n", used);
+		g_atomic_int_set(&ring->tail, (gint)head);
+		return NULL;
+	}
+	guint32 len = 0;
+	janus_smem_ring_copyout(ring, size, tail, (char *)&len, sizeof(guint32));
+	if(len == 0 || sizeof(guint32) + len > used) {
+		JANUS_LOG(LOG_ERR, "Corrupted frame in shared memory ring (%"SCNu32" bytes), resetting it\n", len);
+		g_atomic_int_set(&ring->tail, (gint)head);
+		return NULL;
+	}
+	char *payload = g_malloc(len + 1);
+	janus_smem_ring_copyout(ring, size, tail + sizeof(guint32), payload, len);
+	payload[len] = '\0';
+	g_atomic_int_set(&ring->tail, (gint)(tail + sizeof(guint32) + len));
+	return payload;
+}
+
+
+/* Helper to create a named Unix Socket for the bootstrap handshake */
+static int janus_smem_create_socket(char *pfname) {
+	if(pfname == NULL)
+		return -1;
+	if(strnlen(pfname, UNIX_PATH_MAX + 1) > UNIX_PATH_MAX) {
+		JANUS_LOG(LOG_WARN, "The provided path name (%s) is longer than %lu characters, it will be truncated\n", pfname, UNIX_PATH_MAX);
+		pfname[UNIX_PATH_MAX] = '\0';
+	}
+	int fd = socket(PF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0);
+	if(fd < 0) {
+		JANUS_LOG(LOG_FATAL, "Bootstrap socket %s creation failed: %d, %s\n", pfname, errno, g_strerror(errno));
+		return -1;
+	}
+	/* Unlink before binding */
+	unlink(pfname);
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	g_snprintf(address.sun_path, UNIX_PATH_MAX, "%s", pfname);
+	JANUS_LOG(LOG_VERB, "Binding bootstrap socket %s...\n", pfname);
+	if(bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+		JANUS_LOG(LOG_FATAL, "Bind for bootstrap socket %s failed: %d, %s\n", pfname, errno, g_strerror(errno));
+		close(fd);
+		return -1;
+	}
+	JANUS_LOG(LOG_VERB, "Listening on bootstrap socket %s...\n", pfname);
+	if(listen(fd, 128) != 0) {
+		JANUS_LOG(LOG_FATAL, "Listening on bootstrap socket %s failed: %d, %s\n", pfname, errno, g_strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* Helper to allocate the shared segment for a new client and send the
+ * descriptors over the bootstrap socket: returns FALSE on failure */
+static gboolean janus_smem_setup_client(janus_smem_client *client) {
+	/* Keep a trusted copy of the geometry: all our ring accesses use this
+	 * one, as whatever's in the shared segment can be rewritten by the client */
+	client->ring_size = ring_size;
+	client->shm_size = sizeof(janus_smem_header) + 2*(sizeof(janus_smem_ring) + ring_size);
+	client->shm_fd = memfd_create("janus-smem", MFD_CLOEXEC);
+	if(client->shm_fd < 0) {
+		JANUS_LOG(LOG_ERR, "memfd_create failed: %d, %s\n", errno, g_strerror(errno));
+		return FALSE;
+	}
+	if(ftruncate(client->shm_fd, client->shm_size) < 0) {
+		JANUS_LOG(LOG_ERR, "Error sizing shared segment: %d, %s\n", errno, g_strerror(errno));
+		return FALSE;
+	}
+	client->shm = mmap(NULL, client->shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, client->shm_fd, 0);
+	if(client->shm == MAP_FAILED) {
+		JANUS_LOG(LOG_ERR, "Error mapping shared segment: %d, %s\n", errno, g_strerror(errno));
+		return FALSE;
+	}
+	client->in_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	client->out_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if(client->in_efd < 0 || client->out_efd < 0) {
+		JANUS_LOG(LOG_ERR, "Error creating eventfds: %d, %s\n", errno, g_strerror(errno));
+		return FALSE;
+	}
+	/* Initialize the segment: header, then the two rings */
+	janus_smem_header *header = (janus_smem_header *)client->shm;
+	header->magic = JANUS_SMEM_MAGIC;
+	header->version = JANUS_SMEM_LAYOUT_VERSION;
+	header->ring_size = ring_size;
+	header->reserved = 0;
+	client->in_ring = (janus_smem_ring *)(client->shm + sizeof(janus_smem_header));
+	client->in_ring->size = ring_size;
+	client->out_ring = (janus_smem_ring *)((char *)(client->in_ring + 1) + ring_size);
+	client->out_ring->size = ring_size;
+	/* Send the header as payload and the three descriptors as ancillary
+	 * data: from the client's perspective, the first eventfd is the one
+	 * to write after queueing requests, the second the one to block on */
+	struct iovec iov = { .iov_base = header, .iov_len = sizeof(janus_smem_header) };
+	int fds[3] = { client->shm_fd, client->in_efd, client->out_efd };
+	char control[CMSG_SPACE(sizeof(fds))];
+	memset(control, 0, sizeof(control));
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+	int res = 0;
+	do {
+		res = sendmsg(client->fd, &msg, 0);
+	} while(res == -1 && errno == EINTR);
+	if(res < 0) {
+		JANUS_LOG(LOG_ERR, "Error sending shared segment descriptors: %d, %s\n", errno, g_strerror(errno));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* Helper to get rid of a client: must be called with the clients mutex held */
+static void janus_smem_drop_client(janus_smem_client *client, gboolean notify) {
+	if(notify) {
+		/* Notify core */
+		gateway->transport_gone(&janus_smem_transport, client->ts);
+		/* Notify handlers about this transport being gone */
+		if(notify_events && gateway->events_is_enabled()) {
+			json_t *info = json_object();
+			json_object_set_new(info, "event", json_string("disconnected"));
+			gateway->notify_event(&janus_smem_transport, client->ts, info);
+		}
+	}
+	g_hash_table_remove(clients_by_fd, GINT_TO_POINTER(client->fd));
+	g_hash_table_remove(clients, client);
+	shutdown(SHUT_RDWR, client->fd);
+	close(client->fd);
+	client->fd = -1;
+	/* Unref the transport instance: the mapping and the other
+	 * descriptors are released in janus_smem_client_free */
+	janus_transport_session_destroy(client->ts);
+}
+
+
+/* Transport implementation */
+int janus_smem_init(janus_transport_callbacks *callback, const char *config_path) {
+	if(g_atomic_int_get(&stopping)) {
+		/* Still stopping from before */
+		return -1;
+	}
+	if(callback == NULL || config_path == NULL) {
+		/* Invalid arguments */
+		return -1;
+	}
+
+	/* This is the callback we'll need to invoke to contact the Janus core */
+	gateway = callback;
+
+	/* Read configuration */
+	char filename[255];
+	g_snprintf(filename, 255, "%s/%s.jcfg", config_path, JANUS_SMEM_PACKAGE);
+	JANUS_LOG(LOG_VERB, "Configuration file: %s\n", filename);
+	janus_config *config = janus_config_parse(filename);
+	if(config == NULL) {
+		JANUS_LOG(LOG_WARN, "Couldn't find .jcfg configuration file (%s), trying .cfg\n", JANUS_SMEM_PACKAGE);
+		g_snprintf(filename, 255, "%s/%s.cfg", config_path, JANUS_SMEM_PACKAGE);
+		JANUS_LOG(LOG_VERB, "Configuration file: %s\n", filename);
+		config = janus_config_parse(filename);
+	}
+	if(config != NULL) {
+		/* Handle configuration */
+		janus_config_print(config);
+		janus_config_category *config_general = janus_config_get_create(config, NULL, janus_config_type_category, "general");
+		janus_config_category *config_admin = janus_config_get_create(config, NULL, janus_config_type_category, "admin");
+
+		janus_config_item *item = janus_config_get(config, config_general, janus_config_type_item, "json");
+		if(item && item->value) {
+			/* Check how we need to format/serialize the JSON output */
+			if(!strcasecmp(item->value, "indented")) {
+				json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
+			} else if(!strcasecmp(item->value, "plain")) {
+				/* Not indented and no new lines, but still readable */
+				json_format = JSON_INDENT(0) | JSON_PRESERVE_ORDER;
+			} else if(!strcasecmp(item->value, "compact")) {
+				/* Default: compact, so no spaces between separators */
+				json_format = JSON_COMPACT | JSON_PRESERVE_ORDER;
+			} else {
+				JANUS_LOG(LOG_WARN, "Unsupported JSON format option '%s', using default (compact)\n", item->value);
+				json_format = JSON_COMPACT | JSON_PRESERVE_ORDER;
+			}
+		}
+
+		/* Check if we need to send events to handlers */
+		janus_config_item *events = janus_config_get(config, config_general, janus_config_type_item, "events");
+		if(events != NULL && events->value != NULL)
+			notify_events = janus_is_true(events->value);
+		if(!notify_events && callback->events_is_enabled()) {
+			JANUS_LOG(LOG_WARN, "Notification of events to handlers disabled for %s\n", JANUS_SMEM_NAME);
+		}
+
+		/* Check if a custom ring size was provided */
+		item = janus_config_get(config, config_general, janus_config_type_item, "ring_size");
+		if(item && item->value) {
+			int rs = atoi(item->value);
+			if(rs < JANUS_SMEM_RING_MIN_SIZE/1024 || rs > JANUS_SMEM_RING_MAX_SIZE/1024) {
+				JANUS_LOG(LOG_WARN, "Invalid ring_size %s (KB), using default (%d)\n",
+					item->value, JANUS_SMEM_RING_DEFAULT_SIZE/1024);
+			} else {
+				/* Round up to the next power of two, the rings need that */
+				guint32 size = 1024*(guint32)rs, rounded = JANUS_SMEM_RING_MIN_SIZE;
+				while(rounded < size)
+					rounded <<= 1;
+				if(rounded != size) {
+					JANUS_LOG(LOG_WARN, "ring_size must be a power of two, rounding %"SCNu32"KB up to %"SCNu32"KB\n",
+						size/1024, rounded/1024);
+				}
+				ring_size = rounded;
+			}
+		}
+
+		/* First of all, initialize the socketpair for the thread wake-ups */
+		if(socketpair(PF_LOCAL, SOCK_STREAM, 0, write_fd) < 0) {
+			JANUS_LOG(LOG_FATAL, "Error creating socket pair for wake-up events: %d, %s\n", errno, g_strerror(errno));
+			janus_config_destroy(config);
+			return -1;
+		}
+
+		/* Setup the Janus API bootstrap socket */
+		item = janus_config_get(config, config_general, janus_config_type_item, "enabled");
+		if(!item || !item->value || !janus_is_true(item->value)) {
+			JANUS_LOG(LOG_VERB, "Shared memory server disabled (Janus API)\n");
+		} else {
+			item = janus_config_get(config, config_general, janus_config_type_item, "path");
+			char *pfname = (char *)(item && item->value ? item->value : NULL);
+			if(pfname == NULL) {
+				JANUS_LOG(LOG_WARN, "No path configured, skipping shared memory server (Janus API)\n");
+			} else {
+				JANUS_LOG(LOG_INFO, "Configuring shared memory server (Janus API)\n");
+				pfd = janus_smem_create_socket(pfname);
+			}
+		}
+		/* Do the same for the Admin API, if enabled */
+		item = janus_config_get(config, config_admin, janus_config_type_item, "admin_enabled");
+		if(!item || !item->value || !janus_is_true(item->value)) {
+			JANUS_LOG(LOG_VERB, "Shared memory server disabled (Admin API)\n");
+		} else {
+			item = janus_config_get(config, config_admin, janus_config_type_item, "admin_path");
+			char *pfname = (char *)(item && item->value ? item->value : NULL);
+			if(pfname == NULL) {
+				JANUS_LOG(LOG_WARN, "No path configured, skipping shared memory server (Admin API)\n");
+			} else {
+				JANUS_LOG(LOG_INFO, "Configuring shared memory server (Admin API)\n");
+				admin_pfd = janus_smem_create_socket(pfname);
+			}
+		}
+	}
+	janus_config_destroy(config);
+	config = NULL;
+	if(pfd < 0 && admin_pfd < 0) {
+		JANUS_LOG(LOG_WARN, "No shared memory server started, giving up...\n");
+		return -1;	/* No point in keeping the plugin loaded */
+	}
+
+	/* Create a couple of hashtables for all clients */
+	clients = g_hash_table_new(NULL, NULL);
+	clients_by_fd = g_hash_table_new(NULL, NULL);
+
+	/* Start the shared memory service thread */
+	GError *error = NULL;
+	smem_thread = g_thread_try_new("smem thread", &janus_smem_thread, NULL, &error);
+	if(error != NULL) {
+		g_atomic_int_set(&initialized, 0);
+		JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the shared memory thread...\n",
+			error->code, error->message ? error->message : "??");
+		g_error_free(error);
+		return -1;
+	}
+
+	/* Done */
+	g_atomic_int_set(&initialized, 1);
+	JANUS_LOG(LOG_INFO, "%s initialized!\n", JANUS_SMEM_NAME);
+	return 0;
+}
+
+void janus_smem_destroy(void) {
+	if(!g_atomic_int_get(&initialized))
+		return;
+	g_atomic_int_set(&stopping, 1);
+
+	/* Stop the service thread */
+	int res = 0;
+	do {
+		res = write(write_fd[1], "x", 1);
+	} while(res == -1 && errno == EINTR);
+
+	if(smem_thread != NULL) {
+		g_thread_join(smem_thread);
+		smem_thread = NULL;
+	}
+
+	g_atomic_int_set(&initialized, 0);
+	g_atomic_int_set(&stopping, 0);
+	JANUS_LOG(LOG_INFO, "%s destroyed!\n", JANUS_SMEM_NAME);
+}
+
+int janus_smem_get_api_compatibility(void) {
+	/* Important! This is what your plugin MUST always return: don't lie here or bad things will happen */
+	return JANUS_TRANSPORT_API_VERSION;
+}
+
+int janus_smem_get_version(void) {
+	return JANUS_SMEM_VERSION;
+}
+
+const char *janus_smem_get_version_string(void) {
+	return JANUS_SMEM_VERSION_STRING;
+}
+
+const char *janus_smem_get_description(void) {
+	return JANUS_SMEM_DESCRIPTION;
+}
+
+const char *janus_smem_get_name(void) {
+	return JANUS_SMEM_NAME;
+}
+
+const char *janus_smem_get_author(void) {
+	return JANUS_SMEM_AUTHOR;
+}
+
+const char *janus_smem_get_package(void) {
+	return JANUS_SMEM_PACKAGE;
+}
+
+gboolean janus_smem_is_janus_api_enabled(void) {
+	return pfd > -1;
+}
+
+gboolean janus_smem_is_admin_api_enabled(void) {
+	return admin_pfd > -1;
+}
+
+int janus_smem_send_message(janus_transport_session *transport, void *request_id, gboolean admin, json_t *message) {
+	if(message == NULL)
+		return -1;
+	if(transport == NULL || transport->transport_p == NULL) {
+		json_decref(message);
+		return -1;
+	}
+	janus_smem_client *client = (janus_smem_client *)transport->transport_p;
+	/* Convert to string before grabbing the global clients mutex */
+	char *payload = json_dumps(message, json_format);
+	json_decref(message);
+	if(payload == NULL) {
+		JANUS_LOG(LOG_ERR, "Failed to stringify message...\n");
+		return -1;
+	}
+	size_t length = strlen(payload);
+	/* Make sure this is related to a still valid shared memory session */
+	janus_mutex_lock(&clients_mutex);
+	if(g_hash_table_lookup(clients, client) == NULL) {
+		janus_mutex_unlock(&clients_mutex);
+		JANUS_LOG(LOG_WARN, "Outgoing message for invalid client %p\n", client);
+		free(payload);
+		return -1;
+	}
+	janus_transport_session *ts = client->ts;
+	janus_refcount_increase(&ts->ref);
+	janus_mutex_unlock(&clients_mutex);
+	/* Copy the message to the outgoing ring: several core threads may
+	 * get here concurrently for the same client, so writes need to be
+	 * serialized; the only consumer is the client, which never takes
+	 * this mutex, so there's no cross-process locking involved */
+	janus_mutex_lock(&client->wmutex);
+	if(length + sizeof(guint32) > client->ring_size) {
+		janus_mutex_unlock(&client->wmutex);
+		janus_refcount_decrease(&ts->ref);
+		JANUS_LOG(LOG_ERR, "Outgoing message larger than the shared memory ring (%zu > %"SCNu32"), dropping it...\n",
+			length, client->ring_size);
+		free(payload);
+		return -1;
+	}
+	if(!janus_smem_ring_write(client->out_ring, client->ring_size, client->out_efd, payload, (guint32)length)) {
+		/* Ring full: the client is not draining fast enough, dropping
+		 * the message is the only option that doesn't stall the core */
+		janus_mutex_unlock(&client->wmutex);
+		janus_refcount_decrease(&ts->ref);
+		JANUS_LOG(LOG_WARN, "Shared memory ring full for client %p, dropping message (%zu bytes)...\n", client, length);
+		free(payload);
+		return -1;
+	}
+	janus_mutex_unlock(&client->wmutex);
+	janus_refcount_decrease(&ts->ref);
+	free(payload);
+	return 0;
+}
+
+void janus_smem_session_created(janus_transport_session *transport, guint64 session_id) {
+	/* We don't care */
+}
+
+void janus_smem_session_over(janus_transport_session *transport, guint64 session_id, gboolean timeout, gboolean claimed) {
+	/* We only care if it's a timeout: if so, close the connection */
+	if(transport == NULL || transport->transport_p == NULL || !timeout)
+		return;
+	janus_smem_client *client = (janus_smem_client *)transport->transport_p;
+	janus_mutex_lock(&clients_mutex);
+	if(g_hash_table_lookup(clients, client) != NULL) {
+		client->session_timeout = TRUE;
+		/* Notify the thread about this */
+		int res = 0;
+		do {
+			res = write(write_fd[1], "x", 1);
+		} while(res == -1 && errno == EINTR);
+	}
+	janus_mutex_unlock(&clients_mutex);
+}
+
+void janus_smem_session_claimed(janus_transport_session *transport, guint64 session_id) {
+	/* We don't care about this. We should start receiving messages from the core about this session: no action necessary */
+}
+
+json_t *janus_smem_query_transport(json_t *request) {
+	if(g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized)) {
+		return NULL;
+	}
+	/* We can use this request to dynamically change the behaviour of
+	 * the transport plugin, and/or query for some specific information */
+	json_t *response = json_object();
+	int error_code = 0;
+	char error_cause[512];
+	JANUS_VALIDATE_JSON_OBJECT(request, request_parameters,
+		error_code, error_cause, TRUE,
+		JANUS_SMEM_ERROR_MISSING_ELEMENT, JANUS_SMEM_ERROR_INVALID_ELEMENT);
+	if(error_code != 0)
+		goto plugin_response;
+	/* Get the request */
+	const char *request_text = json_string_value(json_object_get(request, "request"));
+	if(!strcasecmp(request_text, "configure")) {
+		/* We only allow for the configuration of some basic properties:
+		 * changing the ring size would require a new handshake with all
+		 * connected clients, so that can only be done via config file */
+		JANUS_VALIDATE_JSON_OBJECT(request, configure_parameters,
+			error_code, error_cause, TRUE,
+			JANUS_SMEM_ERROR_MISSING_ELEMENT, JANUS_SMEM_ERROR_INVALID_ELEMENT);
+		/* Check if we now need to send events to handlers */
+		json_object_set_new(response, "result", json_integer(200));
+		json_t *notes = NULL;
+		gboolean events = json_is_true(json_object_get(request, "events"));
+		if(events && !gateway->events_is_enabled()) {
+			/* Notify that this will be ignored */
+			notes = json_array();
+			json_array_append_new(notes, json_string("Event handlers disabled at the core level"));
+			json_object_set_new(response, "notes", notes);
+		}
+		if(events != notify_events) {
+			notify_events = events;
+			if(!notify_events && gateway->events_is_enabled()) {
+				JANUS_LOG(LOG_WARN, "Notification of events to handlers disabled for %s\n", JANUS_SMEM_NAME);
+			}
+		}
+		const char *indentation = json_string_value(json_object_get(request, "json"));
+		if(indentation != NULL) {
+			if(!strcasecmp(indentation, "indented")) {
+				json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
+			} else if(!strcasecmp(indentation, "plain")) {
+				/* Not indented and no new lines, but still readable */
+				json_format = JSON_INDENT(0) | JSON_PRESERVE_ORDER;
+			} else if(!strcasecmp(indentation, "compact")) {
+				/* Default: compact, so no spaces between separators */
+				json_format = JSON_COMPACT | JSON_PRESERVE_ORDER;
+			} else {
+				JANUS_LOG(LOG_WARN, "Unsupported JSON format option '%s', ignoring tweak\n", indentation);
+				/* Notify that this will be ignored */
+				if(notes == NULL) {
+					notes = json_array();
+					json_object_set_new(response, "notes", notes);
+				}
+				json_array_append_new(notes, json_string("Ignored unsupported indentation format"));
+			}
+		}
+	} else if(!strcasecmp(request_text, "connections")) {
+		/* Return the number of active connections currently handled by the plugin */
+		json_object_set_new(response, "result", json_integer(200));
+		janus_mutex_lock(&clients_mutex);
+		guint connections = g_hash_table_size(clients);
+		janus_mutex_unlock(&clients_mutex);
+		json_object_set_new(response, "connections", json_integer(connections));
+		json_object_set_new(response, "ring_size", json_integer(ring_size));
+	} else {
+		JANUS_LOG(LOG_VERB, "Unknown request '%s'\n", request_text);
+		error_code = JANUS_SMEM_ERROR_INVALID_REQUEST;
+		g_snprintf(error_cause, 512, "Unknown request '%s'", request_text);
+	}
+
+plugin_response:
+		{
+			if(error_code != 0) {
+				/* Prepare JSON error event */
+				json_object_set_new(response, "error_code", json_integer(error_code));
+				json_object_set_new(response, "error", json_string(error_cause));
+			}
+			return response;
+		}
+}
+
+
+/* Thread */
+void *janus_smem_thread(void *data) {
+	JANUS_LOG(LOG_INFO, "Shared memory thread started\n");
+
+	int fds = 0;
+	struct pollfd poll_fds[1024];	/* FIXME Should we allow for more clients? */
+	char buffer[64];
+
+	while(g_atomic_int_get(&initialized) && !g_atomic_int_get(&stopping)) {
+		/* Get rid of clients whose Janus session timed out in the core */
+		janus_mutex_lock(&clients_mutex);
+		GHashTableIter iter;
+		gpointer value;
+		g_hash_table_iter_init(&iter, clients_by_fd);
+		while(g_hash_table_iter_next(&iter, NULL, &value)) {
+			janus_smem_client *client = value;
+			if(client->session_timeout) {
+				JANUS_LOG(LOG_INFO, "Shared memory client session timed out (%d), closing\n", client->fd);
+				janus_smem_drop_client(client, FALSE);
+				/* The tables changed under us, restart the iteration */
+				g_hash_table_iter_init(&iter, clients_by_fd);
+			}
+		}
+		/* Prepare poll list of file descriptors */
+		fds = 0;
+		/* Wake-up monitor */
+		poll_fds[fds].fd = write_fd[0];
+		poll_fds[fds].events = POLLIN;
+		fds++;
+		if(pfd > -1) {
+			/* Janus API */
+			poll_fds[fds].fd = pfd;
+			poll_fds[fds].events = POLLIN;
+			fds++;
+		}
+		if(admin_pfd > -1) {
+			/* Admin API */
+			poll_fds[fds].fd = admin_pfd;
+			poll_fds[fds].events = POLLIN;
+			fds++;
+		}
+		/* Iterate on available clients: we poll both the bootstrap
+		 * socket (to detect disconnections) and the incoming eventfd;
+		 * before blocking we flag ourselves as waiting and re-check the
+		 * ring, to close the race with a producer that saw the flag
+		 * still unset right after publishing */
+		g_hash_table_iter_init(&iter, clients_by_fd);
+		while(g_hash_table_iter_next(&iter, NULL, &value)) {
+			janus_smem_client *client = value;
+			g_atomic_int_set(&client->in_ring->waiting, 1);
+			if(g_atomic_int_get(&client->in_ring->head) != g_atomic_int_get(&client->in_ring->tail)) {
+				/* More requests slipped in, make sure the eventfd fires */
+				guint64 one = 1;
+				int res = 0;
+				do {
+					res = write(client->in_efd, &one, sizeof(one));
+				} while(res == -1 && errno == EINTR);
+			}
+			poll_fds[fds].fd = client->fd;
+			poll_fds[fds].events = POLLIN;
+			fds++;
+			poll_fds[fds].fd = client->in_efd;
+			poll_fds[fds].events = POLLIN;
+			fds++;
+		}
+		janus_mutex_unlock(&clients_mutex);
+
+		/* Start polling */
+		int res = poll(poll_fds, fds, -1);
+		if(res == 0)
+			continue;
+		if(res < 0) {
+			if(errno == EINTR) {
+				JANUS_LOG(LOG_HUGE, "Got an EINTR (%s) polling the shared memory descriptors, ignoring...\n", g_strerror(errno));
+				continue;
+			}
+			JANUS_LOG(LOG_ERR, "poll() failed: %d (%s)\n", errno, g_strerror(errno));
+			break;
+		}
+		int i = 0;
+		for(i=0; i<fds; i++) {
+			if(poll_fds[i].revents & (POLLERR | POLLHUP)) {
+				if(poll_fds[i].fd == write_fd[0]) {
+					/* Error in the wake-up socketpair, that sucks: try recreating it */
+					JANUS_LOG(LOG_WARN, "Error polling wake-up socketpair: %s...\n",
+						poll_fds[i].revents & POLLERR ? "POLLERR" : "POLLHUP");
+					close(write_fd[0]);
+					write_fd[0] = -1;
+					close(write_fd[1]);
+					write_fd[1] = -1;
+					if(socketpair(PF_LOCAL, SOCK_STREAM, 0, write_fd) < 0) {
+						JANUS_LOG(LOG_FATAL, "Error creating socket pair for wake-up events: %d, %s\n", errno, g_strerror(errno));
+						continue;
+					}
+				} else if(poll_fds[i].fd == pfd) {
+					/* Error in the Janus API bootstrap socket */
+					JANUS_LOG(LOG_WARN, "Error polling shared memory Janus API interface (%s), disabling it\n",
+						poll_fds[i].revents & POLLERR ? "POLLERR" : "POLLHUP");
+					close(pfd);
+					pfd = -1;
+				} else if(poll_fds[i].fd == admin_pfd) {
+					/* Error in the Admin API bootstrap socket */
+					JANUS_LOG(LOG_WARN, "Error polling shared memory Admin API interface (%s), disabling it\n",
+						poll_fds[i].revents & POLLERR ? "POLLERR" : "POLLHUP");
+					close(admin_pfd);
+					admin_pfd = -1;
+				} else {
+					/* Error or hangup on a client descriptor: if it's the
+					 * bootstrap socket, the client went away */
+					janus_mutex_lock(&clients_mutex);
+					janus_smem_client *client = g_hash_table_lookup(clients_by_fd, GINT_TO_POINTER(poll_fds[i].fd));
+					if(client != NULL) {
+						JANUS_LOG(LOG_INFO, "Shared memory client disconnected (%d)\n", poll_fds[i].fd);
+						janus_smem_drop_client(client, TRUE);
+					}
+					janus_mutex_unlock(&clients_mutex);
+				}
+				continue;
+			}
+			if(poll_fds[i].revents & POLLIN) {
+				if(poll_fds[i].fd == write_fd[0]) {
+					/* Read and ignore: we use this to unlock the poll for housekeeping */
+					(void)read(poll_fds[i].fd, buffer, sizeof(buffer));
+				} else if(poll_fds[i].fd == pfd || poll_fds[i].fd == admin_pfd) {
+					/* New client: accept, allocate the segment and hand the descriptors over */
+					struct sockaddr_un address;
+					socklen_t addrlen = sizeof(address);
+					int cfd = accept(poll_fds[i].fd, (struct sockaddr *)&address, &addrlen);
+					if(cfd < 0)
+						continue;
+					JANUS_LOG(LOG_INFO, "Got new shared memory %s API client: %d\n",
+						poll_fds[i].fd == pfd ? "Janus" : "Admin", cfd);
+					/* Allocate new client */
+					janus_smem_client *client = g_malloc0(sizeof(janus_smem_client));
+					client->fd = cfd;
+					client->shm_fd = -1;
+					client->in_efd = -1;
+					client->out_efd = -1;
+					client->admin = (poll_fds[i].fd == admin_pfd);	/* API client type */
+					janus_mutex_init(&client->wmutex);
+					if(!janus_smem_setup_client(client)) {
+						/* Something went wrong allocating or sharing the
+						 * segment, get rid of this client right away */
+						shutdown(SHUT_RDWR, cfd);
+						close(cfd);
+						client->fd = -1;
+						janus_smem_client_free(client);
+						continue;
+					}
+					/* Create a transport instance as well */
+					client->ts = janus_transport_session_create(client, janus_smem_client_free);
+					/* Take note of this new client */
+					janus_mutex_lock(&clients_mutex);
+					g_hash_table_insert(clients_by_fd, GINT_TO_POINTER(cfd), client);
+					g_hash_table_insert(clients, client, client);
+					janus_mutex_unlock(&clients_mutex);
+					/* Notify handlers about this new transport */
+					if(notify_events && gateway->events_is_enabled()) {
+						json_t *info = json_object();
+						json_object_set_new(info, "event", json_string("connected"));
+						json_object_set_new(info, "admin_api", client->admin ? json_true() : json_false());
+						json_object_set_new(info, "fd", json_integer(client->fd));
+						gateway->notify_event(&janus_smem_transport, client->ts, info);
+					}
+				} else {
+					/* Client activity: either the eventfd fired, or
+					 * something arrived on the bootstrap socket */
+					janus_mutex_lock(&clients_mutex);
+					janus_smem_client *client = g_hash_table_lookup(clients_by_fd, GINT_TO_POINTER(poll_fds[i].fd));
+					if(client != NULL) {
+						/* Data on the bootstrap socket: clients shouldn't
+						 * send anything there after the handshake, so this
+						 * is either noise to drain or an orderly close */
+						res = recv(poll_fds[i].fd, buffer, sizeof(buffer), 0);
+						if(res == 0) {
+							JANUS_LOG(LOG_INFO, "Shared memory client disconnected (%d)\n", poll_fds[i].fd);
+							janus_smem_drop_client(client, TRUE);
+						}
+						janus_mutex_unlock(&clients_mutex);
+						continue;
+					}
+					/* Not a bootstrap socket, find the client by eventfd */
+					janus_smem_client *owner = NULL;
+					g_hash_table_iter_init(&iter, clients_by_fd);
+					while(g_hash_table_iter_next(&iter, NULL, &value)) {
+						client = value;
+						if(client->in_efd == poll_fds[i].fd) {
+							owner = client;
+							break;
+						}
+					}
+					if(owner == NULL) {
+						janus_mutex_unlock(&clients_mutex);
+						continue;
+					}
+					/* We're awake and draining, kicks are not needed until
+					 * we flag ourselves as waiting again before the poll */
+					g_atomic_int_set(&owner->in_ring->waiting, 0);
+					guint64 counter = 0;
+					(void)read(poll_fds[i].fd, &counter, sizeof(counter));
+					janus_transport_session *ts = owner->ts;
+					gboolean admin = owner->admin;
+					janus_refcount_increase(&ts->ref);
+					janus_mutex_unlock(&clients_mutex);
+					/* Drain the incoming ring: we're the only consumer,
+					 * so no lock is needed while reading */
+					char *payload = NULL;
+					while((payload = janus_smem_ring_read(owner->in_ring, owner->ring_size)) != NULL) {
+						JANUS_LOG(LOG_HUGE, "%s\n", payload);
+						/* Parse the JSON payload */
+						json_error_t error;
+						json_t *root = json_loads(payload, 0, &error);
+						g_free(payload);
+						/* Notify the core, passing both the object and, since it may be needed, the error */
+						gateway->incoming_request(&janus_smem_transport, ts, NULL, admin, root, &error);
+					}
+					janus_refcount_decrease(&ts->ref);
+				}
+			}
+		}
+	}
+
+	/* Get rid of the active clients */
+	janus_mutex_lock(&clients_mutex);
+	GHashTableIter iter;
+	gpointer value;
+	g_hash_table_iter_init(&iter, clients_by_fd);
+	while(g_hash_table_iter_next(&iter, NULL, &value)) {
+		janus_smem_client *client = value;
+		shutdown(SHUT_RDWR, client->fd);
+		close(client->fd);
+		client->fd = -1;
+		janus_transport_session_destroy(client->ts);
+	}
+	janus_mutex_unlock(&clients_mutex);
+
+	void *addr = g_malloc(sizeof(struct sockaddr_un)+1);
+	if(pfd > -1) {
+		socklen_t addrlen = sizeof(struct sockaddr_un);
+		/* Unlink the path name first */
+		if(getsockname(pfd, (struct sockaddr *)addr, &addrlen) != -1) {
+			JANUS_LOG(LOG_INFO, "Unlinking %s\n", ((struct sockaddr_un *)addr)->sun_path);
+			unlink(((struct sockaddr_un *)addr)->sun_path);
+		}
+		/* Close the socket */
+		close(pfd);
+	}
+	pfd = -1;
+	if(admin_pfd > -1) {
+		socklen_t addrlen = sizeof(struct sockaddr_un);
+		/* Unlink the path name first */
+		if(getsockname(admin_pfd, (struct sockaddr *)addr, &addrlen) != -1) {
+			JANUS_LOG(LOG_INFO, "Unlinking %s\n", ((struct sockaddr_un *)addr)->sun_path);
+			unlink(((struct sockaddr_un *)addr)->sun_path);
+		}
+		/* Close the socket */
+		close(admin_pfd);
+	}
+	admin_pfd = -1;
+	g_free(addr);
+
+	g_hash_table_destroy(clients_by_fd);
+	g_hash_table_destroy(clients);
+
+	/* Done */
+	JANUS_LOG(LOG_INFO, "Shared memory thread ended\n");
+	return NULL;
+}
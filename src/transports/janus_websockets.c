@@ -174,7 +174,8 @@ static void janus_websockets_log_emit_function(int level, const char *line) {
 }
 
 /* WebSockets service thread */
-static GThread *ws_thread = NULL;
+static GThread **ws_threads = NULL;
+static int ws_threads_count = 1;
 void *janus_websockets_thread(void *data);
 
 
@@ -584,6 +585,24 @@ int janus_websockets_init(janus_transport_callbacks *callback, const char *confi
 			JANUS_LOG(LOG_WARN, "Notification of events to handlers disabled for %s\n", JANUS_WEBSOCKETS_NAME);
 		}
 
+		/* Check how many threads should service the WebSockets servers:
+		 * by default we use a single thread, but deployments with many
+		 * clients can spread them across more (libwebsockets takes care
+		 * of distributing new connections among the service threads) */
+		item = janus_config_get(config, config_general, janus_config_type_item, "threads");
+		if(item && item->value) {
+			ws_threads_count = atoi(item->value);
+			if(ws_threads_count < 1) {
+				JANUS_LOG(LOG_WARN, "Invalid value for threads (%s), using a single service thread\n", item->value);
+				ws_threads_count = 1;
+			} else if(ws_threads_count > LWS_MAX_SMP) {
+				/* The libwebsockets build caps how many service threads a context can have */
+				JANUS_LOG(LOG_WARN, "Value for threads (%d) is larger than this libwebsockets build supports, capping to %d\n",
+					ws_threads_count, LWS_MAX_SMP);
+				ws_threads_count = LWS_MAX_SMP;
+			}
+		}
+
 		item = janus_config_get(config, config_general, janus_config_type_item, "ws_logging");
 		if(item && item->value) {
 			/* libwebsockets uses a mask to set log levels, as documented here:
@@ -737,8 +756,8 @@ int janus_websockets_init(janus_transport_callbacks *callback, const char *confi
 		}
 #endif
 #endif
-		/* Force single-thread server */
-		wscinfo.count_threads = 1;
+		/* Configure how many threads will service this context */
+		wscinfo.count_threads = ws_threads_count;
 
 		/* Create the base context */
 		wsc = lws_create_context(&wscinfo);
@@ -778,15 +797,21 @@ int janus_websockets_init(janus_transport_callbacks *callback, const char *confi
 	g_atomic_int_set(&initialized, 1);
 
 	GError *error = NULL;
-	/* Start the WebSocket service thread */
+	/* Start the WebSocket service thread(s) */
 	if(ws_janus_api_enabled || ws_admin_api_enabled) {
-		ws_thread = g_thread_try_new("ws thread", &janus_websockets_thread, wsc, &error);
-		if(error != NULL) {
-			g_atomic_int_set(&initialized, 0);
-			JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the WebSockets thread...\n",
-				error->code, error->message ? error->message : "??");
-			g_error_free(error);
-			return -1;
+		ws_threads = g_malloc0(ws_threads_count * sizeof(GThread *));
+		char tname[16];
+		int i = 0;
+		for(i=0; i<ws_threads_count; i++) {
+			g_snprintf(tname, sizeof(tname), "ws thread %d", i);
+			ws_threads[i] = g_thread_try_new(tname, &janus_websockets_thread, GINT_TO_POINTER(i), &error);
+			if(error != NULL) {
+				g_atomic_int_set(&initialized, 0);
+				JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the WebSockets thread...\n",
+					error->code, error->message ? error->message : "??");
+				g_error_free(error);
+				return -1;
+			}
 		}
 	}
 
@@ -803,10 +828,15 @@ void janus_websockets_destroy(void) {
 	lws_cancel_service(wsc);
 #endif
 
-	/* Stop the service thread */
-	if(ws_thread != NULL) {
-		g_thread_join(ws_thread);
-		ws_thread = NULL;
+	/* Stop the service thread(s) */
+	if(ws_threads != NULL) {
+		int i = 0;
+		for(i=0; i<ws_threads_count; i++) {
+			if(ws_threads[i] != NULL)
+				g_thread_join(ws_threads[i]);
+		}
+		g_free(ws_threads);
+		ws_threads = NULL;
 	}
 
 	/* Destroy the context */
@@ -922,18 +952,20 @@ int janus_websockets_send_message(janus_transport_session *transport, void *requ
 		json_decref(message);
 		return -1;
 	}
-	janus_mutex_lock(&transport->mutex);
-	janus_websockets_client *client = (janus_websockets_client *)transport->transport_p;
-	if(!client || !client->wsi || g_atomic_int_get(&client->destroyed)) {
-		json_decref(message);
-		janus_mutex_unlock(&transport->mutex);
-		return -1;
-	}
-	/* Convert to string and enqueue */
+	/* Convert to string before grabbing the client mutex: serialization is
+	 * the expensive part, and keeping it out of the critical section means
+	 * concurrent senders to different clients don't line up behind it */
 	char *payload = json_dumps(message, json_format);
 	if(payload == NULL) {
 		JANUS_LOG(LOG_ERR, "Failed to stringify message...\n");
 		json_decref(message);
+		return -1;
+	}
+	janus_mutex_lock(&transport->mutex);
+	janus_websockets_client *client = (janus_websockets_client *)transport->transport_p;
+	if(!client || !client->wsi || g_atomic_int_get(&client->destroyed)) {
+		free(payload);
+		json_decref(message);
 		janus_mutex_unlock(&transport->mutex);
 		return -1;
 	}
@@ -1106,23 +1138,25 @@ plugin_response:
 
 /* Thread */
 void *janus_websockets_thread(void *data) {
-	struct lws_context *service = (struct lws_context *)data;
+	int tsi = GPOINTER_TO_INT(data);
+	struct lws_context *service = wsc;
 	if(service == NULL) {
 		JANUS_LOG(LOG_ERR, "Invalid service\n");
 		return NULL;
 	}
 
-	JANUS_LOG(LOG_INFO, "WebSockets thread started\n");
+	JANUS_LOG(LOG_INFO, "WebSockets thread started (#%d)\n", tsi);
 
 	while(g_atomic_int_get(&initialized) && !g_atomic_int_get(&stopping)) {
-		/* libwebsockets is single thread, we cycle through events here */
-		lws_service(service, 50);
+		/* Cycle through the events of the connections this thread services */
+		lws_service_tsi(service, 50, tsi);
 	}
 
 	/* Get rid of the WebSockets server */
-	lws_cancel_service(service);
+	if(tsi == 0)
+		lws_cancel_service(service);
 	/* Done */
-	JANUS_LOG(LOG_INFO, "WebSockets thread ended\n");
+	JANUS_LOG(LOG_INFO, "WebSockets thread ended (#%d)\n", tsi);
 	return NULL;
 }
 
@@ -1414,85 +1448,86 @@ static int janus_websockets_common_callback(
 			if(!g_atomic_int_get(&ws_client->destroyed) && !g_atomic_int_get(&stopping)) {
 				janus_mutex_lock(&ws_client->ts->mutex);
 
-				/* Check if Websockets send pipe is choked */
-				if(lws_send_pipe_choked(wsi)) {
-					if(ws_client->buffer && ws_client->bufpending > 0 && ws_client->bufoffset > 0) {
-						JANUS_LOG(LOG_WARN, "Websockets choked with buffer: %zu, trying again\n", ws_client->bufpending);
-						lws_callback_on_writable(wsi);
-					} else {
-						gint qlen = g_async_queue_length(ws_client->messages);
-						JANUS_LOG(LOG_WARN, "Websockets choked with queue: %d, trying again\n", qlen);
-						if(qlen > 0) {
+				/* Drain as much of the backlog as the socket allows in this
+				 * round, rather than writing a single chunk per POLLOUT
+				 * event: with many messages queued (e.g., when an event is
+				 * broadcast to a lot of subscribers), one event loop round
+				 * trip per message adds up quickly */
+				while(TRUE) {
+					/* Check if Websockets send pipe is choked */
+					if(lws_send_pipe_choked(wsi)) {
+						if(ws_client->buffer && ws_client->bufpending > 0 && ws_client->bufoffset > 0) {
+							JANUS_LOG(LOG_WARN, "Websockets choked with buffer: %zu, trying again\n", ws_client->bufpending);
 							lws_callback_on_writable(wsi);
+						} else {
+							gint qlen = g_async_queue_length(ws_client->messages);
+							JANUS_LOG(LOG_WARN, "Websockets choked with queue: %d, trying again\n", qlen);
+							if(qlen > 0) {
+								lws_callback_on_writable(wsi);
+							}
 						}
+						break;
 					}
-					janus_mutex_unlock(&ws_client->ts->mutex);
-					return 0;
-				}
 
-				/* Check if we have a pending/partial write to complete first */
-				if(ws_client->buffer && ws_client->bufpending > 0 && ws_client->bufoffset > 0) {
-					JANUS_LOG(LOG_HUGE, "[%s-%p] Completing pending WebSocket write (still need to write last %zu bytes)...\n",
-						log_prefix, wsi, ws_client->bufpending);
-				} else {
-					/* Shoot all the pending messages */
-					char *response = g_async_queue_try_pop(ws_client->messages);
-					if (!response) {
-						/* No messages found */
-						janus_mutex_unlock(&ws_client->ts->mutex);
-						return 0;
-					}
-					if (g_atomic_int_get(&ws_client->destroyed) || g_atomic_int_get(&stopping)) {
+					/* Check if we have a pending/partial write to complete first */
+					if(ws_client->buffer && ws_client->bufpending > 0 && ws_client->bufoffset > 0) {
+						JANUS_LOG(LOG_HUGE, "[%s-%p] Completing pending WebSocket write (still need to write last %zu bytes)...\n",
+							log_prefix, wsi, ws_client->bufpending);
+					} else {
+						/* Shoot all the pending messages */
+						char *response = g_async_queue_try_pop(ws_client->messages);
+						if (!response) {
+							/* No messages found */
+							break;
+						}
+						if (g_atomic_int_get(&ws_client->destroyed) || g_atomic_int_get(&stopping)) {
+							free(response);
+							break;
+						}
+						/* Gotcha! */
+						JANUS_LOG(LOG_HUGE, "[%s-%p] Sending WebSocket message (%zu bytes)...\n", log_prefix, wsi, strlen(response));
+						size_t buflen = LWS_PRE + strlen(response);
+						if (buflen > ws_client->buflen) {
+							/* We need a larger shared buffer */
+							JANUS_LOG(LOG_HUGE, "[%s-%p] Re-allocating to %zu bytes (was %zu, response is %zu bytes)\n", log_prefix, wsi, buflen, ws_client->buflen, strlen(response));
+							ws_client->buflen = buflen;
+							ws_client->buffer = g_realloc(ws_client->buffer, buflen);
+						}
+						memcpy(ws_client->buffer + LWS_PRE, response, strlen(response));
+						/* Initialize pending bytes count and buffer offset */
+						ws_client->bufpending = strlen(response);
+						ws_client->bufoffset = LWS_PRE;
+						/* We can get rid of the message */
 						free(response);
-						janus_mutex_unlock(&ws_client->ts->mutex);
-						return 0;
-					}
-					/* Gotcha! */
-					JANUS_LOG(LOG_HUGE, "[%s-%p] Sending WebSocket message (%zu bytes)...\n", log_prefix, wsi, strlen(response));
-					size_t buflen = LWS_PRE + strlen(response);
-					if (buflen > ws_client->buflen) {
-						/* We need a larger shared buffer */
-						JANUS_LOG(LOG_HUGE, "[%s-%p] Re-allocating to %zu bytes (was %zu, response is %zu bytes)\n", log_prefix, wsi, buflen, ws_client->buflen, strlen(response));
-						ws_client->buflen = buflen;
-						ws_client->buffer = g_realloc(ws_client->buffer, buflen);
 					}
-					memcpy(ws_client->buffer + LWS_PRE, response, strlen(response));
-					/* Initialize pending bytes count and buffer offset */
-					ws_client->bufpending = strlen(response);
-					ws_client->bufoffset = LWS_PRE;
-					/* We can get rid of the message */
-					free(response);
-				}
 
-				if (g_atomic_int_get(&ws_client->destroyed) || g_atomic_int_get(&stopping)) {
-					janus_mutex_unlock(&ws_client->ts->mutex);
-					return 0;
-				}
+					if (g_atomic_int_get(&ws_client->destroyed) || g_atomic_int_get(&stopping)) {
+						break;
+					}
 
-				/* Evaluate amount of data to send according to MESSAGE_CHUNK_SIZE */
-				int amount = ws_client->bufpending <= MESSAGE_CHUNK_SIZE ? ws_client->bufpending : MESSAGE_CHUNK_SIZE;
-				/* Set fragment flags */
-				int flags = lws_write_ws_flags(LWS_WRITE_TEXT, ws_client->bufoffset == LWS_PRE, ws_client->bufpending <= (size_t)amount);
-				/* Send the fragment with proper flags */
-				int sent = lws_write(wsi, ws_client->buffer + ws_client->bufoffset, (size_t)amount, flags);
-				JANUS_LOG(LOG_HUGE, "[%s-%p]   -- First=%d, Last=%d, Requested=%d bytes, Sent=%d bytes, Missing=%zu bytes\n", log_prefix, wsi, ws_client->bufoffset <= LWS_PRE, ws_client->bufpending <= (size_t)amount, amount, sent, ws_client->bufpending - amount);
-				if(sent < amount) {
-					/* Error on sending, abort operation */
-					JANUS_LOG(LOG_ERR, "Websocket sent only %d bytes (expected %d)\n", sent, amount);
-					ws_client->bufpending = 0;
-					ws_client->bufoffset = 0;
-				} else {
-					/* Fragment successfully sent, update status */
-					ws_client->bufpending -= amount;
-					ws_client->bufoffset += amount;
-					if(ws_client->bufpending > 0) {
-						/* We couldn't send everything in a single write, we'll complete this in the next round */
-						JANUS_LOG(LOG_HUGE, "[%s-%p]   -- Couldn't write all bytes (%zu missing), setting offset %zu\n",
-							log_prefix, wsi, ws_client->bufpending, ws_client->bufoffset);
+					/* Evaluate amount of data to send according to MESSAGE_CHUNK_SIZE */
+					int amount = ws_client->bufpending <= MESSAGE_CHUNK_SIZE ? ws_client->bufpending : MESSAGE_CHUNK_SIZE;
+					/* Set fragment flags */
+					int flags = lws_write_ws_flags(LWS_WRITE_TEXT, ws_client->bufoffset == LWS_PRE, ws_client->bufpending <= (size_t)amount);
+					/* Send the fragment with proper flags */
+					int sent = lws_write(wsi, ws_client->buffer + ws_client->bufoffset, (size_t)amount, flags);
+					JANUS_LOG(LOG_HUGE, "[%s-%p]   -- First=%d, Last=%d, Requested=%d bytes, Sent=%d bytes, Missing=%zu bytes\n", log_prefix, wsi, ws_client->bufoffset <= LWS_PRE, ws_client->bufpending <= (size_t)amount, amount, sent, ws_client->bufpending - amount);
+					if(sent < amount) {
+						/* Error on sending, abort operation */
+						JANUS_LOG(LOG_ERR, "Websocket sent only %d bytes (expected %d)\n", sent, amount);
+						ws_client->bufpending = 0;
+						ws_client->bufoffset = 0;
+					} else {
+						/* Fragment successfully sent, update status */
+						ws_client->bufpending -= amount;
+						ws_client->bufoffset += amount;
+						if(ws_client->bufpending > 0) {
+							/* We couldn't send everything in a single write, we'll complete this in the next round */
+							JANUS_LOG(LOG_HUGE, "[%s-%p]   -- Couldn't write all bytes (%zu missing), setting offset %zu\n",
+								log_prefix, wsi, ws_client->bufpending, ws_client->bufoffset);
+						}
 					}
 				}
-				/* Done for this round, check the next response/notification later */
-				lws_callback_on_writable(wsi);
 				janus_mutex_unlock(&ws_client->ts->mutex);
 				return 0;
 			}
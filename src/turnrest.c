@@ -24,6 +24,7 @@
 
 #include "turnrest.h"
 #include "debug.h"
+#include "metrics.h"
 #include "mutex.h"
 #include "ip-utils.h"
 #include "utils.h"
@@ -34,6 +35,47 @@ static gboolean api_http_get = FALSE;
 static uint api_timeout;
 static janus_mutex api_mutex = JANUS_MUTEX_INITIALIZER;
 
+/* Credentials returned by the backend are valid for their whole TTL, so
+ * there's no reason to pay an HTTP round trip (plus DNS resolution of the
+ * TURN URIs) on every single PeerConnection: we cache responses per user
+ * for a fraction of their TTL, so that mass reconnects reuse the cached
+ * credentials instead of hammering the backend with an identical request
+ * per handle; allocations made with cached credentials outlive the TTL
+ * anyway, as TURN refreshes are authenticated when they're issued */
+typedef struct janus_turnrest_cache_entry {
+	janus_turnrest_response *response;
+	gint64 expires;
+} janus_turnrest_cache_entry;
+static GHashTable *api_cache = NULL;
+
+static void janus_turnrest_cache_entry_destroy(gpointer data) {
+	janus_turnrest_cache_entry *entry = (janus_turnrest_cache_entry *)data;
+	if(entry == NULL)
+		return;
+	janus_turnrest_response_destroy(entry->response);
+	g_free(entry);
+}
+
+/* Deep copy of a response, since callers destroy the instance they get */
+static janus_turnrest_response *janus_turnrest_response_clone(janus_turnrest_response *response) {
+	janus_turnrest_response *copy = g_malloc(sizeof(janus_turnrest_response));
+	copy->username = g_strdup(response->username);
+	copy->password = g_strdup(response->password);
+	copy->ttl = response->ttl;
+	copy->servers = NULL;
+	GList *server = response->servers;
+	while(server != NULL) {
+		janus_turnrest_instance *instance = (janus_turnrest_instance *)server->data;
+		janus_turnrest_instance *instance_copy = g_malloc(sizeof(janus_turnrest_instance));
+		instance_copy->server = g_strdup(instance->server);
+		instance_copy->port = instance->port;
+		instance_copy->transport = instance->transport;
+		copy->servers = g_list_append(copy->servers, instance_copy);
+		server = server->next;
+	}
+	return copy;
+}
+
 
 /* Buffer we use to receive the response via libcurl */
 typedef struct janus_turnrest_buffer {
@@ -67,17 +109,26 @@ void janus_turnrest_deinit(void) {
 	janus_mutex_lock(&api_mutex);
 	g_free((char *)api_server);
 	g_free((char *)api_key);
+	if(api_cache != NULL) {
+		g_hash_table_destroy(api_cache);
+		api_cache = NULL;
+	}
 	janus_mutex_unlock(&api_mutex);
 }
 
 void janus_turnrest_set_backend(const char *server, const char *key, const char *method, const uint timeout) {
 	janus_mutex_lock(&api_mutex);
 
-	/* Get rid of the old values first */
+	/* Get rid of the old values first (cached credentials included,
+	 * as they may refer to a different backend) */
 	g_free((char *)api_server);
 	api_server = NULL;
 	g_free((char *)api_key);
 	api_key = NULL;
+	if(api_cache != NULL) {
+		g_hash_table_destroy(api_cache);
+		api_cache = NULL;
+	}
 
 	if(server != NULL) {
 		/* Set a new server now */
@@ -95,6 +146,8 @@ void janus_turnrest_set_backend(const char *server, const char *key, const char
 			}
 		}
 		api_timeout = timeout;
+		api_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+			(GDestroyNotify)g_free, (GDestroyNotify)janus_turnrest_cache_entry_destroy);
 	}
 	janus_mutex_unlock(&api_mutex);
 }
@@ -126,7 +179,23 @@ janus_turnrest_response *janus_turnrest_request(const char *user) {
 		janus_mutex_unlock(&api_mutex);
 		return NULL;
 	}
+	/* Check if we have valid cached credentials for this user first */
+	if(api_cache != NULL && user != NULL) {
+		janus_turnrest_cache_entry *entry = g_hash_table_lookup(api_cache, user);
+		if(entry != NULL) {
+			if(janus_get_monotonic_time() < entry->expires) {
+				janus_turnrest_response *response = janus_turnrest_response_clone(entry->response);
+				janus_mutex_unlock(&api_mutex);
+				JANUS_LOG(LOG_VERB, "Reusing cached TURN REST API credentials for '%s'\n", user);
+				janus_metrics_account_turnrest(TRUE, 0);
+				return response;
+			}
+			/* Expired, get rid of it and ask the backend again */
+			g_hash_table_remove(api_cache, user);
+		}
+	}
 	/* Prepare the libcurl context */
+	gint64 started = janus_get_monotonic_time();
 	CURLcode res;
 	CURL *curl = curl_easy_init();
 	if(curl == NULL) {
@@ -296,6 +365,21 @@ janus_turnrest_response *janus_turnrest_request(const char *user) {
 		janus_turnrest_response_destroy(response);
 		return NULL;
 	}
+	gint64 latency = janus_get_monotonic_time() - started;
+	JANUS_LOG(LOG_VERB, "TURN REST API request took %"SCNi64" us\n", latency);
+	janus_metrics_account_turnrest(FALSE, (gsize)latency);
+	/* Cache the credentials for half their TTL, so that a burst of new
+	 * PeerConnections for the same user only costs one backend request */
+	if(user != NULL && response->ttl > 0) {
+		janus_mutex_lock(&api_mutex);
+		if(api_cache != NULL) {
+			janus_turnrest_cache_entry *entry = g_malloc(sizeof(janus_turnrest_cache_entry));
+			entry->response = janus_turnrest_response_clone(response);
+			entry->expires = janus_get_monotonic_time() + ((gint64)response->ttl/2)*G_USEC_PER_SEC;
+			g_hash_table_replace(api_cache, g_strdup(user), entry);
+		}
+		janus_mutex_unlock(&api_mutex);
+	}
 	/* Done */
 	return response;
 }
@@ -66,7 +66,9 @@ void janus_turnrest_response_destroy(janus_turnrest_response *response);
 
 
 /*! \brief Retrieve address and credentials for one or more TURN servers
- * @note Use janus_turnrest_response_destroy to get rid of the response, once done
+ * @note Use janus_turnrest_response_destroy to get rid of the response, once done.
+ * Responses are cached per user for a fraction of their TTL, so repeated
+ * requests (e.g., a burst of new PeerConnections) don't all hit the backend
  * @param[in] user Username to provide in the TURN REST API request
  * @returns A valid janus_turnrest_response instance, if successful, NULL otherwise */
 janus_turnrest_response *janus_turnrest_request(const char *user);
@@ -684,6 +684,55 @@ gboolean janus_json_is_valid(json_t *val, json_type jtype, unsigned int flags) {
 	return is_valid;
 }
 
+int janus_json_validate_object_capture(json_t *obj, const struct janus_json_parameter *params, size_t num,
+		json_t **captured, const char **error_name, char *type_name) {
+	if(obj == NULL || params == NULL || num == 0)
+		return 0;
+	/* Walk the object once, matching each key against the parameter table: for
+	 * the small tables we use everywhere this avoids a hash lookup per parameter */
+	json_t *local[64];
+	gboolean single_walk = (captured != NULL || num <= sizeof(local)/sizeof(local[0]));
+	json_t **values = captured ? captured : local;
+	if(single_walk) {
+		memset(values, 0, num*sizeof(json_t *));
+		const char *key = NULL;
+		json_t *value = NULL;
+		json_object_foreach(obj, key, value) {
+			size_t i = 0;
+			for(i = 0; i < num; i++) {
+				if(values[i] == NULL && !strcmp(key, params[i].name)) {
+					values[i] = value;
+					break;
+				}
+			}
+		}
+	}
+	/* Now check the parameters in the order they're declared in, so that
+	 * the error we report is the same the per-parameter lookups would give */
+	size_t i = 0;
+	for(i = 0; i < num; i++) {
+		json_t *val = single_walk ? values[i] : json_object_get(obj, params[i].name);
+		if(val == NULL) {
+			if((params[i].flags & JANUS_JSON_PARAM_REQUIRED) != 0) {
+				*error_name = params[i].name;
+				return 1;
+			}
+			continue;
+		}
+		if(!janus_json_is_valid(val, params[i].jtype, params[i].flags)) {
+			*error_name = params[i].name;
+			janus_get_json_type_name(params[i].jtype, params[i].flags, type_name);
+			return 2;
+		}
+	}
+	return 0;
+}
+
+int janus_json_validate_object(json_t *obj, const struct janus_json_parameter *params, size_t num,
+		const char **error_name, char *type_name) {
+	return janus_json_validate_object_capture(obj, params, num, NULL, error_name, type_name);
+}
+
 /* The following code is more related to codec specific helpers */
 #if defined(__ppc__) || defined(__ppc64__)
 	# define swap2(d)  \
@@ -1407,6 +1456,16 @@ uint32_t janus_bitstream_getbits(uint8_t *base, uint8_t num, uint32_t *offset) {
 	return res;
 }
 
+json_t *janus_json_immortal_string(const char *text) {
+	json_t *s = json_string(text);
+	if(s != NULL) {
+		/* Setting the reference count to -1 marks the value as immortal
+		 * to Jansson, the same way json_true() and json_null() are */
+		s->refcount = (size_t)-1;
+	}
+	return s;
+}
+
 #ifndef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
 size_t janus_gzip_compress(int compression, char *text, size_t tlen, char *compressed, size_t zlen) {
 	if(text == NULL || tlen < 1 || compressed == NULL || zlen < 1)
@@ -1445,4 +1504,70 @@ size_t janus_gzip_compress(int compression, char *text, size_t tlen, char *compr
 	/* Done, return the size of the compressed data */
 	return zs.total_out;
 }
+
+struct janus_gzip_context {
+	/* The deflate state we keep reusing */
+	z_stream zs;
+	/* Compression factor the state is currently configured for */
+	int compression;
+};
+
+janus_gzip_context *janus_gzip_context_create(int compression) {
+	if(compression < 0 || compression > 9) {
+		JANUS_LOG(LOG_WARN, "Invalid compression factor %d, falling back to default compression...\n", compression);
+		compression = Z_DEFAULT_COMPRESSION;
+	}
+	janus_gzip_context *ctx = g_malloc0(sizeof(janus_gzip_context));
+	ctx->compression = compression;
+	ctx->zs.zalloc = Z_NULL;
+	ctx->zs.zfree = Z_NULL;
+	ctx->zs.opaque = Z_NULL;
+	/* Initialize the deflater, and clarify we need gzip */
+	int res = deflateInit2(&ctx->zs, compression, Z_DEFLATED, 15 | 16, 8, Z_DEFAULT_STRATEGY);
+	if(res != Z_OK) {
+		JANUS_LOG(LOG_ERR, "deflateInit error: %d\n", res);
+		g_free(ctx);
+		return NULL;
+	}
+	return ctx;
+}
+
+size_t janus_gzip_context_compress(janus_gzip_context *ctx, int compression, char *text, size_t tlen, char *compressed, size_t zlen) {
+	if(ctx == NULL || text == NULL || tlen < 1 || compressed == NULL || zlen < 1)
+		return 0;
+	/* Reset the existing state, rather than creating a new one */
+	int res = deflateReset(&ctx->zs);
+	if(res != Z_OK) {
+		JANUS_LOG(LOG_ERR, "deflateReset error: %d\n", res);
+		return 0;
+	}
+	if(compression >= 0 && compression <= 9 && compression != ctx->compression) {
+		/* The compression factor was changed in the meanwhile, update the state */
+		res = deflateParams(&ctx->zs, compression, Z_DEFAULT_STRATEGY);
+		if(res != Z_OK) {
+			JANUS_LOG(LOG_ERR, "deflateParams error: %d\n", res);
+			return 0;
+		}
+		ctx->compression = compression;
+	}
+	ctx->zs.next_in = (Bytef *)text;
+	ctx->zs.avail_in = (uInt)tlen;
+	ctx->zs.next_out = (Bytef *)compressed;
+	ctx->zs.avail_out = (uInt)zlen;
+	/* Deflate the string */
+	res = deflate(&ctx->zs, Z_FINISH);
+	if(res != Z_STREAM_END) {
+		JANUS_LOG(LOG_ERR, "deflate error: %d\n", res);
+		return 0;
+	}
+	/* Done, return the size of the compressed data */
+	return ctx->zs.total_out;
+}
+
+void janus_gzip_context_destroy(janus_gzip_context *ctx) {
+	if(ctx == NULL)
+		return;
+	deflateEnd(&ctx->zs);
+	g_free(ctx);
+}
 #endif
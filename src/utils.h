@@ -244,6 +244,32 @@ void janus_get_json_type_name(int jtype, unsigned int flags, char *type_name);
  * @returns TRUE if the value is valid */
 gboolean janus_json_is_valid(json_t *val, json_type jtype, unsigned int flags);
 
+/*! \brief Validates the JSON object against an array of parameter descriptions with
+ * a single walk of the object, rather than a hash lookup per parameter
+ * @param obj The JSON object to be validated
+ * @param params Array of struct janus_json_parameter to describe the parameters
+ * @param num Number of entries in the params array
+ * @param[out] error_name The name of the offending parameter, in case of errors
+ * @param[out] type_name The expected type description, in case of invalid parameters; required size is 19 characters
+ * @returns 0 if the object is valid, 1 if a required parameter is missing, 2 if a parameter has an invalid value */
+int janus_json_validate_object(json_t *obj, const struct janus_json_parameter *params, size_t num,
+	const char **error_name, char *type_name);
+
+/*! \brief Same as janus_json_validate_object, but also captures a view of the
+ * validated fields: after a successful validation, captured[i] holds a borrowed
+ * reference to the value of params[i] (NULL if the optional parameter was
+ * absent), so handlers can access fields by position instead of repeating
+ * json_object_get lookups for every field they need
+ * @param obj The JSON object to be validated
+ * @param params Array of struct janus_json_parameter to describe the parameters
+ * @param num Number of entries in the params array
+ * @param[out] captured Array of at least num json_t pointers to fill with the matched values (borrowed references)
+ * @param[out] error_name The name of the offending parameter, in case of errors
+ * @param[out] type_name The expected type description, in case of invalid parameters; required size is 19 characters
+ * @returns 0 if the object is valid, 1 if a required parameter is missing, 2 if a parameter has an invalid value */
+int janus_json_validate_object_capture(json_t *obj, const struct janus_json_parameter *params, size_t num,
+	json_t **captured, const char **error_name, char *type_name);
+
 /*! \brief Validates the JSON object against the description of its parameters
  * @param missing_format printf format to indicate a missing required parameter; needs one %s for the parameter name
  * @param invalid_format printf format to indicate an invalid parameter; needs two %s for parameter name and type description from janus_get_json_type_name
@@ -257,30 +283,22 @@ gboolean janus_json_is_valid(json_t *val, json_type jtype, unsigned int flags);
 #define JANUS_VALIDATE_JSON_OBJECT_FORMAT(missing_format, invalid_format, obj, params, error_code, error_cause, log_error, missing_code, invalid_code) \
 	do { \
 		error_code = 0; \
-		unsigned int i; \
-		for(i = 0; i < sizeof(params) / sizeof(struct janus_json_parameter); i++) { \
-			json_t *val = json_object_get(obj, params[i].name); \
-			if(!val) { \
-				if((params[i].flags & JANUS_JSON_PARAM_REQUIRED) != 0) {	\
-					error_code = (missing_code); \
-					if(log_error) \
-						JANUS_LOG(LOG_ERR, missing_format "\n", params[i].name); \
-					if(error_cause != NULL) \
-						g_snprintf(error_cause, sizeof(error_cause), missing_format, params[i].name); \
-					break; \
-				} \
-				continue; \
-			} \
-			if(!janus_json_is_valid(val, params[i].jtype, params[i].flags)) { \
-				error_code = (invalid_code); \
-				char type_name[20]; \
-				janus_get_json_type_name(params[i].jtype, params[i].flags, type_name); \
-				if(log_error) \
-					JANUS_LOG(LOG_ERR, invalid_format "\n", params[i].name, type_name); \
-				if(error_cause != NULL) \
-					g_snprintf(error_cause, sizeof(error_cause), invalid_format, params[i].name, type_name); \
-				break; \
-			} \
+		const char *failed_param = NULL; \
+		char type_name[20]; \
+		int validation = janus_json_validate_object(obj, params, \
+			sizeof(params) / sizeof(struct janus_json_parameter), &failed_param, type_name); \
+		if(validation == 1) { \
+			error_code = (missing_code); \
+			if(log_error) \
+				JANUS_LOG(LOG_ERR, missing_format "\n", failed_param); \
+			if(error_cause != NULL) \
+				g_snprintf(error_cause, sizeof(error_cause), missing_format, failed_param); \
+		} else if(validation == 2) { \
+			error_code = (invalid_code); \
+			if(log_error) \
+				JANUS_LOG(LOG_ERR, invalid_format "\n", failed_param, type_name); \
+			if(error_cause != NULL) \
+				g_snprintf(error_cause, sizeof(error_cause), invalid_format, failed_param, type_name); \
 		} \
 	} while(0)
 
@@ -295,6 +313,42 @@ gboolean janus_json_is_valid(json_t *val, json_type jtype, unsigned int flags);
 #define JANUS_VALIDATE_JSON_OBJECT(obj, params, error_code, error_cause, log_error, missing_code, invalid_code) \
 	JANUS_VALIDATE_JSON_OBJECT_FORMAT("Missing mandatory element (%s)", "Invalid element type (%s should be %s)", obj, params, error_code, error_cause, log_error, missing_code, invalid_code)
 
+/*! \brief Validates the JSON object against the description of its parameters, and
+ * captures a positional view of the validated fields in the provided array, so
+ * that handlers don't have to repeat json_object_get lookups for each field: the
+ * array entries are aligned with the parameter table (borrowed references, NULL
+ * for optional parameters that weren't there), and handlers typically address
+ * them through an enum matching the table order
+ * @param obj The JSON object to be validated
+ * @param params Array of struct janus_json_parameter to describe the parameters; the array has to be a global or stack variable to make sizeof work
+ * @param[out] values Array of at least as many json_t pointers as the params table to fill in
+ * @param[out] error_code int to return error code
+ * @param[out] error_cause Array of char or NULL to return the error descriptions; the array has to be a global or stack variable to make sizeof work; the required size is the length of the longest parameter name plus 54 for the format string and type description
+ * @param log_error If TRUE, log any error with JANUS_LOG(LOG_ERR)
+ * @param missing_code The code to be returned in error_code if a parameter is missing
+ * @param invalid_code The code to be returned in error_code if a parameter is invalid */
+#define JANUS_VALIDATE_JSON_OBJECT_CAPTURE(obj, params, values, error_code, error_cause, log_error, missing_code, invalid_code) \
+	do { \
+		error_code = 0; \
+		const char *failed_param = NULL; \
+		char type_name[20]; \
+		int validation = janus_json_validate_object_capture(obj, params, \
+			sizeof(params) / sizeof(struct janus_json_parameter), values, &failed_param, type_name); \
+		if(validation == 1) { \
+			error_code = (missing_code); \
+			if(log_error) \
+				JANUS_LOG(LOG_ERR, "Missing mandatory element (%s)\n", failed_param); \
+			if(error_cause != NULL) \
+				g_snprintf(error_cause, sizeof(error_cause), "Missing mandatory element (%s)", failed_param); \
+		} else if(validation == 2) { \
+			error_code = (invalid_code); \
+			if(log_error) \
+				JANUS_LOG(LOG_ERR, "Invalid element type (%s should be %s)\n", failed_param, type_name); \
+			if(error_cause != NULL) \
+				g_snprintf(error_cause, sizeof(error_cause), "Invalid element type (%s should be %s)", failed_param, type_name); \
+		} \
+	} while(0)
+
 /*! \brief If the secret isn't NULL, check the secret after validating the specified member of the JSON object
  * @param secret The secret to be checked; no check if the secret is NULL
  * @param obj The JSON object to be validated
@@ -483,6 +537,20 @@ uint8_t janus_bitstream_getbit(uint8_t *base, uint32_t offset);
  * @returns The value of the bits */
 uint32_t janus_bitstream_getbits(uint8_t *base, uint8_t num, uint32_t *offset);
 
+/*! \brief Helper method to create an "immortal" constant JSON string
+ * \details Jansson treats values whose reference count is (size_t)-1 as
+ * immortal: json_incref and json_decref become no-ops on them, which also
+ * makes them safe to attach to messages processed by different threads
+ * (reference counts in Jansson are not atomic, so regular values can't be
+ * shared that way). Use this for constant strings that get attached to a
+ * lot of messages (e.g., with json_object_set), so that they're only
+ * allocated and copied once instead of once per message
+ * \note The returned value is never freed: only create a bounded number
+ * of these, typically in an init method
+ * @param[in] text The string constant
+ * @returns A shared json_t string that survives any json_decref */
+json_t *janus_json_immortal_string(const char *text);
+
 /*! \brief Helper method to compress a string to gzip (using zlib)
  * \note It's up to you to provide a buffer large enough for the compressed
  * data: in case the buffer isn't large enough, the request will fail
@@ -495,4 +563,29 @@ uint32_t janus_bitstream_getbits(uint8_t *base, uint8_t num, uint32_t *offset);
  */
 size_t janus_gzip_compress(int compression, char *text, size_t tlen, char *compressed, size_t zlen);
 
+/*! \brief Opaque reusable gzip compression context (see janus_gzip_context_create) */
+typedef struct janus_gzip_context janus_gzip_context;
+/*! \brief Helper method to create a reusable gzip compression context: when
+ * compressing many small payloads in a row (e.g., an event per message), reusing
+ * the same deflate state is much cheaper than janus_gzip_compress, which
+ * allocates and tears down a new one for each payload
+ * \note Contexts are not thread-safe: only use one from a single thread at a time
+ * @param[in] compression Compression factor (1=fastest, 9=best compression)
+ * @returns A valid janus_gzip_context pointer, if successful, NULL otherwise */
+janus_gzip_context *janus_gzip_context_create(int compression);
+/*! \brief Helper method to compress a string to gzip reusing an existing context
+ * \note It's up to you to provide a buffer large enough for the compressed
+ * data: in case the buffer isn't large enough, the request will fail
+ * @param[in] ctx The janus_gzip_context to use
+ * @param[in] compression Compression factor (can differ from the one the context was created with)
+ * @param[in] text Pointer to the string to compress
+ * @param[in] tlen Length of the string to compress
+ * @param[in] compressed Pointer to the buffer where to compress the string to
+ * @param[in] zlen Size of the output buffer
+ * @returns The size of the compressed data, if successful, or 0 otherwise */
+size_t janus_gzip_context_compress(janus_gzip_context *ctx, int compression, char *text, size_t tlen, char *compressed, size_t zlen);
+/*! \brief Helper method to destroy a janus_gzip_context
+ * @param[in] ctx The janus_gzip_context to destroy */
+void janus_gzip_context_destroy(janus_gzip_context *ctx);
+
 #endif